@@ -269,6 +269,174 @@ namespace Microsoft.Azure.IoT.Gateway.Test
             ///cleanup
         }
 
+        /* Tests_SRS_DOTNET_MESSAGE_04_002: [ Message class shall have a constructor that receives a byte array with it's content format as described in message_requirements.md and it's Content and Properties are extracted and saved. ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version2Message_Succeed()
+        {
+            ///arrage
+            byte[] notFail__2Property_3bytes_v2 =
+            {
+                0xA1, 0x60,             /*header*/
+                0x82,                   /*version 2*/
+                0x00, 0x00, 0x00, 24,   /*size of this array*/
+                0x02,                   /*two properties*/
+                0x01, 0x01, (byte)'x', (byte)'\0', /*interned "source"*/
+                0x04, (byte)'a', (byte)'b', (byte)'\0', 0x02, (byte)'c', (byte)'d', (byte)'\0',
+                0x03, 1, 2, 3           /*3 bytes of message content*/
+            };
+
+            ///act
+            var messageInstance = new Message(notFail__2Property_3bytes_v2);
+
+            ///Assert
+            Assert.AreEqual(3, messageInstance.Content.GetLength(0));
+            Assert.AreEqual(2, messageInstance.Properties.Count);
+            Assert.AreEqual("x", messageInstance.Properties["source"]);
+            Assert.AreEqual("cd", messageInstance.Properties["ab"]);
+            Assert.AreEqual((byte)3, messageInstance.Content[2]);
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_MESSAGE_04_006: [ If byte array received as a parameter to the Message(byte[] msgInByteArray) constructor is not in a valid format, it shall throw an ArgumentException ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version2Message_with_unknown_interned_name_throws()
+        {
+            ///arrage
+            byte[] fail_unknownInternedName_v2 =
+            {
+                0xA1, 0x60, 0x82, 0x00, 0x00, 0x00, 12,
+                0x01, 0x13, 0x00, (byte)'\0',
+                0x00
+            };
+
+            ///act
+            try
+            {
+                var messageInstance = new Message(fail_unknownInternedName_v2);
+            }
+            catch (ArgumentException e)
+            {
+                ///assert
+                StringAssert.Contains(e.Message, "Unknown interned property name.");
+                return;
+            }
+            Assert.Fail("No exception was thrown.");
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_MESSAGE_04_002: [ Message class shall have a constructor that receives a byte array with it's content format as described in message_requirements.md and it's Content and Properties are extracted and saved. ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version3Message_Succeed()
+        {
+            ///arrage
+            byte[] notFail__5TypedProperty_1bytes_v3 =
+            {
+                0xA1, 0x60,             /*header*/
+                0x83,                   /*version 3*/
+                0x00, 0x00, 0x00, 55,   /*size of this array*/
+                0x05,                   /*five properties*/
+                0x01, 0x00, 0x01, (byte)'x', (byte)'\0', /*interned "source", string*/
+                0x0D, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF4, /*interned "bleControllerIndex", int64*/
+                0x0F, 0x04, 0x00, 0x00, 0x01, 0x58, 0x87, 0x14, 0x4F, 0xC3, /*interned "timestamp"*/
+                0x02, (byte)'t', (byte)'\0', 0x02, 0x40, 0x35, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, /*double*/
+                0x02, (byte)'b', (byte)'\0', 0x03, 0x03, 0x00, 0xAB, 0x10, /*bytes*/
+                0x01, 7                 /*1 byte of message content*/
+            };
+
+            ///act
+            var messageInstance = new Message(notFail__5TypedProperty_1bytes_v3);
+
+            ///Assert
+            Assert.AreEqual(1, messageInstance.Content.GetLength(0));
+            Assert.AreEqual(5, messageInstance.Properties.Count);
+            Assert.AreEqual("x", messageInstance.Properties["source"]);
+            Assert.AreEqual("-12", messageInstance.Properties["bleControllerIndex"]);
+            Assert.AreEqual("2016-11-21T13:30:05.123Z", messageInstance.Properties["timestamp"]);
+            Assert.AreEqual("21.5", messageInstance.Properties["t"]);
+            Assert.AreEqual("00ab10", messageInstance.Properties["b"]);
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_MESSAGE_04_002: [ Message class shall have a constructor that receives a byte array with it's content format as described in message_requirements.md and it's Content and Properties are extracted and saved. ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version3Message_timestamp_before_1970_Succeed()
+        {
+            ///arrage
+            byte[] notFail__earlyTimestamp_v3 =
+            {
+                0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 19,
+                0x01,
+                0x0F, 0x04, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                0x00
+            };
+
+            ///act
+            var messageInstance = new Message(notFail__earlyTimestamp_v3);
+
+            ///Assert
+            Assert.AreEqual("1969-12-31T23:59:59.999Z", messageInstance.Properties["timestamp"]);
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_MESSAGE_04_006: [ If byte array received as a parameter to the Message(byte[] msgInByteArray) constructor is not in a valid format, it shall throw an ArgumentException ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version3Message_with_unknown_type_throws()
+        {
+            ///arrage
+            byte[] fail_unknownType_v3 =
+            {
+                0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 12,
+                0x01, 0x01, 0x05, 0x00,
+                0x00
+            };
+
+            ///act
+            try
+            {
+                var messageInstance = new Message(fail_unknownType_v3);
+            }
+            catch (ArgumentException e)
+            {
+                ///assert
+                StringAssert.Contains(e.Message, "Unknown property type.");
+                return;
+            }
+            Assert.Fail("No exception was thrown.");
+
+            ///cleanup
+        }
+
+        /* Tests_SRS_DOTNET_MESSAGE_04_006: [ If byte array received as a parameter to the Message(byte[] msgInByteArray) constructor is not in a valid format, it shall throw an ArgumentException ] */
+        [TestMethod]
+        public void Message_byteArrayConstructor_version3Message_with_truncated_number_throws()
+        {
+            ///arrage
+            byte[] fail_numberPastTheEnd_v3 =
+            {
+                0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 14,
+                0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00
+            };
+
+            ///act
+            try
+            {
+                var messageInstance = new Message(fail_numberPastTheEnd_v3);
+            }
+            catch (ArgumentException e)
+            {
+                ///assert
+                StringAssert.Contains(e.Message, "Number goes past the end of the array.");
+                return;
+            }
+            Assert.Fail("No exception was thrown.");
+
+            ///cleanup
+        }
+
         /* Tests_SRS_DOTNET_MESSAGE_04_002: [ Message class shall have a constructor that receives a byte array with it's content format as described in message_requirements.md and it's Content and Properties are extracted and saved. ] */
         [TestMethod]
         public void Message_byteArrayConstructor_notFail__0Property_1bytes_Succeed()
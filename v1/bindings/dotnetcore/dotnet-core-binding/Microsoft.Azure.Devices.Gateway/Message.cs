@@ -3,6 +3,7 @@
 
 using System;
 using System.Collections.Generic;
+using System.Globalization;
 using System.IO;
 
 namespace Microsoft.Azure.Devices.Gateway
@@ -20,6 +21,38 @@ namespace Microsoft.Azure.Devices.Gateway
         /// </summary>
         public Dictionary<string, string> Properties { get; }
 
+        // Byte 2 of a version 2 message; in version 1 it is the top byte of the array size.
+        private const byte Version2MessageByte = 0x82;
+
+        // Byte 2 of a version 3 message, which is version 2 with a type at the start of every value.
+        private const byte Version3MessageByte = 0x83;
+
+        // Types of version 3 values, in the order of MESSAGE_PROPERTY_TYPE.
+        private const int PropertyTypeString = 0;
+        private const int PropertyTypeInt64 = 1;
+        private const int PropertyTypeDouble = 2;
+        private const int PropertyTypeBytes = 3;
+        private const int PropertyTypeTimestamp = 4;
+
+        private const long MillisecondsPerDay = 86400000L;
+
+        // The smallest version 2 or 3 message: header, version, array size, no properties and no content.
+        private const int MinVersion2MessageSize = 9;
+
+        // Property names a version 2 message sends as ids, in the order of MESSAGE_PROPERTY_ID.
+        private static readonly string[] InternedPropertyNames =
+        {
+            "source",
+            "macAddress",
+            "deviceName",
+            "deviceKey",
+            "iotHubMessageId",
+            "iotHubMessageDeliveryStatus",
+            "bleControllerIndex",
+            "timestamp",
+            "characteristicUUID"
+        };
+
         private bool readNullTerminatedString(MemoryStream bis, out byte[] output)
         {
             List<byte> list = new List<byte>();
@@ -69,6 +102,163 @@ namespace Microsoft.Azure.Devices.Gateway
             return BitConverter.ToInt32(byteArray, 0);
         }
 
+        private static bool isVersion2Or3(byte[] input)
+        {
+            return input.Length >= MinVersion2MessageSize &&
+                input[0] == (byte)0xA1 && input[1] == (byte)0x60 &&
+                (input[2] == Version2MessageByte || input[2] == Version3MessageByte);
+        }
+
+        private static int readVarintFromMemoryStream(MemoryStream input)
+        {
+            long value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                int b = input.ReadByte();
+                if (b < 0)
+                {
+                    break;
+                }
+                value |= (long)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    if (value > int.MaxValue)
+                    {
+                        break;
+                    }
+                    return (int)value;
+                }
+            }
+            throw new ArgumentException("Invalid varint.");
+        }
+
+        private static string readSizedStringFromMemoryStream(MemoryStream input, int length)
+        {
+            if (input.Length - input.Position <= length)
+            {
+                throw new ArgumentException("String goes past the end of the array.");
+            }
+            byte[] bytes = new byte[length];
+            input.Read(bytes, 0, length);
+            if (input.ReadByte() != 0)
+            {
+                throw new ArgumentException("String is not null-terminated.");
+            }
+            return System.Text.Encoding.UTF8.GetString(bytes, 0, length);
+        }
+
+        private static long readInt64FromMemoryStream(MemoryStream input)
+        {
+            if (input.Length - input.Position < 8)
+            {
+                throw new ArgumentException("Number goes past the end of the array.");
+            }
+            long value = 0;
+            for (int index = 0; index < 8; index++)
+            {
+                value = (value << 8) | (long)input.ReadByte();
+            }
+            return value;
+        }
+
+        // Writes milliseconds since 1970-01-01T00:00:00Z as YYYY-MM-DDTHH:MM:SS.mmmZ, with
+        // H. Hinnant's civil_from_days as the gateway does, so that every year comes out the
+        // same in every language.
+        private static string timestampToString(long timestamp)
+        {
+            long days = timestamp / MillisecondsPerDay;
+            long milliseconds = timestamp % MillisecondsPerDay;
+            if (milliseconds < 0)
+            {
+                milliseconds += MillisecondsPerDay;
+                days--;
+            }
+
+            long shifted = days + 719468;
+            long era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+            long dayOfEra = shifted - era * 146097;
+            long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+            long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+            long marchMonth = (5 * dayOfYear + 2) / 153;
+            long day = dayOfYear - (153 * marchMonth + 2) / 5 + 1;
+            long month = marchMonth < 10 ? marchMonth + 3 : marchMonth - 9;
+            long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+            return string.Format(CultureInfo.InvariantCulture, "{0:D4}-{1:D2}-{2:D2}T{3:D2}:{4:D2}:{5:D2}.{6:D3}Z", year, month, day,
+                milliseconds / 3600000, milliseconds / 60000 % 60, milliseconds / 1000 % 60, milliseconds % 1000);
+        }
+
+        // Reads a version 3 value as the string the gateway would hand out for it. Doubles use
+        // the round-trip format, which may pick other digits than the gateway for the same double.
+        private static string readTypedValueFromMemoryStream(MemoryStream input)
+        {
+            switch (input.ReadByte())
+            {
+                case PropertyTypeString:
+                    return readSizedStringFromMemoryStream(input, readVarintFromMemoryStream(input));
+                case PropertyTypeInt64:
+                    return readInt64FromMemoryStream(input).ToString(CultureInfo.InvariantCulture);
+                case PropertyTypeDouble:
+                    return BitConverter.Int64BitsToDouble(readInt64FromMemoryStream(input)).ToString("R", CultureInfo.InvariantCulture);
+                case PropertyTypeBytes:
+                    int length = readVarintFromMemoryStream(input);
+                    if (input.Length - input.Position < length)
+                    {
+                        throw new ArgumentException("Bytes go past the end of the array.");
+                    }
+                    byte[] bytes = new byte[length];
+                    input.Read(bytes, 0, length);
+                    return BitConverter.ToString(bytes).Replace("-", "").ToLowerInvariant();
+                case PropertyTypeTimestamp:
+                    return timestampToString(readInt64FromMemoryStream(input));
+                default:
+                    throw new ArgumentException("Unknown property type.");
+            }
+        }
+
+        // Reads what follows the version byte of a version 2 message: counts and lengths are
+        // varints and well-known property names are sent as ids. Version 3 also starts every
+        // value with its type. Returns the content.
+        private byte[] readVersion2(MemoryStream stream, int size, bool typed)
+        {
+            if (readIntFromMemoryStream(stream) != size)
+            {
+                throw new ArgumentException("Array Size information doesn't match with array size.");
+            }
+
+            int propCount = readVarintFromMemoryStream(stream);
+            for (int count = 0; count < propCount; count++)
+            {
+                int tag = readVarintFromMemoryStream(stream);
+                string key;
+                if ((tag & 1) != 0)
+                {
+                    if ((tag >> 1) >= InternedPropertyNames.Length)
+                    {
+                        throw new ArgumentException("Unknown interned property name.");
+                    }
+                    key = InternedPropertyNames[tag >> 1];
+                }
+                else
+                {
+                    key = readSizedStringFromMemoryStream(stream, tag >> 1);
+                }
+                this.Properties.Add(key, typed ?
+                    readTypedValueFromMemoryStream(stream) :
+                    readSizedStringFromMemoryStream(stream, readVarintFromMemoryStream(stream)));
+            }
+
+            int contentLength = readVarintFromMemoryStream(stream);
+            if (stream.Length - stream.Position != contentLength)
+            {
+                throw new ArgumentException("Size of byte array doesn't match with current content.");
+            }
+
+            byte[] content = new byte[contentLength];
+            stream.Read(content, 0, contentLength);
+            return content;
+        }
+
         /// <summary>
         ///     Constructor for Message. This receives a byte array. Format defined at <a href="https://github.com/Azure/azure-iot-gateway-sdk/blob/master/core/devdoc/message_requirements.md">message_requirements.md</a>.
         /// </summary>
@@ -81,7 +271,7 @@ namespace Microsoft.Azure.Devices.Gateway
                 throw new ArgumentNullException("msgAsByteArray", "msgAsByteArray cannot be null");                    
             }
             /* Codes_SRS_DOTNET_CORE_MESSAGE_04_002: [ Message class shall have a constructor that receives a byte array with it's content format as described in message_requirements.md and it's Content and Properties are extracted and saved. ] */
-            else if (msgAsByteArray.Length >= 14)
+            else if (msgAsByteArray.Length >= 14 || isVersion2Or3(msgAsByteArray))
             {
                 MemoryStream stream = new MemoryStream(msgAsByteArray);
                 this.Properties = new Dictionary<string, string>();
@@ -89,7 +279,13 @@ namespace Microsoft.Azure.Devices.Gateway
                 byte header1 = (byte)stream.ReadByte();
                 byte header2 = (byte)stream.ReadByte();
 
-                if (header1 == (byte)0xA1 && header2 == (byte)0x60)
+                if (isVersion2Or3(msgAsByteArray))
+                {
+                    bool typed = stream.ReadByte() == Version3MessageByte;
+                    /* Codes_SRS_DOTNET_CORE_MESSAGE_04_006: [ If byte array received as a parameter to the Message(byte[] msgInByteArray) constructor is not in a valid format, it shall throw an ArgumentException ] */
+                    this.Content = readVersion2(stream, msgAsByteArray.Length, typed);
+                }
+                else if (header1 == (byte)0xA1 && header2 == (byte)0x60)
                 {
                     int arraySizeInInt;
                     try
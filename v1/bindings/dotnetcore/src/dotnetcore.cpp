@@ -324,36 +324,25 @@ static void DotNetCore_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
         {
             DOTNET_CORE_HOST_HANDLE_DATA* result = (DOTNET_CORE_HOST_HANDLE_DATA*)moduleHandle;
 
-            /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
-            int32_t size = Message_ToByteArray(messageHandle, NULL, 0); 
+            /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_GetByteArray to get the serialized form of message. ] */
+            const CONSTBUFFER* serialized = Message_GetByteArray(messageHandle);
 
-            if (size > 0)
+            if (serialized == NULL)
             {
-                unsigned char* buffer = (unsigned char*)malloc(size);
-
-                if (buffer != NULL)
+                LogError("Unable to convert message to Byte Array");
+            }
+            else if (serialized->size > 0)
+            {
+                try
                 {
-                    int32_t resultFromConversionToByteArray = Message_ToByteArray(messageHandle, buffer, size);
-
-                    if (resultFromConversionToByteArray > 0)
-                    {
-                        try
-                        {
-                            /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
-                            (*GatewayReceiveDelegate)(buffer, size, result->module_id);
-                        }
-                        catch (const std::exception& msgErr)
-                        {
-                            (void)msgErr;
-                            LogError("Exception Thrown. Error on calling Receive Delegate.");
-                        }
-                    }
-                    else
-                    {
-                        LogError("Unable to convert message to Byte Array");
-                    }
-
-                    delete(buffer);
+                    /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
+                    /* The managed side copies the buffer before returning, so the message's own bytes are handed over as-is. */
+                    (*GatewayReceiveDelegate)(const_cast<unsigned char*>(serialized->buffer), (int32_t)serialized->size, result->module_id);
+                }
+                catch (const std::exception& msgErr)
+                {
+                    (void)msgErr;
+                    LogError("Exception Thrown. Error on calling Receive Delegate.");
                 }
             }
         }
@@ -289,6 +289,7 @@ TEST_FUNCTION(GW_dotnetcore_binding_e2e_Managed2Managed)
     GATEWAY_PROPERTIES properties;
     properties.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     properties.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    properties.broker_config = NULL;
     ASSERT_IS_NOT_NULL(properties.gateway_modules);
     ASSERT_IS_NOT_NULL(properties.gateway_links);
     VECTOR_push_back(properties.gateway_modules, modulesEntryArray, 3);
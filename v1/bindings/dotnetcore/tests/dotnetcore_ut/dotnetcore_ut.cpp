@@ -49,6 +49,9 @@ extern PGatewayStartDelegate GatewayStartDelegate;
 static size_t gMessageSize;
 static const unsigned char * gMessageSource;
 
+static const unsigned char serializedMessageBytes[11] = { 0 };
+static const CONSTBUFFER serializedMessage = { serializedMessageBytes, sizeof(serializedMessageBytes) };
+
 static size_t currentnew_call;
 static size_t whenShallnew_fail;
 static size_t currentnewarray_call;
@@ -261,8 +264,8 @@ public:
     MOCK_VOID_METHOD_END()
 
     //Message Mocks
-    MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t , size)
-    MOCK_METHOD_END( int32_t, (int32_t)11);
+    MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetByteArray, MESSAGE_HANDLE, messageHandle)
+    MOCK_METHOD_END(const CONSTBUFFER*, &serializedMessage);
 
     MOCK_STATIC_METHOD_2(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
     MOCK_METHOD_END(MESSAGE_HANDLE, (MESSAGE_HANDLE)0x42);
@@ -386,7 +389,7 @@ extern "C"
 
         
     //Message Mocks
-    DECLARE_GLOBAL_MOCK_METHOD_3(CDOTNETCOREMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t, size);
+    DECLARE_GLOBAL_MOCK_METHOD_1(CDOTNETCOREMocks, , const CONSTBUFFER*, Message_GetByteArray, MESSAGE_HANDLE, messageHandle);
 
     DECLARE_GLOBAL_MOCK_METHOD_2(CDOTNETCOREMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
 
@@ -1106,7 +1109,7 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         ///cleanup
     }
 
-    /* Tests_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
+    /* Tests_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_GetByteArray to get the serialized form of message. ] */
     /* Tests_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
     TEST_FUNCTION(DotNetCore_Receive_succeed)
     {
@@ -1127,10 +1130,7 @@ BEGIN_TEST_SUITE(dotnetcore_ut)
         auto result = MODULE_CREATE(theAPIS)((BROKER_HANDLE)0x42, &dotNetConfig);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_ToByteArray((MESSAGE_HANDLE)0x42, NULL, 0));
-
-        STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, Message_GetByteArray((MESSAGE_HANDLE)0x42));
 
 
         ///act
@@ -7,10 +7,41 @@ package com.microsoft.azure.gateway.messaging;
 import java.io.*;
 import java.util.ArrayList;
 import java.util.HashMap;
+import java.util.Locale;
 import java.util.Map;
 
 public final class Message {
 
+    /** Byte 2 of a version 2 serialized message; in version 1 it is the top byte of the array size. */
+    private static final byte VERSION_2_MESSAGE_BYTE = (byte) 0x82;
+
+    /** Byte 2 of a version 3 serialized message, which is version 2 with a type at the start of every value. */
+    private static final byte VERSION_3_MESSAGE_BYTE = (byte) 0x83;
+
+    /** Types of version 3 values, in the order of MESSAGE_PROPERTY_TYPE. */
+    private static final int PROPERTY_TYPE_STRING = 0;
+    private static final int PROPERTY_TYPE_INT64 = 1;
+    private static final int PROPERTY_TYPE_DOUBLE = 2;
+    private static final int PROPERTY_TYPE_BYTES = 3;
+    private static final int PROPERTY_TYPE_TIMESTAMP = 4;
+
+    private static final long MILLISECONDS_PER_DAY = 86400000L;
+
+    private static final char[] HEX_DIGITS = "0123456789abcdef".toCharArray();
+
+    /** Property names a version 2 serialized message sends as ids, in the order of MESSAGE_PROPERTY_ID. */
+    private static final String[] INTERNED_PROPERTY_NAMES = {
+        "source",
+        "macAddress",
+        "deviceName",
+        "deviceKey",
+        "iotHubMessageId",
+        "iotHubMessageDeliveryStatus",
+        "bleControllerIndex",
+        "timestamp",
+        "characteristicUUID"
+    };
+
     private Map<String, String> properties;
 
     private byte[] content;
@@ -125,7 +156,12 @@ public final class Message {
             //Get Header
             byte header1 = dis.readByte();
             byte header2 = dis.readByte();
-            if (header1 == (byte) 0xA1 && header2 == (byte) 0x60) {
+            if (header1 == (byte) 0xA1 && header2 == (byte) 0x60 &&
+                serializedMessage.length > 2 &&
+                (serializedMessage[2] == VERSION_2_MESSAGE_BYTE || serializedMessage[2] == VERSION_3_MESSAGE_BYTE)) {
+                dis.readByte();
+                fromByteArrayV2(serializedMessage.length, dis, serializedMessage[2] == VERSION_3_MESSAGE_BYTE);
+            } else if (header1 == (byte) 0xA1 && header2 == (byte) 0x60) {
                 int arraySize = dis.readInt();
                 if (arraySize >= 14) {
                     Map<String, String> _properties = new HashMap<String, String>();
@@ -157,6 +193,150 @@ public final class Message {
         }
     }
 
+    /**
+     * Deserializes the rest of a version 2 message, where counts and lengths are varints and well-known
+     * property names are sent as ids, or of a version 3 message, where every value also has a type.
+     *
+     * @param size The size of the whole serialized message.
+     * @param dis The stream, positioned after the version byte.
+     * @param typed Whether the message is version 3.
+     * @throws IOException if the message is malformed.
+     */
+    private void fromByteArrayV2(int size, DataInputStream dis, boolean typed) throws IOException {
+        if (dis.readInt() != size) {
+            throw new IOException("Invalid byte array size.");
+        }
+
+        Map<String, String> _properties = new HashMap<String, String>();
+        int propCount = readVarint(dis);
+        for (int count = 0; count < propCount; count++) {
+            int tag = readVarint(dis);
+            String key;
+            if ((tag & 1) != 0) {
+                if ((tag >>> 1) >= INTERNED_PROPERTY_NAMES.length) {
+                    throw new IOException("Unknown interned property name.");
+                }
+                key = INTERNED_PROPERTY_NAMES[tag >>> 1];
+            } else {
+                key = new String(readString(dis, tag >>> 1));
+            }
+            String value = typed ? readTypedValue(dis) : new String(readString(dis, readVarint(dis)));
+            _properties.put(key, value);
+        }
+
+        int contentLength = readVarint(dis);
+        byte[] content = new byte[contentLength];
+        dis.readFully(content);
+        if (dis.available() != 0) {
+            throw new IOException("Content size does not match the array size.");
+        }
+
+        this.properties = _properties;
+        this.content = content;
+    }
+
+    /**
+     * Reads a version 3 value as the string the gateway would hand out for it. Doubles use
+     * {@link Double#toString(double)}, which may pick other digits than the gateway for the same double.
+     *
+     * @param dis The stream, positioned at the type of the value.
+     * @return The value as a string.
+     * @throws IOException if the value is truncated or its type is unknown.
+     */
+    private static String readTypedValue(DataInputStream dis) throws IOException {
+        int type = dis.readUnsignedByte();
+        switch (type) {
+            case PROPERTY_TYPE_STRING:
+                return new String(readString(dis, readVarint(dis)));
+            case PROPERTY_TYPE_INT64:
+                return Long.toString(dis.readLong());
+            case PROPERTY_TYPE_DOUBLE:
+                return Double.toString(dis.readDouble());
+            case PROPERTY_TYPE_BYTES: {
+                byte[] bytes = new byte[readVarint(dis)];
+                dis.readFully(bytes);
+                char[] hex = new char[bytes.length * 2];
+                for (int index = 0; index < bytes.length; index++) {
+                    hex[index * 2] = HEX_DIGITS[(bytes[index] >> 4) & 0x0F];
+                    hex[index * 2 + 1] = HEX_DIGITS[bytes[index] & 0x0F];
+                }
+                return new String(hex);
+            }
+            case PROPERTY_TYPE_TIMESTAMP:
+                return timestampToString(dis.readLong());
+            default:
+                throw new IOException("Unknown property type.");
+        }
+    }
+
+    /**
+     * Writes milliseconds since 1970-01-01T00:00:00Z as YYYY-MM-DDTHH:MM:SS.mmmZ, with H. Hinnant's
+     * civil_from_days as the gateway does, so that every year comes out the same in every language.
+     *
+     * @param timestamp The milliseconds since 1970-01-01T00:00:00Z.
+     * @return The timestamp as a string.
+     */
+    private static String timestampToString(long timestamp) {
+        long days = timestamp / MILLISECONDS_PER_DAY;
+        long milliseconds = timestamp % MILLISECONDS_PER_DAY;
+        if (milliseconds < 0) {
+            milliseconds += MILLISECONDS_PER_DAY;
+            days--;
+        }
+
+        long shifted = days + 719468;
+        long era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+        long dayOfEra = shifted - era * 146097;
+        long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        long marchMonth = (5 * dayOfYear + 2) / 153;
+        long day = dayOfYear - (153 * marchMonth + 2) / 5 + 1;
+        long month = marchMonth < 10 ? marchMonth + 3 : marchMonth - 9;
+        long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+        return String.format(Locale.ROOT, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", year, month, day,
+            milliseconds / 3600000, milliseconds / 60000 % 60, milliseconds / 1000 % 60, milliseconds % 1000);
+    }
+
+    /**
+     * Reads an unsigned varint: 7 bits per byte, least significant group first.
+     *
+     * @param dis The stream from which to read the varint.
+     * @return The value, which must fit a non-negative int.
+     * @throws IOException if the varint is truncated or too large.
+     */
+    private static int readVarint(DataInputStream dis) throws IOException {
+        long value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            int b = dis.readUnsignedByte();
+            value |= (long) (b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                if (value > Integer.MAX_VALUE) {
+                    break;
+                }
+                return (int) value;
+            }
+        }
+        throw new IOException("Invalid varint.");
+    }
+
+    /**
+     * Reads {@code length} bytes followed by a null terminator.
+     *
+     * @param dis The stream from which to read the string.
+     * @param length The number of bytes before the terminator.
+     * @return The bytes of the string.
+     * @throws IOException if the string is truncated or not null-terminated.
+     */
+    private static byte[] readString(DataInputStream dis, int length) throws IOException {
+        byte[] result = new byte[length];
+        dis.readFully(result);
+        if (dis.readByte() != '\0') {
+            throw new IOException("Could not read null-terminated string.");
+        }
+        return result;
+    }
+
     /**
      * Returns the first null-terminated ('\0') sub-array.
      *
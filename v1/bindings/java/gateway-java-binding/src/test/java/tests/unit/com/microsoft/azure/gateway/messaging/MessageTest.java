@@ -186,6 +186,127 @@ public class MessageTest {
         assertTrue(Arrays.equals(expectedContent, actualContent));
     }
 
+    /*Tests_SRS_JAVA_MESSAGE_14_001: [ The constructor shall create a Message object by deserializing the byte array. ]*/
+    @Test
+    public void constructorSetsDataFromInputArray_Version2() throws IOException {
+        byte[] notFail__2Property_2bytes_v2 =
+            {
+                (byte)0xA1, 0x60,       /*header*/
+                (byte)0x82,             /*version 2*/
+                0x00, 0x00, 0x00, 24,   /*size of this array*/
+                0x02,                   /*two properties*/
+                0x01, 0x01, 'x', '\0',  /*interned "source"*/
+                0x04, 'a', 'b', '\0', 0x02, 'c', 'd', '\0',
+                0x03, 1, 2, 3           /*3 bytes of message content*/
+            };
+
+        Map<String, String> expected = new HashMap<String, String>();
+        expected.put("source", "x");
+        expected.put("ab", "cd");
+        byte[] expectedContent = new byte[]{ 1, 2, 3 };
+
+        Message message = new Message(notFail__2Property_2bytes_v2);
+
+        assertEquals(expected, message.getProperties());
+        assertTrue(Arrays.equals(expectedContent, message.getContent()));
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
+    @Test(expected = IllegalArgumentException.class)
+    public void constructorThrowsExceptionForVersion2UnknownInternedName(){
+        byte[] fail_unknownInternedName_v2 =
+            {
+                (byte)0xA1, 0x60, (byte)0x82, 0x00, 0x00, 0x00, 12,
+                0x01, 0x13, 0x00, '\0',
+                0x00
+            };
+
+        new Message(fail_unknownInternedName_v2);
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
+    @Test(expected = IllegalArgumentException.class)
+    public void constructorThrowsExceptionForVersion2ValuePastTheEnd(){
+        byte[] fail_valuePastTheEnd_v2 =
+            {
+                (byte)0xA1, 0x60, (byte)0x82, 0x00, 0x00, 0x00, 11,
+                0x01, 0x01, 0x09, '\0'
+            };
+
+        new Message(fail_valuePastTheEnd_v2);
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_001: [ The constructor shall create a Message object by deserializing the byte array. ]*/
+    @Test
+    public void constructorSetsDataFromInputArray_Version3() throws IOException {
+        byte[] notFail__typedProperties_v3 =
+            {
+                (byte)0xA1, 0x60,       /*header*/
+                (byte)0x83,             /*version 3*/
+                0x00, 0x00, 0x00, 55,   /*size of this array*/
+                0x05,                   /*five properties*/
+                0x01, 0x00, 0x01, 'x', '\0', /*interned "source", string*/
+                0x0D, 0x01, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xF4, /*interned "bleControllerIndex", int64*/
+                0x0F, 0x04, 0x00, 0x00, 0x01, 0x58, (byte)0x87, 0x14, 0x4F, (byte)0xC3, /*interned "timestamp"*/
+                0x02, 't', '\0', 0x02, 0x40, 0x35, (byte)0x80, 0x00, 0x00, 0x00, 0x00, 0x00, /*double*/
+                0x02, 'b', '\0', 0x03, 0x03, 0x00, (byte)0xAB, 0x10, /*bytes*/
+                0x01, 7                 /*1 byte of message content*/
+            };
+
+        Map<String, String> expected = new HashMap<String, String>();
+        expected.put("source", "x");
+        expected.put("bleControllerIndex", "-12");
+        expected.put("timestamp", "2016-11-21T13:30:05.123Z");
+        expected.put("t", "21.5");
+        expected.put("b", "00ab10");
+
+        Message message = new Message(notFail__typedProperties_v3);
+
+        assertEquals(expected, message.getProperties());
+        assertTrue(Arrays.equals(new byte[]{ 7 }, message.getContent()));
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_001: [ The constructor shall create a Message object by deserializing the byte array. ]*/
+    @Test
+    public void constructorReadsVersion3TimestampsBefore1970() throws IOException {
+        byte[] notFail__earlyTimestamp_v3 =
+            {
+                (byte)0xA1, 0x60, (byte)0x83, 0x00, 0x00, 0x00, 19,
+                0x01,
+                0x0F, 0x04, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF, (byte)0xFF,
+                0x00
+            };
+
+        Message message = new Message(notFail__earlyTimestamp_v3);
+
+        assertEquals("1969-12-31T23:59:59.999Z", message.getProperties().get("timestamp"));
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
+    @Test(expected = IllegalArgumentException.class)
+    public void constructorThrowsExceptionForVersion3UnknownType(){
+        byte[] fail_unknownType_v3 =
+            {
+                (byte)0xA1, 0x60, (byte)0x83, 0x00, 0x00, 0x00, 12,
+                0x01, 0x01, 0x05, 0x00,
+                0x00
+            };
+
+        new Message(fail_unknownType_v3);
+    }
+
+    /*Tests_SRS_JAVA_MESSAGE_14_002: [ If the byte array is malformed, the function shall throw an IllegalArgumentException. ]*/
+    @Test(expected = IllegalArgumentException.class)
+    public void constructorThrowsExceptionForVersion3NumberPastTheEnd(){
+        byte[] fail_numberPastTheEnd_v3 =
+            {
+                (byte)0xA1, 0x60, (byte)0x83, 0x00, 0x00, 0x00, 14,
+                0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00
+            };
+
+        new Message(fail_numberPastTheEnd_v3);
+    }
+
     /*Tests_SRS_JAVA_MESSAGE_14_004: [ The function shall serialize the Message content and properties according to the specification in message.h ]*/
     @Test
     public void toByteArraySerializesMinimalMessageSuccess() throws IOException {
@@ -120,6 +120,15 @@ int32_t my_MessageToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf,
     return 1;
 }
 
+static const unsigned char serialized_message_bytes[1] = { 0 };
+static const CONSTBUFFER serialized_message = { serialized_message_bytes, sizeof(serialized_message_bytes) };
+
+const CONSTBUFFER* my_Message_GetByteArray(MESSAGE_HANDLE messageHandle)
+{
+    (void)messageHandle;
+    return &serialized_message;
+}
+
 void my_Message_Destroy(MESSAGE_HANDLE message)
 {
     if (message != NULL)
@@ -669,6 +678,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     //Message Hooks
     REGISTER_GLOBAL_MOCK_HOOK(Message_CreateFromByteArray, my_Message_CreateFromByteArray);
     REGISTER_GLOBAL_MOCK_HOOK(Message_ToByteArray, my_MessageToByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_GetByteArray, my_Message_GetByteArray);
     REGISTER_GLOBAL_MOCK_HOOK(Message_Destroy, my_Message_Destroy);
 
     //JavaModuleHostManager Hooks
@@ -688,6 +698,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
 
@@ -2175,12 +2186,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
     MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
 
     STRICT_EXPECTED_CALL(AttachCurrentThread(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(1)
@@ -2223,8 +2229,6 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
     STRICT_EXPECTED_CALL(DetachCurrentThread(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //Act
     JavaModuleHost_Receive(module, message);
@@ -2280,7 +2284,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_message_NULL_failure)
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_Message_GetByteArray_failure)
 {
     //Arrange
     const unsigned char msg[] =
@@ -2299,8 +2303,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0))
-        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message))
+        .SetFailReturn(NULL);
 
 
     umock_c_negative_tests_snapshot();
@@ -2320,47 +2324,6 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
 
 }
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
-{
-    //Arrange
-    const unsigned char msg[] =
-    {
-        0xA1, 0x60,             /*header*/
-        0x00, 0x00, 0x00, 14,   /*size of this array*/
-        0x00, 0x00, 0x00, 0x00, /*zero properties*/
-        0x00, 0x00, 0x00, 0x00  /*zero message content size*/
-    };
-
-    MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
-    MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
-    umock_c_reset_all_calls();
-
-    int result = 0;
-    result = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, result);
-
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(NULL);
-
-    umock_c_negative_tests_snapshot();
-
-    //Act
-    umock_c_negative_tests_fail_call(1);
-    JavaModuleHost_Receive(module, message);
-
-    //Assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //Cleanup
-    Message_Destroy(message);
-    JavaModuleHost_Destroy(module);
-
-    umock_c_negative_tests_deinit();
-
-}
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
 TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
 {
@@ -2381,21 +2344,14 @@ TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(3);
+    umock_c_negative_tests_fail_call(1);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2428,12 +2384,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -2441,13 +2392,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
 
     STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(4);
+    umock_c_negative_tests_fail_call(2);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2480,12 +2429,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -2501,13 +2445,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(6);
+    umock_c_negative_tests_fail_call(4);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2540,12 +2482,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -2561,13 +2498,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(7);
+    umock_c_negative_tests_fail_call(5);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2600,12 +2535,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -2626,13 +2556,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(8);
+    umock_c_negative_tests_fail_call(6);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -2665,12 +2593,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
     result = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, result);
 
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_GetByteArray(message));
     STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -2696,13 +2619,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     umock_c_negative_tests_snapshot();
 
     //Act
-    umock_c_negative_tests_fail_call(11);
+    umock_c_negative_tests_fail_call(9);
     JavaModuleHost_Receive(module, message);
 
     //Assert
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "mapped_file.h"
+
+typedef struct MAPPED_FILE_TAG
+{
+    void* address;
+    size_t size;
+}MAPPED_FILE;
+
+MAPPED_FILE_HANDLE MappedFile_Open(const char* path, const unsigned char** data, size_t* size)
+{
+    MAPPED_FILE* result;
+    if (path == NULL || data == NULL || size == NULL)
+    {
+        /*Codes_SRS_MAPPED_FILE_17_001: [ MappedFile_Open shall return NULL if path, data or size is NULL. ]*/
+        LogError("invalid arg path=%p, data=%p, size=%p", path, data, size);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MAPPED_FILE_17_002: [ MappedFile_Open shall map the whole file read only, with open, fstat and mmap on Linux and CreateFileA, CreateFileMappingA and MapViewOfFile on Windows. ]*/
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+            LogError("unable to open %s", path);
+            result = NULL;
+        }
+        else
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > SIZE_MAX)
+            {
+                /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                LogError("unable to get the size of %s", path);
+                result = NULL;
+            }
+            else if ((result = (MAPPED_FILE*)malloc(sizeof(MAPPED_FILE))) == NULL)
+            {
+                /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                LogError("malloc failed");
+            }
+            else
+            {
+                result->size = (size_t)st.st_size;
+                if (result->size == 0)
+                {
+                    /*Codes_SRS_MAPPED_FILE_17_005: [ An empty file shall not be mapped; *data shall be NULL and *size 0. ]*/
+                    result->address = NULL;
+                }
+                else if ((result->address = mmap(NULL, result->size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+                {
+                    /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                    LogError("unable to map %zu bytes of %s", result->size, path);
+                    free(result);
+                    result = NULL;
+                }
+
+                if (result != NULL)
+                {
+                    /*Codes_SRS_MAPPED_FILE_17_003: [ On success, MappedFile_Open shall set *data and *size to the mapping and return a non-NULL handle. ]*/
+                    *data = (const unsigned char*)result->address;
+                    *size = result->size;
+                }
+            }
+            /*the mapping stays valid once the descriptor is closed*/
+            (void)close(fd);
+        }
+    }
+    return result;
+}
+
+void MappedFile_Close(MAPPED_FILE_HANDLE handle)
+{
+    /*Codes_SRS_MAPPED_FILE_17_006: [ MappedFile_Close shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_MAPPED_FILE_17_007: [ MappedFile_Close shall unmap the file and free handle. ]*/
+        if (handle->address != NULL)
+        {
+            (void)munmap(handle->address, handle->size);
+        }
+        free(handle);
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <windows.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "mapped_file.h"
+
+typedef struct MAPPED_FILE_TAG
+{
+    void* address;
+    size_t size;
+}MAPPED_FILE;
+
+MAPPED_FILE_HANDLE MappedFile_Open(const char* path, const unsigned char** data, size_t* size)
+{
+    MAPPED_FILE* result;
+    if (path == NULL || data == NULL || size == NULL)
+    {
+        /*Codes_SRS_MAPPED_FILE_17_001: [ MappedFile_Open shall return NULL if path, data or size is NULL. ]*/
+        LogError("invalid arg path=%p, data=%p, size=%p", path, data, size);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MAPPED_FILE_17_002: [ MappedFile_Open shall map the whole file read only, with open, fstat and mmap on Linux and CreateFileA, CreateFileMappingA and MapViewOfFile on Windows. ]*/
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+            LogError("unable to open %s, error %u", path, (unsigned int)GetLastError());
+            result = NULL;
+        }
+        else
+        {
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || (uint64_t)fileSize.QuadPart > SIZE_MAX)
+            {
+                /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                LogError("unable to get the size of %s", path);
+                result = NULL;
+            }
+            else if ((result = (MAPPED_FILE*)malloc(sizeof(MAPPED_FILE))) == NULL)
+            {
+                /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                LogError("malloc failed");
+            }
+            else
+            {
+                result->size = (size_t)fileSize.QuadPart;
+                if (result->size == 0)
+                {
+                    /*Codes_SRS_MAPPED_FILE_17_005: [ An empty file shall not be mapped; *data shall be NULL and *size 0. ]*/
+                    result->address = NULL;
+                }
+                else
+                {
+                    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mapping == NULL)
+                    {
+                        result->address = NULL;
+                    }
+                    else
+                    {
+                        result->address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                        /*the view keeps the mapping alive*/
+                        (void)CloseHandle(mapping);
+                    }
+
+                    if (result->address == NULL)
+                    {
+                        /*Codes_SRS_MAPPED_FILE_17_004: [ MappedFile_Open shall return NULL if the file cannot be opened or mapped. ]*/
+                        LogError("unable to map %zu bytes of %s, error %u", result->size, path, (unsigned int)GetLastError());
+                        free(result);
+                        result = NULL;
+                    }
+                }
+
+                if (result != NULL)
+                {
+                    /*Codes_SRS_MAPPED_FILE_17_003: [ On success, MappedFile_Open shall set *data and *size to the mapping and return a non-NULL handle. ]*/
+                    *data = (const unsigned char*)result->address;
+                    *size = result->size;
+                }
+            }
+            (void)CloseHandle(file);
+        }
+    }
+    return result;
+}
+
+void MappedFile_Close(MAPPED_FILE_HANDLE handle)
+{
+    /*Codes_SRS_MAPPED_FILE_17_006: [ MappedFile_Close shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_MAPPED_FILE_17_007: [ MappedFile_Close shall unmap the file and free handle. ]*/
+        if (handle->address != NULL)
+        {
+            (void)UnmapViewOfFile(handle->address);
+        }
+        free(handle);
+    }
+}
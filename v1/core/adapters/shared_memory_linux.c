@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "shared_memory.h"
+
+/*without futexes, waiters check the word again after this long*/
+#define SHARED_MEMORY_POLL_MS 1
+
+typedef struct SHARED_MEMORY_TAG
+{
+    void* address;
+    size_t size;
+    /*"/" + name; only kept by the process that created the region*/
+    char* path;
+}SHARED_MEMORY;
+
+static char* make_path(const char* name)
+{
+    char* result;
+    if (name == NULL || name[0] == '\0' || strchr(name, '/') != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid shared memory name %s", (name == NULL) ? "NULL" : name);
+        result = NULL;
+    }
+    else if ((result = (char*)malloc(strlen(name) + 2)) == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else
+    {
+        result[0] = '/';
+        (void)strcpy(result + 1, name);
+    }
+    return result;
+}
+
+SHARED_MEMORY_HANDLE SharedMemory_Create(const char* name, size_t size, void** address)
+{
+    SHARED_MEMORY* result;
+    char* path;
+    if (size == 0 || address == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid arg size=%zu, address=%p", size, address);
+        result = NULL;
+    }
+    else if ((path = make_path(name)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_002: [ SharedMemory_Create shall create the region with shm_open, ftruncate and mmap on Linux and CreateFileMappingA and MapViewOfFile on Windows. ]*/
+        int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (fd == -1 && errno == EEXIST)
+        {
+            /*Codes_SRS_SHARED_MEMORY_17_003: [ On Linux, SharedMemory_Create shall replace a region left behind under name; on Windows it shall fail while another process uses the name. ]*/
+            (void)shm_unlink(path);
+            fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        }
+
+        if (fd == -1)
+        {
+            /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+            LogError("unable to create shared memory %s, errno = %d", path, errno);
+            free(path);
+            result = NULL;
+        }
+        else
+        {
+            /*ftruncate fills the region with zeros*/
+            if (ftruncate(fd, (off_t)size) != 0)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                LogError("unable to size shared memory %s to %zu bytes, errno = %d", path, size, errno);
+                result = NULL;
+            }
+            else if ((result = (SHARED_MEMORY*)malloc(sizeof(SHARED_MEMORY))) == NULL)
+            {
+                LogError("malloc failed");
+            }
+            else if ((result->address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                LogError("unable to map %zu bytes of shared memory %s, errno = %d", size, path, errno);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_005: [ On success, SharedMemory_Create and SharedMemory_Open shall set *address (and *size for SharedMemory_Open) to the mapping and return a non-NULL handle. ]*/
+                result->size = size;
+                result->path = path;
+                *address = result->address;
+            }
+
+            /*the mapping stays valid once the descriptor is closed*/
+            (void)close(fd);
+            if (result == NULL)
+            {
+                (void)shm_unlink(path);
+                free(path);
+            }
+        }
+    }
+    return result;
+}
+
+SHARED_MEMORY_HANDLE SharedMemory_Open(const char* name, void** address, size_t* size)
+{
+    SHARED_MEMORY* result;
+    char* path;
+    if (address == NULL || size == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid arg address=%p, size=%p", address, size);
+        result = NULL;
+    }
+    else if ((path = make_path(name)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_006: [ SharedMemory_Open shall map the whole region with shm_open, fstat and mmap on Linux and OpenFileMappingA and MapViewOfFile on Windows. ]*/
+        int fd = shm_open(path, O_RDWR | O_CLOEXEC, 0);
+        if (fd == -1)
+        {
+            /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+            LogError("unable to open shared memory %s, errno = %d", path, errno);
+            result = NULL;
+        }
+        else
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                LogError("unable to get the size of shared memory %s", path);
+                result = NULL;
+            }
+            else if ((result = (SHARED_MEMORY*)malloc(sizeof(SHARED_MEMORY))) == NULL)
+            {
+                LogError("malloc failed");
+            }
+            else
+            {
+                result->size = (size_t)st.st_size;
+                result->path = NULL;
+                if ((result->address = mmap(NULL, result->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+                {
+                    /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                    LogError("unable to map %zu bytes of shared memory %s, errno = %d", result->size, path, errno);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    /*Codes_SRS_SHARED_MEMORY_17_005: [ On success, SharedMemory_Create and SharedMemory_Open shall set *address (and *size for SharedMemory_Open) to the mapping and return a non-NULL handle. ]*/
+                    *address = result->address;
+                    *size = result->size;
+                }
+            }
+            (void)close(fd);
+        }
+        free(path);
+    }
+    return result;
+}
+
+void SharedMemory_Close(SHARED_MEMORY_HANDLE handle)
+{
+    /*Codes_SRS_SHARED_MEMORY_17_007: [ SharedMemory_Close shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_008: [ SharedMemory_Close shall unmap the region, remove its name if it was made by SharedMemory_Create, and free handle. ]*/
+        (void)munmap(handle->address, handle->size);
+        if (handle->path != NULL)
+        {
+            (void)shm_unlink(handle->path);
+            free(handle->path);
+        }
+        free(handle);
+    }
+}
+
+int SharedMemory_Wait(volatile uint32_t* word, uint32_t expected, int timeout_ms)
+{
+    int result;
+#ifdef __linux__
+    /*Codes_SRS_SHARED_MEMORY_17_009: [ SharedMemory_Wait shall sleep while *word equals expected, with a shared (not process private) FUTEX_WAIT on Linux, and return non-zero only if timeout_ms elapsed. ]*/
+    struct timespec timeout;
+    struct timespec* timeout_arg = NULL;
+    if (timeout_ms >= 0)
+    {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        timeout_arg = &timeout;
+    }
+    if (syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, timeout_arg, NULL, 0) == -1 && errno == ETIMEDOUT)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        /*woken, interrupted, or *word had already changed*/
+        result = 0;
+    }
+#else
+    /*Codes_SRS_SHARED_MEMORY_17_010: [ Where the OS cannot sleep on a shared word, SharedMemory_Wait shall check *word every millisecond instead. ]*/
+    int waited = 0;
+    while (*word == expected && (timeout_ms < 0 || waited < timeout_ms))
+    {
+        struct timespec poll_time = { 0, SHARED_MEMORY_POLL_MS * 1000000L };
+        (void)nanosleep(&poll_time, NULL);
+        waited += SHARED_MEMORY_POLL_MS;
+    }
+    result = (*word == expected) ? __LINE__ : 0;
+#endif
+    return result;
+}
+
+void SharedMemory_WakeAll(volatile uint32_t* word)
+{
+#ifdef __linux__
+    /*Codes_SRS_SHARED_MEMORY_17_011: [ SharedMemory_WakeAll shall wake all threads sleeping on word with FUTEX_WAKE on Linux, and do nothing where waiters poll. ]*/
+    (void)syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+#else
+    /*Codes_SRS_SHARED_MEMORY_17_011: [ SharedMemory_WakeAll shall wake all threads sleeping on word with FUTEX_WAKE on Linux, and do nothing where waiters poll. ]*/
+    (void)word;
+#endif
+}
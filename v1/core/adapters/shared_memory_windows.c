@@ -0,0 +1,187 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <windows.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "shared_memory.h"
+
+#define SHARED_MEMORY_NAME_HEAD "Local\\"
+
+/*Windows cannot sleep on a word shared between processes, so waiters check it again after this long*/
+#define SHARED_MEMORY_POLL_MS 1
+
+typedef struct SHARED_MEMORY_TAG
+{
+    void* address;
+    /*the mapping object; a name lasts as long as one process keeps it open*/
+    HANDLE mapping;
+}SHARED_MEMORY;
+
+static char* make_path(const char* name)
+{
+    char* result;
+    if (name == NULL || name[0] == '\0' || strchr(name, '/') != NULL || strchr(name, '\\') != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid shared memory name %s", (name == NULL) ? "NULL" : name);
+        result = NULL;
+    }
+    else if ((result = (char*)malloc(sizeof(SHARED_MEMORY_NAME_HEAD) + strlen(name))) == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else
+    {
+        (void)strcpy(result, SHARED_MEMORY_NAME_HEAD);
+        (void)strcat(result, name);
+    }
+    return result;
+}
+
+SHARED_MEMORY_HANDLE SharedMemory_Create(const char* name, size_t size, void** address)
+{
+    SHARED_MEMORY* result;
+    char* path;
+    if (size == 0 || address == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid arg size=%zu, address=%p", size, address);
+        result = NULL;
+    }
+    else if ((path = make_path(name)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        if ((result = (SHARED_MEMORY*)malloc(sizeof(SHARED_MEMORY))) == NULL)
+        {
+            LogError("malloc failed");
+        }
+        else
+        {
+            /*Codes_SRS_SHARED_MEMORY_17_002: [ SharedMemory_Create shall create the region with shm_open, ftruncate and mmap on Linux and CreateFileMappingA and MapViewOfFile on Windows. ]*/
+            /*pages backed by the paging file start out filled with zeros*/
+            uint64_t size64 = (uint64_t)size;
+            result->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)(size64 & 0xFFFFFFFF), path);
+            if (result->mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_003: [ On Linux, SharedMemory_Create shall replace a region left behind under name; on Windows it shall fail while another process uses the name. ]*/
+                LogError("shared memory %s is in use", path);
+                (void)CloseHandle(result->mapping);
+                result->mapping = NULL;
+            }
+
+            if (result->mapping == NULL ||
+                (result->address = MapViewOfFile(result->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size)) == NULL)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                LogError("unable to create %zu bytes of shared memory %s, error %u", size, path, (unsigned int)GetLastError());
+                if (result->mapping != NULL)
+                {
+                    (void)CloseHandle(result->mapping);
+                }
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_005: [ On success, SharedMemory_Create and SharedMemory_Open shall set *address (and *size for SharedMemory_Open) to the mapping and return a non-NULL handle. ]*/
+                *address = result->address;
+            }
+        }
+        free(path);
+    }
+    return result;
+}
+
+SHARED_MEMORY_HANDLE SharedMemory_Open(const char* name, void** address, size_t* size)
+{
+    SHARED_MEMORY* result;
+    char* path;
+    if (address == NULL || size == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_001: [ SharedMemory_Create and SharedMemory_Open shall return NULL if name is NULL, empty or contains a '/', or if address or size is NULL. ]*/
+        LogError("invalid arg address=%p, size=%p", address, size);
+        result = NULL;
+    }
+    else if ((path = make_path(name)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        if ((result = (SHARED_MEMORY*)malloc(sizeof(SHARED_MEMORY))) == NULL)
+        {
+            LogError("malloc failed");
+        }
+        else
+        {
+            MEMORY_BASIC_INFORMATION info;
+            /*Codes_SRS_SHARED_MEMORY_17_006: [ SharedMemory_Open shall map the whole region with shm_open, fstat and mmap on Linux and OpenFileMappingA and MapViewOfFile on Windows. ]*/
+            result->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+            if (result->mapping == NULL ||
+                (result->address = MapViewOfFile(result->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)) == NULL ||
+                VirtualQuery(result->address, &info, sizeof(info)) == 0)
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_004: [ SharedMemory_Create and SharedMemory_Open shall return NULL if the region cannot be created, opened or mapped. ]*/
+                LogError("unable to open shared memory %s, error %u", path, (unsigned int)GetLastError());
+                if (result->mapping != NULL)
+                {
+                    if (result->address != NULL)
+                    {
+                        (void)UnmapViewOfFile(result->address);
+                    }
+                    (void)CloseHandle(result->mapping);
+                }
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_SHARED_MEMORY_17_005: [ On success, SharedMemory_Create and SharedMemory_Open shall set *address (and *size for SharedMemory_Open) to the mapping and return a non-NULL handle. ]*/
+                /*the view is rounded up to whole pages, which the creator sized its region within*/
+                *address = result->address;
+                *size = info.RegionSize;
+            }
+        }
+        free(path);
+    }
+    return result;
+}
+
+void SharedMemory_Close(SHARED_MEMORY_HANDLE handle)
+{
+    /*Codes_SRS_SHARED_MEMORY_17_007: [ SharedMemory_Close shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_17_008: [ SharedMemory_Close shall unmap the region, remove its name if it was made by SharedMemory_Create, and free handle. ]*/
+        /*the name goes away once every process has closed the mapping*/
+        (void)UnmapViewOfFile(handle->address);
+        (void)CloseHandle(handle->mapping);
+        free(handle);
+    }
+}
+
+int SharedMemory_Wait(volatile uint32_t* word, uint32_t expected, int timeout_ms)
+{
+    int waited = 0;
+    /*Codes_SRS_SHARED_MEMORY_17_010: [ Where the OS cannot sleep on a shared word, SharedMemory_Wait shall check *word every millisecond instead. ]*/
+    while (*word == expected && (timeout_ms < 0 || waited < timeout_ms))
+    {
+        Sleep(SHARED_MEMORY_POLL_MS);
+        waited += SHARED_MEMORY_POLL_MS;
+    }
+    return (*word == expected) ? __LINE__ : 0;
+}
+
+void SharedMemory_WakeAll(volatile uint32_t* word)
+{
+    /*Codes_SRS_SHARED_MEMORY_17_011: [ SharedMemory_WakeAll shall wake all threads sleeping on word with FUTEX_WAKE on Linux, and do nothing where waiters poll. ]*/
+    (void)word;
+}
@@ -30,6 +30,44 @@ extern "C"
 #include <stddef.h>
 #endif
 
+#define BROKER_OVERFLOW_POLICY_VALUES \
+    BROKER_OVERFLOW_DROP_NEWEST, \
+    BROKER_OVERFLOW_DROP_OLDEST, \
+    BROKER_OVERFLOW_BLOCK, \
+    BROKER_OVERFLOW_CONFLATE
+
+/** @brief    Enumeration describing what a link does with a message
+*             published while its queue is full.
+*
+*   @details  #BROKER_OVERFLOW_DROP_NEWEST discards the message being
+*             published. #BROKER_OVERFLOW_DROP_OLDEST discards the message
+*             that has waited longest. #BROKER_OVERFLOW_BLOCK makes the
+*             publisher wait for room; a module must not block on a link
+*             that leads back to itself. #BROKER_OVERFLOW_CONFLATE replaces
+*             any waiting message that has the same value for the link's
+*             conflate key, full or not, and otherwise discards the oldest.
+*/
+DEFINE_ENUM(BROKER_OVERFLOW_POLICY, BROKER_OVERFLOW_POLICY_VALUES);
+
+/** @brief    Queue a link keeps for messages its sink has not received yet.
+*/
+typedef struct BROKER_LINK_QUEUE_TAG {
+    /** @brief    Number of messages that may wait on the link. 0 means the
+    *             link has no queue of its own and messages wait on the
+    *             sink module's queue.
+    */
+    size_t capacity;
+    /** @brief    The #BROKER_OVERFLOW_POLICY applied once @c capacity
+    *             messages are waiting.
+    */
+    BROKER_OVERFLOW_POLICY overflow;
+    /** @brief    Name of the message property whose value identifies
+    *             messages that replace each other (#BROKER_OVERFLOW_CONFLATE
+    *             only).
+    */
+    const char* conflate_key;
+} BROKER_LINK_QUEUE;
+
 /** @brief    Link Data with #MODULE_HANDLE for source and sink. 
 */
 typedef struct BROKER_LINK_DATA_TAG {
@@ -41,6 +79,23 @@ typedef struct BROKER_LINK_DATA_TAG {
     MODULE_HANDLE module_sink_handle;
 } BROKER_LINK_DATA;
 
+/** @brief    Link Data along with how the broker delivers messages on the
+*             link.
+*/
+typedef struct BROKER_LINK_DATA_EX_TAG {
+    /** @brief    The source and sink of the link.
+    */
+    BROKER_LINK_DATA base;
+    /** @brief    The #BROKER_LINK_QUEUE of the link, or @c NULL for none.
+    */
+    const BROKER_LINK_QUEUE* queue;
+    /** @brief    Expression on message properties, in the grammar of
+    *             link_filter.h, that a message must match to be delivered
+    *             over the link, or @c NULL to deliver every message.
+    */
+    const char* filter;
+} BROKER_LINK_DATA_EX;
+
 #define BROKER_RESULT_VALUES \
     BROKER_OK, \
     BROKER_ERROR, \
@@ -49,16 +104,64 @@ typedef struct BROKER_LINK_DATA_TAG {
     BROKER_INVALIDARG
 
 /** @brief    Enumeration describing the result of ::Broker_Publish, 
-*            ::Broker_AddModule, ::Broker_AddLink, and ::Broker_RemoveModule.
+*            ::Broker_AddModule, ::Broker_AddLink, ::Broker_AddLinkEx, and
+*            ::Broker_RemoveModule.
 */
 DEFINE_ENUM(BROKER_RESULT, BROKER_RESULT_VALUES);
 
+#define BROKER_ENGINE_VALUES \
+    BROKER_ENGINE_NANOMSG, \
+    BROKER_ENGINE_RING, \
+    BROKER_ENGINE_POOL
+
+/** @brief    Enumeration selecting how a broker delivers messages to modules.
+*
+*   @details  #BROKER_ENGINE_NANOMSG hands each message to a module over an
+*             in-process nanomsg socket. #BROKER_ENGINE_RING pushes it straight
+*             into a bounded lock-free queue owned by the module, keeping
+*             publishers off any lock in the common case. Both give every
+*             module a thread of its own. #BROKER_ENGINE_POOL uses the same
+*             queues, but modules share a fixed pool of worker threads that
+*             steal work from each other; a module still receives one message
+*             at a time. Links with #BROKER_OVERFLOW_BLOCK are not supported
+*             on #BROKER_ENGINE_POOL.
+*/
+DEFINE_ENUM(BROKER_ENGINE, BROKER_ENGINE_VALUES);
+
+/** @brief    Configuration used by ::Broker_CreateWithConfig.
+*/
+typedef struct BROKER_CONFIG_TAG {
+    /** @brief    The #BROKER_ENGINE used to deliver messages.
+    */
+    BROKER_ENGINE engine;
+
+    /** @brief    Number of messages each module may have waiting before
+    *             new ones are dropped. 0 picks the engine's default, which
+    *             is unbounded but for socket buffers on #BROKER_ENGINE_NANOMSG.
+    */
+    size_t queue_capacity;
+
+    /** @brief    Number of threads shared by all modules on
+    *             #BROKER_ENGINE_POOL. 0 starts one per processor. Ignored by
+    *             the other engines.
+    */
+    size_t worker_count;
+} BROKER_CONFIG;
+
 /** @brief        Creates a new message broker.
 *   
 *    @return        A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
 */
 GATEWAY_EXPORT BROKER_HANDLE Broker_Create(void);
 
+/** @brief        Creates a new message broker using the given engine.
+*
+*    @param        config    The #BROKER_CONFIG describing the broker.
+*
+*    @return        A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
+*/
+GATEWAY_EXPORT BROKER_HANDLE Broker_CreateWithConfig(const BROKER_CONFIG* config);
+
 /** @brief        Increments the reference count of a message broker.
 *
 *    @details    This function will simply increment the internal reference
@@ -96,6 +199,25 @@ GATEWAY_EXPORT void Broker_DecRef(BROKER_HANDLE broker);
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message);
 
+/** @brief        Publishes several messages to the message broker at once.
+*
+*    @details    Same as calling ::Broker_Publish for each message in turn,
+*                but the routing snapshot is read once and, on the nanomsg
+*                engine, each sink is sent the whole batch in a single
+*                buffer. Sinks receive the messages in order.
+*
+*    @param        broker    The #BROKER_HANDLE onto which the messages will be
+*                        published.
+*    @param        source    The #MODULE_HANDLE from which the messages will be
+*                        published.
+*    @param        messages  The #MESSAGE_HANDLE array of messages to publish.
+*                        The caller keeps ownership of the messages.
+*    @param        count     The number of messages in @c messages.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE* messages, size_t count);
+
 /** @brief        Adds a module to the message broker.
 *
 *    @details    For details about threading with regard to the message broker
@@ -135,6 +257,18 @@ GATEWAY_EXPORT BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MOD
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
 
+/** @brief        Adds a route with a queue or a filter to the message broker.
+*                The route is removed with ::Broker_RemoveLink.
+*
+*    @param        broker          The #BROKER_HANDLE onto which the link will be
+*                                added.
+*    @param        link            The #BROKER_LINK_DATA_EX for the link that will
+*                                be added to this message broker.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddLinkEx(BROKER_HANDLE broker, const BROKER_LINK_DATA_EX* link);
+
 /** @brief        Removes a route from the message broker.
 *
 *    @param        broker    The #BROKER_HANDLE from which the link will be removed.
@@ -144,6 +278,19 @@ GATEWAY_EXPORT BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_L
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
 
+/** @brief        Reads how many messages a link has lost.
+*
+*    @details    A message is lost when the link's overflow policy discards
+*                it, or when it cannot be handed to the sink module.
+*
+*    @param        broker    The #BROKER_HANDLE the link belongs to.
+*    @param        link      The #BROKER_LINK_DATA of the link.
+*    @param        dropped   Receives the number of messages lost so far.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetLinkDropCount(BROKER_HANDLE broker, const BROKER_LINK_DATA* link, size_t* dropped);
+
 /** @brief      Disposes of resources allocated by a message broker.
 *
 *    @param      broker  The #BROKER_HANDLE to be destroyed.
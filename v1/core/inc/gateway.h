@@ -27,7 +27,9 @@ extern "C"
 
 #define GATEWAY_CONNECTION_ID_MAX           NN_SOCKADDR_MAX
 #define GATEWAY_MESSAGE_VERSION_1           0x01
-#define GATEWAY_MESSAGE_VERSION_CURRENT     GATEWAY_MESSAGE_VERSION_1
+#define GATEWAY_MESSAGE_VERSION_2           0x02
+#define GATEWAY_MESSAGE_VERSION_3           0x03
+#define GATEWAY_MESSAGE_VERSION_CURRENT     GATEWAY_MESSAGE_VERSION_3
 
 #define GATEWAY_ADD_LINK_RESULT_VALUES \
     GATEWAY_ADD_LINK_SUCCESS, \
@@ -67,6 +69,26 @@ typedef struct GATEWAY_LINK_ENTRY_TAG
     const char* module_sink;
 } GATEWAY_LINK_ENTRY;
 
+/** @brief      Struct representing a single link for a gateway, along with
+ *              how the message broker delivers messages on it.
+ */
+typedef struct GATEWAY_LINK_ENTRY_EX_TAG
+{
+    /** @brief  The source and sink of the link. */
+    GATEWAY_LINK_ENTRY base;
+
+    /** @brief  The queue messages wait on before the sink receives them.
+     *          A zero capacity delivers them directly.
+     */
+    BROKER_LINK_QUEUE queue;
+
+    /** @brief  Expression on message properties a message must match to be
+     *          delivered to the sink, see link_filter.h. @c NULL delivers
+     *          every message.
+     */
+    const char* filter;
+} GATEWAY_LINK_ENTRY_EX;
+
 /** @brief      Struct representing a particular gateway. */
 typedef struct GATEWAY_HANDLE_DATA_TAG* GATEWAY_HANDLE;
 
@@ -110,6 +132,12 @@ typedef struct GATEWAY_PROPERTIES_DATA_TAG
 
     /** @brief  Vector of #GATEWAY_LINK_ENTRY objects. */
     VECTOR_HANDLE gateway_links;
+
+    /** @brief  The (possibly @c NULL) configuration of the gateway's message
+     *          broker, which selects its #BROKER_ENGINE. The broker is created
+     *          with ::Broker_Create when this is @c NULL.
+     */
+    const BROKER_CONFIG* broker_config;
 } GATEWAY_PROPERTIES;
 
 /** @brief      Creates a gateway using a JSON configuration file as input
@@ -252,6 +280,18 @@ GATEWAY_EXPORT int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *mod
  */
 GATEWAY_EXPORT GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink);
 
+/** @brief      Adds a link with a queue or a filter to a gateway message
+ *              broker. The link is removed with ::Gateway_RemoveLink.
+ *
+ *  @param      gw          Pointer to a #GATEWAY_HANDLE from which link is
+ *                          going to be added.
+ *
+ *  @param      entryLink   Pointer to a #GATEWAY_LINK_ENTRY_EX to be added.
+ *
+ *  @return     A GATEWAY_ADD_LINK_RESULT with the operation result.
+ */
+GATEWAY_EXPORT GATEWAY_ADD_LINK_RESULT Gateway_AddLinkEx(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY_EX* entryLink);
+
 /** @brief      Remove a link from a gateway message broker.
  *
  *  @param      gw          Pointer to a #GATEWAY_HANDLE from which link is
@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       link_filter.h
+*   @brief      Predicate on message properties that decides whether a link
+*               delivers a message.
+*
+*   @details    A filter is compiled once from an expression such as
+*               <tt>properties.source == "bleTelemetry" &&
+*               properties.macAddress in ["01:02:03:03:02:01", "AA:BB:CC:DD:EE:FF"]</tt>
+*               and then evaluated against every message published on the
+*               link. The grammar is:
+*
+*                   expression := and ( "||" and )*
+*                   and        := unary ( "&&" unary )*
+*                   unary      := "!" unary | "(" expression ")" | test
+*                   test       := property [ ( "==" | "!=" ) string | "in" "[" string ( "," string )* "]" ]
+*                   property   := "properties." name | "properties[" string "]"
+*
+*               A property on its own is true when the message has it.
+*               Strings are double quoted, with \" and \\ as the only escapes.
+*/
+
+#ifndef LINK_FILTER_H
+#define LINK_FILTER_H
+
+#include "message.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#else
+#include <stdbool.h>
+#endif
+
+typedef struct LINK_FILTER_TAG* LINK_FILTER_HANDLE;
+
+/* compiles expression, NULL if it is not a valid filter */
+MOCKABLE_FUNCTION(, LINK_FILTER_HANDLE, LINK_FILTER_create, const char*, expression);
+
+/* destruction */
+MOCKABLE_FUNCTION(, void, LINK_FILTER_destroy, LINK_FILTER_HANDLE, handle);
+
+/* evaluation, safe from any thread */
+MOCKABLE_FUNCTION(, bool, LINK_FILTER_matches, LINK_FILTER_HANDLE, handle, MESSAGE_HANDLE, message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_FILTER_H */
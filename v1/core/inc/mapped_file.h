@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       mapped_file.h
+*   @brief      Maps a whole file into memory, read only, so that it can be
+*               the content of a message without being copied.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+typedef struct MAPPED_FILE_TAG* MAPPED_FILE_HANDLE;
+
+/* maps the file at path; *data and *size describe the mapping, *data is NULL for an empty file */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MAPPED_FILE_HANDLE, MappedFile_Open, const char*, path, const unsigned char**, data, size_t*, size);
+
+/* unmaps the file; does nothing if handle is NULL */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MappedFile_Close, MAPPED_FILE_HANDLE, handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MAPPED_FILE_H
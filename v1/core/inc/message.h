@@ -8,8 +8,10 @@
  *              message broker.
  *
  *  @details    A message essentially has two components:
- *              - Properties represented as key/value pairs where both the
- *                key and value are strings
+ *              - Properties represented as key/value pairs where the key is
+ *                a string and the value is a string or, for a message
+ *                created with #Message_CreateTyped, a number, a timestamp
+ *                or bytes
  *              - The content of the message which is simply a memory buffer
  *                (a @c BUFFER_HANDLE)
  *
@@ -42,7 +44,9 @@
 #endif
 
 #define GATEWAY_MESSAGE_VERSION_1           0x01
-#define GATEWAY_MESSAGE_VERSION_CURRENT     GATEWAY_MESSAGE_VERSION_1
+#define GATEWAY_MESSAGE_VERSION_2           0x02
+#define GATEWAY_MESSAGE_VERSION_3           0x03
+#define GATEWAY_MESSAGE_VERSION_CURRENT     GATEWAY_MESSAGE_VERSION_3
 
 /** @brief  Struct representing a particular message. */
 typedef struct MESSAGE_HANDLE_DATA_TAG* MESSAGE_HANDLE;
@@ -87,6 +91,220 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
     MAP_HANDLE sourceProperties;
 }MESSAGE_BUFFER_CONFIG;
 
+/** @brief  Releases a byte array handed over to
+ *          #Message_CreateFromOwnedByteArray, once the message built on it
+ *          is destroyed.
+ */
+typedef void(*MESSAGE_BYTE_ARRAY_RELEASE)(void* context);
+
+/** @brief  Property names every message carries in an interned form, so
+ *          that #Message_GetPropertyById finds them without comparing
+ *          strings. The names match those in modules/common/messageproperties.h.
+ */
+typedef enum MESSAGE_PROPERTY_ID_TAG
+{
+    /** @brief  "source" */
+    MESSAGE_PROPERTY_SOURCE,
+    /** @brief  "macAddress" */
+    MESSAGE_PROPERTY_MAC_ADDRESS,
+    /** @brief  "deviceName" */
+    MESSAGE_PROPERTY_DEVICE_NAME,
+    /** @brief  "deviceKey" */
+    MESSAGE_PROPERTY_DEVICE_KEY,
+    /** @brief  "iotHubMessageId" */
+    MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID,
+    /** @brief  "iotHubMessageDeliveryStatus" */
+    MESSAGE_PROPERTY_IOTHUB_DELIVERY_STATUS,
+    /** @brief  "bleControllerIndex" */
+    MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX,
+    /** @brief  "timestamp" */
+    MESSAGE_PROPERTY_TIMESTAMP,
+    /** @brief  "characteristicUUID" */
+    MESSAGE_PROPERTY_CHARACTERISTIC_UUID,
+    /** @brief  Number of interned names, not a property. */
+    MESSAGE_PROPERTY_ID_COUNT
+}MESSAGE_PROPERTY_ID;
+
+/** @brief  A property #Message_Derive sets on the derived message, adding it
+ *          or replacing the parent's value.
+ */
+typedef struct MESSAGE_PROPERTY_UPDATE_TAG
+{
+    /** @brief  Name of the property; must not be @c NULL. */
+    const char* name;
+
+    /** @brief  Value of the property; must not be @c NULL. */
+    const char* value;
+}MESSAGE_PROPERTY_UPDATE;
+
+/** @brief  The type of a property value. */
+typedef enum MESSAGE_PROPERTY_TYPE_TAG
+{
+    /** @brief  A zero terminated UTF8 string. */
+    MESSAGE_PROPERTY_TYPE_STRING,
+    /** @brief  A signed 64 bit integer. */
+    MESSAGE_PROPERTY_TYPE_INT64,
+    /** @brief  A double precision floating point number. */
+    MESSAGE_PROPERTY_TYPE_DOUBLE,
+    /** @brief  An array of bytes. */
+    MESSAGE_PROPERTY_TYPE_BYTES,
+    /** @brief  Milliseconds since 1970-01-01T00:00:00Z. */
+    MESSAGE_PROPERTY_TYPE_TIMESTAMP,
+    /** @brief  Number of types, not a type. */
+    MESSAGE_PROPERTY_TYPE_COUNT
+}MESSAGE_PROPERTY_TYPE;
+
+/** @brief  A property value together with its type. */
+typedef struct MESSAGE_PROPERTY_VALUE_TAG
+{
+    /** @brief  Which member of @c value holds the value. */
+    MESSAGE_PROPERTY_TYPE type;
+
+    union
+    {
+        /** @brief  #MESSAGE_PROPERTY_TYPE_STRING; must not be @c NULL. */
+        const char* string;
+
+        /** @brief  #MESSAGE_PROPERTY_TYPE_INT64. */
+        int64_t integer;
+
+        /** @brief  #MESSAGE_PROPERTY_TYPE_DOUBLE. */
+        double real;
+
+        /** @brief  #MESSAGE_PROPERTY_TYPE_BYTES; @c buffer may be @c NULL only
+         *          when @c size is zero.
+         */
+        struct
+        {
+            const unsigned char* buffer;
+            size_t size;
+        } bytes;
+
+        /** @brief  #MESSAGE_PROPERTY_TYPE_TIMESTAMP, in milliseconds since
+         *          1970-01-01T00:00:00Z.
+         */
+        int64_t timestamp;
+    } value;
+}MESSAGE_PROPERTY_VALUE;
+
+/** @brief  A property of a message created with #Message_CreateTyped. */
+typedef struct MESSAGE_TYPED_PROPERTY_TAG
+{
+    /** @brief  Name of the property; must not be @c NULL. */
+    const char* name;
+
+    /** @brief  Value of the property. */
+    MESSAGE_PROPERTY_VALUE value;
+}MESSAGE_TYPED_PROPERTY;
+
+/** @brief  Struct defining the configuration of a message whose properties
+ *          may have values other than strings.
+ *
+ *  @details    This is a separate structure, rather than new fields of
+ *              #MESSAGE_CONFIG, so that code filling a #MESSAGE_CONFIG field
+ *              by field keeps working unchanged.
+ */
+typedef struct MESSAGE_TYPED_CONFIG_TAG
+{
+    /** @brief  Specifies the size of the buffer pointed at by @c source. This
+     *          can be zero when the message has only properties and no
+     *          content. It is an error for the size to be greater than zero
+     *          when @c source is equal to @c NULL.
+     */
+    size_t size;
+
+    /** @brief  Pointer to the buffer containing the data that will be the
+     *          content of this message. This can be @c NULL when @c size is
+     *          zero.
+     */
+    const unsigned char* source;
+
+    /** @brief  The properties of the message. A name must not repeat. This
+     *          can be @c NULL when @c propertyCount is zero.
+     */
+    const MESSAGE_TYPED_PROPERTY* properties;
+
+    /** @brief  Number of entries in @c properties. */
+    size_t propertyCount;
+}MESSAGE_TYPED_CONFIG;
+
+/** @brief  Handle to a reference counted, immutable set of properties that
+ *          any number of messages can share without copying it.
+ */
+typedef struct MESSAGE_PROPERTIES_TAG* PROPERTY_SET_HANDLE;
+
+/** @brief  Struct defining the configuration of a message whose properties
+ *          are an existing #PROPERTY_SET_HANDLE.
+ */
+typedef struct MESSAGE_SHARED_CONFIG_TAG
+{
+    /** @brief  Specifies the size of the buffer pointed at by @c source. This
+     *          can be zero when the message has only properties and no
+     *          content. It is an error for the size to be greater than zero
+     *          when @c source is equal to @c NULL.
+     */
+    size_t size;
+
+    /** @brief  Pointer to the buffer containing the data that will be the
+     *          content of this message. This can be @c NULL when @c size is
+     *          zero.
+     */
+    const unsigned char* source;
+
+    /** @brief  The properties of the message. The message takes a reference
+     *          to them; this field must not be @c NULL.
+     */
+    PROPERTY_SET_HANDLE properties;
+}MESSAGE_SHARED_CONFIG;
+
+/** @brief  Struct defining the configuration of a message whose content
+ *          stays in memory owned by the caller, such as a mapped file.
+ */
+typedef struct MESSAGE_EXTERNAL_CONFIG_TAG
+{
+    /** @brief  Specifies the size of the buffer pointed at by @c source. It
+     *          is an error for the size to be greater than zero when
+     *          @c source is equal to @c NULL.
+     */
+    size_t size;
+
+    /** @brief  The content of the message. It is not copied, and must not
+     *          change until @c release is called.
+     */
+    const unsigned char* source;
+
+    /** @brief  Called with @c context once the last reference to the message
+     *          is destroyed. This can be @c NULL when @c source outlives
+     *          every message.
+     */
+    MESSAGE_BYTE_ARRAY_RELEASE release;
+
+    /** @brief  Passed to @c release. */
+    void* context;
+
+    /** @brief  The properties of the message. The message takes a reference
+     *          to them; this field must not be @c NULL.
+     */
+    PROPERTY_SET_HANDLE properties;
+}MESSAGE_EXTERNAL_CONFIG;
+
+/** @brief  Struct describing the content of a message without a copy of it,
+ *          filled by #Message_GetContentView.
+ */
+typedef struct MESSAGE_CONTENT_VIEW_TAG
+{
+    /** @brief  The content of the message. */
+    const unsigned char* buffer;
+
+    /** @brief  The size of @c buffer. */
+    size_t size;
+
+    /** @brief  The reference to the message that keeps @c buffer valid;
+     *          #Message_ReleaseContentView destroys it.
+     */
+    MESSAGE_HANDLE owner;
+}MESSAGE_CONTENT_VIEW;
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 /** @brief      Creates a new reference counted message from a #MESSAGE_CONFIG
@@ -105,6 +323,132 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG *, cfg);
 
+/** @brief      Creates a new reference counted message from a
+ *              #MESSAGE_TYPED_CONFIG structure with the reference count
+ *              initialized to 1.
+ *
+ *  @details    The content, names, strings and bytes are copied. Numbers
+ *              and timestamps are kept as they are: they are carried in
+ *              binary in the serialized message, and are only turned into
+ *              strings when one is asked for through #Message_GetProperty,
+ *              #Message_GetPropertyById or #Message_GetProperties. Integers
+ *              are then written in decimal, doubles with as many digits as
+ *              it takes to read them back exactly, bytes in lowercase
+ *              hexadecimal and timestamps in ISO 8601, in UTC with
+ *              milliseconds (e.g. "2016-11-21T13:30:05.123Z").
+ *
+ *  @param      cfg     Pointer to a #MESSAGE_TYPED_CONFIG structure.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateTyped, const MESSAGE_TYPED_CONFIG *, cfg);
+
+/** @brief      Creates a property set from a collection of string key/value
+ *              pairs, for use with #Message_CreateWithPropertySet.
+ *
+ *  @details    The keys and values are copied. A producer that publishes
+ *              many messages with the same properties builds the set once
+ *              and hands it to every message, instead of copying a @c MAP
+ *              into each of them.
+ *
+ *  @param      properties  The properties; must not be @c NULL.
+ *
+ *  @return     A non-NULL #PROPERTY_SET_HANDLE with the reference count set
+ *              to 1, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT PROPERTY_SET_HANDLE, PropertySet_Create, MAP_HANDLE, properties);
+
+/** @brief      Creates a property set whose values may be numbers, bytes or
+ *              timestamps, as described for #Message_CreateTyped.
+ *
+ *  @param      properties  The properties; may be @c NULL when @c count is
+ *                          zero. A name must not repeat.
+ *  @param      count       Number of entries in @c properties.
+ *
+ *  @return     A non-NULL #PROPERTY_SET_HANDLE with the reference count set
+ *              to 1, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT PROPERTY_SET_HANDLE, PropertySet_CreateTyped, const MESSAGE_TYPED_PROPERTY*, properties, size_t, count);
+
+/** @brief      Takes another reference to a property set.
+ *
+ *  @param      propertySet The set to clone.
+ *
+ *  @return     @c propertySet, or @c NULL if it was @c NULL.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT PROPERTY_SET_HANDLE, PropertySet_Clone, PROPERTY_SET_HANDLE, propertySet);
+
+/** @brief      Releases a reference to a property set; the set is freed once
+ *              neither its creator nor any message refers to it.
+ *
+ *  @param      propertySet The set to release.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, PropertySet_Destroy, PROPERTY_SET_HANDLE, propertySet);
+
+/** @brief      Creates a new reference counted message from a
+ *              #MESSAGE_SHARED_CONFIG structure with the reference count
+ *              initialized to 1.
+ *
+ *  @details    The content is copied; the property set is not. The message
+ *              holds a reference to it, so the caller may destroy its own
+ *              reference at any time. Messages sharing a set also share the
+ *              @c CONSTMAP that #Message_GetProperties builds from it.
+ *
+ *  @param      cfg     Pointer to a #MESSAGE_SHARED_CONFIG structure.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateWithPropertySet, const MESSAGE_SHARED_CONFIG *, cfg);
+
+/** @brief      Gets the property set of a message, so that it can be given
+ *              to other messages with #Message_CreateWithPropertySet.
+ *
+ *  @param      message The message whose properties are wanted.
+ *
+ *  @return     A new reference to the property set of @c message, to be
+ *              released with #PropertySet_Destroy, or @c NULL if
+ *              @c message is @c NULL.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT PROPERTY_SET_HANDLE, Message_GetPropertySet, MESSAGE_HANDLE, message);
+
+/** @brief      Creates a new reference counted message whose content is
+ *              memory owned by the caller, with the reference count
+ *              initialized to 1.
+ *
+ *  @details    The content is not copied: every clone of the message, in
+ *              every module it reaches, reads the same memory, which
+ *              @c release frees once the last of them is destroyed. On
+ *              failure @c source still belongs to the caller and @c release
+ *              is not called. The serialized form of the message, built for
+ *              #Message_ToByteArray and #Message_GetByteArray, and the handle
+ *              returned by #Message_GetContentHandle are copies.
+ *
+ *  @param      cfg     Pointer to a #MESSAGE_EXTERNAL_CONFIG structure.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateWithExternalContent, const MESSAGE_EXTERNAL_CONFIG *, cfg);
+
+/** @brief      Creates a new reference counted message whose content is a
+ *              file, mapped into memory rather than read.
+ *
+ *  @details    The file is mapped read only and unmapped when the last
+ *              reference to the message is destroyed; see
+ *              #Message_CreateWithExternalContent. The file must not be
+ *              truncated while it is mapped.
+ *
+ *  @param      path        Path of the file.
+ *  @param      properties  The properties of the message; must not be
+ *                          @c NULL. The message takes a reference to them.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromMappedFile, const char*, path, PROPERTY_SET_HANDLE, properties);
+
 /** @brief      Creates a new reference counted message from a byte array
  *              containing the serialized form of a message.
  *
@@ -119,11 +463,43 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Create, const MESSAGE
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char *, source, int32_t, size);
 
+/** @brief      Creates a new reference counted message on top of a byte array
+ *              containing the serialized form of a message, without copying
+ *              it.
+ *
+ *  @details    On success the message takes ownership of @c source: its
+ *              content and property strings point into the array, which is
+ *              also returned by #Message_GetByteArray. @c release is called
+ *              with @c context once the last reference to the message is
+ *              destroyed. On failure @c source still belongs to the caller.
+ *              #Message_GetContentHandle returns a copy of the content for
+ *              such messages, since a @c CONSTBUFFER_HANDLE cannot refer to
+ *              memory it does not own; #Message_GetContentView does not
+ *              copy it.
+ *
+ *  @param      source  Pointer to a byte array; must not change while the
+ *                      message lives.
+ *  @param      size    size in bytes of the array
+ *  @param      release Function that frees @c source.
+ *  @param      context Argument passed to @c release.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromOwnedByteArray, const unsigned char *, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context);
+
 /** @brief      Creates a byte array representation of a MESSAGE_HANDLE. 
  *
  *  @details    The byte array created can be used with function
  *              #Message_CreateFromByteArray to reproduce the message. If buffer
  *              is not set, this function will return the serialization size.
+ *              Messages are written in #GATEWAY_MESSAGE_VERSION_2 of the
+ *              format (see proxy/message_format.md), where lengths are
+ *              varints and the names of #MESSAGE_PROPERTY_ID are interned,
+ *              or in #GATEWAY_MESSAGE_VERSION_3, which also carries the type
+ *              of every value, if they have any property that is not a
+ *              string. #Message_CreateFromByteArray and
+ *              #Message_CreateFromOwnedByteArray read all versions.
  *
  *  @param      messageHandle   A #MESSAGE_HANDLE. Must not be NULL.
  *  @param      buf             A pointer to a byte array in memory, or NULL.
@@ -136,6 +512,46 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromByteArray,
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buf, int32_t, size);
 
+/** @brief      Creates a byte array representation of a MESSAGE_HANDLE in
+ *              a given version of the format.
+ *
+ *  @details    For peers that only read an older version, such as a module
+ *              host process built before #GATEWAY_MESSAGE_VERSION_2. Versions
+ *              before #GATEWAY_MESSAGE_VERSION_3 carry every value as a
+ *              string, so values that are not strings are written as
+ *              #Message_GetProperty returns them. The bytes are not kept with
+ *              the message unless the version is
+ *              #GATEWAY_MESSAGE_VERSION_CURRENT.
+ *
+ *  @param      messageHandle   A #MESSAGE_HANDLE. Must not be NULL.
+ *  @param      version         The version to write, from
+ *                              #GATEWAY_MESSAGE_VERSION_1 to
+ *                              #GATEWAY_MESSAGE_VERSION_CURRENT.
+ *  @param      buf             A pointer to a byte array in memory, or NULL.
+ *  @param      size            An int32_t that specifies the size of buf.
+ *
+ *  @return     The same as #Message_ToByteArray.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArrayVersion, MESSAGE_HANDLE, messageHandle, uint8_t, version, unsigned char *, buf, int32_t, size);
+
+/** @brief      Gets the serialized form of a message.
+ *
+ *  @details    The bytes are the same #Message_ToByteArray produces. A message
+ *              never changes, so they are computed on the first call, by
+ *              whichever thread gets there first, and kept with the message.
+ *              Every later call, and every #Message_ToByteArray, copies from
+ *              them instead of encoding the message again. The buffer is
+ *              borrowed: it stays valid for as long as the caller holds a
+ *              reference to the message, and must not be freed. Take a
+ *              #Message_Clone to keep it past that.
+ *
+ *  @param      message     A #MESSAGE_HANDLE.
+ *
+ *  @return     A const pointer to the serialized bytes and their size, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER*, Message_GetByteArray, MESSAGE_HANDLE, message);
+
 /** @brief      Creates a new message from a @c CONSTBUFFER source and
  *              @c MAP_HANDLE.
  *
@@ -165,10 +581,38 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromBuffer, con
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 
+/** @brief      Creates a new message with the content and properties of
+ *              @c message, except for a few properties that are added,
+ *              replaced or removed.
+ *
+ *  @details    Nothing is copied but the added names and values: the new
+ *              message shares the content of @c message and points at the
+ *              strings of its unchanged properties, keeping a reference to
+ *              them. The cost of deriving a message grows with the number
+ *              of changes and not with the size of the message. @c message
+ *              itself is unchanged and may be destroyed at any time.
+ *
+ *  @param      message     The #MESSAGE_HANDLE to derive from.
+ *  @param      adds        The properties to set, or @c NULL when
+ *                          @c addCount is zero. A name must not repeat.
+ *  @param      addCount    Number of entries in @c adds.
+ *  @param      removes     Names of the properties to drop, or @c NULL when
+ *                          @c removeCount is zero. Names @c message does
+ *                          not have are ignored.
+ *  @param      removeCount Number of entries in @c removes.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the new message, with the
+ *              reference count set to 1, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Derive, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_UPDATE*, adds, size_t, addCount, const char* const*, removes, size_t, removeCount);
+
 /** @brief      Gets the properties of a message.
  *
  *  @details    The returned @c CONSTMAP handle should be destroyed when no 
- *              longer needed.
+ *              longer needed. Messages do not keep their properties in a
+ *              @c CONSTMAP; one is built on the first call and shared by
+ *              later ones. #Message_GetProperty and #Message_GetPropertyById
+ *              are cheaper when only a few values are needed.
  *
  *  @param      message     The #MESSAGE_HANDLE from which properties will be
  *                          fetched.
@@ -179,6 +623,66 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the value of one property of a message.
+ *
+ *  @details    Unlike #Message_GetProperties this does not need to be
+ *              released; the value stays valid for as long as the caller
+ *              holds the message. A value that is not a string is turned
+ *              into one on the first call and kept with the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE whose property is wanted.
+ *  @param      name        The name of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message does not
+ *              have it or either argument is @c NULL.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name);
+
+/** @brief      Gets the value of a property with an interned name, in
+ *              constant time.
+ *
+ *  @details    The value stays valid for as long as the caller holds the
+ *              message. As with #Message_GetProperty, a value that is not a
+ *              string is turned into one on the first call.
+ *
+ *  @param      message     The #MESSAGE_HANDLE whose property is wanted.
+ *  @param      id          The #MESSAGE_PROPERTY_ID of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message does not
+ *              have it, @c message is @c NULL or @c id is out of range.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id);
+
+/** @brief      Gets the value of one property of a message, with its type.
+ *
+ *  @details    Unlike #Message_GetProperty this never turns a number,
+ *              timestamp or bytes into a string. Properties of messages
+ *              that were not created with #Message_CreateTyped are all
+ *              strings. The value stays valid for as long as the caller
+ *              holds the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE whose property is wanted.
+ *  @param      name        The name of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message does not
+ *              have it or either argument is @c NULL.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MESSAGE_PROPERTY_VALUE*, Message_GetTypedProperty, MESSAGE_HANDLE, message, const char*, name);
+
+/** @brief      Gets the value of a property with an interned name, with its
+ *              type, in constant time.
+ *
+ *  @details    The value stays valid for as long as the caller holds the
+ *              message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE whose property is wanted.
+ *  @param      id          The #MESSAGE_PROPERTY_ID of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message does not
+ *              have it, @c message is @c NULL or @c id is out of range.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MESSAGE_PROPERTY_VALUE*, Message_GetTypedPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id);
+
 /** @brief      Gets the content of a message.
  *
  *  @details    The returned @c CONSTBUFFER need not be freed by the caller.
@@ -204,6 +708,31 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER *, Message_GetContent, MESS
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the content of a message without copying it, in a view
+ *              that may outlive the caller's @c message handle.
+ *
+ *  @details    Unlike #Message_GetContentHandle, this never copies the
+ *              content, whatever the message was created with, including
+ *              #Message_CreateWithExternalContent and
+ *              #Message_CreateFromMappedFile. The view keeps a reference to
+ *              the message and must be released with
+ *              #Message_ReleaseContentView.
+ *
+ *  @param      message     The #MESSAGE_HANDLE whose content is viewed.
+ *  @param      view        The #MESSAGE_CONTENT_VIEW to fill.
+ *
+ *  @return     Zero on success, non-zero if @c message or @c view is
+ *              @c NULL.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetContentView, MESSAGE_HANDLE, message, MESSAGE_CONTENT_VIEW*, view);
+
+/** @brief      Releases a view filled by #Message_GetContentView.
+ *
+ *  @param      view        The #MESSAGE_CONTENT_VIEW to release; it is left
+ *                          empty.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, Message_ReleaseContentView, MESSAGE_CONTENT_VIEW*, view);
+
 /** @brief      Disposes of resources allocated by the message.
  *       
  *  @param      message     The #MESSAGE_HANDLE to be destroyed.
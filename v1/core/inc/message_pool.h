@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_pool.h
+*   @brief      Slab allocator for the small, short-lived blocks messages are
+*               made of.
+*
+*   @details    Blocks come in a few size classes and are carved out of
+*               slabs that are never handed back to the heap, so a gateway
+*               that has reached its working set stops allocating and stops
+*               fragmenting the heap. Every thread keeps a small cache of
+*               free blocks per class and only takes a lock to exchange a
+*               whole batch of blocks with the shared free lists, which is
+*               what happens when messages are created on one thread and
+*               destroyed on another. A thread's cache goes back to the shared
+*               lists when the thread exits. Requests larger than the largest
+*               class are passed to malloc.
+*/
+
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/** @brief    Counters of a message pool, see ::MESSAGE_POOL_get_statistics.
+*
+*   @details  The hit rate of the pool is
+*             (thread_hits + shared_hits) / (thread_hits + shared_hits + misses).
+*/
+typedef struct MESSAGE_POOL_STATISTICS_TAG
+{
+    /** @brief    Blocks taken from the allocating thread's own cache. */
+    uint64_t thread_hits;
+    /** @brief    Blocks taken from a batch other threads had freed. */
+    uint64_t shared_hits;
+    /** @brief    Blocks carved from a new slab. */
+    uint64_t misses;
+    /** @brief    Requests too large for any size class, passed to malloc. */
+    uint64_t oversized;
+    /** @brief    Bytes held by slabs. */
+    uint64_t slab_bytes;
+} MESSAGE_POOL_STATISTICS;
+
+/* allocation, size bytes aligned for pointers and 64 bit integers, NULL if out of memory */
+MOCKABLE_FUNCTION(, void*, MESSAGE_POOL_alloc, size_t, size);
+
+/* release of a block returned by MESSAGE_POOL_alloc, on any thread; NULL is ignored */
+MOCKABLE_FUNCTION(, void, MESSAGE_POOL_free, void*, block);
+
+/** @brief        Reads the counters of the message pool.
+*
+*   @details      Every thread folds its counters into the totals each time
+*                 it exchanges blocks with the shared lists and every 1024
+*                 allocations, so the counters of other threads may lag a
+*                 little behind. The calling thread's are always current.
+*
+*   @param        statistics    Receives the counters.
+*
+*   @return       0 on success, non-zero if @c statistics is @c NULL.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MESSAGE_POOL_get_statistics, MESSAGE_POOL_STATISTICS*, statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_POOL_H*/
@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_properties.h
+*   @brief      Compact, immutable storage for the properties of a message.
+*
+*   @details    All the properties live in one block from the message pool:
+*               a table of entries, each holding the lengths of its name and
+*               value, followed by the strings themselves (or, for a set
+*               borrowed from a serialized message, pointing into it). The
+*               names listed
+*               in ::MESSAGE_PROPERTY_ID are interned when the block is
+*               built, so looking one of them up is a single index. A set
+*               derived from another copies only the names and values that
+*               changed, and points at its parent's strings for the rest.
+*               Values that are not strings are kept in binary, and turned
+*               into a string, kept in a block of its own, the first time
+*               one is asked for. Property
+*               sets are reference counted and never modified, so they can be
+*               read from any thread.
+*/
+
+#ifndef MESSAGE_PROPERTIES_H
+#define MESSAGE_PROPERTIES_H
+
+#include "message.h"
+
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+typedef struct MESSAGE_PROPERTIES_TAG* MESSAGE_PROPERTIES_HANDLE;
+
+/** @brief    One property; both strings are also zero terminated. */
+typedef struct MESSAGE_PROPERTY_TAG
+{
+    const char* key;
+    size_t      key_length;
+    /** NULL, and value_length 0, if the value is not a string */
+    const char* value;
+    size_t      value_length;
+    /** MESSAGE_PROPERTY_ID of key + 1 if it is interned, 0 otherwise */
+    size_t      interned;
+    /** the value with its type; a string is the same as value */
+    MESSAGE_PROPERTY_VALUE typed;
+    /** string form of a value that is not a string, built on first use */
+    void* volatile rendered;
+} MESSAGE_PROPERTY;
+
+/* copies the properties in map, NULL on failure */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_create, MAP_HANDLE, map);
+
+/* refers to count name/value pairs laid out as consecutive zero terminated
+ * strings, without copying them; pairs must outlive the set. NULL on failure
+ * or if a name repeats */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_create_borrowed, const char*, pairs, size_t, count);
+
+/* as MESSAGE_PROPERTIES_create_borrowed, for count properties laid out as in
+ * version 2 of the serialized message (see proxy/message_format.md); the
+ * layout must already have been checked */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_create_borrowed_v2, const unsigned char*, encoded, size_t, count);
+
+/* copies count properties, whose values may be of any MESSAGE_PROPERTY_TYPE;
+ * NULL on failure or if a name repeats */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_create_typed, const MESSAGE_TYPED_PROPERTY*, properties, size_t, count);
+
+/* as MESSAGE_PROPERTIES_create_borrowed_v2, for version 3 of the serialized
+ * message, where every value also has a type */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_create_borrowed_v3, const unsigned char*, encoded, size_t, count);
+
+/* the properties of parent without those named in adds or removes, followed
+ * by adds; shares the strings of parent and keeps a reference to it, copies
+ * only adds. NULL on failure or if a name repeats in adds */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_derive, MESSAGE_PROPERTIES_HANDLE, parent, const MESSAGE_PROPERTY_UPDATE*, adds, size_t, add_count, const char* const*, removes, size_t, remove_count);
+
+/* new reference to the same properties */
+MOCKABLE_FUNCTION(, MESSAGE_PROPERTIES_HANDLE, MESSAGE_PROPERTIES_clone, MESSAGE_PROPERTIES_HANDLE, handle);
+
+/* releases a reference */
+MOCKABLE_FUNCTION(, void, MESSAGE_PROPERTIES_destroy, MESSAGE_PROPERTIES_HANDLE, handle);
+
+/* number of properties, 0 if handle is NULL */
+MOCKABLE_FUNCTION(, size_t, MESSAGE_PROPERTIES_get_count, MESSAGE_PROPERTIES_HANDLE, handle);
+
+/* property at index, NULL if out of range; valid for as long as handle */
+MOCKABLE_FUNCTION(, const MESSAGE_PROPERTY*, MESSAGE_PROPERTIES_get_at, MESSAGE_PROPERTIES_HANDLE, handle, size_t, index);
+
+/* value of the property called name as a string, NULL if absent */
+MOCKABLE_FUNCTION(, const char*, MESSAGE_PROPERTIES_get, MESSAGE_PROPERTIES_HANDLE, handle, const char*, name);
+
+/* value of an interned property as a string, NULL if absent */
+MOCKABLE_FUNCTION(, const char*, MESSAGE_PROPERTIES_get_by_id, MESSAGE_PROPERTIES_HANDLE, handle, MESSAGE_PROPERTY_ID, id);
+
+/* value of the property called name with its type, NULL if absent */
+MOCKABLE_FUNCTION(, const MESSAGE_PROPERTY_VALUE*, MESSAGE_PROPERTIES_get_typed, MESSAGE_PROPERTIES_HANDLE, handle, const char*, name);
+
+/* value of an interned property with its type, NULL if absent */
+MOCKABLE_FUNCTION(, const MESSAGE_PROPERTY_VALUE*, MESSAGE_PROPERTIES_get_typed_by_id, MESSAGE_PROPERTIES_HANDLE, handle, MESSAGE_PROPERTY_ID, id);
+
+/* the properties as a CONSTMAP, built once and cloned for every caller */
+MOCKABLE_FUNCTION(, CONSTMAP_HANDLE, MESSAGE_PROPERTIES_get_constmap, MESSAGE_PROPERTIES_HANDLE, handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESSAGE_PROPERTIES_H */
@@ -1,6 +1,18 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+/** @file       message_queue.h
+*   @brief      First-in-first-out queue of messages, safe for concurrent use.
+*
+*   @details    The queue keeps messages in a circular array, so pushing and
+*               popping do not allocate once the queue has grown to its
+*               largest backlog. A queue may be given a capacity, past which
+*               pushes fail instead of growing. Every call takes the queue's
+*               lock, so any number of threads may push and pop, and
+*               MESSAGE_QUEUE_pop_wait lets a consumer sleep until a message
+*               is pushed instead of polling.
+*/
+
 #ifndef MESSAGE_QUEUE_H
 #define MESSAGE_QUEUE_H
 
@@ -21,21 +33,31 @@ extern "C"
 
 typedef struct MESSAGE_QUEUE_TAG* MESSAGE_QUEUE_HANDLE;
 
-/* creation */
+/* creation, the queue grows as needed */
 MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create);
 
+/* creation, the queue holds at most capacity messages, or grows as needed if capacity is 0 */
+MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create_with_capacity, size_t, capacity);
+
 /* destruction */
 MOCKABLE_FUNCTION(, void, MESSAGE_QUEUE_destroy, MESSAGE_QUEUE_HANDLE, handle);
 
-/* insertion */
+/* insertion, fails without blocking when the queue holds capacity messages; the queue owns element only on success */
 MOCKABLE_FUNCTION(, int, MESSAGE_QUEUE_push, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE, element);
 
 /* removal */
 MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_HANDLE, handle);
 
+/* removal, waits up to timeout milliseconds for a message, without a limit if timeout is negative; NULL on timeout or once the queue is closed and empty */
+MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_HANDLE, handle, int, timeout);
+
+/* wakes every thread in MESSAGE_QUEUE_pop_wait; from then on it returns at once when the queue is empty */
+MOCKABLE_FUNCTION(, void, MESSAGE_QUEUE_close, MESSAGE_QUEUE_HANDLE, handle);
+
 /* access */
 MOCKABLE_FUNCTION(, bool,  MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_HANDLE, handle);
 MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_front, MESSAGE_QUEUE_HANDLE, handle);
+MOCKABLE_FUNCTION(, size_t, MESSAGE_QUEUE_size, MESSAGE_QUEUE_HANDLE, handle);
 
 #ifdef __cplusplus
 }
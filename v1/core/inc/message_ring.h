@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_ring.h
+*   @brief      Bounded, lock-free, multi-producer single-consumer queue of
+*               messages.
+*
+*   @details    Any number of threads may push onto a ring concurrently; a
+*               single thread pops from it. Pushing never blocks: when the
+*               ring is full the push fails and the caller keeps ownership
+*               of the message. Popping blocks until a message arrives or the
+*               ring is closed, or MESSAGE_RING_try_pop returns at once for
+*               a consumer that is woken some other way. The consumer only touches a lock when the ring
+*               is empty, so a busy ring costs producers one compare-and-swap
+*               per message.
+*/
+
+#ifndef MESSAGE_RING_H
+#define MESSAGE_RING_H
+
+#include "message.h"
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+typedef struct MESSAGE_RING_TAG* MESSAGE_RING_HANDLE;
+
+/* creation, capacity is rounded up to a power of two */
+MOCKABLE_FUNCTION(, MESSAGE_RING_HANDLE, MESSAGE_RING_create, size_t, capacity);
+
+/* destruction, destroys every message still in the ring */
+MOCKABLE_FUNCTION(, void, MESSAGE_RING_destroy, MESSAGE_RING_HANDLE, handle);
+
+/* insertion, safe from any thread; the ring owns element only on success */
+MOCKABLE_FUNCTION(, int, MESSAGE_RING_push, MESSAGE_RING_HANDLE, handle, MESSAGE_HANDLE, element);
+
+/* removal, single consumer; blocks until a message is available, returns NULL once the ring is closed */
+MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_RING_pop, MESSAGE_RING_HANDLE, handle);
+
+/* removal, single consumer; returns NULL at once if the ring is empty or closed */
+MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_RING_try_pop, MESSAGE_RING_HANDLE, handle);
+
+/* wakes the consumer and makes every following MESSAGE_RING_pop return NULL */
+MOCKABLE_FUNCTION(, void, MESSAGE_RING_close, MESSAGE_RING_HANDLE, handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESSAGE_RING_H */
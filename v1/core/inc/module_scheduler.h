@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       module_scheduler.h
+*   @brief      Fixed pool of worker threads shared by many module tasks.
+*
+*   @details    A task is a unit of work that is run when notified, such as
+*               a module draining its message ring. The scheduler never runs
+*               a task on two threads at once, so the work it does is serial
+*               even though it may move between workers. Each worker keeps
+*               its own queue of tasks ready to run; a worker with an empty
+*               queue steals from the others before it goes to sleep. A task
+*               is queued on the worker that last ran it, so its data tends
+*               to stay in that worker's cache.
+*/
+
+#ifndef MODULE_SCHEDULER_H
+#define MODULE_SCHEDULER_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+typedef struct MODULE_SCHEDULER_TAG* MODULE_SCHEDULER_HANDLE;
+typedef struct MODULE_TASK_TAG* MODULE_TASK_HANDLE;
+
+/* does at most budget units of the task's work, returns true if work may be left */
+typedef bool(*MODULE_TASK_RUN)(void* context, size_t budget);
+
+/* creation, starts worker_count threads, or one per processor if worker_count is 0 */
+MOCKABLE_FUNCTION(, MODULE_SCHEDULER_HANDLE, MODULE_SCHEDULER_create, size_t, worker_count);
+
+/* destruction, stops and joins every worker; every task must have been removed */
+MOCKABLE_FUNCTION(, void, MODULE_SCHEDULER_destroy, MODULE_SCHEDULER_HANDLE, handle);
+
+/* registers a task, it does not run until notified */
+MOCKABLE_FUNCTION(, MODULE_TASK_HANDLE, MODULE_SCHEDULER_add_task, MODULE_SCHEDULER_HANDLE, handle, MODULE_TASK_RUN, run, void*, context);
+
+/* makes the task run once more, safe from any thread and never blocks */
+MOCKABLE_FUNCTION(, void, MODULE_SCHEDULER_notify, MODULE_TASK_HANDLE, task);
+
+/* waits for the task to stop running and frees it; it must not be notified again */
+MOCKABLE_FUNCTION(, void, MODULE_SCHEDULER_remove_task, MODULE_TASK_HANDLE, task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_SCHEDULER_H */
@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       shared_memory.h
+*   @brief      Maps a named region of memory shared between processes, and
+*               lets a process sleep until a 32 bit word in it changes.
+*/
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+typedef struct SHARED_MEMORY_TAG* SHARED_MEMORY_HANDLE;
+
+/* creates and maps a zero filled region of size bytes under name, replacing a region left behind under that name; *address receives the mapping */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_HANDLE, SharedMemory_Create, const char*, name, size_t, size, void**, address);
+
+/* maps the region another process created under name; *address and *size describe the mapping */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_HANDLE, SharedMemory_Open, const char*, name, void**, address, size_t*, size);
+
+/* unmaps the region, and removes its name if this process created it; does nothing if handle is NULL */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SharedMemory_Close, SHARED_MEMORY_HANDLE, handle);
+
+/* sleeps while *word equals expected, for up to timeout_ms milliseconds (forever if negative); returns 0 when woken, non-zero on timeout */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, SharedMemory_Wait, volatile uint32_t*, word, uint32_t, expected, int, timeout_ms);
+
+/* wakes every thread, in any process, sleeping in SharedMemory_Wait on word */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SharedMemory_WakeAll, volatile uint32_t*, word);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_MEMORY_H
@@ -3,11 +3,16 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/map.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
@@ -15,26 +20,50 @@
 #include "azure_c_shared_utility/uniqueid.h"
 
 #include <nanomsg/nn.h>
-#include <nanomsg/pubsub.h>
+#include <nanomsg/pair.h>
 
 #include "message.h"
+#include "message_ring.h"
+#include "link_filter.h"
+#include "module_scheduler.h"
 #include "module.h"
 #include "module_access.h"
 #include "broker.h"
+#include "gateway_atomic.h"
 
 /* minimum size for a guid string, 36 characters + null terminator */
 #define BROKER_GUID_SIZE 37
 #define INPROC_URL_HEAD "inproc://"
 #define INPROC_URL_HEAD_SIZE 9
 #define URL_SIZE (INPROC_URL_HEAD_SIZE + BROKER_GUID_SIZE +1)
+/* messages a module may have waiting on the ring and pool engines when none is configured */
+#define BROKER_DEFAULT_QUEUE_CAPACITY 1024
+/* messages sent to a module in one buffer, or handed to it in one call, at most */
+#define BROKER_BATCH_SIZE 32
 
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
 {
     SINGLYLINKEDLIST_HANDLE modules;
     LOCK_HANDLE             modules_lock;
-    int                     publish_socket;
     STRING_HANDLE           url;
+    BROKER_ENGINE           engine;
+    size_t                  queue_capacity;
+    /** Threads running every module (pool engine only) */
+    MODULE_SCHEDULER_HANDLE scheduler;
+    /** Number of links across all modules, bounds the size of a snapshot */
+    size_t                  link_count;
+    /** Current routing snapshot (BROKER_ROUTES*), never NULL */
+    void* volatile          routes;
+    /** Bumped every time a snapshot is retired */
+    GATEWAY_ATOMIC_U32      epoch;
+    /** Publishers reading a snapshot, by the parity of the epoch they entered in */
+    GATEWAY_ATOMIC_U32      readers[2];
+    /** Set while routes_swap waits for the readers of a retired snapshot */
+    GATEWAY_ATOMIC_U32      swap_waiting;
+    LOCK_HANDLE             swap_lock;
+    /** Posted by the last reader of a retired snapshot */
+    COND_HANDLE             readers_gone;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
@@ -51,11 +80,94 @@ typedef struct BROKER_MODULEINFO_TAG
     int             receive_socket;
     /** Lock to prevent nanomsg race condition */
     LOCK_HANDLE     socket_lock;
+    /** Socket publishers use to deliver messages to this module */
+    int             send_socket;
     /** Guid sent to module worker thread to close task */
     STRING_HANDLE   quit_message_guid;
-
+    /** Links (BROKER_LINK*) to the modules that are linked to this module as sinks */
+    VECTOR_HANDLE   sinks;
+    /** Queue publishers push messages for this module onto (ring and pool engines only) */
+    MESSAGE_RING_HANDLE ring;
+    /** Task draining ring on the broker's scheduler (pool engine only) */
+    MODULE_TASK_HANDLE task;
+    /** Links (BROKER_LINK*) with a queue of their own that deliver to this
+     *  module, NULL until the first one is added
+     */
+    VECTOR_HANDLE   inbound;
+    /** Lock held by the worker while it takes messages off inbound links */
+    LOCK_HANDLE     inbound_lock;
+    /** Message (MESSAGE_HANDLE) sent to the worker when inbound links have messages */
+    void* volatile  link_signal;
+    /** Set once an inbound link has messages the worker has not looked for yet */
+    GATEWAY_ATOMIC_U32 links_pending;
+    /** Inbound link the worker takes a message from first, so links take turns */
+    size_t          next_inbound;
 }BROKER_MODULEINFO;
 
+/*A message waiting on a link, and the value of the link's conflate key in it*/
+typedef struct BROKER_LINK_SLOT_TAG
+{
+    MESSAGE_HANDLE  message;
+    const char*     key;
+}BROKER_LINK_SLOT;
+
+/*One entry of a module's sinks*/
+typedef struct BROKER_LINK_TAG
+{
+    BROKER_MODULEINFO*      sink;
+    /** Messages this link has lost */
+    GATEWAY_ATOMIC_U32      dropped;
+    /** Snapshots and blocked publishers holding the link, it is destroyed
+     *  when the last one lets go
+     */
+    GATEWAY_ATOMIC_U32      refs;
+    /** Set once the link is gone from every module, the snapshots let go of
+     *  the link when the last one holding it is retired
+     */
+    bool                    retired;
+    /** Messages that do not match it are not delivered, NULL when all are */
+    LINK_FILTER_HANDLE      filter;
+    /** Messages that may wait on the link, 0 when they go straight to the sink.
+     *  The fields below are only used when it is not 0.
+     */
+    size_t                  capacity;
+    BROKER_OVERFLOW_POLICY  overflow;
+    STRING_HANDLE           conflate_key;
+    LOCK_HANDLE             lock;
+    /** Posted when a message leaves the link (BROKER_OVERFLOW_BLOCK only) */
+    COND_HANDLE             space;
+    BROKER_LINK_SLOT*       slots;
+    size_t                  head;
+    size_t                  count;
+    bool                    closed;
+}BROKER_LINK;
+
+/*One source module and the modules its messages are delivered to*/
+typedef struct BROKER_ROUTE_TAG
+{
+    MODULE_HANDLE       source;
+    size_t              sink_count;
+    BROKER_LINK**       sinks;
+}BROKER_ROUTE;
+
+/*Immutable copy of every module's sinks. Broker_Publish reads it without a
+ *lock; topology changes build a new one and swap it in.
+ */
+typedef struct BROKER_ROUTES_TAG
+{
+    size_t          route_count;
+    BROKER_ROUTE*   routes;
+}BROKER_ROUTES;
+
+/** What travels on a module's delivery socket: a clone of the published
+ *  message, never serialized in process. Module_Receive is not told the
+ *  publisher, so the envelope does not carry it.
+ */
+typedef struct BROKER_MESSAGE_ENVELOPE_TAG
+{
+    MESSAGE_HANDLE  message;
+}BROKER_MESSAGE_ENVELOPE;
+
 static int nn_really_close(int s)
 {
     int result;
@@ -110,7 +222,453 @@ static STRING_HANDLE construct_url()
     return result;
 }
 
-BROKER_HANDLE Broker_Create(void)
+/*allocates a snapshot large enough for link_count links, routes and sinks share one block*/
+static BROKER_ROUTES* routes_alloc(size_t link_count)
+{
+    BROKER_ROUTES* result = (BROKER_ROUTES*)malloc(sizeof(BROKER_ROUTES) + link_count * (sizeof(BROKER_ROUTE) + sizeof(BROKER_LINK*)));
+    if (result == NULL)
+    {
+        LogError("unable to allocate routing snapshot");
+    }
+    else
+    {
+        result->route_count = 0;
+        result->routes = (BROKER_ROUTE*)(result + 1);
+    }
+    return result;
+}
+
+static bool find_sink_predicate(const void* element, const void* value)
+{
+    return (*(BROKER_LINK**)element)->sink == (BROKER_MODULEINFO*)value;
+}
+
+static bool find_link_predicate(const void* element, const void* value)
+{
+    return *(BROKER_LINK**)element == (BROKER_LINK*)value;
+}
+
+static void link_destroy(BROKER_LINK* link)
+{
+    size_t i;
+    for (i = 0; i < link->count; i++)
+    {
+        Message_Destroy(link->slots[(link->head + i) % link->capacity].message);
+    }
+    if (link->space != NULL)
+    {
+        Condition_Deinit(link->space);
+    }
+    if (link->lock != NULL)
+    {
+        Lock_Deinit(link->lock);
+    }
+    if (link->conflate_key != NULL)
+    {
+        STRING_delete(link->conflate_key);
+    }
+    if (link->slots != NULL)
+    {
+        free(link->slots);
+    }
+    if (link->filter != NULL)
+    {
+        LINK_FILTER_destroy(link->filter);
+    }
+    free(link);
+}
+
+/*the link takes *filter, which is set to NULL, unless the link cannot be allocated*/
+static BROKER_LINK* link_create(BROKER_MODULEINFO* sink, const BROKER_LINK_QUEUE* queue, LINK_FILTER_HANDLE* filter)
+{
+    BROKER_LINK* result = (BROKER_LINK*)malloc(sizeof(BROKER_LINK));
+    if (result == NULL)
+    {
+        LogError("unable to allocate link");
+    }
+    else
+    {
+        result->sink = sink;
+        result->dropped = 0;
+        result->refs = 1;
+        result->retired = false;
+        result->filter = *filter;
+        *filter = NULL;
+        result->capacity = 0;
+        result->overflow = BROKER_OVERFLOW_DROP_NEWEST;
+        result->conflate_key = NULL;
+        result->lock = NULL;
+        result->space = NULL;
+        result->slots = NULL;
+        result->head = 0;
+        result->count = 0;
+        result->closed = false;
+        if (queue != NULL && queue->capacity > 0)
+        {
+            result->overflow = queue->overflow;
+            result->slots = (BROKER_LINK_SLOT*)malloc(queue->capacity * sizeof(BROKER_LINK_SLOT));
+            if (result->slots == NULL)
+            {
+                LogError("unable to allocate link queue");
+                link_destroy(result);
+                result = NULL;
+            }
+            else
+            {
+                result->capacity = queue->capacity;
+                result->lock = Lock_Init();
+                if (result->lock == NULL)
+                {
+                    LogError("Lock_Init failed for link queue");
+                    link_destroy(result);
+                    result = NULL;
+                }
+                else if (queue->overflow == BROKER_OVERFLOW_BLOCK &&
+                    (result->space = Condition_Init()) == NULL)
+                {
+                    LogError("Condition_Init failed for link queue");
+                    link_destroy(result);
+                    result = NULL;
+                }
+                else if (queue->overflow == BROKER_OVERFLOW_CONFLATE &&
+                    (result->conflate_key = STRING_construct(queue->conflate_key)) == NULL)
+                {
+                    LogError("unable to copy the conflate key of a link");
+                    link_destroy(result);
+                    result = NULL;
+                }
+                else
+                {
+                    /*the link is ready*/
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/*keeps a link alive after the snapshot it was found in is released*/
+static void link_acquire(BROKER_LINK* link)
+{
+    (void)gateway_atomic_increment(&link->refs);
+}
+
+static void link_release(BROKER_LINK* link)
+{
+    if (gateway_atomic_decrement(&link->refs) == 0)
+    {
+        link_destroy(link);
+    }
+}
+
+/*takes the oldest message off a link, NULL if there is none*/
+static MESSAGE_HANDLE link_dequeue(BROKER_LINK* link)
+{
+    MESSAGE_HANDLE result = NULL;
+    if (Lock(link->lock) != LOCK_OK)
+    {
+        LogError("unable to lock link queue");
+    }
+    else
+    {
+        if (link->count > 0)
+        {
+            result = link->slots[link->head].message;
+            link->head = (link->head + 1) % link->capacity;
+            link->count--;
+            if (link->space != NULL)
+            {
+                (void)Condition_Post(link->space);
+            }
+        }
+        (void)Unlock(link->lock);
+    }
+    return result;
+}
+
+/*stops a link with a queue from taking messages and from being drained, so it can be retired*/
+static void link_detach(BROKER_LINK* link)
+{
+    if (link->capacity > 0)
+    {
+        BROKER_MODULEINFO* sink = link->sink;
+        if (Lock(link->lock) != LOCK_OK)
+        {
+            LogError("unable to lock link queue");
+        }
+        else
+        {
+            link->closed = true;
+            if (link->space != NULL)
+            {
+                (void)Condition_Post(link->space);
+            }
+            (void)Unlock(link->lock);
+        }
+
+        if (Lock(sink->inbound_lock) != LOCK_OK)
+        {
+            LogError("unable to lock inbound links");
+        }
+        else
+        {
+            BROKER_LINK** inbound = (BROKER_LINK**)VECTOR_find_if(sink->inbound, find_link_predicate, link);
+            if (inbound != NULL)
+            {
+                VECTOR_erase(sink->inbound, inbound, 1);
+            }
+            (void)Unlock(sink->inbound_lock);
+        }
+    }
+}
+
+/*hands at most BROKER_BATCH_SIZE messages the sink now owns to the sink's worker,
+  destroying the ones it cannot take. Returns the number of messages destroyed.*/
+static size_t deliver_to_module(BROKER_MODULEINFO* sink, MESSAGE_HANDLE* messages, size_t count)
+{
+    size_t result = 0;
+    size_t i;
+    if (sink->ring != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_BROKER_17_061: [ On the ring engine, Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::ring. ]*/
+            if (MESSAGE_RING_push(sink->ring, messages[i]) != 0)
+            {
+                Message_Destroy(messages[i]);
+                result++;
+            }
+        }
+        if (result < count && sink->task != NULL)
+        {
+            /*Codes_SRS_BROKER_17_086: [ On the pool engine, Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::ring and notify the sink's task. ]*/
+            MODULE_SCHEDULER_notify(sink->task);
+        }
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a BROKER_MESSAGE_ENVELOPE holding the clone on the sink's send_socket without blocking. ]*/
+        /*Codes_SRS_BROKER_17_093: [ On the nanomsg engine, Broker_PublishBatch shall send each sink the envelopes of up to 32 clones in a single buffer. ]*/
+        BROKER_MESSAGE_ENVELOPE envelopes[BROKER_BATCH_SIZE];
+        int size = (int)(count * sizeof(BROKER_MESSAGE_ENVELOPE));
+        for (i = 0; i < count; i++)
+        {
+            envelopes[i].message = messages[i];
+        }
+        if (nn_really_send(sink->send_socket, envelopes, (size_t)size, NN_DONTWAIT) != size)
+        {
+            for (i = 0; i < count; i++)
+            {
+                Message_Destroy(messages[i]);
+            }
+            result = count;
+        }
+    }
+    return result;
+}
+
+/*wakes the sink's worker to drain its inbound links, unless it has been woken already*/
+static void signal_inbound(BROKER_MODULEINFO* sink)
+{
+    /*Codes_SRS_BROKER_17_076: [ After queuing on a link, Broker_Publish shall send BROKER_MODULEINFO::link_signal to the sink unless the sink has inbound links pending already. ]*/
+    if (gateway_atomic_compare_exchange(&sink->links_pending, 0, 1))
+    {
+        MESSAGE_HANDLE signal = Message_Clone((MESSAGE_HANDLE)gateway_atomic_load_pointer(&sink->link_signal));
+        if (signal != NULL)
+        {
+            /*if the sink's queue is full, its worker looks at links_pending after each message it takes*/
+            (void)deliver_to_module(sink, &signal, 1);
+        }
+    }
+}
+
+/*queues a message the link now owns, applying the link's overflow policy, and
+  wakes the sink if the link is still attached to it*/
+static void link_enqueue(BROKER_LINK* link, MESSAGE_HANDLE message)
+{
+    const char* key = NULL;
+    if (link->conflate_key != NULL)
+    {
+        /*the value lives as long as the link holds on to the message*/
+        key = Message_GetProperty(message, STRING_c_str(link->conflate_key));
+    }
+
+    if (Lock(link->lock) != LOCK_OK)
+    {
+        LogError("unable to lock link queue");
+        Message_Destroy(message);
+        (void)gateway_atomic_increment(&link->dropped);
+    }
+    else
+    {
+        BROKER_LINK_SLOT* slot = NULL;
+        size_t i;
+
+        /*Codes_SRS_BROKER_17_073: [ With BROKER_OVERFLOW_BLOCK, Broker_Publish shall wait until the link has room or is removed. ]*/
+        while (link->overflow == BROKER_OVERFLOW_BLOCK && !link->closed && link->count == link->capacity)
+        {
+            (void)Condition_Wait(link->space, link->lock, 0);
+        }
+
+        /*Codes_SRS_BROKER_17_074: [ With BROKER_OVERFLOW_CONFLATE, Broker_Publish shall replace the waiting message that has the same value for the conflate key, whether or not the link is full. ]*/
+        for (i = 0; key != NULL && i < link->count && slot == NULL; i++)
+        {
+            BROKER_LINK_SLOT* waiting = &link->slots[(link->head + i) % link->capacity];
+            if (waiting->key != NULL && strcmp(waiting->key, key) == 0)
+            {
+                slot = waiting;
+            }
+        }
+
+        if (link->closed)
+        {
+            Message_Destroy(message);
+            (void)gateway_atomic_increment(&link->dropped);
+        }
+        else if (slot != NULL)
+        {
+            Message_Destroy(slot->message);
+            slot->message = message;
+            slot->key = key;
+            (void)gateway_atomic_increment(&link->dropped);
+        }
+        else if (link->count < link->capacity)
+        {
+            slot = &link->slots[(link->head + link->count) % link->capacity];
+            slot->message = message;
+            slot->key = key;
+            link->count++;
+        }
+        else if (link->overflow == BROKER_OVERFLOW_DROP_NEWEST)
+        {
+            /*Codes_SRS_BROKER_17_071: [ With BROKER_OVERFLOW_DROP_NEWEST, Broker_Publish shall discard the message when the link is full. ]*/
+            Message_Destroy(message);
+            (void)gateway_atomic_increment(&link->dropped);
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_072: [ With BROKER_OVERFLOW_DROP_OLDEST, or BROKER_OVERFLOW_CONFLATE and no message to replace, Broker_Publish shall discard the message that waited longest when the link is full. ]*/
+            slot = &link->slots[link->head];
+            Message_Destroy(slot->message);
+            slot->message = message;
+            slot->key = key;
+            link->head = (link->head + 1) % link->capacity;
+            (void)gateway_atomic_increment(&link->dropped);
+        }
+        /*the sink outlives the link until link_detach closes it, which needs this lock*/
+        if (!link->closed && link->count > 0)
+        {
+            signal_inbound(link->sink);
+        }
+        (void)Unlock(link->lock);
+    }
+}
+
+/*releases the messages of the envelopes in a buffer received on a module's receive_socket*/
+static void destroy_envelopes(const unsigned char* buf, size_t envelope_count)
+{
+    size_t i;
+    for (i = 0; i < envelope_count; i++)
+    {
+        BROKER_MESSAGE_ENVELOPE envelope;
+        memcpy(&envelope, buf + i * sizeof(BROKER_MESSAGE_ENVELOPE), sizeof(BROKER_MESSAGE_ENVELOPE));
+        Message_Destroy(envelope.message);
+    }
+}
+
+/*retires the current snapshot: after this returns no publisher can still be reading it*/
+static void routes_swap(BROKER_HANDLE_DATA* broker_data, BROKER_ROUTES* routes)
+{
+    size_t i;
+    BROKER_ROUTES* old_routes = (BROKER_ROUTES*)gateway_atomic_exchange_pointer(&broker_data->routes, routes);
+    uint32_t old_epoch = gateway_atomic_increment(&broker_data->epoch) - 1;
+    gateway_atomic_store(&broker_data->swap_waiting, 1);
+    gateway_atomic_fence();
+    /*publishers entering from now on see the new epoch and the new snapshot,
+      wait for the ones that entered before. None of them blocks while it reads.*/
+    if (gateway_atomic_load(&broker_data->readers[old_epoch & 1]) != 0)
+    {
+        /*Codes_SRS_BROKER_17_102: [ Functions that change links shall wait on BROKER_HANDLE_DATA::readers_gone, without spinning, for the publishers still reading the previous routing snapshot. ]*/
+        if (Lock(broker_data->swap_lock) != LOCK_OK)
+        {
+            LogError("unable to lock the routing snapshot, waiting without it");
+            while (gateway_atomic_load(&broker_data->readers[old_epoch & 1]) != 0)
+            {
+                ThreadAPI_Sleep(1);
+            }
+        }
+        else
+        {
+            while (gateway_atomic_load(&broker_data->readers[old_epoch & 1]) != 0)
+            {
+                (void)Condition_Wait(broker_data->readers_gone, broker_data->swap_lock, 0);
+            }
+            (void)Unlock(broker_data->swap_lock);
+        }
+    }
+    gateway_atomic_store(&broker_data->swap_waiting, 0);
+    /*every link is in the snapshot that was current when it was retired*/
+    for (i = 0; i < old_routes->route_count; i++)
+    {
+        size_t j;
+        for (j = 0; j < old_routes->routes[i].sink_count; j++)
+        {
+            if (old_routes->routes[i].sinks[j]->retired)
+            {
+                link_release(old_routes->routes[i].sinks[j]);
+            }
+        }
+    }
+    free(old_routes);
+}
+
+/*leaves the readers of an epoch, waking routes_swap if it waits for the last one*/
+static void readers_leave(BROKER_HANDLE_DATA* broker_data, uint32_t reader_slot)
+{
+    if (gateway_atomic_decrement(&broker_data->readers[reader_slot]) == 0 &&
+        gateway_atomic_load(&broker_data->swap_waiting) != 0)
+    {
+        /*the writer checks the readers while holding swap_lock, so the post cannot be lost*/
+        if (Lock(broker_data->swap_lock) != LOCK_OK)
+        {
+            LogError("unable to lock the routing snapshot");
+        }
+        else
+        {
+            (void)Condition_Post(broker_data->readers_gone);
+            (void)Unlock(broker_data->swap_lock);
+        }
+    }
+}
+
+static BROKER_ROUTES* routes_acquire(BROKER_HANDLE_DATA* broker_data, uint32_t* reader_slot)
+{
+    BROKER_ROUTES* result = NULL;
+    while (result == NULL)
+    {
+        uint32_t epoch = gateway_atomic_load(&broker_data->epoch);
+        (void)gateway_atomic_increment(&broker_data->readers[epoch & 1]);
+        gateway_atomic_fence();
+        if (gateway_atomic_load(&broker_data->epoch) == epoch)
+        {
+            *reader_slot = epoch & 1;
+            result = (BROKER_ROUTES*)gateway_atomic_load_pointer(&broker_data->routes);
+        }
+        else
+        {
+            /*a snapshot was retired meanwhile, the writer may not have seen us*/
+            readers_leave(broker_data, epoch & 1);
+        }
+    }
+    return result;
+}
+
+static void routes_release(BROKER_HANDLE_DATA* broker_data, uint32_t reader_slot)
+{
+    readers_leave(broker_data, reader_slot);
+}
+
+static BROKER_HANDLE broker_create(BROKER_ENGINE engine, size_t queue_capacity, size_t worker_count)
 {
     BROKER_HANDLE_DATA* result;
 
@@ -146,44 +704,78 @@ BROKER_HANDLE Broker_Create(void)
             }
             else
             {
-                /*Codes_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]*/
-                result->publish_socket = nn_socket(AF_SP, NN_PUB);
-                if (result->publish_socket < 0)
+                result->url = construct_url();
+                if (result->url == NULL)
                 {
                     /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                    LogError("nanomsg puclish socket create failedL %d", result->publish_socket);
                     singlylinkedlist_destroy(result->modules);
                     Lock_Deinit(result->modules_lock);
                     free(result);
+                    LogError("Unable to generate unique url.");
                     result = NULL;
                 }
                 else
                 {
-                    result->url = construct_url();
-                    if (result->url == NULL)
+                    /*Codes_SRS_BROKER_17_062: [ Broker_Create shall initialize BROKER_HANDLE_DATA::routes with an empty routing snapshot. ]*/
+                    BROKER_ROUTES* routes = routes_alloc(0);
+                    if (routes == NULL)
                     {
                         /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
+                        STRING_delete(result->url);
                         singlylinkedlist_destroy(result->modules);
                         Lock_Deinit(result->modules_lock);
-                        nn_really_close(result->publish_socket);
                         free(result);
-                        LogError("Unable to generate unique url.");
                         result = NULL;
                     }
                     else
                     {
-                        /*Codes_SRS_BROKER_17_004: [ Broker_Create shall bind the socket to the BROKER_HANDLE_DATA::url. ]*/
-                        if (nn_bind(result->publish_socket, STRING_c_str(result->url)) < 0)
+                        result->engine = engine;
+                        result->queue_capacity = queue_capacity;
+                        result->scheduler = NULL;
+                        result->link_count = 0;
+                        result->routes = routes;
+                        result->epoch = 0;
+                        result->readers[0] = 0;
+                        result->readers[1] = 0;
+                        result->swap_waiting = 0;
+                        result->readers_gone = NULL;
+
+                        /*Codes_SRS_BROKER_17_101: [ Broker_Create shall initialize BROKER_HANDLE_DATA::swap_lock with a valid LOCK_HANDLE and BROKER_HANDLE_DATA::readers_gone with a valid COND_HANDLE. ]*/
+                        result->swap_lock = Lock_Init();
+                        if (result->swap_lock == NULL ||
+                            (result->readers_gone = Condition_Init()) == NULL)
                         {
                             /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
-                            LogError("nanomsg bind failed");
+                            LogError("unable to create the routing snapshot lock");
+                            if (result->swap_lock != NULL)
+                            {
+                                Lock_Deinit(result->swap_lock);
+                            }
+                            free(routes);
+                            STRING_delete(result->url);
                             singlylinkedlist_destroy(result->modules);
                             Lock_Deinit(result->modules_lock);
-                            nn_really_close(result->publish_socket);
-                            STRING_delete(result->url);                
                             free(result);
                             result = NULL;
                         }
+                        else if (engine == BROKER_ENGINE_POOL)
+                        {
+                            /*Codes_SRS_BROKER_17_085: [ On the pool engine, Broker_CreateWithConfig shall create a module scheduler with config->worker_count workers. ]*/
+                            result->scheduler = MODULE_SCHEDULER_create(worker_count);
+                            if (result->scheduler == NULL)
+                            {
+                                /*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
+                                LogError("MODULE_SCHEDULER_create failed");
+                                Condition_Deinit(result->readers_gone);
+                                Lock_Deinit(result->swap_lock);
+                                free(routes);
+                                STRING_delete(result->url);
+                                singlylinkedlist_destroy(result->modules);
+                                Lock_Deinit(result->modules_lock);
+                                free(result);
+                                result = NULL;
+                            }
+                        }
                     }
                 }
             }
@@ -194,6 +786,37 @@ BROKER_HANDLE Broker_Create(void)
     return result;
 }
 
+BROKER_HANDLE Broker_Create(void)
+{
+    /*Codes_SRS_BROKER_17_054: [ Broker_Create shall create a broker using BROKER_ENGINE_NANOMSG. ]*/
+    return broker_create(BROKER_ENGINE_NANOMSG, 0, 0);
+}
+
+BROKER_HANDLE Broker_CreateWithConfig(const BROKER_CONFIG* config)
+{
+    BROKER_HANDLE result;
+    /*Codes_SRS_BROKER_17_055: [ If config is NULL or config->engine is not a BROKER_ENGINE value, Broker_CreateWithConfig shall return NULL. ]*/
+    if (config == NULL)
+    {
+        LogError("invalid arg: config is NULL");
+        result = NULL;
+    }
+    else if (config->engine != BROKER_ENGINE_NANOMSG && config->engine != BROKER_ENGINE_RING && config->engine != BROKER_ENGINE_POOL)
+    {
+        LogError("invalid arg: unknown broker engine %d", (int)config->engine);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_056: [ Broker_CreateWithConfig shall create a broker using config->engine, and a queue capacity of config->queue_capacity or, on the ring and pool engines, 1024 if that is 0. ]*/
+        result = broker_create(
+            config->engine,
+            (config->queue_capacity == 0 && config->engine != BROKER_ENGINE_NANOMSG) ? BROKER_DEFAULT_QUEUE_CAPACITY : config->queue_capacity,
+            config->worker_count);
+    }
+    return result;
+}
+
 void Broker_IncRef(BROKER_HANDLE broker)
 {
     /*Codes_SRS_BROKER_13_108: [If `broker` is NULL then Broker_IncRef shall do nothing.]*/
@@ -208,6 +831,123 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
+/*hands messages to the module, all at once if it can take a batch, then destroys them*/
+static void deliver_messages(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE* messages, size_t count)
+{
+    if (count > 0)
+    {
+        pfModule_ReceiveBatch receive_batch = MODULE_RECEIVE_BATCH(module_info->module->module_apis);
+        size_t i;
+        if (receive_batch != NULL)
+        {
+            /*Codes_SRS_BROKER_17_094: [ If the module's API is MODULE_API_VERSION_2 or later and has a Module_ReceiveBatch function, the function shall hand it every message it took at once, in order. ]*/
+            receive_batch(module_info->module->module_handle, messages, count);
+        }
+        else
+        {
+            for (i = 0; i < count; i++)
+            {
+                /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
+                MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, messages[i]);
+            }
+        }
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+            Message_Destroy(messages[i]);
+        }
+    }
+}
+
+/*delivers the messages waiting on the module's inbound links, one link after the other*/
+static void drain_inbound(BROKER_MODULEINFO* module_info)
+{
+    MESSAGE_HANDLE messages[BROKER_BATCH_SIZE];
+    size_t count;
+
+    gateway_atomic_store(&module_info->links_pending, 0);
+    gateway_atomic_fence();
+    do
+    {
+        count = 0;
+        if (Lock(module_info->inbound_lock) != LOCK_OK)
+        {
+            LogError("unable to lock inbound links");
+        }
+        else
+        {
+            size_t link_count = VECTOR_size(module_info->inbound);
+            size_t empty_links = 0;
+            /*take one message from each link in turn until the batch is full or every link is empty*/
+            while (count < BROKER_BATCH_SIZE && empty_links < link_count)
+            {
+                size_t index = module_info->next_inbound % link_count;
+                MESSAGE_HANDLE message = link_dequeue(*(BROKER_LINK**)VECTOR_element(module_info->inbound, index));
+                module_info->next_inbound = index + 1;
+                if (message == NULL)
+                {
+                    empty_links++;
+                }
+                else
+                {
+                    messages[count++] = message;
+                    empty_links = 0;
+                }
+            }
+            (void)Unlock(module_info->inbound_lock);
+        }
+
+        deliver_messages(module_info, messages, count);
+    } while (count > 0);
+}
+
+/*delivers messages taken off the module's queue, which may include the inbound link signal*/
+static void receive_messages(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE* messages, size_t count)
+{
+    MESSAGE_HANDLE link_signal = (MESSAGE_HANDLE)gateway_atomic_load_pointer(&module_info->link_signal);
+    size_t kept = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (messages[i] == link_signal)
+        {
+            Message_Destroy(messages[i]);
+        }
+        else
+        {
+            messages[kept++] = messages[i];
+        }
+    }
+    deliver_messages(module_info, messages, kept);
+
+    /*Codes_SRS_BROKER_17_077: [ After every message it takes off the module's queue, the function shall deliver the messages waiting on the module's inbound links if any link is pending. ]*/
+    if (gateway_atomic_load(&module_info->links_pending) != 0)
+    {
+        drain_inbound(module_info);
+    }
+}
+
+/*delivers the messages of the envelopes in a buffer received on the module's receive_socket*/
+static void receive_envelopes(BROKER_MODULEINFO* module_info, const unsigned char* buf, size_t envelope_count)
+{
+    MESSAGE_HANDLE messages[BROKER_BATCH_SIZE];
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < envelope_count; i++)
+    {
+        BROKER_MESSAGE_ENVELOPE envelope;
+        memcpy(&envelope, buf + i * sizeof(BROKER_MESSAGE_ENVELOPE), sizeof(BROKER_MESSAGE_ENVELOPE));
+        messages[count++] = envelope.message;
+        if (count == BROKER_BATCH_SIZE || i + 1 == envelope_count)
+        {
+            receive_messages(module_info, messages, count);
+            count = 0;
+        }
+    }
+}
+
 /**
 * This function runs for each module. It receives a pointer to a MODULE_INFO
 * object that describes the module. Its job is to call the Receive function on
@@ -242,6 +982,11 @@ static int module_worker(void * user_data)
             should_continue = 0;
             if (nbytes > 0)
             {
+                if ((size_t)nbytes % sizeof(BROKER_MESSAGE_ENVELOPE) == 0)
+                {
+                    /*Codes_SRS_BROKER_17_050: [ If the function exits with an envelope still in hand, it shall destroy the envelope's message. ]*/
+                    destroy_envelopes(buf, (size_t)nbytes / sizeof(BROKER_MESSAGE_ENVELOPE));
+                }
                 /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
                 nn_freemsg(buf);
             }
@@ -259,7 +1004,12 @@ static int module_worker(void * user_data)
         }
         else
         {
-            if (nbytes == BROKER_GUID_SIZE &&
+            if (nbytes > 0 && (size_t)nbytes % sizeof(BROKER_MESSAGE_ENVELOPE) == 0)
+            {
+                /*Codes_SRS_BROKER_17_043: [ If the buffer received is a whole number of BROKER_MESSAGE_ENVELOPEs, the function shall copy the envelopes out of the buffer and deliver their messages in order. ]*/
+                receive_envelopes(module_info, buf, (size_t)nbytes / sizeof(BROKER_MESSAGE_ENVELOPE));
+            }
+            else if (nbytes == BROKER_GUID_SIZE &&
                 (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
             {
                 /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
@@ -268,19 +1018,8 @@ static int module_worker(void * user_data)
             }
             else
             {
-                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
-                const unsigned char*buf_bytes = (const unsigned char*)buf;
-                buf_bytes += sizeof(MODULE_HANDLE);
-                /*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
-                MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - sizeof(MODULE_HANDLE));
-                /*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
-                if (msg != NULL)
-                {
-                    /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-                    MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, msg);
-                    /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
-                    Message_Destroy(msg);
-                }
+                /*Codes_SRS_BROKER_17_018: [ If the buffer received is neither an envelope nor the quit signal, the message loop shall continue. ]*/
+                LogError("module [%p] received an unexpected buffer of %d bytes", module_info->module->module_handle, nbytes);
             }
             /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
             nn_freemsg(buf);
@@ -290,6 +1029,65 @@ static int module_worker(void * user_data)
     return 0;
 }
 
+/**
+* Worker used by the ring engine: same contract as module_worker, but messages
+* arrive on BROKER_MODULEINFO::ring and the quit signal is the ring closing.
+*/
+static int ring_module_worker(void * user_data)
+{
+    /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
+    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+    MESSAGE_HANDLE messages[BROKER_BATCH_SIZE];
+    MESSAGE_HANDLE message;
+
+    /*Codes_SRS_BROKER_17_057: [ On the ring engine, the function shall pop messages from BROKER_MODULEINFO::ring until MESSAGE_RING_pop returns NULL. ]*/
+    while ((message = MESSAGE_RING_pop(module_info->ring)) != NULL)
+    {
+        size_t count = 1;
+        messages[0] = message;
+        /*Codes_SRS_BROKER_17_095: [ On the ring engine, after each message it pops the function shall take the messages already waiting on the ring with MESSAGE_RING_try_pop, up to 32 in all, and deliver them together. ]*/
+        while (count < BROKER_BATCH_SIZE && (message = MESSAGE_RING_try_pop(module_info->ring)) != NULL)
+        {
+            messages[count++] = message;
+        }
+        receive_messages(module_info, messages, count);
+    }
+
+    return 0;
+}
+
+/**
+* Task run by the pool engine's scheduler: delivers at most budget messages
+* from BROKER_MODULEINFO::ring, never waiting for more.
+*/
+static bool pool_module_run(void* context, size_t budget)
+{
+    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)context;
+    MESSAGE_HANDLE messages[BROKER_BATCH_SIZE];
+    size_t delivered = 0;
+    bool empty = false;
+
+    /*Codes_SRS_BROKER_17_087: [ On the pool engine, the module's task shall deliver at most budget messages popped from BROKER_MODULEINFO::ring with MESSAGE_RING_try_pop, and report whether it used the whole budget. ]*/
+    while (!empty && delivered < budget)
+    {
+        size_t count = 0;
+        while (count < BROKER_BATCH_SIZE && delivered + count < budget)
+        {
+            MESSAGE_HANDLE message = MESSAGE_RING_try_pop(module_info->ring);
+            if (message == NULL)
+            {
+                empty = true;
+                break;
+            }
+            messages[count++] = message;
+        }
+        receive_messages(module_info, messages, count);
+        delivered += count;
+    }
+
+    return delivered == budget;
+}
+
 static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
 {
     BROKER_RESULT result;
@@ -338,7 +1136,27 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
                 }
                 else
                 {
-                    result = BROKER_OK;
+                    /*Codes_SRS_BROKER_17_044: [ The function shall initialize BROKER_MODULEINFO::sinks with a valid VECTOR_HANDLE. ]*/
+                    module_info->sinks = VECTOR_create(sizeof(BROKER_LINK*));
+                    if (module_info->sinks == NULL)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                        LogError("VECTOR_create failed for module sinks");
+                        STRING_delete(module_info->quit_message_guid);
+                        Lock_Deinit(module_info->socket_lock);
+                        result = BROKER_ERROR;
+                    }
+                    else
+                    {
+                        module_info->ring = NULL;
+                        module_info->task = NULL;
+                        module_info->inbound = NULL;
+                        module_info->inbound_lock = NULL;
+                        module_info->link_signal = NULL;
+                        module_info->links_pending = 0;
+                        module_info->next_inbound = 0;
+                        result = BROKER_OK;
+                    }
                 }
             }
         }
@@ -351,43 +1169,176 @@ static void deinit_module(BROKER_MODULEINFO* module_info)
     /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
     Lock_Deinit(module_info->socket_lock);
     STRING_delete(module_info->quit_message_guid);
+    VECTOR_destroy(module_info->sinks);
+    if (module_info->inbound != NULL)
+    {
+        VECTOR_destroy(module_info->inbound);
+        Lock_Deinit(module_info->inbound_lock);
+        Message_Destroy((MESSAGE_HANDLE)module_info->link_signal);
+    }
     free(module_info->module);
 }
 
-static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE url)
+/*gives a module what it needs to be the sink of links with a queue of their own*/
+static int init_inbound(BROKER_MODULEINFO* module_info)
+{
+    int result;
+    if (module_info->inbound != NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_078: [ The first time a link with a queue is added to a sink, Broker_AddLinkEx shall create the sink's BROKER_MODULEINFO::inbound vector, its lock and its link_signal message. ]*/
+        VECTOR_HANDLE inbound = VECTOR_create(sizeof(BROKER_LINK*));
+        if (inbound == NULL)
+        {
+            LogError("VECTOR_create failed for inbound links");
+            result = __LINE__;
+        }
+        else
+        {
+            module_info->inbound_lock = Lock_Init();
+            if (module_info->inbound_lock == NULL)
+            {
+                LogError("Lock_Init failed for inbound links");
+                VECTOR_destroy(inbound);
+                result = __LINE__;
+            }
+            else
+            {
+                MESSAGE_HANDLE signal = NULL;
+                MAP_HANDLE properties = Map_Create(NULL);
+                if (properties != NULL)
+                {
+                    MESSAGE_CONFIG signal_config = { 0, NULL, properties };
+                    signal = Message_Create(&signal_config);
+                    Map_Destroy(properties);
+                }
+
+                if (signal == NULL)
+                {
+                    LogError("unable to create the inbound link signal");
+                    Lock_Deinit(module_info->inbound_lock);
+                    module_info->inbound_lock = NULL;
+                    VECTOR_destroy(inbound);
+                    result = __LINE__;
+                }
+                else
+                {
+                    (void)gateway_atomic_exchange_pointer(&module_info->link_signal, signal);
+                    module_info->inbound = inbound;
+                    result = 0;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/*makes the sink's worker drain a link with a queue*/
+static int add_inbound(BROKER_MODULEINFO* module_info, BROKER_LINK* link)
+{
+    int result;
+    if (init_inbound(module_info) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (Lock(module_info->inbound_lock) != LOCK_OK)
+    {
+        LogError("unable to lock inbound links");
+        result = __LINE__;
+    }
+    else
+    {
+        if (VECTOR_push_back(module_info->inbound, &link, 1) != 0)
+        {
+            LogError("unable to add an inbound link");
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        (void)Unlock(module_info->inbound_lock);
+    }
+    return result;
+}
+
+static int set_receive_capacity(int s, size_t queue_capacity)
+{
+    int buffer_size = (queue_capacity > (size_t)INT_MAX / sizeof(BROKER_MESSAGE_ENVELOPE)) ?
+        INT_MAX :
+        (int)(queue_capacity * sizeof(BROKER_MESSAGE_ENVELOPE));
+    return nn_setsockopt(s, NN_SOL_SOCKET, NN_RCVBUF, &buffer_size, sizeof(buffer_size));
+}
+
+static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE url, size_t queue_capacity)
 {
     BROKER_RESULT result;
 
-    /* Connect to pub/sub */
-    /*Codes_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]*/
-    module_info->receive_socket = nn_socket(AF_SP, NN_SUB);
-    if (module_info->receive_socket < 0)
+    /*Codes_SRS_BROKER_17_045: [ The function shall construct a module url consisting of BROKER_HANDLE_DATA::url + the quit signal GUID. ]*/
+    STRING_HANDLE module_url = STRING_construct(STRING_c_str(url));
+    if (module_url == NULL)
     {
         /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-        LogError("module receive socket create failed");
+        LogError("unable to construct module url");
+        result = BROKER_ERROR;
+    }
+    else if (STRING_concat_with_STRING(module_url, module_info->quit_message_guid) != 0)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        LogError("unable to append guid to module url");
+        STRING_delete(module_url);
         result = BROKER_ERROR;
     }
     else
     {
-        /*Codes_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]*/
-        int connect_result = nn_connect(module_info->receive_socket, STRING_c_str(url));
-        if (connect_result < 0)
+        /*Codes_SRS_BROKER_17_013: [ The function shall create a nanomsg NN_PAIR socket for reception. ]*/
+        module_info->receive_socket = nn_socket(AF_SP, NN_PAIR);
+        if (module_info->receive_socket < 0)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("module receive socket create failed");
+            result = BROKER_ERROR;
+        }
+        /*Codes_SRS_BROKER_17_069: [ If BROKER_HANDLE_DATA::queue_capacity is not 0, the function shall size the reception socket's buffer to hold that many envelopes. ]*/
+        else if (queue_capacity > 0 && set_receive_capacity(module_info->receive_socket, queue_capacity) < 0)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("unable to bound the module receive socket");
+            nn_really_close(module_info->receive_socket);
+            module_info->receive_socket = -1;
+            result = BROKER_ERROR;
+        }
+        /*Codes_SRS_BROKER_17_014: [ The function shall bind the reception socket to the module url. ]*/
+        else if (nn_bind(module_info->receive_socket, STRING_c_str(module_url)) < 0)
         {
             /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-            LogError("nn_connect failed");
+            LogError("nn_bind failed");
             nn_really_close(module_info->receive_socket);
             module_info->receive_socket = -1;
             result = BROKER_ERROR;
         }
         else
         {
-            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]*/
-            if (nn_setsockopt(
-                module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->quit_message_guid), STRING_length(module_info->quit_message_guid)) < 0)
+            /*Codes_SRS_BROKER_17_046: [ The function shall create a nanomsg NN_PAIR socket for delivery and connect it to the module url. ]*/
+            module_info->send_socket = nn_socket(AF_SP, NN_PAIR);
+            if (module_info->send_socket < 0)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("module send socket create failed");
+                nn_really_close(module_info->receive_socket);
+                module_info->receive_socket = -1;
+                result = BROKER_ERROR;
+            }
+            else if (nn_connect(module_info->send_socket, STRING_c_str(module_url)) < 0)
             {
                 /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                LogError("nn_setsockopt failed");
+                LogError("nn_connect failed");
+                nn_really_close(module_info->send_socket);
                 nn_really_close(module_info->receive_socket);
+                module_info->send_socket = -1;
                 module_info->receive_socket = -1;
                 result = BROKER_ERROR;
             }
@@ -402,6 +1353,7 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE
                 {
                     /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
                     LogError("ThreadAPI_Create failed");
+                    nn_really_close(module_info->send_socket);
                     nn_really_close(module_info->receive_socket);
                     result = BROKER_ERROR;
                 }
@@ -411,21 +1363,113 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE
                 }
             }
         }
-    }
-
-    return result;
+        STRING_delete(module_url);
+    }
+
+    return result;
+}
+
+static BROKER_RESULT start_ring_module(BROKER_MODULEINFO* module_info, size_t queue_capacity)
+{
+    BROKER_RESULT result;
+
+    module_info->receive_socket = -1;
+    module_info->send_socket = -1;
+    /*Codes_SRS_BROKER_17_058: [ On the ring engine, the function shall create BROKER_MODULEINFO::ring with BROKER_HANDLE_DATA::queue_capacity instead of any socket. ]*/
+    module_info->ring = MESSAGE_RING_create(queue_capacity);
+    if (module_info->ring == NULL)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        LogError("MESSAGE_RING_create failed");
+        result = BROKER_ERROR;
+    }
+    /*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
+    else if (ThreadAPI_Create(
+        &(module_info->thread),
+        ring_module_worker,
+        (void*)module_info
+    ) != THREADAPI_OK)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        LogError("ThreadAPI_Create failed");
+        MESSAGE_RING_destroy(module_info->ring);
+        module_info->ring = NULL;
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        result = BROKER_OK;
+    }
+
+    return result;
+}
+
+static BROKER_RESULT start_pool_module(BROKER_MODULEINFO* module_info, MODULE_SCHEDULER_HANDLE scheduler, size_t queue_capacity)
+{
+    BROKER_RESULT result;
+
+    module_info->receive_socket = -1;
+    module_info->send_socket = -1;
+    /*Codes_SRS_BROKER_17_104: [ On the pool engine, the function shall create BROKER_MODULEINFO::ring with BROKER_HANDLE_DATA::queue_capacity, which its task drains, instead of any socket. ]*/
+    module_info->ring = MESSAGE_RING_create(queue_capacity);
+    if (module_info->ring == NULL)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        LogError("MESSAGE_RING_create failed");
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_088: [ On the pool engine, the function shall add a pool_module_run task for the module to BROKER_HANDLE_DATA::scheduler instead of starting a thread. ]*/
+        module_info->task = MODULE_SCHEDULER_add_task(scheduler, pool_module_run, module_info);
+        if (module_info->task == NULL)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("MODULE_SCHEDULER_add_task failed");
+            MESSAGE_RING_destroy(module_info->ring);
+            module_info->ring = NULL;
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            result = BROKER_OK;
+        }
+    }
+
+    return result;
+}
+
+/*releases every envelope still waiting on the module's receive_socket*/
+static void drain_module(BROKER_MODULEINFO* module_info)
+{
+    int nbytes;
+    do
+    {
+        unsigned char *buf = NULL;
+        nbytes = nn_recv(module_info->receive_socket, (void *)&buf, NN_MSG, NN_DONTWAIT);
+        if (nbytes >= 0)
+        {
+            if ((size_t)nbytes % sizeof(BROKER_MESSAGE_ENVELOPE) == 0)
+            {
+                destroy_envelopes(buf, (size_t)nbytes / sizeof(BROKER_MESSAGE_ENVELOPE));
+            }
+            nn_freemsg(buf);
+        }
+    } while (nbytes >= 0 || nn_errno() == EINTR);
 }
 
 /*stop module means: stop the thread that feeds messages to Module_Receive function + deletion of all queued messages */
 /*returns 0 if success, otherwise __LINE__*/
-static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
+static int stop_module(BROKER_MODULEINFO* module_info)
 {
     int  quit_result, close_result, thread_result, result;
 
-    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
+    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the module's send_socket. ]*/
     /* send the unique quite id for this module */
-    if ((quit_result = nn_really_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
+    if ((quit_result = nn_really_send(module_info->send_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, NN_DONTWAIT)) < 0)
     {
+        /*Codes_SRS_BROKER_17_048: [ This function shall destroy every message left undelivered on BROKER_MODULEINFO::receive_socket. ]*/
+        drain_module(module_info);
         /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
         /* at the cost of a data race, we will close the socket to terminate the thread */
         nn_really_close(module_info->receive_socket);
@@ -436,6 +1480,8 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
         /*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]*/
         if (Lock(module_info->socket_lock) != LOCK_OK)
         {
+            /*Codes_SRS_BROKER_17_048: [ This function shall destroy every message left undelivered on BROKER_MODULEINFO::receive_socket. ]*/
+            drain_module(module_info);
             /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
             /* at the cost of a data race, we will close the socket to terminate the thread */
             nn_really_close(module_info->receive_socket);
@@ -443,6 +1489,8 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
         }
         else
         {
+            /*Codes_SRS_BROKER_17_048: [ This function shall destroy every message left undelivered on BROKER_MODULEINFO::receive_socket. ]*/
+            drain_module(module_info);
             /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
             close_result = nn_really_close(module_info->receive_socket);
             if (close_result < 0)
@@ -460,6 +1508,28 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
             }
         }
     }
+    /*Codes_SRS_BROKER_17_049: [ This function shall close the BROKER_MODULEINFO::send_socket. ]*/
+    nn_really_close(module_info->send_socket);
+    /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
+    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+    {
+        result = __LINE__;
+        LogError("ThreadAPI_Join() returned an error.");
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/*returns 0 if success, otherwise __LINE__*/
+static int stop_ring_module(BROKER_MODULEINFO* module_info)
+{
+    int thread_result, result;
+
+    /*Codes_SRS_BROKER_17_059: [ On the ring engine, this function shall close BROKER_MODULEINFO::ring to stop the worker thread. ]*/
+    MESSAGE_RING_close(module_info->ring);
     /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
     if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
     {
@@ -468,11 +1538,24 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
     }
     else
     {
+        /*Codes_SRS_BROKER_17_060: [ On the ring engine, this function shall destroy BROKER_MODULEINFO::ring along with every message left undelivered. ]*/
+        MESSAGE_RING_destroy(module_info->ring);
+        module_info->ring = NULL;
         result = 0;
     }
     return result;
 }
 
+static void stop_pool_module(BROKER_MODULEINFO* module_info)
+{
+    /*Codes_SRS_BROKER_17_089: [ On the pool engine, this function shall close BROKER_MODULEINFO::ring, wait for the module's task to finish with MODULE_SCHEDULER_remove_task, then destroy the ring along with every message left undelivered. ]*/
+    MESSAGE_RING_close(module_info->ring);
+    MODULE_SCHEDULER_remove_task(module_info->task);
+    module_info->task = NULL;
+    MESSAGE_RING_destroy(module_info->ring);
+    module_info->ring = NULL;
+}
+
 BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
 {
     BROKER_RESULT result;
@@ -533,7 +1616,12 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                     }
                     else
                     {
-                        if (start_module(module_info, broker_data->url) != BROKER_OK)
+                        BROKER_RESULT start_result = (broker_data->engine == BROKER_ENGINE_POOL) ?
+                            start_pool_module(module_info, broker_data->scheduler, broker_data->queue_capacity) :
+                            (broker_data->engine == BROKER_ENGINE_RING) ?
+                            start_ring_module(module_info, broker_data->queue_capacity) :
+                            start_module(module_info, broker_data->url, broker_data->queue_capacity);
+                        if (start_result != BROKER_OK)
                         {
                             LogError("start_module failed");
                             deinit_module(module_info);
@@ -565,6 +1653,63 @@ static bool find_module_predicate(LIST_ITEM_HANDLE list_item, const void* value)
     return element->module->module_handle == ((MODULE*)value)->module_handle;
 }
 
+/*takes a link out of service, it is destroyed by the next routes_swap*/
+static void retire_link(BROKER_LINK* link)
+{
+    /*Codes_SRS_BROKER_17_075: [ Removing a link shall release every publisher blocked on it. ]*/
+    link->retired = true;
+    link_detach(link);
+}
+
+static void unlink_module(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info)
+{
+    size_t sink_count;
+    size_t i;
+    LIST_ITEM_HANDLE source_item = singlylinkedlist_get_head_item(broker_data->modules);
+    while (source_item != NULL)
+    {
+        BROKER_MODULEINFO* source_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(source_item);
+        BROKER_LINK** sink = (BROKER_LINK**)VECTOR_find_if(source_info->sinks, find_sink_predicate, module_info);
+        if (sink != NULL)
+        {
+            retire_link(*sink);
+            VECTOR_erase(source_info->sinks, sink, 1);
+            broker_data->link_count--;
+        }
+        source_item = singlylinkedlist_get_next_item(source_item);
+    }
+
+    /*the module's own links go with it*/
+    sink_count = VECTOR_size(module_info->sinks);
+    for (i = 0; i < sink_count; i++)
+    {
+        retire_link(*(BROKER_LINK**)VECTOR_element(module_info->sinks, i));
+    }
+    broker_data->link_count -= sink_count;
+}
+
+/*copies the sinks of every module in BROKER_HANDLE_DATA::modules into routes, which has room for link_count links*/
+static void routes_fill(BROKER_ROUTES* routes, size_t link_count, SINGLYLINKEDLIST_HANDLE modules)
+{
+    BROKER_LINK** sink_storage = (BROKER_LINK**)(routes->routes + link_count);
+    LIST_ITEM_HANDLE module_item = singlylinkedlist_get_head_item(modules);
+    while (module_item != NULL)
+    {
+        BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_item);
+        size_t sink_count = VECTOR_size(module_info->sinks);
+        if (sink_count > 0)
+        {
+            BROKER_ROUTE* route = &routes->routes[routes->route_count++];
+            route->source = module_info->module->module_handle;
+            route->sink_count = sink_count;
+            route->sinks = sink_storage;
+            memcpy(sink_storage, VECTOR_front(module_info->sinks), sink_count * sizeof(BROKER_LINK*));
+            sink_storage += sink_count;
+        }
+        module_item = singlylinkedlist_get_next_item(module_item);
+    }
+}
+
 BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
 {
     /*Codes_SRS_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
@@ -599,21 +1744,48 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
             else
             {
                 BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
-                if (stop_module(broker_data->publish_socket, module_info) == 0)
+                /*Codes_SRS_BROKER_17_063: [ Broker_RemoveModule shall allocate a new routing snapshot before changing any link. ]*/
+                BROKER_ROUTES* routes = routes_alloc(broker_data->link_count);
+                if (routes == NULL)
                 {
-                    deinit_module(module_info);
+                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                    result = BROKER_ERROR;
                 }
                 else
                 {
-                    LogError("unable to stop module");
-                }
+                    /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                    singlylinkedlist_remove(broker_data->modules, module_info_item);
+                    /*Codes_SRS_BROKER_17_051: [ Broker_RemoveModule shall remove the module from the sinks of every module in BROKER_HANDLE_DATA::modules. ]*/
+                    unlink_module(broker_data, module_info);
+                    /*Codes_SRS_BROKER_17_064: [ Broker_RemoveModule shall swap in the new routing snapshot and wait until no Broker_Publish call still reads the previous one before stopping the module. ]*/
+                    routes_fill(routes, broker_data->link_count, broker_data->modules);
+                    routes_swap(broker_data, routes);
 
-                /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
-                singlylinkedlist_remove(broker_data->modules, module_info_item);
-                free(module_info);
+                    int stop_result;
+                    if (module_info->task != NULL)
+                    {
+                        stop_pool_module(module_info);
+                        stop_result = 0;
+                    }
+                    else
+                    {
+                        stop_result = (module_info->ring != NULL) ?
+                            stop_ring_module(module_info) :
+                            stop_module(module_info);
+                    }
+                    if (stop_result == 0)
+                    {
+                        deinit_module(module_info);
+                    }
+                    else
+                    {
+                        LogError("unable to stop module");
+                    }
+                    free(module_info);
 
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                result = BROKER_OK;
+                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                    result = BROKER_OK;
+                }
             }
 
             /*Codes_SRS_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
@@ -643,20 +1815,47 @@ BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_
     return result;
 }
 
-BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+static BROKER_RESULT add_link(BROKER_HANDLE broker, const BROKER_LINK_DATA_EX* link)
 {
     BROKER_RESULT result;
     /*Codes_SRS_BROKER_17_029: [ If broker or link are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]*/
-    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    if (broker == NULL || link->base.module_sink_handle == NULL || link->base.module_source_handle == NULL)
     {
         LogError("Broker_AddLink, input is NULL.");
         result = BROKER_INVALIDARG;
     }
+    /*Codes_SRS_BROKER_17_070: [ If link->queue has a capacity and an unknown overflow policy, BROKER_OVERFLOW_CONFLATE without a conflate_key, or a capacity too large to allocate, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]*/
+    else if (link->queue != NULL && link->queue->capacity > 0 &&
+        ((link->queue->overflow != BROKER_OVERFLOW_DROP_NEWEST &&
+          link->queue->overflow != BROKER_OVERFLOW_DROP_OLDEST &&
+          link->queue->overflow != BROKER_OVERFLOW_BLOCK &&
+          link->queue->overflow != BROKER_OVERFLOW_CONFLATE) ||
+         (link->queue->overflow == BROKER_OVERFLOW_CONFLATE && link->queue->conflate_key == NULL) ||
+         link->queue->capacity > SIZE_MAX / sizeof(BROKER_LINK_SLOT)))
+    {
+        LogError("Broker_AddLink, invalid link queue.");
+        result = BROKER_INVALIDARG;
+    }
+    /*Codes_SRS_BROKER_17_090: [ On the pool engine, if link->queue has a capacity and BROKER_OVERFLOW_BLOCK, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]*/
+    else if (link->queue != NULL && link->queue->capacity > 0 &&
+        link->queue->overflow == BROKER_OVERFLOW_BLOCK && ((BROKER_HANDLE_DATA*)broker)->engine == BROKER_ENGINE_POOL)
+    {
+        /*a blocked publisher would hold a worker the sink may need to make room*/
+        LogError("Broker_AddLink, blocking links are not supported on the pool engine.");
+        result = BROKER_INVALIDARG;
+    }
     else
     {
         BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        LINK_FILTER_HANDLE filter = NULL;
+        /*Codes_SRS_BROKER_17_097: [ If link->filter is not NULL, Broker_AddLinkEx shall compile it with LINK_FILTER_create before locking, and return BROKER_INVALIDARG if that fails. ]*/
+        if (link->filter != NULL && (filter = LINK_FILTER_create(link->filter)) == NULL)
+        {
+            LogError("Broker_AddLink, invalid link filter.");
+            result = BROKER_INVALIDARG;
+        }
         /*Codes_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]*/
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        else if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
             /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
             LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
@@ -665,7 +1864,7 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
         else
         {
             /*Codes_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->sink. ]*/
-            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->base.module_sink_handle);
 
             if (module_info == NULL)
             {
@@ -676,7 +1875,7 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
             else
             {
                 /*Codes_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]*/
-                BROKER_MODULEINFO* source_module = broker_locate_handle(broker_data, link->module_source_handle);
+                BROKER_MODULEINFO* source_module = broker_locate_handle(broker_data, link->base.module_source_handle);
 
                 if (source_module == NULL)
                 {
@@ -685,16 +1884,49 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    BROKER_ROUTES* routes;
+                    BROKER_LINK* new_link;
+                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall add the link->module_sink_handle module_info to the sinks of the link->module_source_handle module_info, unless it is already there. ]*/
+                    if (VECTOR_find_if(source_module->sinks, find_sink_predicate, module_info) != NULL)
+                    {
+                        result = BROKER_OK;
+                    }
+                    /*Codes_SRS_BROKER_17_065: [ Broker_AddLink shall allocate a new routing snapshot with room for the new link. ]*/
+                    else if ((routes = routes_alloc(broker_data->link_count + 1)) == NULL)
+                    {
+                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    /*Codes_SRS_BROKER_17_079: [ Broker_AddLink shall create a BROKER_LINK for the sink, with a queue of link->queue->capacity messages if that is not 0. ]*/
+                    /*Codes_SRS_BROKER_17_098: [ The BROKER_LINK shall own the compiled filter and destroy it when the link is destroyed. ]*/
+                    else if ((new_link = link_create(module_info, link->queue, &filter)) == NULL)
+                    {
+                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                        free(routes);
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else if (new_link->capacity > 0 && add_inbound(module_info, new_link) != 0)
+                    {
+                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                        link_destroy(new_link);
+                        free(routes);
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else if (VECTOR_push_back(source_module->sinks, &new_link, 1) != 0)
                     {
                         /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
                         LogError("Unable to make link in Broker");
+                        link_detach(new_link);
+                        link_destroy(new_link);
+                        free(routes);
                         result = BROKER_ADD_LINK_ERROR;
                     }
                     else
                     {
+                        /*Codes_SRS_BROKER_17_066: [ Broker_AddLink shall fill the new routing snapshot from the sinks of every module and swap it in. ]*/
+                        broker_data->link_count++;
+                        routes_fill(routes, broker_data->link_count, broker_data->modules);
+                        routes_swap(broker_data, routes);
                         result = BROKER_OK;
                     }
                 }
@@ -702,6 +1934,46 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
             /*Codes_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]*/
             Unlock(broker_data->modules_lock);
         }
+
+        /*Codes_SRS_BROKER_17_099: [ If no BROKER_LINK took the compiled filter, Broker_AddLinkEx shall destroy it. ]*/
+        if (filter != NULL)
+        {
+            LINK_FILTER_destroy(filter);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    if (link == NULL)
+    {
+        /*Codes_SRS_BROKER_17_029: [ If broker or link are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]*/
+        LogError("Broker_AddLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_105: [ Broker_AddLink shall add the link as Broker_AddLinkEx would, with no queue and no filter. ]*/
+        BROKER_LINK_DATA_EX link_ex = { { link->module_source_handle, link->module_sink_handle }, NULL, NULL };
+        result = add_link(broker, &link_ex);
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddLinkEx(BROKER_HANDLE broker, const BROKER_LINK_DATA_EX* link)
+{
+    BROKER_RESULT result;
+    if (link == NULL)
+    {
+        /*Codes_SRS_BROKER_17_106: [ If broker, link, link->base.module_source_handle or link->base.module_sink_handle are NULL, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]*/
+        LogError("Broker_AddLinkEx, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        result = add_link(broker, link);
     }
     return result;
 }
@@ -747,16 +2019,29 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    BROKER_ROUTES* routes;
+                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall remove the link->module_sink_handle module_info from the sinks of the link->module_source_handle module_info. ]*/
+                    BROKER_LINK** sink = (BROKER_LINK**)VECTOR_find_if(source_module_info->sinks, find_sink_predicate, module_info);
+                    if (sink == NULL)
+                    {
+                        /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                        LogError("Link does not exist in Broker");
+                        result = BROKER_REMOVE_LINK_ERROR;
+                    }
+                    /*Codes_SRS_BROKER_17_067: [ Broker_RemoveLink shall allocate a new routing snapshot before removing the link. ]*/
+                    else if ((routes = routes_alloc(broker_data->link_count)) == NULL)
                     {
                         /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
-                        LogError("Unable to make link in Broker");
                         result = BROKER_REMOVE_LINK_ERROR;
                     }
                     else
                     {
+                        retire_link(*sink);
+                        VECTOR_erase(source_module_info->sinks, sink, 1);
+                        broker_data->link_count--;
+                        /*Codes_SRS_BROKER_17_068: [ Broker_RemoveLink shall fill the new routing snapshot from the sinks of every module and swap it in. ]*/
+                        routes_fill(routes, broker_data->link_count, broker_data->modules);
+                        routes_swap(broker_data, routes);
                         result = BROKER_OK;
                     }
                 }
@@ -768,6 +2053,49 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
     return result;
 }
 
+BROKER_RESULT Broker_GetLinkDropCount(BROKER_HANDLE broker, const BROKER_LINK_DATA* link, size_t* dropped)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_081: [ If broker, link, link->module_source_handle, link->module_sink_handle or dropped are NULL, Broker_GetLinkDropCount shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL || dropped == NULL)
+    {
+        LogError("Broker_GetLinkDropCount, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_082: [ Broker_GetLinkDropCount shall lock the modules_lock while it looks for the link. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            LogError("Broker_GetLinkDropCount, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* source_module_info = broker_locate_handle(broker_data, link->module_source_handle);
+            BROKER_LINK** sink = (module_info == NULL || source_module_info == NULL) ?
+                NULL :
+                (BROKER_LINK**)VECTOR_find_if(source_module_info->sinks, find_sink_predicate, module_info);
+            if (sink == NULL)
+            {
+                /*Codes_SRS_BROKER_17_083: [ Broker_GetLinkDropCount shall return BROKER_ERROR if the link does not exist. ]*/
+                LogError("Link does not exist in Broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_084: [ Broker_GetLinkDropCount shall store in dropped the number of messages the link has discarded or failed to deliver, and return BROKER_OK. ]*/
+                *dropped = gateway_atomic_load(&(*sink)->dropped);
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
 static void broker_decrement_ref(BROKER_HANDLE broker)
 {
     /*Codes_SRS_BROKER_13_058: [If `broker` is NULL the function shall do nothing.]*/
@@ -782,11 +2110,17 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
             {
                 LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
             }
-            /* May want to do nn_shutdown first for cleanliness. */
-            nn_really_close(broker_data->publish_socket);
+            if (broker_data->scheduler != NULL)
+            {
+                /*Codes_SRS_BROKER_17_091: [ On the pool engine, Broker_Destroy shall destroy the module scheduler. ]*/
+                MODULE_SCHEDULER_destroy(broker_data->scheduler);
+            }
             STRING_delete(broker_data->url);
             singlylinkedlist_destroy(broker_data->modules);
             Lock_Deinit(broker_data->modules_lock);
+            Condition_Deinit(broker_data->readers_gone);
+            Lock_Deinit(broker_data->swap_lock);
+            free(broker_data->routes);
             free(broker_data);
         }
     }
@@ -807,84 +2141,184 @@ extern void Broker_DecRef(BROKER_HANDLE broker)
     broker_decrement_ref(broker);
 }
 
-BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
+/*delivers clones of messages from source to the sink of one link*/
+static BROKER_RESULT publish_to_link(BROKER_LINK* sink_link, MESSAGE_HANDLE* messages, size_t count)
 {
-    BROKER_RESULT result;
-    /*Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]*/
-    if (broker == NULL || source == NULL || message == NULL)
-    {
-        result = BROKER_INVALIDARG;
-        LogError("Broker handle, source, and/or message handle is NULL");
-    }
-    else
+    BROKER_RESULT result = BROKER_OK;
+    size_t first;
+    for (first = 0; first < count; first += BROKER_BATCH_SIZE)
     {
-        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]*/
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        MESSAGE_HANDLE clones[BROKER_BATCH_SIZE];
+        size_t clone_count = 0;
+        size_t last = (count - first > BROKER_BATCH_SIZE) ? first + BROKER_BATCH_SIZE : count;
+        size_t j;
+        for (j = first; j < last; j++)
         {
-            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-            LogError("Lock on broker_data->modules_lock failed");
-            result = BROKER_ERROR;
+            MESSAGE_HANDLE clone;
+            /*Codes_SRS_BROKER_17_100: [ If the link has a filter, Broker_Publish shall deliver only messages that LINK_FILTER_matches accepts to its sink, without counting the others as dropped. ]*/
+            if (sink_link->filter != NULL && !LINK_FILTER_matches(sink_link->filter, messages[j]))
+            {
+                /*not for this sink*/
+            }
+            /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message once for every sink of source. ]*/
+            else if ((clone = Message_Clone(messages[j])) == NULL)
+            {
+                /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("unable to clone a message [%p]", messages[j]);
+                (void)gateway_atomic_increment(&sink_link->dropped);
+                result = BROKER_ERROR;
+            }
+            else if (sink_link->capacity > 0)
+            {
+                /*Codes_SRS_BROKER_17_080: [ If the link has a queue, Broker_Publish shall queue the clone on the link, apply the link's overflow policy, and return BROKER_OK for messages the policy discards. ]*/
+                link_enqueue(sink_link, clone);
+            }
+            else
+            {
+                clones[clone_count++] = clone;
+            }
         }
-        else
+
+        if (clone_count > 0)
         {
-            int32_t msg_size;
-            int32_t buf_size;
-            /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
-            MESSAGE_HANDLE msg = Message_Clone(message);
-            /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
-            msg_size = Message_ToByteArray(message, NULL, 0);
-            if (msg_size < 0)
-            {
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                LogError("unable to serialize a message [%p]", msg);
-                Message_Destroy(msg);
+            /*Codes_SRS_BROKER_17_012: [ If the envelope could not be sent, Broker_Publish shall destroy the clone and continue with the remaining sinks. ]*/
+            size_t lost = deliver_to_module(sink_link->sink, clones, clone_count);
+            if (lost > 0)
+            {
+                LogError("unable to deliver %zu message(s) to module [%p]", lost, sink_link->sink->module->module_handle);
                 result = BROKER_ERROR;
+                for (; lost > 0; lost--)
+                {
+                    (void)gateway_atomic_increment(&sink_link->dropped);
+                }
             }
-            else
+            /*the sink's worker owns the other clones now*/
+        }
+    }
+    return result;
+}
+
+/*delivers messages from source to every sink of source, reading the routing snapshot once*/
+static BROKER_RESULT publish_messages(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source, MESSAGE_HANDLE* messages, size_t count)
+{
+    BROKER_RESULT result = BROKER_OK;
+    uint32_t reader_slot;
+    size_t i;
+    /*links the publisher may block on, published to after the snapshot is released*/
+    BROKER_LINK** blocking = NULL;
+    size_t blocking_count = 0;
+    /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall acquire the current routing snapshot without taking a lock. ]*/
+    BROKER_ROUTES* routes = routes_acquire(broker_data, &reader_slot);
+    BROKER_ROUTE* route = NULL;
+
+    /*Codes_SRS_BROKER_17_052: [ Broker_Publish shall find the route for source in the routing snapshot. ]*/
+    for (i = 0; i < routes->route_count; i++)
+    {
+        if (routes->routes[i].source == source)
+        {
+            route = &routes->routes[i];
+            break;
+        }
+    }
+
+    /*Codes_SRS_BROKER_17_053: [ If source has no route, Broker_Publish shall deliver the message to no module and return BROKER_OK. ]*/
+    if (route != NULL)
+    {
+        for (i = 0; i < route->sink_count; i++)
+        {
+            BROKER_LINK* sink_link = route->sinks[i];
+            if (sink_link->capacity > 0 && sink_link->overflow == BROKER_OVERFLOW_BLOCK)
             {
-                /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
-                buf_size = msg_size + sizeof(MODULE_HANDLE);
-                void* nn_msg = nn_allocmsg(buf_size, 0);
-                if (nn_msg == NULL)
+                if (blocking == NULL &&
+                    (blocking = (BROKER_LINK**)malloc(route->sink_count * sizeof(BROKER_LINK*))) == NULL)
                 {
-                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                    LogError("unable to serialize a message [%p]", msg);
+                    /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    size_t lost;
+                    LogError("unable to allocate the links to publish to after the routing snapshot");
+                    for (lost = 0; lost < count; lost++)
+                    {
+                        (void)gateway_atomic_increment(&sink_link->dropped);
+                    }
                     result = BROKER_ERROR;
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
-                    unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-                    memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
-                    /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
-                    nn_msg_bytes += sizeof(MODULE_HANDLE);
-                    Message_ToByteArray(message, nn_msg_bytes, msg_size);
-
-                    /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
-                    int nbytes = nn_really_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
-                    if (nbytes != buf_size)
-                    {
-                        /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("unable to send a message [%p]", msg);
-                        /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                        nn_freemsg(nn_msg);
-                        result = BROKER_ERROR;
-                    }
-                    else
-                    {
-                        result = BROKER_OK;
-                    }
+                    /*Codes_SRS_BROKER_17_103: [ Broker_Publish shall take a reference on every link with BROKER_OVERFLOW_BLOCK and queue on it only after releasing the routing snapshot, then release the reference. ]*/
+                    link_acquire(sink_link);
+                    blocking[blocking_count++] = sink_link;
                 }
-                /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                Message_Destroy(msg);
-                /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
             }
-            /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
-            Unlock(broker_data->modules_lock);
+            else if (publish_to_link(sink_link, messages, count) != BROKER_OK)
+            {
+                result = BROKER_ERROR;
+            }
+        }
+    }
+
+    /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall release the routing snapshot. ]*/
+    routes_release(broker_data, reader_slot);
+
+    for (i = 0; i < blocking_count; i++)
+    {
+        /*a removed link releases the publisher, and is destroyed here if it was the last to hold it*/
+        if (publish_to_link(blocking[i], messages, count) != BROKER_OK)
+        {
+            result = BROKER_ERROR;
         }
+        link_release(blocking[i]);
+    }
+    if (blocking != NULL)
+    {
+        free(blocking);
+    }
+    return result;
+}
 
+BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || source == NULL || message == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("Broker handle, source, and/or message handle is NULL");
+    }
+    else
+    {
+        result = publish_messages((BROKER_HANDLE_DATA*)broker, source, &message, 1);
     }
     /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
     return result;
 }
+
+BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE* messages, size_t count)
+{
+    BROKER_RESULT result;
+    size_t i;
+    /*Codes_SRS_BROKER_17_092: [ If broker, source or messages is NULL, or any of the count messages is NULL, Broker_PublishBatch shall return BROKER_INVALIDARG without publishing any message. ]*/
+    if (broker == NULL || source == NULL || messages == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("Broker handle, source, and/or messages is NULL");
+    }
+    else
+    {
+        i = 0;
+        while (i < count && messages[i] != NULL)
+        {
+            i++;
+        }
+
+        if (i < count)
+        {
+            result = BROKER_INVALIDARG;
+            LogError("message %zu of the batch is NULL", i);
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_096: [ Otherwise Broker_PublishBatch shall deliver every message as Broker_Publish would, in order, reading the routing snapshot once. ]*/
+            result = publish_messages((BROKER_HANDLE_DATA*)broker, source, messages, count);
+        }
+    }
+    return result;
+}
@@ -158,7 +158,7 @@ GATEWAY_HANDLE Gateway_Create(const GATEWAY_PROPERTIES* properties)
     }
     else
     {
-        result = gateway_create_internal(properties, false);
+        result = gateway_create_internal(properties, false, false);
         if (result == NULL)
         {
             /* Codes_SRS_GATEWAY_27_027: [ Launch - This function shall join any spawned threads upon any failure. ] */
@@ -322,15 +322,15 @@ int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name)
     return result;
 }
 
-GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+static GATEWAY_ADD_LINK_RESULT add_link(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY_EX* entryLink)
 {
     GATEWAY_ADD_LINK_RESULT result;
 
-    if (gw == NULL || entryLink == NULL || entryLink->module_source == NULL || entryLink->module_sink == NULL)
+    if (gw == NULL || entryLink->base.module_source == NULL || entryLink->base.module_sink == NULL)
     {
         /*Codes_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
         result = GATEWAY_ADD_LINK_INVALID_ARG;
-        LogError("Failed to add link because either the GATEWAY_HANDLE is NULL, entryLink, module_source string is NULL or empty or module_sink is NULL or empty. gw = %p, module_source = '%s', module_sink = '%s'.", gw, entryLink, (entryLink != NULL)? entryLink->module_source:NULL, (entryLink != NULL) ? entryLink->module_sink : NULL);
+        LogError("Failed to add link because either the GATEWAY_HANDLE is NULL, module_source string is NULL or empty or module_sink is NULL or empty. gw = %p, module_source = '%s', module_sink = '%s'.", gw, entryLink->base.module_source, entryLink->base.module_sink);
     }
     else
     {
@@ -352,6 +352,44 @@ GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_EN
     return result;
 }
 
+GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+{
+    GATEWAY_ADD_LINK_RESULT result;
+
+    if (entryLink == NULL)
+    {
+        /*Codes_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
+        result = GATEWAY_ADD_LINK_INVALID_ARG;
+        LogError("Failed to add link because entryLink is NULL. gw = %p.", gw);
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_17_025: [ Gateway_AddLink shall add the link as Gateway_AddLinkEx would, with a queue of zero capacity and no filter. ]*/
+        GATEWAY_LINK_ENTRY_EX entryLinkEx = { { entryLink->module_source, entryLink->module_sink }, { 0, BROKER_OVERFLOW_DROP_NEWEST, NULL }, NULL };
+        result = add_link(gw, &entryLinkEx);
+    }
+
+    return result;
+}
+
+GATEWAY_ADD_LINK_RESULT Gateway_AddLinkEx(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY_EX* entryLink)
+{
+    GATEWAY_ADD_LINK_RESULT result;
+
+    if (entryLink == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_026: [ If gw, entryLink, entryLink->base.module_source or entryLink->base.module_sink is NULL, Gateway_AddLinkEx shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
+        result = GATEWAY_ADD_LINK_INVALID_ARG;
+        LogError("Failed to add link because entryLink is NULL. gw = %p.", gw);
+    }
+    else
+    {
+        result = add_link(gw, entryLink);
+    }
+
+    return result;
+}
+
 void Gateway_RemoveLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
 {
     /*Codes_SRS_GATEWAY_04_005: [ If gw or entryLink is NULL the function shall return. ]*/
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*Minimal atomic operations shared by the lock-free parts of the gateway core
+ *(message ring, broker routing snapshots, message pool and properties).
+ *Every operation is at least acquire/release; gateway_atomic_fence is a full
+ *barrier.
+ */
+
+#ifndef GATEWAY_ATOMIC_H
+#define GATEWAY_ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#define GATEWAY_ATOMIC_INLINE static __inline
+#else
+#define GATEWAY_ATOMIC_INLINE static inline
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef _MSC_VER
+typedef volatile LONG GATEWAY_ATOMIC_U32;
+
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_load(GATEWAY_ATOMIC_U32* counter)
+{
+    return (uint32_t)InterlockedOr(counter, 0);
+}
+
+GATEWAY_ATOMIC_INLINE void gateway_atomic_store(GATEWAY_ATOMIC_U32* counter, uint32_t value)
+{
+    (void)InterlockedExchange(counter, (LONG)value);
+}
+
+GATEWAY_ATOMIC_INLINE bool gateway_atomic_compare_exchange(GATEWAY_ATOMIC_U32* counter, uint32_t expected, uint32_t desired)
+{
+    return (uint32_t)InterlockedCompareExchange(counter, (LONG)desired, (LONG)expected) == expected;
+}
+
+/*returns the incremented value*/
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_increment(GATEWAY_ATOMIC_U32* counter)
+{
+    return (uint32_t)InterlockedIncrement(counter);
+}
+
+/*returns the decremented value*/
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_decrement(GATEWAY_ATOMIC_U32* counter)
+{
+    return (uint32_t)InterlockedDecrement(counter);
+}
+
+GATEWAY_ATOMIC_INLINE void* gateway_atomic_load_pointer(void* volatile* location)
+{
+    return InterlockedCompareExchangePointer(location, NULL, NULL);
+}
+
+/*returns the previous value*/
+GATEWAY_ATOMIC_INLINE void* gateway_atomic_exchange_pointer(void* volatile* location, void* value)
+{
+    return InterlockedExchangePointer(location, value);
+}
+
+GATEWAY_ATOMIC_INLINE bool gateway_atomic_compare_exchange_pointer(void* volatile* location, void* expected, void* desired)
+{
+    return InterlockedCompareExchangePointer(location, desired, expected) == expected;
+}
+
+GATEWAY_ATOMIC_INLINE void gateway_atomic_fence(void)
+{
+    MemoryBarrier();
+}
+#else
+typedef volatile uint32_t GATEWAY_ATOMIC_U32;
+
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_load(GATEWAY_ATOMIC_U32* counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+}
+
+GATEWAY_ATOMIC_INLINE void gateway_atomic_store(GATEWAY_ATOMIC_U32* counter, uint32_t value)
+{
+    __atomic_store_n(counter, value, __ATOMIC_RELEASE);
+}
+
+GATEWAY_ATOMIC_INLINE bool gateway_atomic_compare_exchange(GATEWAY_ATOMIC_U32* counter, uint32_t expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(counter, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/*returns the incremented value*/
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_increment(GATEWAY_ATOMIC_U32* counter)
+{
+    return __atomic_add_fetch(counter, 1, __ATOMIC_SEQ_CST);
+}
+
+/*returns the decremented value*/
+GATEWAY_ATOMIC_INLINE uint32_t gateway_atomic_decrement(GATEWAY_ATOMIC_U32* counter)
+{
+    return __atomic_sub_fetch(counter, 1, __ATOMIC_SEQ_CST);
+}
+
+GATEWAY_ATOMIC_INLINE void* gateway_atomic_load_pointer(void* volatile* location)
+{
+    return __atomic_load_n(location, __ATOMIC_ACQUIRE);
+}
+
+/*returns the previous value*/
+GATEWAY_ATOMIC_INLINE void* gateway_atomic_exchange_pointer(void* volatile* location, void* value)
+{
+    return __atomic_exchange_n(location, value, __ATOMIC_SEQ_CST);
+}
+
+GATEWAY_ATOMIC_INLINE bool gateway_atomic_compare_exchange_pointer(void* volatile* location, void* expected, void* desired)
+{
+    return __atomic_compare_exchange_n(location, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+GATEWAY_ATOMIC_INLINE void gateway_atomic_fence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*GATEWAY_ATOMIC_H*/
@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
@@ -24,6 +26,16 @@
 #define LINKS_KEY "links"
 #define SOURCE_KEY "source"
 #define SINK_KEY "sink"
+#define QUEUE_KEY "queue"
+#define QUEUE_CAPACITY_KEY "capacity"
+#define QUEUE_OVERFLOW_KEY "overflow"
+#define QUEUE_CONFLATE_KEY "key"
+#define FILTER_KEY "filter"
+
+#define BROKER_KEY "broker"
+#define BROKER_ENGINE_KEY "engine"
+#define BROKER_CAPACITY_KEY "capacity"
+#define BROKER_WORKERS_KEY "workers"
 
 #define PARSE_JSON_RESULT_VALUES \
     PARSE_JSON_SUCCESS, \
@@ -34,8 +46,8 @@
 
 DEFINE_ENUM(PARSE_JSON_RESULT, PARSE_JSON_RESULT_VALUES);
 
-GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
-static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root);
+GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json, bool links_ex);
+static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, BROKER_CONFIG* out_broker_config, JSON_Value *root);
 static void destroy_properties_internal(GATEWAY_PROPERTIES* properties);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
 
@@ -65,13 +77,15 @@ GATEWAY_HANDLE Gateway_CreateFromJson(const char* file_path)
 
                 if (properties != NULL)
                 {
+                    BROKER_CONFIG broker_config;
                     properties->gateway_modules = NULL;
                     properties->gateway_links = NULL;
-                    if ((parse_json_internal(properties, root_value) == PARSE_JSON_SUCCESS) && properties->gateway_modules != NULL && properties->gateway_links != NULL)
+                    properties->broker_config = NULL;
+                    if ((parse_json_internal(properties, &broker_config, root_value) == PARSE_JSON_SUCCESS) && properties->gateway_modules != NULL && properties->gateway_links != NULL)
                     {
                         /*Codes_SRS_GATEWAY_JSON_14_007: [The function shall use the GATEWAY_PROPERTIES instance to create and return a GATEWAY_HANDLE using the lower level API.]*/
                         /*Codes_SRS_GATEWAY_JSON_17_004: [ The function shall set the module loader to the default dynamically linked library module loader. ]*/
-                        gw = gateway_create_internal(properties, true);
+                        gw = gateway_create_internal(properties, true, true);
 
                         if (gw == NULL)
                         {
@@ -186,9 +200,10 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
             {
                 properties->gateway_modules = NULL;
                 properties->gateway_links = NULL;
+                properties->broker_config = NULL;
                 /* Codes_SRS_GATEWAY_JSON_04_007: [ The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance. ] */
                 /* Codes_SRS_GATEWAY_JSON_04_011: [ The function shall be able to add just `modules`, just `links` or both. ] */
-                if (parse_json_internal(properties, root_value) != PARSE_JSON_SUCCESS)
+                if (parse_json_internal(properties, NULL, root_value) != PARSE_JSON_SUCCESS)
                 {
                     /* Codes_SRS_GATEWAY_JSON_04_010: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON_Value contains incomplete information. ] */
                     LogError("Failed to create properties structure from JSON configuration.");
@@ -205,7 +220,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                     }
                     else
                     {
-                        VECTOR_HANDLE links_added_successfully = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+                        VECTOR_HANDLE links_added_successfully = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY_EX));
                         if (links_added_successfully == NULL)
                         {
                             LogError("Failed to create Vector for successfully added links.");
@@ -297,7 +312,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                 if (entries_count > 0)
                                 {
                                     //Add the first link, if successfull add others
-                                    GATEWAY_LINK_ENTRY* entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, 0);
+                                    GATEWAY_LINK_ENTRY_EX* entry = (GATEWAY_LINK_ENTRY_EX*)VECTOR_element(properties->gateway_links, 0);
                                     bool linkAdded = gateway_addlink_internal(gw, entry);
 
                                     if (linkAdded)
@@ -305,7 +320,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                         if (VECTOR_push_back(links_added_successfully, entry, 1) != 0)
                                         {
                                             LogError("Failed to save successfully added link.");
-                                            Gateway_RemoveLink(gw, entry);
+                                            Gateway_RemoveLink(gw, &entry->base);
                                             linkAdded = false;
                                             result = GATEWAY_UPDATE_FROM_JSON_ERROR;
                                         }
@@ -319,14 +334,14 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                     //Continue adding links until all are added or one fails
                                     for (size_t links_index = 1; links_index < entries_count && linkAdded; ++links_index)
                                     {
-                                        entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, links_index);
+                                        entry = (GATEWAY_LINK_ENTRY_EX*)VECTOR_element(properties->gateway_links, links_index);
                                         linkAdded = gateway_addlink_internal(gw, entry);
                                         if (linkAdded)
                                         {
                                             if (VECTOR_push_back(links_added_successfully, entry, 1) != 0)
                                             {
                                                 LogError("Failed to save successfully added link.");
-                                                Gateway_RemoveLink(gw, entry);
+                                                Gateway_RemoveLink(gw, &entry->base);
                                                 linkAdded = false;
                                                 result = GATEWAY_UPDATE_FROM_JSON_ERROR;
                                             }
@@ -348,8 +363,8 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                         {
                                             for (size_t properties_index = 0; properties_index < success_link_entries_count; ++properties_index)
                                             {
-                                                GATEWAY_LINK_ENTRY* entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(links_added_successfully, properties_index);
-                                                Gateway_RemoveLink(gw, entry);
+                                                GATEWAY_LINK_ENTRY_EX* entry = (GATEWAY_LINK_ENTRY_EX*)VECTOR_element(links_added_successfully, properties_index);
+                                                Gateway_RemoveLink(gw, &entry->base);
                                             }
                                         }
 
@@ -357,7 +372,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                         /* Codes_SRS_GATEWAY_JSON_04_009: [ The function shall be able to roll back previous operation if any module or link fails to be added. ] */
                                         rollbackModules(gw, modules_added_successfully);
 
-                                        LogError("Unable to add link from '%s' to '%s'.Rolling back Update Operation.", entry->module_source, entry->module_sink);
+                                        LogError("Unable to add link from '%s' to '%s'.Rolling back Update Operation.", entry->base.module_source, entry->base.module_sink);
                                     }
                                 }
                             }
@@ -446,7 +461,106 @@ static PARSE_JSON_RESULT parse_loader(JSON_Object* loader_json, GATEWAY_MODULE_L
     return result;
 }
 
-static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root)
+static bool parse_link_queue(JSON_Object* route, BROKER_LINK_QUEUE* queue)
+{
+    bool result;
+    JSON_Object* queue_json = json_object_get_object(route, QUEUE_KEY);
+    queue->capacity = 0;
+    queue->overflow = BROKER_OVERFLOW_DROP_NEWEST;
+    queue->conflate_key = NULL;
+    if (queue_json == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_015: [ A link without a "queue" object shall deliver messages directly to its sink. ]*/
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_016: [ The function shall read the "capacity", "overflow" and "key" of a link's "queue" into the GATEWAY_LINK_ENTRY_EX's queue. ]*/
+        double capacity = json_object_get_number(queue_json, QUEUE_CAPACITY_KEY);
+        const char* overflow = json_object_get_string(queue_json, QUEUE_OVERFLOW_KEY);
+        queue->conflate_key = json_object_get_string(queue_json, QUEUE_CONFLATE_KEY);
+        result = true;
+        if (capacity < 1 || capacity > (double)SIZE_MAX)
+        {
+            result = false;
+        }
+        else if (overflow == NULL || strcmp(overflow, "drop_newest") == 0)
+        {
+            queue->overflow = BROKER_OVERFLOW_DROP_NEWEST;
+        }
+        else if (strcmp(overflow, "drop_oldest") == 0)
+        {
+            queue->overflow = BROKER_OVERFLOW_DROP_OLDEST;
+        }
+        else if (strcmp(overflow, "block") == 0)
+        {
+            queue->overflow = BROKER_OVERFLOW_BLOCK;
+        }
+        else if (strcmp(overflow, "conflate") == 0 && queue->conflate_key != NULL)
+        {
+            queue->overflow = BROKER_OVERFLOW_CONFLATE;
+        }
+        else
+        {
+            result = false;
+        }
+
+        if (result)
+        {
+            queue->capacity = (size_t)capacity;
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_017: [ The function shall fail if a "queue" has no positive "capacity", an unknown "overflow", or "overflow" of "conflate" without a "key". ]*/
+            LogError("\"queue\" of a link in input JSON configuration is misconfigured.");
+        }
+    }
+    return result;
+}
+
+static bool parse_broker_config(JSON_Object* broker_json, BROKER_CONFIG* config)
+{
+    bool result;
+    /*Codes_SRS_GATEWAY_JSON_17_020: [ The function shall read the "engine", "capacity" and "workers" of the "broker" object into a BROKER_CONFIG and set the GATEWAY_PROPERTIES's broker_config to it. ]*/
+    const char* engine = json_object_get_string(broker_json, BROKER_ENGINE_KEY);
+    double capacity = json_object_get_number(broker_json, BROKER_CAPACITY_KEY);
+    double workers = json_object_get_number(broker_json, BROKER_WORKERS_KEY);
+    result = true;
+    if (capacity < 0 || capacity > (double)SIZE_MAX || workers < 0 || workers > (double)SIZE_MAX)
+    {
+        result = false;
+    }
+    else if (engine == NULL || strcmp(engine, "nanomsg") == 0)
+    {
+        config->engine = BROKER_ENGINE_NANOMSG;
+    }
+    else if (strcmp(engine, "ring") == 0)
+    {
+        config->engine = BROKER_ENGINE_RING;
+    }
+    else if (strcmp(engine, "pool") == 0)
+    {
+        config->engine = BROKER_ENGINE_POOL;
+    }
+    else
+    {
+        result = false;
+    }
+
+    if (result)
+    {
+        config->queue_capacity = (size_t)capacity;
+        config->worker_count = (size_t)workers;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_021: [ The function shall fail if the "broker" has an unknown "engine", or a negative "capacity" or "workers". ]*/
+        LogError("\"broker\" in input JSON configuration is misconfigured.");
+    }
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, BROKER_CONFIG* out_broker_config, JSON_Value *root)
 {
     PARSE_JSON_RESULT result;
 
@@ -461,6 +575,8 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
         {
             JSON_Array *modules_array = json_object_get_array(json_document, MODULES_KEY);
             JSON_Array *links_array = json_object_get_array(json_document, LINKS_KEY);
+            // "broker" is only read when creating a gateway, and is not required
+            JSON_Object *broker_json = (out_broker_config == NULL) ? NULL : json_object_get_object(json_document, BROKER_KEY);
 
             if (modules_array != NULL || links_array != NULL)
             {
@@ -545,7 +661,7 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                     if (links_array != NULL)
                     {
                         /* Codes_SRS_GATEWAY_JSON_04_001: [ The function shall create a Vector to Store all links to this gateway. ] */
-                        out_properties->gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+                        out_properties->gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY_EX));
                         if (out_properties->gateway_links != NULL)
                         {
                             JSON_Object *route;
@@ -558,21 +674,33 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
 
                                 if (module_source != NULL && module_sink != NULL)
                                 {
-                                    GATEWAY_LINK_ENTRY entry = {
-                                        module_source,
-                                        module_sink
+                                    GATEWAY_LINK_ENTRY_EX entry = {
+                                        { module_source, module_sink },
+                                        { 0, BROKER_OVERFLOW_DROP_NEWEST, NULL },
+                                        NULL
                                     };
 
-                                    /* Codes_SRS_GATEWAY_JSON_04_002: [ The function shall add all modules source and sink to GATEWAY_PROPERTIES inside gateway_links. ] */
-                                    if (VECTOR_push_back(out_properties->gateway_links, &entry, 1) == 0)
+                                    if (!parse_link_queue(route, &entry.queue))
                                     {
-                                        result = PARSE_JSON_SUCCESS;
+                                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                        break;
                                     }
                                     else
                                     {
-                                        result = PARSE_JSON_VECTOR_FAILURE;
-                                        LogError("Failed to push data into links vector.");
-                                        break;
+                                        /*Codes_SRS_GATEWAY_JSON_17_018: [ The function shall read a link's "filter" string, if any, into the GATEWAY_LINK_ENTRY_EX's filter. ]*/
+                                        entry.filter = json_object_get_string(route, FILTER_KEY);
+
+                                        /* Codes_SRS_GATEWAY_JSON_04_002: [ The function shall add all modules source and sink to GATEWAY_PROPERTIES inside gateway_links. ] */
+                                        if (VECTOR_push_back(out_properties->gateway_links, &entry, 1) == 0)
+                                        {
+                                            result = PARSE_JSON_SUCCESS;
+                                        }
+                                        else
+                                        {
+                                            result = PARSE_JSON_VECTOR_FAILURE;
+                                            LogError("Failed to push data into links vector.");
+                                            break;
+                                        }
                                     }
                                 }
                                 /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
@@ -600,6 +728,19 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                 {
                     out_properties->gateway_links = NULL;
                 }
+
+                if (result == PARSE_JSON_SUCCESS && broker_json != NULL)
+                {
+                    if (parse_broker_config(broker_json, out_broker_config))
+                    {
+                        out_properties->broker_config = out_broker_config;
+                    }
+                    else
+                    {
+                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                    }
+                }
+                /*Codes_SRS_GATEWAY_JSON_17_019: [ Without a "broker" object, the function shall leave the GATEWAY_PROPERTIES's broker_config NULL so the gateway uses the default broker. ]*/
             }
             /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
             else
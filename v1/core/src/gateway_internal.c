@@ -44,15 +44,16 @@ static bool check_if_link_exists(GATEWAY_HANDLE_DATA* gateway_handle, const GATE
     return link_data == NULL ? false : true;
 }
 
-static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink)
+static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink, const LINK_DATA* link_data)
 {
     int result;
-    BROKER_LINK_DATA broker_link_entry =
+    BROKER_LINK_DATA_EX broker_link_entry =
     {
-        source,
-        sink
+        { source, sink },
+        &link_data->queue,
+        link_data->filter
     };
-    if (Broker_AddLink(gateway_handle->broker, &broker_link_entry) != BROKER_OK)
+    if (Broker_AddLinkEx(gateway_handle->broker, &broker_link_entry) != BROKER_OK)
     {
         LogError("Could not add link to broker [%p] -> [%p]", source, sink);
         result = __LINE__;
@@ -84,9 +85,52 @@ static int remove_one_link_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODU
     return result;
 }
 
-static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
+/*copies the queue and filter of a link entry, the copy owns their strings*/
+static int link_options_copy(LINK_DATA* destination, const GATEWAY_LINK_ENTRY_EX* source)
+{
+    int result;
+    char* key_copied = NULL;
+    char* filter_copied = NULL;
+    if (source->queue.conflate_key != NULL && mallocAndStrcpy_s(&key_copied, source->queue.conflate_key) != 0)
+    {
+        LogError("Unable to copy the conflate key of a link.");
+        result = __LINE__;
+    }
+    else if (source->filter != NULL && mallocAndStrcpy_s(&filter_copied, source->filter) != 0)
+    {
+        LogError("Unable to copy the filter of a link.");
+        free(key_copied);
+        result = __LINE__;
+    }
+    else
+    {
+        destination->queue.capacity = source->queue.capacity;
+        destination->queue.overflow = source->queue.overflow;
+        destination->queue.conflate_key = key_copied;
+        destination->filter = filter_copied;
+        result = 0;
+    }
+    return result;
+}
+
+static void link_options_release(LINK_DATA* link_data)
+{
+    if (link_data->queue.conflate_key != NULL)
+    {
+        free((void*)link_data->queue.conflate_key);
+        link_data->queue.conflate_key = NULL;
+    }
+    if (link_data->filter != NULL)
+    {
+        free(link_data->filter);
+        link_data->filter = NULL;
+    }
+}
+
+static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY_EX* link_entry_ex)
 {
     int result;
+    const GATEWAY_LINK_ENTRY* link_entry = &link_entry_ex->base;
     MODULE_DATA** module_source_handle = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_entry->module_source);
 
     //Check of Source Module exists.
@@ -107,25 +151,35 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
         }
         else
         {
-            if (add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module) != 0)
+            LINK_DATA link_data =
+            {
+                false,
+                *module_source_handle,
+                *module_sink_handle,
+                { 0, BROKER_OVERFLOW_DROP_NEWEST, NULL },
+                NULL
+            };
+
+            if (link_options_copy(&link_data, link_entry_ex) != 0)
+            {
+                result = __LINE__;
+            }
+            /*Codes_SRS_GATEWAY_17_023: [ The gateway shall create the link on the broker with the queue of the entryLink, and keep its own copy of the queue. ]*/
+            /*Codes_SRS_GATEWAY_17_024: [ The gateway shall create the link on the broker with the filter of the entryLink, and keep its own copy of the filter. ]*/
+            else if (add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module, &link_data) != 0)
             {
                 LogError("Unable to add link to Broker.");
+                link_options_release(&link_data);
                 result = __LINE__;
             }
             else
             {
-                LINK_DATA link_data =
-                {
-                    false,
-                    *module_source_handle,
-                    *module_sink_handle
-                };
-
                 /*Codes_SRS_GATEWAY_04_012: [ This function shall add the entryLink to the gw->links ] */
                 if (VECTOR_push_back(gateway_handle->links, &link_data, 1) != 0)
                 {
                     LogError("Unable to add LINK_DATA* to the gateway links vector.");
                     remove_one_link_from_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module);
+                    link_options_release(&link_data);
                     result = __LINE__;
                 }
                 else
@@ -138,7 +192,23 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
     return result;
 }
 
-GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json)
+/*adds a link of GATEWAY_PROPERTIES, which is a GATEWAY_LINK_ENTRY_EX if links_ex is true*/
+static bool add_properties_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* entry, bool links_ex)
+{
+    bool result;
+    if (links_ex)
+    {
+        result = gateway_addlink_internal(gateway_handle, (const GATEWAY_LINK_ENTRY_EX*)entry);
+    }
+    else
+    {
+        GATEWAY_LINK_ENTRY_EX entry_ex = { { entry->module_source, entry->module_sink }, { 0, BROKER_OVERFLOW_DROP_NEWEST, NULL }, NULL };
+        result = gateway_addlink_internal(gateway_handle, &entry_ex);
+    }
+    return result;
+}
+
+GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json, bool links_ex)
 {
     GATEWAY_HANDLE_DATA* gateway;
     /*Codes_SRS_GATEWAY_14_001: [This function shall create a GATEWAY_HANDLE representing the newly created gateway.]*/
@@ -150,7 +220,15 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
         memset(gateway, 0, sizeof(GATEWAY_HANDLE_DATA));
 
         /*Codes_SRS_GATEWAY_14_003: [This function shall create a new BROKER_HANDLE for the gateway representing this gateway's message broker. ]*/
-        gateway->broker = Broker_Create();
+        if (properties != NULL && properties->broker_config != NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_027: [ If properties->broker_config is not NULL, this function shall create the broker with Broker_CreateWithConfig. ]*/
+            gateway->broker = Broker_CreateWithConfig(properties->broker_config);
+        }
+        else
+        {
+            gateway->broker = Broker_Create();
+        }
         if (gateway->broker == NULL)
         {
             /*Codes_SRS_GATEWAY_14_004: [This function shall return NULL if a BROKER_HANDLE cannot be created.]*/
@@ -218,13 +296,13 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
                                 {
                                     //Add the first link, if successfull add others
                                     GATEWAY_LINK_ENTRY* entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, 0);
-                                    bool linkAdded = gateway_addlink_internal(gateway, entry);
+                                    bool linkAdded = add_properties_link(gateway, entry, links_ex);
 
                                     //Continue adding links until all are added or one fails
                                     for (size_t links_index = 1; links_index < entries_count && linkAdded; ++links_index)
                                     {
                                         entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, links_index);
-                                        linkAdded = gateway_addlink_internal(gateway, entry);
+                                        linkAdded = add_properties_link(gateway, entry, links_ex);
                                     }
 
                                     /*Codes_SRS_GATEWAY_04_003: [If any GATEWAY_LINK_ENTRY is unable to be added to the broker the GATEWAY_HANDLE will be destroyed.]*/
@@ -588,9 +666,10 @@ void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_D
     free(module_data_ptr);
 }
 
-bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
+bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY_EX* link_entry_ex)
 {
     bool result;
+    const GATEWAY_LINK_ENTRY* link_entry = &link_entry_ex->base;
 
     //First check if a link with a given source/sink pair already exists.
     /*Codes_SRS_GATEWAY_04_009: [ This function shall check if a given link already exists. ]*/
@@ -601,7 +680,7 @@ bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY
         if (strcmp(GATEWAY_ALL, link_entry->module_source) == 0)
         {
             /*Codes_SRS_GATEWAY_17_002: [ The gateway shall accept a link with a source of "*" and a sink of a valid module. ]*/
-            if (add_any_source_link(gateway_handle, link_entry) != 0)
+            if (add_any_source_link(gateway_handle, link_entry_ex) != 0)
             {
                 LogError("Failed to add a any_source link sink = %s", link_entry->module_sink);
                 result = false;
@@ -613,7 +692,7 @@ bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY
         }
         else
         {
-            if (add_regular_link(gateway_handle, link_entry) != 0)
+            if (add_regular_link(gateway_handle, link_entry_ex) != 0)
             {
                 LogError("Failed to add a any_source link sink = %s", link_entry->module_sink);
                 result = false;
@@ -653,6 +732,7 @@ void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA*
         Broker_RemoveLink(gateway_handle->broker, &broker_data);
     }
 
+    link_options_release(link_data);
     VECTOR_erase(gateway_handle->links, link_data, 1);
 }
 
@@ -675,7 +755,7 @@ int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* m
             }
             else
             {
-                if (add_one_link_to_broker(gateway_handle, module->module, (*module_sink)->module) != 0)
+                if (add_one_link_to_broker(gateway_handle, module->module, (*module_sink)->module, link_data) != 0)
                 {
                     result = __LINE__;
                     break;
@@ -719,9 +799,10 @@ void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_D
     }
 }
 
-int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
+int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY_EX* link_entry_ex)
 {
     int result;
+    const GATEWAY_LINK_ENTRY* link_entry = &link_entry_ex->base;
     MODULE_DATA** module_sink_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_entry->module_sink);
 
     /*Codes_SRS_GATEWAY_04_011: [If the module referenced by the entryLink->module_source or entryLink->module_sink doesn't exists this function shall return GATEWAY_ADD_LINK_ERROR ] */
@@ -737,13 +818,20 @@ int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_
         {
             true,
             no_module,
-            *module_sink_data
+            *module_sink_data,
+            { 0, BROKER_OVERFLOW_DROP_NEWEST, NULL },
+            NULL
         };
 
+        if (link_options_copy(&link_data, link_entry_ex) != 0)
+        {
+            result = __LINE__;
+        }
         /*Codes_SRS_GATEWAY_04_012: [ This function shall add the entryLink to the gw->links ] */
-        if (VECTOR_push_back(gateway_handle->links, &link_data, 1) != 0)
+        else if (VECTOR_push_back(gateway_handle->links, &link_data, 1) != 0)
         {
             LogError("Unable to add LINK_DATA* to the gateway links vector.");
+            link_options_release(&link_data);
             result = __LINE__;
         }
         else
@@ -757,7 +845,7 @@ int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_
                 MODULE_DATA **source_module_data = (MODULE_DATA **)VECTOR_element(gateway_handle->modules, m);
                 /*Codes_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]*/
                 if ((*source_module_data)->module != (*module_sink_data)->module &&
-                    add_one_link_to_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module) != 0)
+                    add_one_link_to_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module, &link_data) != 0)
                 {
                     result = __LINE__;
                     break;
@@ -766,6 +854,7 @@ int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_
             if (result != 0)
             {
                 remove_any_source_link(gateway_handle, &link_data);
+                link_options_release(&link_data);
                 VECTOR_erase(gateway_handle->links, VECTOR_back(gateway_handle->links), 1);
             }
         }
@@ -47,17 +47,22 @@ typedef struct LINK_DATA_TAG {
     bool from_any_source;
     MODULE_DATA *module_source;
     MODULE_DATA *module_sink;
+    /** @brief  Queue of the link on the broker, the gateway owns conflate_key */
+    BROKER_LINK_QUEUE queue;
+    /** @brief  Filter of the link on the broker, owned by the gateway */
+    char* filter;
 } LINK_DATA;
 
-GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
+/* properties->gateway_links holds GATEWAY_LINK_ENTRY_EX entries when links_ex is true, GATEWAY_LINK_ENTRY ones otherwise */
+GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json, bool links_ex);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
 MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* entry, bool use_json);
 void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module);
-bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
+bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY_EX* link_entry);
 void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_data);
 int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
 void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
-int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
+int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY_EX* link_entry);
 void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_entry);
 bool module_name_find(const void* element, const void* module_name);
 bool link_data_find(const void* element, const void* link_data);
@@ -0,0 +1,479 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message.h"
+#include "link_filter.h"
+
+/*nesting of parentheses and negations a filter may have, bounds the recursion of both parser and evaluation*/
+#define LINK_FILTER_MAX_DEPTH 32
+/*longest expression accepted*/
+#define LINK_FILTER_MAX_LENGTH 65536
+#define NO_NODE SIZE_MAX
+#define PROPERTIES_NAME "properties"
+
+typedef enum LINK_FILTER_NODE_TYPE_TAG
+{
+    FILTER_ANY,
+    FILTER_ALL,
+    FILTER_NOT,
+    FILTER_EXISTS,
+    FILTER_EQUALS,
+    FILTER_NOT_EQUALS,
+    FILTER_IN,
+    FILTER_VALUE
+} LINK_FILTER_NODE_TYPE;
+
+/*One node of a compiled filter. Operands of FILTER_ANY and FILTER_ALL, and
+ *the values of FILTER_IN, are chained through next so neither parsing nor
+ *evaluating a long chain of || or && recurses.
+ */
+typedef struct LINK_FILTER_NODE_TAG
+{
+    LINK_FILTER_NODE_TYPE   type;
+    /** First operand, or first value of FILTER_IN */
+    size_t                  first;
+    /** Next operand of the same FILTER_ANY or FILTER_ALL, or next value of the same FILTER_IN */
+    size_t                  next;
+    /** Property tested */
+    const char*             key;
+    /** Value the property is compared with (FILTER_EQUALS, FILTER_NOT_EQUALS, FILTER_VALUE) */
+    const char*             value;
+} LINK_FILTER_NODE;
+
+/*The filter, its nodes and its strings live in a single allocation*/
+typedef struct LINK_FILTER_TAG
+{
+    LINK_FILTER_NODE*   nodes;
+    size_t              node_count;
+    size_t              node_capacity;
+    char*               strings;
+    size_t              root;
+} LINK_FILTER_HANDLE_DATA;
+
+typedef struct FILTER_PARSER_TAG
+{
+    const char*                 next;
+    LINK_FILTER_HANDLE_DATA*    filter;
+    char*                       strings_end;
+    size_t                      depth;
+} FILTER_PARSER;
+
+static int parse_expression(FILTER_PARSER* parser, size_t* node);
+
+static void skip_spaces(FILTER_PARSER* parser)
+{
+    while (*parser->next == ' ' || *parser->next == '\t' || *parser->next == '\r' || *parser->next == '\n')
+    {
+        parser->next++;
+    }
+}
+
+static bool is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+/*consumes token if it comes next*/
+static bool accept(FILTER_PARSER* parser, const char* token)
+{
+    bool result;
+    size_t length = strlen(token);
+    skip_spaces(parser);
+    if (strncmp(parser->next, token, length) != 0 ||
+        (is_name_char(token[length - 1]) && is_name_char(parser->next[length])))
+    {
+        result = false;
+    }
+    else
+    {
+        parser->next += length;
+        result = true;
+    }
+    return result;
+}
+
+static int new_node(FILTER_PARSER* parser, LINK_FILTER_NODE_TYPE type, size_t* node)
+{
+    int result;
+    LINK_FILTER_HANDLE_DATA* filter = parser->filter;
+    if (filter->node_count == filter->node_capacity)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        LINK_FILTER_NODE* created = &filter->nodes[filter->node_count];
+        created->type = type;
+        created->first = NO_NODE;
+        created->next = NO_NODE;
+        created->key = NULL;
+        created->value = NULL;
+        *node = filter->node_count++;
+        result = 0;
+    }
+    return result;
+}
+
+/*copies a double quoted string into the filter's strings*/
+static int parse_string(FILTER_PARSER* parser, const char** value)
+{
+    int result;
+    skip_spaces(parser);
+    if (*parser->next != '"')
+    {
+        LogError("expected a string at \"%s\"", parser->next);
+        result = __LINE__;
+    }
+    else
+    {
+        const char* source = parser->next + 1;
+        *value = parser->strings_end;
+        while (*source != '"' && *source != '\0')
+        {
+            if (*source == '\\' && (source[1] == '"' || source[1] == '\\'))
+            {
+                source++;
+            }
+            *parser->strings_end++ = *source++;
+        }
+
+        if (*source != '"')
+        {
+            LogError("unterminated string in filter");
+            result = __LINE__;
+        }
+        else
+        {
+            *parser->strings_end++ = '\0';
+            parser->next = source + 1;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*property := "properties." name | "properties[" string "]"*/
+static int parse_property(FILTER_PARSER* parser, const char** key)
+{
+    int result;
+    if (!accept(parser, PROPERTIES_NAME))
+    {
+        LogError("expected a property at \"%s\"", parser->next);
+        result = __LINE__;
+    }
+    else if (*parser->next == '.' && is_name_char(parser->next[1]))
+    {
+        parser->next++;
+        *key = parser->strings_end;
+        while (is_name_char(*parser->next))
+        {
+            *parser->strings_end++ = *parser->next++;
+        }
+        *parser->strings_end++ = '\0';
+        result = 0;
+    }
+    else if (*parser->next == '[' && (parser->next++, parse_string(parser, key) == 0) && accept(parser, "]"))
+    {
+        result = 0;
+    }
+    else
+    {
+        LogError("expected a property name at \"%s\"", parser->next);
+        result = __LINE__;
+    }
+    return result;
+}
+
+/*test := property [ ( "==" | "!=" ) string | "in" "[" string ( "," string )* "]" ]*/
+static int parse_test(FILTER_PARSER* parser, size_t* node)
+{
+    int result;
+    const char* key;
+    if (parse_property(parser, &key) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (accept(parser, "=="))
+    {
+        result = (new_node(parser, FILTER_EQUALS, node) == 0 && parse_string(parser, &parser->filter->nodes[*node].value) == 0) ? 0 : __LINE__;
+    }
+    else if (accept(parser, "!="))
+    {
+        result = (new_node(parser, FILTER_NOT_EQUALS, node) == 0 && parse_string(parser, &parser->filter->nodes[*node].value) == 0) ? 0 : __LINE__;
+    }
+    else if (accept(parser, "in"))
+    {
+        if (new_node(parser, FILTER_IN, node) != 0 || !accept(parser, "["))
+        {
+            LogError("expected a list of values at \"%s\"", parser->next);
+            result = __LINE__;
+        }
+        else
+        {
+            size_t* link = &parser->filter->nodes[*node].first;
+            result = 0;
+            do
+            {
+                size_t value;
+                if (new_node(parser, FILTER_VALUE, &value) != 0 ||
+                    parse_string(parser, &parser->filter->nodes[value].value) != 0)
+                {
+                    result = __LINE__;
+                }
+                else
+                {
+                    *link = value;
+                    link = &parser->filter->nodes[value].next;
+                }
+            } while (result == 0 && accept(parser, ","));
+
+            if (result == 0 && !accept(parser, "]"))
+            {
+                LogError("expected ']' at \"%s\"", parser->next);
+                result = __LINE__;
+            }
+        }
+    }
+    else
+    {
+        result = new_node(parser, FILTER_EXISTS, node);
+    }
+
+    if (result == 0)
+    {
+        parser->filter->nodes[*node].key = key;
+    }
+    return result;
+}
+
+/*unary := "!" unary | "(" expression ")" | test*/
+static int parse_unary(FILTER_PARSER* parser, size_t* node)
+{
+    int result;
+    if (parser->depth == LINK_FILTER_MAX_DEPTH)
+    {
+        LogError("filter is nested too deeply");
+        result = __LINE__;
+    }
+    else
+    {
+        parser->depth++;
+        if (accept(parser, "!"))
+        {
+            size_t operand;
+            if (parse_unary(parser, &operand) != 0 || new_node(parser, FILTER_NOT, node) != 0)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                parser->filter->nodes[*node].first = operand;
+                result = 0;
+            }
+        }
+        else if (accept(parser, "("))
+        {
+            if (parse_expression(parser, node) != 0)
+            {
+                result = __LINE__;
+            }
+            else if (!accept(parser, ")"))
+            {
+                LogError("expected ')' at \"%s\"", parser->next);
+                result = __LINE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+        else
+        {
+            result = parse_test(parser, node);
+        }
+        parser->depth--;
+    }
+    return result;
+}
+
+/*parses operands separated by op, grouping them under one node of type if there is more than one*/
+static int parse_chain(FILTER_PARSER* parser, const char* op, LINK_FILTER_NODE_TYPE type, int(*parse_operand)(FILTER_PARSER*, size_t*), size_t* node)
+{
+    int result;
+    size_t operand;
+    if (parse_operand(parser, &operand) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (!accept(parser, op))
+    {
+        *node = operand;
+        result = 0;
+    }
+    else if (new_node(parser, type, node) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        size_t last = operand;
+        parser->filter->nodes[*node].first = operand;
+        do
+        {
+            if (parse_operand(parser, &operand) != 0)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                parser->filter->nodes[last].next = operand;
+                last = operand;
+                result = 0;
+            }
+        } while (result == 0 && accept(parser, op));
+    }
+    return result;
+}
+
+/*and := unary ( "&&" unary )**/
+static int parse_and(FILTER_PARSER* parser, size_t* node)
+{
+    return parse_chain(parser, "&&", FILTER_ALL, parse_unary, node);
+}
+
+/*expression := and ( "||" and )**/
+static int parse_expression(FILTER_PARSER* parser, size_t* node)
+{
+    return parse_chain(parser, "||", FILTER_ANY, parse_and, node);
+}
+
+static bool node_matches(const LINK_FILTER_HANDLE_DATA* filter, size_t index, MESSAGE_HANDLE message)
+{
+    bool result;
+    const LINK_FILTER_NODE* node = &filter->nodes[index];
+    const char* value;
+    size_t operand;
+    switch (node->type)
+    {
+    case FILTER_ANY:
+        result = false;
+        for (operand = node->first; operand != NO_NODE && !result; operand = filter->nodes[operand].next)
+        {
+            result = node_matches(filter, operand, message);
+        }
+        break;
+    case FILTER_ALL:
+        result = true;
+        for (operand = node->first; operand != NO_NODE && result; operand = filter->nodes[operand].next)
+        {
+            result = node_matches(filter, operand, message);
+        }
+        break;
+    case FILTER_NOT:
+        result = !node_matches(filter, node->first, message);
+        break;
+    case FILTER_EXISTS:
+        result = Message_GetProperty(message, node->key) != NULL;
+        break;
+    case FILTER_EQUALS:
+        value = Message_GetProperty(message, node->key);
+        result = value != NULL && strcmp(value, node->value) == 0;
+        break;
+    case FILTER_NOT_EQUALS:
+        value = Message_GetProperty(message, node->key);
+        result = value == NULL || strcmp(value, node->value) != 0;
+        break;
+    case FILTER_IN:
+        value = Message_GetProperty(message, node->key);
+        result = false;
+        for (operand = node->first; value != NULL && operand != NO_NODE && !result; operand = filter->nodes[operand].next)
+        {
+            result = strcmp(value, filter->nodes[operand].value) == 0;
+        }
+        break;
+    default:
+        result = false;
+        break;
+    }
+    return result;
+}
+
+LINK_FILTER_HANDLE LINK_FILTER_create(const char* expression)
+{
+    LINK_FILTER_HANDLE_DATA* result;
+    size_t length;
+    if (expression == NULL || (length = strlen(expression)) > LINK_FILTER_MAX_LENGTH)
+    {
+        /*Codes_SRS_LINK_FILTER_17_001: [ LINK_FILTER_create shall return NULL if expression is NULL or longer than 65536 characters. ]*/
+        LogError("invalid filter expression");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_LINK_FILTER_17_002: [ LINK_FILTER_create shall allocate the filter, room for one node per character of expression and a copy of its strings in a single block. ]*/
+        result = (LINK_FILTER_HANDLE_DATA*)malloc(sizeof(LINK_FILTER_HANDLE_DATA) + (length + 1) * (sizeof(LINK_FILTER_NODE) + 1));
+        if (result == NULL)
+        {
+            /*Codes_SRS_LINK_FILTER_17_003: [ LINK_FILTER_create shall return NULL if it cannot allocate the filter. ]*/
+            LogError("unable to allocate filter");
+        }
+        else
+        {
+            FILTER_PARSER parser;
+            result->nodes = (LINK_FILTER_NODE*)(result + 1);
+            result->node_count = 0;
+            result->node_capacity = length + 1;
+            result->strings = (char*)(result->nodes + result->node_capacity);
+            parser.next = expression;
+            parser.filter = result;
+            parser.strings_end = result->strings;
+            parser.depth = 0;
+
+            /*Codes_SRS_LINK_FILTER_17_004: [ LINK_FILTER_create shall compile expression according to the filter grammar. ]*/
+            if (parse_expression(&parser, &result->root) != 0 ||
+                (skip_spaces(&parser), *parser.next != '\0'))
+            {
+                /*Codes_SRS_LINK_FILTER_17_005: [ LINK_FILTER_create shall return NULL if expression does not follow the grammar, or nests parentheses and negations more than 32 deep. ]*/
+                LogError("invalid filter expression \"%s\"", expression);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+void LINK_FILTER_destroy(LINK_FILTER_HANDLE handle)
+{
+    /*Codes_SRS_LINK_FILTER_17_006: [ LINK_FILTER_destroy shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_17_007: [ LINK_FILTER_destroy shall free the filter. ]*/
+        free(handle);
+    }
+}
+
+bool LINK_FILTER_matches(LINK_FILTER_HANDLE handle, MESSAGE_HANDLE message)
+{
+    bool result;
+    if (handle == NULL || message == NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_17_008: [ LINK_FILTER_matches shall return false if handle or message is NULL. ]*/
+        LogError("invalid arg handle=%p, message=%p", handle, message);
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_LINK_FILTER_17_009: [ LINK_FILTER_matches shall look up every property it tests with Message_GetProperty. ]*/
+        /*Codes_SRS_LINK_FILTER_17_010: [ LINK_FILTER_matches shall return whether the properties satisfy the filter: a property alone is true when the message has it, == and != compare its value with a string, in tests it against a list of strings, and !, && and || combine tests, evaluating operands only as far as needed. ]*/
+        result = node_matches((LINK_FILTER_HANDLE_DATA*)handle, ((LINK_FILTER_HANDLE_DATA*)handle)->root, message);
+    }
+    return result;
+}
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "message.h"
@@ -11,27 +12,63 @@
 #include "azure_c_shared_utility/map.h"
 #include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "message_properties.h"
+#include "mapped_file.h"
 
-#include "azure_c_shared_utility/refcount.h"
+#include "gateway_atomic.h"
+#include "message_pool.h"
+#include "message_varint.h"
 
 #define FIRST_MESSAGE_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
 #define SECOND_MESSAGE_BYTE 0x60 /*0x60 comes from (G)ateway*/
+/*the third byte of a version 2 or 3 message; in version 1 it is the top byte of the size, which never has this bit*/
+#define VERSION_2_MESSAGE_BYTE (0x80 | GATEWAY_MESSAGE_VERSION_2)
+#define VERSION_3_MESSAGE_BYTE (0x80 | GATEWAY_MESSAGE_VERSION_3)
 
 #define MIN_MESSAGE_BUFFER_LENGTH 14 /*14 is the minimum message length that is still valid*/
+#define MIN_MESSAGE_V2_BUFFER_LENGTH 9 /*header, version, size, no properties and no content; the same in version 3*/
+
+/*the serialized form of a message, the bytes follow the structure in the same block*/
+typedef struct MESSAGE_BYTE_ARRAY_TAG
+{
+    CONSTBUFFER view;
+}MESSAGE_BYTE_ARRAY;
 
 typedef struct MESSAGE_HANDLE_DATA_TAG
 {
-    CONSTMAP_HANDLE properties;
+    MESSAGE_PROPERTIES_HANDLE properties;
     CONSTBUFFER_HANDLE content;
+    void* volatile byteArray; /*MESSAGE_BYTE_ARRAY*, built on first use and freed with the message*/
+    GATEWAY_ATOMIC_U32 count;
+    /*set when the message was created on a byte array it owns, or on external content; content is NULL then*/
+    MESSAGE_BYTE_ARRAY_RELEASE release;
+    void* releaseContext;
+    CONSTBUFFER ownedByteArray; /*buffer is NULL unless the message was created on a byte array*/
+    CONSTBUFFER ownedContent;
+    /*set when the message was derived from one whose content is in a byte array it owns; ownedContent points there*/
+    struct MESSAGE_HANDLE_DATA_TAG* parent;
 }MESSAGE_HANDLE_DATA;
 
-DEFINE_REFCOUNT_TYPE(MESSAGE_HANDLE_DATA);
+/*messages are created and destroyed at the rate they flow, so their structure comes from the message pool*/
+static MESSAGE_HANDLE_DATA* message_data_create(void)
+{
+    MESSAGE_HANDLE_DATA* result = (MESSAGE_HANDLE_DATA*)MESSAGE_POOL_alloc(sizeof(MESSAGE_HANDLE_DATA));
+    if (result != NULL)
+    {
+        result->byteArray = NULL;
+        result->release = NULL;
+        result->ownedByteArray.buffer = NULL;
+        result->parent = NULL;
+        gateway_atomic_store(&result->count, 1);
+    }
+    return result;
+}
 
 static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
 {
     MESSAGE_HANDLE_DATA* result;
     /*Codes_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+    result = message_data_create();
     if (result == NULL)
     {
         LogError("malloc returned NULL");
@@ -46,19 +83,19 @@ static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
         if (result->content == NULL)
         {
             LogError("CONSBUFFER_Create failed");
-            free(result);
+            MESSAGE_POOL_free(result);
             result = NULL;
         }
         else
         {
-            /*Codes_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.]*/
-            result->properties = ConstMap_Create(cfg->sourceProperties);
+            /*Codes_SRS_MESSAGE_02_019: [Message_Create shall copy the sourceProperties to a readonly property set with MESSAGE_PROPERTIES_create.]*/
+            result->properties = MESSAGE_PROPERTIES_create(cfg->sourceProperties);
             if (result->properties == NULL)
             {
                 /*Codes_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.] */
-                LogError("ConstMap_Create failed");
+                LogError("MESSAGE_PROPERTIES_create failed");
                 CONSTBUFFER_Destroy(result->content);
-                free(result);
+                MESSAGE_POOL_free(result);
                 result = NULL;
             }
             else
@@ -93,6 +130,211 @@ MESSAGE_HANDLE Message_Create(const MESSAGE_CONFIG * cfg)
     return (MESSAGE_HANDLE)result;
 }
 
+MESSAGE_HANDLE Message_CreateTyped(const MESSAGE_TYPED_CONFIG* cfg)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (cfg == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_051: [ If cfg is NULL then Message_CreateTyped shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter (NULL).");
+    }
+    else if ((cfg->size > 0) && (cfg->source == NULL))
+    {
+        /*Codes_SRS_MESSAGE_17_052: [ If field source of cfg is NULL and size is not zero, then Message_CreateTyped shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter combination cfg->size=%zd, cfg->source=%p", cfg->size, cfg->source);
+    }
+    else if ((result = message_data_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_055: [ If any underlying call fails, Message_CreateTyped shall return NULL. ]*/
+        LogError("malloc returned NULL");
+    }
+    /*Codes_SRS_MESSAGE_17_053: [ Message_CreateTyped shall copy the source to a readonly CONSTBUFFER. ]*/
+    else if ((result->content = CONSTBUFFER_Create(cfg->source, cfg->size)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_055: [ If any underlying call fails, Message_CreateTyped shall return NULL. ]*/
+        LogError("CONSBUFFER_Create failed");
+        MESSAGE_POOL_free(result);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_17_054: [ Message_CreateTyped shall create the property set with MESSAGE_PROPERTIES_create_typed, passing it the properties and propertyCount of cfg. ]*/
+    else if ((result->properties = MESSAGE_PROPERTIES_create_typed(cfg->properties, cfg->propertyCount)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_055: [ If any underlying call fails, Message_CreateTyped shall return NULL. ]*/
+        LogError("MESSAGE_PROPERTIES_create_typed failed");
+        CONSTBUFFER_Destroy(result->content);
+        MESSAGE_POOL_free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_056: [ On success, Message_CreateTyped shall return a non-NULL handle with the ref count set to "1". ]*/
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+PROPERTY_SET_HANDLE PropertySet_Create(MAP_HANDLE properties)
+{
+    /*Codes_SRS_MESSAGE_17_064: [ PropertySet_Create shall return the property set MESSAGE_PROPERTIES_create makes from properties. ]*/
+    return MESSAGE_PROPERTIES_create(properties);
+}
+
+PROPERTY_SET_HANDLE PropertySet_CreateTyped(const MESSAGE_TYPED_PROPERTY* properties, size_t count)
+{
+    /*Codes_SRS_MESSAGE_17_065: [ PropertySet_CreateTyped shall return the property set MESSAGE_PROPERTIES_create_typed makes from properties and count. ]*/
+    return MESSAGE_PROPERTIES_create_typed(properties, count);
+}
+
+PROPERTY_SET_HANDLE PropertySet_Clone(PROPERTY_SET_HANDLE propertySet)
+{
+    /*Codes_SRS_MESSAGE_17_066: [ PropertySet_Clone shall return the result of MESSAGE_PROPERTIES_clone on propertySet. ]*/
+    return MESSAGE_PROPERTIES_clone(propertySet);
+}
+
+void PropertySet_Destroy(PROPERTY_SET_HANDLE propertySet)
+{
+    /*Codes_SRS_MESSAGE_17_067: [ PropertySet_Destroy shall call MESSAGE_PROPERTIES_destroy on propertySet. ]*/
+    MESSAGE_PROPERTIES_destroy(propertySet);
+}
+
+MESSAGE_HANDLE Message_CreateWithPropertySet(const MESSAGE_SHARED_CONFIG* cfg)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (cfg == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_068: [ If cfg is NULL then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter (NULL).");
+    }
+    else if (cfg->properties == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_069: [ If field properties of cfg is NULL then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter cfg->properties=NULL");
+    }
+    else if ((cfg->size > 0) && (cfg->source == NULL))
+    {
+        /*Codes_SRS_MESSAGE_17_070: [ If field source of cfg is NULL and size is not zero, then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter combination cfg->size=%zd, cfg->source=%p", cfg->size, cfg->source);
+    }
+    else if ((result = message_data_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_073: [ If any underlying call fails, Message_CreateWithPropertySet shall return NULL. ]*/
+        LogError("malloc returned NULL");
+    }
+    /*Codes_SRS_MESSAGE_17_071: [ Message_CreateWithPropertySet shall copy the source to a readonly CONSTBUFFER. ]*/
+    else if ((result->content = CONSTBUFFER_Create(cfg->source, cfg->size)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_073: [ If any underlying call fails, Message_CreateWithPropertySet shall return NULL. ]*/
+        LogError("CONSBUFFER_Create failed");
+        MESSAGE_POOL_free(result);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_17_072: [ Message_CreateWithPropertySet shall take a reference to the properties of cfg with MESSAGE_PROPERTIES_clone, without copying them. ]*/
+    else if ((result->properties = MESSAGE_PROPERTIES_clone(cfg->properties)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_073: [ If any underlying call fails, Message_CreateWithPropertySet shall return NULL. ]*/
+        LogError("MESSAGE_PROPERTIES_clone failed");
+        CONSTBUFFER_Destroy(result->content);
+        MESSAGE_POOL_free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_074: [ On success, Message_CreateWithPropertySet shall return a non-NULL handle with the ref count set to "1". ]*/
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+MESSAGE_HANDLE Message_CreateWithExternalContent(const MESSAGE_EXTERNAL_CONFIG* cfg)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (cfg == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_077: [ If cfg is NULL then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter (NULL).");
+    }
+    else if (cfg->properties == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_078: [ If field properties of cfg is NULL then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter cfg->properties=NULL");
+    }
+    else if ((cfg->size > 0) && (cfg->source == NULL))
+    {
+        /*Codes_SRS_MESSAGE_17_079: [ If field source of cfg is NULL and size is not zero, then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+        result = NULL;
+        LogError("invalid parameter combination cfg->size=%zd, cfg->source=%p", cfg->size, cfg->source);
+    }
+    else if ((result = message_data_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_082: [ If any underlying call fails, Message_CreateWithExternalContent shall return NULL without calling release. ]*/
+        LogError("malloc returned NULL");
+    }
+    /*Codes_SRS_MESSAGE_17_081: [ Message_CreateWithExternalContent shall take a reference to the properties of cfg with MESSAGE_PROPERTIES_clone. ]*/
+    else if ((result->properties = MESSAGE_PROPERTIES_clone(cfg->properties)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_082: [ If any underlying call fails, Message_CreateWithExternalContent shall return NULL without calling release. ]*/
+        LogError("MESSAGE_PROPERTIES_clone failed");
+        MESSAGE_POOL_free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_080: [ Message_CreateWithExternalContent shall not copy the source; Message_GetContent shall return source and size. ]*/
+        result->content = NULL;
+        result->ownedContent.buffer = cfg->source;
+        result->ownedContent.size = cfg->size;
+        result->release = cfg->release;
+        result->releaseContext = cfg->context;
+        /*Codes_SRS_MESSAGE_17_083: [ On success, Message_CreateWithExternalContent shall return a non-NULL handle with the ref count set to "1". ]*/
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+static void release_mapped_file(void* context)
+{
+    MappedFile_Close((MAPPED_FILE_HANDLE)context);
+}
+
+MESSAGE_HANDLE Message_CreateFromMappedFile(const char* path, PROPERTY_SET_HANDLE properties)
+{
+    MESSAGE_HANDLE result;
+    MESSAGE_EXTERNAL_CONFIG cfg;
+    MAPPED_FILE_HANDLE file;
+    if (path == NULL || properties == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_086: [ If path or properties is NULL then Message_CreateFromMappedFile shall fail and return NULL. ]*/
+        LogError("invalid arg path=%p, properties=%p", path, properties);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_17_087: [ Message_CreateFromMappedFile shall map the file with MappedFile_Open. ]*/
+    else if ((file = MappedFile_Open(path, &cfg.source, &cfg.size)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_089: [ If any underlying call fails, Message_CreateFromMappedFile shall return NULL. ]*/
+        LogError("unable to map %s", path);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_088: [ Message_CreateFromMappedFile shall create the message with Message_CreateWithExternalContent, with a release that closes the mapping with MappedFile_Close. ]*/
+        cfg.release = release_mapped_file;
+        cfg.context = file;
+        cfg.properties = properties;
+        result = Message_CreateWithExternalContent(&cfg);
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_089: [ If any underlying call fails, Message_CreateFromMappedFile shall return NULL. ]*/
+            LogError("unable to create a message on %s", path);
+            MappedFile_Close(file);
+        }
+    }
+    return result;
+}
+
 MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
 {
     MESSAGE_HANDLE_DATA* result;
@@ -118,7 +360,7 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
     {
         /*Codes_SRS_MESSAGE_17_011: [If Message_CreateFromBuffer encounters an error while building the internal structures of the message, then it shall return NULL.]*/
         /*Codes_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-        result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+        result = message_data_create();
         if (result == NULL)
         {
             LogError("malloc returned NULL");
@@ -131,18 +373,18 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
             if (result->content == NULL)
             {
                 LogError("CONSBUFFER Clone failed");
-                free(result);
+                MESSAGE_POOL_free(result);
                 result = NULL;
             }
             else
             {
-                /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
-                result->properties = ConstMap_Create(cfg->sourceProperties);
+                /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly property set with MESSAGE_PROPERTIES_create.]*/
+                result->properties = MESSAGE_PROPERTIES_create(cfg->sourceProperties);
                 if (result->properties == NULL)
                 {
-                    LogError("ConstMap_Create failed");
+                    LogError("MESSAGE_PROPERTIES_create failed");
                     CONSTBUFFER_Destroy(result->content);
-                    free(result);
+                    MESSAGE_POOL_free(result);
                     result = NULL;
                 }
                 else
@@ -165,17 +407,64 @@ MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
     else
     {
         /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
-        INC_REF(MESSAGE_HANDLE_DATA, message);
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-        (void)ConstMap_Clone(messageData->properties);
+        (void)gateway_atomic_increment(&messageData->count);
+        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the property set.]*/
+        (void)MESSAGE_PROPERTIES_clone(messageData->properties);
         /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
-        (void)CONSTBUFFER_Clone(messageData->content);
+        if (messageData->content != NULL)
+        {
+            (void)CONSTBUFFER_Clone(messageData->content);
+        }
     }
     /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
     return message;
 }
 
+MESSAGE_HANDLE Message_Derive(MESSAGE_HANDLE message, const MESSAGE_PROPERTY_UPDATE* adds, size_t addCount, const char* const* removes, size_t removeCount)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_044: [ If message is NULL then Message_Derive shall fail and return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else if ((result = message_data_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_049: [ If any underlying call fails, Message_Derive shall return NULL. ]*/
+        LogError("unable to allocate a message");
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        /*Codes_SRS_MESSAGE_17_045: [ Message_Derive shall create the property set of the new message with MESSAGE_PROPERTIES_derive, passing it the property set of message, adds and removes. ]*/
+        result->properties = MESSAGE_PROPERTIES_derive(messageData->properties, adds, addCount, removes, removeCount);
+        if (result->properties == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_049: [ If any underlying call fails, Message_Derive shall return NULL. ]*/
+            LogError("unable to derive the properties");
+            MESSAGE_POOL_free(result);
+            result = NULL;
+        }
+        else if (messageData->content != NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_046: [ Message_Derive shall share the content of message by cloning its CONSTBUFFER handle. ]*/
+            result->content = CONSTBUFFER_Clone(messageData->content);
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_047: [ If the content of message is inside a byte array it owns, Message_Derive shall point at the same content and keep a reference to message with Message_Clone. ]*/
+            result->content = NULL;
+            result->ownedContent = messageData->ownedContent;
+            result->parent = (messageData->parent != NULL) ? messageData->parent : messageData;
+            (void)Message_Clone((MESSAGE_HANDLE)result->parent);
+        }
+        /*Codes_SRS_MESSAGE_17_050: [ On success, Message_Derive shall return a non-NULL handle with the ref count set to "1". ]*/
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
 CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
 {
     CONSTMAP_HANDLE result;
@@ -187,9 +476,94 @@ CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
+        /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall return the CONSTMAP handle representing the properties of the message, obtained from MESSAGE_PROPERTIES_get_constmap.]*/
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        result = ConstMap_Clone(messageData->properties);
+        result = MESSAGE_PROPERTIES_get_constmap(messageData->properties);
+    }
+    return result;
+}
+
+const char* Message_GetProperty(MESSAGE_HANDLE message, const char* name)
+{
+    const char* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_019: [ If message is NULL then Message_GetProperty shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_020: [ Otherwise, Message_GetProperty shall return the value MESSAGE_PROPERTIES_get finds for name. ]*/
+        result = MESSAGE_PROPERTIES_get(((MESSAGE_HANDLE_DATA*)message)->properties, name);
+    }
+    return result;
+}
+
+const char* Message_GetPropertyById(MESSAGE_HANDLE message, MESSAGE_PROPERTY_ID id)
+{
+    const char* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_021: [ If message is NULL then Message_GetPropertyById shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_022: [ Otherwise, Message_GetPropertyById shall return the value MESSAGE_PROPERTIES_get_by_id finds for id. ]*/
+        result = MESSAGE_PROPERTIES_get_by_id(((MESSAGE_HANDLE_DATA*)message)->properties, id);
+    }
+    return result;
+}
+
+PROPERTY_SET_HANDLE Message_GetPropertySet(MESSAGE_HANDLE message)
+{
+    PROPERTY_SET_HANDLE result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_075: [ If message is NULL then Message_GetPropertySet shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_076: [ Otherwise, Message_GetPropertySet shall return a new reference to the property set of the message, taken with MESSAGE_PROPERTIES_clone. ]*/
+        result = MESSAGE_PROPERTIES_clone(((MESSAGE_HANDLE_DATA*)message)->properties);
+    }
+    return result;
+}
+
+const MESSAGE_PROPERTY_VALUE* Message_GetTypedProperty(MESSAGE_HANDLE message, const char* name)
+{
+    const MESSAGE_PROPERTY_VALUE* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_057: [ If message is NULL then Message_GetTypedProperty shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_058: [ Otherwise, Message_GetTypedProperty shall return the value MESSAGE_PROPERTIES_get_typed finds for name. ]*/
+        result = MESSAGE_PROPERTIES_get_typed(((MESSAGE_HANDLE_DATA*)message)->properties, name);
+    }
+    return result;
+}
+
+const MESSAGE_PROPERTY_VALUE* Message_GetTypedPropertyById(MESSAGE_HANDLE message, MESSAGE_PROPERTY_ID id)
+{
+    const MESSAGE_PROPERTY_VALUE* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_059: [ If message is NULL then Message_GetTypedPropertyById shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_060: [ Otherwise, Message_GetTypedPropertyById shall return the value MESSAGE_PROPERTIES_get_typed_by_id finds for id. ]*/
+        result = MESSAGE_PROPERTIES_get_typed_by_id(((MESSAGE_HANDLE_DATA*)message)->properties, id);
     }
     return result;
 }
@@ -207,7 +581,9 @@ const CONSTBUFFER * Message_GetContent(MESSAGE_HANDLE message)
     {
         /*Codes_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type MESSAGE_CONTENT.]*/
         /*Codes_SRS_MESSAGE_02_016: [The CONSTBUFFER's field buffer shall compare equal byte-by-byte to the cfg's field source.]*/
-        result = CONSTBUFFER_GetContent(((MESSAGE_HANDLE_DATA*)message)->content);
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        /*Codes_SRS_MESSAGE_17_036: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetContent shall return the content inside the owned byte array. ]*/
+        result = (messageData->content == NULL) ? &messageData->ownedContent : CONSTBUFFER_GetContent(messageData->content);
     }
     return result;
 }
@@ -223,12 +599,58 @@ CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message)
     }
     else
     {
-        /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-        result = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        if (messageData->content == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_037: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetContentHandle shall return a copy of the content made with CONSTBUFFER_Create. ]*/
+            /*Codes_SRS_MESSAGE_17_085: [ For a message created by Message_CreateWithExternalContent, Message_GetContentHandle shall return a copy of the content made with CONSTBUFFER_Create. ]*/
+            result = CONSTBUFFER_Create(messageData->ownedContent.buffer, messageData->ownedContent.size);
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+            result = CONSTBUFFER_Clone(messageData->content);
+        }
+    }
+    return result;
+}
+
+int Message_GetContentView(MESSAGE_HANDLE message, MESSAGE_CONTENT_VIEW* view)
+{
+    int result;
+    if (message == NULL || view == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_090: [ If message or view is NULL, Message_GetContentView shall fail and return a non-zero value. ]*/
+        LogError("invalid argument, message=%p, view=%p", message, view);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        /*Codes_SRS_MESSAGE_17_091: [ Message_GetContentView shall point view at the content of the message without copying it, for every kind of message. ]*/
+        const CONSTBUFFER* content = (messageData->content == NULL) ? &messageData->ownedContent : CONSTBUFFER_GetContent(messageData->content);
+        view->buffer = content->buffer;
+        view->size = content->size;
+        /*Codes_SRS_MESSAGE_17_092: [ Message_GetContentView shall keep the content alive by storing a clone of message, made with Message_Clone, in view->owner, and return 0. ]*/
+        view->owner = Message_Clone(message);
+        result = 0;
     }
     return result;
 }
 
+void Message_ReleaseContentView(MESSAGE_CONTENT_VIEW* view)
+{
+    /*Codes_SRS_MESSAGE_17_093: [ If view is NULL, Message_ReleaseContentView shall do nothing. ]*/
+    if (view != NULL && view->owner != NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_094: [ Message_ReleaseContentView shall destroy view->owner with Message_Destroy and clear the view. ]*/
+        Message_Destroy(view->owner);
+        view->owner = NULL;
+        view->buffer = NULL;
+        view->size = 0;
+    }
+}
+
 void Message_Destroy(MESSAGE_HANDLE message)
 {
     /*Codes_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
@@ -239,15 +661,34 @@ void Message_Destroy(MESSAGE_HANDLE message)
     else
     {
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-        ConstMap_Destroy(messageData->properties);
+        /*Codes_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the property set.]*/
+        MESSAGE_PROPERTIES_destroy(messageData->properties);
         /*Codes_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
-        CONSTBUFFER_Destroy(messageData->content);
+        if (messageData->content != NULL)
+        {
+            CONSTBUFFER_Destroy(messageData->content);
+        }
         /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
-        if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
+        if (gateway_atomic_decrement(&messageData->count) == 0)
         {
             /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-            free(message);
+            if (messageData->byteArray != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_026: [ When the ref count is zero, Message_Destroy shall also free the serialized form of the message, if it was built. ]*/
+                MESSAGE_POOL_free(messageData->byteArray);
+            }
+            if (messageData->release != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_038: [ When the ref count is zero, Message_Destroy shall call release with context for a message created by Message_CreateFromOwnedByteArray. ]*/
+                /*Codes_SRS_MESSAGE_17_084: [ When the ref count is zero, Message_Destroy shall call release with context for a message created by Message_CreateWithExternalContent, if release is not NULL. ]*/
+                messageData->release(messageData->releaseContext);
+            }
+            if (messageData->parent != NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_048: [ When the ref count is zero, Message_Destroy shall destroy the reference a message made by Message_Derive keeps to the message whose byte array holds its content. ]*/
+                Message_Destroy((MESSAGE_HANDLE)messageData->parent);
+            }
+            MESSAGE_POOL_free(messageData);
         }
     }
 }
@@ -298,19 +739,360 @@ static int parse_null_terminated_const_char(const unsigned char* source, int32_t
     return result;
 }
 
-/*creates a MESSAGE_HANDLE from a serialized byte array*/
-MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
+/*where the parts of a serialized message are*/
+typedef struct BYTE_ARRAY_LAYOUT_TAG
 {
-    MESSAGE_HANDLE_DATA* result;
-    /*Codes_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    if (
-        (source == NULL) ||
-        (size < MIN_MESSAGE_BUFFER_LENGTH)
-        )
+    uint8_t version;
+    int32_t propertiesCount;
+    int32_t propertiesPosition;
+    int32_t contentPosition;
+}BYTE_ARRAY_LAYOUT;
+
+/*checks that source holds a whole version 1 message and finds where its properties and content are*/
+static int parse_byte_array_layout_v1(const unsigned char* source, int32_t size, BYTE_ARRAY_LAYOUT* layout)
+{
+    int result;
+    int32_t currentPosition = 10; /*past the header, the size and the number of properties*/
+    int32_t parsed;
+    int32_t messageSize;
+    int32_t messageContentSize;
+    int32_t i;
+
+    if (parse_int32_t(source, size, 2, &parsed, &messageSize) != 0 || messageSize != size)
     {
-        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
-        result = NULL;
+        LogError("message size is inconsistent");
+        result = __LINE__;
+    }
+    else if (parse_int32_t(source, size, 6, &parsed, &layout->propertiesCount) != 0 ||
+        layout->propertiesCount < 0 || layout->propertiesCount == INT32_MAX)
+    {
+        LogError("invalid message detected with wrong number of properties");
+        result = __LINE__;
+    }
+    else
+    {
+        const char* ignored;
+        layout->propertiesPosition = currentPosition;
+        for (i = 0; i < 2 * layout->propertiesCount; i++)
+        {
+            /*names and values alternate*/
+            if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &ignored) != 0)
+            {
+                LogError("unable to parse property %" PRId32, i / 2);
+                break;
+            }
+            currentPosition += parsed;
+        }
+
+        if (i != 2 * layout->propertiesCount)
+        {
+            result = __LINE__;
+        }
+        else if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0 ||
+            messageContentSize < 0 || currentPosition + parsed + messageContentSize != messageSize)
+        {
+            LogError("the message content doesn't add up to the message size");
+            result = __LINE__;
+        }
+        else
+        {
+            layout->version = GATEWAY_MESSAGE_VERSION_1;
+            layout->contentPosition = currentPosition + parsed;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*parses a varint at position, fails if it does not fit in size or is larger than limit*/
+static int parse_varint(const unsigned char* source, int32_t size, int32_t position, int32_t* parsed, uint32_t limit, uint32_t* value)
+{
+    int result;
+    size_t read = message_varint_read(source + position, (size_t)(size - position), value);
+    if (read == 0 || *value > limit)
+    {
+        /*Codes_SRS_MESSAGE_17_041: [ If a length or count of a version 2 byte array is truncated or goes past the end of the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("invalid varint at %" PRId32, position);
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = (int32_t)read;
+        result = 0;
+    }
+    return result;
+}
+
+/*skips a version 2 string of length bytes at position, which must be followed by '\0'*/
+static int parse_v2_string(const unsigned char* source, int32_t size, int32_t position, uint32_t length, int32_t* parsed)
+{
+    int result;
+    if (length >= (uint32_t)(size - position) || source[position + length] != '\0')
+    {
+        LogError("string at %" PRId32 " is not terminated", position);
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = (int32_t)length + 1;
+        result = 0;
+    }
+    return result;
+}
+
+/*skips a version 3 value at position: its type, then a version 2 string, a length and as many bytes, or an 8 byte number*/
+static int parse_v3_value(const unsigned char* source, int32_t size, int32_t position, int32_t* parsed)
+{
+    int result;
+    int32_t length_size;
+    uint32_t length;
+    MESSAGE_PROPERTY_TYPE type = (MESSAGE_PROPERTY_TYPE)source[position];
+    position++;
+    if ((size_t)type >= MESSAGE_PROPERTY_TYPE_COUNT)
+    {
+        /*Codes_SRS_MESSAGE_17_061: [ If a value of a version 3 byte array has a type that is not a MESSAGE_PROPERTY_TYPE, or does not fit in the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unknown property type %d", (int)type);
+        result = __LINE__;
+    }
+    else if (type == MESSAGE_PROPERTY_TYPE_STRING || type == MESSAGE_PROPERTY_TYPE_BYTES)
+    {
+        if (parse_varint(source, size, position, &length_size, UINT32_MAX, &length) != 0)
+        {
+            result = __LINE__;
+        }
+        else if (type == MESSAGE_PROPERTY_TYPE_STRING)
+        {
+            result = parse_v2_string(source, size, position + length_size, length, parsed);
+            *parsed += 1 + length_size;
+        }
+        else if (length > (uint32_t)(size - position - length_size))
+        {
+            LogError("bytes at %" PRId32 " go past the end of the message", position);
+            result = __LINE__;
+        }
+        else
+        {
+            *parsed = 1 + length_size + (int32_t)length;
+            result = 0;
+        }
+    }
+    else if (size - position < MESSAGE_FIXED64_SIZE)
+    {
+        LogError("number at %" PRId32 " goes past the end of the message", position);
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = 1 + MESSAGE_FIXED64_SIZE;
+        result = 0;
+    }
+    return result;
+}
+
+/*checks that source holds a whole version 2 or 3 message and finds where its properties and content are*/
+static int parse_byte_array_layout_v2(const unsigned char* source, int32_t size, uint8_t version, BYTE_ARRAY_LAYOUT* layout)
+{
+    int result;
+    int32_t currentPosition = 7; /*past the header, the version and the size*/
+    int32_t parsed;
+    int32_t messageSize;
+    uint32_t value;
+    int32_t i;
+
+    if (parse_int32_t(source, size, 3, &parsed, &messageSize) != 0 || messageSize != size)
+    {
+        LogError("message size is inconsistent");
+        result = __LINE__;
+    }
+    /*every property takes at least 3 bytes*/
+    else if (parse_varint(source, size, currentPosition, &parsed, (uint32_t)(size - currentPosition) / 3, &value) != 0)
+    {
+        LogError("invalid message detected with wrong number of properties");
+        result = __LINE__;
+    }
+    else
+    {
+        currentPosition += parsed;
+        layout->propertiesCount = (int32_t)value;
+        layout->propertiesPosition = currentPosition;
+        for (i = 0; i < layout->propertiesCount; i++)
+        {
+            /*a name is either an interned id (low bit set) or a length (low bit clear) followed by the string*/
+            if (parse_varint(source, size, currentPosition, &parsed, UINT32_MAX, &value) != 0)
+            {
+                break;
+            }
+            currentPosition += parsed;
+            if ((value & 1) != 0)
+            {
+                if ((value >> 1) >= MESSAGE_PROPERTY_ID_COUNT)
+                {
+                    /*Codes_SRS_MESSAGE_17_042: [ If a property name of a version 2 byte array is an id that is not a MESSAGE_PROPERTY_ID, Message_CreateFromByteArray shall fail and return NULL. ]*/
+                    LogError("unknown interned property %" PRIu32, value >> 1);
+                    break;
+                }
+            }
+            else if (parse_v2_string(source, size, currentPosition, value >> 1, &parsed) != 0)
+            {
+                break;
+            }
+            else
+            {
+                currentPosition += parsed;
+            }
+
+            if (version == GATEWAY_MESSAGE_VERSION_3)
+            {
+                /*the type of a version 3 value comes first; there is always a byte after the value, the content size*/
+                if (currentPosition >= size || parse_v3_value(source, size, currentPosition, &parsed) != 0)
+                {
+                    break;
+                }
+            }
+            else if (parse_varint(source, size, currentPosition, &parsed, UINT32_MAX, &value) != 0)
+            {
+                break;
+            }
+            else
+            {
+                currentPosition += parsed;
+                if (parse_v2_string(source, size, currentPosition, value, &parsed) != 0)
+                {
+                    break;
+                }
+            }
+            currentPosition += parsed;
+        }
+
+        if (i != layout->propertiesCount)
+        {
+            LogError("unable to parse property %" PRId32, i);
+            result = __LINE__;
+        }
+        else if (parse_varint(source, size, currentPosition, &parsed, UINT32_MAX, &value) != 0 ||
+            value != (uint32_t)(size - currentPosition - parsed))
+        {
+            LogError("the message content doesn't add up to the message size");
+            result = __LINE__;
+        }
+        else
+        {
+            layout->version = version;
+            layout->contentPosition = currentPosition + parsed;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*whether source starts as a version 2 or 3 message*/
+static int is_version_2(const unsigned char* source, int32_t size)
+{
+    return
+        (size >= MIN_MESSAGE_V2_BUFFER_LENGTH) &&
+        (source[0] == FIRST_MESSAGE_BYTE) &&
+        (source[1] == SECOND_MESSAGE_BYTE) &&
+        (source[2] == VERSION_2_MESSAGE_BYTE || source[2] == VERSION_3_MESSAGE_BYTE);
+}
+
+/*checks that source holds a whole serialized message of any version and finds where its properties and content are*/
+static int parse_byte_array_layout(const unsigned char* source, int32_t size, BYTE_ARRAY_LAYOUT* layout)
+{
+    int result;
+    if (is_version_2(source, size))
+    {
+        result = parse_byte_array_layout_v2(source, size, source[2] & 0x7F, layout);
+    }
+    else if ((size < MIN_MESSAGE_BUFFER_LENGTH) || (source[0] != FIRST_MESSAGE_BYTE) || (source[1] != SECOND_MESSAGE_BYTE))
+    {
+        LogError("byte array is not a gateway message serialization");
+        result = __LINE__;
+    }
+    else
+    {
+        result = parse_byte_array_layout_v1(source, size, layout);
+    }
+    return result;
+}
+
+/*builds a message whose properties and content point into source, NULL if source is not a serialized message*/
+static MESSAGE_HANDLE_DATA* create_on_byte_array(const unsigned char* source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void* context)
+{
+    MESSAGE_HANDLE_DATA* result;
+    BYTE_ARRAY_LAYOUT layout;
+    /*Codes_SRS_MESSAGE_17_031: [ Message_CreateFromOwnedByteArray shall fail and return NULL if source is not a serialized message, exactly as Message_CreateFromByteArray would. ]*/
+    if (parse_byte_array_layout(source, size, &layout) != 0)
+    {
+        result = NULL;
+    }
+    else if ((result = message_data_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_032: [ If any underlying call fails, Message_CreateFromOwnedByteArray shall return NULL and shall not call release. ]*/
+        LogError("unable to allocate a message");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_033: [ Message_CreateFromOwnedByteArray shall create the property set with MESSAGE_PROPERTIES_create_borrowed, or MESSAGE_PROPERTIES_create_borrowed_v2 for version 2 of the serialized form, pointing into source. ]*/
+        /*Codes_SRS_MESSAGE_17_062: [ Message_CreateFromOwnedByteArray shall create the property set of version 3 of the serialized form with MESSAGE_PROPERTIES_create_borrowed_v3. ]*/
+        result->properties =
+            (layout.version == GATEWAY_MESSAGE_VERSION_3) ? MESSAGE_PROPERTIES_create_borrowed_v3(source + layout.propertiesPosition, (size_t)layout.propertiesCount) :
+            (layout.version == GATEWAY_MESSAGE_VERSION_2) ? MESSAGE_PROPERTIES_create_borrowed_v2(source + layout.propertiesPosition, (size_t)layout.propertiesCount) :
+            MESSAGE_PROPERTIES_create_borrowed((const char*)source + layout.propertiesPosition, (size_t)layout.propertiesCount);
+        if (result->properties == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_032: [ If any underlying call fails, Message_CreateFromOwnedByteArray shall return NULL and shall not call release. ]*/
+            LogError("unable to create the properties");
+            MESSAGE_POOL_free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_034: [ Message_CreateFromOwnedByteArray shall use the content inside source without copying it. ]*/
+            result->content = NULL;
+            result->ownedContent.buffer = source + layout.contentPosition;
+            result->ownedContent.size = (size_t)(size - layout.contentPosition);
+            result->ownedByteArray.buffer = source;
+            result->ownedByteArray.size = (size_t)size;
+            /*Codes_SRS_MESSAGE_17_035: [ On success, Message_CreateFromOwnedByteArray shall keep release and context, and return a non-NULL handle with the ref count set to "1". ]*/
+            result->release = release;
+            result->releaseContext = context;
+        }
+    }
+    return result;
+}
+
+/*creates a MESSAGE_HANDLE from a serialized byte array*/
+MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
+{
+    MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    if (
+        (source == NULL) ||
+        ((size < MIN_MESSAGE_BUFFER_LENGTH) && !is_version_2(source, size))
+        )
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    else if (is_version_2(source, size))
+    {
+        /*Codes_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+        unsigned char* copy = (unsigned char*)MESSAGE_POOL_alloc((size_t)size);
+        if (copy == NULL)
+        {
+            LogError("unable to allocate %" PRId32 " bytes", size);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(copy, source, (size_t)size);
+            result = create_on_byte_array(copy, size, MESSAGE_POOL_free, copy);
+            if (result == NULL)
+            {
+                MESSAGE_POOL_free(copy);
+            }
+        }
     }
     else
     {
@@ -460,118 +1242,446 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 
 }
 
-extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+MESSAGE_HANDLE Message_CreateFromOwnedByteArray(const unsigned char* source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void* context)
 {
-    int32_t result;
-    if (messageHandle == NULL) 
+    MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_MESSAGE_17_030: [ If source or release is NULL, or size is smaller than the smallest serialized message, then Message_CreateFromOwnedByteArray shall fail and return NULL. ]*/
+    if (source == NULL || release == NULL || size < MIN_MESSAGE_V2_BUFFER_LENGTH)
     {
-        /*Codes_SRS_MESSAGE_02_032: [ If messageHandle is NULL then Message_ToByteArray shall fail and return -1. ]*/
-        LogError("invalid (NULL) messageHandle parameter detected", messageHandle, size);
-        result = -1;
+        LogError("invalid parameter source=[%p] size=%" PRId32 " release=[%p]", source, size, release);
+        result = NULL;
     }
-    else if (
-        (buf == NULL) &&
-        (size != 0)
-        )
+    else
     {
-        /*Codes_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
-        LogError("Null buffer sent with a specific size buffer=[%p], size=[%d]", messageHandle, size);
-        result = -1;
+        result = create_on_byte_array(source, size, release, context);
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+/*the varint before the name of a property in version 2: an interned id with the low bit set, or the length of the name*/
+static uint32_t property_name_tag(const MESSAGE_PROPERTY* property)
+{
+    return (property->interned != 0) ?
+        ((uint32_t)(property->interned - 1) << 1) | 1 :
+        (uint32_t)property->key_length << 1;
+}
+
+/*the bytes the value of a property takes, after its type in version 3*/
+static size_t property_value_size(const MESSAGE_PROPERTY* property)
+{
+    return
+        (property->typed.type == MESSAGE_PROPERTY_TYPE_STRING) ? message_varint_size((uint32_t)property->value_length) + property->value_length + 1 :
+        (property->typed.type == MESSAGE_PROPERTY_TYPE_BYTES) ? message_varint_size((uint32_t)property->typed.value.bytes.size) + property->typed.value.bytes.size :
+        MESSAGE_FIXED64_SIZE;
+}
+
+/*the serialized size of a message, 0 if it would not fit the 32 bit size of the format; version is 3 if a value is not a string, 2 otherwise*/
+static size_t message_byte_array_size(MESSAGE_HANDLE_DATA* messageData, const CONSTBUFFER* messageContent, uint8_t* version)
+{
+    /*Codes_SRS_MESSAGE_02_033: [Message_ToByteArray shall precompute the needed memory size.]*/
+    size_t nProperties = MESSAGE_PROPERTIES_get_count(messageData->properties);
+    size_t result =
+        + 2 /*header*/
+        + 1 /*version*/
+        + 4 /*total size of byte array*/
+        + message_varint_size((uint32_t)nProperties) /*total number of properties*/
+        + 0 /*an unknown at this moment number of bytes for properties*/
+        + message_varint_size((uint32_t)messageContent->size) /*number of bytes in messageContent*/
+        + 0 /*an unknown at this moment number of bytes for message content*/
+        ;
+
+    /*Codes_SRS_MESSAGE_17_018: [ Message_ToByteArray shall take the names, values and lengths of the properties from the message's property set. ]*/
+    size_t i;
+    *version = GATEWAY_MESSAGE_VERSION_2;
+    for (i = 0;i < nProperties;i++)
+    {
+        /*add to the needed size the name and value of property i*/
+        const MESSAGE_PROPERTY* property = MESSAGE_PROPERTIES_get_at(messageData->properties, i);
+        result += message_varint_size(property_name_tag(property));
+        if (property->interned == 0)
+        {
+            result += property->key_length + 1;
+        }
+        if (property->typed.type != MESSAGE_PROPERTY_TYPE_STRING)
+        {
+            *version = GATEWAY_MESSAGE_VERSION_3;
+        }
+        result += property_value_size(property);
+    }
+
+    if (*version == GATEWAY_MESSAGE_VERSION_3)
+    {
+        /*the type of every value*/
+        result += nProperties;
+    }
+
+    result += messageContent->size;
+    return (result > INT32_MAX || nProperties > INT32_MAX || messageContent->size > INT32_MAX) ? 0 : result;
+}
+
+/*writes a version 2 string: its length, the bytes and '\0'*/
+static size_t write_v2_string(unsigned char* buf, const char* value, size_t length)
+{
+    size_t result = message_varint_write(buf, (uint32_t)length);
+    memcpy(buf + result, value, length + 1);/*the +1 will take care of copying '\0' too*/
+    return result + length + 1;
+}
+
+/*writes a version 3 value: its type, then a version 2 string, a length and as many bytes, or an 8 byte number*/
+static size_t write_v3_value(unsigned char* buf, const MESSAGE_PROPERTY* property)
+{
+    const MESSAGE_PROPERTY_VALUE* value = &property->typed;
+    size_t result = 1;
+    buf[0] = (unsigned char)value->type;
+    if (value->type == MESSAGE_PROPERTY_TYPE_STRING)
+    {
+        result += write_v2_string(buf + result, property->value, property->value_length);
+    }
+    else if (value->type == MESSAGE_PROPERTY_TYPE_BYTES)
+    {
+        result += message_varint_write(buf + result, (uint32_t)value->value.bytes.size);
+        if (value->value.bytes.size > 0)
+        {
+            memcpy(buf + result, value->value.bytes.buffer, value->value.bytes.size);
+        }
+        result += value->value.bytes.size;
     }
     else
     {
-        MESSAGE_HANDLE_DATA* messageHandleData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        uint64_t bits;
+        if (value->type == MESSAGE_PROPERTY_TYPE_DOUBLE)
+        {
+            (void)memcpy(&bits, &value->value.real, sizeof(bits));
+        }
+        else if (value->type == MESSAGE_PROPERTY_TYPE_TIMESTAMP)
+        {
+            bits = (uint64_t)value->value.timestamp;
+        }
+        else
+        {
+            bits = (uint64_t)value->value.integer;
+        }
+        message_fixed64_write(buf + result, bits);
+        result += MESSAGE_FIXED64_SIZE;
+    }
+    return result;
+}
 
-        /*Codes_SRS_MESSAGE_02_033: [Message_ToByteArray shall precompute the needed memory size.]*/
-        size_t byteArraySize =
-            + 2 /*header*/
-            + 4 /*total size of byte array*/
-            + 4 /*total number of properties*/
-            + 0 /*an unknown at this moment number of bytes for properties*/
-            + 4 /*number of bytes in messageContent*/
-            + 0 /*an unknown at this moment number of bytes for message content*/
-            ;
-        
-        const char* const * keys;
-        const char* const * values;
-        size_t nProperties;
+static void message_byte_array_write(MESSAGE_HANDLE_DATA* messageData, const CONSTBUFFER* messageContent, uint8_t version, unsigned char* buf, size_t byteArraySize)
+{
+    /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
+    /*Codes_SRS_MESSAGE_17_043: [ Message_ToByteArray shall write version 2 of the serialized form, interning the names of MESSAGE_PROPERTY_ID. ]*/
+    size_t nProperties = MESSAGE_PROPERTIES_get_count(messageData->properties);
+    size_t currentPosition; /*always points to the byte we are about to write*/
+    size_t i;
+    /*a header formed of the following hex characters in this order: 0xA1 0x60*/
+    buf[0] = FIRST_MESSAGE_BYTE;
+    buf[1] = SECOND_MESSAGE_BYTE;
+    /*the version, with the bit no version 1 size has*/
+    /*Codes_SRS_MESSAGE_17_063: [ If a property of the message is not a string, Message_ToByteArray shall write version 3 of the serialized form instead, where every value starts with its type, and bytes and numbers are written in binary. ]*/
+    buf[2] = (version == GATEWAY_MESSAGE_VERSION_3) ? VERSION_3_MESSAGE_BYTE : VERSION_2_MESSAGE_BYTE;
+    /*4 bytes in MSB order representing the total size of the byte array. */
+    buf[3] = byteArraySize >> 24;
+    buf[4] = (byteArraySize >> 16) & 0xFF;
+    buf[5] = (byteArraySize >> 8) & 0xFF;
+    buf[6] = (byteArraySize) & 0xFF;
+    /*a varint representing the number of properties*/
+    currentPosition = 7;
+    currentPosition += message_varint_write(buf + currentPosition, (uint32_t)nProperties);
+    /*for every property, the name (an interned id, or a length prefixed, null terminated string) and the value (a length prefixed, null terminated string, or in version 3 a typed value)*/
+    for (i = 0;i < nProperties;i++)
+    {
+        const MESSAGE_PROPERTY* property = MESSAGE_PROPERTIES_get_at(messageData->properties, i);
+        currentPosition += message_varint_write(buf + currentPosition, property_name_tag(property));
+        if (property->interned == 0)
+        {
+            memcpy(buf + currentPosition, property->key, property->key_length + 1);/*the +1 will take care of copying '\0' too*/
+            currentPosition += property->key_length + 1;
+        }
 
-        /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
-        if (ConstMap_GetInternals(messageHandleData->properties, &keys, &values, &nProperties) != CONSTMAP_OK)
+        currentPosition += (version == GATEWAY_MESSAGE_VERSION_3) ?
+            write_v3_value(buf + currentPosition, property) :
+            write_v2_string(buf + currentPosition, property->value, property->value_length);
+    }
+
+    /*a varint representing the number of bytes in the message content array*/
+    currentPosition += message_varint_write(buf + currentPosition, (uint32_t)messageContent->size);
+
+    /*n bytes of message content follows.*/
+    memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+}
+
+/*the value of a property as a string, turning a value that is not one into a string; NULL if that fails*/
+static const char* property_string(MESSAGE_HANDLE_DATA* messageData, const MESSAGE_PROPERTY* property)
+{
+    return (property->typed.type == MESSAGE_PROPERTY_TYPE_STRING) ?
+        property->value :
+        MESSAGE_PROPERTIES_get(messageData->properties, property->key);
+}
+
+/*the size of a message written in version 1 or 2, where every value is a string, 0 if it would not fit the 32 bit size of the format or a value cannot be turned into a string*/
+static size_t message_string_byte_array_size(MESSAGE_HANDLE_DATA* messageData, const CONSTBUFFER* messageContent, uint8_t version)
+{
+    size_t nProperties = MESSAGE_PROPERTIES_get_count(messageData->properties);
+    size_t result = (version == GATEWAY_MESSAGE_VERSION_1) ?
+        2 /*header*/ + 4 /*total size*/ + 4 /*number of properties*/ + 4 /*number of bytes in messageContent*/ :
+        2 /*header*/ + 1 /*version*/ + 4 /*total size*/ + message_varint_size((uint32_t)nProperties) + message_varint_size((uint32_t)messageContent->size);
+    size_t i;
+    for (i = 0; i < nProperties; i++)
+    {
+        const MESSAGE_PROPERTY* property = MESSAGE_PROPERTIES_get_at(messageData->properties, i);
+        const char* value = property_string(messageData, property);
+        if (value == NULL)
         {
-            LogError("failed to get the keys and values from the message properties");
-            result = -1;
+            LogError("unable to write property %s as a string", property->key);
+            break;
+        }
+        size_t valueLength = strlen(value);
+        if (version == GATEWAY_MESSAGE_VERSION_1)
+        {
+            result += (property->key_length + 1) + (valueLength + 1);
         }
         else
         {
-            size_t i;
-            for (i = 0;i < nProperties;i++)
+            result += message_varint_size(property_name_tag(property));
+            if (property->interned == 0)
             {
-                /*add to the needed size the name and value of property i*/
-                byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
+                result += property->key_length + 1;
             }
+            result += message_varint_size((uint32_t)valueLength) + valueLength + 1;
+        }
+    }
+
+    result += messageContent->size;
+    return (i != nProperties || result > INT32_MAX || nProperties > INT32_MAX || messageContent->size > INT32_MAX) ? 0 : result;
+}
+
+/*writes a 32 bit number in MSB order*/
+static size_t write_int32(unsigned char* buf, size_t value)
+{
+    buf[0] = (value >> 24) & 0xFF;
+    buf[1] = (value >> 16) & 0xFF;
+    buf[2] = (value >> 8) & 0xFF;
+    buf[3] = value & 0xFF;
+    return 4;
+}
+
+static void message_string_byte_array_write(MESSAGE_HANDLE_DATA* messageData, const CONSTBUFFER* messageContent, uint8_t version, unsigned char* buf, size_t byteArraySize)
+{
+    size_t nProperties = MESSAGE_PROPERTIES_get_count(messageData->properties);
+    size_t currentPosition = 0; /*always points to the byte we are about to write*/
+    size_t i;
+    /*a header formed of the following hex characters in this order: 0xA1 0x60*/
+    buf[currentPosition++] = FIRST_MESSAGE_BYTE;
+    buf[currentPosition++] = SECOND_MESSAGE_BYTE;
+    if (version == GATEWAY_MESSAGE_VERSION_1)
+    {
+        /*4 bytes in MSB order for the total size, then 4 for the number of properties*/
+        currentPosition += write_int32(buf + currentPosition, byteArraySize);
+        currentPosition += write_int32(buf + currentPosition, nProperties);
+    }
+    else
+    {
+        buf[currentPosition++] = VERSION_2_MESSAGE_BYTE;
+        currentPosition += write_int32(buf + currentPosition, byteArraySize);
+        currentPosition += message_varint_write(buf + currentPosition, (uint32_t)nProperties);
+    }
 
-            const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
-            byteArraySize += messageContent->size;
-            
-            if (size == 0)
+    for (i = 0; i < nProperties; i++)
+    {
+        const MESSAGE_PROPERTY* property = MESSAGE_PROPERTIES_get_at(messageData->properties, i);
+        /*the size was only computed if every value could be turned into a string*/
+        const char* value = property_string(messageData, property);
+        if (version == GATEWAY_MESSAGE_VERSION_1)
+        {
+            /*2 arrays of null terminated characters, the name of the property and the value*/
+            memcpy(buf + currentPosition, property->key, property->key_length + 1);
+            currentPosition += property->key_length + 1;
+            size_t valueLength = strlen(value) + 1;/*the +1 will take care of copying '\0' too*/
+            memcpy(buf + currentPosition, value, valueLength);
+            currentPosition += valueLength;
+        }
+        else
+        {
+            currentPosition += message_varint_write(buf + currentPosition, property_name_tag(property));
+            if (property->interned == 0)
             {
-                /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
-                result = byteArraySize;
+                memcpy(buf + currentPosition, property->key, property->key_length + 1);
+                currentPosition += property->key_length + 1;
             }
-            else if (byteArraySize > (size_t)size)
+            currentPosition += write_v2_string(buf + currentPosition, value, strlen(value));
+        }
+    }
+
+    currentPosition += (version == GATEWAY_MESSAGE_VERSION_1) ?
+        write_int32(buf + currentPosition, messageContent->size) :
+        message_varint_write(buf + currentPosition, (uint32_t)messageContent->size);
+
+    /*n bytes of message content follows.*/
+    memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+}
+
+static const CONSTBUFFER* message_byte_array_get(MESSAGE_HANDLE_DATA* messageData)
+{
+    MESSAGE_BYTE_ARRAY* result = (MESSAGE_BYTE_ARRAY*)gateway_atomic_load_pointer(&messageData->byteArray);
+    if (result == NULL)
+    {
+        const CONSTBUFFER* messageContent = (messageData->content == NULL) ? &messageData->ownedContent : CONSTBUFFER_GetContent(messageData->content);
+        uint8_t version;
+        size_t byteArraySize = message_byte_array_size(messageData, messageContent, &version);
+        if (byteArraySize == 0)
+        {
+            LogError("message is too large to serialize");
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_024: [ On the first call, Message_GetByteArray shall serialize the message into a block from MESSAGE_POOL_alloc. ]*/
+            MESSAGE_BYTE_ARRAY* built = (MESSAGE_BYTE_ARRAY*)MESSAGE_POOL_alloc(sizeof(MESSAGE_BYTE_ARRAY) + byteArraySize);
+            if (built == NULL)
             {
-                /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-                LogError("message is %u bytes, won't fit in buffer of %u bytes", byteArraySize, size);
-                result = -1;
+                /*Codes_SRS_MESSAGE_17_028: [ If building the serialized form fails, Message_GetByteArray shall return NULL. ]*/
+                LogError("unable to allocate %zu bytes for the serialized message", byteArraySize);
             }
             else
             {
-                /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-
-                size_t currentPosition; /*always points to the byte we are about to write*/
-                /*a header formed of the following hex characters in this order: 0xA1 0x60*/
-                buf[0] = FIRST_MESSAGE_BYTE;
-                buf[1] = SECOND_MESSAGE_BYTE;
-                /*4 bytes in MSB order representing the total size of the byte array. */
-                buf[2] = byteArraySize >> 24;
-                buf[3] = (byteArraySize >> 16) & 0xFF;
-                buf[4] = (byteArraySize >> 8) & 0xFF;
-                buf[5] = (byteArraySize) & 0xFF;
-                /*4 bytes in MSB order representing the number of properties*/
-                buf[6] = nProperties >> 24;
-                buf[7] = (nProperties >> 16) & 0xFF;
-                buf[8] = (nProperties >> 8) & 0xFF;
-                buf[9] = nProperties & 0xFF;
-                /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
-				currentPosition = 10;
-                for (i = 0;i < nProperties;i++)
+                unsigned char* bytes = (unsigned char*)(built + 1);
+                message_byte_array_write(messageData, messageContent, version, bytes, byteArraySize);
+                built->view.buffer = bytes;
+                built->view.size = byteArraySize;
+
+                /*Codes_SRS_MESSAGE_17_025: [ Message_GetByteArray shall publish the serialized form with an atomic compare-exchange; if another thread published one first, it shall free its own and use that one. ]*/
+                if (gateway_atomic_compare_exchange_pointer(&messageData->byteArray, NULL, built))
+                {
+                    result = built;
+                }
+                else
                 {
-                    size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
-                    size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
-
-                    /*copy name*/
-                    memcpy(buf + currentPosition, keys[i], nameLength);
-                    currentPosition += nameLength;
-                    
-                    /*copy value*/
-                    memcpy(buf + currentPosition, values[i], valueLength);
-                    currentPosition += valueLength;
+                    MESSAGE_POOL_free(built);
+                    result = (MESSAGE_BYTE_ARRAY*)gateway_atomic_load_pointer(&messageData->byteArray);
                 }
+            }
+        }
+    }
+    return (result == NULL) ? NULL : &result->view;
+}
 
-                /*4 bytes in MSB order representing the number of bytes in the message content array*/
-                buf[currentPosition++] = (messageContent->size) >> 24;
-                buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
-                buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
-                buf[currentPosition++] = (messageContent->size) & 0xFF;
+static const CONSTBUFFER* message_serialized(MESSAGE_HANDLE_DATA* messageData)
+{
+    /*Codes_SRS_MESSAGE_17_039: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetByteArray shall return the owned byte array. ]*/
+    return (messageData->ownedByteArray.buffer != NULL) ? &messageData->ownedByteArray : message_byte_array_get(messageData);
+}
 
-                /*n bytes of message content follows.*/
-                memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+const CONSTBUFFER* Message_GetByteArray(MESSAGE_HANDLE message)
+{
+    const CONSTBUFFER* result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_023: [ If message is NULL then Message_GetByteArray shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_027: [ Otherwise, Message_GetByteArray shall return the serialized form kept with the message, without serializing it again. ]*/
+        result = message_serialized((MESSAGE_HANDLE_DATA*)message);
+    }
+    return result;
+}
 
-                /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
-                result = byteArraySize;
-            }
+extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+{
+    int32_t result;
+    if (messageHandle == NULL) 
+    {
+        /*Codes_SRS_MESSAGE_02_032: [ If messageHandle is NULL then Message_ToByteArray shall fail and return -1. ]*/
+        LogError("invalid (NULL) messageHandle parameter detected", messageHandle, size);
+        result = -1;
+    }
+    else if (
+        (buf == NULL) &&
+        (size != 0)
+        )
+    {
+        /*Codes_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
+        LogError("Null buffer sent with a specific size buffer=[%p], size=[%d]", messageHandle, size);
+        result = -1;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_029: [ Message_ToByteArray shall get the serialized form of the message as Message_GetByteArray does, and fail and return -1 if that fails. ]*/
+        const CONSTBUFFER* byteArray = message_serialized((MESSAGE_HANDLE_DATA*)messageHandle);
+        if (byteArray == NULL)
+        {
+            LogError("unable to serialize the message");
+            result = -1;
+        }
+        else if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
+            result = (int32_t)byteArray->size;
+        }
+        else if (byteArray->size > (size_t)size)
+        {
+            /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+            LogError("message is %zu bytes, won't fit in buffer of %" PRId32 " bytes", byteArray->size, size);
+            result = -1;
+        }
+        else
+        {
+            memcpy(buf, byteArray->buffer, byteArray->size);
+            /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+            result = (int32_t)byteArray->size;
         }
     }
     return result;
-}
\ No newline at end of file
+}
+
+int32_t Message_ToByteArrayVersion(MESSAGE_HANDLE messageHandle, uint8_t version, unsigned char* buf, int32_t size)
+{
+    int32_t result;
+    if (messageHandle == NULL ||
+        (buf == NULL && size != 0) ||
+        version < GATEWAY_MESSAGE_VERSION_1 || version > GATEWAY_MESSAGE_VERSION_CURRENT)
+    {
+        /*Codes_SRS_MESSAGE_17_095: [ If messageHandle is NULL, buf is NULL and size is not zero, or version is not a GATEWAY_MESSAGE_VERSION, Message_ToByteArrayVersion shall fail and return -1. ]*/
+        LogError("invalid arg messageHandle=%p, version=%u, buf=%p, size=%" PRId32, messageHandle, (unsigned int)version, buf, size);
+        result = -1;
+    }
+    else if (version == GATEWAY_MESSAGE_VERSION_CURRENT)
+    {
+        /*Codes_SRS_MESSAGE_17_096: [ If version is GATEWAY_MESSAGE_VERSION_CURRENT, Message_ToByteArrayVersion shall behave as Message_ToByteArray. ]*/
+        result = Message_ToByteArray(messageHandle, buf, size);
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_097: [ Otherwise, Message_ToByteArrayVersion shall write every value as a string, turning a value that is not one into a string as Message_GetProperty does, and fail and return -1 if that fails. ]*/
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        const CONSTBUFFER* messageContent = (messageData->content == NULL) ? &messageData->ownedContent : CONSTBUFFER_GetContent(messageData->content);
+        size_t byteArraySize = message_string_byte_array_size(messageData, messageContent, version);
+        if (byteArraySize == 0)
+        {
+            LogError("unable to serialize the message in version %u", (unsigned int)version);
+            result = -1;
+        }
+        else if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_17_098: [ If buf is NULL and size is zero, Message_ToByteArrayVersion shall return the needed memory size. ]*/
+            result = (int32_t)byteArraySize;
+        }
+        else if (byteArraySize > (size_t)size)
+        {
+            /*Codes_SRS_MESSAGE_17_099: [ If size is less than the needed memory size, Message_ToByteArrayVersion shall fail and return -1. ]*/
+            LogError("message is %zu bytes, won't fit in buffer of %" PRId32 " bytes", byteArraySize, size);
+            result = -1;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_100: [ For GATEWAY_MESSAGE_VERSION_1, Message_ToByteArrayVersion shall write the header, 4 byte sizes and counts, and null terminated names and values of version 1. ]*/
+            /*Codes_SRS_MESSAGE_17_101: [ For GATEWAY_MESSAGE_VERSION_2, Message_ToByteArrayVersion shall write version 2 of the serialized form, interning the names of MESSAGE_PROPERTY_ID. ]*/
+            message_string_byte_array_write(messageData, messageContent, version, buf, byteArraySize);
+            /*Codes_SRS_MESSAGE_17_102: [ Otherwise Message_ToByteArrayVersion shall succeed, and return the byte array size. ]*/
+            result = (int32_t)byteArraySize;
+        }
+    }
+    return result;
+}
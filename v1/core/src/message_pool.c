@@ -0,0 +1,480 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message_pool.h"
+#include "gateway_atomic.h"
+
+/*size classes hold 32, 64, 128 and 256 bytes*/
+#define POOL_CLASS_COUNT 4
+#define POOL_SMALLEST_CLASS 32
+/*marks a block that was passed to malloc*/
+#define POOL_UNPOOLED POOL_CLASS_COUNT
+/*blocks carved from every slab*/
+#define POOL_SLAB_BLOCKS 64
+/*blocks moved between a thread's cache and the shared lists at once*/
+#define POOL_BATCH 32
+/*free blocks a thread keeps per class before it gives a batch back*/
+#define POOL_CACHE_LIMIT (2 * POOL_BATCH)
+/*allocations after which a thread folds its counters into the totals*/
+#define POOL_STATISTICS_INTERVAL 1024
+
+#define POOL_STATE_NONE 0
+#define POOL_STATE_STARTING 1
+#define POOL_STATE_READY 2
+#define POOL_STATE_FAILED 3
+
+/*Precedes every block and keeps its size class for as long as the slab
+ *lives. Its size keeps the block behind it aligned like the header.
+ */
+typedef union POOL_HEADER_TAG
+{
+    size_t      size_class;
+    void*       align_pointer;
+    uint64_t    align_u64;
+    double      align_double;
+} POOL_HEADER;
+
+/*Overlays a block while it is free. On the shared lists free blocks travel
+ *in batches; the first block of a batch links the next batch.
+ */
+typedef struct POOL_FREE_BLOCK_TAG
+{
+    struct POOL_FREE_BLOCK_TAG* next;
+    struct POOL_FREE_BLOCK_TAG* next_batch;
+    size_t                      batch_count;
+} POOL_FREE_BLOCK;
+
+typedef struct POOL_THREAD_CACHE_TAG
+{
+    POOL_FREE_BLOCK*        blocks[POOL_CLASS_COUNT];
+    size_t                  count[POOL_CLASS_COUNT];
+    /** Counters not yet folded into the totals */
+    MESSAGE_POOL_STATISTICS pending;
+    size_t                  allocations;
+} POOL_THREAD_CACHE;
+
+typedef struct POOL_SHARED_TAG
+{
+    /** Spin lock guarding the fields below, only held for a few instructions */
+    GATEWAY_ATOMIC_U32      busy;
+    POOL_FREE_BLOCK*        batches[POOL_CLASS_COUNT];
+    MESSAGE_POOL_STATISTICS totals;
+} POOL_SHARED;
+
+static POOL_SHARED pool_shared;
+static GATEWAY_ATOMIC_U32 pool_state;
+
+static void shared_lock(void)
+{
+    while (!gateway_atomic_compare_exchange(&pool_shared.busy, 0, 1))
+    {
+        /*spin, the holder is about to release*/
+    }
+}
+
+static void shared_unlock(void)
+{
+    gateway_atomic_store(&pool_shared.busy, 0);
+}
+
+static size_t class_size(size_t size_class)
+{
+    return (size_t)POOL_SMALLEST_CLASS << size_class;
+}
+
+static size_t size_to_class(size_t size)
+{
+    size_t result = 0;
+    while (result < POOL_CLASS_COUNT && size > class_size(result))
+    {
+        result++;
+    }
+    return result;
+}
+
+static void add_statistics(MESSAGE_POOL_STATISTICS* totals, const MESSAGE_POOL_STATISTICS* counters)
+{
+    totals->thread_hits += counters->thread_hits;
+    totals->shared_hits += counters->shared_hits;
+    totals->misses += counters->misses;
+    totals->oversized += counters->oversized;
+    totals->slab_bytes += counters->slab_bytes;
+}
+
+/*the shared lock is held*/
+static void fold_statistics(POOL_THREAD_CACHE* cache)
+{
+    add_statistics(&pool_shared.totals, &cache->pending);
+    memset(&cache->pending, 0, sizeof(cache->pending));
+    cache->allocations = 0;
+}
+
+/*the shared lock is held*/
+static void push_batch(size_t size_class, POOL_FREE_BLOCK* batch, size_t count)
+{
+    batch->batch_count = count;
+    batch->next_batch = pool_shared.batches[size_class];
+    pool_shared.batches[size_class] = batch;
+}
+
+/*hands every block of an exiting thread's cache to the shared lists*/
+static void thread_cache_release(POOL_THREAD_CACHE* cache)
+{
+    size_t size_class;
+    shared_lock();
+    for (size_class = 0; size_class < POOL_CLASS_COUNT; size_class++)
+    {
+        if (cache->count[size_class] > 0)
+        {
+            push_batch(size_class, cache->blocks[size_class], cache->count[size_class]);
+        }
+    }
+    fold_statistics(cache);
+    shared_unlock();
+    free(cache);
+}
+
+#ifdef _WIN32
+static DWORD pool_key;
+
+static VOID WINAPI thread_cache_exit(PVOID value)
+{
+    if (value != NULL)
+    {
+        thread_cache_release((POOL_THREAD_CACHE*)value);
+    }
+}
+
+static bool pool_key_create(void)
+{
+    pool_key = FlsAlloc(thread_cache_exit);
+    return pool_key != FLS_OUT_OF_INDEXES;
+}
+
+static POOL_THREAD_CACHE* pool_key_get(void)
+{
+    return (POOL_THREAD_CACHE*)FlsGetValue(pool_key);
+}
+
+static bool pool_key_set(POOL_THREAD_CACHE* cache)
+{
+    return FlsSetValue(pool_key, cache) != 0;
+}
+#else
+static pthread_key_t pool_key;
+
+static void thread_cache_exit(void* value)
+{
+    if (value != NULL)
+    {
+        thread_cache_release((POOL_THREAD_CACHE*)value);
+    }
+}
+
+static bool pool_key_create(void)
+{
+    return pthread_key_create(&pool_key, thread_cache_exit) == 0;
+}
+
+static POOL_THREAD_CACHE* pool_key_get(void)
+{
+    return (POOL_THREAD_CACHE*)pthread_getspecific(pool_key);
+}
+
+static bool pool_key_set(POOL_THREAD_CACHE* cache)
+{
+    return pthread_setspecific(pool_key, cache) == 0;
+}
+#endif
+
+/*creates the thread cache key once, returns false if the pool cannot keep thread caches*/
+static bool pool_start(void)
+{
+    uint32_t state;
+    if (gateway_atomic_compare_exchange(&pool_state, POOL_STATE_NONE, POOL_STATE_STARTING))
+    {
+        if (pool_key_create())
+        {
+            gateway_atomic_store(&pool_state, POOL_STATE_READY);
+        }
+        else
+        {
+            LogError("unable to create the thread cache key, messages will not be pooled");
+            gateway_atomic_store(&pool_state, POOL_STATE_FAILED);
+        }
+    }
+
+    while ((state = gateway_atomic_load(&pool_state)) == POOL_STATE_STARTING)
+    {
+        /*another thread is creating the key*/
+    }
+    return state == POOL_STATE_READY;
+}
+
+static POOL_THREAD_CACHE* get_thread_cache(void)
+{
+    POOL_THREAD_CACHE* result;
+    if (!pool_start())
+    {
+        result = NULL;
+    }
+    else if ((result = pool_key_get()) == NULL)
+    {
+        result = (POOL_THREAD_CACHE*)malloc(sizeof(POOL_THREAD_CACHE));
+        if (result == NULL)
+        {
+            LogError("unable to allocate a thread cache");
+        }
+        else
+        {
+            memset(result, 0, sizeof(POOL_THREAD_CACHE));
+            if (!pool_key_set(result))
+            {
+                LogError("unable to set the thread cache");
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+/*takes a batch freed by other threads, the cache has no block of the class*/
+static bool take_batch(POOL_THREAD_CACHE* cache, size_t size_class)
+{
+    bool result;
+    POOL_FREE_BLOCK* batch;
+    shared_lock();
+    batch = pool_shared.batches[size_class];
+    if (batch == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        pool_shared.batches[size_class] = batch->next_batch;
+        cache->blocks[size_class] = batch;
+        cache->count[size_class] = batch->batch_count;
+        fold_statistics(cache);
+        result = true;
+    }
+    shared_unlock();
+    return result;
+}
+
+/*gives the oldest part of an overfull cache back to the shared lists*/
+static void give_batch(POOL_THREAD_CACHE* cache, size_t size_class)
+{
+    POOL_FREE_BLOCK* batch = cache->blocks[size_class];
+    POOL_FREE_BLOCK* last = batch;
+    size_t i;
+    for (i = 1; i < POOL_BATCH; i++)
+    {
+        last = last->next;
+    }
+    cache->blocks[size_class] = last->next;
+    cache->count[size_class] -= POOL_BATCH;
+    last->next = NULL;
+
+    shared_lock();
+    push_batch(size_class, batch, POOL_BATCH);
+    fold_statistics(cache);
+    shared_unlock();
+}
+
+/*carves a new slab into the cache, which has no block of the class*/
+static bool carve_slab(POOL_THREAD_CACHE* cache, size_t size_class)
+{
+    bool result;
+    size_t stride = sizeof(POOL_HEADER) + class_size(size_class);
+    unsigned char* slab = (unsigned char*)malloc(POOL_SLAB_BLOCKS * stride);
+    if (slab == NULL)
+    {
+        LogError("unable to allocate a slab of %zu byte blocks", class_size(size_class));
+        result = false;
+    }
+    else
+    {
+        size_t i;
+        for (i = POOL_SLAB_BLOCKS; i > 0; i--)
+        {
+            POOL_HEADER* header = (POOL_HEADER*)(slab + (i - 1) * stride);
+            POOL_FREE_BLOCK* block = (POOL_FREE_BLOCK*)(header + 1);
+            header->size_class = size_class;
+            block->next = cache->blocks[size_class];
+            cache->blocks[size_class] = block;
+        }
+        cache->count[size_class] = POOL_SLAB_BLOCKS;
+        cache->pending.slab_bytes += POOL_SLAB_BLOCKS * stride;
+        result = true;
+    }
+    return result;
+}
+
+static void* alloc_unpooled(size_t size, POOL_THREAD_CACHE* cache)
+{
+    void* result;
+    POOL_HEADER* header;
+    if (size > SIZE_MAX - sizeof(POOL_HEADER) ||
+        (header = (POOL_HEADER*)malloc(sizeof(POOL_HEADER) + size)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_POOL_17_003: [ MESSAGE_POOL_alloc shall return NULL if it cannot allocate memory. ]*/
+        LogError("unable to allocate %zu bytes", size);
+        result = NULL;
+    }
+    else
+    {
+        header->size_class = POOL_UNPOOLED;
+        if (cache != NULL)
+        {
+            cache->pending.oversized++;
+        }
+        else
+        {
+            shared_lock();
+            pool_shared.totals.oversized++;
+            shared_unlock();
+        }
+        result = header + 1;
+    }
+    return result;
+}
+
+void* MESSAGE_POOL_alloc(size_t size)
+{
+    void* result;
+    size_t size_class = size_to_class(size);
+    POOL_THREAD_CACHE* cache = get_thread_cache();
+    if (size_class == POOL_UNPOOLED || cache == NULL)
+    {
+        /*Codes_SRS_MESSAGE_POOL_17_002: [ MESSAGE_POOL_alloc shall pass requests larger than 256 bytes, or made when the pool cannot keep a cache for the calling thread, to malloc. ]*/
+        result = alloc_unpooled(size, cache);
+    }
+    else
+    {
+        bool available;
+        if (cache->count[size_class] > 0)
+        {
+            /*Codes_SRS_MESSAGE_POOL_17_004: [ MESSAGE_POOL_alloc shall take a block of the smallest size class that fits size from the calling thread's cache. ]*/
+            cache->pending.thread_hits++;
+            available = true;
+        }
+        else if (take_batch(cache, size_class))
+        {
+            /*Codes_SRS_MESSAGE_POOL_17_005: [ If the thread's cache has no block of that class, MESSAGE_POOL_alloc shall move a batch of blocks freed by other threads into it. ]*/
+            cache->pending.shared_hits++;
+            available = true;
+        }
+        /*Codes_SRS_MESSAGE_POOL_17_006: [ If there is no such batch, MESSAGE_POOL_alloc shall carve a new slab of 64 blocks into the thread's cache. ]*/
+        else if (carve_slab(cache, size_class))
+        {
+            cache->pending.misses++;
+            available = true;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_POOL_17_003: [ MESSAGE_POOL_alloc shall return NULL if it cannot allocate memory. ]*/
+            available = false;
+        }
+
+        if (!available)
+        {
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_POOL_17_001: [ MESSAGE_POOL_alloc shall return a block of at least size bytes, aligned for pointers and 64 bit integers. ]*/
+            POOL_FREE_BLOCK* block = cache->blocks[size_class];
+            cache->blocks[size_class] = block->next;
+            cache->count[size_class]--;
+            result = block;
+
+            /*Codes_SRS_MESSAGE_POOL_17_011: [ Every 1024 allocations, MESSAGE_POOL_alloc shall fold the calling thread's counters into the totals. ]*/
+            if (++cache->allocations == POOL_STATISTICS_INTERVAL)
+            {
+                shared_lock();
+                fold_statistics(cache);
+                shared_unlock();
+            }
+        }
+    }
+    return result;
+}
+
+void MESSAGE_POOL_free(void* block)
+{
+    /*Codes_SRS_MESSAGE_POOL_17_007: [ MESSAGE_POOL_free shall do nothing if block is NULL. ]*/
+    if (block != NULL)
+    {
+        POOL_HEADER* header = (POOL_HEADER*)block - 1;
+        size_t size_class = header->size_class;
+        if (size_class == POOL_UNPOOLED)
+        {
+            /*Codes_SRS_MESSAGE_POOL_17_008: [ MESSAGE_POOL_free shall free a block that was passed to malloc. ]*/
+            free(header);
+        }
+        else
+        {
+            POOL_FREE_BLOCK* free_block = (POOL_FREE_BLOCK*)block;
+            POOL_THREAD_CACHE* cache = get_thread_cache();
+            if (cache == NULL)
+            {
+                /*Codes_SRS_MESSAGE_POOL_17_010: [ If the pool cannot keep a cache for the calling thread, MESSAGE_POOL_free shall give the block to the shared lists. ]*/
+                free_block->next = NULL;
+                shared_lock();
+                push_batch(size_class, free_block, 1);
+                shared_unlock();
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_POOL_17_009: [ MESSAGE_POOL_free shall put a pooled block in the calling thread's cache and, once the cache holds more than 64 blocks of the class, give a batch of 32 to the shared lists. ]*/
+                free_block->next = cache->blocks[size_class];
+                cache->blocks[size_class] = free_block;
+                if (++cache->count[size_class] > POOL_CACHE_LIMIT)
+                {
+                    give_batch(cache, size_class);
+                }
+            }
+        }
+    }
+}
+
+int MESSAGE_POOL_get_statistics(MESSAGE_POOL_STATISTICS* statistics)
+{
+    int result;
+    if (statistics == NULL)
+    {
+        /*Codes_SRS_MESSAGE_POOL_17_012: [ MESSAGE_POOL_get_statistics shall return non-zero if statistics is NULL. ]*/
+        LogError("invalid arg statistics=NULL");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_POOL_17_013: [ MESSAGE_POOL_get_statistics shall store the totals, plus the counters the calling thread has not folded yet, in statistics and return 0. ]*/
+        shared_lock();
+        *statistics = pool_shared.totals;
+        shared_unlock();
+        if (gateway_atomic_load(&pool_state) == POOL_STATE_READY)
+        {
+            POOL_THREAD_CACHE* cache = pool_key_get();
+            if (cache != NULL)
+            {
+                add_statistics(statistics, &cache->pending);
+            }
+        }
+        result = 0;
+    }
+    return result;
+}
@@ -0,0 +1,997 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message_properties.h"
+#include "message_pool.h"
+#include "gateway_atomic.h"
+#include "message_varint.h"
+
+/*an interned property the message does not have*/
+#define NO_ENTRY 0
+
+/*room for the string form of an int64, a double or a timestamp*/
+#define RENDERED_NUMBER_SIZE 40
+
+#define MILLISECONDS_PER_DAY INT64_C(86400000)
+
+typedef struct INTERNED_NAME_TAG
+{
+    const char* name;
+    size_t      length;
+} INTERNED_NAME;
+
+#define INTERNED_NAME_OF(name) { name, sizeof(name) - 1 }
+
+/*in MESSAGE_PROPERTY_ID order*/
+static const INTERNED_NAME interned_names[MESSAGE_PROPERTY_ID_COUNT] =
+{
+    INTERNED_NAME_OF("source"),
+    INTERNED_NAME_OF("macAddress"),
+    INTERNED_NAME_OF("deviceName"),
+    INTERNED_NAME_OF("deviceKey"),
+    INTERNED_NAME_OF("iotHubMessageId"),
+    INTERNED_NAME_OF("iotHubMessageDeliveryStatus"),
+    INTERNED_NAME_OF("bleControllerIndex"),
+    INTERNED_NAME_OF("timestamp"),
+    INTERNED_NAME_OF("characteristicUUID")
+};
+
+/*Followed, in the same block, by count entries and then by the strings they
+ *point to.
+ */
+typedef struct MESSAGE_PROPERTIES_TAG
+{
+    GATEWAY_ATOMIC_U32  refs;
+    size_t              count;
+    /** Entry index + 1 of every interned property, NO_ENTRY if absent */
+    size_t              interned[MESSAGE_PROPERTY_ID_COUNT];
+    /** CONSTMAP_HANDLE built by the first MESSAGE_PROPERTIES_get_constmap */
+    void* volatile      constmap;
+    /** Set whose strings the entries of a derived set share, NULL otherwise */
+    struct MESSAGE_PROPERTIES_TAG* parent;
+    /** Number of entries whose value is not a string */
+    size_t              typed;
+} MESSAGE_PROPERTIES;
+
+#define PROPERTY_ENTRIES(properties) ((MESSAGE_PROPERTY*)((properties) + 1))
+
+static size_t intern(const char* name, size_t length)
+{
+    size_t result = 0;
+    while (result < MESSAGE_PROPERTY_ID_COUNT &&
+        (interned_names[result].length != length || memcmp(interned_names[result].name, name, length) != 0))
+    {
+        result++;
+    }
+    return result;
+}
+
+static char* copy_string(char* destination, const char* source, size_t length)
+{
+    (void)memcpy(destination, source, length);
+    destination[length] = '\0';
+    return destination + length + 1;
+}
+
+static void init_properties(MESSAGE_PROPERTIES* properties, size_t count)
+{
+    size_t id;
+    gateway_atomic_store(&properties->refs, 1);
+    properties->count = count;
+    properties->constmap = NULL;
+    properties->parent = NULL;
+    properties->typed = 0;
+    for (id = 0; id < MESSAGE_PROPERTY_ID_COUNT; id++)
+    {
+        properties->interned[id] = NO_ENTRY;
+    }
+}
+
+static void set_string(MESSAGE_PROPERTY* entry, const char* value, size_t length)
+{
+    entry->value = value;
+    entry->value_length = length;
+    entry->typed.type = MESSAGE_PROPERTY_TYPE_STRING;
+    entry->typed.value.string = value;
+    entry->rendered = NULL;
+}
+
+/*a value that is not a string has no string form until one is asked for*/
+static void set_typed(MESSAGE_PROPERTIES* properties, MESSAGE_PROPERTY* entry, const MESSAGE_PROPERTY_VALUE* value)
+{
+    entry->value = NULL;
+    entry->value_length = 0;
+    entry->typed = *value;
+    entry->rendered = NULL;
+    properties->typed++;
+}
+
+/*id is MESSAGE_PROPERTY_ID_COUNT for a name that is not interned*/
+static void record_interned(MESSAGE_PROPERTIES* properties, MESSAGE_PROPERTY* entries, size_t index, size_t id)
+{
+    if (id < MESSAGE_PROPERTY_ID_COUNT)
+    {
+        properties->interned[id] = index + 1;
+        entries[index].interned = id + 1;
+    }
+    else
+    {
+        entries[index].interned = 0;
+    }
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_create(MAP_HANDLE map)
+{
+    MESSAGE_PROPERTIES* result;
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    if (map == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_001: [ MESSAGE_PROPERTIES_create shall return NULL if map is NULL. ]*/
+        LogError("invalid arg map=NULL");
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_002: [ MESSAGE_PROPERTIES_create shall get the keys and values of map with Map_GetInternals. ]*/
+    else if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_004: [ MESSAGE_PROPERTIES_create shall return NULL if any underlying call fails. ]*/
+        LogError("unable to get the contents of the map");
+        result = NULL;
+    }
+    else if (count > (SIZE_MAX - sizeof(MESSAGE_PROPERTIES)) / sizeof(MESSAGE_PROPERTY))
+    {
+        LogError("too many properties: %zu", count);
+        result = NULL;
+    }
+    else
+    {
+        size_t size = sizeof(MESSAGE_PROPERTIES) + count * sizeof(MESSAGE_PROPERTY);
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            size += strlen(keys[i]) + 1 + strlen(values[i]) + 1;
+        }
+
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_003: [ MESSAGE_PROPERTIES_create shall allocate the property set, its entries and a copy of every key and value in a single block from the message pool. ]*/
+        result = (MESSAGE_PROPERTIES*)MESSAGE_POOL_alloc(size);
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_004: [ MESSAGE_PROPERTIES_create shall return NULL if any underlying call fails. ]*/
+            LogError("unable to allocate %zu properties", count);
+        }
+        else
+        {
+            MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(result);
+            char* strings = (char*)(entries + count);
+            size_t id;
+
+            init_properties(result, count);
+            for (i = 0; i < count; i++)
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_005: [ MESSAGE_PROPERTIES_create shall record the length of every key and value. ]*/
+                entries[i].key_length = strlen(keys[i]);
+                entries[i].key = strings;
+                strings = copy_string(strings, keys[i], entries[i].key_length);
+                set_string(entries + i, strings, strlen(values[i]));
+                strings = copy_string(strings, values[i], entries[i].value_length);
+
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_006: [ MESSAGE_PROPERTIES_create shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+                id = intern(entries[i].key, entries[i].key_length);
+                record_interned(result, entries, i, id);
+            }
+        }
+    }
+    return result;
+}
+
+static int is_repeated(const MESSAGE_PROPERTY* entries, size_t index)
+{
+    size_t i;
+    for (i = 0; i < index; i++)
+    {
+        if (entries[i].key_length == entries[index].key_length &&
+            memcmp(entries[i].key, entries[index].key, entries[index].key_length) == 0)
+        {
+            break;
+        }
+    }
+    return i < index;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_create_borrowed(const char* pairs, size_t count)
+{
+    MESSAGE_PROPERTIES* result;
+    if (pairs == NULL && count > 0)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_023: [ MESSAGE_PROPERTIES_create_borrowed shall return NULL if pairs is NULL and count is not 0. ]*/
+        LogError("invalid arg pairs=NULL, count=%zu", count);
+        result = NULL;
+    }
+    else if (count > (SIZE_MAX - sizeof(MESSAGE_PROPERTIES)) / sizeof(MESSAGE_PROPERTY))
+    {
+        LogError("too many properties: %zu", count);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_024: [ MESSAGE_PROPERTIES_create_borrowed shall allocate the property set and its entries, but not the strings, in a single block from the message pool. ]*/
+    else if ((result = (MESSAGE_PROPERTIES*)MESSAGE_POOL_alloc(sizeof(MESSAGE_PROPERTIES) + count * sizeof(MESSAGE_PROPERTY))) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_025: [ MESSAGE_PROPERTIES_create_borrowed shall return NULL if any underlying call fails. ]*/
+        LogError("unable to allocate %zu properties", count);
+    }
+    else
+    {
+        MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(result);
+        size_t i;
+
+        init_properties(result, count);
+        for (i = 0; i < count; i++)
+        {
+            size_t id;
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_026: [ MESSAGE_PROPERTIES_create_borrowed shall point every key and value into pairs, where each key is followed by its value and each string by '\0', and record their lengths. ]*/
+            entries[i].key = pairs;
+            entries[i].key_length = strlen(pairs);
+            pairs += entries[i].key_length + 1;
+            set_string(entries + i, pairs, strlen(pairs));
+            pairs += entries[i].value_length + 1;
+
+            if (is_repeated(entries, i))
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_027: [ MESSAGE_PROPERTIES_create_borrowed shall fail and return NULL if a key appears more than once. ]*/
+                LogError("property %s appears more than once", entries[i].key);
+                break;
+            }
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_028: [ MESSAGE_PROPERTIES_create_borrowed shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+            id = intern(entries[i].key, entries[i].key_length);
+            record_interned(result, entries, i, id);
+        }
+
+        if (i != count)
+        {
+            MESSAGE_POOL_free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*bytes needed by the copies of the names, strings and bytes of properties, 0 if one of them is NULL or a type is unknown*/
+static size_t typed_strings_size(const MESSAGE_TYPED_PROPERTY* properties, size_t count)
+{
+    size_t result = 1; /*so that no properties is not mistaken for an error*/
+    size_t i;
+    for (i = 0; i < count && result != 0; i++)
+    {
+        const MESSAGE_PROPERTY_VALUE* value = &properties[i].value;
+        size_t size;
+        if (properties[i].name == NULL ||
+            (size_t)value->type >= MESSAGE_PROPERTY_TYPE_COUNT ||
+            (value->type == MESSAGE_PROPERTY_TYPE_STRING && value->value.string == NULL) ||
+            (value->type == MESSAGE_PROPERTY_TYPE_BYTES && value->value.bytes.buffer == NULL && value->value.bytes.size > 0))
+        {
+            result = 0;
+        }
+        else
+        {
+            size = strlen(properties[i].name) + 1 +
+                (value->type == MESSAGE_PROPERTY_TYPE_STRING ? strlen(value->value.string) + 1 :
+                value->type == MESSAGE_PROPERTY_TYPE_BYTES ? value->value.bytes.size :
+                0);
+            result = (size > SIZE_MAX - result) ? 0 : result + size;
+        }
+    }
+    return result;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_create_typed(const MESSAGE_TYPED_PROPERTY* properties, size_t count)
+{
+    MESSAGE_PROPERTIES* result;
+    size_t strings_size;
+    if ((properties == NULL && count > 0) ||
+        (strings_size = typed_strings_size(properties, count)) == 0)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_045: [ MESSAGE_PROPERTIES_create_typed shall return NULL if properties is NULL and count is not 0, if a name is NULL, if a type is not a MESSAGE_PROPERTY_TYPE, if a string is NULL, or if bytes are NULL while their size is not 0. ]*/
+        LogError("invalid arg properties=%p, count=%zu", properties, count);
+        result = NULL;
+    }
+    else if (count > (SIZE_MAX - sizeof(MESSAGE_PROPERTIES) - strings_size) / sizeof(MESSAGE_PROPERTY))
+    {
+        LogError("too many properties: %zu", count);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_046: [ MESSAGE_PROPERTIES_create_typed shall allocate the property set, its entries and a copy of every name, string and array of bytes in a single block from the message pool. ]*/
+    else if ((result = (MESSAGE_PROPERTIES*)MESSAGE_POOL_alloc(sizeof(MESSAGE_PROPERTIES) + count * sizeof(MESSAGE_PROPERTY) + strings_size)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_050: [ MESSAGE_PROPERTIES_create_typed shall return NULL if any underlying call fails. ]*/
+        LogError("unable to allocate %zu properties", count);
+    }
+    else
+    {
+        MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(result);
+        char* strings = (char*)(entries + count);
+        size_t i;
+
+        init_properties(result, count);
+        for (i = 0; i < count; i++)
+        {
+            const MESSAGE_PROPERTY_VALUE* value = &properties[i].value;
+            entries[i].key_length = strlen(properties[i].name);
+            entries[i].key = strings;
+            strings = copy_string(strings, properties[i].name, entries[i].key_length);
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_047: [ MESSAGE_PROPERTIES_create_typed shall keep every value with its type, copying strings and bytes, and keeping integers, doubles and timestamps as they are, without turning them into strings. ]*/
+            if (value->type == MESSAGE_PROPERTY_TYPE_STRING)
+            {
+                set_string(entries + i, strings, strlen(value->value.string));
+                strings = copy_string(strings, value->value.string, entries[i].value_length);
+            }
+            else
+            {
+                set_typed(result, entries + i, value);
+                if (value->type == MESSAGE_PROPERTY_TYPE_BYTES)
+                {
+                    if (value->value.bytes.size > 0)
+                    {
+                        (void)memcpy(strings, value->value.bytes.buffer, value->value.bytes.size);
+                    }
+                    entries[i].typed.value.bytes.buffer = (const unsigned char*)strings;
+                    strings += value->value.bytes.size;
+                }
+            }
+
+            if (is_repeated(entries, i))
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_048: [ MESSAGE_PROPERTIES_create_typed shall fail and return NULL if a name appears more than once. ]*/
+                LogError("property %s appears more than once", entries[i].key);
+                break;
+            }
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_049: [ MESSAGE_PROPERTIES_create_typed shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+            record_interned(result, entries, i, intern(entries[i].key, entries[i].key_length));
+        }
+
+        if (i != count)
+        {
+            MESSAGE_POOL_free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*points value at the length bytes of a version 2 string, which are followed by '\0', and returns what comes after*/
+static const unsigned char* borrow_string(const unsigned char* encoded, size_t length, const char** value, size_t* value_length)
+{
+    *value = (const char*)encoded;
+    *value_length = length;
+    return encoded + length + 1;
+}
+
+/*reads the value of a version 3 property, which starts with its type, and returns what comes after*/
+static const unsigned char* borrow_typed(MESSAGE_PROPERTIES* properties, MESSAGE_PROPERTY* entry, const unsigned char* encoded)
+{
+    MESSAGE_PROPERTY_VALUE value;
+    uint32_t length;
+    value.type = (MESSAGE_PROPERTY_TYPE)*encoded++;
+    if (value.type == MESSAGE_PROPERTY_TYPE_STRING)
+    {
+        encoded += message_varint_read(encoded, MESSAGE_VARINT_MAX_SIZE, &length);
+        set_string(entry, (const char*)encoded, length);
+        encoded += length + 1;
+    }
+    else
+    {
+        if (value.type == MESSAGE_PROPERTY_TYPE_BYTES)
+        {
+            encoded += message_varint_read(encoded, MESSAGE_VARINT_MAX_SIZE, &length);
+            value.value.bytes.buffer = encoded;
+            value.value.bytes.size = length;
+            encoded += length;
+        }
+        else
+        {
+            uint64_t bits = message_fixed64_read(encoded);
+            encoded += MESSAGE_FIXED64_SIZE;
+            if (value.type == MESSAGE_PROPERTY_TYPE_DOUBLE)
+            {
+                (void)memcpy(&value.value.real, &bits, sizeof(bits));
+            }
+            else if (value.type == MESSAGE_PROPERTY_TYPE_TIMESTAMP)
+            {
+                value.value.timestamp = (int64_t)bits;
+            }
+            else
+            {
+                value.value.integer = (int64_t)bits;
+            }
+        }
+        set_typed(properties, entry, &value);
+    }
+    return encoded;
+}
+
+/*borrows count properties laid out as in version 2, or, if typed, version 3 of the serialized message*/
+static MESSAGE_PROPERTIES* create_borrowed_encoded(const unsigned char* encoded, size_t count, int typed)
+{
+    MESSAGE_PROPERTIES* result;
+    if (count > (SIZE_MAX - sizeof(MESSAGE_PROPERTIES)) / sizeof(MESSAGE_PROPERTY))
+    {
+        LogError("too many properties: %zu", count);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_030: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall allocate the property set and its entries, but not the strings, in a single block from the message pool. ]*/
+    else if ((result = (MESSAGE_PROPERTIES*)MESSAGE_POOL_alloc(sizeof(MESSAGE_PROPERTIES) + count * sizeof(MESSAGE_PROPERTY))) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_031: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall return NULL if any underlying call fails. ]*/
+        LogError("unable to allocate %zu properties", count);
+    }
+    else
+    {
+        MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(result);
+        size_t i;
+
+        init_properties(result, count);
+        for (i = 0; i < count; i++)
+        {
+            uint32_t tag;
+            uint32_t length;
+            size_t id;
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_032: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall take the name of a key tagged with an interned id from MESSAGE_PROPERTY_ID, without comparing strings. ]*/
+            encoded += message_varint_read(encoded, MESSAGE_VARINT_MAX_SIZE, &tag);
+            if ((tag & 1) != 0)
+            {
+                id = tag >> 1;
+                entries[i].key = interned_names[id].name;
+                entries[i].key_length = interned_names[id].length;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_033: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall point every other key, and every value, into encoded and take their lengths from it. ]*/
+                encoded = borrow_string(encoded, tag >> 1, &entries[i].key, &entries[i].key_length);
+                id = intern(entries[i].key, entries[i].key_length);
+            }
+
+            if (typed)
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_052: [ MESSAGE_PROPERTIES_create_borrowed_v3 shall read the type that starts every value, point strings and bytes into encoded, and read integers, doubles and timestamps from 8 bytes, most significant first. ]*/
+                encoded = borrow_typed(result, entries + i, encoded);
+            }
+            else
+            {
+                encoded += message_varint_read(encoded, MESSAGE_VARINT_MAX_SIZE, &length);
+                set_string(entries + i, (const char*)encoded, length);
+                encoded += length + 1;
+            }
+
+            if (is_repeated(entries, i))
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_034: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall fail and return NULL if a key appears more than once. ]*/
+                LogError("property %s appears more than once", entries[i].key);
+                break;
+            }
+
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_035: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+            record_interned(result, entries, i, id);
+        }
+
+        if (i != count)
+        {
+            MESSAGE_POOL_free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_create_borrowed_v2(const unsigned char* encoded, size_t count)
+{
+    MESSAGE_PROPERTIES* result;
+    if (encoded == NULL && count > 0)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_029: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall return NULL if encoded is NULL and count is not 0. ]*/
+        LogError("invalid arg encoded=NULL, count=%zu", count);
+        result = NULL;
+    }
+    else
+    {
+        result = create_borrowed_encoded(encoded, count, 0);
+    }
+    return result;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_create_borrowed_v3(const unsigned char* encoded, size_t count)
+{
+    MESSAGE_PROPERTIES* result;
+    if (encoded == NULL && count > 0)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_051: [ MESSAGE_PROPERTIES_create_borrowed_v3 shall return NULL if encoded is NULL and count is not 0. ]*/
+        LogError("invalid arg encoded=NULL, count=%zu", count);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_053: [ Otherwise MESSAGE_PROPERTIES_create_borrowed_v3 shall read the names, allocate the set and fail exactly as MESSAGE_PROPERTIES_create_borrowed_v2 does. ]*/
+        result = create_borrowed_encoded(encoded, count, 1);
+    }
+    return result;
+}
+
+static int is_named(const MESSAGE_PROPERTY* entry, const char* name)
+{
+    return strncmp(entry->key, name, entry->key_length) == 0 && name[entry->key_length] == '\0';
+}
+
+/*whether derive drops the parent's entry, because adds replaces it or removes names it*/
+static int is_changed(const MESSAGE_PROPERTY* entry, const MESSAGE_PROPERTY_UPDATE* adds, size_t add_count, const char* const* removes, size_t remove_count)
+{
+    size_t i;
+    int result = 0;
+    for (i = 0; i < add_count && !result; i++)
+    {
+        result = is_named(entry, adds[i].name);
+    }
+    for (i = 0; i < remove_count && !result; i++)
+    {
+        result = is_named(entry, removes[i]);
+    }
+    return result;
+}
+
+/*bytes needed by the copies of the names and values of adds, 0 if one of them or of removes is NULL*/
+static size_t derived_strings_size(const MESSAGE_PROPERTY_UPDATE* adds, size_t add_count, const char* const* removes, size_t remove_count)
+{
+    size_t result = 1; /*so that no adds is not mistaken for an error*/
+    size_t i;
+    for (i = 0; i < add_count && result != 0; i++)
+    {
+        result = (adds[i].name == NULL || adds[i].value == NULL) ?
+            0 :
+            result + strlen(adds[i].name) + 1 + strlen(adds[i].value) + 1;
+    }
+    for (i = 0; i < remove_count && result != 0; i++)
+    {
+        result = (removes[i] == NULL) ? 0 : result;
+    }
+    return result;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_derive(MESSAGE_PROPERTIES_HANDLE parent, const MESSAGE_PROPERTY_UPDATE* adds, size_t add_count, const char* const* removes, size_t remove_count)
+{
+    MESSAGE_PROPERTIES* result;
+    size_t strings_size;
+    if (parent == NULL ||
+        (adds == NULL && add_count > 0) ||
+        (removes == NULL && remove_count > 0) ||
+        (strings_size = derived_strings_size(adds, add_count, removes, remove_count)) == 0)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_036: [ MESSAGE_PROPERTIES_derive shall return NULL if parent is NULL, if adds or removes is NULL while its count is not 0, or if any name or value in them is NULL. ]*/
+        LogError("invalid arg parent=%p, adds=%p, add_count=%zu, removes=%p, remove_count=%zu", parent, adds, add_count, removes, remove_count);
+        result = NULL;
+    }
+    else
+    {
+        const MESSAGE_PROPERTY* parent_entries = PROPERTY_ENTRIES(parent);
+        size_t kept = 0;
+        size_t i;
+        for (i = 0; i < parent->count; i++)
+        {
+            kept += is_changed(parent_entries + i, adds, add_count, removes, remove_count) ? 0 : 1;
+        }
+
+        if (add_count > (SIZE_MAX - sizeof(MESSAGE_PROPERTIES) - strings_size) / sizeof(MESSAGE_PROPERTY) - kept)
+        {
+            LogError("too many properties: %zu", add_count);
+            result = NULL;
+        }
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_037: [ MESSAGE_PROPERTIES_derive shall allocate the property set, its entries and a copy of every added name and value in a single block from the message pool. ]*/
+        else if ((result = (MESSAGE_PROPERTIES*)MESSAGE_POOL_alloc(sizeof(MESSAGE_PROPERTIES) + (kept + add_count) * sizeof(MESSAGE_PROPERTY) + strings_size)) == NULL)
+        {
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_043: [ MESSAGE_PROPERTIES_derive shall return NULL if any underlying call fails. ]*/
+            LogError("unable to allocate %zu properties", kept + add_count);
+        }
+        else
+        {
+            MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(result);
+            char* strings = (char*)(entries + kept + add_count);
+            size_t count = 0;
+
+            init_properties(result, kept + add_count);
+            for (i = 0; i < parent->count; i++)
+            {
+                if (!is_changed(parent_entries + i, adds, add_count, removes, remove_count))
+                {
+                    /*Codes_SRS_MESSAGE_PROPERTIES_17_038: [ MESSAGE_PROPERTIES_derive shall keep, in their order, the properties of parent that adds and removes do not name, pointing at the strings of parent without copying them. ]*/
+                    entries[count] = parent_entries[i];
+                    if (entries[count].typed.type != MESSAGE_PROPERTY_TYPE_STRING)
+                    {
+                        /*Codes_SRS_MESSAGE_PROPERTIES_17_062: [ MESSAGE_PROPERTIES_derive shall keep the values of parent that are not strings with their types, but not their string forms. ]*/
+                        entries[count].rendered = NULL;
+                        result->typed++;
+                    }
+                    /*Codes_SRS_MESSAGE_PROPERTIES_17_041: [ MESSAGE_PROPERTIES_derive shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+                    record_interned(result, entries, count, entries[count].interned == 0 ? MESSAGE_PROPERTY_ID_COUNT : entries[count].interned - 1);
+                    count++;
+                }
+            }
+
+            for (i = 0; i < add_count; i++, count++)
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_039: [ MESSAGE_PROPERTIES_derive shall follow them with copies of the properties in adds, in their order. ]*/
+                entries[count].key_length = strlen(adds[i].name);
+                entries[count].key = strings;
+                strings = copy_string(strings, adds[i].name, entries[count].key_length);
+                set_string(entries + count, strings, strlen(adds[i].value));
+                strings = copy_string(strings, adds[i].value, entries[count].value_length);
+
+                if (is_repeated(entries, count))
+                {
+                    /*Codes_SRS_MESSAGE_PROPERTIES_17_040: [ MESSAGE_PROPERTIES_derive shall fail and return NULL if a name appears more than once in adds. ]*/
+                    LogError("property %s appears more than once", adds[i].name);
+                    break;
+                }
+
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_041: [ MESSAGE_PROPERTIES_derive shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+                record_interned(result, entries, count, intern(entries[count].key, entries[count].key_length));
+            }
+
+            if (i != add_count)
+            {
+                MESSAGE_POOL_free(result);
+                result = NULL;
+            }
+            else if (kept > 0)
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_042: [ MESSAGE_PROPERTIES_derive shall keep a reference to parent, with MESSAGE_PROPERTIES_clone, if it shares any of its strings. ]*/
+                result->parent = MESSAGE_PROPERTIES_clone(parent);
+            }
+        }
+    }
+    return result;
+}
+
+MESSAGE_PROPERTIES_HANDLE MESSAGE_PROPERTIES_clone(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_007: [ MESSAGE_PROPERTIES_clone shall return NULL if handle is NULL. ]*/
+        LogError("invalid arg handle=NULL");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_008: [ MESSAGE_PROPERTIES_clone shall increment the reference count and return handle. ]*/
+        (void)gateway_atomic_increment(&handle->refs);
+    }
+    return handle;
+}
+
+void MESSAGE_PROPERTIES_destroy(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_009: [ MESSAGE_PROPERTIES_destroy shall do nothing if handle is NULL. ]*/
+    if (handle != NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_010: [ MESSAGE_PROPERTIES_destroy shall decrement the reference count and, when it reaches zero, destroy the CONSTMAP built by MESSAGE_PROPERTIES_get_constmap and free the block. ]*/
+        if (gateway_atomic_decrement(&handle->refs) == 0)
+        {
+            MESSAGE_PROPERTIES* parent = handle->parent;
+            if (handle->constmap != NULL)
+            {
+                ConstMap_Destroy((CONSTMAP_HANDLE)handle->constmap);
+            }
+            if (handle->typed > 0)
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_061: [ When the reference count reaches zero, MESSAGE_PROPERTIES_destroy shall also free the string forms made of values that are not strings. ]*/
+                MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(handle);
+                size_t i;
+                for (i = 0; i < handle->count; i++)
+                {
+                    if (entries[i].rendered != NULL)
+                    {
+                        MESSAGE_POOL_free(entries[i].rendered);
+                    }
+                }
+            }
+            MESSAGE_POOL_free(handle);
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_044: [ When the reference count of a derived set reaches zero, MESSAGE_PROPERTIES_destroy shall also destroy the reference it keeps to its parent. ]*/
+            MESSAGE_PROPERTIES_destroy(parent);
+        }
+    }
+}
+
+size_t MESSAGE_PROPERTIES_get_count(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    /*Codes_SRS_MESSAGE_PROPERTIES_17_011: [ MESSAGE_PROPERTIES_get_count shall return the number of properties, or 0 if handle is NULL. ]*/
+    return handle == NULL ? 0 : handle->count;
+}
+
+const MESSAGE_PROPERTY* MESSAGE_PROPERTIES_get_at(MESSAGE_PROPERTIES_HANDLE handle, size_t index)
+{
+    const MESSAGE_PROPERTY* result;
+    if (handle == NULL || index >= handle->count)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_012: [ MESSAGE_PROPERTIES_get_at shall return NULL if handle is NULL or index is not less than the number of properties. ]*/
+        LogError("invalid arg handle=%p, index=%zu", handle, index);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_013: [ MESSAGE_PROPERTIES_get_at shall return the property at index, in the order of the map the set was created from. ]*/
+        result = PROPERTY_ENTRIES(handle) + index;
+    }
+    return result;
+}
+
+/*the entry of the property called name, comparing lengths before contents; NULL if there is none*/
+static MESSAGE_PROPERTY* find(MESSAGE_PROPERTIES* properties, const char* name)
+{
+    MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(properties);
+    MESSAGE_PROPERTY* result = NULL;
+    size_t length = strlen(name);
+    size_t i;
+    for (i = 0; i < properties->count && result == NULL; i++)
+    {
+        if (entries[i].key_length == length && memcmp(entries[i].key, name, length) == 0)
+        {
+            result = entries + i;
+        }
+    }
+    return result;
+}
+
+/*days since 1970-01-01 to a date of the proleptic Gregorian calendar, as in H. Hinnant's civil_from_days*/
+static void civil_from_days(int64_t days, int64_t* year, unsigned int* month, unsigned int* day)
+{
+    int64_t shifted = days + 719468; /*days since 0000-03-01*/
+    int64_t era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    unsigned int day_of_era = (unsigned int)(shifted - era * 146097);
+    unsigned int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned int march_month = (5 * day_of_year + 2) / 153;
+    *day = day_of_year - (153 * march_month + 2) / 5 + 1;
+    *month = march_month < 10 ? march_month + 3 : march_month - 9;
+    *year = (int64_t)year_of_era + era * 400 + (*month <= 2 ? 1 : 0);
+}
+
+static void render_timestamp(char* buffer, size_t size, int64_t timestamp)
+{
+    int64_t days = timestamp / MILLISECONDS_PER_DAY;
+    int64_t milliseconds = timestamp % MILLISECONDS_PER_DAY;
+    int64_t year;
+    unsigned int month;
+    unsigned int day;
+    if (milliseconds < 0)
+    {
+        milliseconds += MILLISECONDS_PER_DAY;
+        days--;
+    }
+    civil_from_days(days, &year, &month, &day);
+    (void)snprintf(buffer, size, "%04" PRId64 "-%02u-%02uT%02u:%02u:%02u.%03uZ", year, month, day,
+        (unsigned int)(milliseconds / 3600000), (unsigned int)(milliseconds / 60000 % 60), (unsigned int)(milliseconds / 1000 % 60), (unsigned int)(milliseconds % 1000));
+}
+
+/*the shortest of 15 or 17 significant digits that reads back as the same double*/
+static void render_double(char* buffer, size_t size, double real)
+{
+    (void)snprintf(buffer, size, "%.15g", real);
+    if (strtod(buffer, NULL) != real)
+    {
+        (void)snprintf(buffer, size, "%.17g", real);
+    }
+}
+
+static void render_bytes(char* buffer, const unsigned char* bytes, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        *buffer++ = digits[bytes[i] >> 4];
+        *buffer++ = digits[bytes[i] & 0x0F];
+    }
+    *buffer = '\0';
+}
+
+/*the string form of a value that is not a string, in a block of its own from the message pool; NULL on failure*/
+static char* render(const MESSAGE_PROPERTY_VALUE* value)
+{
+    char* result;
+    size_t size = (value->type != MESSAGE_PROPERTY_TYPE_BYTES) ? RENDERED_NUMBER_SIZE :
+        (value->value.bytes.size > (SIZE_MAX - 1) / 2) ? 0 :
+        value->value.bytes.size * 2 + 1;
+    if (size == 0 || (result = (char*)MESSAGE_POOL_alloc(size)) == NULL)
+    {
+        LogError("unable to allocate the string form of a value of type %d", (int)value->type);
+        result = NULL;
+    }
+    else if (value->type == MESSAGE_PROPERTY_TYPE_INT64)
+    {
+        (void)snprintf(result, size, "%" PRId64, value->value.integer);
+    }
+    else if (value->type == MESSAGE_PROPERTY_TYPE_DOUBLE)
+    {
+        render_double(result, size, value->value.real);
+    }
+    else if (value->type == MESSAGE_PROPERTY_TYPE_TIMESTAMP)
+    {
+        render_timestamp(result, size, value->value.timestamp);
+    }
+    else
+    {
+        render_bytes(result, value->value.bytes.buffer, value->value.bytes.size);
+    }
+    return result;
+}
+
+/*the value of entry as a string, made on first use if it is not one; NULL on failure*/
+static const char* value_string(MESSAGE_PROPERTY* entry)
+{
+    const char* result;
+    if (entry->typed.type == MESSAGE_PROPERTY_TYPE_STRING)
+    {
+        result = entry->value;
+    }
+    else if ((result = (const char*)gateway_atomic_load_pointer(&entry->rendered)) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_054: [ The first time the value of a property that is not a string is asked for, as a string or in the CONSTMAP, it shall be turned into one in a block from the message pool, published with an atomic compare-exchange and kept with the set; if another thread published one first, the block shall be freed and that one used. ]*/
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_055: [ Integers shall be written in decimal, doubles with 15 significant digits or with 17 if 15 do not read back as the same double, bytes as two lowercase hexadecimal digits each, and timestamps as YYYY-MM-DDTHH:MM:SS.mmmZ in UTC. ]*/
+        char* rendered = render(&entry->typed);
+        if (rendered != NULL &&
+            !gateway_atomic_compare_exchange_pointer(&entry->rendered, NULL, rendered))
+        {
+            MESSAGE_POOL_free(rendered);
+        }
+        result = (const char*)gateway_atomic_load_pointer(&entry->rendered);
+    }
+    return result;
+}
+
+const char* MESSAGE_PROPERTIES_get(MESSAGE_PROPERTIES_HANDLE handle, const char* name)
+{
+    const char* result = NULL;
+    if (handle == NULL || name == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_014: [ MESSAGE_PROPERTIES_get shall return NULL if handle or name is NULL. ]*/
+        LogError("invalid arg handle=%p, name=%p", handle, name);
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_015: [ MESSAGE_PROPERTIES_get shall return the value of the property called name, comparing lengths before contents, or NULL if there is none. ]*/
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_056: [ MESSAGE_PROPERTIES_get and MESSAGE_PROPERTIES_get_by_id shall return NULL if a value that is not a string cannot be turned into one. ]*/
+        MESSAGE_PROPERTY* entry = find(handle, name);
+        result = entry == NULL ? NULL : value_string(entry);
+    }
+    return result;
+}
+
+const char* MESSAGE_PROPERTIES_get_by_id(MESSAGE_PROPERTIES_HANDLE handle, MESSAGE_PROPERTY_ID id)
+{
+    const char* result;
+    if (handle == NULL || (size_t)id >= MESSAGE_PROPERTY_ID_COUNT)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_016: [ MESSAGE_PROPERTIES_get_by_id shall return NULL if handle is NULL or id is not a MESSAGE_PROPERTY_ID. ]*/
+        LogError("invalid arg handle=%p, id=%d", handle, (int)id);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_017: [ MESSAGE_PROPERTIES_get_by_id shall return the value of the interned property without comparing strings, or NULL if there is none. ]*/
+        size_t entry = handle->interned[id];
+        result = entry == NO_ENTRY ? NULL : value_string(PROPERTY_ENTRIES(handle) + entry - 1);
+    }
+    return result;
+}
+
+const MESSAGE_PROPERTY_VALUE* MESSAGE_PROPERTIES_get_typed(MESSAGE_PROPERTIES_HANDLE handle, const char* name)
+{
+    const MESSAGE_PROPERTY_VALUE* result;
+    if (handle == NULL || name == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_057: [ MESSAGE_PROPERTIES_get_typed shall return NULL if handle or name is NULL. ]*/
+        LogError("invalid arg handle=%p, name=%p", handle, name);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_058: [ MESSAGE_PROPERTIES_get_typed shall return the value of the property called name with its type, or NULL if there is none. ]*/
+        const MESSAGE_PROPERTY* entry = find(handle, name);
+        result = entry == NULL ? NULL : &entry->typed;
+    }
+    return result;
+}
+
+const MESSAGE_PROPERTY_VALUE* MESSAGE_PROPERTIES_get_typed_by_id(MESSAGE_PROPERTIES_HANDLE handle, MESSAGE_PROPERTY_ID id)
+{
+    const MESSAGE_PROPERTY_VALUE* result;
+    if (handle == NULL || (size_t)id >= MESSAGE_PROPERTY_ID_COUNT)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_059: [ MESSAGE_PROPERTIES_get_typed_by_id shall return NULL if handle is NULL or id is not a MESSAGE_PROPERTY_ID. ]*/
+        LogError("invalid arg handle=%p, id=%d", handle, (int)id);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_060: [ MESSAGE_PROPERTIES_get_typed_by_id shall return the value of the interned property with its type, without comparing strings, or NULL if there is none. ]*/
+        size_t entry = handle->interned[id];
+        result = entry == NO_ENTRY ? NULL : &PROPERTY_ENTRIES(handle)[entry - 1].typed;
+    }
+    return result;
+}
+
+static CONSTMAP_HANDLE build_constmap(MESSAGE_PROPERTIES* properties)
+{
+    CONSTMAP_HANDLE result;
+    MAP_HANDLE map = Map_Create(NULL);
+    if (map == NULL)
+    {
+        LogError("unable to create a map");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_PROPERTY* entries = PROPERTY_ENTRIES(properties);
+        size_t i;
+        for (i = 0; i < properties->count; i++)
+        {
+            const char* value = value_string(entries + i);
+            if (value == NULL || Map_Add(map, entries[i].key, value) != MAP_OK)
+            {
+                LogError("unable to add property %s", entries[i].key);
+                break;
+            }
+        }
+
+        result = (i == properties->count) ? ConstMap_Create(map) : NULL;
+        Map_Destroy(map);
+    }
+    return result;
+}
+
+CONSTMAP_HANDLE MESSAGE_PROPERTIES_get_constmap(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    CONSTMAP_HANDLE result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_PROPERTIES_17_018: [ MESSAGE_PROPERTIES_get_constmap shall return NULL if handle is NULL. ]*/
+        LogError("invalid arg handle=NULL");
+        result = NULL;
+    }
+    else
+    {
+        CONSTMAP_HANDLE constmap = (CONSTMAP_HANDLE)gateway_atomic_load_pointer(&handle->constmap);
+        if (constmap == NULL)
+        {
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_019: [ On its first call, MESSAGE_PROPERTIES_get_constmap shall build a CONSTMAP of the properties with Map_Create, Map_Add, ConstMap_Create and Map_Destroy, and keep it. ]*/
+            CONSTMAP_HANDLE built = build_constmap(handle);
+            if (built != NULL &&
+                !gateway_atomic_compare_exchange_pointer(&handle->constmap, NULL, built))
+            {
+                /*Codes_SRS_MESSAGE_PROPERTIES_17_020: [ If another thread kept its CONSTMAP first, MESSAGE_PROPERTIES_get_constmap shall destroy the one it built. ]*/
+                ConstMap_Destroy(built);
+            }
+            constmap = (CONSTMAP_HANDLE)gateway_atomic_load_pointer(&handle->constmap);
+        }
+
+        if (constmap == NULL)
+        {
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_021: [ MESSAGE_PROPERTIES_get_constmap shall return NULL if it cannot build the CONSTMAP. ]*/
+            LogError("unable to build the properties map");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_PROPERTIES_17_022: [ MESSAGE_PROPERTIES_get_constmap shall return a clone of the kept CONSTMAP. ]*/
+            result = ConstMap_Clone(constmap);
+        }
+    }
+    return result;
+}
@@ -2,63 +2,157 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 
-#include "azure_c_shared_utility/doublylinkedlist.h"
 #include "message.h"
 #include "message_queue.h"
 
-typedef struct MESSAGE_QUEUE_STORAGE_TAG
-{
-    DLIST_ENTRY queue_entry;
-    MESSAGE_HANDLE message;
-} MESSAGE_QUEUE_STORAGE;
+/*slots of a queue without a capacity before it first grows*/
+#define MESSAGE_QUEUE_INITIAL_SLOTS 16
 
+/*Messages live in a circular array of slots. A queue created with a
+ *capacity never reallocates it; one without doubles it when it is full, so
+ *once a queue has seen its largest backlog pushing and popping allocate
+ *nothing.
+ */
 typedef struct MESSAGE_QUEUE_TAG
 {
-    MESSAGE_QUEUE_STORAGE queue_head;
+    MESSAGE_HANDLE*     slots;
+    size_t              slot_count;
+    size_t              head;
+    size_t              count;
+    size_t              capacity;
+    size_t              waiters;
+    bool                closed;
+    LOCK_HANDLE         lock;
+    COND_HANDLE         condition;
+    TICK_COUNTER_HANDLE ticks;
 } MESSAGE_QUEUE_HANDLE_DATA;
 
 static MESSAGE_HANDLE message_pop(MESSAGE_QUEUE_HANDLE_DATA* handle)
 {
     MESSAGE_HANDLE result;
-	if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
-	{
+    if (handle->count == 0)
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_013: [ MESSAGE_QUEUE_pop shall return NULL on an empty message queue. ]*/
-		result = NULL;
-	}
-	else
-	{
+        result = NULL;
+    }
+    else
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_014: [ MESSAGE_QUEUE_pop shall remove messages from the queue in a first-in-first-out order. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_015: [ A successful call to MESSAGE_QUEUE_pop on a queue with one message will cause the message queue to be empty. ]*/
-		MESSAGE_QUEUE_STORAGE* entry =
-		(MESSAGE_QUEUE_STORAGE*)DList_RemoveHeadList( (PDLIST_ENTRY)&(handle->queue_head));
+        result = handle->slots[handle->head];
+        handle->slots[handle->head] = NULL;
+        handle->head = (handle->head + 1 == handle->slot_count) ? 0 : handle->head + 1;
+        handle->count--;
+    }
+    return result;
+}
 
-        result = ((MESSAGE_QUEUE_STORAGE*)entry)->message;
-        /*Codes_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
-        free(entry);
+/*doubles the slots of a full queue, unwrapping the messages to the start*/
+static int message_queue_grow(MESSAGE_QUEUE_HANDLE_DATA* handle)
+{
+    int result;
+    MESSAGE_HANDLE* slots;
+    if (handle->slot_count > SIZE_MAX / (2 * sizeof(MESSAGE_HANDLE)))
+    {
+        LogError("message queue cannot grow past %zu messages", handle->slot_count);
+        result = __LINE__;
+    }
+    else if ((slots = (MESSAGE_HANDLE*)malloc(2 * handle->slot_count * sizeof(MESSAGE_HANDLE))) == NULL)
+    {
+        LogError("malloc failed.");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < handle->count; i++)
+        {
+            slots[i] = handle->slots[(handle->head + i) % handle->slot_count];
+        }
+        free(handle->slots);
+        handle->slots = slots;
+        handle->slot_count *= 2;
+        handle->head = 0;
+        result = 0;
     }
     return result;
 }
 
 MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create()
 {
-	MESSAGE_QUEUE_HANDLE_DATA* result;
+    /*Codes_SRS_MESSAGE_QUEUE_17_023: [ MESSAGE_QUEUE_create shall create a queue without a capacity, as MESSAGE_QUEUE_create_with_capacity does with a capacity of 0. ]*/
+    return MESSAGE_QUEUE_create_with_capacity(0);
+}
 
-    result = (MESSAGE_QUEUE_HANDLE_DATA*)malloc(sizeof(MESSAGE_QUEUE_HANDLE_DATA));
-    if (result == NULL)
+MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create_with_capacity(size_t capacity)
+{
+    MESSAGE_QUEUE_HANDLE_DATA* result;
+    size_t slot_count = (capacity == 0) ? MESSAGE_QUEUE_INITIAL_SLOTS : capacity;
+
+    if (slot_count > SIZE_MAX / sizeof(MESSAGE_HANDLE))
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+        LogError("invalid capacity %zu", capacity);
+        result = NULL;
+    }
+    else if ((result = (MESSAGE_QUEUE_HANDLE_DATA*)malloc(sizeof(MESSAGE_QUEUE_HANDLE_DATA))) == NULL)
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
         LogError("malloc failed.");
     }
+    /*Codes_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_with_capacity shall allocate room for capacity messages, or for 16 if capacity is 0. ]*/
+    else if ((result->slots = (MESSAGE_HANDLE*)malloc(slot_count * sizeof(MESSAGE_HANDLE))) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+        LogError("malloc of queue slots failed.");
+        free(result);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_with_capacity shall create a lock, a condition and a tick counter used to make the queue safe for concurrent use and to wait on it. ]*/
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+        LogError("Lock_Init failed.");
+        free(result->slots);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->condition = Condition_Init()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+        LogError("Condition_Init failed.");
+        (void)Lock_Deinit(result->lock);
+        free(result->slots);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->ticks = tickcounter_create()) == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+        LogError("tickcounter_create failed.");
+        Condition_Deinit(result->condition);
+        (void)Lock_Deinit(result->lock);
+        free(result->slots);
+        free(result);
+        result = NULL;
+    }
     else
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_001: [ On a successful call, MESSAGE_QUEUE_create shall return a non-NULL value in MESSAGE_QUEUE_HANDLE. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_002: [ A newly created message queue shall be empty. ]*/
-        DList_InitializeListHead((PDLIST_ENTRY)&(result->queue_head));
-        result->queue_head.message = NULL;
+        result->slot_count = slot_count;
+        result->head = 0;
+        result->count = 0;
+        result->capacity = capacity;
+        result->waiters = 0;
+        result->closed = false;
     }
     return result;
 }
@@ -72,7 +166,7 @@ void MESSAGE_QUEUE_destroy(MESSAGE_QUEUE_HANDLE handle)
     }
     else
     {
-		MESSAGE_QUEUE_HANDLE_DATA * mq = (MESSAGE_QUEUE_HANDLE_DATA*)handle;
+        MESSAGE_QUEUE_HANDLE_DATA * mq = (MESSAGE_QUEUE_HANDLE_DATA*)handle;
         MESSAGE_HANDLE message;
         while((message = message_pop(mq)) != NULL)
         {
@@ -80,7 +174,11 @@ void MESSAGE_QUEUE_destroy(MESSAGE_QUEUE_HANDLE handle)
             Message_Destroy(message);
         }
         /*Codes_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
-        free(handle);
+        tickcounter_destroy(mq->ticks);
+        Condition_Deinit(mq->condition);
+        (void)Lock_Deinit(mq->lock);
+        free(mq->slots);
+        free(mq);
     }
 }
 
@@ -96,24 +194,40 @@ int MESSAGE_QUEUE_push(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE element)
         LogError("invalid argument - handle(%p), element(%p).", handle, element);
         result = __LINE__;
     }
+    /*Codes_SRS_MESSAGE_QUEUE_17_026: [ MESSAGE_QUEUE_push, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_front and MESSAGE_QUEUE_close shall hold the queue's lock while they use the queue. ]*/
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
+        LogError("unable to lock the message queue");
+        result = __LINE__;
+    }
     else
     {
-		MESSAGE_QUEUE_STORAGE* temp = (MESSAGE_QUEUE_STORAGE*)malloc(sizeof(MESSAGE_QUEUE_STORAGE));
-        if (temp == NULL)
+        if (handle->count == handle->slot_count && handle->capacity != 0)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_027: [ MESSAGE_QUEUE_push shall return a non-zero value, without blocking, if the queue holds capacity messages. ]*/
+            result = __LINE__;
+        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_028: [ If a queue without a capacity is full, MESSAGE_QUEUE_push shall double its room for messages. ]*/
+        else if (handle->count == handle->slot_count && message_queue_grow(handle) != 0)
         {
             /*Codes_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
-            LogError("malloc failed.");
             result = __LINE__;
         }
         else
         {
-            DList_InitializeListHead((PDLIST_ENTRY)temp);
-            temp->message = element;
             /*Codes_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
-            DList_AppendTailList((PDLIST_ENTRY)&(handle->queue_head), (PDLIST_ENTRY)temp);
+            handle->slots[(handle->head + handle->count) % handle->slot_count] = element;
+            handle->count++;
+            if (handle->waiters != 0)
+            {
+                /*Codes_SRS_MESSAGE_QUEUE_17_029: [ MESSAGE_QUEUE_push shall signal the queue's condition if a thread waits in MESSAGE_QUEUE_pop_wait. ]*/
+                (void)Condition_Post(handle->condition);
+            }
             /*Codes_SRS_MESSAGE_QUEUE_17_008: [ MESSAGE_QUEUE_push shall return zero on success. ]*/
             result = 0;
         }
+        (void)Unlock(handle->lock);
     }
     return result;
 }
@@ -129,33 +243,131 @@ MESSAGE_HANDLE MESSAGE_QUEUE_pop(MESSAGE_QUEUE_HANDLE handle)
         LogError("invalid argument - handle(%p).", handle);
         result = NULL;
     }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the message queue");
+        result = NULL;
+    }
     else
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_013: [ MESSAGE_QUEUE_pop shall return NULL on an empty message queue. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_014: [ MESSAGE_QUEUE_pop shall remove messages from the queue in a first-in-first-out order. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_015: [ A successful call to MESSAGE_QUEUE_pop on a queue with one message will cause the message queue to be empty. ]*/
         result = message_pop(handle);
+        (void)Unlock(handle->lock);
     }
     return result;
 }
 
+MESSAGE_HANDLE MESSAGE_QUEUE_pop_wait(MESSAGE_QUEUE_HANDLE handle, int timeout)
+{
+    MESSAGE_HANDLE result;
+    tickcounter_ms_t started = 0;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_030: [ MESSAGE_QUEUE_pop_wait shall return NULL on a NULL message queue. ]*/
+        LogError("invalid argument - handle(%p).", handle);
+        result = NULL;
+    }
+    else if (timeout > 0 && tickcounter_get_current_ms(handle->ticks, &started) != 0)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_031: [ MESSAGE_QUEUE_pop_wait shall return NULL if any system call fails. ]*/
+        LogError("unable to read the tick counter");
+        result = NULL;
+    }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_031: [ MESSAGE_QUEUE_pop_wait shall return NULL if any system call fails. ]*/
+        LogError("unable to lock the message queue");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_032: [ MESSAGE_QUEUE_pop_wait shall remove the oldest message, as MESSAGE_QUEUE_pop does, as soon as the queue holds one. ]*/
+        while ((result = message_pop(handle)) == NULL && !handle->closed && timeout != 0)
+        {
+            /*Condition_Wait takes 0 to mean for ever*/
+            int wait_ms = 0;
+            if (timeout > 0)
+            {
+                tickcounter_ms_t now;
+                if (tickcounter_get_current_ms(handle->ticks, &now) != 0)
+                {
+                    LogError("unable to read the tick counter");
+                    break;
+                }
+                else if (now - started >= (tickcounter_ms_t)timeout)
+                {
+                    /*Codes_SRS_MESSAGE_QUEUE_17_034: [ MESSAGE_QUEUE_pop_wait shall return NULL if no message arrives within timeout milliseconds. ]*/
+                    break;
+                }
+                wait_ms = (int)((tickcounter_ms_t)timeout - (now - started));
+            }
+
+            /*Codes_SRS_MESSAGE_QUEUE_17_033: [ While the queue is empty, MESSAGE_QUEUE_pop_wait shall wait on the queue's condition for up to timeout milliseconds, or without a limit if timeout is negative. ]*/
+            handle->waiters++;
+            (void)Condition_Wait(handle->condition, handle->lock, wait_ms);
+            handle->waiters--;
+        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_035: [ If timeout is 0, MESSAGE_QUEUE_pop_wait shall not wait. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_pop_wait shall return NULL without waiting on an empty queue once MESSAGE_QUEUE_close was called. ]*/
+        if (handle->closed && handle->waiters != 0)
+        {
+            /*pass the wake up from MESSAGE_QUEUE_close on to the next waiter*/
+            (void)Condition_Post(handle->condition);
+        }
+        (void)Unlock(handle->lock);
+    }
+    return result;
+}
+
+void MESSAGE_QUEUE_close(MESSAGE_QUEUE_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_037: [ MESSAGE_QUEUE_close shall do nothing if handle is NULL. ]*/
+        LogError("invalid argument handle (NULL).");
+    }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the message queue");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_038: [ MESSAGE_QUEUE_close shall mark the queue closed and wake every thread waiting in MESSAGE_QUEUE_pop_wait. ]*/
+        handle->closed = true;
+        if (handle->waiters != 0)
+        {
+            /*wakes one waiter, which wakes the next as it leaves*/
+            (void)Condition_Post(handle->condition);
+        }
+        (void)Unlock(handle->lock);
+    }
+}
+
 /* access */
 bool MESSAGE_QUEUE_is_empty(MESSAGE_QUEUE_HANDLE handle)
 {
-	bool result;
-	if (handle == NULL)
-	{
+    bool result;
+    if (handle == NULL)
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_016: [ MESSAGE_QUEUE_is_empty shall return true if handle is NULL. ]*/
-		LogError("invalid argument handle (NULL).");
-		result = true;
-	}
-	else
-	{
+        LogError("invalid argument handle (NULL).");
+        result = true;
+    }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the message queue");
+        result = true;
+    }
+    else
+    {
         /*Codes_SRS_MESSAGE_QUEUE_17_017: [ MESSAGE_QUEUE_is_empty shall return true if there are no messages on the queue. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_018: [ MESSAGE_QUEUE_is_empty shall return false if one or more messages have been pushed on the queue. ]*/
-		result = (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)));
-	}
-	return result;
+        result = (handle->count == 0);
+        (void)Unlock(handle->lock);
+    }
+    return result;
 }
 
 MESSAGE_HANDLE MESSAGE_QUEUE_front(MESSAGE_QUEUE_HANDLE handle)
@@ -167,23 +379,41 @@ MESSAGE_HANDLE MESSAGE_QUEUE_front(MESSAGE_QUEUE_HANDLE handle)
         LogError("invalid argument handle (NULL).");
         result = NULL;
     }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the message queue");
+        result = NULL;
+    }
     else
     {
         /*Codes_SRS_MESSAGE_QUEUE_17_020: [ MESSAGE_QUEUE_front shall return NULL if the message queue is empty. ]*/
-        if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
-        {
-            result = NULL;
-        }
-        else
-        {
-            /*Codes_SRS_MESSAGE_QUEUE_17_021: [ On a non-empty queue, MESSAGE_QUEUE_front shall return the first remaining element that was pushed onto the message queue. ]*/
-            
-            MESSAGE_QUEUE_STORAGE* entry = (MESSAGE_QUEUE_STORAGE*)DList_RemoveHeadList((PDLIST_ENTRY)&(handle->queue_head));
-            result = entry->message;
-            /*Codes_SRS_MESSAGE_QUEUE_17_022: [ The content of the message queue shall not be changed after calling MESSAGE_QUEUE_front. ]*/
-            DList_InsertHeadList((PDLIST_ENTRY)&(handle->queue_head), (PDLIST_ENTRY)entry);
-        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_021: [ On a non-empty queue, MESSAGE_QUEUE_front shall return the first remaining element that was pushed onto the message queue. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_022: [ The content of the message queue shall not be changed after calling MESSAGE_QUEUE_front. ]*/
+        result = (handle->count == 0) ? NULL : handle->slots[handle->head];
+        (void)Unlock(handle->lock);
     }
     return result;
 }
 
+size_t MESSAGE_QUEUE_size(MESSAGE_QUEUE_HANDLE handle)
+{
+    size_t result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_039: [ MESSAGE_QUEUE_size shall return 0 if handle is NULL. ]*/
+        LogError("invalid argument handle (NULL).");
+        result = 0;
+    }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the message queue");
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_040: [ MESSAGE_QUEUE_size shall return the number of messages on the queue. ]*/
+        result = handle->count;
+        (void)Unlock(handle->lock);
+    }
+    return result;
+}
@@ -0,0 +1,362 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message.h"
+#include "message_ring.h"
+#include "gateway_atomic.h"
+
+/*largest ring that can be created, keeps sequence arithmetic well inside 32 bits*/
+#define MESSAGE_RING_MAX_CAPACITY ((size_t)1 << 24)
+/*times the consumer retries an empty ring before going to sleep*/
+#define MESSAGE_RING_SPIN_COUNT 64
+/*upper bound on one sleep; the consumer re-checks the ring when it wakes*/
+#define MESSAGE_RING_WAIT_MS 100
+#define MESSAGE_RING_CACHE_LINE 64
+
+/*One slot of the ring. The sequence number tells producers and the consumer
+ *whose turn it is: equal to the slot's position when it is free to write,
+ *position + 1 once it holds a message.
+ */
+typedef struct MESSAGE_RING_CELL_TAG
+{
+    GATEWAY_ATOMIC_U32  sequence;
+    MESSAGE_HANDLE      message;
+} MESSAGE_RING_CELL;
+
+typedef struct MESSAGE_RING_TAG
+{
+    MESSAGE_RING_CELL*  cells;
+    uint32_t            mask;
+    LOCK_HANDLE         wait_lock;
+    COND_HANDLE         wait_condition;
+    GATEWAY_ATOMIC_U32  closed;
+    GATEWAY_ATOMIC_U32  consumer_waiting;
+    /*producer and consumer positions live on their own cache lines*/
+    char                pad0[MESSAGE_RING_CACHE_LINE];
+    GATEWAY_ATOMIC_U32  enqueue_position;
+    char                pad1[MESSAGE_RING_CACHE_LINE];
+    uint32_t            dequeue_position;
+} MESSAGE_RING_HANDLE_DATA;
+
+static MESSAGE_HANDLE ring_try_pop(MESSAGE_RING_HANDLE_DATA* ring)
+{
+    MESSAGE_HANDLE result;
+    uint32_t position = ring->dequeue_position;
+    MESSAGE_RING_CELL* cell = &ring->cells[position & ring->mask];
+    if ((int32_t)(gateway_atomic_load(&cell->sequence) - (position + 1)) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = cell->message;
+        cell->message = NULL;
+        ring->dequeue_position = position + 1;
+        /*hand the slot back to producers for the next lap*/
+        gateway_atomic_store(&cell->sequence, position + ring->mask + 1);
+    }
+    return result;
+}
+
+static void ring_wake_consumer(MESSAGE_RING_HANDLE_DATA* ring)
+{
+    if (Lock(ring->wait_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the ring");
+    }
+    else
+    {
+        (void)Condition_Post(ring->wait_condition);
+        (void)Unlock(ring->wait_lock);
+    }
+}
+
+MESSAGE_RING_HANDLE MESSAGE_RING_create(size_t capacity)
+{
+    MESSAGE_RING_HANDLE_DATA* result;
+    if (capacity == 0 || capacity > MESSAGE_RING_MAX_CAPACITY)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_001: [ MESSAGE_RING_create shall return NULL if capacity is 0 or larger than 2^24. ]*/
+        LogError("invalid capacity %zu", capacity);
+        result = NULL;
+    }
+    else
+    {
+        result = (MESSAGE_RING_HANDLE_DATA*)malloc(sizeof(MESSAGE_RING_HANDLE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_RING_17_002: [ MESSAGE_RING_create shall return NULL if any underlying call fails. ]*/
+            LogError("malloc failed.");
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_RING_17_003: [ MESSAGE_RING_create shall round capacity up to the next power of two. ]*/
+            uint32_t slots = 2;
+            while (slots < capacity)
+            {
+                slots <<= 1;
+            }
+
+            /*Codes_SRS_MESSAGE_RING_17_004: [ MESSAGE_RING_create shall allocate one cell per slot. ]*/
+            result->cells = (MESSAGE_RING_CELL*)malloc(slots * sizeof(MESSAGE_RING_CELL));
+            if (result->cells == NULL)
+            {
+                /*Codes_SRS_MESSAGE_RING_17_002: [ MESSAGE_RING_create shall return NULL if any underlying call fails. ]*/
+                LogError("malloc of ring cells failed.");
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_RING_17_005: [ MESSAGE_RING_create shall create a lock and a condition used to put an idle consumer to sleep. ]*/
+                result->wait_lock = Lock_Init();
+                if (result->wait_lock == NULL)
+                {
+                    /*Codes_SRS_MESSAGE_RING_17_002: [ MESSAGE_RING_create shall return NULL if any underlying call fails. ]*/
+                    LogError("Lock_Init failed.");
+                    free(result->cells);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->wait_condition = Condition_Init();
+                    if (result->wait_condition == NULL)
+                    {
+                        /*Codes_SRS_MESSAGE_RING_17_002: [ MESSAGE_RING_create shall return NULL if any underlying call fails. ]*/
+                        LogError("Condition_Init failed.");
+                        Lock_Deinit(result->wait_lock);
+                        free(result->cells);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_MESSAGE_RING_17_006: [ A newly created ring shall be empty and open. ]*/
+                        uint32_t i;
+                        for (i = 0; i < slots; i++)
+                        {
+                            result->cells[i].sequence = i;
+                            result->cells[i].message = NULL;
+                        }
+                        result->mask = slots - 1;
+                        result->closed = 0;
+                        result->consumer_waiting = 0;
+                        result->enqueue_position = 0;
+                        result->dequeue_position = 0;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void MESSAGE_RING_destroy(MESSAGE_RING_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_007: [ MESSAGE_RING_destroy shall do nothing if handle is NULL. ]*/
+        LogError("invalid argument handle(NULL).");
+    }
+    else
+    {
+        MESSAGE_RING_HANDLE_DATA* ring = (MESSAGE_RING_HANDLE_DATA*)handle;
+        MESSAGE_HANDLE message;
+        while ((message = ring_try_pop(ring)) != NULL)
+        {
+            /*Codes_SRS_MESSAGE_RING_17_008: [ MESSAGE_RING_destroy shall destroy every message still in the ring. ]*/
+            Message_Destroy(message);
+        }
+        /*Codes_SRS_MESSAGE_RING_17_009: [ MESSAGE_RING_destroy shall free all allocated resources. ]*/
+        Condition_Deinit(ring->wait_condition);
+        Lock_Deinit(ring->wait_lock);
+        free(ring->cells);
+        free(ring);
+    }
+}
+
+int MESSAGE_RING_push(MESSAGE_RING_HANDLE handle, MESSAGE_HANDLE element)
+{
+    int result;
+    if (handle == NULL || element == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_010: [ MESSAGE_RING_push shall return a non-zero value if handle or element are NULL. ]*/
+        LogError("invalid argument - handle(%p), element(%p).", handle, element);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_RING_HANDLE_DATA* ring = (MESSAGE_RING_HANDLE_DATA*)handle;
+        if (gateway_atomic_load(&ring->closed) != 0)
+        {
+            /*Codes_SRS_MESSAGE_RING_17_011: [ MESSAGE_RING_push shall return a non-zero value if the ring is closed. ]*/
+            result = __LINE__;
+        }
+        else
+        {
+            MESSAGE_RING_CELL* cell = NULL;
+            uint32_t position = gateway_atomic_load(&ring->enqueue_position);
+            /*Codes_SRS_MESSAGE_RING_17_012: [ MESSAGE_RING_push shall claim the next free slot without taking a lock. ]*/
+            for (;;)
+            {
+                int32_t lap;
+                cell = &ring->cells[position & ring->mask];
+                lap = (int32_t)(gateway_atomic_load(&cell->sequence) - position);
+                if (lap == 0)
+                {
+                    if (gateway_atomic_compare_exchange(&ring->enqueue_position, position, position + 1))
+                    {
+                        break;
+                    }
+                    position = gateway_atomic_load(&ring->enqueue_position);
+                }
+                else if (lap < 0)
+                {
+                    /*the consumer has not freed this slot yet: the ring is full*/
+                    cell = NULL;
+                    break;
+                }
+                else
+                {
+                    position = gateway_atomic_load(&ring->enqueue_position);
+                }
+            }
+
+            if (cell == NULL)
+            {
+                /*Codes_SRS_MESSAGE_RING_17_013: [ MESSAGE_RING_push shall return a non-zero value, without blocking, if the ring is full. ]*/
+                result = __LINE__;
+            }
+            else
+            {
+                cell->message = element;
+                gateway_atomic_store(&cell->sequence, position + 1);
+
+                /*Codes_SRS_MESSAGE_RING_17_014: [ MESSAGE_RING_push shall wake the consumer only if it is waiting on an empty ring. ]*/
+                gateway_atomic_fence();
+                if (gateway_atomic_load(&ring->consumer_waiting) != 0)
+                {
+                    ring_wake_consumer(ring);
+                }
+                /*Codes_SRS_MESSAGE_RING_17_015: [ MESSAGE_RING_push shall return zero on success. ]*/
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+MESSAGE_HANDLE MESSAGE_RING_pop(MESSAGE_RING_HANDLE handle)
+{
+    MESSAGE_HANDLE result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_016: [ MESSAGE_RING_pop shall return NULL if handle is NULL. ]*/
+        LogError("invalid argument handle(NULL).");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_RING_HANDLE_DATA* ring = (MESSAGE_RING_HANDLE_DATA*)handle;
+        result = NULL;
+        /*Codes_SRS_MESSAGE_RING_17_017: [ MESSAGE_RING_pop shall return NULL once the ring is closed. ]*/
+        while (gateway_atomic_load(&ring->closed) == 0)
+        {
+            int spin;
+            /*Codes_SRS_MESSAGE_RING_17_018: [ MESSAGE_RING_pop shall remove messages from the ring in a first-in-first-out order. ]*/
+            for (spin = 0; spin < MESSAGE_RING_SPIN_COUNT && result == NULL; spin++)
+            {
+                result = ring_try_pop(ring);
+            }
+
+            if (result != NULL)
+            {
+                break;
+            }
+            /*Codes_SRS_MESSAGE_RING_17_019: [ If the ring stays empty, MESSAGE_RING_pop shall wait on the ring's condition until a producer or MESSAGE_RING_close wakes it. ]*/
+            else if (Lock(ring->wait_lock) != LOCK_OK)
+            {
+                LogError("unable to lock the ring");
+                break;
+            }
+            else
+            {
+                gateway_atomic_store(&ring->consumer_waiting, 1);
+                gateway_atomic_fence();
+                /*a producer may have pushed before it could see consumer_waiting*/
+                result = ring_try_pop(ring);
+                if (result == NULL && gateway_atomic_load(&ring->closed) == 0)
+                {
+                    (void)Condition_Wait(ring->wait_condition, ring->wait_lock, MESSAGE_RING_WAIT_MS);
+                }
+                gateway_atomic_store(&ring->consumer_waiting, 0);
+                (void)Unlock(ring->wait_lock);
+
+                if (result != NULL)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (result != NULL && gateway_atomic_load(&ring->closed) != 0)
+        {
+            /*closed while we were fetching it, MESSAGE_RING_destroy cleans up the rest*/
+            Message_Destroy(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+MESSAGE_HANDLE MESSAGE_RING_try_pop(MESSAGE_RING_HANDLE handle)
+{
+    MESSAGE_HANDLE result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_022: [ MESSAGE_RING_try_pop shall return NULL if handle is NULL. ]*/
+        LogError("invalid argument handle(NULL).");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_RING_HANDLE_DATA* ring = (MESSAGE_RING_HANDLE_DATA*)handle;
+        if (gateway_atomic_load(&ring->closed) != 0)
+        {
+            /*Codes_SRS_MESSAGE_RING_17_023: [ MESSAGE_RING_try_pop shall return NULL once the ring is closed. ]*/
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_RING_17_024: [ MESSAGE_RING_try_pop shall remove the oldest message from the ring, or return NULL without waiting if the ring is empty. ]*/
+            result = ring_try_pop(ring);
+        }
+    }
+    return result;
+}
+
+void MESSAGE_RING_close(MESSAGE_RING_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_RING_17_020: [ MESSAGE_RING_close shall do nothing if handle is NULL. ]*/
+        LogError("invalid argument handle(NULL).");
+    }
+    else
+    {
+        MESSAGE_RING_HANDLE_DATA* ring = (MESSAGE_RING_HANDLE_DATA*)handle;
+        /*Codes_SRS_MESSAGE_RING_17_021: [ MESSAGE_RING_close shall mark the ring closed and wake the consumer. ]*/
+        gateway_atomic_store(&ring->closed, 1);
+        gateway_atomic_fence();
+        ring_wake_consumer(ring);
+    }
+}
@@ -0,0 +1,109 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*Unsigned varints of version 2 of the serialized message format: 7 bits per
+ *byte, least significant group first, with the high bit set on every byte but
+ *the last. Values are limited to 32 bits, so a varint takes 1 to 5 bytes.
+ *Version 3 adds 8 byte big-endian numbers.
+ */
+
+#ifndef MESSAGE_VARINT_H
+#define MESSAGE_VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#define MESSAGE_VARINT_INLINE static __inline
+#else
+#define MESSAGE_VARINT_INLINE static inline
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MESSAGE_VARINT_MAX_SIZE 5
+
+/*bytes needed to write value*/
+MESSAGE_VARINT_INLINE size_t message_varint_size(uint32_t value)
+{
+    size_t result = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        result++;
+    }
+    return result;
+}
+
+/*writes value at buf, returns the number of bytes written*/
+MESSAGE_VARINT_INLINE size_t message_varint_write(unsigned char* buf, uint32_t value)
+{
+    size_t result = 0;
+    while (value >= 0x80)
+    {
+        buf[result++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buf[result++] = (unsigned char)value;
+    return result;
+}
+
+/*reads a varint from the size bytes at source, returns the number of bytes
+ *read, or 0 if it does not end within them or does not fit 32 bits*/
+MESSAGE_VARINT_INLINE size_t message_varint_read(const unsigned char* source, size_t size, uint32_t* value)
+{
+    size_t read = 0;
+    size_t result = 0;
+    uint32_t parsed = 0;
+    while (result == 0 && read < size && read < MESSAGE_VARINT_MAX_SIZE)
+    {
+        unsigned char byte = source[read];
+        if (read == 4 && byte > 0x0F)
+        {
+            /*more than 32 bits*/
+            break;
+        }
+        parsed |= (uint32_t)(byte & 0x7F) << (7 * read);
+        read++;
+        if ((byte & 0x80) == 0)
+        {
+            *value = parsed;
+            result = read;
+        }
+    }
+    return result;
+}
+
+#define MESSAGE_FIXED64_SIZE 8
+
+/*writes value at buf in MESSAGE_FIXED64_SIZE bytes, most significant first*/
+MESSAGE_VARINT_INLINE void message_fixed64_write(unsigned char* buf, uint64_t value)
+{
+    size_t i;
+    for (i = MESSAGE_FIXED64_SIZE; i > 0; i--)
+    {
+        buf[i - 1] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+/*reads the MESSAGE_FIXED64_SIZE bytes at source, most significant first*/
+MESSAGE_VARINT_INLINE uint64_t message_fixed64_read(const unsigned char* source)
+{
+    uint64_t result = 0;
+    size_t i;
+    for (i = 0; i < MESSAGE_FIXED64_SIZE; i++)
+    {
+        result = (result << 8) | source[i];
+    }
+    return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MESSAGE_VARINT_H */
@@ -0,0 +1,498 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "module_scheduler.h"
+#include "gateway_atomic.h"
+
+/*workers started when the processor count cannot be found*/
+#define MODULE_SCHEDULER_DEFAULT_WORKERS 4
+/*largest pool that can be created*/
+#define MODULE_SCHEDULER_MAX_WORKERS 1024
+/*messages a task handles before it goes to the back of the queue, so one busy
+ *module cannot starve the others sharing its worker*/
+#define MODULE_SCHEDULER_TASK_BUDGET 32
+/*upper bound on one sleep; the worker looks for tasks again when it wakes*/
+#define MODULE_SCHEDULER_WAIT_MS 100
+
+/*A task is in exactly one of these states. Only the thread that moves it out
+ *of TASK_IDLE queues it, and only the worker that dequeues it runs it.
+ */
+#define TASK_IDLE       0
+#define TASK_QUEUED     1
+#define TASK_RUNNING    2
+/*running, and notified since it started: it is queued again when it returns*/
+#define TASK_NOTIFIED   3
+#define TASK_REMOVED    4
+
+typedef struct MODULE_TASK_TAG
+{
+    struct MODULE_SCHEDULER_TAG*    scheduler;
+    MODULE_TASK_RUN                 run;
+    void*                           context;
+    GATEWAY_ATOMIC_U32              state;
+    /** Worker the task is queued on when notified, the last one that ran it */
+    GATEWAY_ATOMIC_U32              home;
+    /** Next task in a worker queue, guarded by that worker's lock */
+    struct MODULE_TASK_TAG*         next;
+} MODULE_TASK;
+
+typedef struct MODULE_WORKER_TAG
+{
+    struct MODULE_SCHEDULER_TAG*    scheduler;
+    size_t                          index;
+    THREAD_HANDLE                   thread;
+    /** Guards the queue, taken by the owner and by workers stealing from it */
+    LOCK_HANDLE                     lock;
+    MODULE_TASK*                    head;
+    MODULE_TASK*                    tail;
+} MODULE_WORKER;
+
+typedef struct MODULE_SCHEDULER_TAG
+{
+    MODULE_WORKER*      workers;
+    size_t              worker_count;
+    LOCK_HANDLE         sleep_lock;
+    COND_HANDLE         sleep_condition;
+    /** Tasks waiting in any worker queue */
+    GATEWAY_ATOMIC_U32  queued;
+    /** Workers asleep, or about to be, on sleep_condition */
+    GATEWAY_ATOMIC_U32  sleepers;
+    GATEWAY_ATOMIC_U32  stopping;
+    /** Spreads new tasks over the workers */
+    GATEWAY_ATOMIC_U32  next_home;
+} MODULE_SCHEDULER_HANDLE_DATA;
+
+static size_t processor_count(void)
+{
+    size_t result;
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    result = (size_t)system_info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    result = (processors > 0) ? (size_t)processors : MODULE_SCHEDULER_DEFAULT_WORKERS;
+#else
+    result = MODULE_SCHEDULER_DEFAULT_WORKERS;
+#endif
+    return (result == 0) ? 1 : result;
+}
+
+static void wake_workers(MODULE_SCHEDULER_HANDLE_DATA* scheduler, size_t count)
+{
+    if (Lock(scheduler->sleep_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the scheduler");
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            (void)Condition_Post(scheduler->sleep_condition);
+        }
+        (void)Unlock(scheduler->sleep_lock);
+    }
+}
+
+static void queue_push(MODULE_WORKER* worker, MODULE_TASK* task)
+{
+    MODULE_SCHEDULER_HANDLE_DATA* scheduler = worker->scheduler;
+    if (Lock(worker->lock) != LOCK_OK)
+    {
+        /*leave the task idle, the next notification tries again*/
+        LogError("unable to lock worker queue");
+        gateway_atomic_store(&task->state, TASK_IDLE);
+    }
+    else
+    {
+        task->next = NULL;
+        if (worker->tail == NULL)
+        {
+            worker->head = task;
+        }
+        else
+        {
+            worker->tail->next = task;
+        }
+        worker->tail = task;
+        (void)Unlock(worker->lock);
+
+        /*Codes_SRS_MODULE_SCHEDULER_17_017: [ Queuing a task shall wake a sleeping worker, if there is one. ]*/
+        (void)gateway_atomic_increment(&scheduler->queued);
+        gateway_atomic_fence();
+        if (gateway_atomic_load(&scheduler->sleepers) != 0)
+        {
+            wake_workers(scheduler, 1);
+        }
+    }
+}
+
+static MODULE_TASK* queue_pop(MODULE_WORKER* worker)
+{
+    MODULE_TASK* result;
+    if (Lock(worker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock worker queue");
+        result = NULL;
+    }
+    else
+    {
+        result = worker->head;
+        if (result != NULL)
+        {
+            worker->head = result->next;
+            if (worker->head == NULL)
+            {
+                worker->tail = NULL;
+            }
+        }
+        (void)Unlock(worker->lock);
+
+        if (result != NULL)
+        {
+            (void)gateway_atomic_decrement(&worker->scheduler->queued);
+        }
+    }
+    return result;
+}
+
+static MODULE_TASK* find_task(MODULE_WORKER* worker)
+{
+    MODULE_SCHEDULER_HANDLE_DATA* scheduler = worker->scheduler;
+    /*Codes_SRS_MODULE_SCHEDULER_17_018: [ A worker shall take the oldest task from its own queue or, if that is empty, steal the oldest task from the other workers' queues in turn. ]*/
+    MODULE_TASK* result = queue_pop(worker);
+    size_t i;
+    for (i = 1; i < scheduler->worker_count && result == NULL; i++)
+    {
+        result = queue_pop(&scheduler->workers[(worker->index + i) % scheduler->worker_count]);
+    }
+    return result;
+}
+
+static void run_task(MODULE_WORKER* worker, MODULE_TASK* task)
+{
+    bool more;
+    /*Codes_SRS_MODULE_SCHEDULER_17_019: [ A worker shall run a task it took with a budget of 32 and make itself the task's home worker. ]*/
+    gateway_atomic_store(&task->home, (uint32_t)worker->index);
+    gateway_atomic_store(&task->state, TASK_RUNNING);
+    /*whatever was notified before the task left the queue must be seen by run*/
+    gateway_atomic_fence();
+    more = task->run(task->context, MODULE_SCHEDULER_TASK_BUDGET);
+
+    /*Codes_SRS_MODULE_SCHEDULER_17_020: [ If the task's run function returns true, or the task was notified while it ran, the worker shall put it at the back of its own queue; otherwise the task shall become idle. ]*/
+    if (more || !gateway_atomic_compare_exchange(&task->state, TASK_RUNNING, TASK_IDLE))
+    {
+        gateway_atomic_store(&task->state, TASK_QUEUED);
+        queue_push(worker, task);
+    }
+}
+
+/*returns 0 once woken or timed out, non-zero if the worker must stop*/
+static int wait_for_task(MODULE_SCHEDULER_HANDLE_DATA* scheduler)
+{
+    int result;
+    if (Lock(scheduler->sleep_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_022: [ If a worker cannot lock the scheduler to sleep, it shall return. ]*/
+        LogError("unable to lock the scheduler");
+        result = __LINE__;
+    }
+    else
+    {
+        (void)gateway_atomic_increment(&scheduler->sleepers);
+        gateway_atomic_fence();
+        /*a task may have been queued before its notifier could see this worker asleep*/
+        if (gateway_atomic_load(&scheduler->queued) == 0 && gateway_atomic_load(&scheduler->stopping) == 0)
+        {
+            (void)Condition_Wait(scheduler->sleep_condition, scheduler->sleep_lock, MODULE_SCHEDULER_WAIT_MS);
+        }
+        (void)gateway_atomic_decrement(&scheduler->sleepers);
+        (void)Unlock(scheduler->sleep_lock);
+        result = 0;
+    }
+    return result;
+}
+
+static int scheduler_worker(void* user_data)
+{
+    MODULE_WORKER* worker = (MODULE_WORKER*)user_data;
+    MODULE_SCHEDULER_HANDLE_DATA* scheduler = worker->scheduler;
+
+    /*Codes_SRS_MODULE_SCHEDULER_17_021: [ A worker with no task to run shall sleep on the scheduler's condition until a task is queued or the scheduler is stopped. ]*/
+    while (gateway_atomic_load(&scheduler->stopping) == 0)
+    {
+        MODULE_TASK* task = find_task(worker);
+        if (task != NULL)
+        {
+            run_task(worker, task);
+        }
+        else if (wait_for_task(scheduler) != 0)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void stop_workers(MODULE_SCHEDULER_HANDLE_DATA* scheduler, size_t started)
+{
+    size_t i;
+    gateway_atomic_store(&scheduler->stopping, 1);
+    gateway_atomic_fence();
+    wake_workers(scheduler, started);
+    for (i = 0; i < started; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(scheduler->workers[i].thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for worker %zu", i);
+        }
+    }
+}
+
+static void deinit_workers(MODULE_SCHEDULER_HANDLE_DATA* scheduler, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        Lock_Deinit(scheduler->workers[i].lock);
+    }
+}
+
+MODULE_SCHEDULER_HANDLE MODULE_SCHEDULER_create(size_t worker_count)
+{
+    MODULE_SCHEDULER_HANDLE_DATA* result;
+    /*Codes_SRS_MODULE_SCHEDULER_17_001: [ If worker_count is 0, MODULE_SCHEDULER_create shall start one worker per processor. ]*/
+    size_t workers = (worker_count == 0) ? processor_count() : worker_count;
+    if (workers > MODULE_SCHEDULER_MAX_WORKERS)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_002: [ MODULE_SCHEDULER_create shall return NULL if worker_count is larger than 1024. ]*/
+        LogError("invalid worker count %zu", worker_count);
+        result = NULL;
+    }
+    else
+    {
+        result = (MODULE_SCHEDULER_HANDLE_DATA*)malloc(sizeof(MODULE_SCHEDULER_HANDLE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+            LogError("malloc failed.");
+        }
+        else
+        {
+            /*Codes_SRS_MODULE_SCHEDULER_17_004: [ MODULE_SCHEDULER_create shall allocate one worker, with an empty queue and a lock, per worker thread. ]*/
+            result->workers = (MODULE_WORKER*)malloc(workers * sizeof(MODULE_WORKER));
+            if (result->workers == NULL)
+            {
+                /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+                LogError("malloc of workers failed.");
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                size_t initialized;
+                for (initialized = 0; initialized < workers; initialized++)
+                {
+                    MODULE_WORKER* worker = &result->workers[initialized];
+                    worker->lock = Lock_Init();
+                    if (worker->lock == NULL)
+                    {
+                        break;
+                    }
+                    worker->scheduler = result;
+                    worker->index = initialized;
+                    worker->head = NULL;
+                    worker->tail = NULL;
+                }
+
+                if (initialized < workers)
+                {
+                    /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+                    LogError("Lock_Init failed for worker %zu.", initialized);
+                    deinit_workers(result, initialized);
+                    free(result->workers);
+                    free(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_MODULE_SCHEDULER_17_005: [ MODULE_SCHEDULER_create shall create a lock and a condition used to put idle workers to sleep. ]*/
+                else if ((result->sleep_lock = Lock_Init()) == NULL)
+                {
+                    /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+                    LogError("Lock_Init failed.");
+                    deinit_workers(result, workers);
+                    free(result->workers);
+                    free(result);
+                    result = NULL;
+                }
+                else if ((result->sleep_condition = Condition_Init()) == NULL)
+                {
+                    /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+                    LogError("Condition_Init failed.");
+                    Lock_Deinit(result->sleep_lock);
+                    deinit_workers(result, workers);
+                    free(result->workers);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    size_t started;
+                    result->worker_count = workers;
+                    result->queued = 0;
+                    result->sleepers = 0;
+                    result->stopping = 0;
+                    result->next_home = 0;
+
+                    /*Codes_SRS_MODULE_SCHEDULER_17_006: [ MODULE_SCHEDULER_create shall start a thread for every worker. ]*/
+                    for (started = 0; started < workers; started++)
+                    {
+                        if (ThreadAPI_Create(&result->workers[started].thread, scheduler_worker, &result->workers[started]) != THREADAPI_OK)
+                        {
+                            break;
+                        }
+                    }
+
+                    if (started < workers)
+                    {
+                        /*Codes_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+                        LogError("ThreadAPI_Create failed for worker %zu.", started);
+                        stop_workers(result, started);
+                        Condition_Deinit(result->sleep_condition);
+                        Lock_Deinit(result->sleep_lock);
+                        deinit_workers(result, workers);
+                        free(result->workers);
+                        free(result);
+                        result = NULL;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void MODULE_SCHEDULER_destroy(MODULE_SCHEDULER_HANDLE handle)
+{
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_007: [ MODULE_SCHEDULER_destroy shall do nothing if handle is NULL. ]*/
+        LogError("invalid argument handle(NULL).");
+    }
+    else
+    {
+        MODULE_SCHEDULER_HANDLE_DATA* scheduler = (MODULE_SCHEDULER_HANDLE_DATA*)handle;
+        /*Codes_SRS_MODULE_SCHEDULER_17_008: [ MODULE_SCHEDULER_destroy shall mark the scheduler stopping, wake every worker and join every worker thread. ]*/
+        stop_workers(scheduler, scheduler->worker_count);
+        /*Codes_SRS_MODULE_SCHEDULER_17_009: [ MODULE_SCHEDULER_destroy shall free all allocated resources. ]*/
+        Condition_Deinit(scheduler->sleep_condition);
+        Lock_Deinit(scheduler->sleep_lock);
+        deinit_workers(scheduler, scheduler->worker_count);
+        free(scheduler->workers);
+        free(scheduler);
+    }
+}
+
+MODULE_TASK_HANDLE MODULE_SCHEDULER_add_task(MODULE_SCHEDULER_HANDLE handle, MODULE_TASK_RUN run, void* context)
+{
+    MODULE_TASK* result;
+    if (handle == NULL || run == NULL)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_010: [ MODULE_SCHEDULER_add_task shall return NULL if handle or run are NULL. ]*/
+        LogError("invalid argument - handle(%p), run(%p).", handle, run);
+        result = NULL;
+    }
+    else
+    {
+        MODULE_SCHEDULER_HANDLE_DATA* scheduler = (MODULE_SCHEDULER_HANDLE_DATA*)handle;
+        result = (MODULE_TASK*)malloc(sizeof(MODULE_TASK));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MODULE_SCHEDULER_17_011: [ MODULE_SCHEDULER_add_task shall return NULL if it cannot allocate the task. ]*/
+            LogError("malloc failed.");
+        }
+        else
+        {
+            /*Codes_SRS_MODULE_SCHEDULER_17_012: [ MODULE_SCHEDULER_add_task shall create an idle task whose home is the next worker in turn. ]*/
+            result->scheduler = scheduler;
+            result->run = run;
+            result->context = context;
+            result->state = TASK_IDLE;
+            result->home = (gateway_atomic_increment(&scheduler->next_home) - 1) % (uint32_t)scheduler->worker_count;
+            result->next = NULL;
+        }
+    }
+    return result;
+}
+
+void MODULE_SCHEDULER_notify(MODULE_TASK_HANDLE task)
+{
+    if (task == NULL)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_013: [ MODULE_SCHEDULER_notify shall do nothing if task is NULL. ]*/
+        LogError("invalid argument task(NULL).");
+    }
+    else
+    {
+        bool done = false;
+        /*whatever the caller did before notifying must be seen by the next run*/
+        gateway_atomic_fence();
+        while (!done)
+        {
+            uint32_t state = gateway_atomic_load(&task->state);
+            if (state == TASK_IDLE)
+            {
+                /*Codes_SRS_MODULE_SCHEDULER_17_014: [ If the task is idle, MODULE_SCHEDULER_notify shall queue it on its home worker. ]*/
+                if (gateway_atomic_compare_exchange(&task->state, TASK_IDLE, TASK_QUEUED))
+                {
+                    queue_push(&task->scheduler->workers[gateway_atomic_load(&task->home)], task);
+                    done = true;
+                }
+            }
+            else if (state == TASK_RUNNING)
+            {
+                /*Codes_SRS_MODULE_SCHEDULER_17_015: [ If the task is running, MODULE_SCHEDULER_notify shall have it queued again when it returns instead of running it on another worker. ]*/
+                done = gateway_atomic_compare_exchange(&task->state, TASK_RUNNING, TASK_NOTIFIED);
+            }
+            else
+            {
+                /*Codes_SRS_MODULE_SCHEDULER_17_016: [ If the task is queued already, MODULE_SCHEDULER_notify shall do nothing. ]*/
+                done = true;
+            }
+        }
+    }
+}
+
+void MODULE_SCHEDULER_remove_task(MODULE_TASK_HANDLE task)
+{
+    if (task == NULL)
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_023: [ MODULE_SCHEDULER_remove_task shall do nothing if task is NULL. ]*/
+        LogError("invalid argument task(NULL).");
+    }
+    else
+    {
+        /*Codes_SRS_MODULE_SCHEDULER_17_024: [ MODULE_SCHEDULER_remove_task shall wait until the task is neither queued nor running, then free it. ]*/
+        while (!gateway_atomic_compare_exchange(&task->state, TASK_IDLE, TASK_REMOVED))
+        {
+            ThreadAPI_Sleep(0);
+        }
+        free(task);
+    }
+}
@@ -8,15 +8,21 @@
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "message.h"
+#include "message_ring.h"
+#include "module_scheduler.h"
+#include "link_filter.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "nanomsg/nn.h"
-#include "nanomsg/pubsub.h"
+#include "nanomsg/pair.h"
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
@@ -89,7 +95,25 @@ static size_t whenShallCond_Post_fail;
 static size_t currentThreadAPI_Create_call;
 static size_t whenShallThreadAPI_Create_fail;
 
+static size_t currentMESSAGE_RING_create_call;
+static size_t whenShallMESSAGE_RING_create_fail;
+
+static size_t currentMESSAGE_RING_push_call;
+static size_t whenShallMESSAGE_RING_push_fail;
+
+static MESSAGE_HANDLE ring_pop_message;
+
+static size_t currentMODULE_SCHEDULER_create_call;
+static size_t whenShallMODULE_SCHEDULER_create_fail;
+
+static MODULE_TASK_RUN task_run_to_call;
+static void* task_run_context;
+
+static bool link_filter_matches;
+
 static size_t nn_current_msg_size;
+static MESSAGE_HANDLE nn_recv_envelope_message;
+static size_t nn_recv_envelope_count;
 
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
@@ -159,6 +183,35 @@ MODULE fake_module =
     fake_module_handle
 };
 
+static size_t FakeModule_ReceiveBatch_calls;
+static size_t FakeModule_ReceiveBatch_count;
+
+static void FakeModule_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messageHandles, size_t count)
+{
+    (void)messageHandles;
+    FakeModule_ReceiveBatch_calls++;
+    FakeModule_ReceiveBatch_count += count;
+    ASSERT_ARE_EQUAL(void_ptr, module, call_status_for_FakeModule_Receive.module);
+}
+
+static MODULE_API_2 fake_module_apis_2 =
+{
+    { MODULE_API_VERSION_2 },
+    NULL,
+    NULL,
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive,
+    NULL,
+    FakeModule_ReceiveBatch
+};
+
+MODULE fake_module_2 =
+{
+    (const MODULE_API *)&fake_module_apis_2,
+    fake_module_handle
+};
+
 class RefCountObject
 {
 private:
@@ -243,6 +296,19 @@ public:
         auto result2 = LOCK_OK;
     MOCK_METHOD_END(LOCK_RESULT, result2)
 
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+    MOCK_METHOD_END(COND_HANDLE, BASEIMPLEMENTATION::gballoc_malloc(1))
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+    MOCK_METHOD_END(COND_RESULT, COND_OK)
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+    MOCK_METHOD_END(COND_RESULT, COND_OK)
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
         VECTOR_HANDLE result2;
         ++currentVECTOR_create_call;
@@ -327,6 +393,9 @@ public:
         }
     MOCK_METHOD_END(THREADAPI_RESULT, result2)
 
+    MOCK_STATIC_METHOD_1(, void, ThreadAPI_Sleep, unsigned int, milliseconds)
+    MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
         free(threadHandle);
         auto result2 = THREADAPI_OK;
@@ -344,11 +413,108 @@ public:
         ((RefCountObject*)message)->dec_ref();
     MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_2(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
-    MOCK_METHOD_END(MESSAGE_HANDLE, (MESSAGE_HANDLE)(new RefCountObject()))
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name)
+    MOCK_METHOD_END(const char*, "value")
+
+    // map.h
+    MOCK_STATIC_METHOD_1(, MAP_HANDLE, Map_Create, MAP_FILTER_CALLBACK, mapFilterFunc)
+    MOCK_METHOD_END(MAP_HANDLE, (MAP_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1))
+
+    MOCK_STATIC_METHOD_1(, void, Map_Destroy, MAP_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_VOID_METHOD_END()
+
+    // message_ring.h
+    MOCK_STATIC_METHOD_1(, MESSAGE_RING_HANDLE, MESSAGE_RING_create, size_t, capacity)
+        MESSAGE_RING_HANDLE result2;
+        ++currentMESSAGE_RING_create_call;
+        if ((whenShallMESSAGE_RING_create_fail > 0) &&
+            (currentMESSAGE_RING_create_call == whenShallMESSAGE_RING_create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (MESSAGE_RING_HANDLE)malloc(1);
+        }
+    MOCK_METHOD_END(MESSAGE_RING_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MESSAGE_RING_destroy, MESSAGE_RING_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, MESSAGE_RING_push, MESSAGE_RING_HANDLE, handle, MESSAGE_HANDLE, element)
+        int result2;
+        ++currentMESSAGE_RING_push_call;
+        if ((whenShallMESSAGE_RING_push_fail > 0) &&
+            (currentMESSAGE_RING_push_call == whenShallMESSAGE_RING_push_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = 0;
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MESSAGE_RING_pop, MESSAGE_RING_HANDLE, handle)
+        MESSAGE_HANDLE result2 = ring_pop_message;
+        ring_pop_message = NULL;
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MESSAGE_RING_try_pop, MESSAGE_RING_HANDLE, handle)
+        MESSAGE_HANDLE result2 = ring_pop_message;
+        ring_pop_message = NULL;
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MESSAGE_RING_close, MESSAGE_RING_HANDLE, handle)
+    MOCK_VOID_METHOD_END()
+
+    // module_scheduler.h
+    MOCK_STATIC_METHOD_1(, MODULE_SCHEDULER_HANDLE, MODULE_SCHEDULER_create, size_t, worker_count)
+        MODULE_SCHEDULER_HANDLE result2;
+        ++currentMODULE_SCHEDULER_create_call;
+        if ((whenShallMODULE_SCHEDULER_create_fail > 0) &&
+            (currentMODULE_SCHEDULER_create_call == whenShallMODULE_SCHEDULER_create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (MODULE_SCHEDULER_HANDLE)malloc(1);
+        }
+    MOCK_METHOD_END(MODULE_SCHEDULER_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MODULE_SCHEDULER_destroy, MODULE_SCHEDULER_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, MODULE_TASK_HANDLE, MODULE_SCHEDULER_add_task, MODULE_SCHEDULER_HANDLE, handle, MODULE_TASK_RUN, run, void*, context)
+        MODULE_TASK_HANDLE result2 = (MODULE_TASK_HANDLE)malloc(1);
+        task_run_to_call = run;
+        task_run_context = context;
+    MOCK_METHOD_END(MODULE_TASK_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MODULE_SCHEDULER_notify, MODULE_TASK_HANDLE, task)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, void, MODULE_SCHEDULER_remove_task, MODULE_TASK_HANDLE, task)
+        free(task);
+    MOCK_VOID_METHOD_END()
+
+    // link_filter.h
+    MOCK_STATIC_METHOD_1(, LINK_FILTER_HANDLE, LINK_FILTER_create, const char*, expression)
+        LINK_FILTER_HANDLE result2 = (LINK_FILTER_HANDLE)malloc(1);
+    MOCK_METHOD_END(LINK_FILTER_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, LINK_FILTER_destroy, LINK_FILTER_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, bool, LINK_FILTER_matches, LINK_FILTER_HANDLE, handle, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(bool, link_filter_matches)
+
 
-    MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size)
-    MOCK_METHOD_END(int32_t, (int32_t)1)
 
     // list.h
 
@@ -501,6 +667,10 @@ public:
         int result1 = BASEIMPLEMENTATION::STRING_concat(s1, s2);
     MOCK_METHOD_END(int, result1);
 
+    MOCK_STATIC_METHOD_2(, int, STRING_concat_with_STRING, STRING_HANDLE, s1, STRING_HANDLE, s2)
+        int result1 = BASEIMPLEMENTATION::STRING_concat_with_STRING(s1, s2);
+    MOCK_METHOD_END(int, result1);
+
     MOCK_STATIC_METHOD_1(, const char*, STRING_c_str, STRING_HANDLE, s)
     MOCK_METHOD_END(const char*, BASEIMPLEMENTATION::STRING_c_str(s))
 
@@ -562,10 +732,31 @@ public:
         int rcv_length;
         if (len == NN_MSG)
         {
-            char * text = (char*)"nn_recv";
-            (*(void**)buf) = malloc(8);
-            memcpy((*(void**)buf), text, 8);
-            rcv_length = 8;
+            if (nn_recv_envelope_message != NULL)
+            {
+                /*hand over message envelopes, the way the broker delivers in process*/
+                void** envelope = (void**)malloc(nn_recv_envelope_count * sizeof(void*));
+                for (size_t e = 0; e < nn_recv_envelope_count; e++)
+                {
+                    envelope[e] = (void*)nn_recv_envelope_message;
+                }
+                nn_recv_envelope_message = NULL;
+                (*(void**)buf) = envelope;
+                rcv_length = (int)(nn_recv_envelope_count * sizeof(void*));
+            }
+            else if (flags == NN_DONTWAIT)
+            {
+                /*nothing left to drain*/
+                rcv_length = -1;
+            }
+            else
+            {
+                /*13 bytes so it never looks like an envelope, whatever the pointer size*/
+                char * text = (char*)"nn_recv";
+                (*(void**)buf) = malloc(13);
+                memcpy((*(void**)buf), text, 8);
+                rcv_length = 13;
+            }
         }
         else
         {
@@ -585,6 +776,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, loc
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, lock);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, VECTOR_destroy, VECTOR_HANDLE, vector);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements);
@@ -597,12 +793,32 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, VECTOR_size, VECTOR_HANDLE,
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
 DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, ThreadAPI_Sleep, unsigned int, milliseconds);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MAP_HANDLE, Map_Create, MAP_FILTER_CALLBACK, mapFilterFunc);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Map_Destroy, MAP_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_RING_HANDLE, MESSAGE_RING_create, size_t, capacity);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MESSAGE_RING_destroy, MESSAGE_RING_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, MESSAGE_RING_push, MESSAGE_RING_HANDLE, handle, MESSAGE_HANDLE, element);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MESSAGE_RING_pop, MESSAGE_RING_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MESSAGE_RING_try_pop, MESSAGE_RING_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MESSAGE_RING_close, MESSAGE_RING_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MODULE_SCHEDULER_HANDLE, MODULE_SCHEDULER_create, size_t, worker_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MODULE_SCHEDULER_destroy, MODULE_SCHEDULER_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , MODULE_TASK_HANDLE, MODULE_SCHEDULER_add_task, MODULE_SCHEDULER_HANDLE, handle, MODULE_TASK_RUN, run, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MODULE_SCHEDULER_notify, MODULE_TASK_HANDLE, task);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MODULE_SCHEDULER_remove_task, MODULE_TASK_HANDLE, task);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LINK_FILTER_HANDLE, LINK_FILTER_create, const char*, expression);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, LINK_FILTER_destroy, LINK_FILTER_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , bool, LINK_FILTER_matches, LINK_FILTER_HANDLE, handle, MESSAGE_HANDLE, message);
 
 // singlylinkedlist.h
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , SINGLYLINKEDLIST_HANDLE, singlylinkedlist_create);
@@ -618,6 +834,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const void*, singlylinkedlist_item_
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, STRING_delete, STRING_HANDLE, s)
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , STRING_HANDLE, STRING_construct, const char*, source)
 DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, STRING_concat, STRING_HANDLE, s1, const char*, s2)
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, STRING_concat_with_STRING, STRING_HANDLE, s1, STRING_HANDLE, s2)
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const char*, STRING_c_str, STRING_HANDLE, s)
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, STRING_length, STRING_HANDLE, s)
 
@@ -701,7 +918,25 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
         nn_socket_memory[l] = NULL;
     }
 
+    currentMESSAGE_RING_create_call = 0;
+    whenShallMESSAGE_RING_create_fail = 0;
+
+    currentMESSAGE_RING_push_call = 0;
+    whenShallMESSAGE_RING_push_fail = 0;
+
+    ring_pop_message = NULL;
+
+    currentMODULE_SCHEDULER_create_call = 0;
+    whenShallMODULE_SCHEDULER_create_fail = 0;
+
+    task_run_to_call = NULL;
+    task_run_context = NULL;
+
+    link_filter_matches = true;
+
     nn_current_msg_size = 0;
+    nn_recv_envelope_message = NULL;
+    nn_recv_envelope_count = 1;
 
     thread_func_to_call = NULL;
     thread_func_args = NULL;
@@ -710,6 +945,9 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.module = NULL;
     call_status_for_FakeModule_Receive.was_called = false;
+
+    FakeModule_ReceiveBatch_calls = 0;
+    FakeModule_ReceiveBatch_count = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -723,10 +961,10 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 //Tests_SRS_BROKER_13_001: [This API shall yield a BROKER_HANDLE representing the newly created message broker. This handle value shall not be equal to NULL when the API call is successful.]
 //Tests_SRS_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]
 //Tests_SRS_BROKER_13_023: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules_lock with a valid LOCK_HANDLE.]
-//Tests_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]
 //Tests_SRS_BROKER_17_002: [ Broker_Create shall create a unique id. ]
 //Tests_SRS_BROKER_17_003: [ Broker_Create shall initialize a url consisting of "inproc://" + unique id. ]
-//Tests_SRS_BROKER_17_004: [ Broker_Create shall bind the socket to the BROKER_HANDLE_DATA::url. ]
+//Tests_SRS_BROKER_17_062: [ Broker_Create shall initialize BROKER_HANDLE_DATA::routes with an empty routing snapshot. ]
+//Tests_SRS_BROKER_17_101: [ Broker_Create shall initialize BROKER_HANDLE_DATA::swap_lock with a valid LOCK_HANDLE and BROKER_HANDLE_DATA::readers_gone with a valid COND_HANDLE. ]
 TEST_FUNCTION(Broker_Create_succeeds)
 {
     ///arrange
@@ -736,18 +974,16 @@ TEST_FUNCTION(Broker_Create_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
     STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
     ///act
     auto r = Broker_Create();
 
@@ -759,39 +995,78 @@ TEST_FUNCTION(Broker_Create_succeeds)
     Broker_Destroy(r);
 }
 
-//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-/*Tests_SRS_BROKER_13_067: [ Broker_Create shall malloc a new instance of BROKER_HANDLE_DATA and return NULL if it fails. ]*/
-TEST_FUNCTION(Broker_Create_fails_when_malloc_fails)
+//Tests_SRS_BROKER_17_055: [ If config is NULL or config->engine is not a BROKER_ENGINE value, Broker_CreateWithConfig shall return NULL. ]
+TEST_FUNCTION(Broker_CreateWithConfig_fails_with_null_config)
 {
     ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r = Broker_CreateWithConfig(NULL);
 
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_055: [ If config is NULL or config->engine is not a BROKER_ENGINE value, Broker_CreateWithConfig shall return NULL. ]
+TEST_FUNCTION(Broker_CreateWithConfig_fails_with_unknown_engine)
+{
+    ///arrange
     CBrokerMocks mocks;
-    whenShallmalloc_fail = 1;
+    BROKER_CONFIG config = { (BROKER_ENGINE)42, 0 };
+
+    ///act
+    auto r = Broker_CreateWithConfig(&config);
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_056: [ Broker_CreateWithConfig shall create a broker using config->engine, and a queue capacity of config->queue_capacity or, on the ring and pool engines, 1024 if that is 0. ]
+TEST_FUNCTION(Broker_CreateWithConfig_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_CONFIG config = { BROKER_ENGINE_RING, 0 };
+
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
 
     ///act
-    auto r = Broker_Create();
+    auto r = Broker_CreateWithConfig(&config);
 
     ///assert
-    ASSERT_IS_NULL(r);
+    ASSERT_IS_NOT_NULL(r);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_Destroy(r);
 }
 
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_singlylinkedlist_create_fails)
+/*Tests_SRS_BROKER_13_067: [ Broker_Create shall malloc a new instance of BROKER_HANDLE_DATA and return NULL if it fails. ]*/
+TEST_FUNCTION(Broker_Create_fails_when_malloc_fails)
 {
     ///arrange
 
     CBrokerMocks mocks;
+    whenShallmalloc_fail = 1;
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    whenShallsinglylinkedlist_create_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
 
     ///act
     auto r = Broker_Create();
@@ -804,7 +1079,7 @@ TEST_FUNCTION(Broker_Create_fails_when_singlylinkedlist_create_fails)
 }
 
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
+TEST_FUNCTION(Broker_Create_fails_when_singlylinkedlist_create_fails)
 {
     ///arrange
 
@@ -813,11 +1088,8 @@ TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_create_fail = 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    whenShallLock_Init_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
 
     ///act
     auto r = Broker_Create();
@@ -829,13 +1101,12 @@ TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
     ///cleanup
 }
 
-
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
+TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
 {
     ///arrange
-    CBrokerMocks mocks;
 
+    CBrokerMocks mocks;
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
@@ -843,11 +1114,8 @@ TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallLock_Init_fail = 1;
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB))
-        .SetFailReturn(-1);
 
     ///act
     auto r = Broker_Create();
@@ -857,7 +1125,6 @@ TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_Destroy(r);
 }
 
 
@@ -877,9 +1144,6 @@ TEST_FUNCTION(Broker_Create_fails_when_uuid_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1)
         .SetFailReturn(UNIQUEID_ERROR);
@@ -912,9 +1176,6 @@ TEST_FUNCTION(Broker_Create_fails_when_url_create_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"))
@@ -932,7 +1193,8 @@ TEST_FUNCTION(Broker_Create_fails_when_url_create_fails)
     Broker_Destroy(r);
 }
 
-TEST_FUNCTION(Broker_Create_retries_nn_close_when_it_is_interrupted)
+//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -947,19 +1209,15 @@ TEST_FUNCTION(Broker_Create_retries_nn_close_when_it_is_interrupted)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno())
-        .SetFailReturn(EINTR);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"))
-        .SetFailReturn((STRING_HANDLE)NULL);
-
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(1);
 
     ///act
     auto r = Broker_Create();
@@ -973,7 +1231,7 @@ TEST_FUNCTION(Broker_Create_retries_nn_close_when_it_is_interrupted)
 }
 
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
+TEST_FUNCTION(Broker_Create_fails_when_routes_alloc_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -988,18 +1246,17 @@ TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(1);
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallmalloc_fail = 2;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
 
     ///act
     auto r = Broker_Create();
@@ -1009,11 +1266,10 @@ TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_Destroy(r);
 }
 
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
-TEST_FUNCTION(Broker_Create_fails_when_bind_fails)
+TEST_FUNCTION(Broker_Create_fails_when_swap_lock_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1028,23 +1284,21 @@ TEST_FUNCTION(Broker_Create_fails_when_bind_fails)
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallLock_Init_fail = 2;
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+
     ///act
     auto r = Broker_Create();
 
@@ -1053,7 +1307,6 @@ TEST_FUNCTION(Broker_Create_fails_when_bind_fails)
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_Destroy(r);
 }
 
 //Tests_SRS_BROKER_99_013: [ If broker or module is NULL the function shall return BROKER_INVALIDARG. ]
@@ -1292,7 +1545,7 @@ TEST_FUNCTION(Broker_AddModule_fails_string_construct_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_VECTOR_create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1317,9 +1570,8 @@ TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)))
+        .SetFailReturn((VECTOR_HANDLE)NULL);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1333,7 +1585,7 @@ TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
+TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1358,13 +1610,12 @@ TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallsinglylinkedlist_add_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1377,9 +1628,8 @@ TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
     Broker_Destroy(broker);
 }
 
-
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1404,16 +1654,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallsinglylinkedlist_add_fail = 1;
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB))
-        .SetFailReturn(-1);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1426,8 +1676,9 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
     Broker_Destroy(broker);
 }
 
+
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1452,6 +1703,9 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1460,18 +1714,20 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR))
+        .SetFailReturn(-1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
 
-    ///act
-    auto result = Broker_AddModule(broker, &fake_module);
-
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
@@ -1481,7 +1737,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_nn_bind_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1506,6 +1762,9 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1514,18 +1773,19 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4)
+    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
         .SetFailReturn(-1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
@@ -1542,7 +1802,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
 }
 
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_send_nn_socket_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -1554,10 +1814,76 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR))
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1567,6 +1893,9 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1575,18 +1904,98 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     whenShallThreadAPI_Create_fail = 1;
@@ -1604,19 +2013,19 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
     Broker_Destroy(broker);
 }
 
-
-
 //Tests_SRS_BROKER_13_107 : [The function shall assign the module handle to BROKER_MODULEINFO::module.]
-//Tests_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]
-//Tests_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]
+//Tests_SRS_BROKER_17_013: [ The function shall create a nanomsg NN_PAIR socket for reception. ]
+//Tests_SRS_BROKER_17_014: [ The function shall bind the reception socket to the module url. ]
 //Tests_SRS_BROKER_13_099: [ The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle. ]
 //Tests_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]
+//Tests_SRS_BROKER_17_044: [ The function shall initialize BROKER_MODULEINFO::sinks with a valid VECTOR_HANDLE. ]
+//Tests_SRS_BROKER_17_045: [ The function shall construct a module url consisting of BROKER_HANDLE_DATA::url + the quit signal GUID. ]
+//Tests_SRS_BROKER_17_046: [ The function shall create a nanomsg NN_PAIR socket for delivery and connect it to the module url. ]
 //Tests_SRS_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
 //Tests_SRS_BROKER_13_039 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BROKER_13_045 : [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-//Tests_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]
 TEST_FUNCTION(Broker_AddModule_succeeds)
 {
     ///arrange
@@ -1636,22 +2045,29 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
 
@@ -1672,11 +2088,10 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
 //Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]
 //Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]
 //Tests_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]
-//Tests_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]
+//Tests_SRS_BROKER_17_043: [ If the buffer received is a whole number of BROKER_MESSAGE_ENVELOPEs, the function shall copy the envelopes out of the buffer and deliver their messages in order. ]
 //Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
 //Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
 //Tests_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]
-//Tests_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]
 TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
 {
     CBrokerMocks mocks;
@@ -1690,6 +2105,7 @@ TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
     call_status_for_FakeModule_Receive.messageHandle = message;
 
     (void)Broker_AddModule(broker, &fake_module);
+    nn_recv_envelope_message = Message_Clone(message);
 
     mocks.ResetAllCalls();
 
@@ -1703,11 +2119,7 @@ TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
 
     //loop 2
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1730,6 +2142,7 @@ TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
     auto result = thread_func_to_call(thread_func_args);
 
     ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -1934,11 +2347,6 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetFailReturn("nn_send");
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //loop 2
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1969,8 +2377,8 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]
-TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
+//Tests_SRS_BROKER_17_018: [ If the buffer received is neither an envelope nor the quit signal, the message loop shall continue. ]
+TEST_FUNCTION(module_publish_worker_continue_on_unexpected_buffer)
 {
     CBrokerMocks mocks;
     auto broker = Broker_Create();
@@ -1993,13 +2401,10 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .SetReturn(5);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((MESSAGE_HANDLE)NULL);
 
     //loop 2
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -2067,13 +2472,18 @@ TEST_FUNCTION(Broker_RemoveModule_fails_with_null_module)
 //Tests_SRS_BROKER_13_050 : [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]
+//Tests_SRS_BROKER_17_051: [ Broker_RemoveModule shall remove the module from the sinks of every module in BROKER_HANDLE_DATA::modules. ]
+//Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the module's send_socket. ]
+//Tests_SRS_BROKER_17_048: [ This function shall destroy every message left undelivered on BROKER_MODULEINFO::receive_socket. ]
+//Tests_SRS_BROKER_17_049: [ This function shall close the BROKER_MODULEINFO::send_socket. ]
 //Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]
 //Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]
 //Tests_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]
 //Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
 //Tests_SRS_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
 //Tests_SRS_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+//Tests_SRS_BROKER_17_063: [ Broker_RemoveModule shall allocate a new routing snapshot before changing any link. ]
+//Tests_SRS_BROKER_17_064: [ Broker_RemoveModule shall swap in the new routing snapshot and wait until no Broker_Publish call still reads the previous one before stopping the module. ]
 TEST_FUNCTION(Broker_RemoveModule_succeeds)
 {
     ///arrange
@@ -2095,7 +2505,17 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2106,11 +2526,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2213,7 +2641,17 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetFailReturn(-1);
@@ -2222,11 +2660,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2269,13 +2715,23 @@ TEST_FUNCTION(Broker_RemoveModule_retries_nn_send_when_it_is_interrupted)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetFailReturn(-1);
     STRICT_EXPECTED_CALL(mocks, nn_errno())
         .SetFailReturn(EINTR);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2286,11 +2742,19 @@ TEST_FUNCTION(Broker_RemoveModule_retries_nn_send_when_it_is_interrupted)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2335,7 +2799,17 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2345,11 +2819,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
         .SetFailReturn(LOCK_ERROR);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2393,7 +2875,17 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2406,11 +2898,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
         .IgnoreArgument(1)
         .SetReturn(-1);
     STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2455,7 +2955,17 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2466,11 +2976,19 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG)) /*this is the send_socket*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2533,20 +3051,38 @@ TEST_FUNCTION(Broker_AddLink_null_link_fails)
 
 }
 
-//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
-TEST_FUNCTION(Broker_AddLink_null_source_fails)
+//Tests_SRS_BROKER_17_106: [ If broker, link, link->base.module_source_handle or link->base.module_sink_handle are NULL, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLinkEx_null_link_fails)
 {
     ///arrange
     CBrokerMocks mocks;
     BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
-    BROKER_LINK_DATA bld =
-    {
-        NULL,
-        fake_module_handle
-    };
 
     ///act
-    auto result = Broker_AddLink(broker, &bld);
+    auto result = Broker_AddLinkEx(broker, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+
+}
+
+//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLink_null_source_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    BROKER_LINK_DATA bld =
+    {
+        NULL,
+        fake_module_handle
+    };
+
+    ///act
+    auto result = Broker_AddLink(broker, &bld);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
@@ -2582,8 +3118,11 @@ TEST_FUNCTION(Broker_AddLink_null_sink_fails)
 //Tests_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall add the link->module_sink_handle module_info to the sinks of the link->module_source_handle module_info, unless it is already there. ]
 //Tests_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]
+//Tests_SRS_BROKER_17_065: [ Broker_AddLink shall allocate a new routing snapshot with room for the new link. ]
+//Tests_SRS_BROKER_17_066: [ Broker_AddLink shall fill the new routing snapshot from the sinks of every module and swap it in. ]
+//Tests_SRS_BROKER_17_105: [ Broker_AddLink shall add the link as Broker_AddLinkEx would, with no queue and no filter. ]
 TEST_FUNCTION(Broker_AddLink_succeeds)
 {
     ///arrange
@@ -2612,15 +3151,84 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the link*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
-        .IgnoreArgument(4);
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+
+    ///act
+    result = Broker_AddLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
 
+
+//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall add the link->module_sink_handle module_info to the sinks of the link->module_source_handle module_info, unless it is already there. ]
+TEST_FUNCTION(Broker_AddLink_succeeds_when_link_already_exists)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
     BROKER_LINK_DATA bld =
     {
         fake_module_handle,
         fake_module_handle
     };
+    result = Broker_AddLink(broker, &bld);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
     result = Broker_AddLink(broker, &bld);
@@ -2635,7 +3243,7 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
 }
 
 //Tests_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]
-TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
+TEST_FUNCTION(Broker_AddLink_fails_when_VECTOR_push_back_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2663,10 +3271,20 @@ TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the link*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the unused link*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the unused routing snapshot*/
+        .IgnoreArgument(1);
+    whenShallVECTOR_push_back_fail = currentVECTOR_push_back_call + 1;
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
-        .IgnoreArgument(4)
-        .SetFailReturn(-1);
+        .IgnoreArgument(2);
 
     BROKER_LINK_DATA bld =
     {
@@ -2799,6 +3417,139 @@ TEST_FUNCTION(Broker_AddLink_fails_lock_fails)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_070: [ If link->queue has a capacity and an unknown overflow policy, BROKER_OVERFLOW_CONFLATE without a conflate_key, or a capacity too large to allocate, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLinkEx_fails_with_unknown_overflow_policy)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    BROKER_LINK_QUEUE queue = { 4, (BROKER_OVERFLOW_POLICY)42, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+
+    ///act
+    auto result = Broker_AddLinkEx(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_070: [ If link->queue has a capacity and an unknown overflow policy, BROKER_OVERFLOW_CONFLATE without a conflate_key, or a capacity too large to allocate, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLinkEx_fails_with_conflate_and_no_key)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    BROKER_LINK_QUEUE queue = { 4, BROKER_OVERFLOW_CONFLATE, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+
+    ///act
+    auto result = Broker_AddLinkEx(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_079: [ Broker_AddLink shall create a BROKER_LINK for the sink, with a queue of link->queue->capacity messages if that is not 0. ]
+//Tests_SRS_BROKER_17_078: [ The first time a link with a queue is added to a sink, Broker_AddLinkEx shall create the sink's BROKER_MODULEINFO::inbound vector, its lock and its link_signal message. ]
+TEST_FUNCTION(Broker_AddLinkEx_with_queue_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the link*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(void*) * 4)); /*the link's slots*/
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*the link's lock*/
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*))); /*the sink's inbound links*/
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
+    STRICT_EXPECTED_CALL(mocks, Message_Create(IGNORED_PTR_ARG)) /*the sink's link_signal*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+
+    BROKER_LINK_QUEUE queue = { 4, BROKER_OVERFLOW_DROP_OLDEST, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+
+    ///act
+    result = Broker_AddLinkEx(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+
 //Tests_SRS_BROKER_17_035: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_RemoveLink shall return BROKER_INVALIDARG. ]
 TEST_FUNCTION(Broker_RemoveLink_null_broker_fails)
 {
@@ -2889,8 +3640,10 @@ TEST_FUNCTION(Broker_RemoveLink_null_sink_fails)
 //Tests_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall remove the link->module_sink_handle module_info from the sinks of the link->module_source_handle module_info. ]
 //Tests_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]
+//Tests_SRS_BROKER_17_067: [ Broker_RemoveLink shall allocate a new routing snapshot before removing the link. ]
+//Tests_SRS_BROKER_17_068: [ Broker_RemoveLink shall fill the new routing snapshot from the sinks of every module and swap it in. ]
 TEST_FUNCTION(Broker_RemoveLink_succeeds)
 {
     ///arrange
@@ -2926,10 +3679,25 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
-        .IgnoreArgument(4);
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired link*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -2944,7 +3712,8 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
 }
 
 //Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
-TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
+//Tests_SRS_BROKER_17_067: [ Broker_RemoveLink shall allocate a new routing snapshot before removing the link. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_when_routes_alloc_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2959,6 +3728,55 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
 
     mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_when_link_does_not_exist)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+
+    mocks.ResetAllCalls();
+
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -2979,10 +3797,8 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4)
-        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
     result = Broker_RemoveLink(broker, &bld);
@@ -3206,7 +4022,9 @@ TEST_FUNCTION(Broker_Destroy_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -3214,6 +4032,8 @@ TEST_FUNCTION(Broker_Destroy_works)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -3238,7 +4058,9 @@ TEST_FUNCTION(Broker_DecRef_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -3246,6 +4068,8 @@ TEST_FUNCTION(Broker_DecRef_works)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
@@ -3306,7 +4130,8 @@ TEST_FUNCTION(Broker_Publish_fails_with_null_source)
     ///cleanup
 }
 //Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
+//Tests_SRS_BROKER_17_012: [ If the envelope could not be sent, Broker_Publish shall destroy the clone and continue with the remaining sinks. ]
+TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3320,12 +4145,23 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
 
     auto result = Broker_AddModule(broker, &fake_module);
 
-    mocks.ResetAllCalls();
-
-    // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn((int)-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
@@ -3340,8 +4176,7 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
+TEST_FUNCTION(Broker_Publish_retries_when_send_is_interrupted)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3355,17 +4190,29 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
 
     auto result = Broker_AddModule(broker, &fake_module);
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn((int)-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno())
+        .SetFailReturn(EINTR);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn((int)-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0))
-        .SetFailReturn(-1);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
@@ -3380,8 +4227,8 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
+//Tests_SRS_BROKER_17_052: [ Broker_Publish shall find the route for source in the routing snapshot. ]
+TEST_FUNCTION(Broker_Publish_delivers_nothing_when_source_has_no_links)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3398,21 +4245,12 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
-        .SetFailReturn(nullptr);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(int, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -3421,8 +4259,8 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
+//Tests_SRS_BROKER_17_053: [ If source has no route, Broker_Publish shall deliver the message to no module and return BROKER_OK. ]
+TEST_FUNCTION(Broker_Publish_delivers_nothing_when_source_is_not_attached)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3436,152 +4274,1297 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
 
     auto result = Broker_AddModule(broker, &fake_module);
 
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    // Broker_Publish finds no route for an unattached source and calls nothing
+
+    ///act
+    result = Broker_Publish(broker, (MODULE_HANDLE)&fake, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_022: [ Broker_Publish shall acquire the current routing snapshot without taking a lock. ]
+//Tests_SRS_BROKER_17_052: [ Broker_Publish shall find the route for source in the routing snapshot. ]
+//Tests_SRS_BROKER_17_007: [ Broker_Publish shall clone the message once for every sink of source. ]
+//Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a BROKER_MESSAGE_ENVELOPE holding the clone on the sink's send_socket without blocking. ]
+//Tests_SRS_BROKER_17_023: [ Broker_Publish shall release the routing snapshot. ]
+//Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_Publish_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((int)-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno());
+        .IgnoreArgument(2);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Message_Destroy(message); /*the clone the sink's worker would have released*/
     Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-TEST_FUNCTION(Broker_Publish_retries_when_send_is_interrupted)
+//Tests_SRS_BROKER_17_080: [ If the link has a queue, Broker_Publish shall queue the clone on the link, apply the link's overflow policy, and return BROKER_OK for messages the policy discards. ]
+//Tests_SRS_BROKER_17_071: [ With BROKER_OVERFLOW_DROP_NEWEST, Broker_Publish shall discard the message when the link is full. ]
+//Tests_SRS_BROKER_17_076: [ After queuing on a link, Broker_Publish shall send BROKER_MODULEINFO::link_signal to the sink unless the sink has inbound links pending already. ]
+//Tests_SRS_BROKER_17_084: [ Broker_GetLinkDropCount shall store in dropped the number of messages the link has discarded or failed to deliver, and return BROKER_OK. ]
+TEST_FUNCTION(Broker_Publish_drops_newest_when_link_queue_is_full)
 {
     ///arrange
     CBrokerMocks mocks;
 
     auto broker = Broker_Create();
 
-    // create a message to send
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
     auto result = Broker_AddModule(broker, &fake_module);
 
+    BROKER_LINK_QUEUE queue = { 1, BROKER_OVERFLOW_DROP_NEWEST, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+    result = Broker_AddLinkEx(broker, &bld);
+
     mocks.ResetAllCalls();
 
-    // this is for Broker_Publish
+    // the first message is queued and the sink is signaled once
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    // the second one finds the link full
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((int)-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno())
-        .SetFailReturn(EINTR);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((int)-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno());
 
     ///act
-    result = Broker_Publish(broker, fake_module_handle, message);
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
+    size_t dropped = 0;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, Broker_GetLinkDropCount(broker, &bld.base, &dropped), BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 1, dropped);
+
     ///cleanup
-    Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
+    Message_Destroy(message);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]
-//Tests_SRS_BROKER_17_007: [Broker_Publish shall clone the message.]
-//Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]
-//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]
-//Tests_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]
-//Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]
-//Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]
-//Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]
-//Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]
-//Tests_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]
-//Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_succeeds)
+//Tests_SRS_BROKER_17_103: [ Broker_Publish shall take a reference on every link with BROKER_OVERFLOW_BLOCK and queue on it only after releasing the routing snapshot, then release the reference. ]
+TEST_FUNCTION(Broker_Publish_queues_on_blocking_link_after_releasing_the_snapshot)
 {
     ///arrange
     CBrokerMocks mocks;
 
     auto broker = Broker_Create();
 
-    // create a message to send
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
 
     auto result = Broker_AddModule(broker, &fake_module);
 
+    BROKER_LINK_QUEUE queue = { 1, BROKER_OVERFLOW_BLOCK, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+    result = Broker_AddLinkEx(broker, &bld);
+
     mocks.ResetAllCalls();
 
-    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(void*))); /*the links to publish to later*/
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Message_Destroy(message);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_097: [ If link->filter is not NULL, Broker_AddLinkEx shall compile it with LINK_FILTER_create before locking, and return BROKER_INVALIDARG if that fails. ]
+TEST_FUNCTION(Broker_AddLinkEx_fails_with_invalid_filter)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        NULL,
+        "properties.source =="
+    };
+
+    mocks.ResetAllCalls();
 
+    STRICT_EXPECTED_CALL(mocks, LINK_FILTER_create("properties.source =="))
+        .SetReturn((LINK_FILTER_HANDLE)NULL);
 
     ///act
-    result = Broker_Publish(broker, fake_module_handle, message);
+    result = Broker_AddLinkEx(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_099: [ If no BROKER_LINK took the compiled filter, Broker_AddLinkEx shall destroy it. ]
+TEST_FUNCTION(Broker_AddLinkEx_destroys_filter_when_link_already_exists)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        NULL,
+        "properties.source"
+    };
+    result = Broker_AddLinkEx(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, LINK_FILTER_create("properties.source"));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, LINK_FILTER_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_AddLinkEx(broker, &bld);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_098: [ The BROKER_LINK shall own the compiled filter and destroy it when the link is destroyed. ]
+//Tests_SRS_BROKER_17_100: [ If the link has a filter, Broker_Publish shall deliver only messages that LINK_FILTER_matches accepts to its sink, without counting the others as dropped. ]
+TEST_FUNCTION(Broker_Publish_skips_sink_whose_filter_does_not_match)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        NULL,
+        "properties.source == \"ble\""
+    };
+    result = Broker_AddLinkEx(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // the first message matches and is delivered, the second one is not
+    STRICT_EXPECTED_CALL(mocks, LINK_FILTER_matches(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, LINK_FILTER_matches(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1)
+        .SetReturn(false);
+
+    ///act
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    size_t dropped = 1;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, Broker_GetLinkDropCount(broker, &bld.base, &dropped), BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, dropped);
+
+    ///cleanup
+    Message_Destroy(message); /*the clone the sink's worker would have released*/
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_081: [ If broker, link, link->module_source_handle, link->module_sink_handle or dropped are NULL, Broker_GetLinkDropCount shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_GetLinkDropCount_fails_with_null_dropped)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+
+    ///act
+    auto result = Broker_GetLinkDropCount(broker, &bld, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_082: [ Broker_GetLinkDropCount shall lock the modules_lock while it looks for the link. ]
+//Tests_SRS_BROKER_17_083: [ Broker_GetLinkDropCount shall return BROKER_ERROR if the link does not exist. ]
+TEST_FUNCTION(Broker_GetLinkDropCount_fails_when_link_does_not_exist)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    size_t dropped;
+
+    ///act
+    result = Broker_GetLinkDropCount(broker, &bld, &dropped);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+static BROKER_HANDLE create_ring_broker()
+{
+    BROKER_CONFIG config = { BROKER_ENGINE_RING, 0 };
+    return Broker_CreateWithConfig(&config);
+}
+
+//Tests_SRS_BROKER_17_058: [ On the ring engine, the function shall create BROKER_MODULEINFO::ring with BROKER_HANDLE_DATA::queue_capacity instead of any socket. ]
+//Tests_SRS_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
+TEST_FUNCTION(Broker_AddModule_ring_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_ring_broker();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_create(1024));
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_ring_engine_fails_when_MESSAGE_RING_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_ring_broker();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    whenShallMESSAGE_RING_create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_create(1024));
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_057: [ On the ring engine, the function shall pop messages from BROKER_MODULEINFO::ring until MESSAGE_RING_pop returns NULL. ]
+//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
+TEST_FUNCTION(ring_module_worker_calls_receive_once_then_exits_when_ring_closes)
+{
+    CBrokerMocks mocks;
+    auto broker = create_ring_broker();
+
+    // setup fake module's validation data
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    ring_pop_message = Message_Clone(message);
+
+    mocks.ResetAllCalls();
+
+    //loop 1
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    //loop 2, the ring has been closed
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_059: [ On the ring engine, this function shall close BROKER_MODULEINFO::ring to stop the worker thread. ]
+//Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
+//Tests_SRS_BROKER_17_060: [ On the ring engine, this function shall destroy BROKER_MODULEINFO::ring along with every message left undelivered. ]
+TEST_FUNCTION(Broker_RemoveModule_ring_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_ring_broker();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_close(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_061: [ On the ring engine, Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::ring. ]
+//Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_Publish_ring_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = create_ring_broker();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message); /*the clone the sink's worker would have released*/
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_012: [ If the envelope could not be sent, Broker_Publish shall destroy the clone and continue with the remaining sinks. ]
+TEST_FUNCTION(Broker_Publish_ring_engine_fails_when_push_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = create_ring_broker();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    whenShallMESSAGE_RING_push_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+static BROKER_HANDLE create_pool_broker()
+{
+    BROKER_CONFIG config = { BROKER_ENGINE_POOL, 0, 3 };
+    return Broker_CreateWithConfig(&config);
+}
+
+//Tests_SRS_BROKER_17_085: [ On the pool engine, Broker_CreateWithConfig shall create a module scheduler with config->worker_count workers. ]
+TEST_FUNCTION(Broker_CreateWithConfig_pool_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_CONFIG config = { BROKER_ENGINE_POOL, 0, 3 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_create(3));
+
+    ///act
+    auto r = Broker_CreateWithConfig(&config);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(r);
+}
+
+//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_CreateWithConfig_pool_engine_fails_when_scheduler_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_CONFIG config = { BROKER_ENGINE_POOL, 0, 0 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
+    STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    whenShallMODULE_SCHEDULER_create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_create(0));
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*the structure*/
+        .IgnoreArgument(1);
+
+    ///act
+    auto r = Broker_CreateWithConfig(&config);
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_104: [ On the pool engine, the function shall create BROKER_MODULEINFO::ring with BROKER_HANDLE_DATA::queue_capacity, which its task drains, instead of any socket. ]
+//Tests_SRS_BROKER_17_088: [ On the pool engine, the function shall add a pool_module_run task for the module to BROKER_HANDLE_DATA::scheduler instead of starting a thread. ]
+TEST_FUNCTION(Broker_AddModule_pool_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(void*)));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_create(1024));
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_add_task(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_NOT_NULL((void*)task_run_to_call);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_087: [ On the pool engine, the module's task shall deliver at most budget messages popped from BROKER_MODULEINFO::ring with MESSAGE_RING_try_pop, and report whether it used the whole budget. ]
+//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
+TEST_FUNCTION(pool_module_task_delivers_until_ring_is_empty)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    ring_pop_message = Message_Clone(message);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    bool more = task_run_to_call(task_run_context, 32);
+
+    ///assert
+    ASSERT_IS_FALSE(more);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_087: [ On the pool engine, the module's task shall deliver at most budget messages popped from BROKER_MODULEINFO::ring with MESSAGE_RING_try_pop, and report whether it used the whole budget. ]
+TEST_FUNCTION(pool_module_task_stops_at_budget)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    ring_pop_message = Message_Clone(message);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    ///act
+    bool more = task_run_to_call(task_run_context, 1);
+
+    ///assert
+    ASSERT_IS_TRUE(more);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_089: [ On the pool engine, this function shall close BROKER_MODULEINFO::ring, wait for the module's task to finish with MODULE_SCHEDULER_remove_task, then destroy the ring along with every message left undelivered. ]
+TEST_FUNCTION(Broker_RemoveModule_pool_engine_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG)) /*routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is the retired routing snapshot*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_close(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_remove_task(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_086: [ On the pool engine, Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::ring and notify the sink's task. ]
+TEST_FUNCTION(Broker_Publish_pool_engine_notifies_sink_task)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = create_pool_broker();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_notify(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message); /*the clone the sink's task would have released*/
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_090: [ On the pool engine, if link->queue has a capacity and BROKER_OVERFLOW_BLOCK, Broker_AddLinkEx shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLinkEx_pool_engine_fails_with_blocking_queue)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    BROKER_LINK_QUEUE queue = { 4, BROKER_OVERFLOW_BLOCK, NULL };
+    BROKER_LINK_DATA_EX bld =
+    {
+        { fake_module_handle, fake_module_handle },
+        &queue,
+        NULL
+    };
+
+    ///act
+    result = Broker_AddLinkEx(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_092: [ If broker, source or messages is NULL, or any of the count messages is NULL, Broker_PublishBatch shall return BROKER_INVALIDARG without publishing any message. ]
+TEST_FUNCTION(Broker_PublishBatch_fails_with_null_params)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    MESSAGE_HANDLE messages[1] = { message };
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_PublishBatch(NULL, fake_module_handle, messages, 1);
+    auto result2 = Broker_PublishBatch(broker, NULL, messages, 1);
+    auto result3 = Broker_PublishBatch(broker, fake_module_handle, NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result3, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_092: [ If broker, source or messages is NULL, or any of the count messages is NULL, Broker_PublishBatch shall return BROKER_INVALIDARG without publishing any message. ]
+TEST_FUNCTION(Broker_PublishBatch_fails_with_null_message_in_batch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    MESSAGE_HANDLE messages[2] = { message, NULL };
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+    mocks.ResetAllCalls();
+
+    ///act
+    result = Broker_PublishBatch(broker, fake_module_handle, messages, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_096: [ Otherwise Broker_PublishBatch shall deliver every message as Broker_Publish would, in order, reading the routing snapshot once. ]
+//Tests_SRS_BROKER_17_093: [ On the nanomsg engine, Broker_PublishBatch shall send each sink the envelopes of up to 32 clones in a single buffer. ]
+TEST_FUNCTION(Broker_PublishBatch_sends_one_buffer_per_sink)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    MESSAGE_HANDLE messages[2] = { message, message };
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 2 * sizeof(void*), NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    result = Broker_PublishBatch(broker, fake_module_handle, messages, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message); /*the clones the sink's worker would have released*/
+    Message_Destroy(message);
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_096: [ Otherwise Broker_PublishBatch shall deliver every message as Broker_Publish would, in order, reading the routing snapshot once. ]
+//Tests_SRS_BROKER_17_086: [ On the pool engine, Broker_Publish shall push the clone onto the sink's BROKER_MODULEINFO::ring and notify the sink's task. ]
+TEST_FUNCTION(Broker_PublishBatch_pool_engine_notifies_sink_task_once)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    MESSAGE_HANDLE messages[2] = { message, message };
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MODULE_SCHEDULER_notify(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_PublishBatch(broker, fake_module_handle, messages, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message); /*the clones the sink's task would have released*/
+    Message_Destroy(message);
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_043: [ If the buffer received is a whole number of BROKER_MESSAGE_ENVELOPEs, the function shall copy the envelopes out of the buffer and deliver their messages in order. ]
+//Tests_SRS_BROKER_17_094: [ If the module's API is MODULE_API_VERSION_2 or later and has a Module_ReceiveBatch function, the function shall hand it every message it took at once, in order. ]
+TEST_FUNCTION(module_publish_worker_hands_envelopes_to_receive_batch)
+{
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module_2.module_handle;
+
+    (void)Broker_AddModule(broker, &fake_module_2);
+    nn_recv_envelope_message = Message_Clone(message);
+    (void)Message_Clone(message);
+    nn_recv_envelope_count = 2;
+
+    mocks.ResetAllCalls();
+
+    //loop 1
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(37);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("nn_recv");
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_ReceiveBatch_calls);
+    ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveBatch_count);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module_2);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+//Tests_SRS_BROKER_17_087: [ On the pool engine, the module's task shall deliver at most budget messages popped from BROKER_MODULEINFO::ring with MESSAGE_RING_try_pop, and report whether it used the whole budget. ]
+TEST_FUNCTION(pool_module_task_falls_back_to_receive_without_receive_batch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = create_pool_broker();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    ring_pop_message = Message_Clone(message);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MESSAGE_RING_try_pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+
+    ///act
+    bool more = task_run_to_call(task_run_context, 32);
+
+    ///assert
+    ASSERT_IS_FALSE(more);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_ReceiveBatch_calls);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
 
 END_TEST_SUITE(broker_ut)
@@ -223,6 +223,7 @@ BEGIN_TEST_SUITE(gateway_e2e)
         ///act
         m6GatewayProperties.gateway_modules = gatewayProps;
         m6GatewayProperties.gateway_links = gatewayLinks; 
+        m6GatewayProperties.broker_config = NULL;
         e2eGatewayInstance = Gateway_Create(&m6GatewayProperties);
         auto start_result = Gateway_Start(e2eGatewayInstance);
 
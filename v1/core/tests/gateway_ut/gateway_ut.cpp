@@ -60,6 +60,7 @@ static size_t currentBroker_RemoveModule_call;
 static size_t whenShallBroker_RemoveModule_fail;
 static size_t currentBroker_Create_call;
 static size_t whenShallBroker_Create_fail;
+static const BROKER_CONFIG* lastBroker_config;
 static size_t currentBroker_module_count;
 static size_t currentBroker_ref_count;
 
@@ -132,6 +133,12 @@ public:
     }
     MOCK_METHOD_END(BROKER_HANDLE, result1);
 
+    MOCK_STATIC_METHOD_1(, BROKER_HANDLE, Broker_CreateWithConfig, const BROKER_CONFIG*, config)
+        lastBroker_config = config;
+        ++currentBroker_ref_count;
+        BROKER_HANDLE result1 = (BROKER_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+    MOCK_METHOD_END(BROKER_HANDLE, result1);
+
     MOCK_STATIC_METHOD_1(, void, Broker_Destroy, BROKER_HANDLE, broker)
         if (currentBroker_ref_count > 0)
         {
@@ -166,7 +173,7 @@ public:
         }
     MOCK_METHOD_END(BROKER_RESULT, result1);
 
-    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLinkEx, BROKER_HANDLE, handle, const BROKER_LINK_DATA_EX*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
@@ -340,10 +347,11 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void, mock_Module_Receive, MODUL
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, mock_Module_Start, MODULE_HANDLE, moduleHandle);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , BROKER_HANDLE, Broker_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , BROKER_HANDLE, Broker_CreateWithConfig, const BROKER_CONFIG*, config);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_Destroy, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
-DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLinkEx, BROKER_HANDLE, handle, const BROKER_LINK_DATA_EX*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_IncRef, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_DecRef, BROKER_HANDLE, broker);
@@ -513,6 +521,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     dummyProps = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
     dummyProps->gateway_modules = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     dummyProps->gateway_links = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    dummyProps->broker_config = NULL;
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry, 1);
 }
 
@@ -570,6 +579,41 @@ TEST_FUNCTION(Gateway_Create_Creates_Handle_Success)
     Gateway_Destroy(gateway);
 }
 
+/*Tests_SRS_GATEWAY_17_027: [ If properties->broker_config is not NULL, this function shall create the broker with Broker_CreateWithConfig. ]*/
+TEST_FUNCTION(Gateway_Create_uses_broker_config_Success)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    BROKER_CONFIG config = { BROKER_ENGINE_POOL, 0, 2 };
+    GATEWAY_PROPERTIES props;
+    props.gateway_modules = NULL;
+    props.gateway_links = NULL;
+    props.broker_config = &config;
+    lastBroker_config = NULL;
+
+    //Expectations
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_Initialize());
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Broker_CreateWithConfig(&config));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    expectEventSystemInit(mocks);
+
+    //Act
+    GATEWAY_HANDLE gateway = Gateway_Create(&props);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(gateway);
+    ASSERT_ARE_EQUAL(int, (int)BROKER_ENGINE_POOL, (int)lastBroker_config->engine);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
 /*Tests_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's loader_configuration or loader_api is NULL the function shall return NULL. ]*/
 /*Tests_SRS_GATEWAY_17_017: [ This function shall destroy the default module loaders upon any failure. ]*/
 /*Tests_SRS_GATEWAY_27_027: [ Launch - This function shall join any spawned threads upon any failure. ]*/
@@ -602,6 +646,7 @@ TEST_FUNCTION(Gateway_Create_returns_null_on_bad_module_api_entry)
     ASSERT_IS_NOT_NULL(newdummyProps.gateway_modules);
     BASEIMPLEMENTATION::VECTOR_push_back(newdummyProps.gateway_modules, &dummyEntry2, 1);
     newdummyProps.gateway_links = NULL;
+    newdummyProps.broker_config = NULL;
 
 
     //Expectations
@@ -1453,7 +1498,7 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
         .IgnoreAllArguments(); //Check if Source Module exists.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments(); //Check if Sink Module exists.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
@@ -3224,7 +3269,7 @@ TEST_FUNCTION(Gateway_AddLink_Succeeds)
         .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
@@ -3244,6 +3289,89 @@ TEST_FUNCTION(Gateway_AddLink_Succeeds)
     Gateway_Destroy(gateway);
 }
 
+/*Tests_SRS_GATEWAY_17_026: [ If gw, entryLink, entryLink->base.module_source or entryLink->base.module_sink is NULL, Gateway_AddLinkEx shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
+TEST_FUNCTION(Gateway_AddLinkEx_with_Null_Link_Fail)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_LINK_ENTRY_EX dummyLink = {
+        { NULL, "dummy module2" }
+    };
+
+    mocks.ResetAllCalls();
+
+    //Act
+    GATEWAY_ADD_LINK_RESULT result1 = Gateway_AddLinkEx(gw, NULL);
+    GATEWAY_ADD_LINK_RESULT result2 = Gateway_AddLinkEx(gw, &dummyLink);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_INVALID_ARG, result2);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_023: [ The gateway shall create the link on the broker with the queue of the entryLink, and keep its own copy of the queue. ]*/
+/*Tests_SRS_GATEWAY_17_024: [ The gateway shall create the link on the broker with the filter of the entryLink, and keep its own copy of the filter. ]*/
+TEST_FUNCTION(Gateway_AddLinkEx_Succeeds_with_queue_and_filter)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    //Add another entry to the properties
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+		dummyLoaderInfo,
+        NULL
+    };
+
+    GATEWAY_LINK_ENTRY_EX dummyLink = {
+        { "dummy module", "dummy module 2" },
+        { 4, BROKER_OVERFLOW_CONFLATE, "deviceId" },
+        "temperature > 20"
+    };
+
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+
+    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Act
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Source Module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "deviceId"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "temperature > 20"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLinkEx(gateway, &dummyLink);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
 TEST_FUNCTION(Gateway_AddLink_pushback_fails)
 {
     //Arrange
@@ -3273,7 +3401,7 @@ TEST_FUNCTION(Gateway_AddLink_pushback_fails)
         .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
@@ -3321,7 +3449,7 @@ TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
         .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
@@ -3385,9 +3513,9 @@ TEST_FUNCTION(Gateway_AddLink_star_2nd_addbroker_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
@@ -3551,14 +3679,14 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_with_star_links)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     // 2nd broadcast link
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
@@ -3647,14 +3775,14 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_addLink_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     // 2nd broadcast link
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
@@ -3775,7 +3903,7 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_find_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     // 2nd broadcast link
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
@@ -3882,11 +4010,11 @@ TEST_FUNCTION(Gateway_AddLink_star_success)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
@@ -4008,7 +4136,7 @@ TEST_FUNCTION(Gateway_AddLink_star_failure_to_add)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
@@ -4457,6 +4585,7 @@ TEST_FUNCTION(Gateway_GetModuleList_Links_basic_tree)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4527,6 +4656,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_cycle)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4586,6 +4716,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_to_itself)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4665,6 +4796,7 @@ TEST_FUNCTION(Gateway_GetModuleList_links_star)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4713,6 +4845,7 @@ TEST_FUNCTION(Gateway_GetModuleList_calloc_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4762,6 +4895,7 @@ TEST_FUNCTION(Gateway_modules_sources_vector_create_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4818,6 +4952,7 @@ TEST_FUNCTION(Gateway_GetModuleList_link_push_back_fail)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4888,6 +5023,7 @@ TEST_FUNCTION(Gateway_DestroyModuleList_basic)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, module_entries, module_count);
     VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -5089,6 +5225,7 @@ TEST_FUNCTION(Gateway_RemoveModule_removes_links)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, modules, 3);
     VECTOR_push_back(props.gateway_links, links, 3);
 
@@ -5153,7 +5290,7 @@ TEST_FUNCTION(Gateway_AddLink_no_report_on_fail)
     };
 
     // Expect
-    EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    EXPECTED_CALL(mocks, Broker_AddLinkEx(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
@@ -5214,6 +5351,7 @@ TEST_FUNCTION(Gateway_AddModule_name_is_copied)
     GATEWAY_PROPERTIES props;
     props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
     props.gateway_links = NULL;
+    props.broker_config = NULL;
     VECTOR_push_back(props.gateway_modules, &module, 1);
 
     // Act
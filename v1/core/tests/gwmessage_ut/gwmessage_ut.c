@@ -20,14 +20,33 @@ static TEST_MUTEX_HANDLE g_testByTest;
 
 #include "message.h"
 
+#define ENABLE_MOCKS
+#include "message_properties.h"
+#include "mapped_file.h"
+#undef ENABLE_MOCKS
+
 static size_t currentmalloc_call;
 static size_t whenShallmalloc_fail;
 
-static size_t currentConstMap_Create_call;
-static size_t whenShallConstMap_Create_fail;
+static size_t currentMESSAGE_PROPERTIES_create_call;
+static size_t whenShallMESSAGE_PROPERTIES_create_fail;
+
+static size_t currentMESSAGE_PROPERTIES_create_borrowed_call;
+static size_t whenShallMESSAGE_PROPERTIES_create_borrowed_fail;
 
-static size_t currentConstMap_Clone_call;
-static size_t whenShallConstMap_Clone_fail;
+static size_t currentMESSAGE_PROPERTIES_create_borrowed_v2_call;
+static size_t whenShallMESSAGE_PROPERTIES_create_borrowed_v2_fail;
+
+static size_t currentMESSAGE_PROPERTIES_create_borrowed_v3_call;
+static size_t whenShallMESSAGE_PROPERTIES_create_borrowed_v3_fail;
+
+static size_t currentMESSAGE_PROPERTIES_create_typed_call;
+static size_t whenShallMESSAGE_PROPERTIES_create_typed_fail;
+static size_t currentMESSAGE_PROPERTIES_derive_call;
+static size_t whenShallMESSAGE_PROPERTIES_derive_fail;
+
+static size_t currentMESSAGE_PROPERTIES_clone_call;
+static size_t whenShallMESSAGE_PROPERTIES_clone_fail;
 
 static size_t currentCONSTBUFFER_Create_call;
 static size_t whenShallCONSTBUFFER_Create_fail;
@@ -36,7 +55,7 @@ static size_t currentCONSTBUFFER_refCount;
 static size_t currentCONSTBUFFER_Clone_call;
 static size_t whenShallCONSTBUFFER_Clone_fail;
 
-static void* my_gballoc_malloc(size_t size)
+static void* my_MESSAGE_POOL_alloc(size_t size)
 {
     void* result;
     currentmalloc_call++;
@@ -59,34 +78,132 @@ static void* my_gballoc_malloc(size_t size)
 }
 
 
-static void my_gballoc_free(void* ptr)
+static void my_MESSAGE_POOL_free(void* ptr)
 {
     free(ptr);
 }
 
-static CONSTMAP_HANDLE my_ConstMap_Create(MAP_HANDLE sourceMap)
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_create(MAP_HANDLE map)
+{
+    (void)map;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_create_call++;
+    if (whenShallMESSAGE_PROPERTIES_create_fail == currentMESSAGE_PROPERTIES_create_call)
+    {
+        result2 = NULL;
+    }
+    else
+    {
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
+        *(unsigned char*)result2 = 1;
+    }
+    return result2;
+}
+
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_create_borrowed(const char* pairs, size_t count)
+{
+    (void)pairs;
+    (void)count;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_create_borrowed_call++;
+    if (whenShallMESSAGE_PROPERTIES_create_borrowed_fail == currentMESSAGE_PROPERTIES_create_borrowed_call)
+    {
+        result2 = NULL;
+    }
+    else
+    {
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
+        *(unsigned char*)result2 = 1;
+    }
+    return result2;
+}
+
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_create_borrowed_v2(const unsigned char* encoded, size_t count)
+{
+    (void)encoded;
+    (void)count;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_create_borrowed_v2_call++;
+    if (whenShallMESSAGE_PROPERTIES_create_borrowed_v2_fail == currentMESSAGE_PROPERTIES_create_borrowed_v2_call)
+    {
+        result2 = NULL;
+    }
+    else
+    {
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
+        *(unsigned char*)result2 = 1;
+    }
+    return result2;
+}
+
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_create_borrowed_v3(const unsigned char* encoded, size_t count)
+{
+    (void)encoded;
+    (void)count;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_create_borrowed_v3_call++;
+    if (whenShallMESSAGE_PROPERTIES_create_borrowed_v3_fail == currentMESSAGE_PROPERTIES_create_borrowed_v3_call)
+    {
+        result2 = NULL;
+    }
+    else
+    {
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
+        *(unsigned char*)result2 = 1;
+    }
+    return result2;
+}
+
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_create_typed(const MESSAGE_TYPED_PROPERTY* properties, size_t count)
 {
-    (void)sourceMap;
-    CONSTMAP_HANDLE result2;
+    (void)properties;
+    (void)count;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_create_typed_call++;
+    if (whenShallMESSAGE_PROPERTIES_create_typed_fail == currentMESSAGE_PROPERTIES_create_typed_call)
+    {
+        result2 = NULL;
+    }
+    else
+    {
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
+        *(unsigned char*)result2 = 1;
+    }
+    return result2;
+}
 
-    currentConstMap_Create_call++;
-    if (whenShallConstMap_Create_fail == currentConstMap_Create_call)
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_derive(MESSAGE_PROPERTIES_HANDLE parent, const MESSAGE_PROPERTY_UPDATE* adds, size_t add_count, const char* const* removes, size_t remove_count)
+{
+    (void)parent;
+    (void)adds;
+    (void)add_count;
+    (void)removes;
+    (void)remove_count;
+    MESSAGE_PROPERTIES_HANDLE result2;
+
+    currentMESSAGE_PROPERTIES_derive_call++;
+    if (whenShallMESSAGE_PROPERTIES_derive_fail == currentMESSAGE_PROPERTIES_derive_call)
     {
         result2 = NULL;
     }
     else
     {
-        result2 = (CONSTMAP_HANDLE)malloc(1);
+        result2 = (MESSAGE_PROPERTIES_HANDLE)malloc(1);
         *(unsigned char*)result2 = 1;
     }
     return result2;
 }
 
-static CONSTMAP_HANDLE my_ConstMap_Clone(CONSTMAP_HANDLE handle)
+static MESSAGE_PROPERTIES_HANDLE my_MESSAGE_PROPERTIES_clone(MESSAGE_PROPERTIES_HANDLE handle)
 {
-    CONSTMAP_HANDLE result3;
-    currentConstMap_Clone_call++;
-    if (whenShallConstMap_Clone_fail == currentConstMap_Clone_call)
+    MESSAGE_PROPERTIES_HANDLE result3;
+    currentMESSAGE_PROPERTIES_clone_call++;
+    if (whenShallMESSAGE_PROPERTIES_clone_fail == currentMESSAGE_PROPERTIES_clone_call)
     {
         result3 = NULL;
     }
@@ -98,6 +215,21 @@ static CONSTMAP_HANDLE my_ConstMap_Clone(CONSTMAP_HANDLE handle)
     return result3;
 }
 
+static void my_MESSAGE_PROPERTIES_destroy(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    unsigned char refCount = --(*(unsigned char*)handle);
+    if (refCount == 0)
+        free(handle);
+}
+
+static CONSTMAP_HANDLE my_MESSAGE_PROPERTIES_get_constmap(MESSAGE_PROPERTIES_HANDLE handle)
+{
+    (void)handle;
+    CONSTMAP_HANDLE result4 = (CONSTMAP_HANDLE)malloc(1);
+    *(unsigned char*)result4 = 1;
+    return result4;
+}
+
 static void my_ConstMap_Destroy(CONSTMAP_HANDLE map)
 {
     unsigned char refCount = --(*(unsigned char*)map);
@@ -169,13 +301,23 @@ static void my_CONSTBUFFER_Destroy(CONSTBUFFER_HANDLE constbufferHandle)
 }
 
 #define ENABLE_MOCKS
-#include "azure_c_shared_utility/gballoc.h"
+#include "message_pool.h"
 #undef ENABLE_MOCKS
 
 #ifdef _MSC_VER
 #pragma warning(disable:4505)
 #endif
 
+/*counts the calls Message_Destroy makes to release an owned byte array*/
+static size_t releaseCalls;
+static void* releaseContext;
+
+static void test_release(void* context)
+{
+    releaseCalls++;
+    releaseContext = context;
+}
+
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
     (void)error_code;
@@ -271,6 +413,73 @@ static const unsigned char notFail__2Property_2bytes[] =
     '3', '4'
 };
 
+/*version 2 of the format, as Message_ToByteArray writes it*/
+
+static const unsigned char notFail____minimalMessage_v2[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x82,                   /*version 2*/
+    0x00, 0x00, 0x00, 9,    /*size of this array*/
+    0x00,                   /*zero properties*/
+    0x00                    /*zero message content size*/
+};
+
+static const unsigned char notFail__2Property_2bytes_v2[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x82,                   /*version 2*/
+    0x00, 0x00, 0x00, 63,   /*size of this array*/
+    0x02,                   /*two properties*/
+    24, 'B','l','e','e','d','i','n','g','E','d','g','e','\0', 5, 'r','o','c','k','s','\0',
+    40, 'A', 'z','u','r','e',' ','I','o','T',' ','G','a','t','e','w','a','y',' ','i','s','\0', 7, 'a','w','e','s','o','m','e','\0',
+    0x02,                   /*2 message content size*/
+    '3', '4'
+};
+
+static const unsigned char notFail__internedProperty_1bytes_v2[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x82,                   /*version 2*/
+    0x00, 0x00, 0x00, 16,   /*size of this array*/
+    0x01,                   /*one property*/
+    0x01, 3, 'b','l','e','\0', /*"source", interned*/
+    0x01,                   /*1 message content size*/
+    '3'
+};
+
+/*version 3 of the format, for properties that are not strings*/
+
+static const unsigned char notFail__typedProperty_1bytes_v3[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x83,                   /*version 3*/
+    0x00, 0x00, 0x00, 20,   /*size of this array*/
+    0x01,                   /*one property*/
+    0x0D, MESSAGE_PROPERTY_TYPE_INT64, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF4, /*"bleControllerIndex", interned, -12*/
+    0x01,                   /*1 message content size*/
+    '3'
+};
+
+static const unsigned char fail_unknownPropertyType_v3[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x83,                   /*version 3*/
+    0x00, 0x00, 0x00, 20,   /*size of this array*/
+    0x01,                   /*one property*/
+    0x0D, MESSAGE_PROPERTY_TYPE_COUNT, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF4,
+    0x01,                   /*1 message content size*/
+    '3'
+};
+
+static const unsigned char fail_truncatedPropertyValue_v3[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x83,                   /*version 3*/
+    0x00, 0x00, 0x00, 14,   /*size of this array*/
+    0x01,                   /*one property*/
+    0x0D, MESSAGE_PROPERTY_TYPE_DOUBLE, 0x40, 0x35, 0x80, 0x00 /*half a double, and no content size*/
+};
+
 static const unsigned char fail_____firstByteNot0xA1[] =
 {
     0xA2, 0x60,             /*header - wrong*/
@@ -354,11 +563,18 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         int result = umocktypes_charptr_register_types();
         ASSERT_ARE_EQUAL(int, 0, result);
 
-        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
-        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
-
-        REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Create, my_ConstMap_Create);
-        REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Clone, my_ConstMap_Clone);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_POOL_alloc, my_MESSAGE_POOL_alloc);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_POOL_free, my_MESSAGE_POOL_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_create, my_MESSAGE_PROPERTIES_create);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_create_borrowed, my_MESSAGE_PROPERTIES_create_borrowed);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_create_borrowed_v2, my_MESSAGE_PROPERTIES_create_borrowed_v2);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_create_borrowed_v3, my_MESSAGE_PROPERTIES_create_borrowed_v3);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_create_typed, my_MESSAGE_PROPERTIES_create_typed);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_derive, my_MESSAGE_PROPERTIES_derive);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_clone, my_MESSAGE_PROPERTIES_clone);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_destroy, my_MESSAGE_PROPERTIES_destroy);
+        REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_PROPERTIES_get_constmap, my_MESSAGE_PROPERTIES_get_constmap);
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Destroy, my_ConstMap_Destroy);
 
         REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, my_CONSTBUFFER_Create);
@@ -371,6 +587,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         REGISTER_UMOCK_ALIAS_TYPE(CONSTMAP_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_PROPERTIES_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_PROPERTY*, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_PROPERTY_UPDATE*, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_PROPERTY_ID, int);
+        REGISTER_UMOCK_ALIAS_TYPE(MAPPED_FILE_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(const unsigned char**, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(size_t*, void*);
         
         REGISTER_TYPE(MAP_RESULT, MAP_RESULT);
         REGISTER_TYPE(CONSTMAP_RESULT, CONSTMAP_RESULT);
@@ -401,10 +624,22 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         currentmalloc_call = 0;
         whenShallmalloc_fail = 0;
 
-        currentConstMap_Create_call = 0;
-        whenShallConstMap_Create_fail = 0;
-        currentConstMap_Clone_call = 0;
-        whenShallConstMap_Clone_fail = 0;
+        currentMESSAGE_PROPERTIES_create_call = 0;
+        whenShallMESSAGE_PROPERTIES_create_fail = 0;
+        currentMESSAGE_PROPERTIES_create_borrowed_call = 0;
+        whenShallMESSAGE_PROPERTIES_create_borrowed_fail = 0;
+        currentMESSAGE_PROPERTIES_create_borrowed_v2_call = 0;
+        whenShallMESSAGE_PROPERTIES_create_borrowed_v2_fail = 0;
+        currentMESSAGE_PROPERTIES_create_borrowed_v3_call = 0;
+        whenShallMESSAGE_PROPERTIES_create_borrowed_v3_fail = 0;
+        currentMESSAGE_PROPERTIES_create_typed_call = 0;
+        whenShallMESSAGE_PROPERTIES_create_typed_fail = 0;
+        currentMESSAGE_PROPERTIES_derive_call = 0;
+        whenShallMESSAGE_PROPERTIES_derive_fail = 0;
+        currentMESSAGE_PROPERTIES_clone_call = 0;
+        whenShallMESSAGE_PROPERTIES_clone_fail = 0;
+        releaseCalls = 0;
+        releaseContext = NULL;
         currentCONSTBUFFER_Create_call = 0;
         whenShallCONSTBUFFER_Create_fail = 0;
         currentCONSTBUFFER_refCount = 0;
@@ -450,7 +685,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    /*Tests_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.] */
+    /*Tests_SRS_MESSAGE_02_019: [Message_Create shall copy the sourceProperties to a readonly property set with MESSAGE_PROPERTIES_create.] */
     /*Tests_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
     TEST_FUNCTION(Message_Create_happy_path)
     {
@@ -458,12 +693,12 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake};
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /*this is copying the buffer*/
 
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -483,12 +718,12 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, &fake, (MAP_HANDLE)&fake };
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 0)); /* this is copying the (empty buffer)*/
 
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -508,12 +743,12 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
 
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -533,19 +768,19 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
         {
             STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
             {
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)) /*this is copying the properties*/
+                whenShallMESSAGE_PROPERTIES_create_fail = 1;
+                STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)) /*this is copying the properties*/
                     .IgnoreArgument(1);
 
                 STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /* this is copying the (empty buffer)*/
                     .IgnoreArgument(1);
             }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
                 .IgnoreArgument(1);
         }
         ///act
@@ -566,7 +801,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
         whenShallmalloc_fail = 1;
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         ///act
@@ -586,19 +821,19 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
         {
             STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
             {
 
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+                whenShallMESSAGE_PROPERTIES_create_fail = 1;
+                STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
                 STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
                     .IgnoreArgument(1);
             }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
                 .IgnoreArgument(1);
         }
         ///act
@@ -618,12 +853,12 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         whenShallCONSTBUFFER_Create_fail = 1;
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
 
@@ -645,7 +880,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
         whenShallmalloc_fail = 1;
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         ///act
@@ -725,7 +960,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-    /*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
+    /*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly property set with MESSAGE_PROPERTIES_create.]*/
     /*Tests_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
     TEST_FUNCTION(Message_CreateFromBuffer_Success)
     {
@@ -740,12 +975,12 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
 
-        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
 
 
         ///act
@@ -777,7 +1012,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         ///act
@@ -807,11 +1042,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         whenShallCONSTBUFFER_Clone_fail = 1;
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
         ///act
@@ -837,20 +1072,20 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             (MAP_HANDLE)&fake
         };
 
-        whenShallConstMap_Create_fail = 1;
+        whenShallMESSAGE_PROPERTIES_create_fail = 1;
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
         {
             
             STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
             {
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
+                STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)&fake)); /*this is copying the properties*/
                 STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(buffer));
             }
 
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
                 .IgnoreArgument(1);
         }
 
@@ -882,7 +1117,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
-    /*Tests_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
+    /*Tests_SRS_MESSAGE_17_001: [Message_Clone shall clone the property set.]*/
     /*Tests_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
     TEST_FUNCTION(Message_Clone_increments_ref_count_1)
     {
@@ -891,7 +1126,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -917,7 +1152,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE r = Message_Clone(aMessage);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -942,11 +1177,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(r);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*only 1 because the message is 0 size*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*only 1 because the message is 0 size*/
             .IgnoreArgument(1);
 
         ///act
@@ -974,7 +1209,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
+    /*Tests_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall return the CONSTMAP handle representing the properties of the message, obtained from MESSAGE_PROPERTIES_get_constmap.]*/
     TEST_FUNCTION(Message_GetProperties_happy_path)
     {
         ///arrange
@@ -982,7 +1217,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_constmap(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
         ///act
         CONSTMAP_HANDLE theProperties = Message_GetProperties(aMessage);
@@ -996,6 +1231,82 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ConstMap_Destroy(theProperties);
     }
 
+    /*Tests_SRS_MESSAGE_17_019: [ If message is NULL then Message_GetProperty shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        const char* value = Message_GetProperty(NULL, "source");
+
+        ///assert
+        ASSERT_IS_NULL(value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_020: [ Otherwise, Message_GetProperty shall return the value MESSAGE_PROPERTIES_get finds for name. ]*/
+    TEST_FUNCTION(Message_GetProperty_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get(IGNORED_PTR_ARG, "source"))
+            .IgnoreArgument_handle()
+            .SetReturn("mapping");
+
+        ///act
+        const char* value = Message_GetProperty(aMessage, "source");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(aMessage);
+    }
+
+    /*Tests_SRS_MESSAGE_17_021: [ If message is NULL then Message_GetPropertyById shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetPropertyById_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        const char* value = Message_GetPropertyById(NULL, MESSAGE_PROPERTY_SOURCE);
+
+        ///assert
+        ASSERT_IS_NULL(value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_022: [ Otherwise, Message_GetPropertyById shall return the value MESSAGE_PROPERTIES_get_by_id finds for id. ]*/
+    TEST_FUNCTION(Message_GetPropertyById_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_by_id(IGNORED_PTR_ARG, MESSAGE_PROPERTY_MAC_ADDRESS))
+            .IgnoreArgument_handle()
+            .SetReturn("01:01:01:01:01:01");
+
+        ///act
+        const char* value = Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_MAC_ADDRESS);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "01:01:01:01:01:01", value);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(aMessage);
+    }
+
     /*Tests_SRS_MESSAGE_02_013: [If message is NULL then Message_GetContent shall return NULL.] */
     TEST_FUNCTION(Message_GetContent_with_NULL_message_returns_NULL)
     {
@@ -1152,7 +1463,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
     /*Tests_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
     /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-    /*Tests_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
+    /*Tests_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the property set.]*/
     /*Tests_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
     TEST_FUNCTION(Message_Destroy_happy_path)
     {
@@ -1162,11 +1473,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE msg = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG)) /*this is the map*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG)) /*this is the map*/
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /*this is the buffer*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*this is the handle*/
             .IgnoreArgument(1);
 
         ///act
@@ -1227,10 +1538,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(notFail____minimalMessage + 14, 0));
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1257,11 +1568,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
             .SetReturn(MAP_OK);
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1289,11 +1600,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "ab", "a"))
             .SetReturn(MAP_OK);
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1317,11 +1628,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1347,11 +1658,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .SetReturn(TEST_MAP_HANDLE);
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
             .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1378,11 +1689,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
             .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1406,11 +1717,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
 
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
             .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1434,11 +1745,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
             .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1463,11 +1774,11 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .SetReturn(TEST_MAP_HANDLE);
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
             .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
@@ -1902,33 +2213,33 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
 
-        size_t zero = 0;
         const CONSTBUFFER bufferContent = { NULL, 0 };
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_keys()
-            .IgnoreArgument_values()
-            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
         STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument_constbufferHandle()
             .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0); /*second pass writes the properties*/
 
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
         ///assert
-        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage_v2), nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1942,42 +2253,42 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     {
 
         ///arrange
-        int32_t size = sizeof(notFail____minimalMessage);
-        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail____minimalMessage));
+        int32_t size = sizeof(notFail____minimalMessage_v2);
+        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail____minimalMessage_v2));
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
 
-        size_t zero = 0;
         const CONSTBUFFER bufferContent = { NULL, 0 };
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_keys()
-            .IgnoreArgument_values()
-            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
         STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument_constbufferHandle()
             .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0); /*second pass writes the properties*/
 
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
         ///assert
-        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
-        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail____minimalMessage, size));
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage_v2), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail____minimalMessage_v2, size));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -1988,12 +2299,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     /*Tests_SRS_MESSAGE_02_033: [ Message_ToByteArray shall precompute the needed memory size and shall pre allocate it. ]*/
     /*Tests_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
     /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, write in *size the byte array size and return a non-NULL result. ]*/
+    /*Tests_SRS_MESSAGE_17_018: [ Message_ToByteArray shall take the names, values and lengths of the properties from the message's property set. ]*/
     TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_happy_path)
     {
 
         ///arrange
-        int32_t size = sizeof(notFail__2Property_2bytes);
-        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
+        int32_t size = sizeof(notFail__2Property_2bytes_v2);
+        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes_v2));
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
@@ -2004,38 +2316,51 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
+        const MESSAGE_PROPERTY properties[] =
+        {
+            { "BleedingEdge", 12, "rocks", 5 },
+            { "Azure IoT Gateway is", 20, "awesome", 7 }
+        };
 
         const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two));
         STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument_constbufferHandle()
             .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(2); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
         ///assert
-        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
-        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_2bytes, size));
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes_v2), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_2bytes_v2, size));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
@@ -2044,13 +2369,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
 
-    /*Tests_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_when_ConstMap_GetInternals_fails)
+    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
     {
 
         ///arrange
-        int32_t size = sizeof(notFail__2Property_2bytes);
-        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
+        int32_t size = sizeof(notFail__2Property_2bytes_v2)-1;
+        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes_v2));
         ASSERT_IS_NOT_NULL(buf);
         umock_c_reset_all_calls();
 
@@ -2061,27 +2386,44 @@ BEGIN_TEST_SUITE(gwmessage_ut)
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
         STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
+        const MESSAGE_PROPERTY properties[] =
+        {
+            { "BleedingEdge", 12, "rocks", 5 },
+            { "Azure IoT Gateway is", 20, "awesome", 7 }
+        };
+
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
             .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two))
-            .SetReturn(CONSTMAP_ERROR);
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(2); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
 
         ///act
         int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
@@ -2095,59 +2437,1828 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
+    /*Tests_SRS_MESSAGE_17_023: [ If message is NULL then Message_GetByteArray shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetByteArray_with_NULL_message_returns_NULL)
     {
-
         ///arrange
-        int32_t size = sizeof(notFail__2Property_2bytes)-1;
-        unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
-        ASSERT_IS_NOT_NULL(buf);
-        umock_c_reset_all_calls();
 
+        ///act
+        const CONSTBUFFER* byteArray = Message_GetByteArray(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(byteArray);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_024: [ On the first call, Message_GetByteArray shall serialize the message into a block from MESSAGE_POOL_alloc. ]*/
+    /*Tests_SRS_MESSAGE_17_025: [ Message_GetByteArray shall publish the serialized form with an atomic compare-exchange; if another thread published one first, it shall free its own and use that one. ]*/
+    /*Tests_SRS_MESSAGE_17_027: [ Otherwise, Message_GetByteArray shall return the serialized form kept with the message, without serializing it again. ]*/
+    TEST_FUNCTION(Message_GetByteArray_serializes_the_message_once)
+    {
+        ///arrange
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
             .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
             .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
-        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        ///act
+        const CONSTBUFFER* first = Message_GetByteArray(messageHandle);
+        const CONSTBUFFER* second = Message_GetByteArray(messageHandle);
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
+        ///assert
+        ASSERT_IS_NOT_NULL(first);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
+        ASSERT_ARE_EQUAL(size_t, sizeof(notFail____minimalMessage_v2), first->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(first->buffer, notFail____minimalMessage_v2, sizeof(notFail____minimalMessage_v2)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+    /*Tests_SRS_MESSAGE_17_028: [ If building the serialized form fails, Message_GetByteArray shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetByteArray_fails_when_MESSAGE_POOL_alloc_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+        whenShallmalloc_fail = currentmalloc_call + 1;
         STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument_constbufferHandle()
             .SetReturn(&bufferContent);
-
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
         ///act
-        int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        const CONSTBUFFER* byteArray = Message_GetByteArray(messageHandle);
 
         ///assert
-        ASSERT_IS_TRUE(nbytes < 0);
+        ASSERT_IS_NULL(byteArray);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        free((void*)buf);
         Message_Destroy(messageHandle);
     }
 
+    /*Tests_SRS_MESSAGE_17_029: [ Message_ToByteArray shall get the serialized form of the message as Message_GetByteArray does, and fail and return -1 if that fails. ]*/
+    TEST_FUNCTION(Message_ToByteArray_copies_the_serialized_form_kept_with_the_message)
+    {
+        ///arrange
+        unsigned char buf[sizeof(notFail____minimalMessage_v2)];
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        (void)Message_GetByteArray(messageHandle);
+        umock_c_reset_all_calls();
+
+        ///act
+        int32_t needed = Message_ToByteArray(messageHandle, NULL, 0);
+        int32_t nbytes = Message_ToByteArray(messageHandle, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage_v2), needed);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage_v2), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail____minimalMessage_v2, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_026: [ When the ref count is zero, Message_Destroy shall also free the serialized form of the message, if it was built. ]*/
+    TEST_FUNCTION(Message_Destroy_frees_the_serialized_form)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(0);
+        (void)Message_GetByteArray(messageHandle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*this is the serialized form*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*this is the handle*/
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(messageHandle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_030: [ If source or release is NULL, or size is smaller than the smallest serialized message, then Message_CreateFromOwnedByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_with_NULL_source_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(NULL, 14, test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_030: [ If source or release is NULL, or size is smaller than the smallest serialized message, then Message_CreateFromOwnedByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_with_NULL_release_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage), NULL, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_030: [ If source or release is NULL, or size is smaller than the smallest serialized message, then Message_CreateFromOwnedByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_with_size_below_the_smallest_message_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail____minimalMessage_v2, sizeof(notFail____minimalMessage_v2) - 1, test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_031: [ Message_CreateFromOwnedByteArray shall fail and return NULL if source is not a serialized message, exactly as Message_CreateFromByteArray would. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_with_inconsistent_size_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes) - 1, test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_031: [ Message_CreateFromOwnedByteArray shall fail and return NULL if source is not a serialized message, exactly as Message_CreateFromByteArray would. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_when_first_byte_is_not_0xA1_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(fail_____firstByteNot0xA1, sizeof(fail_____firstByteNot0xA1), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_033: [ Message_CreateFromOwnedByteArray shall create the property set with MESSAGE_PROPERTIES_create_borrowed, or MESSAGE_PROPERTIES_create_borrowed_v2 for version 2 of the serialized form, pointing into source. ]*/
+    /*Tests_SRS_MESSAGE_17_034: [ Message_CreateFromOwnedByteArray shall use the content inside source without copying it. ]*/
+    /*Tests_SRS_MESSAGE_17_035: [ On success, Message_CreateFromOwnedByteArray shall keep release and context, and return a non-NULL handle with the ref count set to "1". ]*/
+    /*Tests_SRS_MESSAGE_17_036: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetContent shall return the content inside the owned byte array. ]*/
+    /*Tests_SRS_MESSAGE_17_039: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetByteArray shall return the owned byte array. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_does_not_copy_the_byte_array)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed((const char*)notFail__1Property_1bytes + 10, 1));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, (void*)0x42);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__1Property_1bytes + 43, content->buffer);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+        const CONSTBUFFER* byteArray = Message_GetByteArray(handle);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__1Property_1bytes, byteArray->buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(notFail__1Property_1bytes), byteArray->size);
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_032: [ If any underlying call fails, Message_CreateFromOwnedByteArray shall return NULL and shall not call release. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_fails_when_MESSAGE_POOL_alloc_fails)
+    {
+        ///arrange
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_032: [ If any underlying call fails, Message_CreateFromOwnedByteArray shall return NULL and shall not call release. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_fails_when_MESSAGE_PROPERTIES_create_borrowed_fails)
+    {
+        ///arrange
+        whenShallMESSAGE_PROPERTIES_create_borrowed_fail = 1;
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed((const char*)notFail__1Property_1bytes + 10, 1));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_037: [ For a message created by Message_CreateFromOwnedByteArray, Message_GetContentHandle shall return a copy of the content made with CONSTBUFFER_Create. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_copies_the_content_of_an_owned_byte_array)
+    {
+        ///arrange
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(notFail__1Property_1bytes + 43, 1));
+
+        ///act
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(handle);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CONSTBUFFER_Destroy(content);
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_038: [ When the ref count is zero, Message_Destroy shall call release with context for a message created by Message_CreateFromOwnedByteArray. ]*/
+    TEST_FUNCTION(Message_Destroy_releases_the_owned_byte_array_with_the_last_reference)
+    {
+        ///arrange
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, (void*)0x42);
+        MESSAGE_HANDLE clone = Message_Clone(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(handle);
+        size_t releasedBeforeLastDestroy = releaseCalls;
+        Message_Destroy(clone);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releasedBeforeLastDestroy);
+        ASSERT_ARE_EQUAL(size_t, 1, releaseCalls);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, releaseContext);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_043: [ Message_ToByteArray shall write version 2 of the serialized form, interning the names of MESSAGE_PROPERTY_ID. ]*/
+    TEST_FUNCTION(Message_ToByteArray_writes_interned_names_as_ids)
+    {
+        ///arrange
+        unsigned char buf[sizeof(notFail__internedProperty_1bytes_v2)];
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+        umock_c_reset_all_calls();
+
+        const MESSAGE_PROPERTY property = { "source", 6, "ble", 3, MESSAGE_PROPERTY_SOURCE + 1 };
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"3", 1 };
+
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+
+        ///act
+        int32_t nbytes = Message_ToByteArray(messageHandle, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__internedProperty_1bytes_v2), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__internedProperty_1bytes_v2, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_copies_a_version_2_byte_array)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(sizeof(notFail__2Property_2bytes_v2)));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v2(IGNORED_PTR_ARG, 2))
+            .IgnoreArgument_encoded();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(size_t, 2, content->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(content->buffer, "34", 2));
+        const CONSTBUFFER* byteArray = Message_GetByteArray(handle);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, notFail__2Property_2bytes_v2, byteArray->buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(notFail__2Property_2bytes_v2), byteArray->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(byteArray->buffer, notFail__2Property_2bytes_v2, byteArray->size));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_reads_a_minimal_version_2_byte_array)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v2(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_encoded();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage_v2, sizeof(notFail____minimalMessage_v2));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, Message_GetContent(handle)->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_fails_when_MESSAGE_POOL_alloc_fails)
+    {
+        ///arrange
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(sizeof(notFail__2Property_2bytes_v2)));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_frees_the_copy_when_MESSAGE_PROPERTIES_create_borrowed_v2_fails)
+    {
+        ///arrange
+        whenShallMESSAGE_PROPERTIES_create_borrowed_v2_fail = 1;
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(sizeof(notFail__2Property_2bytes_v2)));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v2(IGNORED_PTR_ARG, 2))
+            .IgnoreArgument_encoded();
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*the message*/
+            .IgnoreArgument_block();
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG)) /*the copy*/
+            .IgnoreArgument_block();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_041: [ If a length or count of a version 2 byte array is truncated or goes past the end of the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_with_a_value_past_the_end_fails)
+    {
+        ///arrange
+        const unsigned char fail_valuePastTheEnd[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x82,                   /*version 2*/
+            0x00, 0x00, 0x00, 15,   /*size of this array*/
+            0x01,                   /*one property*/
+            0x01, 9, 'b','l','e','\0', /*value longer than what is left*/
+            0x00                    /*zero message content size*/
+        };
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreAllCalls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_valuePastTheEnd, sizeof(fail_valuePastTheEnd));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v2_call);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_041: [ If a length or count of a version 2 byte array is truncated or goes past the end of the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_with_a_truncated_content_size_fails)
+    {
+        ///arrange
+        const unsigned char fail_truncatedContentSize[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x82,                   /*version 2*/
+            0x00, 0x00, 0x00, 9,    /*size of this array*/
+            0x00,                   /*zero properties*/
+            0x80                    /*content size continues past the end*/
+        };
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreAllCalls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_truncatedContentSize, sizeof(fail_truncatedContentSize));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v2_call);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_042: [ If a property name of a version 2 byte array is an id that is not a MESSAGE_PROPERTY_ID, Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_with_an_unknown_interned_name_fails)
+    {
+        ///arrange
+        const unsigned char fail_unknownInternedName[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x82,                   /*version 2*/
+            0x00, 0x00, 0x00, 14,   /*size of this array*/
+            0x01,                   /*one property*/
+            (MESSAGE_PROPERTY_ID_COUNT << 1) | 1, 2, 'x', 'y', '\0',
+            0x00                    /*zero message content size*/
+        };
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreAllCalls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_unknownInternedName, sizeof(fail_unknownInternedName));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v2_call);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_033: [ Message_CreateFromOwnedByteArray shall create the property set with MESSAGE_PROPERTIES_create_borrowed, or MESSAGE_PROPERTIES_create_borrowed_v2 for version 2 of the serialized form, pointing into source. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_borrows_version_2_properties)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v2(notFail__internedProperty_1bytes_v2 + 8, 1));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__internedProperty_1bytes_v2, sizeof(notFail__internedProperty_1bytes_v2), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__internedProperty_1bytes_v2 + 15, content->buffer);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_044: [ If message is NULL then Message_Derive shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_Derive_with_NULL_message_fails)
+    {
+        ///arrange
+        MESSAGE_PROPERTY_UPDATE adds[] = { { "source", "mapping" } };
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(NULL, adds, 1, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_045: [ Message_Derive shall create the property set of the new message with MESSAGE_PROPERTIES_derive, passing it the property set of message, adds and removes. ]*/
+    /*Tests_SRS_MESSAGE_17_046: [ Message_Derive shall share the content of message by cloning its CONSTBUFFER handle. ]*/
+    /*Tests_SRS_MESSAGE_17_050: [ On success, Message_Derive shall return a non-NULL handle with the ref count set to "1". ]*/
+    TEST_FUNCTION(Message_Derive_shares_the_content_of_message)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_PROPERTY_UPDATE adds[] = { { "source", "mapping" } };
+        const char* removes[] = { "macAddress" };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_derive(IGNORED_PTR_ARG, adds, 1, removes, 1))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(parent, adds, 1, removes, 1);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, parent, handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, Message_GetContent(parent), Message_GetContent(handle));
+        ASSERT_ARE_EQUAL(size_t, 2, currentCONSTBUFFER_refCount);
+
+        ///cleanup
+        Message_Destroy(handle);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_046: [ Message_Derive shall share the content of message by cloning its CONSTBUFFER handle. ]*/
+    TEST_FUNCTION(Message_Derive_outlives_its_parent)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE handle = Message_Derive(parent, NULL, 0, NULL, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(parent);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, currentCONSTBUFFER_refCount);
+        ASSERT_IS_NOT_NULL(Message_GetContent(handle));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_047: [ If the content of message is inside a byte array it owns, Message_Derive shall point at the same content and keep a reference to message with Message_Clone. ]*/
+    TEST_FUNCTION(Message_Derive_keeps_the_owned_byte_array_of_message)
+    {
+        ///arrange
+        MESSAGE_HANDLE parent = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_derive(IGNORED_PTR_ARG, NULL, 0, NULL, 0))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(parent, NULL, 0, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        Message_Destroy(parent);
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__1Property_1bytes + 43, content->buffer);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+        ASSERT_ARE_EQUAL(size_t, 1, releaseCalls);
+    }
+
+    /*Tests_SRS_MESSAGE_17_047: [ If the content of message is inside a byte array it owns, Message_Derive shall point at the same content and keep a reference to message with Message_Clone. ]*/
+    /*Tests_SRS_MESSAGE_17_048: [ When the ref count is zero, Message_Destroy shall destroy the reference a message made by Message_Derive keeps to the message whose byte array holds its content. ]*/
+    TEST_FUNCTION(Message_Derive_of_a_derived_message_keeps_the_owner_of_the_byte_array)
+    {
+        ///arrange
+        MESSAGE_HANDLE parent = Message_CreateFromOwnedByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes), test_release, NULL);
+        MESSAGE_HANDLE child = Message_Derive(parent, NULL, 0, NULL, 0);
+        Message_Destroy(parent);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(child, NULL, 0, NULL, 0);
+        Message_Destroy(child);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__1Property_1bytes + 43, Message_GetContent(handle)->buffer);
+
+        ///cleanup
+        Message_Destroy(handle);
+        ASSERT_ARE_EQUAL(size_t, 1, releaseCalls);
+    }
+
+    /*Tests_SRS_MESSAGE_17_049: [ If any underlying call fails, Message_Derive shall return NULL. ]*/
+    TEST_FUNCTION(Message_Derive_fails_when_MESSAGE_POOL_alloc_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        umock_c_reset_all_calls();
+        whenShallmalloc_fail = currentmalloc_call + 1;
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(parent, NULL, 0, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_049: [ If any underlying call fails, Message_Derive shall return NULL. ]*/
+    TEST_FUNCTION(Message_Derive_fails_when_MESSAGE_PROPERTIES_derive_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        umock_c_reset_all_calls();
+        whenShallMESSAGE_PROPERTIES_derive_fail = 1;
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_derive(IGNORED_PTR_ARG, NULL, 0, NULL, 0))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_Derive(parent, NULL, 0, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, currentCONSTBUFFER_refCount);
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_051: [ If cfg is NULL then Message_CreateTyped shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateTyped_with_NULL_cfg_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateTyped(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_052: [ If field source of cfg is NULL and size is not zero, then Message_CreateTyped shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateTyped_with_NULL_source_and_non_zero_size_fails)
+    {
+        ///arrange
+        MESSAGE_TYPED_CONFIG c = { 1, NULL, NULL, 0 };
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateTyped(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_053: [ Message_CreateTyped shall copy the source to a readonly CONSTBUFFER. ]*/
+    /*Tests_SRS_MESSAGE_17_054: [ Message_CreateTyped shall create the property set with MESSAGE_PROPERTIES_create_typed, passing it the properties and propertyCount of cfg. ]*/
+    /*Tests_SRS_MESSAGE_17_056: [ On success, Message_CreateTyped shall return a non-NULL handle with the ref count set to "1". ]*/
+    TEST_FUNCTION(Message_CreateTyped_happy_path)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        const MESSAGE_TYPED_PROPERTY properties[] = { { "bleControllerIndex", { MESSAGE_PROPERTY_TYPE_INT64, { .integer = -12 } } } };
+        MESSAGE_TYPED_CONFIG c = { sizeof(source), source, properties, 1 };
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(source, sizeof(source)));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_typed(properties, 1));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateTyped(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle)->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_055: [ If any underlying call fails, Message_CreateTyped shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateTyped_fails_when_MESSAGE_PROPERTIES_create_typed_fails)
+    {
+        ///arrange
+        MESSAGE_TYPED_CONFIG c = { 0, NULL, NULL, 0 };
+        whenShallMESSAGE_PROPERTIES_create_typed_fail = 1;
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_typed(NULL, 0));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle();
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateTyped(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_055: [ If any underlying call fails, Message_CreateTyped shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateTyped_fails_when_CONSTBUFFER_Create_fails)
+    {
+        ///arrange
+        MESSAGE_TYPED_CONFIG c = { 0, NULL, NULL, 0 };
+        whenShallCONSTBUFFER_Create_fail = 1;
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateTyped(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_typed_call);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_064: [ PropertySet_Create shall return the property set MESSAGE_PROPERTIES_create makes from properties. ]*/
+    /*Tests_SRS_MESSAGE_17_065: [ PropertySet_CreateTyped shall return the property set MESSAGE_PROPERTIES_create_typed makes from properties and count. ]*/
+    /*Tests_SRS_MESSAGE_17_066: [ PropertySet_Clone shall return the result of MESSAGE_PROPERTIES_clone on propertySet. ]*/
+    /*Tests_SRS_MESSAGE_17_067: [ PropertySet_Destroy shall call MESSAGE_PROPERTIES_destroy on propertySet. ]*/
+    TEST_FUNCTION(PropertySet_functions_forward_to_MESSAGE_PROPERTIES)
+    {
+        ///arrange
+        const MESSAGE_TYPED_PROPERTY properties[] = { { "bleControllerIndex", { MESSAGE_PROPERTY_TYPE_INT64, { .integer = -12 } } } };
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create((MAP_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_typed(properties, 1));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+
+        ///act
+        PROPERTY_SET_HANDLE set1 = PropertySet_Create((MAP_HANDLE)0x42);
+        PROPERTY_SET_HANDLE set2 = PropertySet_CreateTyped(properties, 1);
+        PROPERTY_SET_HANDLE set3 = PropertySet_Clone(set1);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(set1);
+        ASSERT_IS_NOT_NULL(set2);
+        ASSERT_ARE_EQUAL(void_ptr, set1, set3);
+
+        ///cleanup
+        PropertySet_Destroy(set3);
+        PropertySet_Destroy(set2);
+        PropertySet_Destroy(set1);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_068: [ If cfg is NULL then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_with_NULL_cfg_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_069: [ If field properties of cfg is NULL then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_with_NULL_properties_fails)
+    {
+        ///arrange
+        MESSAGE_SHARED_CONFIG c = { 0, NULL, NULL };
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_070: [ If field source of cfg is NULL and size is not zero, then Message_CreateWithPropertySet shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_with_NULL_source_and_non_zero_size_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_SHARED_CONFIG c = { 1, NULL, set };
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_071: [ Message_CreateWithPropertySet shall copy the source to a readonly CONSTBUFFER. ]*/
+    /*Tests_SRS_MESSAGE_17_072: [ Message_CreateWithPropertySet shall take a reference to the properties of cfg with MESSAGE_PROPERTIES_clone, without copying them. ]*/
+    /*Tests_SRS_MESSAGE_17_074: [ On success, Message_CreateWithPropertySet shall return a non-NULL handle with the ref count set to "1". ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_happy_path)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_SHARED_CONFIG c = { sizeof(source), source, set };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(source, sizeof(source)));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+
+        ///act
+        MESSAGE_HANDLE handle1 = Message_CreateWithPropertySet(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle1);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle1)->size);
+        ASSERT_ARE_EQUAL(size_t, 1, currentMESSAGE_PROPERTIES_create_call);
+
+        ///cleanup
+        PropertySet_Destroy(set);
+        Message_Destroy(handle1);
+    }
+
+    /*Tests_SRS_MESSAGE_17_073: [ If any underlying call fails, Message_CreateWithPropertySet shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_fails_when_CONSTBUFFER_Create_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_SHARED_CONFIG c = { 0, NULL, set };
+        whenShallCONSTBUFFER_Create_fail = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_clone_call);
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_073: [ If any underlying call fails, Message_CreateWithPropertySet shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithPropertySet_fails_when_MESSAGE_PROPERTIES_clone_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_SHARED_CONFIG c = { 0, NULL, set };
+        whenShallMESSAGE_PROPERTIES_clone_fail = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle();
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_075: [ If message is NULL then Message_GetPropertySet shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetPropertySet_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        PROPERTY_SET_HANDLE result = Message_GetPropertySet(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_076: [ Otherwise, Message_GetPropertySet shall return a new reference to the property set of the message, taken with MESSAGE_PROPERTIES_clone. ]*/
+    TEST_FUNCTION(Message_GetPropertySet_returns_a_reference_to_the_property_set)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_SHARED_CONFIG c = { 0, NULL, set };
+        MESSAGE_HANDLE handle = Message_CreateWithPropertySet(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+
+        ///act
+        PROPERTY_SET_HANDLE result = Message_GetPropertySet(handle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, set, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(result);
+        Message_Destroy(handle);
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_077: [ If cfg is NULL then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_with_NULL_cfg_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_078: [ If field properties of cfg is NULL then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_with_NULL_properties_fails)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, NULL, NULL };
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_079: [ If field source of cfg is NULL and size is not zero, then Message_CreateWithExternalContent shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_with_NULL_source_and_non_zero_size_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { 1, NULL, test_release, NULL, set };
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_080: [ Message_CreateWithExternalContent shall not copy the source; Message_GetContent shall return source and size. ]*/
+    /*Tests_SRS_MESSAGE_17_081: [ Message_CreateWithExternalContent shall take a reference to the properties of cfg with MESSAGE_PROPERTIES_clone. ]*/
+    /*Tests_SRS_MESSAGE_17_083: [ On success, Message_CreateWithExternalContent shall return a non-NULL handle with the ref count set to "1". ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_does_not_copy_the_content)
+    {
+        ///arrange
+        const unsigned char source[] = { '3', '4' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, (void*)0x42, set };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(void_ptr, source, content->buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(source), content->size);
+        ASSERT_ARE_EQUAL(size_t, 0, currentCONSTBUFFER_Create_call);
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+        PropertySet_Destroy(set);
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_082: [ If any underlying call fails, Message_CreateWithExternalContent shall return NULL without calling release. ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_fails_when_MESSAGE_PROPERTIES_clone_fails)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, NULL, set };
+        whenShallMESSAGE_PROPERTIES_clone_fail = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, releaseCalls);
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_085: [ For a message created by Message_CreateWithExternalContent, Message_GetContentHandle shall return a copy of the content made with CONSTBUFFER_Create. ]*/
+    TEST_FUNCTION(Message_GetContentHandle_copies_external_content)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, NULL, set };
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(source, sizeof(source)));
+
+        ///act
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(handle);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CONSTBUFFER_Destroy(content);
+        Message_Destroy(handle);
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_091: [ Message_GetContentView shall point view at the content of the message without copying it, for every kind of message. ]*/
+    /*Tests_SRS_MESSAGE_17_092: [ Message_GetContentView shall keep the content alive by storing a clone of message, made with Message_Clone, in view->owner, and return 0. ]*/
+    TEST_FUNCTION(Message_GetContentView_does_not_copy_external_content)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, NULL, set };
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+        MESSAGE_CONTENT_VIEW view;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        int result = Message_GetContentView(handle, &view);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(void_ptr, source, view.buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(source), view.size);
+        ASSERT_ARE_EQUAL(void_ptr, handle, view.owner);
+        ASSERT_ARE_EQUAL(size_t, 0, currentCONSTBUFFER_Create_call);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_ReleaseContentView(&view);
+        Message_Destroy(handle);
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_090: [ If message or view is NULL, Message_GetContentView shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(Message_GetContentView_with_NULL_arguments_fails)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, NULL, set };
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+        MESSAGE_CONTENT_VIEW view;
+        umock_c_reset_all_calls();
+
+        ///act
+        int result1 = Message_GetContentView(NULL, &view);
+        int result2 = Message_GetContentView(handle, NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_093: [ If view is NULL, Message_ReleaseContentView shall do nothing. ]*/
+    /*Tests_SRS_MESSAGE_17_094: [ Message_ReleaseContentView shall destroy view->owner with Message_Destroy and clear the view. ]*/
+    TEST_FUNCTION(Message_ReleaseContentView_releases_external_content_with_the_last_reference)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, (void*)0x42, set };
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+        MESSAGE_CONTENT_VIEW view;
+        (void)Message_GetContentView(handle, &view);
+        PropertySet_Destroy(set);
+        Message_Destroy(handle);
+        size_t callsBeforeRelease = releaseCalls;
+
+        ///act
+        Message_ReleaseContentView(NULL);
+        Message_ReleaseContentView(&view);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, callsBeforeRelease);
+        ASSERT_ARE_EQUAL(size_t, 1, releaseCalls);
+        ASSERT_IS_NULL(view.owner);
+        ASSERT_IS_NULL(view.buffer);
+        ASSERT_ARE_EQUAL(size_t, 0, view.size);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_084: [ When the ref count is zero, Message_Destroy shall call release with context for a message created by Message_CreateWithExternalContent, if release is not NULL. ]*/
+    TEST_FUNCTION(Message_Destroy_releases_external_content_with_the_last_reference)
+    {
+        ///arrange
+        const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, test_release, (void*)0x42, set };
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+        MESSAGE_HANDLE clone = Message_Clone(handle);
+        PropertySet_Destroy(set);
+
+        ///act
+        Message_Destroy(handle);
+        size_t callsAfterFirst = releaseCalls;
+        Message_Destroy(clone);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, callsAfterFirst);
+        ASSERT_ARE_EQUAL(size_t, 1, releaseCalls);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, releaseContext);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_084: [ When the ref count is zero, Message_Destroy shall call release with context for a message created by Message_CreateWithExternalContent, if release is not NULL. ]*/
+    TEST_FUNCTION(Message_CreateWithExternalContent_accepts_NULL_release)
+    {
+        ///arrange
+        static const unsigned char source[] = { '3' };
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        MESSAGE_EXTERNAL_CONFIG c = { sizeof(source), source, NULL, NULL, set };
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateWithExternalContent(&c);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+
+        ///cleanup
+        Message_Destroy(handle);
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_086: [ If path or properties is NULL then Message_CreateFromMappedFile shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromMappedFile_with_NULL_arguments_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE handle1 = Message_CreateFromMappedFile(NULL, set);
+        MESSAGE_HANDLE handle2 = Message_CreateFromMappedFile("firmware.bin", NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle1);
+        ASSERT_IS_NULL(handle2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_087: [ Message_CreateFromMappedFile shall map the file with MappedFile_Open. ]*/
+    /*Tests_SRS_MESSAGE_17_088: [ Message_CreateFromMappedFile shall create the message with Message_CreateWithExternalContent, with a release that closes the mapping with MappedFile_Close. ]*/
+    TEST_FUNCTION(Message_CreateFromMappedFile_maps_the_file_until_the_message_is_destroyed)
+    {
+        ///arrange
+        static const unsigned char mapped[] = { 'f', 'w' };
+        const unsigned char* data = mapped;
+        size_t size = sizeof(mapped);
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MappedFile_Open("firmware.bin", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &data, sizeof(data))
+            .CopyOutArgumentBuffer(3, &size, sizeof(size))
+            .SetReturn((MAPPED_FILE_HANDLE)0x42);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromMappedFile("firmware.bin", set);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, mapped, Message_GetContent(handle)->buffer);
+        ASSERT_ARE_EQUAL(size_t, sizeof(mapped), Message_GetContent(handle)->size);
+
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_destroy(set));
+        STRICT_EXPECTED_CALL(MappedFile_Close((MAPPED_FILE_HANDLE)0x42));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        Message_Destroy(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_089: [ If any underlying call fails, Message_CreateFromMappedFile shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromMappedFile_fails_when_MappedFile_Open_fails)
+    {
+        ///arrange
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MappedFile_Open("firmware.bin", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_data()
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromMappedFile("firmware.bin", set);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_089: [ If any underlying call fails, Message_CreateFromMappedFile shall return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromMappedFile_closes_the_file_when_the_message_cannot_be_created)
+    {
+        ///arrange
+        static const unsigned char mapped[] = { 'f', 'w' };
+        const unsigned char* data = mapped;
+        size_t size = sizeof(mapped);
+        PROPERTY_SET_HANDLE set = PropertySet_Create((MAP_HANDLE)0x42);
+        whenShallMESSAGE_PROPERTIES_clone_fail = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MappedFile_Open("firmware.bin", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &data, sizeof(data))
+            .CopyOutArgumentBuffer(3, &size, sizeof(size))
+            .SetReturn((MAPPED_FILE_HANDLE)0x42);
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_clone(set));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MappedFile_Close((MAPPED_FILE_HANDLE)0x42));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromMappedFile("firmware.bin", set);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        PropertySet_Destroy(set);
+    }
+
+    /*Tests_SRS_MESSAGE_17_057: [ If message is NULL then Message_GetTypedProperty shall return NULL. ]*/
+    /*Tests_SRS_MESSAGE_17_059: [ If message is NULL then Message_GetTypedPropertyById shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetTypedProperty_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        const MESSAGE_PROPERTY_VALUE* result1 = Message_GetTypedProperty(NULL, "bleControllerIndex");
+        const MESSAGE_PROPERTY_VALUE* result2 = Message_GetTypedPropertyById(NULL, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX);
+
+        ///assert
+        ASSERT_IS_NULL(result1);
+        ASSERT_IS_NULL(result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_058: [ Otherwise, Message_GetTypedProperty shall return the value MESSAGE_PROPERTIES_get_typed finds for name. ]*/
+    /*Tests_SRS_MESSAGE_17_060: [ Otherwise, Message_GetTypedPropertyById shall return the value MESSAGE_PROPERTIES_get_typed_by_id finds for id. ]*/
+    TEST_FUNCTION(Message_GetTypedProperty_returns_the_value_of_the_property_set)
+    {
+        ///arrange
+        MESSAGE_TYPED_CONFIG c = { 0, NULL, NULL, 0 };
+        MESSAGE_HANDLE handle = Message_CreateTyped(&c);
+        const MESSAGE_PROPERTY_VALUE value = { MESSAGE_PROPERTY_TYPE_INT64, { .integer = -12 } };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_typed(IGNORED_PTR_ARG, "bleControllerIndex"))
+            .IgnoreArgument_handle()
+            .SetReturn(&value);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_typed_by_id(IGNORED_PTR_ARG, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX))
+            .IgnoreArgument_handle()
+            .SetReturn(&value);
+
+        ///act
+        const MESSAGE_PROPERTY_VALUE* result1 = Message_GetTypedProperty(handle, "bleControllerIndex");
+        const MESSAGE_PROPERTY_VALUE* result2 = Message_GetTypedPropertyById(handle, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, &value, result1);
+        ASSERT_ARE_EQUAL(void_ptr, &value, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_063: [ If a property of the message is not a string, Message_ToByteArray shall write version 3 of the serialized form instead, where every value starts with its type, and bytes and numbers are written in binary. ]*/
+    TEST_FUNCTION(Message_ToByteArray_writes_version_3_for_typed_values)
+    {
+        ///arrange
+        unsigned char buf[sizeof(notFail__typedProperty_1bytes_v3)];
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+        umock_c_reset_all_calls();
+
+        MESSAGE_PROPERTY property = { "bleControllerIndex", 18, NULL, 0, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX + 1 };
+        property.typed.type = MESSAGE_PROPERTY_TYPE_INT64;
+        property.typed.value.integer = -12;
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"3", 1 };
+
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+
+        ///act
+        int32_t nbytes = Message_ToByteArray(messageHandle, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__typedProperty_1bytes_v3), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__typedProperty_1bytes_v3, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_095: [ If messageHandle is NULL, buf is NULL and size is not zero, or version is not a GATEWAY_MESSAGE_VERSION, Message_ToByteArrayVersion shall fail and return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayVersion_fails_with_unknown_version)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+        umock_c_reset_all_calls();
+
+        ///act
+        int32_t nbytes1 = Message_ToByteArrayVersion(messageHandle, 0, NULL, 0);
+        int32_t nbytes2 = Message_ToByteArrayVersion(messageHandle, GATEWAY_MESSAGE_VERSION_CURRENT + 1, NULL, 0);
+        int32_t nbytes3 = Message_ToByteArrayVersion(NULL, GATEWAY_MESSAGE_VERSION_1, NULL, 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes1);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes2);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_100: [ For GATEWAY_MESSAGE_VERSION_1, Message_ToByteArrayVersion shall write the header, 4 byte sizes and counts, and null terminated names and values of version 1. ]*/
+    /*Tests_SRS_MESSAGE_17_102: [ Otherwise Message_ToByteArrayVersion shall succeed, and return the byte array size. ]*/
+    TEST_FUNCTION(Message_ToByteArrayVersion_writes_version_1)
+    {
+        ///arrange
+        unsigned char buf[sizeof(notFail__2Property_2bytes)];
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        umock_c_reset_all_calls();
+
+        const MESSAGE_PROPERTY properties[] =
+        {
+            { "BleedingEdge", 12, "rocks", 5 },
+            { "Azure IoT Gateway is", 20, "awesome", 7 }
+        };
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(2);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(2); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[0]);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_handle()
+            .SetReturn(&properties[1]);
+
+        ///act
+        int32_t nbytes = Message_ToByteArrayVersion(messageHandle, GATEWAY_MESSAGE_VERSION_1, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_2bytes, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_097: [ Otherwise, Message_ToByteArrayVersion shall write every value as a string, turning a value that is not one into a string as Message_GetProperty does, and fail and return -1 if that fails. ]*/
+    TEST_FUNCTION(Message_ToByteArrayVersion_writes_typed_values_as_strings)
+    {
+        ///arrange
+        static const unsigned char expected[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 38,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            'b','l','e','C','o','n','t','r','o','l','l','e','r','I','n','d','e','x','\0','-','1','2','\0',
+            0x00, 0x00, 0x00, 0x01, /*1 message content size*/
+            '3'
+        };
+        unsigned char buf[sizeof(expected)];
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+        umock_c_reset_all_calls();
+
+        MESSAGE_PROPERTY property = { "bleControllerIndex", 18, NULL, 0, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX + 1 };
+        property.typed.type = MESSAGE_PROPERTY_TYPE_INT64;
+        property.typed.value.integer = -12;
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"3", 1 };
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get(IGNORED_PTR_ARG, "bleControllerIndex"))
+            .IgnoreArgument_handle()
+            .SetReturn("-12");
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_count(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .SetReturn(1); /*second pass writes the properties*/
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get_at(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_handle()
+            .SetReturn(&property);
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_get(IGNORED_PTR_ARG, "bleControllerIndex"))
+            .IgnoreArgument_handle()
+            .SetReturn("-12");
+
+        ///act
+        int32_t nbytes = Message_ToByteArrayVersion(messageHandle, GATEWAY_MESSAGE_VERSION_1, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(expected), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, expected, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_062: [ Message_CreateFromOwnedByteArray shall create the property set of version 3 of the serialized form with MESSAGE_PROPERTIES_create_borrowed_v3. ]*/
+    TEST_FUNCTION(Message_CreateFromOwnedByteArray_borrows_version_3_properties)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v3(notFail__typedProperty_1bytes_v3 + 8, 1));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromOwnedByteArray(notFail__typedProperty_1bytes_v3, sizeof(notFail__typedProperty_1bytes_v3), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v2_call);
+        const CONSTBUFFER* content = Message_GetContent(handle);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__typedProperty_1bytes_v3 + 19, content->buffer);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If source holds version 2 or 3 of the serialized form, Message_CreateFromByteArray shall copy it into a block from MESSAGE_POOL_alloc and create the message on the copy as Message_CreateFromOwnedByteArray does, with MESSAGE_POOL_free as release. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_copies_a_version_3_byte_array)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(sizeof(notFail__typedProperty_1bytes_v3)));
+        STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MESSAGE_PROPERTIES_create_borrowed_v3(IGNORED_PTR_ARG, 1))
+            .IgnoreArgument_encoded();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__typedProperty_1bytes_v3, sizeof(notFail__typedProperty_1bytes_v3));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "3", 1));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_061: [ If a value of a version 3 byte array has a type that is not a MESSAGE_PROPERTY_TYPE, or does not fit in the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_3_with_unknown_type_fails)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreAllCalls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_unknownPropertyType_v3, sizeof(fail_unknownPropertyType_v3));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v3_call);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_061: [ If a value of a version 3 byte array has a type that is not a MESSAGE_PROPERTY_TYPE, or does not fit in the array, Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_3_with_truncated_value_fails)
+    {
+        ///arrange
+        EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+            .IgnoreAllCalls();
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_truncatedPropertyValue_v3, sizeof(fail_truncatedPropertyValue_v3));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, currentMESSAGE_PROPERTIES_create_borrowed_v3_call);
+
+        ///cleanup
+    }
+
 END_TEST_SUITE(gwmessage_ut)
@@ -0,0 +1,347 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "message.h"
+
+#undef ENABLE_MOCKS
+
+#include "link_filter.h"
+
+#define TEST_MESSAGE ((MESSAGE_HANDLE)0x42)
+#define TEST_MAX_PROPERTIES 4
+
+static const char* property_keys[TEST_MAX_PROPERTIES];
+static const char* property_values[TEST_MAX_PROPERTIES];
+static size_t property_count;
+
+static void set_property(const char* key, const char* value)
+{
+    property_keys[property_count] = key;
+    property_values[property_count] = value;
+    property_count++;
+}
+
+static const char* my_Message_GetProperty(MESSAGE_HANDLE message, const char* name)
+{
+    const char* result = NULL;
+    size_t i;
+    (void)message;
+    for (i = 0; i < property_count && result == NULL; i++)
+    {
+        if (strcmp(property_keys[i], name) == 0)
+        {
+            result = property_values[i];
+        }
+    }
+    return result;
+}
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static bool filter_matches(const char* expression)
+{
+    bool result;
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create(expression);
+    ASSERT_IS_NOT_NULL(filter);
+    result = LINK_FILTER_matches(filter, TEST_MESSAGE);
+    LINK_FILTER_destroy(filter);
+    return result;
+}
+
+BEGIN_TEST_SUITE(link_filter_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // message properties
+    REGISTER_GLOBAL_MOCK_HOOK(Message_GetProperty, my_Message_GetProperty);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    property_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_LINK_FILTER_17_001: [ LINK_FILTER_create shall return NULL if expression is NULL or longer than 65536 characters. ]*/
+TEST_FUNCTION(LINK_FILTER_create_fails_with_null_expression)
+{
+    ///arrange
+
+    ///act
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_002: [ LINK_FILTER_create shall allocate the filter, room for one node per character of expression and a copy of its strings in a single block. ]*/
+/*Tests_SRS_LINK_FILTER_17_004: [ LINK_FILTER_create shall compile expression according to the filter grammar. ]*/
+TEST_FUNCTION(LINK_FILTER_create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create("properties.source == \"bleTelemetry\" && properties.macAddress in [\"01:02:03:03:02:01\", \"AA:BB:CC:DD:EE:FF\"]");
+
+    ///assert
+    ASSERT_IS_NOT_NULL(filter);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    LINK_FILTER_destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_17_003: [ LINK_FILTER_create shall return NULL if it cannot allocate the filter. ]*/
+TEST_FUNCTION(LINK_FILTER_create_fails_when_malloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create("properties.source");
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_005: [ LINK_FILTER_create shall return NULL if expression does not follow the grammar, or nests parentheses and negations more than 32 deep. ]*/
+TEST_FUNCTION(LINK_FILTER_create_rejects_invalid_expressions)
+{
+    ///arrange
+    static const char* invalid[] =
+    {
+        "",
+        "source == \"ble\"",
+        "properties.",
+        "properties.source ==",
+        "properties.source == ble",
+        "properties.source == \"ble",
+        "properties.source = \"ble\"",
+        "properties.source in []",
+        "properties.source in [\"a\",]",
+        "properties.source in [\"a\"",
+        "properties.source &&",
+        "(properties.source",
+        "properties.source)",
+        "properties[source]",
+        "properties.source properties.name",
+        "propertiesX.source",
+        "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!properties.source"
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        ///act
+        LINK_FILTER_HANDLE filter = LINK_FILTER_create(invalid[i]);
+
+        ///assert
+        ASSERT_IS_NULL(filter);
+    }
+
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_006: [ LINK_FILTER_destroy shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(LINK_FILTER_destroy_does_nothing_with_null)
+{
+    ///arrange
+
+    ///act
+    LINK_FILTER_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_007: [ LINK_FILTER_destroy shall free the filter. ]*/
+TEST_FUNCTION(LINK_FILTER_destroy_frees_the_filter)
+{
+    ///arrange
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create("properties.source");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    LINK_FILTER_destroy(filter);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_008: [ LINK_FILTER_matches shall return false if handle or message is NULL. ]*/
+TEST_FUNCTION(LINK_FILTER_matches_returns_false_with_null_params)
+{
+    ///arrange
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create("!properties.source");
+    umock_c_reset_all_calls();
+
+    ///act
+    bool result1 = LINK_FILTER_matches(NULL, TEST_MESSAGE);
+    bool result2 = LINK_FILTER_matches(filter, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    LINK_FILTER_destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_17_010: [ LINK_FILTER_matches shall return whether the properties satisfy the filter: a property alone is true when the message has it, == and != compare its value with a string, in tests it against a list of strings, and !, && and || combine tests, evaluating operands only as far as needed. ]*/
+/*Tests_SRS_LINK_FILTER_17_009: [ LINK_FILTER_matches shall look up every property it tests with Message_GetProperty. ]*/
+TEST_FUNCTION(LINK_FILTER_matches_evaluates_the_filter_once)
+{
+    ///arrange
+    LINK_FILTER_HANDLE filter = LINK_FILTER_create("properties.source == \"ble\" || properties.macAddress");
+    umock_c_reset_all_calls();
+    set_property("source", "ble");
+
+    STRICT_EXPECTED_CALL(Message_GetProperty(TEST_MESSAGE, "source"));
+
+    ///act
+    bool result = LINK_FILTER_matches(filter, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    LINK_FILTER_destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_17_010: [ LINK_FILTER_matches shall return whether the properties satisfy the filter: a property alone is true when the message has it, == and != compare its value with a string, in tests it against a list of strings, and !, && and || combine tests, evaluating operands only as far as needed. ]*/
+TEST_FUNCTION(LINK_FILTER_matches_compares_properties)
+{
+    ///arrange
+    set_property("source", "bleTelemetry");
+    set_property("macAddress", "AA:BB:CC:DD:EE:FF");
+    set_property("odd key", "say \"hi\"");
+
+    ///act
+    ///assert
+    ASSERT_IS_TRUE(filter_matches("properties.source"));
+    ASSERT_IS_FALSE(filter_matches("properties.missing"));
+    ASSERT_IS_TRUE(filter_matches("properties.source == \"bleTelemetry\""));
+    ASSERT_IS_FALSE(filter_matches("properties.source == \"ble\""));
+    ASSERT_IS_FALSE(filter_matches("properties.missing == \"\""));
+    ASSERT_IS_TRUE(filter_matches("properties.source != \"ble\""));
+    ASSERT_IS_TRUE(filter_matches("properties.missing != \"ble\""));
+    ASSERT_IS_TRUE(filter_matches("properties.macAddress in [\"01:02:03:03:02:01\", \"AA:BB:CC:DD:EE:FF\"]"));
+    ASSERT_IS_FALSE(filter_matches("properties.macAddress in [\"01:02:03:03:02:01\"]"));
+    ASSERT_IS_FALSE(filter_matches("properties.missing in [\"01:02:03:03:02:01\"]"));
+    ASSERT_IS_TRUE(filter_matches("properties[\"odd key\"] == \"say \\\"hi\\\"\""));
+    ///ablutions
+}
+
+/*Tests_SRS_LINK_FILTER_17_010: [ LINK_FILTER_matches shall return whether the properties satisfy the filter: a property alone is true when the message has it, == and != compare its value with a string, in tests it against a list of strings, and !, && and || combine tests, evaluating operands only as far as needed. ]*/
+TEST_FUNCTION(LINK_FILTER_matches_combines_tests)
+{
+    ///arrange
+    set_property("source", "bleTelemetry");
+    set_property("macAddress", "AA:BB:CC:DD:EE:FF");
+
+    ///act
+    ///assert
+    ASSERT_IS_FALSE(filter_matches("!properties.source"));
+    ASSERT_IS_TRUE(filter_matches("!!properties.source"));
+    ASSERT_IS_TRUE(filter_matches("properties.source && properties.macAddress"));
+    ASSERT_IS_FALSE(filter_matches("properties.source && properties.macAddress && properties.missing"));
+    ASSERT_IS_TRUE(filter_matches("properties.missing || properties.other || properties.macAddress"));
+    ASSERT_IS_FALSE(filter_matches("properties.missing || properties.other"));
+    ASSERT_IS_TRUE(filter_matches("properties.missing && properties.other || properties.source"));
+    ASSERT_IS_FALSE(filter_matches("properties.missing && (properties.other || properties.source)"));
+    ASSERT_IS_TRUE(filter_matches("  ( properties.source==\"bleTelemetry\" )&&!(properties.missing)  "));
+    ///ablutions
+}
+
+END_TEST_SUITE(link_filter_ut)
@@ -0,0 +1,585 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#include "message.h"
+#include "message_pool.h"
+
+/*objects created before a timed loop and destroyed after it*/
+#define BENCH_BATCH 256
+#define BENCH_DEFAULT_ITERATIONS 50000
+#define BENCH_MAX_PROPERTIES 16
+
+static const size_t property_counts[] = { 0, 1, 4, 16 };
+static const size_t payload_sizes[] = { 0, 64, 1024, 16384 };
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+/*glibc lets the executable take over malloc for the whole process, which
+ *counts the blocks the shared utilities take from the heap as well*/
+#if defined(__GLIBC__) && !defined(MESSAGE_BENCH_NO_HEAP_COUNT)
+#define BENCH_COUNTS_HEAP 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* block, size_t size);
+
+static uint64_t heap_allocations;
+
+void* malloc(size_t size)
+{
+    heap_allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    heap_allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* block, size_t size)
+{
+    heap_allocations++;
+    return __libc_realloc(block, size);
+}
+#else
+#define BENCH_COUNTS_HEAP 0
+static uint64_t heap_allocations;
+#endif
+
+typedef struct BENCH_RESULT_TAG
+{
+    const char* name;
+    size_t properties;
+    size_t payload;
+    uint64_t ops;
+    double ns_per_op;
+    double pool_allocations_per_op;
+    double heap_allocations_per_op;
+} BENCH_RESULT;
+
+typedef struct BENCH_CASE_TAG
+{
+    size_t property_count;
+    size_t payload_size;
+    MAP_HANDLE map;
+    unsigned char* payload;
+    MESSAGE_HANDLE message;
+    unsigned char* serialized;
+    int32_t serialized_size;
+    char keys[BENCH_MAX_PROPERTIES][16];
+} BENCH_CASE;
+
+typedef struct BENCH_COUNTERS_TAG
+{
+    uint64_t nanoseconds;
+    uint64_t pool_allocations;
+    uint64_t heap_allocations;
+} BENCH_COUNTERS;
+
+static uint64_t bench_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+    {
+        (void)QueryPerformanceFrequency(&frequency);
+    }
+    (void)QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static uint64_t bench_pool_allocations(void)
+{
+    MESSAGE_POOL_STATISTICS statistics;
+    uint64_t result;
+    if (MESSAGE_POOL_get_statistics(&statistics) != 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        result = statistics.thread_hits + statistics.shared_hits + statistics.misses + statistics.oversized;
+    }
+    return result;
+}
+
+static void bench_start(BENCH_COUNTERS* counters)
+{
+    counters->pool_allocations = bench_pool_allocations();
+    counters->heap_allocations = heap_allocations;
+    counters->nanoseconds = bench_now_ns();
+}
+
+static void bench_stop(BENCH_COUNTERS* counters, BENCH_COUNTERS* total)
+{
+    uint64_t now = bench_now_ns();
+    total->nanoseconds += now - counters->nanoseconds;
+    total->heap_allocations += heap_allocations - counters->heap_allocations;
+    total->pool_allocations += bench_pool_allocations() - counters->pool_allocations;
+}
+
+/*the timed part of a benchmark runs over a batch of objects the untimed
+ *prepare makes and the untimed cleanup destroys; a run that fails destroys
+ *the batch itself*/
+typedef bool(*BENCH_PREPARE)(BENCH_CASE* benchCase, void** objects, size_t count);
+typedef bool(*BENCH_RUN)(BENCH_CASE* benchCase, void** objects, size_t count);
+typedef void(*BENCH_CLEANUP)(BENCH_CASE* benchCase, void** objects, size_t count);
+
+typedef struct BENCHMARK_TAG
+{
+    const char* name;
+    BENCH_PREPARE prepare;
+    BENCH_RUN run;
+    BENCH_CLEANUP cleanup;
+} BENCHMARK;
+
+static void destroy_messages(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    (void)benchCase;
+    for (i = 0; i < count; i++)
+    {
+        Message_Destroy((MESSAGE_HANDLE)objects[i]);
+    }
+}
+
+static void destroy_constmaps(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    (void)benchCase;
+    for (i = 0; i < count; i++)
+    {
+        ConstMap_Destroy((CONSTMAP_HANDLE)objects[i]);
+    }
+}
+
+static bool prepare_nothing(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    (void)benchCase;
+    (void)objects;
+    (void)count;
+    return true;
+}
+
+static bool prepare_messages(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    MESSAGE_CONFIG config;
+    size_t i;
+    bool result = true;
+    config.size = benchCase->payload_size;
+    config.source = benchCase->payload;
+    config.sourceProperties = benchCase->map;
+    for (i = 0; i < count; i++)
+    {
+        if ((objects[i] = Message_Create(&config)) == NULL)
+        {
+            destroy_messages(benchCase, objects, i);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+static bool run_Message_Create(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    return prepare_messages(benchCase, objects, count);
+}
+
+static bool run_Message_Clone(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    bool result = true;
+    for (i = 0; i < count; i++)
+    {
+        if ((objects[i] = Message_Clone(benchCase->message)) == NULL)
+        {
+            destroy_messages(benchCase, objects, i);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+/*every message in the batch is new, so this measures serialization rather
+ *than copying a serialized form kept from an earlier call*/
+static bool run_Message_ToByteArray(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    bool result = true;
+    for (i = 0; i < count; i++)
+    {
+        if (Message_ToByteArray((MESSAGE_HANDLE)objects[i], benchCase->serialized, benchCase->serialized_size) != benchCase->serialized_size)
+        {
+            destroy_messages(benchCase, objects, count);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+static bool run_Message_CreateFromByteArray(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    bool result = true;
+    for (i = 0; i < count; i++)
+    {
+        if ((objects[i] = Message_CreateFromByteArray(benchCase->serialized, benchCase->serialized_size)) == NULL)
+        {
+            destroy_messages(benchCase, objects, i);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+/*every message in the batch is new, so this includes building the map;
+ *the maps go in the second half of the batch*/
+static bool run_Message_GetProperties(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    size_t i;
+    bool result = true;
+    for (i = 0; i < count; i++)
+    {
+        if ((objects[count + i] = Message_GetProperties((MESSAGE_HANDLE)objects[i])) == NULL)
+        {
+            destroy_constmaps(benchCase, objects + count, i);
+            destroy_messages(benchCase, objects, count);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+static void cleanup_messages_and_constmaps(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    destroy_constmaps(benchCase, objects + count, count);
+    destroy_messages(benchCase, objects, count);
+}
+
+static bool prepare_constmap(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    (void)count;
+    objects[0] = Message_GetProperties(benchCase->message);
+    return objects[0] != NULL;
+}
+
+static bool run_ConstMap_GetValue(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    CONSTMAP_HANDLE properties = (CONSTMAP_HANDLE)objects[0];
+    size_t i;
+    bool result = true;
+    for (i = 0; i < count; i++)
+    {
+        /*with no properties every lookup misses*/
+        const char* key = (benchCase->property_count == 0) ? "property0" : benchCase->keys[i % benchCase->property_count];
+        if ((ConstMap_GetValue(properties, key) == NULL) != (benchCase->property_count == 0))
+        {
+            ConstMap_Destroy(properties);
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+static void cleanup_constmap(BENCH_CASE* benchCase, void** objects, size_t count)
+{
+    (void)count;
+    destroy_constmaps(benchCase, objects, 1);
+}
+
+static const BENCHMARK benchmarks[] =
+{
+    { "Message_Create", prepare_nothing, run_Message_Create, destroy_messages },
+    { "Message_Clone", prepare_nothing, run_Message_Clone, destroy_messages },
+    { "Message_ToByteArray", prepare_messages, run_Message_ToByteArray, destroy_messages },
+    { "Message_CreateFromByteArray", prepare_nothing, run_Message_CreateFromByteArray, destroy_messages },
+    { "Message_GetProperties", prepare_messages, run_Message_GetProperties, cleanup_messages_and_constmaps },
+    { "ConstMap_GetValue", prepare_constmap, run_ConstMap_GetValue, cleanup_constmap }
+};
+
+static int bench_case_create(BENCH_CASE* benchCase, size_t property_count, size_t payload_size)
+{
+    int result;
+    MESSAGE_CONFIG config;
+    size_t i;
+
+    memset(benchCase, 0, sizeof(*benchCase));
+    benchCase->property_count = property_count;
+    benchCase->payload_size = payload_size;
+    if ((benchCase->map = Map_Create(NULL)) == NULL ||
+        (benchCase->payload = (unsigned char*)malloc(payload_size + 1)) == NULL)
+    {
+        (void)fprintf(stderr, "out of memory\n");
+        result = __LINE__;
+    }
+    else
+    {
+        memset(benchCase->payload, 'x', payload_size);
+        result = 0;
+        for (i = 0; i < property_count; i++)
+        {
+            char value[32];
+            (void)sprintf(benchCase->keys[i], "property%u", (unsigned int)i);
+            (void)sprintf(value, "value of property %u", (unsigned int)i);
+            if (Map_Add(benchCase->map, benchCase->keys[i], value) != MAP_OK)
+            {
+                (void)fprintf(stderr, "unable to add %s\n", benchCase->keys[i]);
+                result = __LINE__;
+                break;
+            }
+        }
+
+        if (result == 0)
+        {
+            config.size = payload_size;
+            config.source = benchCase->payload;
+            config.sourceProperties = benchCase->map;
+            if ((benchCase->message = Message_Create(&config)) == NULL ||
+                (benchCase->serialized_size = Message_ToByteArray(benchCase->message, NULL, 0)) <= 0 ||
+                (benchCase->serialized = (unsigned char*)malloc((size_t)benchCase->serialized_size)) == NULL ||
+                Message_ToByteArray(benchCase->message, benchCase->serialized, benchCase->serialized_size) != benchCase->serialized_size)
+            {
+                (void)fprintf(stderr, "unable to create the message with %u properties and %u bytes\n", (unsigned int)property_count, (unsigned int)payload_size);
+                result = __LINE__;
+            }
+        }
+    }
+    return result;
+}
+
+static void bench_case_destroy(BENCH_CASE* benchCase)
+{
+    if (benchCase->message != NULL)
+    {
+        Message_Destroy(benchCase->message);
+    }
+    if (benchCase->map != NULL)
+    {
+        Map_Destroy(benchCase->map);
+    }
+    free(benchCase->serialized);
+    free(benchCase->payload);
+}
+
+static int bench_run(const BENCHMARK* benchmark, BENCH_CASE* benchCase, uint64_t iterations, BENCH_RESULT* result)
+{
+    void* objects[2 * BENCH_BATCH];
+    BENCH_COUNTERS start;
+    BENCH_COUNTERS total;
+    uint64_t ops = 0;
+    bool warm = false;
+    int error = 0;
+
+    memset(&total, 0, sizeof(total));
+    while (error == 0 && ops < iterations)
+    {
+        size_t batch = (iterations - ops < BENCH_BATCH) ? (size_t)(iterations - ops) : BENCH_BATCH;
+        if (!benchmark->prepare(benchCase, objects, batch))
+        {
+            error = __LINE__;
+        }
+        else
+        {
+            bench_start(&start);
+            if (!benchmark->run(benchCase, objects, batch))
+            {
+                error = __LINE__;
+            }
+            else
+            {
+                /*the first batch only warms up caches and the pool*/
+                if (warm)
+                {
+                    bench_stop(&start, &total);
+                    ops += batch;
+                }
+                warm = true;
+                benchmark->cleanup(benchCase, objects, batch);
+            }
+        }
+    }
+
+    if (error != 0)
+    {
+        (void)fprintf(stderr, "%s failed with %u properties and %u bytes\n", benchmark->name, (unsigned int)benchCase->property_count, (unsigned int)benchCase->payload_size);
+    }
+    else
+    {
+        result->name = benchmark->name;
+        result->properties = benchCase->property_count;
+        result->payload = benchCase->payload_size;
+        result->ops = ops;
+        result->ns_per_op = (double)total.nanoseconds / (double)ops;
+        result->pool_allocations_per_op = (double)total.pool_allocations / (double)ops;
+        result->heap_allocations_per_op = (double)total.heap_allocations / (double)ops;
+    }
+    return error;
+}
+
+static void bench_write_json(FILE* out, const BENCH_RESULT* results, size_t count, uint64_t iterations)
+{
+    size_t i;
+    (void)fprintf(out, "{\n");
+    (void)fprintf(out, "  \"benchmark\": \"message_bench\",\n");
+    (void)fprintf(out, "  \"iterations\": %llu,\n", (unsigned long long)iterations);
+    (void)fprintf(out, "  \"heap_allocations_counted\": %s,\n", BENCH_COUNTS_HEAP ? "true" : "false");
+    (void)fprintf(out, "  \"results\": [\n");
+    for (i = 0; i < count; i++)
+    {
+        (void)fprintf(out, "    { \"name\": \"%s\", \"properties\": %u, \"payload\": %u, \"ops\": %llu, \"ns_per_op\": %.2f, \"pool_allocations_per_op\": %.3f, ",
+            results[i].name, (unsigned int)results[i].properties, (unsigned int)results[i].payload,
+            (unsigned long long)results[i].ops, results[i].ns_per_op, results[i].pool_allocations_per_op);
+        if (BENCH_COUNTS_HEAP)
+        {
+            (void)fprintf(out, "\"heap_allocations_per_op\": %.3f }", results[i].heap_allocations_per_op);
+        }
+        else
+        {
+            (void)fprintf(out, "\"heap_allocations_per_op\": null }");
+        }
+        (void)fprintf(out, "%s\n", (i + 1 < count) ? "," : "");
+    }
+    (void)fprintf(out, "  ]\n");
+    (void)fprintf(out, "}\n");
+}
+
+static void usage(const char* program)
+{
+    (void)fprintf(stderr, "usage: %s [--iterations <count>] [--output <file.json>]\n", program);
+    (void)fprintf(stderr, "  --iterations  operations measured per benchmark and case (default %u)\n", (unsigned int)BENCH_DEFAULT_ITERATIONS);
+    (void)fprintf(stderr, "  --output      file the JSON report is written to (default stdout)\n");
+}
+
+int main(int argc, char** argv)
+{
+    int result = 0;
+    uint64_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char* output = NULL;
+    int i;
+
+    for (i = 1; i < argc && result == 0; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            char* end;
+            iterations = strtoull(argv[++i], &end, 10);
+            if (*end != '\0' || iterations == 0)
+            {
+                usage(argv[0]);
+                result = 1;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            result = 1;
+        }
+    }
+
+    if (result == 0)
+    {
+        size_t capacity = COUNT_OF(property_counts) * COUNT_OF(payload_sizes) * COUNT_OF(benchmarks);
+        BENCH_RESULT* results = (BENCH_RESULT*)malloc(capacity * sizeof(BENCH_RESULT));
+        size_t count = 0;
+        if (results == NULL)
+        {
+            (void)fprintf(stderr, "out of memory\n");
+            result = 1;
+        }
+        else
+        {
+            size_t p;
+            size_t s;
+            size_t b;
+            (void)fprintf(stderr, "%-28s %5s %7s %12s %12s %12s\n", "benchmark", "props", "payload", "ns/op", "pool/op", "heap/op");
+            for (p = 0; p < COUNT_OF(property_counts) && result == 0; p++)
+            {
+                for (s = 0; s < COUNT_OF(payload_sizes) && result == 0; s++)
+                {
+                    BENCH_CASE benchCase;
+                    if (bench_case_create(&benchCase, property_counts[p], payload_sizes[s]) != 0)
+                    {
+                        result = 1;
+                    }
+                    else
+                    {
+                        for (b = 0; b < COUNT_OF(benchmarks) && result == 0; b++)
+                        {
+                            if (bench_run(&benchmarks[b], &benchCase, iterations, &results[count]) != 0)
+                            {
+                                result = 1;
+                            }
+                            else
+                            {
+                                (void)fprintf(stderr, "%-28s %5u %7u %12.1f %12.3f ",
+                                    results[count].name, (unsigned int)results[count].properties, (unsigned int)results[count].payload,
+                                    results[count].ns_per_op, results[count].pool_allocations_per_op);
+                                if (BENCH_COUNTS_HEAP)
+                                {
+                                    (void)fprintf(stderr, "%12.3f\n", results[count].heap_allocations_per_op);
+                                }
+                                else
+                                {
+                                    (void)fprintf(stderr, "%12s\n", "n/a");
+                                }
+                                count++;
+                            }
+                        }
+                    }
+                    bench_case_destroy(&benchCase);
+                }
+            }
+
+            if (result == 0)
+            {
+                FILE* out = (output == NULL) ? stdout : fopen(output, "w");
+                if (out == NULL)
+                {
+                    (void)fprintf(stderr, "unable to open %s\n", output);
+                    result = 1;
+                }
+                else
+                {
+                    bench_write_json(out, results, count, iterations);
+                    if (out != stdout)
+                    {
+                        (void)fclose(out);
+                    }
+                }
+            }
+            free(results);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,342 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "message_pool.h"
+
+/*The pool is process wide and keeps its slabs, so every test only looks at
+ *what changes while it runs, and the tests that need an empty size class
+ *each use a class no other test touches.
+ */
+#define SMALL_BLOCK 24      /*32 byte class, used to make sure the thread has a cache*/
+#define REUSED_BLOCK 48     /*64 byte class*/
+#define FAILING_BLOCK 100   /*128 byte class*/
+#define CARVED_BLOCK 200    /*256 byte class*/
+#define OVERSIZED_BLOCK 1000
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static MESSAGE_POOL_STATISTICS read_statistics(void)
+{
+    MESSAGE_POOL_STATISTICS result;
+    int status = MESSAGE_POOL_get_statistics(&result);
+    ASSERT_ARE_EQUAL(int, 0, status);
+    return result;
+}
+
+static void make_thread_cache(void)
+{
+    MESSAGE_POOL_free(MESSAGE_POOL_alloc(SMALL_BLOCK));
+    umock_c_reset_all_calls();
+}
+
+BEGIN_TEST_SUITE(message_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_001: [ MESSAGE_POOL_alloc shall return a block of at least size bytes, aligned for pointers and 64 bit integers. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_returns_aligned_blocks)
+{
+    ///arrange
+    make_thread_cache();
+
+    ///act
+    unsigned char* block1 = (unsigned char*)MESSAGE_POOL_alloc(SMALL_BLOCK);
+    unsigned char* block2 = (unsigned char*)MESSAGE_POOL_alloc(SMALL_BLOCK);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(block1);
+    ASSERT_IS_NOT_NULL(block2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, block1, block2);
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)((uintptr_t)block1 % sizeof(uint64_t)));
+    ASSERT_ARE_EQUAL(size_t, 0, (size_t)((uintptr_t)block2 % sizeof(uint64_t)));
+    memset(block1, 0xA1, SMALL_BLOCK);
+    memset(block2, 0x60, SMALL_BLOCK);
+    ASSERT_ARE_EQUAL(int, 0xA1, block1[SMALL_BLOCK - 1]);
+
+    ///ablutions
+    MESSAGE_POOL_free(block1);
+    MESSAGE_POOL_free(block2);
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_004: [ MESSAGE_POOL_alloc shall take a block of the smallest size class that fits size from the calling thread's cache. ]*/
+/*Tests_SRS_MESSAGE_POOL_17_009: [ MESSAGE_POOL_free shall put a pooled block in the calling thread's cache and, once the cache holds more than 64 blocks of the class, give a batch of 32 to the shared lists. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_reuses_block_freed_on_the_same_thread)
+{
+    ///arrange
+    make_thread_cache();
+    void* freed = MESSAGE_POOL_alloc(REUSED_BLOCK);
+    MESSAGE_POOL_free(freed);
+    umock_c_reset_all_calls();
+    MESSAGE_POOL_STATISTICS before = read_statistics();
+
+    ///act
+    void* block = MESSAGE_POOL_alloc(REUSED_BLOCK);
+
+    ///assert
+    MESSAGE_POOL_STATISTICS after = read_statistics();
+    ASSERT_ARE_EQUAL(void_ptr, freed, block);
+    ASSERT_IS_TRUE(after.thread_hits == before.thread_hits + 1);
+    ASSERT_IS_TRUE(after.misses == before.misses);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_POOL_free(block);
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_005: [ If the thread's cache has no block of that class, MESSAGE_POOL_alloc shall move a batch of blocks freed by other threads into it. ]*/
+/*Tests_SRS_MESSAGE_POOL_17_009: [ MESSAGE_POOL_free shall put a pooled block in the calling thread's cache and, once the cache holds more than 64 blocks of the class, give a batch of 32 to the shared lists. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_takes_back_batches_given_to_the_shared_lists)
+{
+    ///arrange
+    void* blocks[200];
+    size_t i;
+    make_thread_cache();
+    for (i = 0; i < 200; i++)
+    {
+        blocks[i] = MESSAGE_POOL_alloc(REUSED_BLOCK);
+        ASSERT_IS_NOT_NULL(blocks[i]);
+    }
+    for (i = 0; i < 200; i++)
+    {
+        MESSAGE_POOL_free(blocks[i]);
+    }
+    umock_c_reset_all_calls();
+    MESSAGE_POOL_STATISTICS before = read_statistics();
+
+    ///act
+    for (i = 0; i < 200; i++)
+    {
+        blocks[i] = MESSAGE_POOL_alloc(REUSED_BLOCK);
+    }
+
+    ///assert
+    MESSAGE_POOL_STATISTICS after = read_statistics();
+    ASSERT_IS_TRUE(after.shared_hits > before.shared_hits);
+    ASSERT_IS_TRUE(after.misses == before.misses);
+    ASSERT_IS_TRUE(after.thread_hits + after.shared_hits == before.thread_hits + before.shared_hits + 200);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    for (i = 0; i < 200; i++)
+    {
+        MESSAGE_POOL_free(blocks[i]);
+    }
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_006: [ If there is no such batch, MESSAGE_POOL_alloc shall carve a new slab of 64 blocks into the thread's cache. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_carves_a_slab_for_an_empty_class)
+{
+    ///arrange
+    make_thread_cache();
+    MESSAGE_POOL_STATISTICS before = read_statistics();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    void* block = MESSAGE_POOL_alloc(CARVED_BLOCK);
+
+    ///assert
+    MESSAGE_POOL_STATISTICS after = read_statistics();
+    ASSERT_IS_NOT_NULL(block);
+    ASSERT_IS_TRUE(after.misses == before.misses + 1);
+    ASSERT_IS_TRUE(after.slab_bytes - before.slab_bytes >= 64 * 256);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_POOL_free(block);
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_003: [ MESSAGE_POOL_alloc shall return NULL if it cannot allocate memory. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_fails_when_slab_cannot_be_allocated)
+{
+    ///arrange
+    make_thread_cache();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    void* block = MESSAGE_POOL_alloc(FAILING_BLOCK);
+
+    ///assert
+    ASSERT_IS_NULL(block);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_002: [ MESSAGE_POOL_alloc shall pass requests larger than 256 bytes, or made when the pool cannot keep a cache for the calling thread, to malloc. ]*/
+/*Tests_SRS_MESSAGE_POOL_17_008: [ MESSAGE_POOL_free shall free a block that was passed to malloc. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_passes_oversized_requests_to_malloc)
+{
+    ///arrange
+    make_thread_cache();
+    MESSAGE_POOL_STATISTICS before = read_statistics();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    unsigned char* block = (unsigned char*)MESSAGE_POOL_alloc(OVERSIZED_BLOCK);
+    ASSERT_IS_NOT_NULL(block);
+    memset(block, 0, OVERSIZED_BLOCK);
+    MESSAGE_POOL_STATISTICS after = read_statistics();
+    MESSAGE_POOL_free(block);
+
+    ///assert
+    ASSERT_IS_TRUE(after.oversized == before.oversized + 1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_003: [ MESSAGE_POOL_alloc shall return NULL if it cannot allocate memory. ]*/
+TEST_FUNCTION(MESSAGE_POOL_alloc_fails_when_oversized_malloc_fails)
+{
+    ///arrange
+    make_thread_cache();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    void* block = MESSAGE_POOL_alloc(OVERSIZED_BLOCK);
+
+    ///assert
+    ASSERT_IS_NULL(block);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_007: [ MESSAGE_POOL_free shall do nothing if block is NULL. ]*/
+TEST_FUNCTION(MESSAGE_POOL_free_does_nothing_with_NULL)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_POOL_free(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_012: [ MESSAGE_POOL_get_statistics shall return non-zero if statistics is NULL. ]*/
+TEST_FUNCTION(MESSAGE_POOL_get_statistics_fails_with_NULL)
+{
+    ///arrange
+
+    ///act
+    int result = MESSAGE_POOL_get_statistics(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_POOL_17_013: [ MESSAGE_POOL_get_statistics shall store the totals, plus the counters the calling thread has not folded yet, in statistics and return 0. ]*/
+TEST_FUNCTION(MESSAGE_POOL_get_statistics_counts_every_allocation)
+{
+    ///arrange
+    void* blocks[10];
+    size_t i;
+    make_thread_cache();
+    MESSAGE_POOL_STATISTICS before = read_statistics();
+
+    ///act
+    for (i = 0; i < 10; i++)
+    {
+        blocks[i] = MESSAGE_POOL_alloc(SMALL_BLOCK);
+    }
+    MESSAGE_POOL_STATISTICS after = read_statistics();
+
+    ///assert
+    ASSERT_IS_TRUE(after.thread_hits + after.shared_hits + after.misses ==
+        before.thread_hits + before.shared_hits + before.misses + 10);
+
+    ///ablutions
+    for (i = 0; i < 10; i++)
+    {
+        MESSAGE_POOL_free(blocks[i]);
+    }
+}
+
+END_TEST_SUITE(message_pool_ut)
@@ -0,0 +1,1230 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/constmap.h"
+#include "message_pool.h"
+#undef ENABLE_MOCKS
+
+#include "message_properties.h"
+
+#define TEST_MAP_HANDLE         ((MAP_HANDLE)0x42)
+#define TEST_PROPERTIES_MAP     ((MAP_HANDLE)0x43)
+#define TEST_CONSTMAP_HANDLE    ((CONSTMAP_HANDLE)0x44)
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static const char* const TEST_KEYS[] = { "source", "temperature" };
+static const char* const TEST_VALUES[] = { "sensor", "21" };
+/*the same properties, as they are laid out in a serialized message*/
+static const char TEST_PAIRS[] = "source\0sensor\0temperature\0" "21";
+/*and in version 2 of the format: source is interned, temperature is not*/
+static const unsigned char TEST_ENCODED[] =
+{
+    (MESSAGE_PROPERTY_SOURCE << 1) | 1, 6, 's', 'e', 'n', 's', 'o', 'r', '\0',
+    11 << 1, 't', 'e', 'm', 'p', 'e', 'r', 'a', 't', 'u', 'r', 'e', '\0', 2, '2', '1', '\0'
+};
+
+static const unsigned char TEST_BYTES[] = { 0x00, 0xAB, 0x10 };
+static const MESSAGE_TYPED_PROPERTY TEST_TYPED[] =
+{
+    { "source", { MESSAGE_PROPERTY_TYPE_STRING, { .string = "sensor" } } },
+    { "bleControllerIndex", { MESSAGE_PROPERTY_TYPE_INT64, { .integer = -12 } } },
+    { "temperature", { MESSAGE_PROPERTY_TYPE_DOUBLE, { .real = 21.5 } } },
+    { "timestamp", { MESSAGE_PROPERTY_TYPE_TIMESTAMP, { .timestamp = INT64_C(1479735005123) } } },
+    { "raw", { MESSAGE_PROPERTY_TYPE_BYTES, { .bytes = { TEST_BYTES, sizeof(TEST_BYTES) } } } }
+};
+/*in version 3 of the format, where every value starts with its type*/
+static const unsigned char TEST_ENCODED_V3[] =
+{
+    (MESSAGE_PROPERTY_SOURCE << 1) | 1, MESSAGE_PROPERTY_TYPE_STRING, 6, 's', 'e', 'n', 's', 'o', 'r', '\0',
+    11 << 1, 't', 'e', 'm', 'p', 'e', 'r', 'a', 't', 'u', 'r', 'e', '\0', MESSAGE_PROPERTY_TYPE_DOUBLE, 0x40, 0x35, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
+    (MESSAGE_PROPERTY_TIMESTAMP << 1) | 1, MESSAGE_PROPERTY_TYPE_TIMESTAMP, 0x00, 0x00, 0x01, 0x58, 0x87, 0x14, 0x4F, 0xC3,
+    3 << 1, 'r', 'a', 'w', '\0', MESSAGE_PROPERTY_TYPE_BYTES, 3, 0x00, 0xAB, 0x10
+};
+
+/*what the next Map_GetInternals hands out*/
+static const char* const* g_keys;
+static const char* const* g_values;
+static size_t g_count;
+
+static void* my_MESSAGE_POOL_alloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_MESSAGE_POOL_free(void* ptr)
+{
+    free(ptr);
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = g_keys;
+    *values = g_values;
+    *count = g_count;
+    return MAP_OK;
+}
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+IMPLEMENT_UMOCK_C_ENUM_TYPE(MAP_RESULT, MAP_RESULT_VALUES);
+
+static MESSAGE_PROPERTIES_HANDLE create_test_properties(void)
+{
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(TEST_PROPERTIES_MAP);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static MESSAGE_PROPERTIES_HANDLE create_typed_test_properties(void)
+{
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_typed(TEST_TYPED, sizeof(TEST_TYPED) / sizeof(TEST_TYPED[0]));
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(message_properties_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTMAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const char*const**, void*);
+    REGISTER_TYPE(MAP_RESULT, MAP_RESULT);
+
+    REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_POOL_alloc, my_MESSAGE_POOL_alloc);
+    REGISTER_GLOBAL_MOCK_HOOK(MESSAGE_POOL_free, my_MESSAGE_POOL_free);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_Create, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_Add, MAP_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(ConstMap_Create, TEST_CONSTMAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(ConstMap_Clone, TEST_CONSTMAP_HANDLE);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_keys = TEST_KEYS;
+    g_values = TEST_VALUES;
+    g_count = sizeof(TEST_KEYS) / sizeof(TEST_KEYS[0]);
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_001: [ MESSAGE_PROPERTIES_create shall return NULL if map is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_returns_NULL_for_NULL_map)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_002: [ MESSAGE_PROPERTIES_create shall get the keys and values of map with Map_GetInternals. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_003: [ MESSAGE_PROPERTIES_create shall allocate the property set, its entries and a copy of every key and value in a single block from the message pool. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_005: [ MESSAGE_PROPERTIES_create shall record the length of every key and value. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_011: [ MESSAGE_PROPERTIES_get_count shall return the number of properties, or 0 if handle is NULL. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_013: [ MESSAGE_PROPERTIES_get_at shall return the property at index, in the order of the map the set was created from. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_copies_the_map)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_PROPERTIES_MAP, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_keys()
+        .IgnoreArgument_values()
+        .IgnoreArgument_count();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(TEST_PROPERTIES_MAP);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, MESSAGE_PROPERTIES_get_count(result));
+    const MESSAGE_PROPERTY* second = MESSAGE_PROPERTIES_get_at(result, 1);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_ARE_EQUAL(char_ptr, "temperature", second->key);
+    ASSERT_ARE_EQUAL(size_t, 11, second->key_length);
+    ASSERT_ARE_EQUAL(char_ptr, "21", second->value);
+    ASSERT_ARE_EQUAL(size_t, 2, second->value_length);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, TEST_VALUES[1], second->value);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_004: [ MESSAGE_PROPERTIES_create shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_fails_when_Map_GetInternals_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_PROPERTIES_MAP, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_keys()
+        .IgnoreArgument_values()
+        .IgnoreArgument_count()
+        .SetReturn(MAP_ERROR);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(TEST_PROPERTIES_MAP);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_004: [ MESSAGE_PROPERTIES_create shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_fails_when_MESSAGE_POOL_alloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_PROPERTIES_MAP, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_keys()
+        .IgnoreArgument_values()
+        .IgnoreArgument_count();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(TEST_PROPERTIES_MAP);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_003: [ MESSAGE_PROPERTIES_create shall allocate the property set, its entries and a copy of every key and value in a single block from the message pool. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_succeeds_for_an_empty_map)
+{
+    ///arrange
+    g_count = 0;
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create(TEST_PROPERTIES_MAP);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, MESSAGE_PROPERTIES_get_count(result));
+    ASSERT_IS_NULL(MESSAGE_PROPERTIES_get(result, "source"));
+    ASSERT_IS_NULL(MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_023: [ MESSAGE_PROPERTIES_create_borrowed shall return NULL if pairs is NULL and count is not 0. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_returns_NULL_for_NULL_pairs)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed(NULL, 1);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_024: [ MESSAGE_PROPERTIES_create_borrowed shall allocate the property set and its entries, but not the strings, in a single block from the message pool. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_026: [ MESSAGE_PROPERTIES_create_borrowed shall point every key and value into pairs, where each key is followed by its value and each string by '\0', and record their lengths. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_028: [ MESSAGE_PROPERTIES_create_borrowed shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_points_into_pairs)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed(TEST_PAIRS, 2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, MESSAGE_PROPERTIES_get_count(result));
+    const MESSAGE_PROPERTY* second = MESSAGE_PROPERTIES_get_at(result, 1);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_PAIRS + 14, second->key);
+    ASSERT_ARE_EQUAL(size_t, 11, second->key_length);
+    ASSERT_ARE_EQUAL(char_ptr, "21", second->value);
+    ASSERT_ARE_EQUAL(size_t, 2, second->value_length);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_PAIRS + 7, MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_025: [ MESSAGE_PROPERTIES_create_borrowed shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_fails_when_MESSAGE_POOL_alloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed(TEST_PAIRS, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_027: [ MESSAGE_PROPERTIES_create_borrowed shall fail and return NULL if a key appears more than once. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_fails_for_a_repeated_key)
+{
+    ///arrange
+    static const char repeated[] = "source\0a\0source\0" "b";
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_block();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed(repeated, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_029: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall return NULL if encoded is NULL and count is not 0. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v2_returns_NULL_for_NULL_encoded)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v2(NULL, 1);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_030: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall allocate the property set and its entries, but not the strings, in a single block from the message pool. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_032: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall take the name of a key tagged with an interned id from MESSAGE_PROPERTY_ID, without comparing strings. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_033: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall point every other key, and every value, into encoded and take their lengths from it. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_035: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v2_points_into_encoded)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v2(TEST_ENCODED, 2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, MESSAGE_PROPERTIES_get_count(result));
+    const MESSAGE_PROPERTY* first = MESSAGE_PROPERTIES_get_at(result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, "source", first->key);
+    ASSERT_ARE_EQUAL(size_t, 6, first->key_length);
+    ASSERT_ARE_EQUAL(size_t, MESSAGE_PROPERTY_SOURCE + 1, first->interned);
+    const MESSAGE_PROPERTY* second = MESSAGE_PROPERTIES_get_at(result, 1);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ENCODED + 10, second->key);
+    ASSERT_ARE_EQUAL(size_t, 11, second->key_length);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ENCODED + 23, second->value);
+    ASSERT_ARE_EQUAL(size_t, 2, second->value_length);
+    ASSERT_ARE_EQUAL(size_t, 0, second->interned);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ENCODED + 2, MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+    ASSERT_ARE_EQUAL(char_ptr, "21", MESSAGE_PROPERTIES_get(result, "temperature"));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_035: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v2_interns_a_well_known_name_sent_in_full)
+{
+    ///arrange
+    static const unsigned char spelled[] = { 6 << 1, 's', 'o', 'u', 'r', 'c', 'e', '\0', 1, 'x', '\0' };
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v2(spelled, 1);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, MESSAGE_PROPERTY_SOURCE + 1, MESSAGE_PROPERTIES_get_at(result, 0)->interned);
+    ASSERT_ARE_EQUAL(char_ptr, "x", MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_031: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v2_fails_when_MESSAGE_POOL_alloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v2(TEST_ENCODED, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_034: [ MESSAGE_PROPERTIES_create_borrowed_v2 shall fail and return NULL if a key appears more than once. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v2_fails_for_a_repeated_key)
+{
+    ///arrange
+    /*the same key once interned and once spelled out*/
+    static const unsigned char repeated[] =
+    {
+        (MESSAGE_PROPERTY_SOURCE << 1) | 1, 1, 'a', '\0',
+        6 << 1, 's', 'o', 'u', 'r', 'c', 'e', '\0', 1, 'b', '\0'
+    };
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_block();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v2(repeated, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_045: [ MESSAGE_PROPERTIES_create_typed shall return NULL if properties is NULL and count is not 0, if a name is NULL, if a type is not a MESSAGE_PROPERTY_TYPE, if a string is NULL, or if bytes are NULL while their size is not 0. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_typed_returns_NULL_for_bad_arguments)
+{
+    ///arrange
+    MESSAGE_TYPED_PROPERTY no_name = { NULL, { MESSAGE_PROPERTY_TYPE_INT64, { .integer = 1 } } };
+    MESSAGE_TYPED_PROPERTY bad_type = { "a", { MESSAGE_PROPERTY_TYPE_COUNT, { .integer = 1 } } };
+    MESSAGE_TYPED_PROPERTY no_string = { "a", { MESSAGE_PROPERTY_TYPE_STRING, { .string = NULL } } };
+    MESSAGE_TYPED_PROPERTY no_bytes = { "a", { MESSAGE_PROPERTY_TYPE_BYTES, { .bytes = { NULL, 1 } } } };
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result1 = MESSAGE_PROPERTIES_create_typed(NULL, 1);
+    MESSAGE_PROPERTIES_HANDLE result2 = MESSAGE_PROPERTIES_create_typed(&no_name, 1);
+    MESSAGE_PROPERTIES_HANDLE result3 = MESSAGE_PROPERTIES_create_typed(&bad_type, 1);
+    MESSAGE_PROPERTIES_HANDLE result4 = MESSAGE_PROPERTIES_create_typed(&no_string, 1);
+    MESSAGE_PROPERTIES_HANDLE result5 = MESSAGE_PROPERTIES_create_typed(&no_bytes, 1);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_046: [ MESSAGE_PROPERTIES_create_typed shall allocate the property set, its entries and a copy of every name, string and array of bytes in a single block from the message pool. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_047: [ MESSAGE_PROPERTIES_create_typed shall keep every value with its type, copying strings and bytes, and keeping integers, doubles and timestamps as they are, without turning them into strings. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_049: [ MESSAGE_PROPERTIES_create_typed shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_typed_keeps_the_types)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_typed(TEST_TYPED, sizeof(TEST_TYPED) / sizeof(TEST_TYPED[0]));
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 5, MESSAGE_PROPERTIES_get_count(result));
+    const MESSAGE_PROPERTY* source = MESSAGE_PROPERTIES_get_at(result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", source->value);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, TEST_TYPED[0].value.value.string, source->value);
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_STRING, source->typed.type);
+    ASSERT_ARE_EQUAL(void_ptr, source->value, source->typed.value.string);
+    const MESSAGE_PROPERTY* index = MESSAGE_PROPERTIES_get_at(result, 1);
+    ASSERT_IS_NULL(index->value);
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_INT64, index->typed.type);
+    ASSERT_IS_TRUE(index->typed.value.integer == -12);
+    ASSERT_ARE_EQUAL(size_t, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX + 1, index->interned);
+    ASSERT_IS_TRUE(MESSAGE_PROPERTIES_get_at(result, 2)->typed.value.real == 21.5);
+    ASSERT_IS_TRUE(MESSAGE_PROPERTIES_get_at(result, 3)->typed.value.timestamp == INT64_C(1479735005123));
+    const MESSAGE_PROPERTY* raw = MESSAGE_PROPERTIES_get_at(result, 4);
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_BYTES, raw->typed.type);
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_BYTES), raw->typed.value.bytes.size);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, TEST_BYTES, raw->typed.value.bytes.buffer);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_BYTES, raw->typed.value.bytes.buffer, sizeof(TEST_BYTES)));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_048: [ MESSAGE_PROPERTIES_create_typed shall fail and return NULL if a name appears more than once. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_typed_fails_for_a_repeated_name)
+{
+    ///arrange
+    MESSAGE_TYPED_PROPERTY repeated[] =
+    {
+        { "a", { MESSAGE_PROPERTY_TYPE_INT64, { .integer = 1 } } },
+        { "a", { MESSAGE_PROPERTY_TYPE_DOUBLE, { .real = 1.0 } } }
+    };
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_block();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_typed(repeated, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_050: [ MESSAGE_PROPERTIES_create_typed shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_typed_fails_when_MESSAGE_POOL_alloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_typed(TEST_TYPED, sizeof(TEST_TYPED) / sizeof(TEST_TYPED[0]));
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_051: [ MESSAGE_PROPERTIES_create_borrowed_v3 shall return NULL if encoded is NULL and count is not 0. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v3_returns_NULL_for_NULL_encoded)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v3(NULL, 1);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_052: [ MESSAGE_PROPERTIES_create_borrowed_v3 shall read the type that starts every value, point strings and bytes into encoded, and read integers, doubles and timestamps from 8 bytes, most significant first. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_053: [ Otherwise MESSAGE_PROPERTIES_create_borrowed_v3 shall read the names, allocate the set and fail exactly as MESSAGE_PROPERTIES_create_borrowed_v2 does. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_create_borrowed_v3_reads_the_types)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_create_borrowed_v3(TEST_ENCODED_V3, 4);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ENCODED_V3 + 3, MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+    const MESSAGE_PROPERTY_VALUE* temperature = MESSAGE_PROPERTIES_get_typed(result, "temperature");
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_DOUBLE, temperature->type);
+    ASSERT_IS_TRUE(temperature->value.real == 21.5);
+    const MESSAGE_PROPERTY_VALUE* timestamp = MESSAGE_PROPERTIES_get_typed_by_id(result, MESSAGE_PROPERTY_TIMESTAMP);
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_TIMESTAMP, timestamp->type);
+    ASSERT_IS_TRUE(timestamp->value.timestamp == INT64_C(1479735005123));
+    const MESSAGE_PROPERTY_VALUE* raw = MESSAGE_PROPERTIES_get_typed(result, "raw");
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_BYTES, raw->type);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ENCODED_V3 + sizeof(TEST_ENCODED_V3) - 3, raw->value.bytes.buffer);
+    ASSERT_ARE_EQUAL(size_t, 3, raw->value.bytes.size);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_036: [ MESSAGE_PROPERTIES_derive shall return NULL if parent is NULL, if adds or removes is NULL while its count is not 0, or if any name or value in them is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_returns_NULL_for_bad_arguments)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    MESSAGE_PROPERTY_UPDATE noValue[] = { { "source", NULL } };
+    const char* noName[] = { NULL };
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result1 = MESSAGE_PROPERTIES_derive(NULL, NULL, 0, NULL, 0);
+    MESSAGE_PROPERTIES_HANDLE result2 = MESSAGE_PROPERTIES_derive(properties, NULL, 1, NULL, 0);
+    MESSAGE_PROPERTIES_HANDLE result3 = MESSAGE_PROPERTIES_derive(properties, NULL, 0, NULL, 1);
+    MESSAGE_PROPERTIES_HANDLE result4 = MESSAGE_PROPERTIES_derive(properties, noValue, 1, NULL, 0);
+    MESSAGE_PROPERTIES_HANDLE result5 = MESSAGE_PROPERTIES_derive(properties, NULL, 0, noName, 1);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_037: [ MESSAGE_PROPERTIES_derive shall allocate the property set, its entries and a copy of every added name and value in a single block from the message pool. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_038: [ MESSAGE_PROPERTIES_derive shall keep, in their order, the properties of parent that adds and removes do not name, pointing at the strings of parent without copying them. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_039: [ MESSAGE_PROPERTIES_derive shall follow them with copies of the properties in adds, in their order. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_041: [ MESSAGE_PROPERTIES_derive shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_keeps_replaces_and_removes_properties)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    char value[] = "mapping";
+    MESSAGE_PROPERTY_UPDATE adds[] = { { "deviceName", "d1" }, { "source", value } };
+    const char* removes[] = { "temperature", "humidity" };
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_derive(properties, adds, 2, removes, 2);
+    value[0] = 'x';
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, MESSAGE_PROPERTIES_get_count(result));
+    ASSERT_ARE_EQUAL(char_ptr, "deviceName", MESSAGE_PROPERTIES_get_at(result, 0)->key);
+    ASSERT_ARE_EQUAL(char_ptr, "mapping", MESSAGE_PROPERTIES_get(result, "source"));
+    ASSERT_IS_NULL(MESSAGE_PROPERTIES_get(result, "temperature"));
+    ASSERT_ARE_EQUAL(char_ptr, "d1", MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_DEVICE_NAME));
+    ASSERT_ARE_EQUAL(char_ptr, "mapping", MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", MESSAGE_PROPERTIES_get(properties, "source"));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_038: [ MESSAGE_PROPERTIES_derive shall keep, in their order, the properties of parent that adds and removes do not name, pointing at the strings of parent without copying them. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_041: [ MESSAGE_PROPERTIES_derive shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_042: [ MESSAGE_PROPERTIES_derive shall keep a reference to parent, with MESSAGE_PROPERTIES_clone, if it shares any of its strings. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_044: [ When the reference count of a derived set reaches zero, MESSAGE_PROPERTIES_destroy shall also destroy the reference it keeps to its parent. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_shares_the_strings_of_parent)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    MESSAGE_PROPERTY_UPDATE adds[] = { { "deviceKey", "k" } };
+    const MESSAGE_PROPERTY* kept = MESSAGE_PROPERTIES_get_at(properties, 0);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_derive(properties, adds, 1, NULL, 0);
+    MESSAGE_PROPERTIES_destroy(properties);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 3, MESSAGE_PROPERTIES_get_count(result));
+    ASSERT_ARE_EQUAL(void_ptr, kept->key, MESSAGE_PROPERTIES_get_at(result, 0)->key);
+    ASSERT_ARE_EQUAL(void_ptr, kept->value, MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_SOURCE));
+    ASSERT_ARE_EQUAL(char_ptr, "21", MESSAGE_PROPERTIES_get(result, "temperature"));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(result));
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(properties));
+    MESSAGE_PROPERTIES_destroy(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_040: [ MESSAGE_PROPERTIES_derive shall fail and return NULL if a name appears more than once in adds. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_fails_for_a_repeated_add)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    MESSAGE_PROPERTY_UPDATE adds[] = { { "deviceName", "a" }, { "deviceName", "b" } };
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_block();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_derive(properties, adds, 2, NULL, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_043: [ MESSAGE_PROPERTIES_derive shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_fails_when_MESSAGE_POOL_alloc_fails)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_derive(properties, NULL, 0, NULL, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_007: [ MESSAGE_PROPERTIES_clone shall return NULL if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_clone_returns_NULL_for_NULL_handle)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_clone(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_008: [ MESSAGE_PROPERTIES_clone shall increment the reference count and return handle. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_010: [ MESSAGE_PROPERTIES_destroy shall decrement the reference count and, when it reaches zero, destroy the CONSTMAP built by MESSAGE_PROPERTIES_get_constmap and free the block. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_clone_keeps_the_block_until_the_last_destroy)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_clone(properties);
+    MESSAGE_PROPERTIES_destroy(properties);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, properties, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", MESSAGE_PROPERTIES_get(result, "source"));
+
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(properties));
+    MESSAGE_PROPERTIES_destroy(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_009: [ MESSAGE_PROPERTIES_destroy shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_destroy_does_nothing_for_NULL_handle)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_PROPERTIES_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_011: [ MESSAGE_PROPERTIES_get_count shall return the number of properties, or 0 if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_count_returns_0_for_NULL_handle)
+{
+    ///arrange
+
+    ///act
+    size_t result = MESSAGE_PROPERTIES_get_count(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_012: [ MESSAGE_PROPERTIES_get_at shall return NULL if handle is NULL or index is not less than the number of properties. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_at_returns_NULL_for_bad_arguments)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    const MESSAGE_PROPERTY* result1 = MESSAGE_PROPERTIES_get_at(NULL, 0);
+    const MESSAGE_PROPERTY* result2 = MESSAGE_PROPERTIES_get_at(properties, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_014: [ MESSAGE_PROPERTIES_get shall return NULL if handle or name is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_returns_NULL_for_NULL_arguments)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    const char* result1 = MESSAGE_PROPERTIES_get(NULL, "source");
+    const char* result2 = MESSAGE_PROPERTIES_get(properties, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_015: [ MESSAGE_PROPERTIES_get shall return the value of the property called name, comparing lengths before contents, or NULL if there is none. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_finds_properties_by_name)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    const char* found = MESSAGE_PROPERTIES_get(properties, "temperature");
+    const char* prefix = MESSAGE_PROPERTIES_get(properties, "temp");
+    const char* missing = MESSAGE_PROPERTIES_get(properties, "humidity");
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, "21", found);
+    ASSERT_IS_NULL(prefix);
+    ASSERT_IS_NULL(missing);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_016: [ MESSAGE_PROPERTIES_get_by_id shall return NULL if handle is NULL or id is not a MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_by_id_returns_NULL_for_bad_arguments)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    const char* result1 = MESSAGE_PROPERTIES_get_by_id(NULL, MESSAGE_PROPERTY_SOURCE);
+    const char* result2 = MESSAGE_PROPERTIES_get_by_id(properties, MESSAGE_PROPERTY_ID_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_006: [ MESSAGE_PROPERTIES_create shall record which entry holds each of the names of MESSAGE_PROPERTY_ID. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_017: [ MESSAGE_PROPERTIES_get_by_id shall return the value of the interned property without comparing strings, or NULL if there is none. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_by_id_finds_interned_properties)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    ///act
+    const char* source = MESSAGE_PROPERTIES_get_by_id(properties, MESSAGE_PROPERTY_SOURCE);
+    const char* macAddress = MESSAGE_PROPERTIES_get_by_id(properties, MESSAGE_PROPERTY_MAC_ADDRESS);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", source);
+    ASSERT_ARE_EQUAL(void_ptr, MESSAGE_PROPERTIES_get_at(properties, 0)->value, source);
+    ASSERT_IS_NULL(macAddress);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_054: [ The first time the value of a property that is not a string is asked for, as a string or in the CONSTMAP, it shall be turned into one in a block from the message pool, published with an atomic compare-exchange and kept with the set; if another thread published one first, the block shall be freed and that one used. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_055: [ Integers shall be written in decimal, doubles with 15 significant digits or with 17 if 15 do not read back as the same double, bytes as two lowercase hexadecimal digits each, and timestamps as YYYY-MM-DDTHH:MM:SS.mmmZ in UTC. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_renders_typed_values_once)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_typed_test_properties();
+
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(7));
+
+    ///act
+    const char* index = MESSAGE_PROPERTIES_get_by_id(properties, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX);
+    const char* temperature = MESSAGE_PROPERTIES_get(properties, "temperature");
+    const char* timestamp = MESSAGE_PROPERTIES_get(properties, "timestamp");
+    const char* raw = MESSAGE_PROPERTIES_get(properties, "raw");
+    const char* again = MESSAGE_PROPERTIES_get(properties, "bleControllerIndex");
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "-12", index);
+    ASSERT_ARE_EQUAL(char_ptr, "21.5", temperature);
+    ASSERT_ARE_EQUAL(char_ptr, "2016-11-21T13:30:05.123Z", timestamp);
+    ASSERT_ARE_EQUAL(char_ptr, "00ab10", raw);
+    ASSERT_ARE_EQUAL(void_ptr, index, again);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_055: [ Integers shall be written in decimal, doubles with 15 significant digits or with 17 if 15 do not read back as the same double, bytes as two lowercase hexadecimal digits each, and timestamps as YYYY-MM-DDTHH:MM:SS.mmmZ in UTC. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_renders_exact_doubles_and_early_timestamps)
+{
+    ///arrange
+    MESSAGE_TYPED_PROPERTY values[] =
+    {
+        { "third", { MESSAGE_PROPERTY_TYPE_DOUBLE, { .real = 1.0 / 3 } } },
+        { "before", { MESSAGE_PROPERTY_TYPE_TIMESTAMP, { .timestamp = -1 } } },
+        { "leap", { MESSAGE_PROPERTY_TYPE_TIMESTAMP, { .timestamp = INT64_C(951782400000) } } }
+    };
+    MESSAGE_PROPERTIES_HANDLE properties = MESSAGE_PROPERTIES_create_typed(values, 3);
+
+    ///act
+    const char* third = MESSAGE_PROPERTIES_get(properties, "third");
+    const char* before = MESSAGE_PROPERTIES_get(properties, "before");
+    const char* leap = MESSAGE_PROPERTIES_get(properties, "leap");
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, "0.33333333333333331", third);
+    ASSERT_ARE_EQUAL(char_ptr, "1969-12-31T23:59:59.999Z", before);
+    ASSERT_ARE_EQUAL(char_ptr, "2000-02-29T00:00:00.000Z", leap);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_056: [ MESSAGE_PROPERTIES_get and MESSAGE_PROPERTIES_get_by_id shall return NULL if a value that is not a string cannot be turned into one. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_returns_NULL_when_rendering_fails)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_typed_test_properties();
+
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size()
+        .SetReturn(NULL);
+
+    ///act
+    const char* result1 = MESSAGE_PROPERTIES_get(properties, "temperature");
+    const char* result2 = MESSAGE_PROPERTIES_get_by_id(properties, MESSAGE_PROPERTY_TIMESTAMP);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_057: [ MESSAGE_PROPERTIES_get_typed shall return NULL if handle or name is NULL. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_059: [ MESSAGE_PROPERTIES_get_typed_by_id shall return NULL if handle is NULL or id is not a MESSAGE_PROPERTY_ID. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_typed_returns_NULL_for_bad_arguments)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_typed_test_properties();
+
+    ///act
+    const MESSAGE_PROPERTY_VALUE* result1 = MESSAGE_PROPERTIES_get_typed(NULL, "raw");
+    const MESSAGE_PROPERTY_VALUE* result2 = MESSAGE_PROPERTIES_get_typed(properties, NULL);
+    const MESSAGE_PROPERTY_VALUE* result3 = MESSAGE_PROPERTIES_get_typed_by_id(NULL, MESSAGE_PROPERTY_SOURCE);
+    const MESSAGE_PROPERTY_VALUE* result4 = MESSAGE_PROPERTIES_get_typed_by_id(properties, MESSAGE_PROPERTY_ID_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_058: [ MESSAGE_PROPERTIES_get_typed shall return the value of the property called name with its type, or NULL if there is none. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_060: [ MESSAGE_PROPERTIES_get_typed_by_id shall return the value of the interned property with its type, without comparing strings, or NULL if there is none. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_typed_finds_values_without_rendering_them)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_typed_test_properties();
+
+    ///act
+    const MESSAGE_PROPERTY_VALUE* source = MESSAGE_PROPERTIES_get_typed_by_id(properties, MESSAGE_PROPERTY_SOURCE);
+    const MESSAGE_PROPERTY_VALUE* index = MESSAGE_PROPERTIES_get_typed(properties, "bleControllerIndex");
+    const MESSAGE_PROPERTY_VALUE* missing = MESSAGE_PROPERTIES_get_typed(properties, "missing");
+    const MESSAGE_PROPERTY_VALUE* no_key = MESSAGE_PROPERTIES_get_typed_by_id(properties, MESSAGE_PROPERTY_DEVICE_KEY);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_STRING, source->type);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", source->value.string);
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_INT64, index->type);
+    ASSERT_IS_TRUE(index->value.integer == -12);
+    ASSERT_IS_NULL(missing);
+    ASSERT_IS_NULL(no_key);
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_018: [ MESSAGE_PROPERTIES_get_constmap shall return NULL if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_constmap_returns_NULL_for_NULL_handle)
+{
+    ///arrange
+
+    ///act
+    CONSTMAP_HANDLE result = MESSAGE_PROPERTIES_get_constmap(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_019: [ On its first call, MESSAGE_PROPERTIES_get_constmap shall build a CONSTMAP of the properties with Map_Create, Map_Add, ConstMap_Create and Map_Destroy, and keep it. ]*/
+/*Tests_SRS_MESSAGE_PROPERTIES_17_022: [ MESSAGE_PROPERTIES_get_constmap shall return a clone of the kept CONSTMAP. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_constmap_builds_the_map_once)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL));
+    STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "sensor"));
+    STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "temperature", "21"));
+    STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+    STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+    STRICT_EXPECTED_CALL(ConstMap_Clone(TEST_CONSTMAP_HANDLE));
+    STRICT_EXPECTED_CALL(ConstMap_Clone(TEST_CONSTMAP_HANDLE));
+
+    ///act
+    CONSTMAP_HANDLE result1 = MESSAGE_PROPERTIES_get_constmap(properties);
+    CONSTMAP_HANDLE result2 = MESSAGE_PROPERTIES_get_constmap(properties);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONSTMAP_HANDLE, result1);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONSTMAP_HANDLE, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_021: [ MESSAGE_PROPERTIES_get_constmap shall return NULL if it cannot build the CONSTMAP. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_constmap_fails_when_Map_Add_fails)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL));
+    STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "sensor"))
+        .SetReturn(MAP_ERROR);
+    STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+    ///act
+    CONSTMAP_HANDLE result = MESSAGE_PROPERTIES_get_constmap(properties);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_021: [ MESSAGE_PROPERTIES_get_constmap shall return NULL if it cannot build the CONSTMAP. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_constmap_fails_when_Map_Create_fails)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL))
+        .SetReturn(NULL);
+
+    ///act
+    CONSTMAP_HANDLE result = MESSAGE_PROPERTIES_get_constmap(properties);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_010: [ MESSAGE_PROPERTIES_destroy shall decrement the reference count and, when it reaches zero, destroy the CONSTMAP built by MESSAGE_PROPERTIES_get_constmap and free the block. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_destroy_destroys_the_kept_constmap)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_test_properties();
+    CONSTMAP_HANDLE constmap = MESSAGE_PROPERTIES_get_constmap(properties);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(ConstMap_Destroy(TEST_CONSTMAP_HANDLE));
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(properties));
+
+    ///act
+    MESSAGE_PROPERTIES_destroy(properties);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONSTMAP_HANDLE, constmap);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_054: [ The first time the value of a property that is not a string is asked for, as a string or in the CONSTMAP, it shall be turned into one in a block from the message pool, published with an atomic compare-exchange and kept with the set; if another thread published one first, the block shall be freed and that one used. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_get_constmap_renders_typed_values)
+{
+    ///arrange
+    MESSAGE_TYPED_PROPERTY values[] =
+    {
+        { "source", { MESSAGE_PROPERTY_TYPE_STRING, { .string = "sensor" } } },
+        { "count", { MESSAGE_PROPERTY_TYPE_INT64, { .integer = 42 } } }
+    };
+    MESSAGE_PROPERTIES_HANDLE properties = MESSAGE_PROPERTIES_create_typed(values, 2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL));
+    STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "sensor"));
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_alloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "count", "42"));
+    STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+    STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+    STRICT_EXPECTED_CALL(ConstMap_Clone(TEST_CONSTMAP_HANDLE));
+
+    ///act
+    CONSTMAP_HANDLE result = MESSAGE_PROPERTIES_get_constmap(properties);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONSTMAP_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(properties);
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_061: [ When the reference count reaches zero, MESSAGE_PROPERTIES_destroy shall also free the string forms made of values that are not strings. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_destroy_frees_the_rendered_values)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE properties = create_typed_test_properties();
+    const char* raw = MESSAGE_PROPERTIES_get(properties, "raw");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free((void*)raw));
+    STRICT_EXPECTED_CALL(MESSAGE_POOL_free(properties));
+
+    ///act
+    MESSAGE_PROPERTIES_destroy(properties);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_PROPERTIES_17_062: [ MESSAGE_PROPERTIES_derive shall keep the values of parent that are not strings with their types, but not their string forms. ]*/
+TEST_FUNCTION(MESSAGE_PROPERTIES_derive_keeps_typed_values)
+{
+    ///arrange
+    MESSAGE_PROPERTIES_HANDLE parent = create_typed_test_properties();
+    const char* parent_index = MESSAGE_PROPERTIES_get(parent, "bleControllerIndex");
+    MESSAGE_PROPERTY_UPDATE adds[] = { { "deviceName", "dev" } };
+    MESSAGE_PROPERTIES_HANDLE result = MESSAGE_PROPERTIES_derive(parent, adds, 1, NULL, 0);
+    MESSAGE_PROPERTIES_destroy(parent);
+
+    ///act
+    const MESSAGE_PROPERTY_VALUE* index = MESSAGE_PROPERTIES_get_typed_by_id(result, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX);
+    const char* rendered = MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, MESSAGE_PROPERTY_TYPE_INT64, index->type);
+    ASSERT_IS_TRUE(index->value.integer == -12);
+    ASSERT_ARE_EQUAL(char_ptr, "-12", rendered);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, parent_index, rendered);
+    ASSERT_ARE_EQUAL(char_ptr, "dev", MESSAGE_PROPERTIES_get_by_id(result, MESSAGE_PROPERTY_DEVICE_NAME));
+
+    ///ablutions
+    MESSAGE_PROPERTIES_destroy(result);
+}
+
+END_TEST_SUITE(message_properties_ut)
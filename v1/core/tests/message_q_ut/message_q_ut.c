@@ -46,75 +46,75 @@ void my_gballoc_free(void* ptr)
 #define GATEWAY_EXPORT
 
 #include "message.h"
-#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/gballoc.h"
 
 #undef ENABLE_MOCKS
 
-// Well, this was the easiest way to "mock" DList.
-void real_DList_InitializeListHead(PDLIST_ENTRY ListHead)
+static LOCK_HANDLE my_Lock_Init(void)
 {
-	ListHead->Flink = ListHead->Blink = ListHead;
-	return;
+	return (LOCK_HANDLE)malloc(1);
 }
 
-int real_DList_IsListEmpty(const PDLIST_ENTRY ListHead)
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
 {
-	return (ListHead->Flink == ListHead);
+	free(handle);
+	return LOCK_OK;
 }
 
-int real_DList_RemoveEntryList(PDLIST_ENTRY Entry)
+static COND_HANDLE my_Condition_Init(void)
 {
-	PDLIST_ENTRY Blink;
-	PDLIST_ENTRY Flink;
-
-	Flink = Entry->Flink;
-	Blink = Entry->Blink;
-	Blink->Flink = Flink;
-	Flink->Blink = Blink;
-	return (Flink == Blink);
+	return (COND_HANDLE)malloc(1);
 }
 
-PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY ListHead)
+static void my_Condition_Deinit(COND_HANDLE handle)
 {
-	PDLIST_ENTRY Flink;
-	PDLIST_ENTRY Entry;
+	free(handle);
+}
 
-	Entry = ListHead->Flink;
-	Flink = Entry->Flink;
-	ListHead->Flink = Flink;
-	Flink->Blink = ListHead;
-	return Entry;
+static TICK_COUNTER_HANDLE my_tickcounter_create(void)
+{
+	return (TICK_COUNTER_HANDLE)malloc(1);
 }
 
-void real_DList_InsertTailList(PDLIST_ENTRY ListHead, PDLIST_ENTRY Entry)
+static void my_tickcounter_destroy(TICK_COUNTER_HANDLE handle)
 {
-	PDLIST_ENTRY Blink;
-	Blink = ListHead->Blink;
-	Entry->Flink = ListHead;
-	Entry->Blink = Blink;
-	Blink->Flink = Entry;
-	ListHead->Blink = Entry;
-	return;
+	free(handle);
 }
 
+static tickcounter_ms_t current_ms;
 
-void real_DList_AppendTailList(PDLIST_ENTRY ListHead,PDLIST_ENTRY ListToAppend)
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE handle, tickcounter_ms_t* ms)
 {
-	PDLIST_ENTRY ListEnd = ListHead->Blink;
-	ListHead->Blink->Flink = ListToAppend;
-	ListHead->Blink = ListToAppend->Blink;
-	ListToAppend->Blink->Flink = ListHead;
-	ListToAppend->Blink = ListEnd;
-	return;
+	(void)handle;
+	*ms = current_ms;
+	return 0;
 }
 
-void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY entry)
+/*what a thread does while the test "waits" on the queue's condition*/
+typedef void(*WAIT_ACTION)(void);
+static WAIT_ACTION wait_action;
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
 {
-	entry->Blink = listHead;
-	entry->Flink = listHead->Flink;
-	listHead->Flink->Blink = entry;
-	listHead->Flink = entry;
+	(void)handle;
+	(void)lock;
+	COND_RESULT result;
+	if (wait_action != NULL)
+	{
+		WAIT_ACTION action = wait_action;
+		wait_action = NULL;
+		action();
+		result = COND_OK;
+	}
+	else
+	{
+		current_ms += (tickcounter_ms_t)timeout_milliseconds;
+		result = COND_TIMEOUT;
+	}
+	return result;
 }
 
 #include "message_queue.h"
@@ -145,21 +145,32 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
 
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
-	REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void *);
-	REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, const void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 
 	// malloc/free hooks
 	REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
 	REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
-	//doubly linked list hooks
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
-	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+	// lock, condition & tick counter hooks
+	REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+	REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+	REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+	REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+	REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+	REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+	REGISTER_GLOBAL_MOCK_HOOK(tickcounter_create, my_tickcounter_create);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+	REGISTER_GLOBAL_MOCK_HOOK(tickcounter_destroy, my_tickcounter_destroy);
+	REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -181,6 +192,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	malloc_will_fail = false;
 	malloc_fail_count = 0;
 	malloc_count = 0;
+	current_ms = 0;
+	wait_action = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -189,13 +202,18 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 }
 
 /*Tests_SRS_MESSAGE_QUEUE_17_001: [ On a successful call, MESSAGE_QUEUE_create shall return a non-NULL value in MESSAGE_QUEUE_HANDLE. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_023: [ MESSAGE_QUEUE_create shall create a queue without a capacity, as MESSAGE_QUEUE_create_with_capacity does with a capacity of 0. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_with_capacity shall allocate room for capacity messages, or for 16 if capacity is 0. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_with_capacity shall create a lock, a condition and a tick counter used to make the queue safe for concurrent use and to wait on it. ]*/
 TEST_FUNCTION(MESSAGE_QUEUE_create_success)
 {
 	///arrange
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(16 * sizeof(MESSAGE_HANDLE)));
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+	STRICT_EXPECTED_CALL(tickcounter_create());
 
 	///act
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
@@ -208,6 +226,29 @@ TEST_FUNCTION(MESSAGE_QUEUE_create_success)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_with_capacity shall allocate room for capacity messages, or for 16 if capacity is 0. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_with_capacity_allocates_capacity_slots)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(3 * sizeof(MESSAGE_HANDLE)));
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+	STRICT_EXPECTED_CALL(tickcounter_create());
+
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_with_capacity(3);
+
+	///assert
+	ASSERT_IS_NOT_NULL(mq);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
 /*Tests_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
 TEST_FUNCTION(MESSAGE_QUEUE_create_fails_with_alloc_fail)
 {
@@ -228,6 +269,42 @@ TEST_FUNCTION(MESSAGE_QUEUE_create_fails_with_alloc_fail)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_003: [ On a failure, MESSAGE_QUEUE_create shall return NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_fails_when_underlying_calls_fail)
+{
+	///arrange
+	int negativeTestsInitResult = umock_c_negative_tests_init();
+	ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+	STRICT_EXPECTED_CALL(tickcounter_create());
+
+	umock_c_negative_tests_snapshot();
+
+	for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+	{
+		///arrange
+		umock_c_negative_tests_reset();
+		umock_c_negative_tests_fail_call(i);
+
+		///act
+		MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+
+		///assert
+		ASSERT_IS_NULL(mq);
+	}
+
+	///ablutions
+	umock_c_negative_tests_deinit();
+}
+
 /*Tests_SRS_MESSAGE_QUEUE_17_004: [ MESSAGE_QUEUE_destroy shall not perform any actions on a NULL message queue. ]*/
 TEST_FUNCTION(MESSAGE_QUEUE_destroy_does_nothing_with_nothing) 
 {
@@ -249,14 +326,14 @@ TEST_FUNCTION(MESSAGE_QUEUE_destroy_does_something_with_a_nonempty_queue)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_Destroy(mh));
+	STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_Destroy(mh));
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -277,7 +354,13 @@ TEST_FUNCTION(MESSAGE_QUEUE_destroy_does_something_with_an_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -311,6 +394,7 @@ TEST_FUNCTION(MESSAGE_QUEUE_push_does_nothing_with_null_params)
 }
 
 /*Tests_SRS_MESSAGE_QUEUE_17_008: [ MESSAGE_QUEUE_push shall return zero on success. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_026: [ MESSAGE_QUEUE_push, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_front and MESSAGE_QUEUE_close shall hold the queue's lock while they use the queue. ]*/
 TEST_FUNCTION(MESSAGE_QUEUE_push_success)
 {
 	///arrange
@@ -318,12 +402,10 @@ TEST_FUNCTION(MESSAGE_QUEUE_push_success)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
 
 	///act
 	int mp1 = MESSAGE_QUEUE_push(mq, element);
@@ -339,25 +421,135 @@ TEST_FUNCTION(MESSAGE_QUEUE_push_success)
 }
 
 /*Tests_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
-TEST_FUNCTION(MESSAGE_QUEUE_push_alloc_element_fails)
+TEST_FUNCTION(MESSAGE_QUEUE_push_fails_when_Lock_fails)
 {
 	///arrange
 	MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	///act
+	int mp1 = MESSAGE_QUEUE_push(mq, element);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, mp1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_027: [ MESSAGE_QUEUE_push shall return a non-zero value, without blocking, if the queue holds capacity messages. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_fails_when_the_queue_is_full)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_with_capacity(2);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	int mp1 = MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x44);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, mp1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x42);
+	ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x44));
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x43);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x44);
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_028: [ If a queue without a capacity is full, MESSAGE_QUEUE_push shall double its room for messages. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_grows_a_full_queue_without_capacity)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	size_t i;
+	/*leave the messages wrapped around the end of the slots*/
+	for (i = 1; i <= 10; i++)
+	{
+		MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)i);
+	}
+	for (i = 1; i <= 10; i++)
+	{
+		(void)MESSAGE_QUEUE_pop(mq);
+	}
+	for (i = 1; i <= 16; i++)
+	{
+		MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)i);
+	}
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(32 * sizeof(MESSAGE_HANDLE)));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	int mp1 = MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)17);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, 0, mp1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	for (i = 1; i <= 17; i++)
+	{
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)i);
+	}
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_009: [ MESSAGE_QUEUE_push shall return a non-zero value if any system call fails. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_alloc_element_fails)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	size_t i;
+	for (i = 1; i <= 16; i++)
+	{
+		MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)i);
+	}
+	umock_c_reset_all_calls();
+
 	malloc_will_fail = true;
-	malloc_fail_count = malloc_count +1;
+	malloc_fail_count = malloc_count + 1;
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 
 	///act
-	int mp1 = MESSAGE_QUEUE_push(mq, element);
+	int mp1 = MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)17);
 
 	///assert
 	ASSERT_ARE_NOT_EQUAL(int, 0, mp1);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
+	for (i = 1; i <= 16; i++)
+	{
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)i);
+	}
 	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
 
 	///ablutions
@@ -385,7 +577,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_pop_returns_null_on_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	///act
@@ -409,11 +603,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_pop_success)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	///act
@@ -428,6 +620,285 @@ TEST_FUNCTION(MESSAGE_QUEUE_pop_success)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_030: [ MESSAGE_QUEUE_pop_wait shall return NULL on a NULL message queue. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_returns_null_with_null)
+{
+	///arrange
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(NULL, -1);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_032: [ MESSAGE_QUEUE_pop_wait shall remove the oldest message, as MESSAGE_QUEUE_pop does, as soon as the queue holds one. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_does_not_wait_for_a_queued_message)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, -1);
+
+	///assert
+	ASSERT_IS_TRUE(mh == (MESSAGE_HANDLE)0x42);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)0x43));
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_035: [ If timeout is 0, MESSAGE_QUEUE_pop_wait shall not wait. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_with_0_timeout_does_not_wait)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 0);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+static MESSAGE_QUEUE_HANDLE waited_queue;
+
+static void push_while_waiting(void)
+{
+	(void)MESSAGE_QUEUE_push(waited_queue, (MESSAGE_HANDLE)0x42);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_029: [ MESSAGE_QUEUE_push shall signal the queue's condition if a thread waits in MESSAGE_QUEUE_pop_wait. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_033: [ While the queue is empty, MESSAGE_QUEUE_pop_wait shall wait on the queue's condition for up to timeout milliseconds, or without a limit if timeout is negative. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_wakes_up_for_a_pushed_message)
+{
+	///arrange
+	waited_queue = MESSAGE_QUEUE_create();
+	wait_action = push_while_waiting;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(waited_queue, -1);
+
+	///assert
+	ASSERT_IS_TRUE(mh == (MESSAGE_HANDLE)0x42);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(waited_queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_029: [ MESSAGE_QUEUE_push shall signal the queue's condition if a thread waits in MESSAGE_QUEUE_pop_wait. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_does_not_signal_without_waiters)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	(void)MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)0x42));
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_033: [ While the queue is empty, MESSAGE_QUEUE_pop_wait shall wait on the queue's condition for up to timeout milliseconds, or without a limit if timeout is negative. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_034: [ MESSAGE_QUEUE_pop_wait shall return NULL if no message arrives within timeout milliseconds. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_times_out)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	current_ms = 1000;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 100))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 100);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_031: [ MESSAGE_QUEUE_pop_wait shall return NULL if any system call fails. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_fails_when_underlying_calls_fail)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+
+	int negativeTestsInitResult = umock_c_negative_tests_init();
+	ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+	STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments()
+		.SetFailReturn(__LINE__);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	umock_c_negative_tests_snapshot();
+
+	for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+	{
+		///arrange
+		umock_c_negative_tests_reset();
+		umock_c_negative_tests_fail_call(i);
+
+		///act
+		MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 100);
+
+		///assert
+		ASSERT_IS_NULL(mh);
+	}
+
+	///ablutions
+	umock_c_negative_tests_deinit();
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+static void close_while_waiting(void)
+{
+	MESSAGE_QUEUE_close(waited_queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_038: [ MESSAGE_QUEUE_close shall mark the queue closed and wake every thread waiting in MESSAGE_QUEUE_pop_wait. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_close_wakes_a_waiting_thread)
+{
+	///arrange
+	waited_queue = MESSAGE_QUEUE_create();
+	wait_action = close_while_waiting;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(waited_queue, -1);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(waited_queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_pop_wait shall return NULL without waiting on an empty queue once MESSAGE_QUEUE_close was called. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_does_not_wait_on_a_closed_queue)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_close(mq);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh1 = MESSAGE_QUEUE_pop_wait(mq, -1);
+	MESSAGE_HANDLE mh2 = MESSAGE_QUEUE_pop_wait(mq, -1);
+
+	///assert
+	ASSERT_IS_TRUE(mh1 == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_NULL(mh2);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_037: [ MESSAGE_QUEUE_close shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_close_does_nothing_with_null)
+{
+	///arrange
+	///act
+	MESSAGE_QUEUE_close(NULL);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
 /*Tests_SRS_MESSAGE_QUEUE_17_016: [ MESSAGE_QUEUE_is_empty shall return true if handle is NULL. ]*/
 TEST_FUNCTION(MESSAGE_QUEUE_is_empty_returns_true_with_null)
 {
@@ -448,7 +919,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_is_empty_returns_true_with_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	///act
 	bool is_empty = MESSAGE_QUEUE_is_empty(mq);
@@ -469,7 +942,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_is_empty_returns_true_with_non_empty_queue)
 	MESSAGE_QUEUE_push(mq, mh);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	///act
 	bool is_empty = MESSAGE_QUEUE_is_empty(mq);
@@ -507,13 +982,10 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_front_of_queue)
 	MESSAGE_QUEUE_push(mq, mh2);
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
 
 	///act
 	MESSAGE_HANDLE mh1_front = MESSAGE_QUEUE_front(mq);
@@ -527,13 +999,10 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_front_of_queue)
 
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
 
 	///act
 	MESSAGE_HANDLE mh2_front = MESSAGE_QUEUE_front(mq);
@@ -553,7 +1022,9 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_null_empty_queue)
 	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	///act
@@ -567,10 +1038,49 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_null_empty_queue)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_039: [ MESSAGE_QUEUE_size shall return 0 if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_size_returns_0_with_null)
+{
+	///arrange
+	///act
+	size_t size = MESSAGE_QUEUE_size(NULL);
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 0, size);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_040: [ MESSAGE_QUEUE_size shall return the number of messages on the queue. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_size_returns_messages_on_queue)
+{
+	///arrange
+	MESSAGE_HANDLE mh1 = (MESSAGE_HANDLE)(0x42);
+	MESSAGE_HANDLE mh2 = (MESSAGE_HANDLE)(0x43);
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, mh1);
+	MESSAGE_QUEUE_push(mq, mh2);
+	(void)MESSAGE_QUEUE_pop(mq);
+	MESSAGE_QUEUE_push(mq, mh1);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	size_t size = MESSAGE_QUEUE_size(mq);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 2, size);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
 ///arrange
 ///act
 ///assert
 ///ablutions
 END_TEST_SUITE(message_q_ut);
-
-
@@ -0,0 +1,557 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+static bool malloc_will_fail = false;
+static size_t malloc_fail_count = 0;
+static size_t malloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    ++malloc_count;
+
+    void* result;
+    if (malloc_will_fail == true && malloc_count == malloc_fail_count)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+#include "message.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "message_ring.h"
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    free(handle);
+    return LOCK_OK;
+}
+
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    free(handle);
+}
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(message_ring_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // lock & condition hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_TIMEOUT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    malloc_will_fail = false;
+    malloc_fail_count = 0;
+    malloc_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_001: [ MESSAGE_RING_create shall return NULL if capacity is 0 or larger than 2^24. ]*/
+TEST_FUNCTION(MESSAGE_RING_create_fails_with_bad_capacity)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_RING_HANDLE r1 = MESSAGE_RING_create(0);
+    MESSAGE_RING_HANDLE r2 = MESSAGE_RING_create(((size_t)1 << 24) + 1);
+
+    ///assert
+    ASSERT_IS_NULL(r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_004: [ MESSAGE_RING_create shall allocate one cell per slot. ]*/
+/*Tests_SRS_MESSAGE_RING_17_005: [ MESSAGE_RING_create shall create a lock and a condition used to put an idle consumer to sleep. ]*/
+TEST_FUNCTION(MESSAGE_RING_create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+
+    ///act
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(16);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(ring);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_002: [ MESSAGE_RING_create shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MESSAGE_RING_create_fails_when_underlying_calls_fail)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        ///arrange
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(16);
+
+        ///assert
+        ASSERT_IS_NULL(ring);
+    }
+
+    ///ablutions
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_MESSAGE_RING_17_003: [ MESSAGE_RING_create shall round capacity up to the next power of two. ]*/
+/*Tests_SRS_MESSAGE_RING_17_013: [ MESSAGE_RING_push shall return a non-zero value, without blocking, if the ring is full. ]*/
+TEST_FUNCTION(MESSAGE_RING_push_fails_when_ring_is_full)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(3);
+    MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
+    size_t i;
+    for (i = 0; i < 4; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, MESSAGE_RING_push(ring, element));
+    }
+    umock_c_reset_all_calls();
+
+    ///act
+    int result = MESSAGE_RING_push(ring, element);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    for (i = 0; i < 4; i++)
+    {
+        STRICT_EXPECTED_CALL(Message_Destroy(element));
+    }
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_006: [ A newly created ring shall be empty and open. ]*/
+/*Tests_SRS_MESSAGE_RING_17_009: [ MESSAGE_RING_destroy shall free all allocated resources. ]*/
+TEST_FUNCTION(MESSAGE_RING_destroy_frees_an_empty_ring)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MESSAGE_RING_destroy(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_007: [ MESSAGE_RING_destroy shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_RING_destroy_does_nothing_with_nothing)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_RING_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_008: [ MESSAGE_RING_destroy shall destroy every message still in the ring. ]*/
+TEST_FUNCTION(MESSAGE_RING_destroy_destroys_queued_messages)
+{
+    ///arrange
+    MESSAGE_HANDLE m1 = (MESSAGE_HANDLE)0x42;
+    MESSAGE_HANDLE m2 = (MESSAGE_HANDLE)0x43;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    (void)MESSAGE_RING_push(ring, m1);
+    (void)MESSAGE_RING_push(ring, m2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_Destroy(m1));
+    STRICT_EXPECTED_CALL(Message_Destroy(m2));
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MESSAGE_RING_destroy(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_010: [ MESSAGE_RING_push shall return a non-zero value if handle or element are NULL. ]*/
+TEST_FUNCTION(MESSAGE_RING_push_does_nothing_with_null_params)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE handle = (MESSAGE_RING_HANDLE)0x42;
+    MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
+
+    ///act
+    int mp1 = MESSAGE_RING_push(NULL, element);
+    int mp2 = MESSAGE_RING_push(handle, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, mp1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, mp2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_012: [ MESSAGE_RING_push shall claim the next free slot without taking a lock. ]*/
+/*Tests_SRS_MESSAGE_RING_17_014: [ MESSAGE_RING_push shall wake the consumer only if it is waiting on an empty ring. ]*/
+/*Tests_SRS_MESSAGE_RING_17_015: [ MESSAGE_RING_push shall return zero on success. ]*/
+TEST_FUNCTION(MESSAGE_RING_push_success_takes_no_lock)
+{
+    ///arrange
+    MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    umock_c_reset_all_calls();
+
+    ///act
+    int result = MESSAGE_RING_push(ring, element);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    STRICT_EXPECTED_CALL(Message_Destroy(element));
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_011: [ MESSAGE_RING_push shall return a non-zero value if the ring is closed. ]*/
+TEST_FUNCTION(MESSAGE_RING_push_fails_on_closed_ring)
+{
+    ///arrange
+    MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    MESSAGE_RING_close(ring);
+    umock_c_reset_all_calls();
+
+    ///act
+    int result = MESSAGE_RING_push(ring, element);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_016: [ MESSAGE_RING_pop shall return NULL if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_RING_pop_returns_null_with_null_handle)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_HANDLE result = MESSAGE_RING_pop(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_018: [ MESSAGE_RING_pop shall remove messages from the ring in a first-in-first-out order. ]*/
+TEST_FUNCTION(MESSAGE_RING_pop_is_fifo)
+{
+    ///arrange
+    MESSAGE_HANDLE m1 = (MESSAGE_HANDLE)0x42;
+    MESSAGE_HANDLE m2 = (MESSAGE_HANDLE)0x43;
+    MESSAGE_HANDLE m3 = (MESSAGE_HANDLE)0x44;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    (void)MESSAGE_RING_push(ring, m1);
+    (void)MESSAGE_RING_push(ring, m2);
+    (void)MESSAGE_RING_push(ring, m3);
+    umock_c_reset_all_calls();
+
+    ///act
+    MESSAGE_HANDLE r1 = MESSAGE_RING_pop(ring);
+    MESSAGE_HANDLE r2 = MESSAGE_RING_pop(ring);
+    MESSAGE_HANDLE r3 = MESSAGE_RING_pop(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, m1, r1);
+    ASSERT_ARE_EQUAL(void_ptr, m2, r2);
+    ASSERT_ARE_EQUAL(void_ptr, m3, r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_018: [ MESSAGE_RING_pop shall remove messages from the ring in a first-in-first-out order. ]*/
+TEST_FUNCTION(MESSAGE_RING_push_pop_wraps_around)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(2);
+    size_t i;
+    umock_c_reset_all_calls();
+
+    ///act
+    for (i = 1; i <= 10; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, MESSAGE_RING_push(ring, (MESSAGE_HANDLE)i));
+        ASSERT_ARE_EQUAL(void_ptr, (void*)i, MESSAGE_RING_pop(ring));
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_017: [ MESSAGE_RING_pop shall return NULL once the ring is closed. ]*/
+/*Tests_SRS_MESSAGE_RING_17_021: [ MESSAGE_RING_close shall mark the ring closed and wake the consumer. ]*/
+TEST_FUNCTION(MESSAGE_RING_pop_returns_null_after_close)
+{
+    ///arrange
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MESSAGE_RING_close(ring);
+    MESSAGE_HANDLE result = MESSAGE_RING_pop(ring);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_022: [ MESSAGE_RING_try_pop shall return NULL if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_RING_try_pop_returns_null_with_null_handle)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_HANDLE result = MESSAGE_RING_try_pop(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MESSAGE_RING_17_024: [ MESSAGE_RING_try_pop shall remove the oldest message from the ring, or return NULL without waiting if the ring is empty. ]*/
+TEST_FUNCTION(MESSAGE_RING_try_pop_does_not_wait_on_empty_ring)
+{
+    ///arrange
+    MESSAGE_HANDLE m1 = (MESSAGE_HANDLE)0x42;
+    MESSAGE_HANDLE m2 = (MESSAGE_HANDLE)0x43;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    (void)MESSAGE_RING_push(ring, m1);
+    (void)MESSAGE_RING_push(ring, m2);
+    umock_c_reset_all_calls();
+
+    ///act
+    MESSAGE_HANDLE r1 = MESSAGE_RING_try_pop(ring);
+    MESSAGE_HANDLE r2 = MESSAGE_RING_try_pop(ring);
+    MESSAGE_HANDLE r3 = MESSAGE_RING_try_pop(ring);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, m1, r1);
+    ASSERT_ARE_EQUAL(void_ptr, m2, r2);
+    ASSERT_IS_NULL(r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_023: [ MESSAGE_RING_try_pop shall return NULL once the ring is closed. ]*/
+TEST_FUNCTION(MESSAGE_RING_try_pop_returns_null_after_close)
+{
+    ///arrange
+    MESSAGE_HANDLE element = (MESSAGE_HANDLE)0x42;
+    MESSAGE_RING_HANDLE ring = MESSAGE_RING_create(4);
+    (void)MESSAGE_RING_push(ring, element);
+    MESSAGE_RING_close(ring);
+    umock_c_reset_all_calls();
+
+    ///act
+    MESSAGE_HANDLE result = MESSAGE_RING_try_pop(ring);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    STRICT_EXPECTED_CALL(Message_Destroy(element));
+    MESSAGE_RING_destroy(ring);
+}
+
+/*Tests_SRS_MESSAGE_RING_17_020: [ MESSAGE_RING_close shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(MESSAGE_RING_close_does_nothing_with_nothing)
+{
+    ///arrange
+
+    ///act
+    MESSAGE_RING_close(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+END_TEST_SUITE(message_ring_ut)
@@ -0,0 +1,657 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "module_scheduler.h"
+
+#define TEST_MAX_WORKERS 4
+
+static THREAD_START_FUNC worker_funcs[TEST_MAX_WORKERS];
+static void* worker_args[TEST_MAX_WORKERS];
+static size_t worker_count;
+
+static size_t run_count;
+static size_t run_budget;
+static size_t run_more_count;
+static bool run_notifies;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    free(handle);
+    return LOCK_OK;
+}
+
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    free(handle);
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = (THREAD_HANDLE)arg;
+    if (worker_count < TEST_MAX_WORKERS)
+    {
+        worker_funcs[worker_count] = func;
+        worker_args[worker_count] = arg;
+        worker_count++;
+    }
+    return THREADAPI_OK;
+}
+
+static MODULE_TASK_HANDLE running_task;
+
+static bool test_task_run(void* context, size_t budget)
+{
+    (void)context;
+    run_count++;
+    run_budget = budget;
+    if (run_notifies)
+    {
+        run_notifies = false;
+        MODULE_SCHEDULER_notify(running_task);
+    }
+    return run_count <= run_more_count;
+}
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(module_scheduler_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // lock & condition hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_TIMEOUT);
+
+    // thread hooks, workers are run by hand
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    worker_count = 0;
+    run_count = 0;
+    run_budget = 0;
+    run_more_count = 0;
+    run_notifies = false;
+    running_task = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_002: [ MODULE_SCHEDULER_create shall return NULL if worker_count is larger than 1024. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_create_fails_with_too_many_workers)
+{
+    ///arrange
+
+    ///act
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1025);
+
+    ///assert
+    ASSERT_IS_NULL(scheduler);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_004: [ MODULE_SCHEDULER_create shall allocate one worker, with an empty queue and a lock, per worker thread. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_005: [ MODULE_SCHEDULER_create shall create a lock and a condition used to put idle workers to sleep. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_006: [ MODULE_SCHEDULER_create shall start a thread for every worker. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(scheduler);
+    ASSERT_ARE_EQUAL(size_t, 2, worker_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_001: [ If worker_count is 0, MODULE_SCHEDULER_create shall start one worker per processor. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_create_with_no_worker_count_starts_workers)
+{
+    ///arrange
+
+    ///act
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(scheduler);
+    ASSERT_IS_TRUE(worker_count > 0);
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_003: [ MODULE_SCHEDULER_create shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_create_fails_when_underlying_calls_fail)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        ///arrange
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(2);
+
+        ///assert
+        ASSERT_IS_NULL(scheduler);
+    }
+
+    ///ablutions
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_007: [ MODULE_SCHEDULER_destroy shall do nothing if handle is NULL. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_destroy_does_nothing_with_nothing)
+{
+    ///arrange
+
+    ///act
+    MODULE_SCHEDULER_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_008: [ MODULE_SCHEDULER_destroy shall mark the scheduler stopping, wake every worker and join every worker thread. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_009: [ MODULE_SCHEDULER_destroy shall free all allocated resources. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_destroy_joins_workers_and_frees)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MODULE_SCHEDULER_destroy(scheduler);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_010: [ MODULE_SCHEDULER_add_task shall return NULL if handle or run are NULL. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_add_task_fails_with_null_params)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    umock_c_reset_all_calls();
+
+    ///act
+    MODULE_TASK_HANDLE t1 = MODULE_SCHEDULER_add_task(NULL, test_task_run, NULL);
+    MODULE_TASK_HANDLE t2 = MODULE_SCHEDULER_add_task(scheduler, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(t1);
+    ASSERT_IS_NULL(t2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_011: [ MODULE_SCHEDULER_add_task shall return NULL if it cannot allocate the task. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_add_task_fails_when_malloc_fails)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    ///act
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(task);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_012: [ MODULE_SCHEDULER_add_task shall create an idle task whose home is the next worker in turn. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_add_task_success_does_not_run_it)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(task);
+    ASSERT_ARE_EQUAL(size_t, 0, run_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_remove_task(task);
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_013: [ MODULE_SCHEDULER_notify shall do nothing if task is NULL. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_notify_does_nothing_with_nothing)
+{
+    ///arrange
+
+    ///act
+    MODULE_SCHEDULER_notify(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_014: [ If the task is idle, MODULE_SCHEDULER_notify shall queue it on its home worker. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_016: [ If the task is queued already, MODULE_SCHEDULER_notify shall do nothing. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_notify_queues_an_idle_task_once)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MODULE_SCHEDULER_notify(task);
+    MODULE_SCHEDULER_notify(task);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, run_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+    free(task);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_018: [ A worker shall take the oldest task from its own queue or, if that is empty, steal the oldest task from the other workers' queues in turn. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_019: [ A worker shall run a task it took with a budget of 32 and make itself the task's home worker. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_021: [ A worker with no task to run shall sleep on the scheduler's condition until a task is queued or the scheduler is stopped. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_022: [ If a worker cannot lock the scheduler to sleep, it shall return. ]*/
+TEST_FUNCTION(worker_runs_a_notified_task_then_sleeps)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    MODULE_SCHEDULER_notify(task);
+    umock_c_reset_all_calls();
+
+    /*takes the task*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*finds nothing*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*goes to sleep*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    int result = worker_funcs[0](worker_args[0]);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, run_count);
+    ASSERT_ARE_EQUAL(size_t, 32, run_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_remove_task(task);
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_020: [ If the task's run function returns true, or the task was notified while it ran, the worker shall put it at the back of its own queue; otherwise the task shall become idle. ]*/
+TEST_FUNCTION(worker_requeues_a_task_with_work_left)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    MODULE_SCHEDULER_notify(task);
+    run_more_count = 1;
+    umock_c_reset_all_calls();
+
+    /*takes the task, puts it back, takes it again, finds nothing*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*goes to sleep*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    (void)worker_funcs[0](worker_args[0]);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, run_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_remove_task(task);
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_015: [ If the task is running, MODULE_SCHEDULER_notify shall have it queued again when it returns instead of running it on another worker. ]*/
+/*Tests_SRS_MODULE_SCHEDULER_17_020: [ If the task's run function returns true, or the task was notified while it ran, the worker shall put it at the back of its own queue; otherwise the task shall become idle. ]*/
+TEST_FUNCTION(worker_runs_again_a_task_notified_while_running)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    running_task = task;
+    run_notifies = true;
+    MODULE_SCHEDULER_notify(task);
+    umock_c_reset_all_calls();
+
+    /*takes the task, the notification queues nothing, the worker puts it back*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*goes to sleep*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    (void)worker_funcs[0](worker_args[0]);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, run_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_remove_task(task);
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_018: [ A worker shall take the oldest task from its own queue or, if that is empty, steal the oldest task from the other workers' queues in turn. ]*/
+TEST_FUNCTION(idle_worker_steals_a_task_from_another_worker)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(2);
+    /*the first task's home is the first worker*/
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    MODULE_SCHEDULER_notify(task);
+    umock_c_reset_all_calls();
+
+    /*own queue is empty, steals from the first worker*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*finds nothing anywhere*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    /*goes to sleep*/
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    (void)worker_funcs[1](worker_args[1]);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, run_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_remove_task(task);
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_023: [ MODULE_SCHEDULER_remove_task shall do nothing if task is NULL. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_remove_task_does_nothing_with_nothing)
+{
+    ///arrange
+
+    ///act
+    MODULE_SCHEDULER_remove_task(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+}
+
+/*Tests_SRS_MODULE_SCHEDULER_17_024: [ MODULE_SCHEDULER_remove_task shall wait until the task is neither queued nor running, then free it. ]*/
+TEST_FUNCTION(MODULE_SCHEDULER_remove_task_frees_an_idle_task)
+{
+    ///arrange
+    MODULE_SCHEDULER_HANDLE scheduler = MODULE_SCHEDULER_create(1);
+    MODULE_TASK_HANDLE task = MODULE_SCHEDULER_add_task(scheduler, test_task_run, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    MODULE_SCHEDULER_remove_task(task);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///ablutions
+    MODULE_SCHEDULER_destroy(scheduler);
+}
+
+END_TEST_SUITE(module_scheduler_ut)
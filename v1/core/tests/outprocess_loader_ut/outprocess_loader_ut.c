@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 
 #define disableNegativeTest(x) (negative_tests_to_skip |= ((uint64_t)1 << (x)))
@@ -99,6 +100,7 @@ static const THREAD_HANDLE MOCK_THREAD_HANDLE = (THREAD_HANDLE *)0x19791709;
 #endif
 
 int launch_child_process_from_entrypoint(OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry);
+int launch_replica_processes(OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry);
 int spawn_child_processes(void * context);
 int update_entrypoint_with_launch_object(OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry, const JSON_Object * launch_object);
 int validate_launch_arguments(const JSON_Object * launch_object);
@@ -133,7 +135,20 @@ MOCKABLE_FUNCTION(, JSON_Value_Type, json_value_get_type, const JSON_Value*, val
 // ** Mocking uv.h (Process handle)
 MOCK_FUNCTION_WITH_CODE(, int, uv_process_kill, uv_process_t *, handle, int, signum)
 MOCK_FUNCTION_END(0);
+#define MAX_RECORDED_SPAWNS 4
+static bool record_spawns = false;
+static size_t recorded_spawn_count = 0;
+static char recorded_spawn_args[MAX_RECORDED_SPAWNS][3][32];
+static uv_process_t * recorded_spawn_children[MAX_RECORDED_SPAWNS];
 MOCK_FUNCTION_WITH_CODE(, int, uv_spawn, uv_loop_t *, loop, uv_process_t *, handle, const uv_process_options_t *, options)
+    if (record_spawns && recorded_spawn_count < MAX_RECORDED_SPAWNS)
+    {
+        for (size_t i = 0; i < 3 && options->args[i] != NULL; ++i)
+        {
+            (void)strncpy(recorded_spawn_args[recorded_spawn_count][i], options->args[i], sizeof(recorded_spawn_args[0][0]) - 1);
+        }
+        recorded_spawn_children[recorded_spawn_count++] = handle;
+    }
 MOCK_FUNCTION_END(0);
 MOCK_FUNCTION_WITH_CODE(, void, uv_close, uv_handle_t *, handle, uv_close_cb, close_cb);
 MOCK_FUNCTION_END();
@@ -162,6 +177,16 @@ const MODULE_API_1 Outprocess_Module_API_all =
 	NULL,
 	NULL
 };
+const MODULE_API_1 Outprocess_Replica_Pool_API_all =
+{
+	{ MODULE_API_VERSION_1 },
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
 
 void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
@@ -727,6 +752,50 @@ TEST_FUNCTION(OutprocessModuleLoader_Load_succeeds)
     global_memory = false;
 }
 
+/*Tests_SRS_OUTPROCESS_LOADER_17_061: [ If the entrypoint has more than one replica, the loader shall store the Outprocess_Replica_Pool_API_all in the loader handle instead. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_Load_with_replicas_stores_the_replica_pool_api)
+{
+	// arrange
+	OUTPROCESS_LOADER_ENTRYPOINT entrypoint =
+	{
+		OUTPROCESS_LOADER_ACTIVATION_NONE,
+		(STRING_HANDLE)0x42,
+		(STRING_HANDLE)0x42,
+		0,
+		NULL,
+		0,
+		0,
+		0,
+		0,
+		OUTPROCESS_MESSAGE_CHANNEL_NANOMSG,
+		0,
+		0,
+		BROKER_OVERFLOW_DROP_NEWEST,
+		OUTPROCESS_IO_THREADS_MODULE,
+		3
+	};
+	MODULE_LOADER loader =
+	{
+		OUTPROCESS,
+		NULL, NULL, NULL
+	};
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_LIBRARY_HANDLE module = OutprocessModuleLoader_Load(&loader, &entrypoint);
+	const MODULE_API* result = OutprocessModuleLoader_GetModuleApi(&loader, module);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(void_ptr, (const MODULE_API*)&Outprocess_Replica_Pool_API_all, result);
+
+	// cleanup
+	OutprocessModuleLoader_Unload(&loader, module);
+}
+
 TEST_FUNCTION(OutprocessModuleLoader_GetModuleApi_returns_NULL_when_moduleLibraryHandle_is_NULL)
 {
     // act
@@ -998,6 +1067,13 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_returns_NULL_when_u
 /*Tests_SRS_OUTPROCESS_LOADER_27_020: [ Launch - `OutprocessModuleLoader_ParseEntrypointFromJson` shall update the entry point with the parsed launch parameters. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_043: [ This function shall read the "timeout" value. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_044: [ If "timeout" is set, the remote_message_wait shall be set to this value, else it will be set to a default of 1000 ms. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_045: [ This function shall read the "batch.max.messages", "batch.max.bytes" and "batch.linger.ms" values. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_047: [ If "batch.max.messages" is set but "batch.max.bytes" is not, batch_max_bytes shall be set to a default of 65536. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_052: [ This function shall read the "credit.window" value, and set credit_window to 0 if it is not set, so messages are sent without credit. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_067: [ This function shall read the "credit.overflow" value; if it is "drop_oldest", credit_overflow shall be BROKER_OVERFLOW_DROP_OLDEST, if it is "block", BROKER_OVERFLOW_BLOCK, else BROKER_OVERFLOW_DROP_NEWEST. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_054: [ This function shall read the "io.threads" value; if it is "shared", io_threads shall be OUTPROCESS_IO_THREADS_SHARED, else OUTPROCESS_IO_THREADS_MODULE. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_056: [ This function shall read the "replicas" value, and set replicas to 1 if it is not set. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_057: [ This function shall read the "balance" value; if it is "least_queue_depth", balance shall be OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, if it is "hash", OUTPROCESS_BALANCE_HASH, else OUTPROCESS_BALANCE_ROUND_ROBIN. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_022: [ This function shall return a valid pointer to an OUTPROCESS_LOADER_ENTRYPOINT on success. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 {
@@ -1024,6 +1100,158 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
     expected_calls_update_entrypoint_with_launch_object();
 	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
 		.SetReturn(2000);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.messages"))
+		.SetReturn(32);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.bytes"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger.ms"))
+		.SetReturn(5);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.channel"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "message.channel.size"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "credit.window"))
+		.SetReturn(64);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "credit.overflow"))
+		.SetReturn("block");
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "io.threads"))
+		.SetReturn("shared");
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "replicas"))
+		.SetReturn(4);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance"))
+		.SetReturn("least_queue_depth");
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	OUTPROCESS_LOADER_ENTRYPOINT * ep = (OUTPROCESS_LOADER_ENTRYPOINT*)result;
+	ASSERT_ARE_EQUAL(int, 2000, (int)ep->remote_message_wait);
+	ASSERT_ARE_EQUAL(int, 32, (int)ep->batch_max_messages);
+	ASSERT_ARE_EQUAL(int, 65536, (int)ep->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 5, (int)ep->batch_linger_ms);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_MESSAGE_CHANNEL_NANOMSG, (int)ep->message_channel);
+	ASSERT_ARE_EQUAL(int, 1024 * 1024, (int)ep->message_channel_size);
+	ASSERT_ARE_EQUAL(int, 64, (int)ep->credit_window);
+	ASSERT_ARE_EQUAL(int, BROKER_OVERFLOW_BLOCK, (int)ep->credit_overflow);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_IO_THREADS_SHARED, (int)ep->io_threads);
+	ASSERT_ARE_EQUAL(int, 4, (int)ep->replicas);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, (int)ep->balance);
+	ASSERT_IS_NULL(ep->balance_property);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_046: [ If "batch.max.messages" is not set, batch_max_messages, batch_max_bytes and batch_linger_ms shall be 0, so messages are sent one at a time. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_without_batch_max_messages_does_not_batch)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x43, "launch"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.messages"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.bytes"))
+		.SetReturn(4096);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger.ms"))
+		.SetReturn(5);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.channel"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "message.channel.size"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "credit.window"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "credit.overflow"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "io.threads"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "replicas"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	OUTPROCESS_LOADER_ENTRYPOINT * ep = (OUTPROCESS_LOADER_ENTRYPOINT*)result;
+	ASSERT_ARE_EQUAL(int, 1000, (int)ep->remote_message_wait);
+	ASSERT_ARE_EQUAL(int, 0, (int)ep->batch_max_messages);
+	ASSERT_ARE_EQUAL(int, 0, (int)ep->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 0, (int)ep->batch_linger_ms);
+	ASSERT_ARE_EQUAL(int, 0, (int)ep->credit_window);
+	ASSERT_ARE_EQUAL(int, BROKER_OVERFLOW_DROP_NEWEST, (int)ep->credit_overflow);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_IO_THREADS_MODULE, (int)ep->io_threads);
+	ASSERT_ARE_EQUAL(int, 1, (int)ep->replicas);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_BALANCE_ROUND_ROBIN, (int)ep->balance);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_048: [ This function shall read the "message.channel" and "message.channel.size" values. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_049: [ If "message.channel" is "shared_memory", message_channel shall be OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, else OUTPROCESS_MESSAGE_CHANNEL_NANOMSG. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_reads_shared_memory_channel)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x43, "launch"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.messages"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.bytes"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger.ms"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.channel"))
+		.SetReturn("shared_memory");
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "message.channel.size"))
+		.SetReturn(65536);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "credit.window"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "credit.overflow"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "io.threads"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "replicas"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance"))
+		.SetReturn(NULL);
 	STRICT_EXPECTED_CALL(STRING_construct(NULL));
 
 	// act
@@ -1032,6 +1260,129 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 	// assert
 	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	OUTPROCESS_LOADER_ENTRYPOINT * ep = (OUTPROCESS_LOADER_ENTRYPOINT*)result;
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, (int)ep->message_channel);
+	ASSERT_ARE_EQUAL(int, 65536, (int)ep->message_channel_size);
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_058: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall assign balance_property to the string value of "balance.property", and set balance to OUTPROCESS_BALANCE_ROUND_ROBIN if it is not present; balance_property shall be NULL otherwise. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_reads_hash_balance)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x43, "launch"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.messages"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.bytes"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger.ms"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.channel"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "message.channel.size"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "credit.window"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "credit.overflow"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "io.threads"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "replicas"))
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance"))
+		.SetReturn("hash");
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance.property"))
+		.SetReturn("deviceName");
+	STRICT_EXPECTED_CALL(STRING_construct("deviceName"));
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	OUTPROCESS_LOADER_ENTRYPOINT * ep = (OUTPROCESS_LOADER_ENTRYPOINT*)result;
+	ASSERT_ARE_EQUAL(int, 2, (int)ep->replicas);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_BALANCE_HASH, (int)ep->balance);
+	ASSERT_ARE_EQUAL(char_ptr, "deviceName", STRING_c_str(ep->balance_property));
+	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+/*Tests_SRS_OUTPROCESS_LOADER_17_058: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall assign balance_property to the string value of "balance.property", and set balance to OUTPROCESS_BALANCE_ROUND_ROBIN if it is not present; balance_property shall be NULL otherwise. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_hash_balance_without_property_is_round_robin)
+{
+	// arrange
+	char * activation_type = "none";
+	char * control_id = "a url";
+
+	STRICT_EXPECTED_CALL(json_value_get_type((JSON_Value*)0x42))
+		.SetReturn(JSONObject);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x42))
+		.SetReturn((JSON_Object*)0x43);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "activation.type"))
+		.SetReturn(activation_type);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "control.id"))
+		.SetReturn(control_id);
+	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x43, "launch"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.id"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_LOADER_ENTRYPOINT)));
+	STRICT_EXPECTED_CALL(STRING_construct(control_id));
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.messages"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.max.bytes"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "batch.linger.ms"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "message.channel"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "message.channel.size"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "credit.window"))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "credit.overflow"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "io.threads"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "replicas"))
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance"))
+		.SetReturn("hash");
+	STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x43, "balance.property"))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(STRING_construct(NULL));
+
+	// act
+	void* result = OutprocessModuleLoader_ParseEntrypointFromJson(NULL, (JSON_Value*)0x42);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	OUTPROCESS_LOADER_ENTRYPOINT * ep = (OUTPROCESS_LOADER_ENTRYPOINT*)result;
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_BALANCE_ROUND_ROBIN, (int)ep->balance);
+	ASSERT_IS_NULL(ep->balance_property);
 	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
 }
 
@@ -1131,9 +1482,58 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_returns_null_on_nu
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/*Tests_SRS_OUTPROCESS_LOADER_17_051: [ If message_channel is OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, the message uri shall start with "shm://" instead of "ipc://". ]*/
+TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_uses_shm_uri_for_shared_memory_channel)
+{
+	//arrange
+	OUTPROCESS_LOADER_ENTRYPOINT ep =
+	{
+		OUTPROCESS_LOADER_ACTIVATION_NONE,
+		STRING_construct("control_id"),
+		STRING_construct("message_id"),
+		0,
+		NULL,
+		0,
+		0,
+		0,
+		0,
+		OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY,
+		65536
+	};
+	STRING_HANDLE mc = STRING_construct("message config");
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_MODULE_CONFIG)));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.message_id));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.control_id));
+	STRICT_EXPECTED_CALL(STRING_clone(mc));
+
+	//act
+	void * result = OutprocessModuleLoader_BuildModuleConfiguration(NULL, &ep, mc);
+	OUTPROCESS_MODULE_CONFIG *omc = (OUTPROCESS_MODULE_CONFIG*)result;
+
+	//assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->control_uri), "ipc://control_id");
+	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->message_uri), "shm://message_id");
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, (int)omc->message_channel);
+	ASSERT_ARE_EQUAL(int, 65536, (int)omc->message_channel_size);
+
+	//cleanup
+	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
+	STRING_delete(ep.control_id);
+	STRING_delete(ep.message_id);
+	STRING_delete(mc);
+}
+
 /*Tests_SRS_OUTPROCESS_LOADER_17_033: [ This function shall allocate and copy each string in OUTPROCESS_LOADER_ENTRYPOINT and assign them to the corresponding fields in OUTPROCESS_MODULE_CONFIG. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_034: [ This function shall allocate and copy the module_configuration string and assign it the OUTPROCESS_MODULE_CONFIG::outprocess_module_args field. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_053: [ The module configuration shall take credit_window from the entrypoint. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_068: [ The module configuration shall take credit_overflow from the entrypoint. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_055: [ The module configuration shall take io_threads from the entrypoint. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_027: [ This function shall allocate a OUTPROCESS_MODULE_CONFIG structure. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_url)
 {
@@ -1145,7 +1545,15 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 		STRING_construct("message_id"),
 		0,
 		NULL,
-		0
+		0,
+		16,
+		8192,
+		2,
+		OUTPROCESS_MESSAGE_CHANNEL_NANOMSG,
+		0,
+		32,
+		BROKER_OVERFLOW_DROP_OLDEST,
+		OUTPROCESS_IO_THREADS_SHARED
 	};
 	STRING_HANDLE mc = STRING_construct("message config");
 
@@ -1166,6 +1574,12 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->control_uri), "ipc://control_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->message_uri), "ipc://message_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->outprocess_module_args), STRING_c_str(mc));
+	ASSERT_ARE_EQUAL(int, 16, (int)omc->batch_max_messages);
+	ASSERT_ARE_EQUAL(int, 8192, (int)omc->batch_max_bytes);
+	ASSERT_ARE_EQUAL(int, 2, (int)omc->batch_linger_ms);
+	ASSERT_ARE_EQUAL(int, 32, (int)omc->credit_window);
+	ASSERT_ARE_EQUAL(int, BROKER_OVERFLOW_DROP_OLDEST, (int)omc->credit_overflow);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_IO_THREADS_SHARED, (int)omc->io_threads);
 
 	//cleanup
 	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
@@ -1174,6 +1588,60 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 	STRING_delete(mc);
 }
 
+/*Tests_SRS_OUTPROCESS_LOADER_17_059: [ The module configuration shall take replicas and balance from the entrypoint, and a copy of its balance_property if there is one. ]*/
+TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_takes_replicas_and_balance)
+{
+	//arrange
+	OUTPROCESS_LOADER_ENTRYPOINT ep =
+	{
+		OUTPROCESS_LOADER_ACTIVATION_NONE,
+		STRING_construct("control_id"),
+		STRING_construct("message_id"),
+		0,
+		NULL,
+		0,
+		0,
+		0,
+		0,
+		OUTPROCESS_MESSAGE_CHANNEL_NANOMSG,
+		0,
+		0,
+		BROKER_OVERFLOW_DROP_NEWEST,
+		OUTPROCESS_IO_THREADS_MODULE,
+		3,
+		OUTPROCESS_BALANCE_HASH,
+		STRING_construct("deviceName")
+	};
+	STRING_HANDLE mc = STRING_construct("message config");
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(OUTPROCESS_MODULE_CONFIG)));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.message_id));
+	STRICT_EXPECTED_CALL(STRING_c_str(ep.control_id));
+	STRICT_EXPECTED_CALL(STRING_clone(mc));
+	STRICT_EXPECTED_CALL(STRING_clone(ep.balance_property));
+
+	//act
+	void * result = OutprocessModuleLoader_BuildModuleConfiguration(NULL, &ep, mc);
+	OUTPROCESS_MODULE_CONFIG *omc = (OUTPROCESS_MODULE_CONFIG*)result;
+
+	//assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 3, (int)omc->replicas);
+	ASSERT_ARE_EQUAL(int, OUTPROCESS_BALANCE_HASH, (int)omc->balance);
+	ASSERT_ARE_EQUAL(char_ptr, "deviceName", STRING_c_str(omc->balance_property));
+	ASSERT_IS_NULL(omc->publish_source);
+
+	//cleanup
+	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
+	STRING_delete(ep.control_id);
+	STRING_delete(ep.message_id);
+	STRING_delete(ep.balance_property);
+	STRING_delete(mc);
+}
+
 /*Tests_SRS_OUTPROCESS_LOADER_17_029: [ If the entrypoint's message_id is NULL, then the loader shall construct an IPC url. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_030: [ The loader shall create a unique id, if needed for URL constrution. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_032: [ The message url shall be composed of "ipc://" + unique id. ]*/
@@ -1481,6 +1949,115 @@ TEST_FUNCTION(OutprocessLoader_JoinChildProcesses_SCENARIO_no_processes_active)
 }
 
 
+/* Tests_SRS_OUTPROCESS_LOADER_17_063: [ `launch_replica_processes` shall allocate an argument array as long as the one of the entrypoint. ] */
+/* Tests_SRS_OUTPROCESS_LOADER_17_064: [ For each replica, `launch_replica_processes` shall pass the launch arguments with each one equal to the control id replaced by the control id of the replica, "<control.id>.<index>". ] */
+/* Tests_SRS_OUTPROCESS_LOADER_17_065: [ `launch_replica_processes` shall launch each replica like `launch_child_process_from_entrypoint`. ] */
+TEST_FUNCTION(launch_replica_processes_launches_a_process_per_replica_with_its_control_id)
+{
+    // arrange
+    char * process_argv[] = {
+        "program.exe",
+        "-c",
+        "control.id",
+        NULL
+    };
+    OUTPROCESS_LOADER_ENTRYPOINT entrypoint = {
+        OUTPROCESS_LOADER_ACTIVATION_LAUNCH,
+        STRING_construct("control.id"),
+        NULL,
+        3,
+        process_argv,
+        0,
+        0,
+        0,
+        0,
+        OUTPROCESS_MESSAGE_CHANNEL_NANOMSG,
+        0,
+        0,
+        BROKER_OVERFLOW_DROP_NEWEST,
+        OUTPROCESS_IO_THREADS_MODULE,
+        2
+    };
+    record_spawns = true;
+    recorded_spawn_count = 0;
+    memset(recorded_spawn_args, 0, sizeof(recorded_spawn_args));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.control_id));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(char *) * 4));
+    for (size_t i = 0; i < 2; ++i) {
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        expected_calls_launch_child_process_from_entrypoint(0 == i);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    int result = launch_replica_processes(&entrypoint);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, recorded_spawn_count);
+    ASSERT_ARE_EQUAL(char_ptr, "program.exe", recorded_spawn_args[0][0]);
+    ASSERT_ARE_EQUAL(char_ptr, "-c", recorded_spawn_args[0][1]);
+    ASSERT_ARE_EQUAL(char_ptr, "control.id.0", recorded_spawn_args[0][2]);
+    ASSERT_ARE_EQUAL(char_ptr, "control.id.1", recorded_spawn_args[1][2]);
+
+    // cleanup
+    record_spawns = false;
+    OutprocessLoader_JoinChildProcesses();
+    for (size_t i = 0; i < recorded_spawn_count; ++i) {
+        free(recorded_spawn_children[i]);
+    }
+    STRING_delete(entrypoint.control_id);
+}
+
+/* Tests_SRS_OUTPROCESS_LOADER_17_062: [ If no launch argument is the control id, then `launch_replica_processes` shall return a non-zero value, since the replicas could not be told apart. ] */
+TEST_FUNCTION(launch_replica_processes_fails_when_no_argument_is_the_control_id)
+{
+    // arrange
+    char * process_argv[] = {
+        "program.exe",
+        "-c",
+        "another.id",
+        NULL
+    };
+    OUTPROCESS_LOADER_ENTRYPOINT entrypoint = {
+        OUTPROCESS_LOADER_ACTIVATION_LAUNCH,
+        STRING_construct("control.id"),
+        NULL,
+        3,
+        process_argv,
+        0,
+        0,
+        0,
+        0,
+        OUTPROCESS_MESSAGE_CHANNEL_NANOMSG,
+        0,
+        0,
+        BROKER_OVERFLOW_DROP_NEWEST,
+        OUTPROCESS_IO_THREADS_MODULE,
+        2
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.control_id));
+
+    // act
+    int result = launch_replica_processes(&entrypoint);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.control_id);
+}
+
 /* Tests_SRS_OUTPROCESS_LOADER_27_059: [** If the child processes are not running, `OutprocessLoader_JoinChildProcesses` shall shall immediately join the child process management thread. ] */
 TEST_FUNCTION(OutprocessLoader_JoinChildProcesses_SCENARIO_processes_exit_during_grace_period)
 {
@@ -56,13 +56,21 @@ void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "broker.h"
 #include "module_loader.h"
 #include "message_queue.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #undef ENABLE_MOCKS
 #include "control_message.h"
 
+#define ENABLE_MOCKS
+#include "message_batch.h"
+#include "shared_memory_channel.h"
+#include "socket_poller.h"
+#undef ENABLE_MOCKS
+
 #include "module_loaders/outprocess_module.h"
 
 //=============================================================================
@@ -199,6 +207,14 @@ MOCK_FUNCTION_WITH_CODE(, int, nn_recv, int, s, void *, buf, size_t, len, int, f
 	}
 MOCK_FUNCTION_END(rcv_length)
 
+static int nn_poll_result;
+MOCK_FUNCTION_WITH_CODE(, int, nn_poll, struct nn_pollfd *, fds, int, nfds, int, timeout)
+	if (nn_poll_result > 0)
+	{
+		fds[0].revents = NN_POLLIN;
+	}
+MOCK_FUNCTION_END(nn_poll_result)
+
 MOCK_FUNCTION_WITH_CODE(, void*, nn_allocmsg, size_t, size, int, type)
 	void * alloc_result = my_gballoc_malloc(size);
 	nn_current_msg_size = size;
@@ -312,8 +328,23 @@ MOCK_FUNCTION_END((CONTROL_MESSAGE*)&global_control_msg)
 MOCK_FUNCTION_WITH_CODE(, void, ControlMessage_Destroy, CONTROL_MESSAGE *, message)
 MOCK_FUNCTION_END()
 
+/*the frame limits offered by the last create message serialized*/
+static MESSAGE_BATCH_LIMITS sent_batch_offer;
+/*the credit window offered by the last create message serialized*/
+static uint32_t sent_credit_offer;
+/*the message versions of the last create message serialized*/
+static uint8_t sent_message_version;
+static uint8_t sent_max_message_version;
+
 MOCK_FUNCTION_WITH_CODE(, int32_t, ControlMessage_ToByteArray, CONTROL_MESSAGE *, message, unsigned char*, buf, int32_t, size)
 	int32_t carray_size = default_serialized_size;
+	if (message != NULL && message->type == CONTROL_MESSAGE_TYPE_MODULE_CREATE)
+	{
+		sent_batch_offer = ((CONTROL_MESSAGE_MODULE_CREATE*)message)->batch_limits;
+		sent_credit_offer = ((CONTROL_MESSAGE_MODULE_CREATE*)message)->credit_window;
+		sent_message_version = ((CONTROL_MESSAGE_MODULE_CREATE*)message)->gateway_message_version;
+		sent_max_message_version = ((CONTROL_MESSAGE_MODULE_CREATE*)message)->max_message_version;
+	}
 MOCK_FUNCTION_END(carray_size)
 
 /*  Message mocks 
@@ -327,32 +358,92 @@ uint8_t *counter = (uint8_t*)m1;
 *counter = 1;
 MOCK_FUNCTION_END(m1)
 
+MOCK_FUNCTION_WITH_CODE(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
+MESSAGE_HANDLE m3 = (MESSAGE_HANDLE)my_gballoc_malloc(default_message_size);
+uint8_t *counter = (uint8_t*)m3;
+*counter = 1;
+MOCK_FUNCTION_END(m3)
+
 MOCK_FUNCTION_WITH_CODE(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, msg)
 uint8_t *counter = (uint8_t*)msg;
 (*counter)++;
 MOCK_FUNCTION_END(msg)
 
-MOCK_FUNCTION_WITH_CODE(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
+/*the last message created on an owned byte array, released with its last reference*/
+static MESSAGE_HANDLE owned_message;
+static MESSAGE_BYTE_ARRAY_RELEASE owned_message_release;
+static void* owned_message_context;
+
+MOCK_FUNCTION_WITH_CODE(, MESSAGE_HANDLE, Message_CreateFromOwnedByteArray, const unsigned char*, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context)
 MESSAGE_HANDLE m2 = (MESSAGE_HANDLE)my_gballoc_malloc(size);
 uint8_t *counter = (uint8_t*)m2;
 *counter = 1;
+owned_message = m2;
+owned_message_release = release;
+owned_message_context = context;
 MOCK_FUNCTION_END(m2)
 
-MOCK_FUNCTION_WITH_CODE(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t, size)
-int32_t array_size = default_serialized_size;
-MOCK_FUNCTION_END(array_size)
+static unsigned char serialized_message_bytes[16];
+static CONSTBUFFER serialized_message;
+
+MOCK_FUNCTION_WITH_CODE(, const CONSTBUFFER*, Message_GetByteArray, MESSAGE_HANDLE, message)
+serialized_message.buffer = serialized_message_bytes;
+serialized_message.size = (size_t)default_serialized_size;
+MOCK_FUNCTION_END(&serialized_message)
+
+MOCK_FUNCTION_WITH_CODE(, int32_t, Message_ToByteArrayVersion, MESSAGE_HANDLE, messageHandle, uint8_t, version, unsigned char*, buf, int32_t, size)
+MOCK_FUNCTION_END(default_serialized_size)
 
 MOCK_FUNCTION_WITH_CODE(, void, Message_Destroy, MESSAGE_HANDLE, message)
 uint8_t *counter = (uint8_t*)message;
 --(*counter);
 if (*counter == 0)
+{
+	if (message == owned_message)
+	{
+		owned_message = NULL;
+		owned_message_release(owned_message_context);
+	}
 	my_gballoc_free(message);
+}
 MOCK_FUNCTION_END()
 
 
 MOCK_FUNCTION_WITH_CODE(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
 MOCK_FUNCTION_END(BROKER_OK)
 
+/*  Message batch mocks
+ */
+
+static MESSAGE_BATCH_LIMITS created_batch_limits;
+
+static MESSAGE_BATCH_HANDLE my_MessageBatch_Create(const MESSAGE_BATCH_LIMITS* limits)
+{
+	created_batch_limits = *limits;
+	return (MESSAGE_BATCH_HANDLE)0x50;
+}
+
+/* Socket poller mocks
+ */
+#define TEST_SOCKET_POLLER ((SOCKET_POLLER_HANDLE)0x60)
+static SOCKET_POLLER_ON_READABLE polled_callbacks[4];
+static void* polled_contexts[4];
+
+static int my_SocketPoller_Add(SOCKET_POLLER_HANDLE poller, int socket, SOCKET_POLLER_ON_READABLE on_readable, void* context)
+{
+	(void)poller;
+	polled_callbacks[socket] = on_readable;
+	polled_contexts[socket] = context;
+	return 0;
+}
+
+/*delivers the whole received buffer as the one message of the frame*/
+static int my_MessageBatch_ForEachMessage(const unsigned char* source, int32_t size, MESSAGE_BATCH_ON_MESSAGE on_message, void* context)
+{
+	on_message(context, source, size);
+	return 0;
+}
+
 BEGIN_TEST_SUITE(OutprocessModule_UnitTests)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -370,14 +461,29 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BYTE_ARRAY_RELEASE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_QUEUE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(struct nn_pollfd *, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_ON_MESSAGE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_BATCH_LIMITS*, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(SHARED_MEMORY_CHANNEL_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(SHARED_MEMORY_CHANNEL_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t*, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(SOCKET_POLLER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(SOCKET_POLLER_ON_READABLE, void*);
 
 	// STRING
 	REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, real_STRING_construct);
@@ -402,6 +508,19 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
 	// message queue
 	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
+	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create_with_capacity, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
+
+	// condition
+	REGISTER_GLOBAL_MOCK_RETURNS(Condition_Init, (COND_HANDLE)0x4C, NULL);
+	REGISTER_GLOBAL_MOCK_RETURNS(Condition_Post, COND_OK, COND_ERROR);
+
+	// message batch
+	REGISTER_GLOBAL_MOCK_HOOK(MessageBatch_Create, my_MessageBatch_Create);
+	REGISTER_GLOBAL_MOCK_HOOK(MessageBatch_ForEachMessage, my_MessageBatch_ForEachMessage);
+
+	// socket poller
+	REGISTER_GLOBAL_MOCK_RETURNS(SocketPoller_Create, TEST_SOCKET_POLLER, NULL);
+	REGISTER_GLOBAL_MOCK_HOOK(SocketPoller_Add, my_SocketPoller_Add);
 
 
 	Module_ParseConfigurationFromJson = Outprocess_Module_API_all.Module_ParseConfigurationFromJson;
@@ -437,6 +556,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	when_shall_nn_send_fail = 0;
 	current_nn_recv_index = 0;
 	when_shall_nn_recv_fail = 0;
+	nn_poll_result = 1;
 
 	current_nn_socket_index = 0;
 	current_nn_bind_index = 0;
@@ -468,6 +588,16 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	}
 
 	memset(&global_control_msg, 0, sizeof(CONTROL_MESSAGE_MODULE_CREATE));
+	memset(&created_batch_limits, 0, sizeof(MESSAGE_BATCH_LIMITS));
+	memset(&sent_batch_offer, 0, sizeof(MESSAGE_BATCH_LIMITS));
+	sent_credit_offer = 0;
+	sent_message_version = 0;
+	sent_max_message_version = 0;
+	for (int p = 0; p < 4; p++)
+	{
+		polled_callbacks[p] = NULL;
+		polled_contexts[p] = NULL;
+	}
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -591,6 +721,27 @@ static void setup_create_create_message(OUTPROCESS_MODULE_CONFIG* config)
 		.IgnoreArgument(2);
 }
 
+/*creates and starts a module offering frames of up to 8 messages and 65536 bytes, to a module host replying with reply_limits*/
+static MODULE_HANDLE create_module_offering_frames(OUTPROCESS_MODULE_CONFIG* config, MESSAGE_BATCH_LIMITS reply_limits)
+{
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->batch_limits = reply_limits;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->max_message_version = GATEWAY_MESSAGE_VERSION_CURRENT;
+
+	setup_create_config(config);
+	config->batch_max_messages = 8;
+	config->batch_max_bytes = 65536;
+	config->batch_linger_ms = 0;
+
+	call_thread_function_on_join[1] = 1;
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+	return module;
+}
+
 /*Tests_SRS_OUTPROCESS_MODULE_17_005: [ If broker or configuration are NULL, this function shall return NULL. ]*/
 TEST_FUNCTION(Outprocess_Create_returns_null_with_null_arguments)
 {
@@ -684,86 +835,8 @@ TEST_FUNCTION(Outprocess_Create_success)
 	cleanup_create_config(&config);
 }
 
-TEST_FUNCTION(Outprocess_Create_retries_nn_recv_when_it_is_interrupted)
-{
-    // arrange
-    global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
-    global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
-    ((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
-
-    OUTPROCESS_MODULE_CONFIG config;
-    setup_create_config(&config);
-
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Lock_Init());
-
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
-        .SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
-
-    setup_create_connections(&config);
-
-    STRICT_EXPECTED_CALL(Lock_Init());
-    STRICT_EXPECTED_CALL(Lock_Init());
-    STRICT_EXPECTED_CALL(Lock_Init());
-    STRICT_EXPECTED_CALL(Lock_Init());
-
-    STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
-    STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
-    STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
-
-    //create thread
-    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    call_thread_function_on_join[1] = 1;
-    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-
-    //join on the create thread.
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-    setup_create_create_message(&config);
-    STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(4).IgnoreArgument(5);
-    STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-        .IgnoreArgument(2);
-    should_nn_recv_fail = false;
-    current_nn_recv_index = 0;
-    when_shall_nn_recv_fail = 1;
-    STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(nn_errno())
-        .SetReturn(EINTR);
-
-    setup_create_create_message(&config);
-    STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreArgument(4).IgnoreArgument(5);
-    STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    // act
-    MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
-
-    // assert
-
-    ASSERT_IS_NOT_NULL(result);
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    // ablution
-    Module_Destroy(result);
-    cleanup_create_config(&config);
-}
-
-TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
+/*Tests_SRS_OUTPROCESS_MODULE_17_071: [ If the configuration selects a shared memory message channel, this function shall create it on the message_uri with SharedMemoryChannel_Create instead of the pair socket. ]*/
+TEST_FUNCTION(Outprocess_Create_creates_a_shared_memory_message_channel)
 {
 	// arrange
 	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
@@ -772,15 +845,23 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.message_channel = OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY;
+	config.message_channel_size = 65536;
 
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
-	setup_create_connections(&config);
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(SharedMemoryChannel_Create(real_STRING_c_str(config.message_uri), 65536))
+		.SetReturn((SHARED_MEMORY_CHANNEL_HANDLE)0x5117);
+	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(nn_connect(1, real_STRING_c_str(config.control_uri)));
 
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -791,33 +872,22 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
 
-	//create thread
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
 	call_thread_function_on_join[1] = 1;
 	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
 
-	//join on the create thread.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	setup_create_create_message(&config);
 
-	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(4).IgnoreArgument(5);
-	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-		.IgnoreArgument(2);
-	malloc_will_fail = true;
-	malloc_fail_count = 11;
-	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
-	setup_create_create_message(&config);
-	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+	// the control socket is the only nanomsg socket
+	STRICT_EXPECTED_CALL(nn_setsockopt(1, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
 		.IgnoreArgument(4).IgnoreArgument(5);
-	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
 		.IgnoreArgument(1);
@@ -830,78 +900,90 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
 
 	// assert
-
 	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	// ablution
+	umock_c_reset_all_calls();
 	Module_Destroy(result);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_013: [ This function shall send the Create Message on the control channel. ]*/
-TEST_FUNCTION(Outprocess_Create_success_async)
+/*Tests_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_when_the_shared_memory_channel_fails)
 {
 	// arrange
-
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
-	config.lifecycle_model = OUTPROCESS_LIFECYCLE_ASYNC;
+	config.message_channel = OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY;
+	config.message_channel_size = 65536;
 
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
-	setup_create_connections(&config);
-	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
-	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
-	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(SharedMemoryChannel_Create(real_STRING_c_str(config.message_uri), 65536))
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
 
 	// assert
-
-	ASSERT_IS_NOT_NULL(result);
+	ASSERT_IS_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	// ablution
-
-	Module_Destroy(result);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
+/*Tests_SRS_OUTPROCESS_MODULE_17_070: [ The Create Message shall offer the frame limits from the configuration. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ If frames were offered, and the Create Response returns frame limits, this function shall send and receive frames within the smaller of the offered and returned limits; otherwise it shall send and receive messages one at a time. ]*/
+TEST_FUNCTION(Outprocess_Create_offers_frames_and_keeps_the_returned_limits)
 {
 	// arrange
-	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_ERROR;
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
 	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
-	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0; 
-	
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->batch_limits.max_messages = 4;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->batch_limits.max_bytes = 4096;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->batch_limits.linger_ms = 10;
+
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.batch_max_messages = 8;
+	config.batch_max_bytes = 65536;
+	config.batch_linger_ms = 2;
 
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
+
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
 	setup_create_connections(&config);
+
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
 	//create thread
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
@@ -924,64 +1006,65 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(nn_close(1));
-	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
 
 	// assert
-
-	ASSERT_IS_NULL(result);
+	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(uint32_t, 8, sent_batch_offer.max_messages);
+	ASSERT_ARE_EQUAL(uint32_t, 65536, sent_batch_offer.max_bytes);
+	ASSERT_ARE_EQUAL(uint32_t, 2, sent_batch_offer.linger_ms);
 
 	// ablution
+	Module_Destroy(result);
 	cleanup_create_config(&config);
-
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
+/*Tests_SRS_OUTPROCESS_MODULE_17_081: [ The Create Message shall offer the credit window from the configuration. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_082: [ If a credit window is configured, the queue for outgoing gateway messages shall hold no more messages than the window. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_076: [ If a credit window was offered, and the Create Response returns a credit window, this function shall send messages within the smaller of the two windows and grant credit for the messages it receives; otherwise it shall send and receive messages without credit. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_094: [ The Create Message shall give GATEWAY_MESSAGE_VERSION_1 as the gateway_message_version, which every module host accepts, and GATEWAY_MESSAGE_VERSION_CURRENT as the max_message_version. ]*/
+TEST_FUNCTION(Outprocess_Create_offers_a_credit_window_and_keeps_the_returned_window)
 {
 	// arrange
-	OUTPROCESS_MODULE_CONFIG config;
 	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
 	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
-	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 1;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->credit_window = 16;
 
+	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.credit_window = 32;
 
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+
+	STRICT_EXPECTED_CALL(Condition_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_with_capacity(32))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
 	setup_create_connections(&config);
+
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
 	STRICT_EXPECTED_CALL(Lock_Init());
+
 	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
 	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
 	//create thread
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
-	call_thread_function_on_join[1] = 1  ;
+	call_thread_function_on_join[1] = 1;
 	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
 
@@ -1000,43 +1083,380 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(nn_close(1));
-	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Condition_Post((COND_HANDLE)0x4C));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 
 	// act
 	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
 
 	// assert
-
-	ASSERT_IS_NULL(result);
+	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(uint32_t, 32, sent_credit_offer);
+	ASSERT_ARE_EQUAL(uint8_t, GATEWAY_MESSAGE_VERSION_1, sent_message_version);
+	ASSERT_ARE_EQUAL(uint8_t, GATEWAY_MESSAGE_VERSION_CURRENT, sent_max_message_version);
 
 	// ablution
+	Module_Destroy(result);
 	cleanup_create_config(&config);
-
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
-TEST_FUNCTION(Outprocess_Create_returns_null_reponse_not_a_message)
+TEST_FUNCTION(Outprocess_Create_retries_nn_recv_when_it_is_interrupted)
 {
-	// arrange
-	OUTPROCESS_MODULE_CONFIG config;
-	setup_create_config(&config);
+    // arrange
+    global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+    global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+    ((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+    OUTPROCESS_MODULE_CONFIG config;
+    setup_create_config(&config);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+        .SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
+    setup_create_connections(&config);
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+    STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+    STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
+    //create thread
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    call_thread_function_on_join[1] = 1;
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    //join on the create thread.
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+    setup_create_create_message(&config);
+    STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(4).IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(2);
+    should_nn_recv_fail = false;
+    current_nn_recv_index = 0;
+    when_shall_nn_recv_fail = 1;
+    STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EINTR);
+
+    setup_create_create_message(&config);
+    STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(4).IgnoreArgument(5);
+    STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+    // assert
+
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // ablution
+    Module_Destroy(result);
+    cleanup_create_config(&config);
+}
+
+TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
+{
+	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+
+	setup_create_connections(&config);
+
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	malloc_will_fail = true;
+	malloc_fail_count = 11;
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
+	setup_create_create_message(&config);
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_013: [ This function shall send the Create Message on the control channel. ]*/
+TEST_FUNCTION(Outprocess_Create_success_async)
+{
+	// arrange
+
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.lifecycle_model = OUTPROCESS_LIFECYCLE_ASYNC;
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+	setup_create_connections(&config);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
+{
+	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_ERROR;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0; 
+	
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+	setup_create_connections(&config);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_close(1));
+	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 1;
+
+	setup_create_config(&config);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
+	setup_create_connections(&config);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(STRING_clone(config.control_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.message_uri));
+	STRICT_EXPECTED_CALL(STRING_clone(config.outprocess_module_args));
+	//create thread
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	call_thread_function_on_join[1] = 1  ;
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//join on the create thread.
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_close(1));
+	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
+TEST_FUNCTION(Outprocess_Create_returns_null_reponse_not_a_message)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
 
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
@@ -2714,28 +3134,285 @@ TEST_FUNCTION(Outprocess_Start_thread3_create_fails)
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
-/*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
-TEST_FUNCTION(Outprocess_Start_thread2_create_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
+TEST_FUNCTION(Outprocess_Start_thread2_create_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	currentThreadAPI_Create_call = 0;
+	whenShallThreadAPI_Create_fail = 2;
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	///act
+	Module_Start(module);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
+TEST_FUNCTION(Outprocess_Start_thread1_create_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	currentThreadAPI_Create_call = 0;
+	whenShallThreadAPI_Create_fail = 1;
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	///act
+	Module_Start(module);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*creates a module sharing I/O threads and starts it*/
+static MODULE_HANDLE create_module_sharing_io_threads(OUTPROCESS_MODULE_CONFIG* config)
+{
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	config->io_threads = OUTPROCESS_IO_THREADS_SHARED;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+	return module;
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_084: [ If the configuration shares I/O threads, this function shall add the control socket, and the message socket unless the message channel is shared memory, to the socket poller shared by the proxy modules, instead of creating the threads that would receive on them. ]*/
+TEST_FUNCTION(Outprocess_Start_adds_the_sockets_to_the_shared_poller)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.io_threads = OUTPROCESS_IO_THREADS_SHARED;
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(SocketPoller_Create());
+	STRICT_EXPECTED_CALL(SocketPoller_Add(TEST_SOCKET_POLLER, 2, IGNORED_PTR_ARG, module))
+		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(SocketPoller_Add(TEST_SOCKET_POLLER, 1, IGNORED_PTR_ARG, module))
+		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	setup_start_or_destroy_message();
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+
+	///act
+	Module_Start(module);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(polled_callbacks[1]);
+	ASSERT_IS_NOT_NULL(polled_callbacks[2]);
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_090: [ If the sockets cannot be added to the shared socket poller, this function shall create the threads of the module instead. ]*/
+TEST_FUNCTION(Outprocess_Start_creates_threads_of_its_own_when_the_shared_poller_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.io_threads = OUTPROCESS_IO_THREADS_SHARED;
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(SocketPoller_Create())
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	setup_start_or_destroy_message();
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+
+	///act
+	Module_Start(module);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_085: [ The message channel callback shall receive a message or frame without waiting, publish it like the incoming message thread, and grant credit like it. ]*/
+TEST_FUNCTION(Outprocess_shared_message_callback_publishes_a_received_message)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray(IGNORED_PTR_ARG, 8, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(Broker_Publish((BROKER_HANDLE)0x42, module, IGNORED_PTR_ARG))
+		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	///act
+	polled_callbacks[1](polled_contexts[1], 1);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_091: [ This function shall publish the messages from the module host as the configuration's publish_source, or as the module itself if publish_source is NULL. ]*/
+TEST_FUNCTION(Outprocess_shared_message_callback_publishes_as_the_publish_source)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.publish_source = (MODULE_HANDLE)0x4242;
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray(IGNORED_PTR_ARG, 8, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(Broker_Publish((BROKER_HANDLE)0x42, (MODULE_HANDLE)0x4242, IGNORED_PTR_ARG))
+		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	///act
+	polled_callbacks[1](polled_contexts[1], 1);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_086: [ The control channel callback shall receive a control message without waiting, and act on it like the control thread. ]*/
+TEST_FUNCTION(Outprocess_shared_control_callback_adds_granted_credits)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.credit_window = 32;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->credit_window = 32;
+	call_thread_function_on_join[1] = 1;
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
+
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_CREDIT;
+	((CONTROL_MESSAGE_MODULE_CREDIT*)&global_control_msg)->credits = 16;
+
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post((COND_HANDLE)0x4C));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	///act
+	polled_callbacks[2](polled_contexts[2], 2);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_087: [ If a Module Reply message indicates the module has failed or has been terminated, the control channel callback shall start a thread to reattach the module host, and leave the control messages to that thread until it ends. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_105: [ While a thread reattaches the module host, the control channel callback shall still receive each control message, and hand it to that thread in place of any it has not taken yet. ]*/
+TEST_FUNCTION(Outprocess_shared_control_callback_starts_a_thread_to_reattach)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
-	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
-	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
-	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
 
-	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
-	umock_c_reset_all_calls();
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 1;
 
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	currentThreadAPI_Create_call = 0;
-	whenShallThreadAPI_Create_fail = 2;
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Init());
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	/*the next control message is still received, so the poller does not spin, and handed to the thread reattaching*/
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post((COND_HANDLE)0x4C));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	///act
-	Module_Start(module);
+	polled_callbacks[2](polled_contexts[2], 2);
+	polled_callbacks[2](polled_contexts[2], 2);
 
 	///assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -2745,28 +3422,50 @@ TEST_FUNCTION(Outprocess_Start_thread2_create_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
-TEST_FUNCTION(Outprocess_Start_thread1_create_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_088: [ The thread reattaching the module host shall follow the same process in Outprocess_Create to send a Create Message, then send a Start Message, and end. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_106: [ The thread reattaching the module host shall take the reply the control channel callback hands over, waiting no longer than remote_message_wait, instead of receiving on the control socket. ]*/
+TEST_FUNCTION(Outprocess_shared_reattach_thread_sends_create_then_start)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
-	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
-	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
-	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
 
-	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 1;
+	polled_callbacks[2](polled_contexts[2], 2);
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	/*the reply to the Create Message, handed over by the callback*/
+	polled_callbacks[2](polled_contexts[2], 2);
 	umock_c_reset_all_calls();
 
-	currentThreadAPI_Create_call = 0;
-	whenShallThreadAPI_Create_fail = 1;
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	setup_create_create_message(&config);
+	STRICT_EXPECTED_CALL(nn_setsockopt(2, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreArgument(4).IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	setup_start_or_destroy_message();
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	///act
-	Module_Start(module);
+	//the async create thread was first, the outgoing message thread second
+	int thread_result = thread_func_to_call[3](thread_func_args[3]);
 
 	///assert
+	ASSERT_ARE_EQUAL(int, 0, thread_result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	///ablution
@@ -2814,6 +3513,7 @@ static void teardown_a_thread(bool needs_join, bool lock_fail)
 /*Tests_SRS_OUTPROCESS_MODULE_17_034: [ This function shall release all resources created by this module. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_064: [ This function shall close the outgoing gateway message queue to wake the outgoing gateway message thread. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_051: [ This function shall wait for the outgoing gateway message thread to complete. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for the control thread to complete. ]*/
 TEST_FUNCTION(Outprocess_Destroy_success)
@@ -2853,6 +3553,7 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
 	//teardown_a_thread(true, false);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2872,6 +3573,57 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	teardown_a_thread(false, false); //async should be closed and NULL
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	Module_Destroy(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_083: [ This function shall end flow control to wake an outgoing gateway message thread waiting for credit. ]*/
+TEST_FUNCTION(Outprocess_Destroy_ends_flow_control_and_releases_the_credit_condition)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.credit_window = 32;
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->credit_window = 32;
+
+	call_thread_function_on_join[1] = 1;
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	umock_c_reset_all_calls();
+
+	// arrange
+	setup_start_or_destroy_message();
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 1)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_close(1));
+	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	teardown_a_thread(false, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Condition_Post((COND_HANDLE)0x4C));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	teardown_a_thread(false, false);
+	teardown_a_thread(false, false);
+	teardown_a_thread(false, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(Condition_Deinit((COND_HANDLE)0x4C));
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2888,6 +3640,44 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	cleanup_create_config(&config);
 }
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_089: [ If the module shares I/O threads, this function shall remove its sockets from the shared socket poller before it closes them, and destroy the poller once no module uses it. ]*/
+TEST_FUNCTION(Outprocess_Destroy_removes_the_sockets_from_the_shared_poller_before_closing_them)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	MODULE_HANDLE module = create_module_sharing_io_threads(&config);
+
+	// arrange
+	setup_start_or_destroy_message();
+	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 1)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(SocketPoller_Remove(TEST_SOCKET_POLLER, 2));
+	STRICT_EXPECTED_CALL(SocketPoller_Remove(TEST_SOCKET_POLLER, 1));
+	STRICT_EXPECTED_CALL(SocketPoller_Destroy(TEST_SOCKET_POLLER));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_close(1));
+	STRICT_EXPECTED_CALL(nn_close(2));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	teardown_a_thread(false, false); //no incoming message thread
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
+	teardown_a_thread(true, false);
+	teardown_a_thread(false, false); //no control thread
+	teardown_a_thread(false, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	Module_Destroy(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_027: [ This function shall ensure thread safety on execution. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_032: [ This function shall signal the messaging thread to close. ]*/
@@ -2930,9 +3720,11 @@ TEST_FUNCTION(Outprocess_Destroy_send_lock_join_fails)
 	thread_join_result[2] = THREADAPI_ERROR;
 	thread_join_result[3] = THREADAPI_ERROR;
 	teardown_a_thread(true, true);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
 	teardown_a_thread(true, true);
 	teardown_a_thread(true, true);
 	teardown_a_thread(true, true); //async won't be closed.
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2975,9 +3767,11 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_alloc_fails)
 	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	teardown_a_thread(true, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
 	teardown_a_thread(true, false);
 	teardown_a_thread(true, false);
 	teardown_a_thread(false, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3017,9 +3811,11 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_to_array_fails)
 	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	teardown_a_thread(true, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_close((MESSAGE_QUEUE_HANDLE)0x40));
 	teardown_a_thread(true, false);
 	teardown_a_thread(true, false);
 	teardown_a_thread(false, false);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_destroy((MESSAGE_QUEUE_HANDLE)0x40));
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3047,30 +3843,167 @@ TEST_FUNCTION(Outprocess_Receive_does_nothing_with_nothing)
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_045: [ This function shall ensure thread safety for the module data. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_046: [ This function shall clone the message to ensure the message is kept allocated until forwarded to module host. ]*/
-TEST_FUNCTION(Outprocess_Receive_success)
+/*Tests_SRS_OUTPROCESS_MODULE_17_045: [ This function shall ensure thread safety for the module data. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_046: [ This function shall clone the message to ensure the message is kept allocated until forwarded to module host. ]*/
+TEST_FUNCTION(Outprocess_Receive_success)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	Module_Receive(module, msg);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Message_Destroy(msg);
+	Message_Destroy(msg);
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_102: [ If the message still cannot be queued, this function shall discard it and count it as dropped. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_104: [ Outprocess_GetDropCount shall return the number of messages Outprocess_Receive has discarded. ]*/
+TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1).SetReturn(2620);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	Module_Receive(module, msg);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 1, Outprocess_GetDropCount(module));
+
+	//ablution
+	Message_Destroy(msg);
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+TEST_FUNCTION(Outprocess_Receive_Lock_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Clone(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+
+	// act
+	Module_Receive(module, msg);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Message_Destroy(msg);
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_092: [ If module is NULL, Outprocess_GetQueueDepth shall return 0. ]*/
+TEST_FUNCTION(Outprocess_GetQueueDepth_returns_0_with_null)
+{
+	// arrange
+
+	// act
+	size_t depth = Outprocess_GetQueueDepth(NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 0, depth);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_093: [ Outprocess_GetQueueDepth shall return the size of the outgoing gateway message queue. ]*/
+TEST_FUNCTION(Outprocess_GetQueueDepth_returns_queue_size)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_size((MESSAGE_QUEUE_HANDLE)0x40))
+		.SetReturn(7);
+
+	// act
+	size_t depth = Outprocess_GetQueueDepth(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 7, depth);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_101: [ If the message cannot be queued and the overflow policy is BROKER_OVERFLOW_DROP_OLDEST, this function shall discard the oldest queued message, count it as dropped, and push the message again. ]*/
+TEST_FUNCTION(Outprocess_Receive_drops_the_oldest_message_when_the_queue_is_full)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.credit_overflow = BROKER_OVERFLOW_DROP_OLDEST;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
 	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE oldest = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1).SetReturn(2620);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop((MESSAGE_QUEUE_HANDLE)0x40)).SetReturn(oldest);
+	STRICT_EXPECTED_CALL(Message_Destroy(oldest));
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	Module_Receive(module, msg);
 
-	// assert 
+	// assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 1, Outprocess_GetDropCount(module));
 
 	//ablution
 	Message_Destroy(msg);
@@ -3079,12 +4012,15 @@ TEST_FUNCTION(Outprocess_Receive_success)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_097: [ If a credit window is configured with BROKER_OVERFLOW_BLOCK, this function shall create a condition to wait on for room in the queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_098: [ If the queue holds the credit window and the overflow policy is BROKER_OVERFLOW_BLOCK, this function shall wait until the outgoing gateway message thread removes a message, then push the message. ]*/
+TEST_FUNCTION(Outprocess_Receive_waits_for_room_when_the_queue_is_full)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
 	setup_create_config(&config);
+	config.credit_window = 32;
+	config.credit_overflow = BROKER_OVERFLOW_BLOCK;
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
@@ -3094,47 +4030,37 @@ TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1).SetReturn(2620);
-	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Condition_Wait((COND_HANDLE)0x4C, IGNORED_PTR_ARG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	Module_Receive(module, msg);
 
-	// assert 
+	// assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 0, Outprocess_GetDropCount(module));
 
 	//ablution
 	Message_Destroy(msg);
+	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_Receive_Lock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_103: [ If module is NULL, Outprocess_GetDropCount shall return 0. ]*/
+TEST_FUNCTION(Outprocess_GetDropCount_returns_0_with_null)
 {
 	// arrange
-	OUTPROCESS_MODULE_CONFIG config;
-	setup_create_config(&config);
-
-	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
-	Module_Start(module);
-	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
-	umock_c_reset_all_calls();
-
-	STRICT_EXPECTED_CALL(Message_Clone(msg));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
-	STRICT_EXPECTED_CALL(Message_Destroy(msg));
 
 	// act
-	Module_Receive(module, msg);
+	size_t dropped = Outprocess_GetDropCount(NULL);
 
-	// assert 
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 0, dropped);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
-	Message_Destroy(msg);
-	Module_Destroy(module);
-	cleanup_create_config(&config);
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
@@ -3187,10 +4113,12 @@ TEST_FUNCTION(Outprocess_outgoing_thread_does_nothing_with_nothing)
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_062: [ This function shall wait on the outgoing gateway message queue until a message is queued or the queue is closed. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_095: [ If the accepted message version is not GATEWAY_MESSAGE_VERSION_CURRENT, this function shall serialize the message in that version with Message_ToByteArrayVersion into a buffer from nn_allocmsg. ]*/
 TEST_FUNCTION(Outprocess_outgoing_thread_success)
 {
 	// arrange
@@ -3204,19 +4132,14 @@ TEST_FUNCTION(Outprocess_outgoing_thread_success)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
 		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, NULL, 0));
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, default_serialized_size))
+		.IgnoreArgument_buf();
 	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
 
@@ -3245,16 +4168,12 @@ TEST_FUNCTION(Outprocess_outgoing_thread_retries_when_nn_send_is_interrupted)
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-        .SetReturn(false);
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
         .SetReturn(msg);
-    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, NULL, 0));
     STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-    STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, default_serialized_size))
+        .IgnoreArgument_buf();
     should_nn_send_fail = false;
     current_nn_send_index = 0;
     when_shall_nn_send_fail = 1;
@@ -3262,7 +4181,6 @@ TEST_FUNCTION(Outprocess_outgoing_thread_retries_when_nn_send_is_interrupted)
     STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EINTR);
     STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
     STRICT_EXPECTED_CALL(Message_Destroy(msg));
-    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
         .SetReturn(LOCK_ERROR);
 
@@ -3279,7 +4197,7 @@ TEST_FUNCTION(Outprocess_outgoing_thread_retries_when_nn_send_is_interrupted)
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
+TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_fails_then_unlock_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3292,16 +4210,12 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
 		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, NULL, 0));
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, default_serialized_size))
+		.IgnoreArgument_buf();
 	should_nn_send_fail = true;
 	current_nn_send_index = 0;
 	when_shall_nn_send_fail = 1;
@@ -3309,7 +4223,6 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
     STRICT_EXPECTED_CALL(nn_errno());
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
@@ -3326,8 +4239,9 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ This function shall end once the outgoing gateway message queue is closed and empty. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_fails_then_queue_closes)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3340,22 +4254,17 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
 		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, NULL, 0));
 	malloc_will_fail = true;
 	malloc_fail_count = malloc_count + 1;
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
+		.SetReturn(NULL);
 
 	// act
 	//third thread created is outgoing message thread
@@ -3369,8 +4278,8 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_serialize_fails_then_unlock_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3383,20 +4292,11 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
 		.SetReturn(msg);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0)).SetReturn(-1);
+	STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(msg, GATEWAY_MESSAGE_VERSION_1, NULL, 0)).SetReturn(-1);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(true);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
 
@@ -3412,8 +4312,8 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ This function shall end once the outgoing gateway message queue is closed and empty. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_ends_when_the_queue_is_closed)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3421,27 +4321,186 @@ TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
 
 	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
 	Module_Start(module);
-	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
 		.SetReturn(NULL);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	//third thread created is outgoing message thread
-	thread_func_to_call[3](thread_func_args[3]);
+	int function_result = thread_func_to_call[3](thread_func_args[3]);
 
 	// assert 
+	ASSERT_ARE_EQUAL(int, 0, function_result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ If frames were offered, and the Create Response returns frame limits, this function shall send and receive frames within the smaller of the offered and returned limits; otherwise it shall send and receive messages one at a time. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_067: [ If the module host accepted frames, this function shall add the message to a batch, then keep adding the messages it removes from the queue, waiting no longer than the accepted linger time since the first one, until the batch is full, a message does not fit, or no message arrives. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_069: [ This function shall serialize the frame with MessageBatch_ToByteArray into a buffer from nn_allocmsg, send it on the message channel, and clear the batch. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_sends_queued_messages_in_one_frame)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	MESSAGE_BATCH_LIMITS reply_limits = { 4, 4096, 0 };
+	MODULE_HANDLE module = create_module_offering_frames(&config, reply_limits);
+	MESSAGE_HANDLE msg1 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE msg2 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
+		.SetReturn(msg1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageBatch_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageBatch_Add((MESSAGE_BATCH_HANDLE)0x50, msg1))
+		.SetReturn(MESSAGE_BATCH_OK);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg1));
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, 0))
+		.SetReturn(msg2);
+	STRICT_EXPECTED_CALL(MessageBatch_Add((MESSAGE_BATCH_HANDLE)0x50, msg2))
+		.SetReturn(MESSAGE_BATCH_FULL);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg2));
+	STRICT_EXPECTED_CALL(MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)0x50))
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, NULL, 0))
+		.SetReturn(30);
+	STRICT_EXPECTED_CALL(nn_allocmsg(30, 0));
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, IGNORED_PTR_ARG, 30))
+		.IgnoreArgument(2)
+		.SetReturn(30);
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MessageBatch_Clear((MESSAGE_BATCH_HANDLE)0x50));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(MessageBatch_Destroy((MESSAGE_BATCH_HANDLE)0x50));
+
+	// act
+	//third thread created is outgoing message thread
+	int function_result = thread_func_to_call[3](thread_func_args[3]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, function_result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(uint32_t, 4, created_batch_limits.max_messages);
+	ASSERT_ARE_EQUAL(uint32_t, 4096, created_batch_limits.max_bytes);
+	ASSERT_ARE_EQUAL(uint32_t, 0, created_batch_limits.linger_ms);
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_068: [ A message that does not fit in the batch shall start the next frame. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_starts_the_next_frame_with_a_message_that_does_not_fit)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	MESSAGE_BATCH_LIMITS reply_limits = { 4, 4096, 0 };
+	MODULE_HANDLE module = create_module_offering_frames(&config, reply_limits);
+	MESSAGE_HANDLE msg1 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE msg2 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
+		.SetReturn(msg1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageBatch_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageBatch_Add((MESSAGE_BATCH_HANDLE)0x50, msg1))
+		.SetReturn(MESSAGE_BATCH_OK);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg1));
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, 0))
+		.SetReturn(msg2);
+	STRICT_EXPECTED_CALL(MessageBatch_Add((MESSAGE_BATCH_HANDLE)0x50, msg2))
+		.SetReturn(MESSAGE_BATCH_NO_ROOM);
+	STRICT_EXPECTED_CALL(MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)0x50))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, NULL, 0))
+		.SetReturn(20);
+	STRICT_EXPECTED_CALL(nn_allocmsg(20, 0));
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, IGNORED_PTR_ARG, 20))
+		.IgnoreArgument(2)
+		.SetReturn(20);
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MessageBatch_Clear((MESSAGE_BATCH_HANDLE)0x50));
+
+	//the message that did not fit starts the next frame, without waiting on the queue
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MessageBatch_Add((MESSAGE_BATCH_HANDLE)0x50, msg2))
+		.SetReturn(MESSAGE_BATCH_FULL);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg2));
+	STRICT_EXPECTED_CALL(MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)0x50))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, NULL, 0))
+		.SetReturn(20);
+	STRICT_EXPECTED_CALL(nn_allocmsg(20, 0));
+	STRICT_EXPECTED_CALL(MessageBatch_ToByteArray((MESSAGE_BATCH_HANDLE)0x50, IGNORED_PTR_ARG, 20))
+		.IgnoreArgument(2)
+		.SetReturn(20);
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MessageBatch_Clear((MESSAGE_BATCH_HANDLE)0x50));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(MessageBatch_Destroy((MESSAGE_BATCH_HANDLE)0x50));
+
+	// act
+	int function_result = thread_func_to_call[3](thread_func_args[3]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, function_result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ If frames were offered, and the Create Response returns frame limits, this function shall send and receive frames within the smaller of the offered and returned limits; otherwise it shall send and receive messages one at a time. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_096: [ If the Create Response returns a max_message_version, this function shall send messages in the lower of it and GATEWAY_MESSAGE_VERSION_CURRENT; otherwise it shall send them in GATEWAY_MESSAGE_VERSION_1. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_sends_messages_one_at_a_time_when_frames_are_declined)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	MESSAGE_BATCH_LIMITS reply_limits = { 0, 0, 0 };
+	MODULE_HANDLE module = create_module_offering_frames(&config, reply_limits);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait((MESSAGE_QUEUE_HANDLE)0x40, -1))
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetByteArray(msg));
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	int function_result = thread_func_to_call[3](thread_func_args[3]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, function_result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
-	Message_Destroy(msg);
 	Module_Destroy(module);
 	cleanup_create_config(&config);
 }
@@ -3588,7 +4647,6 @@ TEST_FUNCTION(Outprocess_incoming_thread_ends_nn_recv_fails)
 	should_nn_recv_fail = true;
 	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(37);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 
 	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
 
@@ -3618,7 +4676,6 @@ TEST_FUNCTION(Outprocess_incoming_thread_retries_when_nn_recv_is_interrupted)
     should_nn_recv_fail = true;
     STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
     STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EINTR);
-    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3626,7 +4683,6 @@ TEST_FUNCTION(Outprocess_incoming_thread_retries_when_nn_recv_is_interrupted)
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
     STRICT_EXPECTED_CALL(nn_errno()).SetReturn(37);
-    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 
     int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
 
@@ -3644,6 +4700,7 @@ TEST_FUNCTION(Outprocess_incoming_thread_retries_when_nn_recv_is_interrupted)
 /*Tests_SRS_OUTPROCESS_MODULE_17_038: [ This function shall read from the message channel for gateway messages from the module host. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_040: [This function shall publish any successfully created gateway message to the broker.]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_061: [ This function shall create the message on the received buffer with Message_CreateFromOwnedByteArray, handing the buffer over to the message, and shall free the buffer itself only if that fails. ]*/
 TEST_FUNCTION(Outprocess_messaging_thread_ends_one_loop_then_fails)
 {
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3659,13 +4716,81 @@ TEST_FUNCTION(Outprocess_messaging_thread_ends_one_loop_then_fails)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+	STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Broker_Publish(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+
+	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, function_result, 0);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_061: [ This function shall create the message on the received buffer with Message_CreateFromOwnedByteArray, handing the buffer over to the message, and shall free the buffer itself only if that fails. ]*/
+TEST_FUNCTION(Outprocess_messaging_thread_frees_the_buffer_when_the_message_is_not_created)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments()
+		.SetReturn(NULL);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+
+	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, function_result, 0);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_066: [ If frames were accepted and the received buffer is a frame, this function shall create each message of the frame with Message_CreateFromByteArray, publish it to the broker, and free the buffer. ]*/
+TEST_FUNCTION(Outprocess_messaging_thread_publishes_each_message_of_a_frame)
+{
+	OUTPROCESS_MODULE_CONFIG config;
+	MESSAGE_BATCH_LIMITS reply_limits = { 4, 4096, 0 };
+	MODULE_HANDLE module = create_module_offering_frames(&config, reply_limits);
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_recv(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(MessageBatch_IsFrame(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1)
+		.SetReturn(true);
+	STRICT_EXPECTED_CALL(MessageBatch_ForEachMessage(IGNORED_PTR_ARG, 8, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1).IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(Message_CreateFromByteArray(IGNORED_PTR_ARG, 8))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Broker_Publish((BROKER_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 
 	int function_result = (*thread_func_to_call[2])(thread_func_args[2]);
@@ -3703,7 +4828,7 @@ TEST_FUNCTION(Outprocess_control_thread_does_nothing_with_nothing)
 
 }
 /*Tests_SRS_OUTPROCESS_MODULE_17_056: [This thread shall ensure thread safety on the module data.]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_057 : [This thread shall periodically attempt to receive a meesage from the module host process.]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_057: [ This thread shall wait on the control channel, for up to 1 second at a time, for a message from the module host process. ]*/
 TEST_FUNCTION(Outprocess_control_thread_success)
 {
 	// arrange
@@ -3721,12 +4846,12 @@ TEST_FUNCTION(Outprocess_control_thread_success)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
 
@@ -3769,13 +4894,13 @@ TEST_FUNCTION(Outprocess_control_thread_restart_success)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
 		.IgnoreAllArguments()
 		.SetReturn((CONTROL_MESSAGE*)&remote_died);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
 	// 2nd pass:needs_to_attach is set.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3840,13 +4965,13 @@ TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fai
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
 		.IgnoreAllArguments()
 		.SetReturn((CONTROL_MESSAGE*)&remote_died);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
 	// 2nd pass:needs_to_attach is set, get bad message.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3870,10 +4995,10 @@ TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fai
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	when_shall_nn_recv_fail = current_nn_recv_index +3;
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
 	//3rd pass: reset_channel fails (needs attach is still 1)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3973,9 +5098,71 @@ TEST_FUNCTION(Outprocess_control_thread_dies_nn_recv_unexpected_error)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	should_nn_recv_fail = true;
 	when_shall_nn_recv_fail = current_nn_recv_index +1;
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(100);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
+
+	// act
+	//fourth thread created is control message thread
+	thread_func_to_call[4](thread_func_args[4]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_057: [ This thread shall wait on the control channel, for up to 1 second at a time, for a message from the module host process. ]*/
+TEST_FUNCTION(Outprocess_control_thread_does_not_receive_when_poll_times_out)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+
+	nn_poll_result = 0;
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//fourth thread created is control message thread
+	thread_func_to_call[4](thread_func_args[4]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+TEST_FUNCTION(Outprocess_control_thread_dies_nn_poll_unexpected_error)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	umock_c_reset_all_calls();
+
+	nn_poll_result = -1;
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, 1000)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EBADF);
 
 	// act
 	//fourth thread created is control message thread
@@ -0,0 +1,677 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+static bool malloc_will_fail = false;
+static size_t malloc_fail_count = 0;
+static size_t malloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    ++malloc_count;
+
+    void* result;
+    if (malloc_will_fail == true && malloc_count == malloc_fail_count)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#include "real_strings.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "message.h"
+#include "module_loaders/outprocess_module.h"
+
+#undef ENABLE_MOCKS
+
+#include "module_loaders/outprocess_replica_pool.h"
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static pfModule_ParseConfigurationFromJson Module_ParseConfigurationFromJson = NULL;
+static pfModule_FreeConfiguration Module_FreeConfiguration = NULL;
+static pfModule_Create Module_Create = NULL;
+static pfModule_Destroy Module_Destroy = NULL;
+static pfModule_Receive Module_Receive = NULL;
+static pfModule_Start Module_Start = NULL;
+
+// replica mocks.
+#define MAX_REPLICAS 4
+#define REPLICA_HANDLE(index) ((MODULE_HANDLE)(0x100 + (index)))
+
+static unsigned int created_replica_count;
+static unsigned int when_shall_replica_create_fail;
+static char created_control_uris[MAX_REPLICAS][32];
+static char created_message_uris[MAX_REPLICAS][32];
+static MODULE_HANDLE created_publish_sources[MAX_REPLICAS];
+
+#define MAX_RECEIVED 8
+static unsigned int received_replica_count;
+static MODULE_HANDLE received_replicas[MAX_RECEIVED];
+
+MOCK_FUNCTION_WITH_CODE(, void*, replica_ParseConfigurationFromJson, const char*, configuration)
+MOCK_FUNCTION_END((void*)0x42)
+
+MOCK_FUNCTION_WITH_CODE(, void, replica_FreeConfiguration, void*, configuration)
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, MODULE_HANDLE, replica_Create, BROKER_HANDLE, broker, const void*, configuration)
+	MODULE_HANDLE replica = NULL;
+	const OUTPROCESS_MODULE_CONFIG * replica_config = (const OUTPROCESS_MODULE_CONFIG*)configuration;
+	created_replica_count++;
+	if (created_replica_count != when_shall_replica_create_fail && created_replica_count <= MAX_REPLICAS)
+	{
+		strncpy(created_control_uris[created_replica_count - 1], real_STRING_c_str(replica_config->control_uri), 31);
+		strncpy(created_message_uris[created_replica_count - 1], real_STRING_c_str(replica_config->message_uri), 31);
+		created_publish_sources[created_replica_count - 1] = replica_config->publish_source;
+		replica = REPLICA_HANDLE(created_replica_count - 1);
+	}
+MOCK_FUNCTION_END(replica)
+
+MOCK_FUNCTION_WITH_CODE(, void, replica_Destroy, MODULE_HANDLE, module)
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, void, replica_Receive, MODULE_HANDLE, module, MESSAGE_HANDLE, message)
+	if (received_replica_count < MAX_RECEIVED)
+	{
+		received_replicas[received_replica_count++] = module;
+	}
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, void, replica_Start, MODULE_HANDLE, module)
+MOCK_FUNCTION_END()
+
+const MODULE_API_1 Outprocess_Module_API_all =
+{
+	{ MODULE_API_VERSION_1 },
+	replica_ParseConfigurationFromJson,
+	replica_FreeConfiguration,
+	replica_Create,
+	replica_Destroy,
+	replica_Receive,
+	replica_Start
+};
+
+static void setup_create_config(OUTPROCESS_MODULE_CONFIG * config, unsigned int replicas, OUTPROCESS_BALANCE balance, const char * balance_property)
+{
+	memset(config, 0, sizeof(OUTPROCESS_MODULE_CONFIG));
+	config->lifecycle_model = OUTPROCESS_LIFECYCLE_SYNC;
+	config->control_uri = real_STRING_construct("ipc://control");
+	config->message_uri = real_STRING_construct("ipc://message");
+	config->outprocess_module_args = real_STRING_construct("args");
+	config->replicas = replicas;
+	config->balance = balance;
+	config->balance_property = (balance_property == NULL) ? NULL : real_STRING_construct(balance_property);
+}
+
+static void cleanup_create_config(OUTPROCESS_MODULE_CONFIG * config)
+{
+	real_STRING_delete(config->control_uri);
+	real_STRING_delete(config->message_uri);
+	real_STRING_delete(config->outprocess_module_args);
+	if (config->balance_property != NULL)
+	{
+		real_STRING_delete(config->balance_property);
+	}
+}
+
+static void expected_replica_calls(OUTPROCESS_MODULE_CONFIG * config)
+{
+	STRICT_EXPECTED_CALL(STRING_c_str(config->control_uri));
+	STRICT_EXPECTED_CALL(STRING_c_str(config->message_uri));
+	STRICT_EXPECTED_CALL(replica_Create((BROKER_HANDLE)0x1, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+}
+
+BEGIN_TEST_SUITE(OutprocessReplicaPool_UnitTests)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+	TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+	g_testByTest = TEST_MUTEX_CREATE();
+	ASSERT_IS_NOT_NULL(g_testByTest);
+
+	umock_c_init(on_umock_c_error);
+	umocktypes_charptr_register_types();
+	umocktypes_stdint_register_types();
+	umocktypes_bool_register_types();
+
+	REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+
+	// STRING
+	REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, real_STRING_construct);
+	REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, real_STRING_delete);
+	REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
+	REGISTER_GLOBAL_MOCK_HOOK(STRING_clone, real_STRING_clone);
+
+	REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+	REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+	REGISTER_GLOBAL_MOCK_RETURN(Outprocess_GetQueueDepth, 0);
+	REGISTER_GLOBAL_MOCK_RETURN(Message_GetProperty, NULL);
+
+	Module_ParseConfigurationFromJson = Outprocess_Replica_Pool_API_all.Module_ParseConfigurationFromJson;
+	Module_FreeConfiguration = Outprocess_Replica_Pool_API_all.Module_FreeConfiguration;
+	Module_Create = Outprocess_Replica_Pool_API_all.Module_Create;
+	Module_Destroy = Outprocess_Replica_Pool_API_all.Module_Destroy;
+	Module_Receive = Outprocess_Replica_Pool_API_all.Module_Receive;
+	Module_Start = Outprocess_Replica_Pool_API_all.Module_Start;
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    malloc_will_fail = false;
+    malloc_fail_count = 0;
+    malloc_count = 0;
+
+	created_replica_count = 0;
+	when_shall_replica_create_fail = 0;
+	memset(created_control_uris, 0, sizeof(created_control_uris));
+	memset(created_message_uris, 0, sizeof(created_message_uris));
+	memset(created_publish_sources, 0, sizeof(created_publish_sources));
+	received_replica_count = 0;
+	memset(received_replicas, 0, sizeof(received_replicas));
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_001: [ This function shall parse the configuration like Outprocess_Module_API_all. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_ParseConfigurationFromJson_parses_like_the_outprocess_module)
+{
+	// arrange
+	STRICT_EXPECTED_CALL(replica_ParseConfigurationFromJson("{}"));
+	STRICT_EXPECTED_CALL(replica_FreeConfiguration((void*)0x42));
+
+	// act
+	void * result = Module_ParseConfigurationFromJson("{}");
+	Module_FreeConfiguration(result);
+
+	// assert
+	ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_002: [ If broker or configuration are NULL, this function shall return NULL. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_returns_null_with_null_broker)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	umock_c_reset_all_calls();
+
+	// act
+	MODULE_HANDLE result = Module_Create(NULL, &config);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_002: [ If broker or configuration are NULL, this function shall return NULL. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_returns_null_with_null_config)
+{
+	// arrange
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, NULL);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_003: [ If balance is OUTPROCESS_BALANCE_HASH and balance_property is NULL, this function shall return NULL. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_returns_null_with_hash_and_no_property)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_HASH, NULL);
+	umock_c_reset_all_calls();
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_004: [ This function shall allocate memory for the pool and for a replica handle per replica, counting one replica if replicas is 0. ]*/
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_006: [ Each replica shall be configured like the pool, with a single replica, the pool as its publish_source, and the control and message URIs of the pool followed by "." and the index of the replica. ]*/
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_007: [ This function shall create each replica with Outprocess_Module_API_all. ]*/
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_009: [ Upon success, this function shall return the pool as the module handle. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_creates_a_proxy_module_per_replica)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(MODULE_HANDLE)));
+	expected_replica_calls(&config);
+	expected_replica_calls(&config);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 2, created_replica_count);
+	ASSERT_ARE_EQUAL(char_ptr, "ipc://control.0", created_control_uris[0]);
+	ASSERT_ARE_EQUAL(char_ptr, "ipc://message.0", created_message_uris[0]);
+	ASSERT_ARE_EQUAL(char_ptr, "ipc://control.1", created_control_uris[1]);
+	ASSERT_ARE_EQUAL(char_ptr, "ipc://message.1", created_message_uris[1]);
+	ASSERT_ARE_EQUAL(void_ptr, result, created_publish_sources[0]);
+	ASSERT_ARE_EQUAL(void_ptr, result, created_publish_sources[1]);
+
+	// cleanup
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_004: [ This function shall allocate memory for the pool and for a replica handle per replica, counting one replica if replicas is 0. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_with_0_replicas_creates_one)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 0, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	umock_c_reset_all_calls();
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(int, 1, created_replica_count);
+	ASSERT_ARE_EQUAL(char_ptr, "ipc://control.0", created_control_uris[0]);
+
+	// cleanup
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_005: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall keep a copy of balance_property. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_with_hash_copies_the_property)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_HASH, "deviceName");
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(MODULE_HANDLE)));
+	STRICT_EXPECTED_CALL(STRING_clone(config.balance_property));
+	expected_replica_calls(&config);
+	expected_replica_calls(&config);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NOT_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(result);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_destroys_created_replicas_when_a_replica_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 3, OUTPROCESS_BALANCE_HASH, "deviceName");
+	when_shall_replica_create_fail = 2;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(3 * sizeof(MODULE_HANDLE)));
+	STRICT_EXPECTED_CALL(STRING_clone(config.balance_property));
+	expected_replica_calls(&config);
+	expected_replica_calls(&config);
+	STRICT_EXPECTED_CALL(replica_Destroy(REPLICA_HANDLE(0)));
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Create_returns_null_when_allocation_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	malloc_will_fail = true;
+	malloc_fail_count = 2;
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(MODULE_HANDLE)));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x1, &config);
+
+	// assert
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(int, 0, created_replica_count);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_010: [ If module or message_handle is NULL, this function shall do nothing. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Receive_does_nothing_with_nulls)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	// act
+	Module_Receive(NULL, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_011: [ This function shall hand the message to the Module_Receive of one replica. ]*/
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_012: [ If balance is OUTPROCESS_BALANCE_ROUND_ROBIN, this function shall choose the replicas in turn. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Receive_round_robin_takes_replicas_in_turn)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 3, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(0), (MESSAGE_HANDLE)0x2));
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(1), (MESSAGE_HANDLE)0x2));
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(2), (MESSAGE_HANDLE)0x2));
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(0), (MESSAGE_HANDLE)0x2));
+
+	// act
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_013: [ If balance is OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, this function shall choose the replica with the fewest messages queued for its module host, looking from the replica after the one chosen last and stopping at an empty queue. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Receive_least_queue_depth_takes_the_shortest_queue)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 3, OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, NULL);
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Outprocess_GetQueueDepth(REPLICA_HANDLE(0)))
+		.SetReturn(5);
+	STRICT_EXPECTED_CALL(Outprocess_GetQueueDepth(REPLICA_HANDLE(1)))
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(Outprocess_GetQueueDepth(REPLICA_HANDLE(2)))
+		.SetReturn(3);
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(1), (MESSAGE_HANDLE)0x2));
+	STRICT_EXPECTED_CALL(Outprocess_GetQueueDepth(REPLICA_HANDLE(2)))
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(2), (MESSAGE_HANDLE)0x2));
+
+	// act
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_014: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall choose the replica from a hash of the message's balance_property, so that messages with the same value go to the same replica in order. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Receive_hash_keeps_a_key_on_one_replica)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 4, OUTPROCESS_BALANCE_HASH, "deviceName");
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetProperty((MESSAGE_HANDLE)0x2, "deviceName"))
+		.SetReturn("device1");
+	STRICT_EXPECTED_CALL(replica_Receive(IGNORED_PTR_ARG, (MESSAGE_HANDLE)0x2))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetProperty((MESSAGE_HANDLE)0x3, "deviceName"))
+		.SetReturn("device1");
+	STRICT_EXPECTED_CALL(replica_Receive(IGNORED_PTR_ARG, (MESSAGE_HANDLE)0x3))
+		.IgnoreArgument(1);
+
+	// act
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x3);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 2, received_replica_count);
+	ASSERT_ARE_EQUAL(void_ptr, received_replicas[0], received_replicas[1]);
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_015: [ If balance is OUTPROCESS_BALANCE_HASH and the message does not have the balance_property, this function shall choose the replicas in turn. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Receive_hash_without_the_property_takes_replicas_in_turn)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_HASH, "deviceName");
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetProperty((MESSAGE_HANDLE)0x2, "deviceName"));
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(0), (MESSAGE_HANDLE)0x2));
+	STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetProperty((MESSAGE_HANDLE)0x2, "deviceName"));
+	STRICT_EXPECTED_CALL(replica_Receive(REPLICA_HANDLE(1), (MESSAGE_HANDLE)0x2));
+
+	// act
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+	Module_Receive(module, (MESSAGE_HANDLE)0x2);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_016: [ If module is NULL, this function shall do nothing. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Start_does_nothing_with_null)
+{
+	// arrange
+
+	// act
+	Module_Start(NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_017: [ This function shall start every replica. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Start_starts_every_replica)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_ROUND_ROBIN, NULL);
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(replica_Start(REPLICA_HANDLE(0)));
+	STRICT_EXPECTED_CALL(replica_Start(REPLICA_HANDLE(1)));
+
+	// act
+	Module_Start(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_018: [ If module is NULL, this function shall do nothing. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Destroy_does_nothing_with_null)
+{
+	// arrange
+
+	// act
+	Module_Destroy(NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_OUTPROCESS_REPLICA_POOL_17_019: [ This function shall destroy every replica and release all resources created by this module. ]*/
+TEST_FUNCTION(Outprocess_Replica_Pool_Destroy_destroys_every_replica)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config, 2, OUTPROCESS_BALANCE_HASH, "deviceName");
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x1, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(replica_Destroy(REPLICA_HANDLE(0)));
+	STRICT_EXPECTED_CALL(replica_Destroy(REPLICA_HANDLE(1)));
+	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(module));
+
+	// act
+	Module_Destroy(module);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	cleanup_create_config(&config);
+}
+
+END_TEST_SUITE(OutprocessReplicaPool_UnitTests);
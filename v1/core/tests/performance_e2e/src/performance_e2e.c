@@ -95,6 +95,7 @@ TEST_FUNCTION(Performance_e2e_5_second_run)
         ///act
         performance_gw_properties.gateway_modules = gatewayProps;
         performance_gw_properties.gateway_links = gatewayLinks; 
+        performance_gw_properties.broker_config = NULL;
         e2eGatewayInstance = Gateway_Create(&performance_gw_properties);
         GATEWAY_START_RESULT start_result = Gateway_Start(e2eGatewayInstance);
 
@@ -164,6 +165,7 @@ TEST_FUNCTION(Performance_e2e_10_second_run)
         ///act
         performance_gw_properties.gateway_modules = gatewayProps;
         performance_gw_properties.gateway_links = gatewayLinks; 
+        performance_gw_properties.broker_config = NULL;
         e2eGatewayInstance = Gateway_Create(&performance_gw_properties);
         GATEWAY_START_RESULT start_result = Gateway_Start(e2eGatewayInstance);
 
@@ -9,7 +9,6 @@
 
 #include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/gb_time.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/base64.h"
@@ -545,44 +544,6 @@ static void on_connect_complete(
     }
 }
 
-static int format_timestamp(char* dest, size_t dest_size)
-{
-    int result;
-    time_t t1 = time(NULL);
-    if (t1 == (time_t)-1)
-    {
-        LogError("time() failed");
-        result = __LINE__;
-    }
-    else
-    {
-        struct tm* t2 = localtime(&t1);
-        if (t2 == NULL)
-        {
-            LogError("localtime() failed");
-            result = __LINE__;
-        }
-        else
-        {
-            /**
-             * Note: We record the time only with a granularity of seconds. We
-             * may want to increase this to include milliseconds.
-             */
-            if (strftime(dest, dest_size, "%Y:%m:%dT%H:%M:%S", t2) == 0)
-            {
-                LogError("strftime() failed");
-                result = __LINE__;
-            }
-            else
-            {
-                result = 0;
-            }
-        }
-    }
-
-    return result;
-}
-
 static void on_read_complete(
     BLEIO_SEQ_HANDLE bleio_seq_handle,
     void* context,
@@ -603,106 +564,75 @@ static void on_read_complete(
     }
     else
     {
-        MAP_HANDLE message_properties = Map_Create(NULL);
-        if (message_properties == NULL)
+        // format MAC address
+        char mac_address[18] = "";
+        int ret = snprintf(
+            mac_address,
+            sizeof(mac_address) / sizeof(mac_address[0]),
+            "%02X:%02X:%02X:%02X:%02X:%02X",
+            handle_data->device_config.device_addr.address[0],
+            handle_data->device_config.device_addr.address[1],
+            handle_data->device_config.device_addr.address[2],
+            handle_data->device_config.device_addr.address[3],
+            handle_data->device_config.device_addr.address[4],
+            handle_data->device_config.device_addr.address[5]
+        );
+        if (ret < 0 || (size_t)ret >= (sizeof(mac_address) / sizeof(mac_address[0])))
         {
-            LogError("Map_Create() failed");
+            LogError("snprintf() failed");
         }
         else
         {
-            // format BLE controller index
-            char ble_controller_index[80];
-            int ret = snprintf(ble_controller_index,
-                sizeof(ble_controller_index) / sizeof(ble_controller_index[0]),
-                "%d",
-                handle_data->device_config.ble_controller_index
-            );
-            if(ret < 0 || (size_t)ret >= (sizeof(ble_controller_index) / sizeof(ble_controller_index[0])))
+            /**
+             * The controller index and the timestamp travel as numbers; they
+             * are only turned into text if a receiver asks for a string.
+             */
+            MESSAGE_TYPED_PROPERTY properties[5];
+            properties[0].name = GW_BLE_CONTROLLER_INDEX_PROPERTY;
+            properties[0].value.type = MESSAGE_PROPERTY_TYPE_INT64;
+            properties[0].value.value.integer = handle_data->device_config.ble_controller_index;
+            properties[1].name = GW_MAC_ADDRESS_PROPERTY;
+            properties[1].value.type = MESSAGE_PROPERTY_TYPE_STRING;
+            properties[1].value.value.string = mac_address;
+            properties[2].name = GW_TIMESTAMP_PROPERTY;
+            properties[2].value.type = MESSAGE_PROPERTY_TYPE_TIMESTAMP;
+            properties[2].value.value.timestamp = g_get_real_time() / 1000;
+            properties[3].name = GW_CHARACTERISTIC_UUID_PROPERTY;
+            properties[3].value.type = MESSAGE_PROPERTY_TYPE_STRING;
+            properties[3].value.value.string = characteristic_uuid;
+            properties[4].name = GW_SOURCE_PROPERTY;
+            properties[4].value.type = MESSAGE_PROPERTY_TYPE_STRING;
+            properties[4].value.value.string = GW_SOURCE_BLE_TELEMETRY;
+
+            MESSAGE_TYPED_CONFIG message_config;
+            message_config.size = BUFFER_length(data); // "data" MUST NOT be NULL here
+            message_config.source = (const unsigned char*)BUFFER_u_char(data);
+            message_config.properties = properties;
+            message_config.propertyCount = sizeof(properties) / sizeof(properties[0]);
+
+            MESSAGE_HANDLE message = Message_CreateTyped(&message_config);
+            if (message == NULL)
             {
-                LogError("snprintf() failed");
+                LogError("Message_CreateTyped() failed");
             }
             else
             {
-                // format MAC address
-                char mac_address[18] = "";
-                ret = snprintf(
-                    mac_address,
-                    sizeof(mac_address) / sizeof(mac_address[0]),
-                    "%02X:%02X:%02X:%02X:%02X:%02X",
-                    handle_data->device_config.device_addr.address[0],
-                    handle_data->device_config.device_addr.address[1],
-                    handle_data->device_config.device_addr.address[2],
-                    handle_data->device_config.device_addr.address[3],
-                    handle_data->device_config.device_addr.address[4],
-                    handle_data->device_config.device_addr.address[5]
-                );
-                if (ret < 0 || (size_t)ret >= (sizeof(mac_address) / sizeof(mac_address[0])))
-                {
-                    LogError("snprintf() failed");
-                }
-                else
-                {
-                    // format timestamp
-                    char timestamp[25] = "";
-                    if (format_timestamp(timestamp, sizeof(timestamp) / sizeof(timestamp[0])) != 0)
-                    {
-                        LogError("format_timestamp() failed");
-                    }
-                    else if (Map_Add(message_properties, GW_BLE_CONTROLLER_INDEX_PROPERTY, ble_controller_index) != MAP_OK)
-                    {
-                        LogError("Map_Add() failed for property %s", GW_BLE_CONTROLLER_INDEX_PROPERTY);
-                    }
-                    else if (Map_Add(message_properties, GW_MAC_ADDRESS_PROPERTY, mac_address) != MAP_OK)
-                    {
-                        LogError("Map_Add() failed for property %s", GW_MAC_ADDRESS_PROPERTY);
-                    }
-                    else if (Map_Add(message_properties, GW_TIMESTAMP_PROPERTY, timestamp) != MAP_OK)
-                    {
-                        LogError("Map_Add() failed for property %s", GW_TIMESTAMP_PROPERTY);
-                    }
-                    else if (Map_Add(message_properties, GW_CHARACTERISTIC_UUID_PROPERTY, characteristic_uuid) != MAP_OK)
-                    {
-                        LogError("Map_Add() failed for property %s", GW_CHARACTERISTIC_UUID_PROPERTY);
-                    }
-                    else if (Map_Add(message_properties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
-                    {
-                        LogError("Map_Add() failed for property %s", GW_SOURCE_PROPERTY);
-                    }
-                    else
-                    {
-                        MESSAGE_CONFIG message_config;
-                        message_config.sourceProperties = message_properties;
-                        message_config.size = BUFFER_length(data); // "data" MUST NOT be NULL here
-                        message_config.source = (const unsigned char*)BUFFER_u_char(data);
+                /*Codes_SRS_BLE_13_019: [BLE_Create shall handle the ON_BLEIO_SEQ_READ_COMPLETE callback on the BLE I/O sequence. If the call is successful then a new message shall be published on the message broker with the buffer that was read as the content of the message along with the following properties:
 
-                        MESSAGE_HANDLE message = Message_Create(&message_config);
-                        if (message == NULL)
-                        {
-                            LogError("Message_Create() failed");
-                        }
-                        else
-                        {
-                            /*Codes_SRS_BLE_13_019: [BLE_Create shall handle the ON_BLEIO_SEQ_READ_COMPLETE callback on the BLE I/O sequence. If the call is successful then a new message shall be published on the message broker with the buffer that was read as the content of the message along with the following properties:
+                | Property Name           | Description                                                   |
+                |-------------------------|---------------------------------------------------------------|
+                | ble_controller_index    | The index of the bluetooth radio hardware on the device.      |
+                | mac_address             | MAC address of the BLE device from which the data was read.   |
+                | timestamp               | Timestamp indicating when the data was read.                  |
+                | source                  | This property will always have the value `bleTelemetry`.      |
 
-                            | Property Name           | Description                                                   |
-                            |-------------------------|---------------------------------------------------------------|
-                            | ble_controller_index    | The index of the bluetooth radio hardware on the device.      |
-                            | mac_address             | MAC address of the BLE device from which the data was read.   |
-                            | timestamp               | Timestamp indicating when the data was read.                  |
-                            | source                  | This property will always have the value `bleTelemetry`.      |
-
-                            ]*/
-                            if (Broker_Publish(handle_data->broker, (MODULE_HANDLE)handle_data, message) != BROKER_OK)
-                            {
-                                LogError("Broker_Publish() failed");
-                            }
-
-                            Message_Destroy(message);
-                        }
-                    }
-
-                    Map_Destroy(message_properties);
+                ]*/
+                if (Broker_Publish(handle_data->broker, (MODULE_HANDLE)handle_data, message) != BROKER_OK)
+                {
+                    LogError("Broker_Publish() failed");
                 }
+
+                Message_Destroy(message);
             }
         }
     }
@@ -783,7 +713,6 @@ static void BLE_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
     if (module != NULL && message != NULL)
     {
         BLE_HANDLE_DATA* handle_data = (BLE_HANDLE_DATA*)module;
-        CONSTMAP_HANDLE properties = Message_GetProperties(message);
 
         /*Codes_SRS_BLE_13_020: [ BLE_Receive shall ignore all messages except those that have the following properties:
             >| Property Name           | Description                                                             |
@@ -792,11 +721,11 @@ static void BLE_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
             >| macAddress              | MAC address of the BLE device to which the data to should be written.   |
         ]*/
         // fetch the 'source' property
-        const char* source = ConstMap_GetValue(properties, GW_SOURCE_PROPERTY);
+        const char* source = Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE);
         if (source != NULL && strcmp(source, GW_SOURCE_BLE_COMMAND) == 0)
         {
             // fetch the 'macAddress' property
-            const char* mac_address = ConstMap_GetValue(properties, GW_MAC_ADDRESS_PROPERTY);
+            const char* mac_address = Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS);
             if (mac_address != NULL && is_message_for_module(mac_address, handle_data) == true)
             {
                 const CONSTBUFFER* content = Message_GetContent(message);
@@ -822,8 +751,6 @@ static void BLE_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
                 }
             }
         }
-
-        ConstMap_Destroy(properties);
     }
     else
     {
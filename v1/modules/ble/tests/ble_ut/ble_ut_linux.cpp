@@ -341,6 +341,10 @@ public:
         MESSAGE_HANDLE result2 = BASEIMPLEMENTATION::Message_Create(cfg);
     MOCK_METHOD_END(MESSAGE_HANDLE, result2)
 
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_CreateTyped, const MESSAGE_TYPED_CONFIG*, cfg)
+        MESSAGE_HANDLE result2 = BASEIMPLEMENTATION::Message_CreateTyped(cfg);
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
     MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg)
             MESSAGE_HANDLE result1 = BASEIMPLEMENTATION::Message_CreateFromBuffer(cfg);
     MOCK_METHOD_END(MESSAGE_HANDLE, result1)
@@ -353,6 +357,10 @@ public:
         CONSTMAP_HANDLE result1 = BASEIMPLEMENTATION::Message_GetProperties(message);
     MOCK_METHOD_END(CONSTMAP_HANDLE, result1)
 
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
+        const char* result1 = BASEIMPLEMENTATION::Message_GetPropertyById(message, id);
+    MOCK_METHOD_END(const char*, result1)
+
     MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message)
         const CONSTBUFFER* result1 = BASEIMPLEMENTATION::Message_GetContent(message);
     MOCK_METHOD_END(const CONSTBUFFER*, result1)
@@ -595,6 +603,10 @@ public:
         gint64 result2 = 1;
     MOCK_METHOD_END(gint64, result2);
 
+    MOCK_STATIC_METHOD_0(, gint64, g_get_real_time)
+        gint64 result2 = 1;
+    MOCK_METHOD_END(gint64, result2);
+
     MOCK_STATIC_METHOD_1(, void, g_usleep, gulong, microseconds)
     MOCK_VOID_METHOD_END()
 
@@ -748,9 +760,11 @@ DECLARE_GLOBAL_MOCK_METHOD_3(CBLEMocks, , THREADAPI_RESULT, ThreadAPI_Create, TH
 DECLARE_GLOBAL_MOCK_METHOD_2(CBLEMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , MESSAGE_HANDLE, Message_CreateTyped, const MESSAGE_TYPED_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBLEMocks, , const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
@@ -780,6 +794,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , struct tm*, gb_localtime, const time_t
 DECLARE_GLOBAL_MOCK_METHOD_4(CBLEMocks, , size_t, gb_strftime, char*, s, size_t, maxsize, const char *, format, const struct tm *, timeptr);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CBLEMocks, , gint64, g_get_monotonic_time);
+DECLARE_GLOBAL_MOCK_METHOD_0(CBLEMocks, , gint64, g_get_real_time);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_usleep, gulong, microseconds);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , GMainContext*, g_main_loop_get_context, GMainLoop*, loop);
@@ -2823,7 +2838,7 @@ BEGIN_TEST_SUITE(ble_ut)
         STRING_delete(instr1.characteristic_uuid);
     }
 
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_Map_Create_fails)
+    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_Message_CreateTyped_fails)
     {
         ///arrange
         CBLEMocks mocks;
@@ -2864,10 +2879,17 @@ BEGIN_TEST_SUITE(ble_ut)
             .IgnoreArgument(2);                                              // CBLEIOSequence::run
         STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);                                              // CBLEIOSequence::run
+        STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);                                              // on_read_complete
+        STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);                                              // on_read_complete
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1);                                              // CBLEIOSequence::run
 
+        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);                 
+
         STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
         STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
@@ -2875,23 +2897,22 @@ BEGIN_TEST_SUITE(ble_ut)
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-
+            .IgnoreArgument(1);                                              // CBLEIOSequence::run
         STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
             .IgnoreArgument(1)
             .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL))
-            .SetFailReturn((MAP_HANDLE)NULL);
-
         STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
         STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments()
             .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
 
+        STRICT_EXPECTED_CALL(mocks, g_get_real_time());
+
+        STRICT_EXPECTED_CALL(mocks, Message_CreateTyped(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetFailReturn((MESSAGE_HANDLE)NULL);
+
         ///act
         auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
 
@@ -2906,7 +2927,17 @@ BEGIN_TEST_SUITE(ble_ut)
         STRING_delete(instr1.characteristic_uuid);
     }
 
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_time_fails)
+    /*Tests_SRS_BLE_13_019: [BLE_Create shall handle the ON_BLEIO_SEQ_READ_COMPLETE callback on the BLE I/O sequence. If the call is successful then a new message shall be published on the message broker with the buffer that was read as the content of the message along with the following properties:
+
+    | Property Name           | Description                                                   |
+    |-------------------------|---------------------------------------------------------------|
+    | ble_controller_index    | The index of the bluetooth radio hardware on the device.      |
+    | mac_address             | MAC address of the BLE device from which the data was read.   |
+    | timestamp               | Timestamp indicating when the data was read.                  |
+    | source                  | This property will always have the value `bleTelemetry`.      |
+
+    ]*/
+    TEST_FUNCTION(on_read_complete_publishes_message)
     {
         ///arrange
         CBLEMocks mocks;
@@ -2947,6 +2978,16 @@ BEGIN_TEST_SUITE(ble_ut)
             .IgnoreArgument(2);                                              // CBLEIOSequence::run
         STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);                                              // CBLEIOSequence::run
+        STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);                                              // on_read_complete
+        STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);                                              // on_read_complete
+
+        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);                                              // on_read_complete
+        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
             .IgnoreArgument(1);                                              // CBLEIOSequence::run
@@ -2959,26 +3000,30 @@ BEGIN_TEST_SUITE(ble_ut)
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
             .IgnoreArgument(1);                                             // CBLEIOSequence::run
-
         STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
+            .IgnoreArgument(1);                                              
+
 
         STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
             .IgnoreArgument(1)
             .IgnoreArgument(2);
 
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, g_get_real_time());
+
+        STRICT_EXPECTED_CALL(mocks, Message_CreateTyped(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+
         STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
         STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments()
             .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL))
-            .SetFailReturn((time_t)-1);
-
         ///act
         auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
 
@@ -2993,7 +3038,23 @@ BEGIN_TEST_SUITE(ble_ut)
         STRING_delete(instr1.characteristic_uuid);
     }
 
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_localtime_fails)
+    /*Tests_SRS_BLE_13_016: [ If module is NULL BLE_Destroy shall do nothing. ]*/
+    TEST_FUNCTION(BLE_Destroy_does_nothing_with_NULL_input)
+    {
+        ///arrange
+        CBLEMocks mocks;
+
+        ///act
+        BLE_Destroy(NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_BLE_13_017: [ BLE_Destroy shall free all resources. ]*/
+    TEST_FUNCTION(BLE_Destroy_happy_path)
     {
         ///arrange
         CBLEMocks mocks;
@@ -3015,1107 +3076,110 @@ BEGIN_TEST_SUITE(ble_ut)
         g_read_result = BLEIO_SEQ_OK;
         g_call_on_read_complete = true;
 
-        mocks.ResetAllCalls();
+        // we don't want ThreadAPI_Create to call the callback
+        shouldThreadAPI_Create_invoke_callback = false;
 
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
+        // we want thread func called from g_main_loop_quit
+        should_g_main_loop_quit_call_thread_func = true;
 
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
+        mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_disconnect(IGNORED_PTR_ARG, NULL, NULL))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
         STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Destroy(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, g_get_monotonic_time());
+        STRICT_EXPECTED_CALL(mocks, g_main_loop_get_context(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, g_main_loop_run(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, g_main_loop_unref(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, g_main_loop_quit(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
-            .SetFailReturn((struct tm*)NULL);
+            .IgnoreArgument(2);
 
         ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
+        BLE_Destroy(result);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
         ASSERT_IS_NOT_NULL(result);
 
         ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
         VECTOR_destroy(instructions);
         STRING_delete(instr1.characteristic_uuid);
     }
 
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_strftime_fails)
+    /*Tests_SRS_BLE_26_001: [ `Module_GetApi` shall return a pointer to a `MODULE_API` structure. ]*/
+    TEST_FUNCTION(Module_GetApi_returns_non_NULL_and_non_NULL_fields)
     {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
+        ///arrrange
 
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
+        ///act
+        const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
+        ///assert
+        ASSERT_IS_NOT_NULL(apis);
+        ASSERT_IS_TRUE(MODULE_PARSE_CONFIGURATION_FROM_JSON(apis) != NULL);
+        ASSERT_IS_TRUE(MODULE_FREE_CONFIGURATION(apis) != NULL);
+        ASSERT_IS_TRUE(MODULE_CREATE(apis) != NULL);
+        ASSERT_IS_TRUE(MODULE_DESTROY(apis) != NULL);
+        ASSERT_IS_TRUE(MODULE_RECEIVE(apis) != NULL);
+    }
 
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+    /*Tests_SRS_BLE_13_018: [ BLE_Receive shall do nothing if module is NULL or if message is NULL. ]*/
+    TEST_FUNCTION(BLE_Receive_does_nothing_when_module_handle_is_NULL)
+    {
+        ///arrrange
+        CBLEMocks mocks;
 
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        ///act
+        BLE_Receive(NULL, (MESSAGE_HANDLE)0x42);
 
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+    }
 
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetFailReturn((size_t)0);
+    /*Tests_SRS_BLE_13_018: [ BLE_Receive shall do nothing if module is NULL or if message is NULL. ]*/
+    TEST_FUNCTION(BLE_Receive_does_nothing_when_message_is_NULL)
+    {
+        ///arrrange
+        CBLEMocks mocks;
 
         ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
+        BLE_Receive((MODULE_HANDLE)0x42, NULL);
 
         ///assert
         mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
     }
 
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_first_Map_Add_fails)
+    /*Tests_SRS_BLE_13_020: [ BLE_Receive shall ignore all messages except those that have the following properties:
+        >| Property Name           | Description                                                             |
+        >|-------------------------|-------------------------------------------------------------------------|
+        >| source                  | This property should have the value "BLE".                              |
+        >| macAddress              | MAC address of the BLE device to which the data to should be written.   |
+    ]*/
+    TEST_FUNCTION(BLE_Receive_does_nothing_when_message_does_not_contain_source_property)
     {
-        ///arrange
+        ///arrrange
         CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3)
-            .SetFailReturn((MAP_RESULT)MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_second_Map_Add_fails)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3)
-            .SetFailReturn((MAP_RESULT)MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_third_Map_Add_fails)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_TIMESTAMP_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3)
-            .SetFailReturn((MAP_RESULT)MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_fourth_Map_Add_fails)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_TIMESTAMP_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_CHARACTERISTIC_UUID_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3)
-            .SetFailReturn((MAP_RESULT)MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-    
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_fifth_Map_Add_fails)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_TIMESTAMP_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_CHARACTERISTIC_UUID_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    TEST_FUNCTION(on_read_complete_does_not_publish_message_when_Message_Create_fails)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // on_read_complete
-        STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // on_read_complete
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                 
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_TIMESTAMP_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_CHARACTERISTIC_UUID_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        // mallocAndStrcpy_s is called twice for each property and we have 5 properties
-        for (size_t i = 0; i < (5 * 2); i++)
-        {
-            STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreAllArguments();
-        }
-
-        STRICT_EXPECTED_CALL(mocks, Message_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .SetFailReturn((MESSAGE_HANDLE)NULL);
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    /*Tests_SRS_BLE_13_019: [BLE_Create shall handle the ON_BLEIO_SEQ_READ_COMPLETE callback on the BLE I/O sequence. If the call is successful then a new message shall be published on the message broker with the buffer that was read as the content of the message along with the following properties:
-
-    | Property Name           | Description                                                   |
-    |-------------------------|---------------------------------------------------------------|
-    | ble_controller_index    | The index of the bluetooth radio hardware on the device.      |
-    | mac_address             | MAC address of the BLE device from which the data was read.   |
-    | timestamp               | Timestamp indicating when the data was read.                  |
-    | source                  | This property will always have the value `bleTelemetry`.      |
-
-    ]*/
-    TEST_FUNCTION(on_read_complete_publishes_message)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_create(&(config.device_config)));
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_connect(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, BUFFER_length(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // on_read_complete
-        STRICT_EXPECTED_CALL(mocks, BUFFER_u_char(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // on_read_complete
-
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);                                              // on_read_complete
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(BLEIO_SEQ_INSTRUCTION)));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(instructions, 0));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);                                              // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(config.instructions));
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                             // CBLEIOSequence::run
-        STRICT_EXPECTED_CALL(mocks, STRING_clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);                                              
-
-
-        STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        STRICT_EXPECTED_CALL(mocks, Map_Create(NULL));
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_BLE_CONTROLLER_INDEX_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_TIMESTAMP_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_CHARACTERISTIC_UUID_PROPERTY, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(3);
-        STRICT_EXPECTED_CALL(mocks, Map_Add(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, gb_time(NULL));
-        STRICT_EXPECTED_CALL(mocks, gb_localtime(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, gb_strftime(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
-        // mallocAndStrcpy_s is called twice for each property and we have 5 properties
-        // and we do the whole thing twice
-        for (size_t i = 0; i < (5 * 2) * 2; i++)
-        {
-            STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreAllArguments();
-        }
-
-        STRICT_EXPECTED_CALL(mocks, Message_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)0x42, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(2)
-            .IgnoreArgument(3);
-
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_new(NULL, FALSE));
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments()
-            .SetReturn((THREADAPI_RESULT)THREADAPI_OK);
-
-        ///act
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        should_g_main_loop_quit_call_thread_func = true;
-        BLE_Destroy(result);
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    /*Tests_SRS_BLE_13_016: [ If module is NULL BLE_Destroy shall do nothing. ]*/
-    TEST_FUNCTION(BLE_Destroy_does_nothing_with_NULL_input)
-    {
-        ///arrange
-        CBLEMocks mocks;
-
-        ///act
-        BLE_Destroy(NULL);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///cleanup
-    }
-
-    /*Tests_SRS_BLE_13_017: [ BLE_Destroy shall free all resources. ]*/
-    TEST_FUNCTION(BLE_Destroy_happy_path)
-    {
-        ///arrange
-        CBLEMocks mocks;
-        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
-        BLE_INSTRUCTION instr1 =
-        {
-            READ_ONCE,
-            STRING_construct("fake_char_id"),
-            { 500 }
-        };
-        VECTOR_push_back(instructions, &instr1, 1);
-        BLE_CONFIG config =
-        {
-            { { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF }, 0 },
-            instructions
-        };
-
-        // have the on_read_complete callback called
-        g_read_result = BLEIO_SEQ_OK;
-        g_call_on_read_complete = true;
-
-        // we don't want ThreadAPI_Create to call the callback
-        shouldThreadAPI_Create_invoke_callback = false;
-
-        // we want thread func called from g_main_loop_quit
-        should_g_main_loop_quit_call_thread_func = true;
-
-        auto result = BLE_Create((BROKER_HANDLE)0x42, &config);
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_disconnect(IGNORED_PTR_ARG, NULL, NULL))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BLEIO_gatt_destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_Destroy(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, g_get_monotonic_time());
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_get_context(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_run(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_unref(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, g_main_loop_quit(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
-
-        ///act
-        BLE_Destroy(result);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-        ASSERT_IS_NOT_NULL(result);
-
-        ///cleanup
-        VECTOR_destroy(instructions);
-        STRING_delete(instr1.characteristic_uuid);
-    }
-
-    /*Tests_SRS_BLE_26_001: [ `Module_GetApi` shall return a pointer to a `MODULE_API` structure. ]*/
-    TEST_FUNCTION(Module_GetApi_returns_non_NULL_and_non_NULL_fields)
-    {
-        ///arrrange
-
-        ///act
-        const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
-
-        ///assert
-        ASSERT_IS_NOT_NULL(apis);
-        ASSERT_IS_TRUE(MODULE_PARSE_CONFIGURATION_FROM_JSON(apis) != NULL);
-        ASSERT_IS_TRUE(MODULE_FREE_CONFIGURATION(apis) != NULL);
-        ASSERT_IS_TRUE(MODULE_CREATE(apis) != NULL);
-        ASSERT_IS_TRUE(MODULE_DESTROY(apis) != NULL);
-        ASSERT_IS_TRUE(MODULE_RECEIVE(apis) != NULL);
-    }
-
-    /*Tests_SRS_BLE_13_018: [ BLE_Receive shall do nothing if module is NULL or if message is NULL. ]*/
-    TEST_FUNCTION(BLE_Receive_does_nothing_when_module_handle_is_NULL)
-    {
-        ///arrrange
-        CBLEMocks mocks;
-
-        ///act
-        BLE_Receive(NULL, (MESSAGE_HANDLE)0x42);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-    }
-
-    /*Tests_SRS_BLE_13_018: [ BLE_Receive shall do nothing if module is NULL or if message is NULL. ]*/
-    TEST_FUNCTION(BLE_Receive_does_nothing_when_message_is_NULL)
-    {
-        ///arrrange
-        CBLEMocks mocks;
-
-        ///act
-        BLE_Receive((MODULE_HANDLE)0x42, NULL);
-
-        ///assert
-        mocks.AssertActualAndExpectedCalls();
-    }
-
-    /*Tests_SRS_BLE_13_020: [ BLE_Receive shall ignore all messages except those that have the following properties:
-        >| Property Name           | Description                                                             |
-        >|-------------------------|-------------------------------------------------------------------------|
-        >| source                  | This property should have the value "BLE".                              |
-        >| macAddress              | MAC address of the BLE device to which the data to should be written.   |
-    ]*/
-    TEST_FUNCTION(BLE_Receive_does_nothing_when_message_does_not_contain_source_property)
-    {
-        ///arrrange
-        CBLEMocks mocks;
-
+
         VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
         BLE_INSTRUCTION instr1 =
         {
@@ -4145,17 +3209,7 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
 
         ///act
         BLE_Receive(handle, message);
@@ -4213,17 +3267,7 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
 
         ///act
         BLE_Receive(handle, message);
@@ -4281,21 +3325,8 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS));
 
         ///act
         BLE_Receive(handle, message);
@@ -4355,21 +3386,8 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS));
 
         ///act
         BLE_Receive(handle, message);
@@ -4424,21 +3442,8 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS));
 
         ///act
         BLE_Receive(handle, message);
@@ -4492,26 +3497,14 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(message));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS));
 
         STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-
         ///act
         BLE_Receive(handle, message);
 
@@ -4573,26 +3566,14 @@ BEGIN_TEST_SUITE(ble_ut)
         MESSAGE_HANDLE message = Message_Create(&message_config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(message));
         STRICT_EXPECTED_CALL(mocks, Message_GetContent(message));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_SOURCE));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(message, MESSAGE_PROPERTY_MAC_ADDRESS));
 
         STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-
         STRICT_EXPECTED_CALL(mocks, BLEIO_Seq_AddInstruction(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .IgnoreArgument(2);
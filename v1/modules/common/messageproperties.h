@@ -4,6 +4,7 @@
 #ifndef MESSAGEPROPERTIES_H
 #define MESSAGEPROPERTIES_H
 
+/*the property names below are also interned by the gateway core, see MESSAGE_PROPERTY_ID in message.h*/
 #define GW_MAC_ADDRESS_PROPERTY             "macAddress"
 #define GW_SOURCE_PROPERTY                  "source"
 #define GW_DEVICENAME_PROPERTY              "deviceName"
@@ -208,6 +208,96 @@ public:
     operator IOTHUB_CONFIG*() { return &config_; }
 };
 
+/*the property tables behind every MESSAGE_HANDLE used in these tests*/
+static const char* getMessagePropertyValue(MESSAGE_HANDLE message, const char* key)
+{
+    const char* result2;
+    CONSTMAP_HANDLE properties;
+    if (message == MESSAGE_HANDLE_WITHOUT_SOURCE)
+    {
+        properties = CONSTMAP_HANDLE_WITHOUT_SOURCE;
+    }
+    else if (message == MESSAGE_HANDLE_WITH_SOURCE_NOT_SET_TO_MAPPING)
+    {
+        properties = CONSTMAP_HANDLE_WITH_SOURCE_NOT_SET_TO_MAPPING;
+    }
+    else if (message == MESSAGE_HANDLE_VALID_1)
+    {
+        properties = CONSTMAP_HANDLE_VALID_1;
+    }
+    else if (message == MESSAGE_HANDLE_VALID_2)
+    {
+        properties = CONSTMAP_HANDLE_VALID_2;
+    }
+    else if (message == MESSAGE_HANDLE_WITH_IOTHUBMESSAGEID)
+    {
+        properties = CONSTMAP_HANDLE_WITH_IOTHUBMESSAGEID;
+    }
+    else
+    {
+        properties = NULL;
+    }
+
+    if (properties == CONSTMAP_HANDLE_WITHOUT_SOURCE)
+    {
+        result2 = NULL;
+    }
+    else if (properties == CONSTMAP_HANDLE_WITH_SOURCE_NOT_SET_TO_MAPPING)
+    {
+        if (strcmp(key, "source") == 0)
+        {
+            result2 = "notMapping";
+        }
+        else
+        {
+            result2 = NULL;
+        }
+    }
+    else if (properties == CONSTMAP_HANDLE_VALID_1)
+    {
+        size_t i;
+        result2 = NULL;
+        for (i = 0; i < sizeof(CONSTMAP_KEYS_VALID_1)/sizeof(CONSTMAP_KEYS_VALID_1[0]); i++)
+        {
+            if (strcmp(CONSTMAP_KEYS_VALID_1[i], key) == 0)
+            {
+                result2 = CONSTMAP_VALUES_VALID_1[i];
+                break;
+            }
+        }
+    }
+    else if (properties == CONSTMAP_HANDLE_VALID_2)
+    {
+        size_t i;
+        result2 = NULL;
+        for (i = 0; i < sizeof(CONSTMAP_KEYS_VALID_2)/sizeof(CONSTMAP_KEYS_VALID_2[0]); i++)
+        {
+            if (strcmp(CONSTMAP_KEYS_VALID_2[i], key) == 0)
+            {
+                result2 = CONSTMAP_VALUES_VALID_2[i];
+                break;
+            }
+        }
+    }
+    else if (properties == CONSTMAP_HANDLE_WITH_IOTHUBMESSAGEID)
+    {
+        size_t i;
+        result2 = NULL;
+        for (i = 0; i < sizeof(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID)/sizeof(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID[0]); i++)
+        {
+            if (strcmp(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID[i], key) == 0)
+            {
+                result2 = CONSTMAP_VALUES_WITH_IOTHUBMESSAGEID[i];
+                break;
+            }
+        }
+    }
+    else
+    {
+        result2 = NULL;
+    }
+    return result2;
+}
 
 TYPED_MOCK_CLASS(IotHubMocks, CGlobalMock)
 {
@@ -397,65 +487,29 @@ public:
         }
     MOCK_METHOD_END(CONSTMAP_HANDLE, result2)
 
-    MOCK_STATIC_METHOD_2(, const char*, ConstMap_GetValue, CONSTMAP_HANDLE, handle, const char*, key)
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name)
+        const char* result2 = getMessagePropertyValue(message, name);
+    MOCK_METHOD_END(const char*, result2)
+
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
         const char* result2;
-        if (handle == CONSTMAP_HANDLE_WITHOUT_SOURCE)
-        {
-            result2 = NULL;
-        }
-        else if (handle == CONSTMAP_HANDLE_WITH_SOURCE_NOT_SET_TO_MAPPING)
-        {
-            if (strcmp(key, "source") == 0)
-            {
-                result2 = "notMapping";
-            }
-            else
-            {
-                result2 = NULL;
-            }
-        }
-        else if (handle == CONSTMAP_HANDLE_VALID_1)
-        {
-            size_t i;
-            result2 = NULL;
-            for (i = 0; i < sizeof(CONSTMAP_KEYS_VALID_1)/sizeof(CONSTMAP_KEYS_VALID_1[0]); i++)
-            {
-                if (strcmp(CONSTMAP_KEYS_VALID_1[i], key) == 0)
-                {
-                    result2 = CONSTMAP_VALUES_VALID_1[i];
-                    break;
-                }
-            }
-        }
-        else if (handle == CONSTMAP_HANDLE_VALID_2)
-        {
-            size_t i;
-            result2 = NULL;
-            for (i = 0; i < sizeof(CONSTMAP_KEYS_VALID_2)/sizeof(CONSTMAP_KEYS_VALID_2[0]); i++)
-            {
-                if (strcmp(CONSTMAP_KEYS_VALID_2[i], key) == 0)
-                {
-                    result2 = CONSTMAP_VALUES_VALID_2[i];
-                    break;
-                }
-            }
-        }
-        else if (handle == CONSTMAP_HANDLE_WITH_IOTHUBMESSAGEID)
-        {
-            size_t i;
-            result2 = NULL;
-            for (i = 0; i < sizeof(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID)/sizeof(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID[0]); i++)
-            {
-                if (strcmp(CONSTMAP_KEYS_WITH_IOTHUBMESSAGEID[i], key) == 0)
-                {
-                    result2 = CONSTMAP_VALUES_WITH_IOTHUBMESSAGEID[i];
-                    break;
-                }
-            }
-        }
-        else
+        switch (id)
         {
+        case MESSAGE_PROPERTY_SOURCE:
+            result2 = getMessagePropertyValue(message, "source");
+            break;
+        case MESSAGE_PROPERTY_DEVICE_NAME:
+            result2 = getMessagePropertyValue(message, "deviceName");
+            break;
+        case MESSAGE_PROPERTY_DEVICE_KEY:
+            result2 = getMessagePropertyValue(message, "deviceKey");
+            break;
+        case MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID:
+            result2 = getMessagePropertyValue(message, "iotHubMessageId");
+            break;
+        default:
             result2 = NULL;
+            break;
         }
     MOCK_METHOD_END(const char*, result2)
 
@@ -636,7 +690,8 @@ DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, IoTHubClient_Destroy, IOTHUB_C
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, Message_Destroy, MESSAGE_HANDLE, message)
-DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, ConstMap_GetValue, CONSTMAP_HANDLE, handle, const char*, key)
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, name)
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_AddOrUpdate, MAP_HANDLE, handle, const char*, key, const char*, value);
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_Add, MAP_HANDLE, handle, const char*, key, const char*, value);
 DECLARE_GLOBAL_MOCK_METHOD_4(IotHubMocks, , CONSTMAP_RESULT, ConstMap_GetInternals, CONSTMAP_HANDLE, handle, const char*const**, keys, const char*const**, values, size_t*, count)
@@ -2015,17 +2070,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2113,9 +2164,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
+            .IgnoreArgument(1);
 
         /*finally, send the message*/
         STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
@@ -2142,19 +2192,15 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE))
             .SetReturn((const char*)NULL);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"))
             .SetReturn("register");
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2297,17 +2343,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2355,9 +2397,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
             .SetReturn((const char*)NULL);
 
         /*finally, send the message*/
@@ -2384,17 +2425,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2482,9 +2519,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
             .SetReturn("messageId1234");
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(MESSAGE_DELIVERED_CALLBACK_CONTEXT)))
@@ -2510,17 +2546,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2568,9 +2600,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
             .SetReturn((const char*)"messageId0123");
 
         STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(MESSAGE_DELIVERED_CALLBACK_CONTEXT)));
@@ -2603,17 +2634,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2661,9 +2688,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
             .IgnoreArgument(1)
-            .IgnoreArgument(2)
             .SetReturn((const char*)"messageId0123");
 
         MESSAGE_DELIVERED_CALLBACK_CONTEXT callbackContext;
@@ -3224,17 +3250,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_2));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_2, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -3321,9 +3343,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument(1)
-            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
+            .IgnoreArgument(1);
 
         /*finally, send the message*/
         STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
@@ -3350,17 +3371,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3448,9 +3465,8 @@ BEGIN_TEST_SUITE(iothub_ut)
         }
 
         /*Check iotHubMessageId property*/
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument(1)
-                .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(IGNORED_PTR_ARG, MESSAGE_PROPERTY_IOTHUB_MESSAGE_ID))
+                .IgnoreArgument(1);
 
         /*finally, send the message*/
         STRICT_EXPECTED_CALL(mocks, IoTHubClient_SendEventAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
@@ -3478,17 +3494,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3597,17 +3609,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3712,17 +3720,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3821,17 +3825,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3910,17 +3910,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3994,17 +3990,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4043,17 +4035,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4111,17 +4099,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4185,17 +4169,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4264,17 +4244,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4317,17 +4293,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -4360,17 +4332,13 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_KEY))
             .SetReturn((const char*)NULL);
 
         ///act
@@ -4392,15 +4360,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICE_NAME))
             .SetReturn((const char*)NULL);
 
         ///act
@@ -4422,14 +4386,10 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE))
             .SetReturn((const char*)NULL);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"));
 
         ///act
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
@@ -4450,14 +4410,10 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, config);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE))
             .SetReturn((const char*)NULL);
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceFunction"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetProperty(MESSAGE_HANDLE_VALID_1, "deviceFunction"))
             .SetReturn("not register");
 
         ///act
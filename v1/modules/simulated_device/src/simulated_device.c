@@ -95,6 +95,40 @@ static void SimulatedDevice_Destroy(MODULE_HANDLE moduleHandle)
     }
 }
 
+static PROPERTY_SET_HANDLE create_telemetry_properties(const char* macAddress)
+{
+    PROPERTY_SET_HANDLE result;
+    MAP_HANDLE properties = Map_Create(NULL);
+    if (properties == NULL)
+    {
+        LogError("Failed to create message properties");
+        result = NULL;
+    }
+    else
+    {
+        if (Map_Add(properties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
+        {
+            LogError("Failed to set source property");
+            result = NULL;
+        }
+        else if (Map_Add(properties, GW_MAC_ADDRESS_PROPERTY, macAddress) != MAP_OK)
+        {
+            LogError("Failed to set address property");
+            result = NULL;
+        }
+        else
+        {
+            result = PropertySet_Create(properties);
+            if (result == NULL)
+            {
+                LogError("Failed to create the property set");
+            }
+        }
+        Map_Destroy(properties);
+    }
+    return result;
+}
+
 static int simulated_device_worker(void * user_data)
 {
     SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)user_data;
@@ -104,71 +138,68 @@ static int simulated_device_worker(void * user_data)
 
     if (user_data != NULL)
     {
-
+        /* every reading has the same properties, so all the messages share one set */
+        PROPERTY_SET_HANDLE properties = NULL;
         while (module_data->simulatedDeviceRunning)
         {
             ThreadAPI_Sleep(module_data -> messagePeriod);
 
-            MESSAGE_CONFIG newMessageCfg;
-            MAP_HANDLE newProperties = Map_Create(NULL);
-            if (newProperties == NULL)
+            if (properties == NULL)
             {
-                LogError("Failed to create message properties");
+                properties = create_telemetry_properties(module_data->fakeMacAddress);
             }
 
+            if (properties == NULL)
+            {
+                LogError("No message properties for device %s, retrying on the next reading", module_data->fakeMacAddress);
+            }
             else
             {
-                if (Map_Add(newProperties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
-                {
-                    LogError("Failed to set source property");
-                }
-                else if (Map_Add(newProperties, GW_MAC_ADDRESS_PROPERTY, module_data->fakeMacAddress) != MAP_OK)
+                MESSAGE_SHARED_CONFIG newMessageCfg;
+                char msgText[128];
+
+                newMessageCfg.properties = properties;
+                if ((avgTemperature + additionalTemp) > maxSpeed)
+                    additionalTemp = 0.0;
+
+                if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", avgTemperature + additionalTemp) < 0)
                 {
-                    LogError("Failed to set address property");
+                    LogError("Failed to set message text");
                 }
                 else
                 {
-                    char msgText[128];
+                    (void)printf("Device: %s, Temperature: %.2f\r\n",
+                        module_data->fakeMacAddress,
+                        avgTemperature + additionalTemp
+                        );
+                    (void)fflush(stdout);
 
-                    newMessageCfg.sourceProperties = newProperties;
-                    if ((avgTemperature + additionalTemp) > maxSpeed)
-                        additionalTemp = 0.0;
+                    newMessageCfg.size = strlen(msgText);
+                    newMessageCfg.source = (const unsigned char*)msgText;
 
-                    if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", avgTemperature + additionalTemp) < 0)
+                    MESSAGE_HANDLE newMessage = Message_CreateWithPropertySet(&newMessageCfg);
+                    if (newMessage == NULL)
                     {
-                        LogError("Failed to set message text");
+                        LogError("Failed to create new message");
                     }
                     else
                     {
-                        (void)printf("Device: %s, Temperature: %.2f\r\n",
-                            module_data->fakeMacAddress,
-                            avgTemperature + additionalTemp
-                            );
-                        (void)fflush(stdout);
-
-                        newMessageCfg.size = strlen(msgText);
-                        newMessageCfg.source = (const unsigned char*)msgText;
-
-                        MESSAGE_HANDLE newMessage = Message_Create(&newMessageCfg);
-                        if (newMessage == NULL)
+                        if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
                         {
-                            LogError("Failed to create new message");
+                            LogError("Failed to publish new message");
                         }
-                        else
-                        {
-                            if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
-                            {
-                                LogError("Failed to publish new message");
-                            }
 
-                            additionalTemp += 1.0;
-                            Message_Destroy(newMessage);
-                        }
+                        additionalTemp += 1.0;
+                        Message_Destroy(newMessage);
                     }
                 }
-                Map_Destroy(newProperties);
             }
         }
+
+        if (properties != NULL)
+        {
+            PropertySet_Destroy(properties);
+        }
     }
 
     return 0;
@@ -5,6 +5,9 @@
 package com.microsoft.azure.gateway.remote;
 
 import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.TimeUnit;
 
 import com.microsoft.azure.gateway.core.Broker;
 import com.microsoft.azure.gateway.messaging.Message;
@@ -15,6 +18,11 @@ import com.microsoft.azure.gateway.messaging.Message;
  */
 class BrokerProxy extends Broker {
     private final CommunicationEndpoint endpoint;
+    private final Object lock = new Object();
+    private final List<byte[]> pending = new ArrayList<byte[]>();
+    private FrameLimits frameLimits;
+    private int pendingBytes = FrameSerializer.FRAME_HEADER_SIZE;
+    private long lingerDeadline;
 
     public BrokerProxy(CommunicationEndpoint dataEndpoint) {
         if (dataEndpoint == null)
@@ -25,7 +33,8 @@ class BrokerProxy extends Broker {
 
     /**
      * Sends messages to the remote Gateway via the communication endpoint. This
-     * method blocks until the Gateway receives the message.
+     * method blocks until the Gateway receives the message, or, once frames
+     * were accepted, until the message is queued for the next frame.
      * 
      * @return 0 on success
      * @throws IOException
@@ -33,11 +42,83 @@ class BrokerProxy extends Broker {
      */
     @Override
     public int publishMessage(Message message, long moduleAddr) throws IOException {
+        byte[] content = message.toByteArray();
         try {
-            this.endpoint.sendMessage(message.toByteArray());
+            synchronized (lock) {
+                // with a linger of 0 no message waits, so none shares a frame
+                if (this.frameLimits == null || this.frameLimits.getLingerMillis() == 0) {
+                    this.endpoint.sendMessage(content);
+                } else {
+                    this.queueMessage(content);
+                }
+            }
         } catch (ConnectionException e) {
             throw new IOException(e);
         }
         return 0;
     }
+
+    /**
+     * Sends the messages published from now on in frames within the limits
+     * the Gateway was sent back.
+     * 
+     * @param limits Accepted frame limits
+     */
+    void acceptFrames(FrameLimits limits) {
+        synchronized (lock) {
+            this.frameLimits = limits;
+        }
+    }
+
+    /**
+     * Sends the queued messages if the first of them has waited for the linger
+     * time.
+     * 
+     * @throws ConnectionException
+     *             if it could not send
+     */
+    void flushExpired() throws ConnectionException {
+        synchronized (lock) {
+            if (!this.pending.isEmpty() && System.nanoTime() - this.lingerDeadline >= 0)
+                this.sendPending();
+        }
+    }
+
+    /**
+     * Sends the queued messages now.
+     * 
+     * @throws ConnectionException
+     *             if it could not send
+     */
+    void flush() throws ConnectionException {
+        synchronized (lock) {
+            if (!this.pending.isEmpty())
+                this.sendPending();
+        }
+    }
+
+    private void queueMessage(byte[] content) throws ConnectionException {
+        int size = FrameSerializer.FRAME_ENTRY_HEADER_SIZE + content.length;
+        if (!this.pending.isEmpty() && this.pendingBytes + size > this.frameLimits.getMaxBytes())
+            this.sendPending();
+
+        if (this.pending.isEmpty())
+            this.lingerDeadline = System.nanoTime()
+                    + TimeUnit.MILLISECONDS.toNanos(this.frameLimits.getLingerMillis());
+        this.pending.add(content);
+        this.pendingBytes += size;
+
+        // a message too large to share a frame fills one on its own
+        if (this.pending.size() >= this.frameLimits.getMaxMessages()
+                || this.pendingBytes >= this.frameLimits.getMaxBytes())
+            this.sendPending();
+    }
+
+    private void sendPending() throws ConnectionException {
+        byte[] content = this.pending.size() == 1 ? this.pending.get(0)
+                : new FrameSerializer().serializeFrame(this.pending);
+        this.pending.clear();
+        this.pendingBytes = FrameSerializer.FRAME_HEADER_SIZE;
+        this.endpoint.sendMessage(content);
+    }
 }
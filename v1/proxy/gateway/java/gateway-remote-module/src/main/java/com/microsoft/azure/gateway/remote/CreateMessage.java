@@ -13,12 +13,18 @@ class CreateMessage extends ControlMessage {
     private final DataEndpointConfig endpointsConfig;
     private final String args;
     private final int version;
+    private final FrameLimits frameLimits;
 
     public CreateMessage(DataEndpointConfig endpointsConfig, String args, int version) {
+        this(endpointsConfig, args, version, null);
+    }
+
+    public CreateMessage(DataEndpointConfig endpointsConfig, String args, int version, FrameLimits frameLimits) {
         super(RemoteMessageType.CREATE);
         this.endpointsConfig = endpointsConfig;
         this.args = args;
         this.version = version;
+        this.frameLimits = frameLimits;
     }
 
     /**
@@ -44,4 +50,12 @@ class CreateMessage extends ControlMessage {
     public int getVersion() {
         return this.version;
     }
+
+    /**
+     * 
+     * @return Frame limits offered by the Gateway, or null if messages are sent one at a time
+     */
+    public FrameLimits getFrameLimits() {
+        return this.frameLimits;
+    }
 }
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Microsoft. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+package com.microsoft.azure.gateway.remote;
+
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Deserializer for message frames received from the Gateway once frames were
+ * accepted.
+ *
+ */
+class FrameDeserializer {
+
+    /**
+     * 
+     * @param content A message received on the data channel
+     * @return true if the content is a frame of messages
+     */
+    public boolean isFrame(byte[] content) {
+        return content.length >= FrameSerializer.FRAME_HEADER_SIZE
+                && content[0] == FrameSerializer.FIRST_FRAME_BYTE
+                && content[1] == FrameSerializer.SECOND_FRAME_BYTE
+                && content[2] == FrameSerializer.FRAME_VERSION;
+    }
+
+    /**
+     * Deserializes the frame into the messages it carries, in order.
+     *
+     * @param content The frame content
+     * @return Serialized messages
+     * @throws MessageDeserializationException If the frame is malformed.
+     */
+    public List<byte[]> deserializeFrame(byte[] content) throws MessageDeserializationException {
+        if (!this.isFrame(content))
+            throw new MessageDeserializationException("Invalid frame header.");
+
+        ByteBuffer buffer = ByteBuffer.wrap(content);
+        buffer.position(3);
+        int totalSize = buffer.getInt();
+        if (totalSize != content.length)
+            throw new MessageDeserializationException(
+                    String.format("Frame size in header %s is different that actual size %s", totalSize,
+                            content.length));
+
+        int count = buffer.getInt();
+        List<byte[]> messages = new ArrayList<byte[]>();
+        for (int index = 0; index < count; index++) {
+            if (buffer.remaining() < FrameSerializer.FRAME_ENTRY_HEADER_SIZE)
+                throw new MessageDeserializationException("Frame holds fewer messages than its count.");
+
+            int size = buffer.getInt();
+            if (size < 0 || size > buffer.remaining())
+                throw new MessageDeserializationException("Message goes past the end of the frame.");
+
+            byte[] message = new byte[size];
+            buffer.get(message);
+            messages.add(message);
+        }
+
+        if (buffer.hasRemaining())
+            throw new MessageDeserializationException("Bytes follow the last message of the frame.");
+
+        return messages;
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Microsoft. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+package com.microsoft.azure.gateway.remote;
+
+/**
+ * The limits of the message frames the Gateway offers in a Create message. A
+ * module accepts them by sending them back in its Create reply, after which
+ * both sides may pack several messages into one frame.
+ *
+ */
+class FrameLimits {
+
+    private final int maxMessages;
+    private final int maxBytes;
+    private final int lingerMillis;
+
+    public FrameLimits(int maxMessages, int maxBytes, int lingerMillis) {
+        this.maxMessages = maxMessages;
+        this.maxBytes = maxBytes;
+        this.lingerMillis = lingerMillis;
+    }
+
+    /**
+     * 
+     * @return The most messages in a frame
+     */
+    public int getMaxMessages() {
+        return this.maxMessages;
+    }
+
+    /**
+     * 
+     * @return The most bytes in a frame, header included
+     */
+    public int getMaxBytes() {
+        return this.maxBytes;
+    }
+
+    /**
+     * 
+     * @return The longest time in milliseconds a message may wait for a frame to fill
+     */
+    public int getLingerMillis() {
+        return this.lingerMillis;
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Microsoft. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+package com.microsoft.azure.gateway.remote;
+
+import java.nio.ByteBuffer;
+import java.util.List;
+
+/**
+ * Serializer for message frames, which carry several serialized messages in
+ * one message to the Gateway.
+ *
+ */
+class FrameSerializer {
+
+    // 0xA1 comes from (A)zure (I)oT
+    static final byte FIRST_FRAME_BYTE = (byte) 0xA1;
+    // 0x62 comes from (B)atch
+    static final byte SECOND_FRAME_BYTE = (byte) 0x62;
+    static final byte FRAME_VERSION = 1;
+    static final int FRAME_HEADER_SIZE = 11;
+    static final int FRAME_ENTRY_HEADER_SIZE = 4;
+
+    /**
+     * Serialize the messages into one frame, in order.
+     * 
+     * @param messages Serialized messages
+     * @return The frame
+     */
+    public byte[] serializeFrame(List<byte[]> messages) {
+        int totalSize = FRAME_HEADER_SIZE;
+        for (byte[] message : messages) {
+            totalSize += FRAME_ENTRY_HEADER_SIZE + message.length;
+        }
+
+        ByteBuffer dos = ByteBuffer.allocate(totalSize);
+
+        // Write Header
+        dos.put(FIRST_FRAME_BYTE);
+        dos.put(SECOND_FRAME_BYTE);
+        dos.put(FRAME_VERSION);
+        dos.putInt(totalSize);
+        dos.putInt(messages.size());
+
+        // Write content
+        for (byte[] message : messages) {
+            dos.putInt(message.length);
+            dos.put(message);
+        }
+
+        return dos.array();
+    }
+}
@@ -18,6 +18,7 @@ class MessageDeserializer {
     private static final byte SECOND_MESSAGE_BYTE = (byte) 0x6C;
     private static final byte BASE_MESSAGE_SIZE = 8;
     private static final byte BASE_CREATE_SIZE = BASE_MESSAGE_SIZE + 10;
+    private static final byte FRAME_LIMITS_SIZE = 12;
 
     /**
      * Deserializes the message and constructs a {@link ControlMessage}.
@@ -91,7 +92,7 @@ class MessageDeserializer {
         int argsSize = buffer.getInt();
         String moduleArgs = readNullTerminatedString(buffer, argsSize);
 
-        message = new CreateMessage(endpointConfig, moduleArgs, version);
+        message = new CreateMessage(endpointConfig, moduleArgs, version, readFrameLimits(buffer));
 
         return message;
     }
@@ -104,6 +105,24 @@ class MessageDeserializer {
         return new ControlMessage(RemoteMessageType.START);
     }
 
+    /**
+     * Frame limits are optional; without them, or with no room for any
+     * message, messages are sent one at a time. Any bytes that follow them are
+     * left for later versions of the message.
+     */
+    private static FrameLimits readFrameLimits(ByteBuffer buffer) {
+        if (buffer.remaining() < FRAME_LIMITS_SIZE)
+            return null;
+
+        int maxMessages = buffer.getInt();
+        int maxBytes = buffer.getInt();
+        int lingerMillis = buffer.getInt();
+        if (maxMessages <= 0 || maxBytes <= 0)
+            return null;
+
+        return new FrameLimits(maxMessages, maxBytes, Math.max(lingerMillis, 0));
+    }
+
     private static String readNullTerminatedString(ByteBuffer bis, int size) throws MessageDeserializationException {
         byte[] result = new byte[size - 1];
         int index = 0;
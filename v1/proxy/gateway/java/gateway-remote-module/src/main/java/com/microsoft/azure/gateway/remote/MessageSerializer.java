@@ -24,7 +24,19 @@ class MessageSerializer {
 	 * @return
 	 */
 	public byte[] serializeMessage(int status, byte version) {
-		byte[] array = new byte[9];
+		return this.serializeMessage(status, version, null);
+	}
+
+	/**
+	 * Serialize the control message with status and the version, followed by
+	 * the frame limits the module accepts
+	 * @param status Status to be send to the Gateway. {@see RemoteModuleReplyCode}
+	 * @param version Message version 
+	 * @param frameLimits Frame limits to send back, or null to send messages one at a time
+	 * @return
+	 */
+	public byte[] serializeMessage(int status, byte version, FrameLimits frameLimits) {
+		byte[] array = new byte[frameLimits == null ? 9 : 21];
 		ByteBuffer dos = ByteBuffer.wrap(array);
 
 		// Write Header
@@ -37,6 +49,11 @@ class MessageSerializer {
 
 		// Write content
 		dos.put((byte) status);
+		if (frameLimits != null) {
+			dos.putInt(frameLimits.getMaxMessages());
+			dos.putInt(frameLimits.getMaxBytes());
+			dos.putInt(frameLimits.getLingerMillis());
+		}
 
 		return dos.array();
 	}
@@ -151,6 +151,8 @@ public class ProxyGateway {
         private final Logger logger = LoggerFactory.getLogger(ProxyGateway.class);
         private CommunicationEndpoint controlEndpoint;
         private CommunicationEndpoint dataEndpoint;
+        private BrokerProxy broker;
+        private boolean framesAccepted;
         private IGatewayModule module;
 
         public MessageListener(ModuleConfiguration config) throws ConnectionException {
@@ -168,6 +170,7 @@ public class ProxyGateway {
         public void run() {
             this.executeControlMessage();
             this.executeDataMessage();
+            this.executeFrameLinger();
         }
 
         public void detach(boolean sendDetachToGateway) {
@@ -176,6 +179,8 @@ public class ProxyGateway {
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_031: [ It shall call module destroy. ]
                 this.module.destroy();
 
+            this.disconnectBroker();
+
             if (sendDetachToGateway) {
                 logger.info("Sending DETACH to the Gateway...");
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_032: [ It shall attempt to notify the Gateway of the detachment. ]
@@ -225,11 +230,17 @@ public class ProxyGateway {
                     try {
                         // Codes_SRS_JAVA_PROXY_GATEWAY_24_014: [ *Message Listener task* - If the message type is CREATE, it shall process the create message ]
                         this.processCreateMessage(message, this.controlEndpoint);
+                        FrameLimits frameLimits = ((CreateMessage) message).getFrameLimits();
                         // Codes_SRS_JAVA_PROXY_GATEWAY_24_020: [ *Message Listener task - Create message* - If the Create message finished processing, it shall send an ok message to the Gateway. ]
-                        boolean sent = sendControlReplyMessage(RemoteModuleReplyCode.OK.getValue());
+                        boolean sent = sendControlReplyMessage(RemoteModuleReplyCode.OK.getValue(), frameLimits);
                         // Codes_SRS_JAVA_PROXY_GATEWAY_24_021: [ *Message Listener task - Create message* - If ok message fails to be send to the Gateway, it shall do call module `destroy` and disconnect from message channel. ]
-                        if (!sent)
+                        if (!sent) {
                             this.disconnectDataMessage();
+                        } else if (frameLimits != null) {
+                            // Codes_SRS_JAVA_PROXY_GATEWAY_17_035: [ *Message Listener task - Create message* - If the Create message offered frame limits, the ok message shall send them back, and once it is sent, messages published by the module shall be sent in frames within those limits. ]
+                            this.broker.acceptFrames(frameLimits);
+                            this.framesAccepted = true;
+                        }
                     } catch (ConnectionException e) {
                         logger.error(e.toString());
                         this.sendControlReplyMessage(RemoteModuleReplyCode.CONNECTION_ERROR.getValue());
@@ -261,8 +272,17 @@ public class ProxyGateway {
                     RemoteMessage dataMessage = this.dataEndpoint.receiveMessage();
                     // Codes_SRS_JAVA_PROXY_GATEWAY_24_027: [ *Message Listener task - Data message* - If no data message is received or if an error occurs, it shall do nothing. ]
                     if (dataMessage != null) {
-                        // Codes_SRS_JAVA_PROXY_GATEWAY_24_026: [ *Message Listener task - Data message* - If data message is received, it shall forward it to the module by calling `receive` method. ]
-                        this.module.receive(((DataMessage) dataMessage).getContent());
+                        byte[] content = ((DataMessage) dataMessage).getContent();
+                        FrameDeserializer frameDeserializer = new FrameDeserializer();
+                        if (this.framesAccepted && frameDeserializer.isFrame(content)) {
+                            // Codes_SRS_JAVA_PROXY_GATEWAY_17_036: [ *Message Listener task - Data message* - If frames were accepted and the data message is a frame, it shall forward each message of the frame to the module, in order. ]
+                            for (byte[] frameMessage : frameDeserializer.deserializeFrame(content)) {
+                                this.module.receive(frameMessage);
+                            }
+                        } else {
+                            // Codes_SRS_JAVA_PROXY_GATEWAY_24_026: [ *Message Listener task - Data message* - If data message is received, it shall forward it to the module by calling `receive` method. ]
+                            this.module.receive(content);
+                        }
                     }
                 }
             } catch (ConnectionException e) {
@@ -272,6 +292,17 @@ public class ProxyGateway {
             }
         }
 
+        void executeFrameLinger() {
+            // Codes_SRS_JAVA_PROXY_GATEWAY_17_037: [ *Message Listener task* - It shall send the messages the module published once the first of them has waited for the linger time of the accepted frame limits. ]
+            if (this.broker != null) {
+                try {
+                    this.broker.flushExpired();
+                } catch (ConnectionException e) {
+                    logger.error(e.toString());
+                }
+            }
+        }
+
         private void processDestroyMessage() {
             this.detach(false);
         }
@@ -294,13 +325,14 @@ public class ProxyGateway {
             // Codes_SRS_JAVA_PROXY_GATEWAY_24_015: [ *Message Listener task - Create message* - Create message processing shall create the data message channel and connect to it. ]
             // Codes_SRS_JAVA_PROXY_GATEWAY_24_016: [ *Message Listener task - Create message* - If connection to the message channel fails, it shall send an error message to the Gateway. ]
             this.dataEndpoint = this.createDataEndpoints(controlMessage.getDataEndpoint());
+            this.broker = new BrokerProxy(this.dataEndpoint);
 
             try {
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_018: [ *Message Listener task - Create message* - Create message processing shall create a module instance and call `create` method. ]
-                this.createModuleInstanceWithArgsConstructor(controlMessage, this.dataEndpoint);
+                this.createModuleInstanceWithArgsConstructor(controlMessage, this.broker);
 
                 if (this.module == null) {
-                    this.createModuleInstanceNoArgsConstructor(controlMessage, this.dataEndpoint);
+                    this.createModuleInstanceNoArgsConstructor(controlMessage, this.broker);
                 }
             } catch (InstantiationException e) {
                 logger.error(e.toString());
@@ -326,13 +358,33 @@ public class ProxyGateway {
                 this.module.destroy();
                 this.module = null;
             }
+            this.disconnectBroker();
             if (this.dataEndpoint != null)
                 this.dataEndpoint.disconnect();
         }
 
+        private void disconnectBroker() {
+            if (this.broker != null) {
+                try {
+                    // Codes_SRS_JAVA_PROXY_GATEWAY_17_038: [ Before disconnecting from the message channel, it shall send the messages the module published that are still waiting for a frame. ]
+                    this.broker.flush();
+                } catch (ConnectionException e) {
+                    logger.error(e.toString());
+                }
+                this.broker = null;
+            }
+            this.framesAccepted = false;
+        }
+
         private boolean sendControlReplyMessage(int code) {
-            byte[] createCompletedMessage = new MessageSerializer().serializeMessage(code,
-                    this.controlEndpoint.getVersion());
+            return this.sendControlReplyMessage(code, null);
+        }
+
+        private boolean sendControlReplyMessage(int code, FrameLimits frameLimits) {
+            MessageSerializer serializer = new MessageSerializer();
+            byte[] createCompletedMessage = frameLimits == null
+                    ? serializer.serializeMessage(code, this.controlEndpoint.getVersion())
+                    : serializer.serializeMessage(code, this.controlEndpoint.getVersion(), frameLimits);
             boolean sent = false;
 
             try {
@@ -344,21 +396,21 @@ public class ProxyGateway {
         }
 
         private void createModuleInstanceNoArgsConstructor(CreateMessage controlMessage,
-                CommunicationEndpoint dataEndpoint) throws InstantiationException, IllegalAccessException {
+                Broker broker) throws InstantiationException, IllegalAccessException {
             final int emptyAddress = 0;
             this.module = this.config.getModuleClass().newInstance();
-            this.module.create(emptyAddress, new BrokerProxy(dataEndpoint), controlMessage.getArgs());
+            this.module.create(emptyAddress, broker, controlMessage.getArgs());
         }
 
         private void createModuleInstanceWithArgsConstructor(CreateMessage controlMessage,
-                CommunicationEndpoint dataEndpoint) throws InstantiationException, IllegalAccessException,
+                Broker broker) throws InstantiationException, IllegalAccessException,
                 IllegalArgumentException, InvocationTargetException {
             Class<? extends IGatewayModule> clazz = this.config.getModuleClass();
             final int emptyAddress = 0;
             try {
                 Constructor<? extends IGatewayModule> ctor = clazz.getDeclaredConstructor(long.class, Broker.class,
                         String.class);
-                this.module = ctor.newInstance(emptyAddress, new BrokerProxy(dataEndpoint), controlMessage.getArgs());
+                this.module = ctor.newInstance(emptyAddress, broker, controlMessage.getArgs());
             } catch (NoSuchMethodException e) {
                 logger.error(e.toString());
             }
@@ -5,7 +5,9 @@
 package com.microsoft.azure.gateway.remote;
 
 import java.io.IOException;
+import java.util.ArrayList;
 import java.util.HashMap;
+import java.util.List;
 
 import org.junit.Test;
 
@@ -13,6 +15,7 @@ import com.microsoft.azure.gateway.messaging.Message;
 
 import mockit.Expectations;
 import mockit.Mocked;
+import mockit.Verifications;
 
 public class BrokerProxyTest {
 
@@ -50,6 +53,84 @@ public class BrokerProxyTest {
         new BrokerProxy(communicationEndpoint).publishMessage(message, moduleAddr);
     }
     
+    @Test
+    public void publishMessageShouldSendFrameWhenFull() throws IOException, ConnectionException {
+        final Message message = new Message("Test".getBytes(), new HashMap<String, String>());
+        final List<byte[]> messages = new ArrayList<byte[]>();
+        messages.add(message.toByteArray());
+        messages.add(message.toByteArray());
+
+        BrokerProxy broker = new BrokerProxy(communicationEndpoint);
+        broker.acceptFrames(new FrameLimits(2, 4096, 60000));
+
+        long moduleAddr = 0;
+        broker.publishMessage(message, moduleAddr);
+        broker.publishMessage(message, moduleAddr);
+
+        new Verifications() {
+            {
+                communicationEndpoint.sendMessage(new FrameSerializer().serializeFrame(messages));
+                times = 1;
+            }
+        };
+    }
+
+    @Test
+    public void publishMessageShouldSendTooLargeMessageAlone() throws IOException, ConnectionException {
+        final Message message = new Message("Test".getBytes(), new HashMap<String, String>());
+
+        BrokerProxy broker = new BrokerProxy(communicationEndpoint);
+        broker.acceptFrames(new FrameLimits(2, 16, 60000));
+
+        long moduleAddr = 0;
+        broker.publishMessage(message, moduleAddr);
+
+        new Verifications() {
+            {
+                communicationEndpoint.sendMessage(message.toByteArray());
+                times = 1;
+            }
+        };
+    }
+
+    @Test
+    public void flushExpiredShouldWaitForLingerTime() throws IOException, ConnectionException {
+        final Message message = new Message("Test".getBytes(), new HashMap<String, String>());
+
+        BrokerProxy broker = new BrokerProxy(communicationEndpoint);
+        broker.acceptFrames(new FrameLimits(2, 4096, 60000));
+
+        long moduleAddr = 0;
+        broker.publishMessage(message, moduleAddr);
+        broker.flushExpired();
+
+        new Verifications() {
+            {
+                communicationEndpoint.sendMessage((byte[]) any);
+                times = 0;
+            }
+        };
+    }
+
+    @Test
+    public void flushShouldSendQueuedMessages() throws IOException, ConnectionException {
+        final Message message = new Message("Test".getBytes(), new HashMap<String, String>());
+
+        BrokerProxy broker = new BrokerProxy(communicationEndpoint);
+        broker.acceptFrames(new FrameLimits(2, 4096, 60000));
+
+        long moduleAddr = 0;
+        broker.publishMessage(message, moduleAddr);
+        broker.flush();
+
+        new Verifications() {
+            {
+                communicationEndpoint.sendMessage(message.toByteArray());
+                times = 1;
+            }
+        };
+    }
+
     @Test(expected=IllegalArgumentException.class)
     public void publishMessageShouldThrowIfEndpointIsNull() throws ConnectionException, IOException {
         final Message message = new Message("Test".getBytes(), new HashMap<String, String>());
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Microsoft. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+package com.microsoft.azure.gateway.remote;
+
+import static org.junit.Assert.*;
+
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Test;
+
+public class FrameDeserializerTest {
+
+    private static final byte[] FIRST_MESSAGE = new byte[] { (byte) 0xA1, (byte) 0x60, 1 };
+    private static final byte[] SECOND_MESSAGE = new byte[] {};
+
+    private static byte[] makeFrame() {
+        List<byte[]> messages = new ArrayList<byte[]>();
+        messages.add(FIRST_MESSAGE);
+        messages.add(SECOND_MESSAGE);
+        return new FrameSerializer().serializeFrame(messages);
+    }
+
+    @Test
+    public void isFrameShouldRecognizeFrame() {
+        assertTrue(new FrameDeserializer().isFrame(makeFrame()));
+    }
+
+    @Test
+    public void isFrameShouldNotRecognizeMessage() {
+        assertFalse(new FrameDeserializer().isFrame(FIRST_MESSAGE));
+    }
+
+    @Test
+    public void isFrameShouldNotRecognizeLaterVersion() {
+        byte[] frame = makeFrame();
+        frame[2] = 2;
+        assertFalse(new FrameDeserializer().isFrame(frame));
+    }
+
+    @Test
+    public void deserializationShouldReturnMessagesInOrder() throws MessageDeserializationException {
+        List<byte[]> messages = new FrameDeserializer().deserializeFrame(makeFrame());
+
+        assertEquals(2, messages.size());
+        assertArrayEquals(FIRST_MESSAGE, messages.get(0));
+        assertArrayEquals(SECOND_MESSAGE, messages.get(1));
+    }
+
+    @Test
+    public void deserializationShouldThrowIfInvalidHeader() {
+        try {
+            new FrameDeserializer().deserializeFrame(FIRST_MESSAGE);
+            fail();
+        } catch (MessageDeserializationException e) {
+            assertEquals("Invalid frame header.", e.getMessage());
+        }
+    }
+
+    @Test
+    public void deserializationShouldThrowIfInvalidFrameSize() {
+        byte[] frame = makeFrame();
+        byte[] truncated = new byte[frame.length - 1];
+        System.arraycopy(frame, 0, truncated, 0, truncated.length);
+        try {
+            new FrameDeserializer().deserializeFrame(truncated);
+            fail();
+        } catch (MessageDeserializationException e) {
+            assertEquals(String.format("Frame size in header %s is different that actual size %s", frame.length,
+                    truncated.length), e.getMessage());
+        }
+    }
+
+    @Test
+    public void deserializationShouldThrowIfMessageGoesPastFrame() {
+        byte[] frame = makeFrame();
+        frame[14] = 100;
+        try {
+            new FrameDeserializer().deserializeFrame(frame);
+            fail();
+        } catch (MessageDeserializationException e) {
+            assertEquals("Message goes past the end of the frame.", e.getMessage());
+        }
+    }
+
+    @Test
+    public void deserializationShouldThrowIfFewerMessagesThanCount() {
+        byte[] frame = makeFrame();
+        frame[10] = 3;
+        try {
+            new FrameDeserializer().deserializeFrame(frame);
+            fail();
+        } catch (MessageDeserializationException e) {
+            assertEquals("Frame holds fewer messages than its count.", e.getMessage());
+        }
+    }
+
+    @Test
+    public void deserializationShouldThrowIfBytesFollowLastMessage() {
+        byte[] frame = makeFrame();
+        frame[10] = 1;
+        try {
+            new FrameDeserializer().deserializeFrame(frame);
+            fail();
+        } catch (MessageDeserializationException e) {
+            assertEquals("Bytes follow the last message of the frame.", e.getMessage());
+        }
+    }
+}
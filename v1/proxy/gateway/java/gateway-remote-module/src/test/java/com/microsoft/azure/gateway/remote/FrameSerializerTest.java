@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Microsoft. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+package com.microsoft.azure.gateway.remote;
+
+import static org.junit.Assert.*;
+
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Test;
+
+public class FrameSerializerTest {
+
+    private static final byte[] FIRST_MESSAGE = new byte[] { (byte) 0xA1, (byte) 0x60, 1 };
+    private static final byte[] SECOND_MESSAGE = new byte[] { 2 };
+
+    @Test
+    public void serializeEmptyFrame() {
+        byte[] result = new FrameSerializer().serializeFrame(new ArrayList<byte[]>());
+
+        ByteBuffer buffer = ByteBuffer.wrap(result);
+        assertEquals((byte) 0xA1, buffer.get());
+        assertEquals((byte) 0x62, buffer.get());
+        assertEquals(1, buffer.get());
+        assertEquals(result.length, buffer.getInt());
+        assertEquals(0, buffer.getInt());
+        assertFalse(buffer.hasRemaining());
+    }
+
+    @Test
+    public void serializeMessagesInOrder() {
+        List<byte[]> messages = new ArrayList<byte[]>();
+        messages.add(FIRST_MESSAGE);
+        messages.add(SECOND_MESSAGE);
+        byte[] result = new FrameSerializer().serializeFrame(messages);
+
+        ByteBuffer buffer = ByteBuffer.wrap(result);
+        buffer.position(3);
+        assertEquals(result.length, buffer.getInt());
+        assertEquals(2, buffer.getInt());
+
+        byte[] first = new byte[buffer.getInt()];
+        buffer.get(first);
+        assertArrayEquals(FIRST_MESSAGE, first);
+
+        byte[] second = new byte[buffer.getInt()];
+        buffer.get(second);
+        assertArrayEquals(SECOND_MESSAGE, second);
+        assertFalse(buffer.hasRemaining());
+    }
+}
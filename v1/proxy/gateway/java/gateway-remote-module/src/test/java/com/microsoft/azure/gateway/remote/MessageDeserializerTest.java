@@ -5,6 +5,7 @@
 package com.microsoft.azure.gateway.remote;
 
 import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertNull;
 import static org.junit.Assert.assertTrue;
 
 import java.nio.ByteBuffer;
@@ -55,6 +56,61 @@ public class MessageDeserializerTest {
         assertEquals(VALID_URI_TYPE, createMessage.getDataEndpoint().getType());
         assertEquals(VALID_MESSAGE_VERSION, createMessage.getVersion());
         assertEquals(MODULE_ARGS.trim(), createMessage.getArgs());
+        assertNull(createMessage.getFrameLimits());
+    }
+
+    @Test
+    public void deserializationShouldReturnCreateMessageWithFrameLimits() throws MessageDeserializationException {
+        int size = 21 + DATA_MESSAGE_SOCKET_NAME.length() + MODULE_ARGS.length() + 12 + 4;
+        ByteBuffer createMessageBuffer = ByteBuffer.allocate(size);
+        createMessageBuffer.put(VALID_HEADER1);
+        createMessageBuffer.put(VALID_HEADER2);
+        createMessageBuffer.put(VALID_MESSAGE_VERSION);
+        createMessageBuffer.put(CREATE_MESSAGE_TYPE);
+        createMessageBuffer.putInt(size);
+        createMessageBuffer.put(VALID_MESSAGE_VERSION);
+        createMessageBuffer.put(VALID_URI_TYPE);
+        createMessageBuffer.putInt(DATA_MESSAGE_SOCKET_NAME.length());
+        createMessageBuffer.put(DATA_MESSAGE_SOCKET_NAME.getBytes());
+        createMessageBuffer.putInt(MODULE_ARGS.length());
+        createMessageBuffer.put(MODULE_ARGS.getBytes());
+        createMessageBuffer.putInt(3);
+        createMessageBuffer.putInt(4096);
+        createMessageBuffer.putInt(5);
+        // a credit window, which this module does not use
+        createMessageBuffer.putInt(8);
+
+        MessageDeserializer deserializer = new MessageDeserializer();
+        CreateMessage createMessage = (CreateMessage) deserializer.deserialize(createMessageBuffer, MESSAGE_VERSION);
+        FrameLimits frameLimits = createMessage.getFrameLimits();
+        assertEquals(MODULE_ARGS.trim(), createMessage.getArgs());
+        assertEquals(3, frameLimits.getMaxMessages());
+        assertEquals(4096, frameLimits.getMaxBytes());
+        assertEquals(5, frameLimits.getLingerMillis());
+    }
+
+    @Test
+    public void deserializationShouldIgnoreFrameLimitsWithoutRoomForMessages() throws MessageDeserializationException {
+        int size = 21 + DATA_MESSAGE_SOCKET_NAME.length() + MODULE_ARGS.length() + 12;
+        ByteBuffer createMessageBuffer = ByteBuffer.allocate(size);
+        createMessageBuffer.put(VALID_HEADER1);
+        createMessageBuffer.put(VALID_HEADER2);
+        createMessageBuffer.put(VALID_MESSAGE_VERSION);
+        createMessageBuffer.put(CREATE_MESSAGE_TYPE);
+        createMessageBuffer.putInt(size);
+        createMessageBuffer.put(VALID_MESSAGE_VERSION);
+        createMessageBuffer.put(VALID_URI_TYPE);
+        createMessageBuffer.putInt(DATA_MESSAGE_SOCKET_NAME.length());
+        createMessageBuffer.put(DATA_MESSAGE_SOCKET_NAME.getBytes());
+        createMessageBuffer.putInt(MODULE_ARGS.length());
+        createMessageBuffer.put(MODULE_ARGS.getBytes());
+        createMessageBuffer.putInt(0);
+        createMessageBuffer.putInt(0);
+        createMessageBuffer.putInt(0);
+
+        MessageDeserializer deserializer = new MessageDeserializer();
+        CreateMessage createMessage = (CreateMessage) deserializer.deserialize(createMessageBuffer, MESSAGE_VERSION);
+        assertNull(createMessage.getFrameLimits());
     }
 
     @Test
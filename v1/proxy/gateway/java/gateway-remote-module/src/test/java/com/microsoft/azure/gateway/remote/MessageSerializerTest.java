@@ -37,6 +37,25 @@ public class MessageSerializerTest {
         assertEquals(messageType, RemoteMessageType.REPLY.getValue());
         assertEquals(totalSize, buffer.limit());
         assertEquals(status, 1);
+        assertFalse(buffer.hasRemaining());
+    }
+
+    @Test
+    public void serializeShouldSendBackFrameLimits() {
+        MessageSerializer serializer = new MessageSerializer();
+        byte[] result = serializer.serializeMessage(STATUS, VERSION, new FrameLimits(3, 4096, 5));
+
+        ByteBuffer buffer = ByteBuffer.wrap(result);
+        buffer.position(4);
+        int totalSize = buffer.getInt();
+        byte status = buffer.get();
+
+        assertEquals(totalSize, buffer.limit());
+        assertEquals(status, 1);
+        assertEquals(3, buffer.getInt());
+        assertEquals(4096, buffer.getInt());
+        assertEquals(5, buffer.getInt());
+        assertFalse(buffer.hasRemaining());
     }
 
 }
@@ -8,6 +8,9 @@ import static org.junit.Assert.assertFalse;
 import static org.junit.Assert.assertNotNull;
 import static org.junit.Assert.assertTrue;
 
+import java.util.ArrayList;
+import java.util.List;
+
 import org.junit.BeforeClass;
 import org.junit.Test;
 
@@ -31,6 +34,8 @@ public class ProxyGatewayTest {
     private final ControlMessage destroyMessage = new ControlMessage(RemoteMessageType.DESTROY);
     private final byte[] content = new byte[] { (byte) 0xA1, (byte) 0x60 };
     private final DataMessage dataMessage = new DataMessage(content);
+    private final FrameLimits frameLimits = new FrameLimits(2, 4096, 5);
+    private final CreateMessage framedCreateMessage = new CreateMessage(endpointsConfig, args, version, frameLimits);
 
     @BeforeClass
     public static void setUp() {
@@ -1036,6 +1041,69 @@ public class ProxyGatewayTest {
         assertTrue(proxy.isAttached());
     }
 
+    // Tests_SRS_JAVA_PROXY_GATEWAY_17_035: [ *Message Listener task - Create message* - If the Create message offered frame limits, the ok message shall send them back, and once it is sent, messages published by the module shall be sent in frames within those limits. ]
+    // Tests_SRS_JAVA_PROXY_GATEWAY_17_036: [ *Message Listener task - Data message* - If frames were accepted and the data message is a frame, it shall forward each message of the frame to the module, in order. ]
+    @Test
+    public void attachShouldReceiveFramedDataMessages(@Mocked final NanomsgCommunicationEndpoint controlEndpoint,
+            @Mocked final NanomsgCommunicationEndpoint dataEndpoint, @Mocked final TestModuleImplementsInterface module,
+            @Mocked final MessageSerializer serializer) throws ConnectionException, MessageDeserializationException {
+
+        final ProxyGateway proxy = new ProxyGateway(config);
+        final List<byte[]> messages = new ArrayList<byte[]>();
+        messages.add(content);
+        messages.add(content);
+        final DataMessage frameMessage = new DataMessage(new FrameSerializer().serializeFrame(messages));
+
+        new Expectations(ProxyGateway.class) {
+            {
+                proxy.startListening();
+            }
+        };
+        new Expectations() {
+            {
+                new NanomsgCommunicationEndpoint(config.getIdentifier(), (CommunicationControlStrategy) any);
+                result = controlEndpoint;
+                new NanomsgCommunicationEndpoint(dataSocketId, (CommunicationDataStrategy) any);
+                result = dataEndpoint;
+
+                new TestModuleImplementsInterface();
+                result = module;
+
+                controlEndpoint.connect();
+                controlEndpoint.receiveMessage();
+                returns(framedCreateMessage, startMessage);
+                controlEndpoint.sendMessageNoWait((byte[]) any);
+                result = true;
+
+                serializer.serializeMessage(RemoteModuleReplyCode.OK.getValue(), anyByte, frameLimits);
+
+                dataEndpoint.connect();
+                dataEndpoint.receiveMessage();
+                returns(null, frameMessage);
+            }
+        };
+
+        proxy.attach();
+        ProxyGateway.MessageListener receiveMessage = proxy.getReceiveMessageListener();
+        receiveMessage.executeControlMessage();
+        receiveMessage.executeDataMessage();
+
+        receiveMessage.executeControlMessage();
+        receiveMessage.executeDataMessage();
+
+        new Verifications() {
+            {
+                serializer.serializeMessage(RemoteModuleReplyCode.OK.getValue(), anyByte, frameLimits);
+                times = 1;
+
+                module.receive(content);
+                times = 2;
+            }
+        };
+
+        assertTrue(proxy.isAttached());
+    }
+
     // Tests_SRS_JAVA_PROXY_GATEWAY_24_028: [ If not attached the function shall do nothing and return. ]
     @Test
     public void detachNoOpIfNotAttached() throws ConnectionException, MessageDeserializationException {
@@ -4,6 +4,8 @@
 #ifndef REMOTE_MODULE_H
 #define REMOTE_MODULE_H
 
+#include <stddef.h>
+
 #include "azure_c_shared_utility/macro_utils.h"
 
 #include "gateway_export.h"
@@ -15,6 +17,13 @@
 
 typedef struct REMOTE_MODULE_TAG * REMOTE_MODULE_HANDLE;
 
+/*!
+ * \brief The longest the worker thread waits for the gateway before checking
+ *        whether it was asked to halt, unless `ProxyGateway_SetWorkOptions`
+ *        sets another.
+ */
+#define PROXY_GATEWAY_DEFAULT_WAIT_MS 100
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 /*!
@@ -55,9 +64,10 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, ProxyGateway_Detach, REMOTE_MODULE_HAND
  * `ProxyGateway_DoWork` is intended to provide the caller with fine-grain control of work
  * scheduling, and is provided as an alternative to calling `ProxyGateway_StartWorkerThread`.
  * `ProxyGateway_DoWork` is a non-blocking call, wherein each call will check for one message
- * on the command and each message channel connected to the Azure IoT Gateway. In other
- * words, if multiple messages are queued on a single channel, only the first message of
- * each channel will be serviced. If the message is intended for the remote module (as
+ * on the command channel, and up to `max_messages` (see `ProxyGateway_SetWorkOptions`,
+ * one by default) on the message channel connected to the Azure IoT Gateway. In other
+ * words, if more messages are queued on a channel, the remaining ones are serviced by
+ * the following calls. If the message is intended for the remote module (as
  * opposed to the ProxyGateway library itself), the ProxyGateway library will pass it along
  * by calling `Module_Receive` on the remote module.
  *
@@ -93,6 +103,9 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_HaltWorkerThread, REMOTE_MO
  * has been invoked, then the ProxyGateway library will create a thread to service and deliver
  * messages from the Azure IoT Gateway to the remote module.
  *
+ * The worker thread sleeps in `nn_poll` on the control and message channels until the
+ * Azure IoT Gateway sends a message, so an idle remote module uses no CPU.
+ *
  * \param remote_module [in] The handle of the remote module you wish to detach from
  *                           the Azure IoT Gateway.
  *
@@ -100,6 +113,26 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_HaltWorkerThread, REMOTE_MO
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_StartWorkerThread, REMOTE_MODULE_HANDLE, remote_module);
 
+/*!
+ * \brief Tune how a given remote module waits for and drains its messages
+ *
+ * `ProxyGateway_SetWorkOptions` sets how long the worker thread waits for a message
+ * before checking whether it was asked to halt, and how many messages each call to
+ * `ProxyGateway_DoWork` may pass to the remote module. A longer wait means fewer idle
+ * wakeups, but `ProxyGateway_HaltWorkerThread` may take that long to return; the wait
+ * is cut to the linger time of the frames the remote module sends, if any. Draining
+ * several messages per call costs fewer wakeups under load.
+ *
+ * \param remote_module [in] The handle of the remote module to tune.
+ * \param wait_ms [in] The longest the worker thread waits for a message, in milliseconds
+ *                     (`PROXY_GATEWAY_DEFAULT_WAIT_MS` by default).
+ * \param max_messages [in] The most messages or frames passed to the remote module by each
+ *                          call to `ProxyGateway_DoWork`, at least 1 (1 by default).
+ *
+ * \return A result value. 0 indicating success or failure otherwise
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_SetWorkOptions, REMOTE_MODULE_HANDLE, remote_module, unsigned int, wait_ms, size_t, max_messages);
+
 #ifdef __cplusplus
   }
 #endif
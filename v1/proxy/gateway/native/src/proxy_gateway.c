@@ -4,6 +4,7 @@
 #include "proxy_gateway.h"
 #include "broker.h"
 
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,11 +15,15 @@
 #include <azure_c_shared_utility/gballoc.h>
 #include <azure_c_shared_utility/lock.h>
 #include <azure_c_shared_utility/threadapi.h>
+#include <azure_c_shared_utility/tickcounter.h>
 #include <azure_c_shared_utility/xlogging.h>
 
 #include "control_message.h"
 #include "gateway.h"
+#include "gateway_atomic.h"
 #include "message.h"
+#include "message_batch.h"
+#include "shared_memory_channel.h"
 
 typedef enum REMOTE_MODULE_RESULT_TAG {
     REMOTE_MODULE_DETACH = -1,
@@ -40,6 +45,22 @@ disconnect_from_message_channel (
     REMOTE_MODULE_HANDLE remote_module
 );
 
+void
+open_message_batch (
+    REMOTE_MODULE_HANDLE remote_module,
+    const MESSAGE_BATCH_LIMITS * offered_limits
+);
+
+void
+close_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
+int
+flush_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
 int
 invoke_add_module_procedure (
     REMOTE_MODULE_HANDLE remote_module,
@@ -58,6 +79,17 @@ send_control_reply (
     uint8_t response
 );
 
+int
+send_control_credit (
+    REMOTE_MODULE_HANDLE remote_module,
+    uint32_t credits
+);
+
+void
+wait_and_do_work (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
 int
 worker_thread(
     void * thread_arg
@@ -74,10 +106,33 @@ typedef struct REMOTE_MODULE_TAG {
 	int control_socket;
     int message_endpoint;
     int message_socket;
+    SHARED_MEMORY_CHANNEL_HANDLE message_channel;
     MESSAGE_THREAD_HANDLE message_thread;
     MODULE module;
+    MESSAGE_BATCH_LIMITS batch_limits;
+    MESSAGE_BATCH_HANDLE batch;
+    LOCK_HANDLE batch_lock;
+    TICK_COUNTER_HANDLE tick_counter;
+    tickcounter_ms_t batch_started;
+    uint32_t credit_window;
+    GATEWAY_ATOMIC_U32 send_credits;
+    uint32_t received_since_credit;
+    uint8_t message_version;
+    uint8_t gateway_max_message_version;
+    unsigned int wait_ms;
+    size_t max_messages;
+    GATEWAY_ATOMIC_U32 publishers;
 } REMOTE_MODULE;
 
+/* Set in REMOTE_MODULE::publishers, next to the count of Broker_Publish calls using the message channel, while the channel is closed */
+#define PUBLISHERS_STOPPED 0x80000000u
+
+/* A frame waits for room on the message channel in slices this long, so it notices the channel closing */
+#define FRAME_SEND_WAIT_MS 10
+
+/* Once the message channel starts closing, a frame waits at most this much longer for room before it is dropped */
+#define FRAME_CLOSING_WAIT_MS 1000
+
 static size_t strnlen_(const char* s, size_t max)
 {
     if (!s) return 0;
@@ -107,6 +162,12 @@ static int nn_really_shutdown(int s, int how)
     return result;
 }
 
+/* Releases a message channel buffer handed over to a module message */
+static void nn_release_module_message(void * module_message)
+{
+    (void)nn_freemsg(module_message);
+}
+
 static int nn_really_send(int s, const void* buf, size_t len, int flags)
 {
     int result;
@@ -117,6 +178,183 @@ static int nn_really_send(int s, const void* buf, size_t len, int flags)
     return result;
 }
 
+/* Takes the credit to send one message to the gateway; there is always one without flow control */
+static bool take_send_credit(REMOTE_MODULE_HANDLE remote_module)
+{
+    bool result;
+    if (0 == remote_module->credit_window) {
+        result = true;
+    } else {
+        uint32_t credits;
+        do {
+            credits = gateway_atomic_load(&remote_module->send_credits);
+        } while (0 != credits && !gateway_atomic_compare_exchange(&remote_module->send_credits, credits, credits - 1));
+        result = (0 != credits);
+    }
+    return result;
+}
+
+/* Adds credits granted by the gateway, never holding more than the window */
+static void add_send_credits(REMOTE_MODULE_HANDLE remote_module, uint32_t credits)
+{
+    if (0 != remote_module->credit_window) {
+        uint32_t current;
+        uint32_t next;
+        do {
+            current = gateway_atomic_load(&remote_module->send_credits);
+            next = (credits >= remote_module->credit_window - current) ? remote_module->credit_window : current + credits;
+        } while (!gateway_atomic_compare_exchange(&remote_module->send_credits, current, next));
+    }
+}
+
+/* Counts a Broker_Publish call in, unless the message channel is being closed */
+static bool enter_publisher(REMOTE_MODULE_HANDLE remote_module)
+{
+    bool result;
+    if (0 != (gateway_atomic_increment(&remote_module->publishers) & PUBLISHERS_STOPPED)) {
+        (void)gateway_atomic_decrement(&remote_module->publishers);
+        result = false;
+    } else {
+        result = true;
+    }
+    return result;
+}
+
+static void leave_publisher(REMOTE_MODULE_HANDLE remote_module)
+{
+    (void)gateway_atomic_decrement(&remote_module->publishers);
+}
+
+/* Returns true once the message channel has started closing */
+static bool publishers_stopping(REMOTE_MODULE_HANDLE remote_module)
+{
+    return (0 != (gateway_atomic_load(&remote_module->publishers) & PUBLISHERS_STOPPED));
+}
+
+/* Turns new publishers away and waits for those using the message channel to leave; returns false if they were already stopped */
+static bool stop_publishers(REMOTE_MODULE_HANDLE remote_module)
+{
+    uint32_t current;
+    do {
+        current = gateway_atomic_load(&remote_module->publishers);
+    } while (!gateway_atomic_compare_exchange(&remote_module->publishers, current, current | PUBLISHERS_STOPPED));
+    while (PUBLISHERS_STOPPED != gateway_atomic_load(&remote_module->publishers)) {
+        ThreadAPI_Sleep(1);
+    }
+    return (0 == (current & PUBLISHERS_STOPPED));
+}
+
+static void resume_publishers(REMOTE_MODULE_HANDLE remote_module)
+{
+    uint32_t current;
+    do {
+        current = gateway_atomic_load(&remote_module->publishers);
+    } while (!gateway_atomic_compare_exchange(&remote_module->publishers, current, current & ~PUBLISHERS_STOPPED));
+}
+
+/* Grants the gateway credits for the messages passed to the module, once they make up half the window */
+static void grant_received_credits(REMOTE_MODULE_HANDLE remote_module)
+{
+    if (0 != remote_module->credit_window && remote_module->received_since_credit >= (remote_module->credit_window + 1) / 2) {
+        /* Codes_SRS_PROXY_GATEWAY_17_022: [Message Channel - Once the module has received at least half the credit window since the last grant, `ProxyGateway_DoWork` shall grant that many credits back to the gateway by calling `send_control_credit`, and try again on its next call if that fails] */
+        if (0 == send_control_credit(remote_module, remote_module->received_since_credit)) {
+            remote_module->received_since_credit = 0;
+        }
+    }
+}
+
+/* Passes one message, copied from a buffer received from the gateway, to the module */
+static void deliver_framed_message(void * context, const unsigned char * source, int32_t size)
+{
+    REMOTE_MODULE_HANDLE remote_module = (REMOTE_MODULE_HANDLE)context;
+    MESSAGE_HANDLE structured_module_message;
+
+    // Every message took a credit from the gateway, whether or not it can be parsed
+    remote_module->received_since_credit++;
+
+    if (NULL == (structured_module_message = Message_CreateFromByteArray(source, size))) {
+        LogError("%s: Unable to parse framed module message!", __FUNCTION__);
+    } else {
+        ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
+        Message_Destroy(structured_module_message);
+    }
+}
+
+/* Passes the oldest buffer of a shared memory message channel, if any, to the module; returns false once none is left */
+static bool receive_shared_memory_message(REMOTE_MODULE_HANDLE remote_module, int timeout_ms)
+{
+    bool result;
+    const unsigned char * module_message;
+    int32_t bytes_received;
+    SHARED_MEMORY_CHANNEL_RESULT receive_result;
+
+    /* Codes_SRS_PROXY_GATEWAY_17_015: [Message Channel - If the message channel is shared memory, `ProxyGateway_DoWork` shall poll it by calling `SHARED_MEMORY_CHANNEL_RESULT SharedMemoryChannel_Receive(SHARED_MEMORY_CHANNEL_HANDLE channel, const unsigned char ** buf, int32_t * size, int timeout_ms)` with 0 for `timeout_ms`] */
+    if (SHARED_MEMORY_CHANNEL_OK != (receive_result = SharedMemoryChannel_Receive(remote_module->message_channel, &module_message, &bytes_received, timeout_ms))) {
+        if (SHARED_MEMORY_CHANNEL_TIMEOUT != receive_result) {
+            LogError("%s: Unexpected error received from the message channel!", __FUNCTION__);
+        }
+        result = false;
+    } else {
+        /* Codes_SRS_PROXY_GATEWAY_17_016: [Message Channel - `ProxyGateway_DoWork` shall copy a buffer received on a shared memory message channel into messages by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)`, or unpack it if it is an accepted frame, pass them to the module, then give the buffer back by calling `void SharedMemoryChannel_Release(SHARED_MEMORY_CHANNEL_HANDLE channel)`] */
+        if (0 != remote_module->batch_limits.max_messages && MessageBatch_IsFrame(module_message, bytes_received)) {
+            if (0 != MessageBatch_ForEachMessage(module_message, bytes_received, deliver_framed_message, remote_module)) {
+                LogError("%s: Received a malformed frame!", __FUNCTION__);
+            }
+        } else {
+            deliver_framed_message(remote_module, module_message, bytes_received);
+        }
+        SharedMemoryChannel_Release(remote_module->message_channel);
+        result = true;
+    }
+
+    return result;
+}
+
+/* Passes the next message or frame of the message socket, if any, to the module; returns false once none is left */
+static bool receive_socket_message(REMOTE_MODULE_HANDLE remote_module)
+{
+    bool result;
+    int32_t bytes_received;
+    void * module_message = NULL;
+
+    /* Codes_SRS_PROXY_GATEWAY_027_038: [Message Channel - `ProxyGateway_DoWork` shall poll the gateway message channel by calling `int nn_recv(int s, void * buf, size_t len, int flags)` with each message socket for `s`, `NULL` for `buf`, `NN_MSG` for `len` and NN_DONTWAIT for `flags`] */
+    if (0 > (bytes_received = nn_recv(remote_module->message_socket, &module_message, NN_MSG, NN_DONTWAIT))) {
+        /* Codes_SRS_PROXY_GATEWAY_027_039: [Message Channel - If no message is available or an error occurred, then `ProxyGateway_DoWork` shall abandon the message channel request] */
+        if (EAGAIN == nn_errno()) {
+            // no messages available at this time
+        } else {
+            LogError("%s: Unexpected error received from the message channel!", __FUNCTION__);
+        }
+        result = false;
+    } else if (0 != remote_module->batch_limits.max_messages && MessageBatch_IsFrame((const unsigned char *)module_message, bytes_received)) {
+        /* Codes_SRS_PROXY_GATEWAY_17_003: [Message Channel - If frames were accepted and the received buffer is a frame, then `ProxyGateway_DoWork` shall create each message of the frame by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)`, pass it to the module by calling `Module_Receive`, destroy it, and free the buffer by calling `nn_freemsg`] */
+        if (0 != MessageBatch_ForEachMessage((const unsigned char *)module_message, bytes_received, deliver_framed_message, remote_module)) {
+            LogError("%s: Received a malformed frame!", __FUNCTION__);
+        }
+        (void)nn_freemsg(module_message);
+        result = true;
+    } else {
+        MESSAGE_HANDLE structured_module_message;
+
+        remote_module->received_since_credit++;
+        /* Codes_SRS_PROXY_GATEWAY_027_040: [Message Channel - If a module message was received, then `ProxyGateway_DoWork` will parse that message by calling `MESSAGE_HANDLE Message_CreateFromOwnedByteArray(const unsigned char * source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void * context)` with the buffer received from `nn_recv` as `source` and `context`, return value from `nn_recv` as `size` and a function calling `nn_freemsg` as `release`] */
+        if (NULL == (structured_module_message = Message_CreateFromOwnedByteArray((const unsigned char *)module_message, bytes_received, nn_release_module_message, module_message))) {
+            /* Codes_SRS_PROXY_GATEWAY_027_041: [Message Channel - If unable to parse the module message, then `ProxyGateway_DoWork` shall free any previously allocated memory and abandon the message channel request] */
+            LogError("%s: Unable to parse control message!", __FUNCTION__);
+            /* Codes_SRS_PROXY_GATEWAY_027_044: [Message Channel - If unable to parse the module message, `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`; otherwise the parsed message owns the buffer] */
+            (void)nn_freemsg(module_message);
+        } else {
+            /* Codes_SRS_PROXY_GATEWAY_027_042: [Message Channel - `ProxyGateway_DoWork` shall pass the structured message to the module by calling `void Module_Receive(MODULE_HANDLE moduleHandle)` using the parsed message as `moduleHandle`] */
+            ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
+            /* Codes_SRS_PROXY_GATEWAY_027_043: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed module message by calling `void Message_Destroy(MESSAGE_HANDLE * message)` using the parsed module message as `message`] */
+            Message_Destroy(structured_module_message);
+        }
+        result = true;
+    }
+
+    return result;
+}
+
 REMOTE_MODULE_HANDLE
 ProxyGateway_Attach (
     const MODULE_API * module_apis,
@@ -197,6 +435,10 @@ ProxyGateway_Attach (
                 // Initialize remaining fields
                 remote_module->message_socket = -1;
                 remote_module->message_endpoint = -1;
+                remote_module->message_channel = NULL;
+                remote_module->wait_ms = PROXY_GATEWAY_DEFAULT_WAIT_MS;
+                remote_module->max_messages = 1;
+                remote_module->message_version = GATEWAY_MESSAGE_VERSION_1;
             }
         }
         /* Codes_SRS_PROXY_GATEWAY_027_015: [`ProxyGateway_Attach` shall release the memory required to formulate the connection string] */
@@ -249,97 +491,113 @@ ProxyGateway_Detach (
 }
 
 
-void
-ProxyGateway_DoWork (
-    REMOTE_MODULE_HANDLE remote_module
-) {
-    if (NULL == remote_module) {
-        /* Codes_SRS_PROXY_GATEWAY_027_026: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_DoWork` shall do nothing] */
-        LogError("%s: NULL parameter - remote_module!", __FUNCTION__);
+/* Receives from the gateway, waiting up to message_wait_ms for the first message of a shared memory channel */
+static void do_work(REMOTE_MODULE_HANDLE remote_module, int message_wait_ms)
+{
+    int32_t bytes_received;
+    void * control_message = NULL;
+
+    /* Codes_SRS_PROXY_GATEWAY_027_027: [Control Channel - `ProxyGateway_DoWork` shall poll the gateway control channel by calling `int nn_recv(int s, void * buf, size_t len, int flags)` with the control socket for `s`, `NULL` for `buf`, `NN_MSG` for `len` and NN_DONTWAIT for `flags`] */
+    if (0 > (bytes_received = nn_recv(remote_module->control_socket, &control_message, NN_MSG, NN_DONTWAIT))) {
+        if (EAGAIN == nn_errno()) {
+            /* Codes_SRS_PROXY_GATEWAY_027_028: [Control Channel - If no message is available, then `ProxyGateway_DoWork` shall abandon the control channel request] */
+        } else {
+            /* Codes_SRS_PROXY_GATEWAY_027_066: [Control Channel - If an error occurred when polling the gateway, then `ProxyGateway_DoWork` shall signal the gateway abandon the control channel request] */
+            LogError("%s: Unexpected error received from the control channel!", __FUNCTION__);
+            (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
+        }
     } else {
-        int32_t bytes_received;
-        void * control_message = NULL;
+        CONTROL_MESSAGE * structured_control_message;
 
-        /* Codes_SRS_PROXY_GATEWAY_027_027: [Control Channel - `ProxyGateway_DoWork` shall poll the gateway control channel by calling `int nn_recv(int s, void * buf, size_t len, int flags)` with the control socket for `s`, `NULL` for `buf`, `NN_MSG` for `len` and NN_DONTWAIT for `flags`] */
-        if (0 > (bytes_received = nn_recv(remote_module->control_socket, &control_message, NN_MSG, NN_DONTWAIT))) {
-            if (EAGAIN == nn_errno()) {
-                /* Codes_SRS_PROXY_GATEWAY_027_028: [Control Channel - If no message is available, then `ProxyGateway_DoWork` shall abandon the control channel request] */
-            } else {
-                /* Codes_SRS_PROXY_GATEWAY_027_066: [Control Channel - If an error occurred when polling the gateway, then `ProxyGateway_DoWork` shall signal the gateway abandon the control channel request] */
-                LogError("%s: Unexpected error received from the control channel!", __FUNCTION__);
-                (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
-            }
+        /* Codes_SRS_PROXY_GATEWAY_027_029: [Control Channel - If a control message was received, then `ProxyGateway_DoWork` will parse that message by calling `CONTROL_MESSAGE * ControlMessage_CreateFromByteArray(const unsigned char * source, size_t size)` with the buffer received from `nn_recv` as `source` and return value from `nn_recv` as `size`] */
+        if (NULL == (structured_control_message = ControlMessage_CreateFromByteArray((const unsigned char *)control_message, bytes_received))) {
+            /* Codes_SRS_PROXY_GATEWAY_027_030: [Control Channel - If unable to parse the control message, then `ProxyGateway_DoWork` shall signal the gateway, free any previously allocated memory and abandon the control channel request] */
+            LogError("%s: Unable to parse control message!", __FUNCTION__);
+            (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
         } else {
-            CONTROL_MESSAGE * structured_control_message;
+            // Route control channel messages to appropriate functions
+            switch (structured_control_message->type) {
+              case CONTROL_MESSAGE_TYPE_MODULE_CREATE:
+                /* Codes_SRS_PROXY_GATEWAY_027_031: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_CREATE, then `ProxyGateway_DoWork` shall process the create message] */
+                if (0 != process_module_create_message(remote_module, (const CONTROL_MESSAGE_MODULE_CREATE *)structured_control_message)) {
+                    LogError("%s: Unable to process create message!", __FUNCTION__);
+                }
+                break;
+              case CONTROL_MESSAGE_TYPE_MODULE_START:
+                /* Codes_SRS_PROXY_GATEWAY_027_032: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_START and `Module_Start` was provided, then `ProxyGateway_DoWork` shall call `void Module_Start(MODULE_HANDLE moduleHandle)`] */
+                if (((MODULE_API_1 *)remote_module->module.module_apis)->Module_Start) {
+                    ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Start(remote_module->module.module_handle);
+                }
+                break;
+              case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
+                /* Codes_SRS_PROXY_GATEWAY_027_033: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_DESTROY, then `ProxyGateway_DoWork` shall call `void Module_Destroy(MODULE_HANDLE moduleHandle)`] */
+                ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Destroy(remote_module->module.module_handle);
+                remote_module->module.module_handle = NULL;
+                /* Codes_SRS_PROXY_GATEWAY_027_034: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_DESTROY, then `ProxyGateway_DoWork` shall disconnect from the message channel] */
+                disconnect_from_message_channel(remote_module);
+                break;
+              case CONTROL_MESSAGE_TYPE_MODULE_CREDIT:
+                /* Codes_SRS_PROXY_GATEWAY_17_021: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_CREDIT, then `ProxyGateway_DoWork` shall add its credits to those the module may use to publish, up to the credit window] */
+                add_send_credits(remote_module, ((const CONTROL_MESSAGE_MODULE_CREDIT *)structured_control_message)->credits);
+                break;
+              default: LogError("ERROR: REMOTE_MODULE - Received unsupported message type! [%d]\n", structured_control_message->type); break;
+            }
+            /* Codes_SRS_PROXY_GATEWAY_027_035: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed control message by calling `void ControlMessage_Destroy(CONTROL_MESSAGE * message)` using the parsed control message as `message`] */
+            ControlMessage_Destroy(structured_control_message);
+        }
+        /* Codes_SRS_PROXY_GATEWAY_027_036: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
+        (void)nn_freemsg(control_message);
+    }
 
-            /* Codes_SRS_PROXY_GATEWAY_027_029: [Control Channel - If a control message was received, then `ProxyGateway_DoWork` will parse that message by calling `CONTROL_MESSAGE * ControlMessage_CreateFromByteArray(const unsigned char * source, size_t size)` with the buffer received from `nn_recv` as `source` and return value from `nn_recv` as `size`] */
-            if (NULL == (structured_control_message = ControlMessage_CreateFromByteArray((const unsigned char *)control_message, bytes_received))) {
-                /* Codes_SRS_PROXY_GATEWAY_027_030: [Control Channel - If unable to parse the control message, then `ProxyGateway_DoWork` shall signal the gateway, free any previously allocated memory and abandon the control channel request] */
-                LogError("%s: Unable to parse control message!", __FUNCTION__);
-                (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
+    /* Codes_SRS_PROXY_GATEWAY_027_037: [Message Channel - `ProxyGateway_DoWork` shall not check for messages, if the message socket is not available] */
+    if ( 0 > remote_module->message_socket && NULL == remote_module->message_channel ) {
+        // not connected to message channel
+    } else {
+        size_t received;
+
+        /* Codes_SRS_PROXY_GATEWAY_17_024: [Message Channel - `ProxyGateway_DoWork` shall pass up to the set number of messages or frames to the module, stopping early once none is left] */
+        for (received = 0; received < remote_module->max_messages; ++received) {
+            bool more;
+            if (NULL != remote_module->message_channel) {
+                more = receive_shared_memory_message(remote_module, (0 == received) ? message_wait_ms : 0);
             } else {
-                // Route control channel messages to appropriate functions
-                switch (structured_control_message->type) {
-                  case CONTROL_MESSAGE_TYPE_MODULE_CREATE:
-                    /* Codes_SRS_PROXY_GATEWAY_027_031: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_CREATE, then `ProxyGateway_DoWork` shall process the create message] */
-                    if (0 != process_module_create_message(remote_module, (const CONTROL_MESSAGE_MODULE_CREATE *)structured_control_message)) {
-                        LogError("%s: Unable to process create message!", __FUNCTION__);
-                    }
-                    break;
-                  case CONTROL_MESSAGE_TYPE_MODULE_START:
-                    /* Codes_SRS_PROXY_GATEWAY_027_032: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_START and `Module_Start` was provided, then `ProxyGateway_DoWork` shall call `void Module_Start(MODULE_HANDLE moduleHandle)`] */
-                    if (((MODULE_API_1 *)remote_module->module.module_apis)->Module_Start) {
-                        ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Start(remote_module->module.module_handle);
-                    }
-                    break;
-                  case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
-                    /* Codes_SRS_PROXY_GATEWAY_027_033: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_DESTROY, then `ProxyGateway_DoWork` shall call `void Module_Destroy(MODULE_HANDLE moduleHandle)`] */
-                    ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Destroy(remote_module->module.module_handle);
-                    remote_module->module.module_handle = NULL;
-                    /* Codes_SRS_PROXY_GATEWAY_027_034: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_DESTROY, then `ProxyGateway_DoWork` shall disconnect from the message channel] */
-                    disconnect_from_message_channel(remote_module);
-                    break;
-                  default: LogError("ERROR: REMOTE_MODULE - Received unsupported message type! [%d]\n", structured_control_message->type); break;
-                }
-                /* Codes_SRS_PROXY_GATEWAY_027_035: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed control message by calling `void ControlMessage_Destroy(CONTROL_MESSAGE * message)` using the parsed control message as `message`] */
-                ControlMessage_Destroy(structured_control_message);
+                more = receive_socket_message(remote_module);
+            }
+            if (!more) {
+                break;
             }
-            /* Codes_SRS_PROXY_GATEWAY_027_036: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
-            (void)nn_freemsg(control_message);
         }
 
-        /* Codes_SRS_PROXY_GATEWAY_027_037: [Message Channel - `ProxyGateway_DoWork` shall not check for messages, if the message socket is not available] */
-        if ( 0 > remote_module->message_socket ) {
-            // not connected to message channel
-        } else {
-            void * module_message = NULL;
-
-            /* Codes_SRS_PROXY_GATEWAY_027_038: [Message Channel - `ProxyGateway_DoWork` shall poll the gateway message channel by calling `int nn_recv(int s, void * buf, size_t len, int flags)` with each message socket for `s`, `NULL` for `buf`, `NN_MSG` for `len` and NN_DONTWAIT for `flags`] */
-            if (0 > (bytes_received = nn_recv(remote_module->message_socket, &module_message, NN_MSG, NN_DONTWAIT))) {
-                /* Codes_SRS_PROXY_GATEWAY_027_039: [Message Channel - If no message is available or an error occurred, then `ProxyGateway_DoWork` shall abandon the message channel request] */
-                if (EAGAIN == nn_errno()) {
-                    // no messages available at this time
-                } else {
-                    LogError("%s: Unexpected error received from the message channel!", __FUNCTION__);
-                }
+        grant_received_credits(remote_module);
+
+        if (NULL != remote_module->batch) {
+            /* Codes_SRS_PROXY_GATEWAY_17_005: [Message Channel - `ProxyGateway_DoWork` shall send the pending frame once its first message has waited the accepted linger time] */
+            if (LOCK_OK != Lock(remote_module->batch_lock)) {
+                LogError("%s: Unable to acquire the frame mutex!", __FUNCTION__);
             } else {
-                MESSAGE_HANDLE structured_module_message;
-
-                /* Codes_SRS_PROXY_GATEWAY_027_040: [Message Channel - If a module message was received, then `ProxyGateway_DoWork` will parse that message by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)` with the buffer received from `nn_recv` as `source` and return value from `nn_recv` as `size`] */
-                if (NULL == (structured_module_message = Message_CreateFromByteArray((const unsigned char *)module_message, bytes_received))) {
-                    /* Codes_SRS_PROXY_GATEWAY_027_041: [Message Channel - If unable to parse the module message, then `ProxyGateway_DoWork` shall free any previously allocated memory and abandon the message channel request] */
-                    LogError("%s: Unable to parse control message!", __FUNCTION__);
-                } else {
-                    /* Codes_SRS_PROXY_GATEWAY_027_042: [Message Channel - `ProxyGateway_DoWork` shall pass the structured message to the module by calling `void Module_Receive(MODULE_HANDLE moduleHandle)` using the parsed message as `moduleHandle`] */
-                    ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
-                    /* Codes_SRS_PROXY_GATEWAY_027_043: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed module message by calling `void Message_Destroy(MESSAGE_HANDLE * message)` using the parsed module message as `message`] */
-                    Message_Destroy(structured_module_message);
+                tickcounter_ms_t now;
+                if (0 < MessageBatch_GetCount(remote_module->batch)
+                    && (0 != tickcounter_get_current_ms(remote_module->tick_counter, &now)
+                        || remote_module->batch_limits.linger_ms <= (now - remote_module->batch_started))) {
+                    (void)flush_message_batch(remote_module);
                 }
-                /* Codes_SRS_PROXY_GATEWAY_027_044: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
-                (void)nn_freemsg(module_message);
+                (void)Unlock(remote_module->batch_lock);
             }
         }
     }
+}
+
+
+void
+ProxyGateway_DoWork (
+    REMOTE_MODULE_HANDLE remote_module
+) {
+    if (NULL == remote_module) {
+        /* Codes_SRS_PROXY_GATEWAY_027_026: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_DoWork` shall do nothing] */
+        LogError("%s: NULL parameter - remote_module!", __FUNCTION__);
+    } else {
+        do_work(remote_module, 0);
+    }
 
     return;
 }
@@ -445,6 +703,37 @@ ProxyGateway_StartWorkerThread (
 }
 
 
+int
+ProxyGateway_SetWorkOptions (
+    REMOTE_MODULE_HANDLE remote_module,
+    unsigned int wait_ms,
+    size_t max_messages
+) {
+    int result;
+
+    if (NULL == remote_module) {
+        /* Codes_SRS_PROXY_GATEWAY_17_025: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+        LogError("%s: NULL parameter - remote_module!", __FUNCTION__);
+        result = __LINE__;
+    } else if (0 == max_messages) {
+        /* Codes_SRS_PROXY_GATEWAY_17_026: [Prerequisite Check - If `max_messages` is zero, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+        LogError("%s: max_messages must be at least 1!", __FUNCTION__);
+        result = __LINE__;
+    } else if (INT_MAX < wait_ms) {
+        /* Codes_SRS_PROXY_GATEWAY_17_027: [Prerequisite Check - If `wait_ms` is greater than `INT_MAX`, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+        LogError("%s: wait_ms is too large!", __FUNCTION__);
+        result = __LINE__;
+    } else {
+        /* Codes_SRS_PROXY_GATEWAY_17_028: [`ProxyGateway_SetWorkOptions` shall keep `wait_ms` for the worker thread and `max_messages` for each call to `ProxyGateway_DoWork`, and return zero] */
+        remote_module->wait_ms = wait_ms;
+        remote_module->max_messages = max_messages;
+        result = 0;
+    }
+
+    return result;
+}
+
+
 /* Codes_SRS_BROKER_17_022: [ N/A - Broker_Publish shall Lock the modules lock. ] */
 /* Codes_SRS_BROKER_17_023: [ N/A - Broker_Publish shall Unlock the modules lock. ] */
 /* Codes_SRS_BROKER_17_026: [ N/A - Broker_Publish shall copy source into the beginning of the nanomsg buffer. ] */
@@ -457,6 +746,8 @@ Broker_Publish (
     (void)source;
     REMOTE_MODULE_HANDLE remote_module = (REMOTE_MODULE_HANDLE)broker;
     BROKER_RESULT result;
+    bool entered = false;
+    bool credit_taken = false;
 
     /* Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.] */
     if (broker == NULL || message == NULL)
@@ -464,6 +755,79 @@ Broker_Publish (
         result = BROKER_INVALIDARG;
         LogError("Broker handle and/or message handle is NULL");
     }
+    /* Codes_SRS_PROXY_GATEWAY_17_037: [While the message channel is being closed, `Broker_Publish` shall drop the message and return BROKER_ERROR, and the channel shall not be closed until every `Broker_Publish` call using it has returned] */
+    else if (!(entered = enter_publisher(remote_module)))
+    {
+        LogError("the message channel is closing, dropping message [%p]", message);
+        result = BROKER_ERROR;
+    }
+    /* Codes_SRS_PROXY_GATEWAY_17_020: [If the gateway accepted a credit window, `Broker_Publish` shall take one credit for the message, and if none is left it shall drop the message without waiting and return BROKER_ERROR, giving the credit back if the message cannot be sent] */
+    else if (!(credit_taken = take_send_credit(remote_module)))
+    {
+        LogError("the gateway granted no credits, dropping message [%p]", message);
+        result = BROKER_ERROR;
+    }
+    else if (remote_module->batch != NULL)
+    {
+        /* Codes_SRS_PROXY_GATEWAY_17_004: [If the remote module sends frames, `Broker_Publish` shall add the message to the pending frame, and send the frame once it is full or before a message that does not fit] */
+        if (LOCK_OK != Lock(remote_module->batch_lock))
+        {
+            LogError("unable to lock the pending frame for message [%p]", message);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            if (0 == MessageBatch_GetCount(remote_module->batch) &&
+                0 != tickcounter_get_current_ms(remote_module->tick_counter, &remote_module->batch_started))
+            {
+                remote_module->batch_started = 0;
+            }
+            MESSAGE_BATCH_RESULT add_result = MessageBatch_Add(remote_module->batch, message);
+            if (add_result == MESSAGE_BATCH_NO_ROOM)
+            {
+                (void)flush_message_batch(remote_module);
+                if (0 != tickcounter_get_current_ms(remote_module->tick_counter, &remote_module->batch_started))
+                {
+                    remote_module->batch_started = 0;
+                }
+                add_result = MessageBatch_Add(remote_module->batch, message);
+            }
+
+            if (add_result == MESSAGE_BATCH_ERROR)
+            {
+                LogError("unable to add a message [%p] to the pending frame", message);
+                result = BROKER_ERROR;
+            }
+            else if (add_result == MESSAGE_BATCH_FULL && 0 != flush_message_batch(remote_module))
+            {
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                result = BROKER_OK;
+            }
+            (void)Unlock(remote_module->batch_lock);
+        }
+    }
+    else if (remote_module->message_channel != NULL)
+    {
+        /* Codes_SRS_PROXY_GATEWAY_17_017: [If the message channel is shared memory, `Broker_Publish` and `flush_message_batch` shall copy the serialized message or frame into it by calling `SHARED_MEMORY_CHANNEL_RESULT SharedMemoryChannel_Send(SHARED_MEMORY_CHANNEL_HANDLE channel, const unsigned char * buf, int32_t size, int timeout_ms)`, waiting for room until the channel is closed] */
+        const CONSTBUFFER * serialized = Message_GetByteArray(message);
+        if (serialized == NULL)
+        {
+            LogError("unable to serialize a message [%p]", message);
+            result = BROKER_ERROR;
+        }
+        else if (SHARED_MEMORY_CHANNEL_OK != SharedMemoryChannel_Send(remote_module->message_channel, serialized->buffer, (int32_t)serialized->size, -1))
+        {
+            LogError("unable to send a message [%p]", message);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            result = BROKER_OK;
+        }
+    }
     else
     {
         // Send message_ to nanomsg
@@ -472,7 +836,8 @@ Broker_Publish (
         /* Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ] */
         MESSAGE_HANDLE msg = Message_Clone(message);
         /* Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ] */
-        msg_size = Message_ToByteArray(message, NULL, 0);
+        /* Codes_SRS_PROXY_GATEWAY_17_036: [`Broker_Publish` shall serialize the message in the message version agreed with the gateway] */
+        msg_size = Message_ToByteArrayVersion(message, remote_module->message_version, NULL, 0);
         if (msg_size < 0)
         {
             /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
@@ -495,10 +860,15 @@ Broker_Publish (
             {
                 unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
                 /* Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ] */
-                Message_ToByteArray(message, nn_msg_bytes, msg_size);
+                Message_ToByteArrayVersion(message, remote_module->message_version, nn_msg_bytes, msg_size);
+
+                /* Closing the socket ends a send waiting on it, so the channel need not wait for this one */
+                int message_socket = remote_module->message_socket;
+                leave_publisher(remote_module);
+                entered = false;
 
                 /* Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ] */
-                int nbytes = nn_really_send(remote_module->message_socket, &nn_msg, NN_MSG, 0);
+                int nbytes = nn_really_send(message_socket, &nn_msg, NN_MSG, 0);
                 if (nbytes != buf_size)
                 {
                     /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
@@ -519,6 +889,15 @@ Broker_Publish (
 
     }
 
+    if (result != BROKER_OK && credit_taken)
+    {
+        add_send_credits(remote_module, 1);
+    }
+    if (entered)
+    {
+        leave_publisher(remote_module);
+    }
+
     /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
     return result;
 }
@@ -531,8 +910,17 @@ connect_to_message_channel (
 ) {
     int result;
 
+    if (MESSAGE_URI_TYPE_SHARED_MEMORY == channel_uri->uri_type) {
+        /* Codes_SRS_PROXY_GATEWAY_17_013: [If `MESSAGE_URI::uri_type` is `MESSAGE_URI_TYPE_SHARED_MEMORY`, `connect_to_message_channel` shall open the channel the gateway created by calling `SHARED_MEMORY_CHANNEL_HANDLE SharedMemoryChannel_Open(const char * uri)` with `MESSAGE_URI::uri` as `uri`, instead of creating a socket] */
+        if (NULL == (remote_module->message_channel = SharedMemoryChannel_Open(channel_uri->uri))) {
+            /* Codes_SRS_PROXY_GATEWAY_17_014: [If a call to `SharedMemoryChannel_Open` returns `NULL`, then `connect_to_message_channel` shall return a non-zero value] */
+            LogError("%s: Unable to open the gateway shared memory channel!", __FUNCTION__);
+            result = __LINE__;
+        } else {
+            result = 0;
+        }
     /* SRS_PROXY_GATEWAY_027_0xx: [`connect_to_message_channel` shall create a socket for the Azure IoT Gateway message channel by calling `int nn_socket(int domain, int protocol)` with `AF_SP` as `domain` and `MESSAGE_URI::uri_type` as `protocol`] */
-    if (-1 == (remote_module->message_socket = nn_socket(AF_SP, channel_uri->uri_type))) {
+    } else if (-1 == (remote_module->message_socket = nn_socket(AF_SP, channel_uri->uri_type))) {
         /* SRS_PROXY_GATEWAY_027_0xx: [If a call to `nn_socket` returns -1, then `connect_to_message_channel` shall free any previously allocated memory, abandon the control message and prepare for the next create message] */
         LogError("%s: Unable to create the gateway socket!", __FUNCTION__);
         result = __LINE__;
@@ -556,17 +944,190 @@ void
 disconnect_from_message_channel (
     REMOTE_MODULE_HANDLE remote_module
 ) {
+    bool stopped;
+    if (NULL != remote_module->message_channel && NULL == remote_module->batch) {
+        /* Codes_SRS_PROXY_GATEWAY_17_038: [If no frame is pending, `disconnect_from_message_channel` shall first close a shared memory message channel by calling `void SharedMemoryChannel_Close(SHARED_MEMORY_CHANNEL_HANDLE channel)`, so publishers waiting for room return] */
+        SharedMemoryChannel_Close(remote_module->message_channel);
+    }
+    /* Codes_SRS_PROXY_GATEWAY_17_037: [While the message channel is being closed, `Broker_Publish` shall drop the message and return BROKER_ERROR, and the channel shall not be closed until every `Broker_Publish` call using it has returned] */
+    stopped = stop_publishers(remote_module);
+    /* Codes_SRS_PROXY_GATEWAY_17_008: [`disconnect_from_message_channel` shall send any pending frame and stop accepting frames before closing the message channel] */
+    close_message_batch(remote_module);
+    if (NULL != remote_module->message_channel) {
+        /* Codes_SRS_PROXY_GATEWAY_17_018: [`disconnect_from_message_channel` shall close and unmap a shared memory message channel by calling `void SharedMemoryChannel_Destroy(SHARED_MEMORY_CHANNEL_HANDLE channel)`] */
+        SharedMemoryChannel_Destroy(remote_module->message_channel);
+        remote_module->message_channel = NULL;
+    }
     /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
     (void)nn_really_shutdown(remote_module->message_socket, remote_module->message_endpoint);
     remote_module->message_endpoint = -1;
     /* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
     (void)nn_really_close(remote_module->message_socket);
     remote_module->message_socket = -1;
+    remote_module->credit_window = 0;
+    if (stopped) {
+        resume_publishers(remote_module);
+    }
 
     return;
 }
 
 
+void
+open_message_batch (
+    REMOTE_MODULE_HANDLE remote_module,
+    const MESSAGE_BATCH_LIMITS * offered_limits
+) {
+    /* Codes_SRS_PROXY_GATEWAY_17_001: [`open_message_batch` shall accept the offered frame limits, so frames received on the message channel are unpacked] */
+    remote_module->batch_limits = *offered_limits;
+
+    // Messages are published one at a time, so only a linger time lets several share a frame
+    if (0 != offered_limits->linger_ms) {
+        /* Codes_SRS_PROXY_GATEWAY_17_002: [If the offered linger time is not zero, `open_message_batch` shall create a mutex by calling `LOCK_HANDLE Lock_Init(void)`, a batch by calling `MESSAGE_BATCH_HANDLE MessageBatch_Create(const MESSAGE_BATCH_LIMITS * limits)` and a tick counter by calling `TICK_COUNTER_HANDLE tickcounter_create(void)`; if any fails, it shall free the others and send messages one at a time] */
+        if (NULL == (remote_module->batch_lock = Lock_Init())) {
+            LogError("%s: Unable to create the frame mutex, sending messages one at a time!", __FUNCTION__);
+        } else if (NULL == (remote_module->batch = MessageBatch_Create(offered_limits))) {
+            LogError("%s: Unable to create a batch, sending messages one at a time!", __FUNCTION__);
+            (void)Lock_Deinit(remote_module->batch_lock);
+            remote_module->batch_lock = NULL;
+        } else if (NULL == (remote_module->tick_counter = tickcounter_create())) {
+            LogError("%s: Unable to create a tick counter, sending messages one at a time!", __FUNCTION__);
+            MessageBatch_Destroy(remote_module->batch);
+            remote_module->batch = NULL;
+            (void)Lock_Deinit(remote_module->batch_lock);
+            remote_module->batch_lock = NULL;
+        }
+    }
+
+    return;
+}
+
+
+void
+close_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+) {
+    bool stopped = stop_publishers(remote_module);
+    if (NULL != remote_module->batch) {
+        /* Codes_SRS_PROXY_GATEWAY_17_006: [`close_message_batch` shall send the pending frame, if any, and free the batch, its mutex and its tick counter] */
+        if (LOCK_OK != Lock(remote_module->batch_lock)) {
+            LogError("%s: Unable to acquire the frame mutex, dropping the pending frame!", __FUNCTION__);
+        } else {
+            if (0 < MessageBatch_GetCount(remote_module->batch)) {
+                (void)flush_message_batch(remote_module);
+            }
+            (void)Unlock(remote_module->batch_lock);
+        }
+        MessageBatch_Destroy(remote_module->batch);
+        remote_module->batch = NULL;
+        (void)Lock_Deinit(remote_module->batch_lock);
+        remote_module->batch_lock = NULL;
+        tickcounter_destroy(remote_module->tick_counter);
+        remote_module->tick_counter = NULL;
+    }
+    /* Codes_SRS_PROXY_GATEWAY_17_007: [`close_message_batch` shall stop accepting frames] */
+    (void)memset(&remote_module->batch_limits, 0, sizeof(MESSAGE_BATCH_LIMITS));
+    if (stopped) {
+        resume_publishers(remote_module);
+    }
+
+    return;
+}
+
+
+/* Sends the pending frame on a shared memory message channel */
+static int send_frame_on_shared_memory(REMOTE_MODULE_HANDLE remote_module, int32_t frame_size)
+{
+    int result;
+    unsigned char * frame;
+
+    if (NULL == (frame = (unsigned char *)malloc(frame_size))) {
+        LogError("%s: Unable to allocate the pending frame!", __FUNCTION__);
+        result = __LINE__;
+    } else {
+        if (frame_size != MessageBatch_ToByteArray(remote_module->batch, frame, frame_size)) {
+            LogError("%s: Unable to serialize the pending frame!", __FUNCTION__);
+            result = __LINE__;
+        } else {
+            SHARED_MEMORY_CHANNEL_RESULT sent;
+            unsigned int closing_waited_ms = 0;
+            while (SHARED_MEMORY_CHANNEL_TIMEOUT == (sent = SharedMemoryChannel_Send(remote_module->message_channel, frame, frame_size, FRAME_SEND_WAIT_MS))
+                && FRAME_CLOSING_WAIT_MS > closing_waited_ms) {
+                if (publishers_stopping(remote_module)) {
+                    closing_waited_ms += FRAME_SEND_WAIT_MS;
+                }
+            }
+            if (SHARED_MEMORY_CHANNEL_OK != sent) {
+                LogError("%s: Unable to send the pending frame!", __FUNCTION__);
+                result = __LINE__;
+            } else {
+                result = 0;
+            }
+        }
+        free(frame);
+    }
+
+    return result;
+}
+
+
+/* Sends a frame on the message socket without blocking, trying again while the gateway is not keeping up */
+static int send_frame_on_socket(REMOTE_MODULE_HANDLE remote_module, void ** frame, int32_t frame_size)
+{
+    int nbytes;
+    unsigned int closing_waited_ms = 0;
+
+    while (frame_size != (nbytes = nn_really_send(remote_module->message_socket, frame, NN_MSG, NN_DONTWAIT))
+        && EAGAIN == nn_errno()
+        && FRAME_CLOSING_WAIT_MS > closing_waited_ms) {
+        ThreadAPI_Sleep(1);
+        if (publishers_stopping(remote_module)) {
+            closing_waited_ms++;
+        }
+    }
+
+    return (frame_size == nbytes) ? 0 : __LINE__;
+}
+
+
+/* Sends the pending frame on the message channel; the caller holds the frame mutex */
+int
+flush_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+) {
+    int result;
+    int32_t frame_size;
+    void * frame;
+
+    /* Codes_SRS_PROXY_GATEWAY_17_009: [`flush_message_batch` shall serialize the pending frame by calling `int32_t MessageBatch_ToByteArray(MESSAGE_BATCH_HANDLE batch, unsigned char * buf, int32_t size)` into a buffer from `nn_allocmsg`, send it on the message channel and clear the batch by calling `void MessageBatch_Clear(MESSAGE_BATCH_HANDLE batch)`] */
+    if (0 > (frame_size = MessageBatch_ToByteArray(remote_module->batch, NULL, 0))) {
+        LogError("%s: Unable to size the pending frame!", __FUNCTION__);
+        result = __LINE__;
+    } else if (NULL != remote_module->message_channel) {
+        /* Codes_SRS_PROXY_GATEWAY_17_017: [If the message channel is shared memory, `Broker_Publish` and `flush_message_batch` shall copy the serialized message or frame into it by calling `SHARED_MEMORY_CHANNEL_RESULT SharedMemoryChannel_Send(SHARED_MEMORY_CHANNEL_HANDLE channel, const unsigned char * buf, int32_t size, int timeout_ms)`, waiting for room until the channel is closed] */
+        result = send_frame_on_shared_memory(remote_module, frame_size);
+    } else if (NULL == (frame = nn_allocmsg(frame_size, 0))) {
+        LogError("%s: Unable to allocate the pending frame!", __FUNCTION__);
+        result = __LINE__;
+    } else if (frame_size != MessageBatch_ToByteArray(remote_module->batch, (unsigned char *)frame, frame_size)) {
+        LogError("%s: Unable to serialize the pending frame!", __FUNCTION__);
+        result = __LINE__;
+        (void)nn_freemsg(frame);
+    /* Codes_SRS_PROXY_GATEWAY_17_039: [`flush_message_batch` shall not block on a full message channel: it shall send with `NN_DONTWAIT`, or with a timeout on a shared memory channel, and try again while the channel is full, giving up once the channel has been closing for `FRAME_CLOSING_WAIT_MS`, so closing the channel never waits forever on a publisher sending a frame] */
+    } else if (0 != send_frame_on_socket(remote_module, &frame, frame_size)) {
+        /* Codes_SRS_PROXY_GATEWAY_17_010: [If unable to send the frame, `flush_message_batch` shall free the buffer by calling `nn_freemsg`, clear the batch and return a non-zero value] */
+        LogError("%s: Unable to send the pending frame!", __FUNCTION__);
+        result = __LINE__;
+        (void)nn_freemsg(frame);
+    } else {
+        result = 0;
+    }
+    MessageBatch_Clear(remote_module->batch);
+
+    return result;
+}
+
+
 int
 invoke_add_module_procedure (
     REMOTE_MODULE_HANDLE remote_module,
@@ -608,8 +1169,8 @@ process_module_create_message (
 ) {
     int result;
 
-    /* SRS_PROXY_GATEWAY_027_0xx: [Prerequisite Check - If the `gateway_message_version` is greater than 1, then `process_module_create_message` shall do nothing and return a non-zero value] */
-    if (1 < message->gateway_message_version) {
+    /* SRS_PROXY_GATEWAY_027_0xx: [Prerequisite Check - If the `gateway_message_version` is greater than `GATEWAY_MESSAGE_VERSION_CURRENT`, then `process_module_create_message` shall do nothing and return a non-zero value] */
+    if (GATEWAY_MESSAGE_VERSION_CURRENT < message->gateway_message_version) {
         LogError("%s: Incompatible create message version: %u!", __FUNCTION__, message->gateway_message_version);
         result = __LINE__;
         (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
@@ -622,11 +1183,30 @@ process_module_create_message (
             disconnect_from_message_channel(remote_module);
         }
 
+        /* Codes_SRS_PROXY_GATEWAY_17_011: [If the create message offers frame limits, `process_module_create_message` shall accept them before creating the module, and return them in its success reply] */
+        if (0 != message->batch_limits.max_messages && 0 != message->batch_limits.max_bytes) {
+            open_message_batch(remote_module, &message->batch_limits);
+        }
+
+        /* Codes_SRS_PROXY_GATEWAY_17_019: [`process_module_create_message` shall accept the credit window of the create message, so the module may publish that many messages before the gateway grants more, and return it in its success reply; a window of zero turns flow control off] */
+        remote_module->credit_window = message->credit_window;
+        gateway_atomic_store(&remote_module->send_credits, message->credit_window);
+        remote_module->received_since_credit = 0;
+
+        /* Codes_SRS_PROXY_GATEWAY_17_034: [`process_module_create_message` shall send messages in the `gateway_message_version` of the create message, or, if the create message carries a `max_message_version`, in the lesser of it and `GATEWAY_MESSAGE_VERSION_CURRENT`] */
+        remote_module->gateway_max_message_version = message->max_message_version;
+        if (0 == message->max_message_version) {
+            remote_module->message_version = message->gateway_message_version;
+        } else {
+            remote_module->message_version = (GATEWAY_MESSAGE_VERSION_CURRENT < message->max_message_version) ? GATEWAY_MESSAGE_VERSION_CURRENT : message->max_message_version;
+        }
+
         /* SRS_PROXY_GATEWAY_027_0xx: [`process_module_create_message` shall connect to the message channels] */
         if (0 != connect_to_message_channel(remote_module, &message->uri)) {
             /* SRS_PROXY_GATEWAY_027_0xx: [If unable to connect to the message channels, `process_module_create_message` shall attempt to reply to the gateway with a connection error status and return a non-zero value] */
             LogError("%s: Cannot connect to message channels!", __FUNCTION__);
             result = __LINE__;
+            close_message_batch(remote_module);
             (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
         /* SRS_PROXY_GATEWAY_027_0xx: [`process_module_create_message` shall invoke the "add module" process] */
         } else if (0 != invoke_add_module_procedure(remote_module, message->args)) {
@@ -651,24 +1231,15 @@ process_module_create_message (
 }
 
 
-int
-send_control_reply (
-    REMOTE_MODULE_HANDLE remote_module,
-    uint8_t response
-) {
+/* Serializes a control message and sends it to the gateway */
+static int send_control_message(REMOTE_MODULE_HANDLE remote_module, CONTROL_MESSAGE * message)
+{
     int result;
-    CONTROL_MESSAGE_MODULE_REPLY reply = {
-        .base = {
-            .type = CONTROL_MESSAGE_TYPE_MODULE_REPLY,
-            .version = CONTROL_MESSAGE_VERSION_1,
-        },
-        .status = response,
-    };
     unsigned char * message_buffer = NULL;
     int32_t message_size;
 
     /* SRS_PROXY_GATEWAY_027_0xx: [`send_control_reply` shall calculate the serialized message size by calling `size_t ControlMessage_ToByteArray(CONTROL MESSAGE * message, unsigned char * buf, size_t size)`] */
-    if (0 > (message_size = ControlMessage_ToByteArray((CONTROL_MESSAGE *)&reply, message_buffer, 0))) {
+    if (0 > (message_size = ControlMessage_ToByteArray(message, message_buffer, 0))) {
         /* SRS_PROXY_GATEWAY_027_0xx: [If unable to calculate the serialized message size, `send_control_reply` shall return a non-zero value] */
         LogError("%s: Unable to calculate serialized message size!", __FUNCTION__);
         result = __LINE__;
@@ -679,7 +1250,7 @@ send_control_reply (
             LogError("%s: Unable to allocate message!", __FUNCTION__);
             result = __LINE__;
         /* SRS_PROXY_GATEWAY_027_0xx: [`send_control_reply` shall serialize a creation reply indicating the creation status by calling `size_t ControlMessage_ToByteArray(CONTROL MESSAGE * message, unsigned char * buf, size_t size)`] */
-        } else if (0 > ControlMessage_ToByteArray((CONTROL_MESSAGE *)&reply, message_buffer, message_size)) {
+        } else if (0 > ControlMessage_ToByteArray(message, message_buffer, message_size)) {
             /* SRS_PROXY_GATEWAY_027_0xx: [If unable to serialize the creation message reply, `send_control_reply` shall return a non-zero value] */
             LogError("%s: Unable to serialize message!", __FUNCTION__);
             result = __LINE__;
@@ -699,12 +1270,98 @@ send_control_reply (
 }
 
 
+int
+send_control_reply (
+    REMOTE_MODULE_HANDLE remote_module,
+    uint8_t response
+) {
+    CONTROL_MESSAGE_MODULE_REPLY reply = {
+        .base = {
+            .type = CONTROL_MESSAGE_TYPE_MODULE_REPLY,
+            .version = CONTROL_MESSAGE_VERSION_1,
+        },
+        .status = response,
+    };
+
+    if ((uint8_t)REMOTE_MODULE_OK == response) {
+        /* Codes_SRS_PROXY_GATEWAY_17_012: [`send_control_reply` shall return the accepted frame limits in a success reply] */
+        reply.batch_limits = remote_module->batch_limits;
+        /* Codes_SRS_PROXY_GATEWAY_17_019: [`process_module_create_message` shall accept the credit window of the create message, so the module may publish that many messages before the gateway grants more, and return it in its success reply; a window of zero turns flow control off] */
+        reply.credit_window = remote_module->credit_window;
+        /* Codes_SRS_PROXY_GATEWAY_17_035: [If the create message carried a `max_message_version`, `send_control_reply` shall return `GATEWAY_MESSAGE_VERSION_CURRENT` as the `max_message_version` of a success reply] */
+        reply.max_message_version = (0 != remote_module->gateway_max_message_version) ? GATEWAY_MESSAGE_VERSION_CURRENT : 0;
+    }
+
+    return send_control_message(remote_module, (CONTROL_MESSAGE *)&reply);
+}
+
+
+int
+send_control_credit (
+    REMOTE_MODULE_HANDLE remote_module,
+    uint32_t credits
+) {
+    CONTROL_MESSAGE_MODULE_CREDIT credit = {
+        .base = {
+            .type = CONTROL_MESSAGE_TYPE_MODULE_CREDIT,
+            .version = CONTROL_MESSAGE_VERSION_1,
+        },
+        .credits = credits,
+    };
+
+    /* Codes_SRS_PROXY_GATEWAY_17_023: [`send_control_credit` shall serialize and send a credit message granting `credits` to the gateway, the same way `send_control_reply` sends a reply] */
+    return send_control_message(remote_module, (CONTROL_MESSAGE *)&credit);
+}
+
+
+void
+wait_and_do_work (
+    REMOTE_MODULE_HANDLE remote_module
+) {
+    int timeout_ms = (int)remote_module->wait_ms;
+
+    // A pending frame must not wait past its linger time for the next wakeup
+    if (NULL != remote_module->batch && remote_module->batch_limits.linger_ms < (uint32_t)timeout_ms) {
+        /* Codes_SRS_PROXY_GATEWAY_17_030: [If the remote module sends frames, `wait_and_do_work` shall wait no longer than the accepted linger time] */
+        timeout_ms = (int)remote_module->batch_limits.linger_ms;
+    }
+
+    if (NULL != remote_module->message_channel) {
+        /* Codes_SRS_PROXY_GATEWAY_17_031: [If the message channel is shared memory, which cannot be polled with the sockets, `wait_and_do_work` shall do the work of `ProxyGateway_DoWork`, waiting up to the timeout for the first message of the channel] */
+        do_work(remote_module, timeout_ms);
+    } else {
+        struct nn_pollfd poll_fds[2];
+        int poll_count = 0;
+
+        poll_fds[poll_count].fd = remote_module->control_socket;
+        poll_fds[poll_count].events = NN_POLLIN;
+        poll_fds[poll_count].revents = 0;
+        ++poll_count;
+        if (0 <= remote_module->message_socket) {
+            poll_fds[poll_count].fd = remote_module->message_socket;
+            poll_fds[poll_count].events = NN_POLLIN;
+            poll_fds[poll_count].revents = 0;
+            ++poll_count;
+        }
+
+        /* Codes_SRS_PROXY_GATEWAY_17_029: [`wait_and_do_work` shall wait until the control socket or the message socket has a message to receive by calling `int nn_poll(struct nn_pollfd * fds, int nfds, int timeout)` with the timeout set by `ProxyGateway_SetWorkOptions`, then call `ProxyGateway_DoWork`] */
+        if (0 > nn_poll(poll_fds, poll_count, timeout_ms) && EINTR != nn_errno()) {
+            /* Codes_SRS_PROXY_GATEWAY_17_032: [If `nn_poll` fails, `wait_and_do_work` shall sleep for the timeout by calling `void ThreadAPI_Sleep(unsigned int milliseconds)` instead, so the worker thread does not spin] */
+            LogError("%s: Unable to poll the gateway channels!", __FUNCTION__);
+            ThreadAPI_Sleep((unsigned int)timeout_ms);
+        }
+        do_work(remote_module, 0);
+    }
+
+    return;
+}
+
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to initialize the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall release the thread mutex upon entering the loop by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to release the mutex, then `worker_thread` shall exit the thread and return a non-zero value] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall invoke asynchronous processing by calling `void ProxyGateway_DoWork(REMOTE_MODULE_HANDLE remote_module)`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall yield its remaining quantum by calling `void THREADAPI_Sleep(unsigned int milliseconds)`] */
+/* Codes_SRS_PROXY_GATEWAY_17_033: [`worker_thread` shall wait for and process the messages of the gateway by calling `wait_and_do_work`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to check for a halt signal by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
@@ -733,8 +1390,7 @@ worker_thread (
                 break;
             }
             else {
-                ProxyGateway_DoWork(remote_module);
-                ThreadAPI_Sleep(0);  // Release the CPU
+                wait_and_do_work(remote_module);
                 if (LOCK_ERROR == Lock(remote_module->message_thread->mutex)) {
                     LogError("%s: Failed to obtain mutex!", __FUNCTION__);
                     result = __LINE__;
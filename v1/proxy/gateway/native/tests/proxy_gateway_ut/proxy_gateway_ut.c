@@ -2,10 +2,12 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #ifdef __cplusplus
   #include <cstdbool>
+  #include <climits>
   #include <cstdlib>
   #include <ctime>
 #else
   #include <stdbool.h>
+  #include <limits.h>
   #include <stdlib.h>
   #include <time.h>
 #endif
@@ -72,7 +74,10 @@ non_mocked_free(
   #include "azure_c_shared_utility/threadapi.h"
   #include "control_message.h"
   #include "message.h"
+  #include "message_batch.h"
+  #include "shared_memory_channel.h"
   #include "module.h"
+  #include "azure_c_shared_utility/tickcounter.h"
 #undef ENABLE_MOCKS
 
 // Under test #includes
@@ -84,6 +89,9 @@ non_mocked_free(
 #define MOCK_LOCK (LOCK_HANDLE)0x17091979
 #define MOCK_MODULE (MODULE_HANDLE)0x09171979
 #define MOCK_REMOTE_MODULE (REMOTE_MODULE_HANDLE)0x19790917
+#define MOCK_BATCH (MESSAGE_BATCH_HANDLE)0x17790919
+#define MOCK_TICK_COUNTER (TICK_COUNTER_HANDLE)0x19171979
+#define MOCK_MESSAGE (MESSAGE_HANDLE)0x19791709
 
 #ifdef __cplusplus
 extern "C"
@@ -103,6 +111,25 @@ disconnect_from_message_channel (
     REMOTE_MODULE_HANDLE remote_module
 );
 
+extern
+void
+open_message_batch (
+    REMOTE_MODULE_HANDLE remote_module,
+    const MESSAGE_BATCH_LIMITS * offered_limits
+);
+
+extern
+void
+close_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
+extern
+int
+flush_message_batch (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
 extern
 int
 invoke_add_module_procedure (
@@ -124,6 +151,12 @@ send_control_reply (
     uint8_t response
 );
 
+extern
+void
+wait_and_do_work (
+    REMOTE_MODULE_HANDLE remote_module
+);
+
 extern
 int
 worker_thread (
@@ -174,10 +207,30 @@ umockvalue_stringify_CONTROL_MESSAGE (
             const CONTROL_MESSAGE_MODULE_REPLY * value = (CONTROL_MESSAGE_MODULE_REPLY *)*value_;
             len = sprintf(
                 buffer,
-                "CONTROL_MESSAGE_MODULE_REPLY {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.status: %u\n}\n",
+                "CONTROL_MESSAGE_MODULE_REPLY {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.status: %u\n\t.batch_limits {\n\t\t.max_messages: %u\n\t\t.max_bytes: %u\n\t\t.linger_ms: %u\n\t}\n\t.credit_window: %u\n\t.max_message_version: %u\n}\n",
+                (uint8_t)value->base.type,
+                (uint8_t)value->base.version,
+                value->status,
+                value->batch_limits.max_messages,
+                value->batch_limits.max_bytes,
+                value->batch_limits.linger_ms,
+                value->credit_window,
+                (uint8_t)value->max_message_version
+            );
+
+            result = (char *)non_mocked_malloc(len + 1);
+            strcpy(result, buffer);
+            break;
+          }
+          case CONTROL_MESSAGE_TYPE_MODULE_CREDIT:
+          {
+            const CONTROL_MESSAGE_MODULE_CREDIT * value = (CONTROL_MESSAGE_MODULE_CREDIT *)*value_;
+            len = sprintf(
+                buffer,
+                "CONTROL_MESSAGE_MODULE_CREDIT {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.credits: %u\n}\n",
                 (uint8_t)value->base.type,
                 (uint8_t)value->base.version,
-                value->status
+                value->credits
             );
 
             result = (char *)non_mocked_malloc(len + 1);
@@ -258,6 +311,22 @@ umockvalue_are_equal_CONTROL_MESSAGE (
             match = (match && (left->base.type == right->base.type));
             match = (match && (left->base.version == right->base.version));
             match = (match && (left->status == right->status));
+            match = (match && (left->batch_limits.max_messages == right->batch_limits.max_messages));
+            match = (match && (left->batch_limits.max_bytes == right->batch_limits.max_bytes));
+            match = (match && (left->batch_limits.linger_ms == right->batch_limits.linger_ms));
+            match = (match && (left->credit_window == right->credit_window));
+            match = (match && (left->max_message_version == right->max_message_version));
+            break;
+          }
+          case CONTROL_MESSAGE_TYPE_MODULE_CREDIT:
+          {
+            const CONTROL_MESSAGE_MODULE_CREDIT * left = (CONTROL_MESSAGE_MODULE_CREDIT *)*left_;
+            const CONTROL_MESSAGE_MODULE_CREDIT * right = (CONTROL_MESSAGE_MODULE_CREDIT *)*right_;
+            match = true;
+
+            match = (match && (left->base.type == right->base.type));
+            match = (match && (left->base.version == right->base.version));
+            match = (match && (left->credits == right->credits));
             break;
           }
           case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
@@ -332,10 +401,26 @@ umockvalue_copy_CONTROL_MESSAGE (
                     destination->base.type = source->base.type;
                     destination->base.version = source->base.version;
                     destination->status = source->status;
+                    destination->batch_limits = source->batch_limits;
+                    destination->credit_window = source->credit_window;
+                    destination->max_message_version = source->max_message_version;
                     result = 0;
                 }
             }
             break;
+          case CONTROL_MESSAGE_TYPE_MODULE_CREDIT:
+            if (NULL == (*destination_ = (CONTROL_MESSAGE *)non_mocked_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREDIT)))) {
+                result = __LINE__;
+            } else {
+                CONTROL_MESSAGE_MODULE_CREDIT * destination = (CONTROL_MESSAGE_MODULE_CREDIT *)*destination_;
+                const CONTROL_MESSAGE_MODULE_CREDIT * source = (const CONTROL_MESSAGE_MODULE_CREDIT *)*source_;
+
+                destination->base.type = source->base.type;
+                destination->base.version = source->base.version;
+                destination->credits = source->credits;
+                result = 0;
+            }
+            break;
           case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
           case CONTROL_MESSAGE_TYPE_MODULE_START:
           default:
@@ -377,6 +462,7 @@ umockvalue_free_CONTROL_MESSAGE (
           case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
           case CONTROL_MESSAGE_TYPE_MODULE_REPLY:
           case CONTROL_MESSAGE_TYPE_MODULE_START:
+          case CONTROL_MESSAGE_TYPE_MODULE_CREDIT:
           default:
             non_mocked_free(*value_);
             break;
@@ -401,6 +487,9 @@ MOCK_FUNCTION_END(0)
 MOCK_FUNCTION_WITH_CODE(, int, nn_freemsg, void *, msg)
 MOCK_FUNCTION_END(0)
 
+MOCK_FUNCTION_WITH_CODE(, int, nn_poll, struct nn_pollfd *, fds, int, nfds, int, timeout)
+MOCK_FUNCTION_END(0)
+
 MOCK_FUNCTION_WITH_CODE(, int, nn_recv, int, s, void *, buf, size_t, len, int, flags)
 MOCK_FUNCTION_END(0)
 
@@ -442,8 +531,38 @@ static const MODULE_API_1 MOCK_MODULE_APIS = {
     mock_start
 };
 
+static
+int
+my_MessageBatch_ForEachMessage (
+    const unsigned char * source,
+    int32_t size,
+    MESSAGE_BATCH_ON_MESSAGE on_message,
+    void * context
+) {
+    // Deliver the whole buffer as the one message of the frame
+    on_message(context, source, size);
+    return 0;
+}
+
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
+static
+void
+expected_calls_open_message_batch (
+    void
+) {
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(MOCK_LOCK);
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(MessageBatch_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(MOCK_BATCH);
+    disableNegativeTest(negative_test_index++);
+    STRICT_EXPECTED_CALL(tickcounter_create())
+        .SetReturn(MOCK_TICK_COUNTER);
+}
+
 static
 void
 expected_calls_connect_to_message_channel (
@@ -532,6 +651,26 @@ expected_calls_process_module_create_message (
     expected_calls_send_control_reply(reply);
 }
 
+static
+REMOTE_MODULE_HANDLE
+attach_and_create_offering_frames (
+    const CONTROL_MESSAGE_MODULE_CREATE * create_message,
+    const CONTROL_MESSAGE_MODULE_REPLY * reply
+) {
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    umock_c_reset_all_calls();
+    if (0 != create_message->batch_limits.linger_ms) {
+        expected_calls_open_message_batch();
+    }
+    expected_calls_process_module_create_message(remote_module, create_message, reply);
+    ASSERT_ARE_EQUAL(int, 0, process_module_create_message(remote_module, create_message));
+    umock_c_reset_all_calls();
+
+    return remote_module;
+}
+
 static
 void
 on_umock_c_error (
@@ -565,6 +704,7 @@ TEST_SUITE_INITIALIZE(suite_init)
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BYTE_ARRAY_RELEASE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void *);
     REGISTER_UMOCK_ALIAS_TYPE(REMOTE_MODULE_HANDLE, void *);
@@ -572,6 +712,17 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void *);
     REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_HANDLE, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BATCH_ON_MESSAGE, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_BATCH_LIMITS *, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t *, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(SHARED_MEMORY_CHANNEL_HANDLE, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(SHARED_MEMORY_CHANNEL_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(const unsigned char **, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(int32_t *, void *);
+    REGISTER_UMOCK_ALIAS_TYPE(struct nn_pollfd *, void *);
 
     //REGISTER_UMOCKC_PAIRED_CREATE_DESTROY_CALLS(ControlMessage_Create, ControlMessage_Destroy);
     //REGISTER_UMOCKC_PAIRED_CREATE_DESTROY_CALLS(Message_Create, Message_Destroy);
@@ -583,6 +734,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, non_mocked_calloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, non_mocked_free);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, non_mocked_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(MessageBatch_ForEachMessage, my_MessageBatch_ForEachMessage);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -1042,10 +1194,10 @@ TEST_FUNCTION(doWork_SCENARIO_NULL_handle)
 /* Tests_SRS_PROXY_GATEWAY_027_035: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed control message by calling `void ControlMessage_Destroy(CONTROL_MESSAGE * message)` using the parsed control message as `message`] */
 /* Tests_SRS_PROXY_GATEWAY_027_036: [Control Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
 /* Tests_SRS_PROXY_GATEWAY_027_038: [Message Channel - `ProxyGateway_DoWork` shall poll the gateway message channel by calling `int nn_recv(int s, void * buf, size_t len, int flags)` with each message socket for `s`, `NULL` for `buf`, `NN_MSG` for `len` and NN_DONTWAIT for `flags`] */
-/* Tests_SRS_PROXY_GATEWAY_027_040: [Message Channel - If a module message was received, then `ProxyGateway_DoWork` will parse that message by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)` with the buffer received from `nn_recv` as `source` and return value from `nn_recv` as `size`] */
+/* Tests_SRS_PROXY_GATEWAY_027_040: [Message Channel - If a module message was received, then `ProxyGateway_DoWork` will parse that message by calling `MESSAGE_HANDLE Message_CreateFromOwnedByteArray(const unsigned char * source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void * context)` with the buffer received from `nn_recv` as `source` and `context`, return value from `nn_recv` as `size` and a function calling `nn_freemsg` as `release`] */
 /* Tests_SRS_PROXY_GATEWAY_027_042: [Message Channel - `ProxyGateway_DoWork` shall pass the structured message to the module by calling `void Module_Receive(MODULE_HANDLE moduleHandle)` using the parsed message as `moduleHandle`] */
 /* Tests_SRS_PROXY_GATEWAY_027_043: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed module message by calling `void Message_Destroy(MESSAGE_HANDLE * message)` using the parsed module message as `message`] */
-/* Tests_SRS_PROXY_GATEWAY_027_044: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`] */
+/* Tests_SRS_PROXY_GATEWAY_027_044: [Message Channel - If unable to parse the module message, `ProxyGateway_DoWork` shall free the resources held by the gateway message by calling `int nn_freemsg(void * msg)` with the resulting buffer from the previous call to `nn_recv`; otherwise the parsed message owns the buffer] */
 TEST_FUNCTION(doWork_SCENARIO_create_message_success)
 {
     // Arrange
@@ -1100,12 +1252,12 @@ TEST_FUNCTION(doWork_SCENARIO_create_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
-    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
         .IgnoreArgument(2)
+        .IgnoreArgument(3)
         .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
     STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, (MESSAGE_HANDLE)&CREATE_MESSAGE));
     STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&CREATE_MESSAGE));
-    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
 
     // Act
     ProxyGateway_DoWork(remote_module);
@@ -1189,13 +1341,13 @@ TEST_FUNCTION(doWork_SCENARIO_start_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
-    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
         .IgnoreArgument(2)
+        .IgnoreArgument(3)
         .SetReturn((MESSAGE_HANDLE)&START_MESSAGE);
     STRICT_EXPECTED_CALL(mock_receive(IGNORED_PTR_ARG, (MESSAGE_HANDLE)&START_MESSAGE))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&START_MESSAGE));
-    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
 
     // Act
     ProxyGateway_DoWork(remote_module);
@@ -1466,8 +1618,9 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_bad_parse)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
-    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
         .IgnoreArgument(2)
+        .IgnoreArgument(3)
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
 
@@ -1481,6 +1634,146 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_bad_parse)
     ProxyGateway_Detach(remote_module);
 }
 
+/* Tests_SRS_PROXY_GATEWAY_17_003: [Message Channel - If frames were accepted and the received buffer is a frame, then `ProxyGateway_DoWork` shall create each message of the frame by calling `MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char * source, int32_t size)`, pass it to the module by calling `Module_Receive`, destroy it, and free the buffer by calling `nn_freemsg`] */
+TEST_FUNCTION(doWork_SCENARIO_gateway_frame_success)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 0 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 0 }
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsFrame((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(MessageBatch_ForEachMessage((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE, IGNORED_PTR_ARG, remote_module))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, (MESSAGE_HANDLE)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_005: [Message Channel - `ProxyGateway_DoWork` shall send the pending frame once its first message has waited the accepted linger time] */
+/* Tests_SRS_PROXY_GATEWAY_17_009: [`flush_message_batch` shall serialize the pending frame by calling `int32_t MessageBatch_ToByteArray(MESSAGE_BATCH_HANDLE batch, unsigned char * buf, int32_t size)` into a buffer from `nn_allocmsg`, send it on the message channel and clear the batch by calling `void MessageBatch_Clear(MESSAGE_BATCH_HANDLE batch)`] */
+TEST_FUNCTION(doWork_SCENARIO_sends_pending_frame_after_linger)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+    static const void * NN_FRAME_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_FRAME_SIZE = 1979;
+    static const tickcounter_ms_t NOW = 5;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(MOCK_TICK_COUNTER, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &NOW, sizeof(NOW))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, NULL, 0))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_allocmsg(NN_FRAME_SIZE, 0))
+        .SetReturn((void *)NN_FRAME_BUFFER);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, (unsigned char *)NN_FRAME_BUFFER, NN_FRAME_SIZE))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_Clear(MOCK_BATCH));
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* Tests_SRS_PROXY_GATEWAY_027_045: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_HaltWorkerThread` shall return a non-zero value] */
 TEST_FUNCTION(haltWorkerThread_SCENARIO_NULL_handle)
 {
@@ -2069,97 +2362,99 @@ TEST_FUNCTION(connect_to_message_channel_SCENARIO_negative_tests)
     umock_c_negative_tests_deinit();
 }
 
-/* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
-TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_success)
+/* Tests_SRS_PROXY_GATEWAY_17_013: [If `MESSAGE_URI::uri_type` is `MESSAGE_URI_TYPE_SHARED_MEMORY`, `connect_to_message_channel` shall open the channel the gateway created by calling `SHARED_MEMORY_CHANNEL_HANDLE SharedMemoryChannel_Open(const char * uri)` with `MESSAGE_URI::uri` as `uri`, instead of creating a socket] */
+/* Tests_SRS_PROXY_GATEWAY_17_018: [`disconnect_from_message_channel` shall close and unmap a shared memory message channel by calling `void SharedMemoryChannel_Destroy(SHARED_MEMORY_CHANNEL_HANDLE channel)`] */
+/* Tests_SRS_PROXY_GATEWAY_17_038: [If no frame is pending, `disconnect_from_message_channel` shall first close a shared memory message channel by calling `void SharedMemoryChannel_Close(SHARED_MEMORY_CHANNEL_HANDLE channel)`, so publishers waiting for room return] */
+TEST_FUNCTION(connect_to_message_channel_SCENARIO_shared_memory_success)
 {
     // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        MESSAGE_URI_TYPE_SHARED_MEMORY,
+        "shm://proxy_gateway_ut"
+    };
+
+    int result;
+
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
     ASSERT_IS_NOT_NULL(remote_module);
 
     // Expected call listing
     umock_c_reset_all_calls();
-    expected_calls_disconnect_from_message_channel();
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Open(MESSAGE.uri))
+        .SetReturn((SHARED_MEMORY_CHANNEL_HANDLE)0x5117);
 
     // Act
-    disconnect_from_message_channel(remote_module);
+    result = connect_to_message_channel(remote_module, &MESSAGE);
 
     // Assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
 
     // Cleanup
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Close((SHARED_MEMORY_CHANNEL_HANDLE)0x5117));
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Destroy((SHARED_MEMORY_CHANNEL_HANDLE)0x5117));
+    expected_calls_disconnect_from_message_channel();
+    disconnect_from_message_channel(remote_module);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ProxyGateway_Detach(remote_module);
 }
 
-/* SRS_PROXY_GATEWAY_027_0xx: [Special Handling - If `Module_ParseConfigurationFromJson` was provided, `invoke_add_module_procedure` shall parse the configuration by calling `void * Module_ParseConfigurationFromJson(const char * configuration)` using the `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
-TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_NULL_Module_ParseConfigurationFromJson)
+static REMOTE_MODULE_HANDLE publishing_module;
+static BROKER_RESULT publish_result_while_closing;
+
+static void publish_while_closing(SHARED_MEMORY_CHANNEL_HANDLE channel)
+{
+    (void)channel;
+    publish_result_while_closing = Broker_Publish((BROKER_HANDLE)publishing_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_037: [While the message channel is being closed, `Broker_Publish` shall drop the message and return BROKER_ERROR, and the channel shall not be closed until every `Broker_Publish` call using it has returned] */
+TEST_FUNCTION(Broker_Publish_SCENARIO_message_channel_closing)
 {
     // Arrange
-    static const CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
-        {
-            CONTROL_MESSAGE_VERSION_CURRENT,
-            CONTROL_MESSAGE_TYPE_MODULE_CREATE
-        },
-        GATEWAY_MESSAGE_VERSION_CURRENT,
-        {
-            sizeof("ipc://message_channel"),
-            NN_PAIR,
-            "ipc://message_channel"
-        },
-        sizeof("json_encoded_remote_module_parameters"),
-        "json_encoded_remote_module_parameters"
-    };
-    static const MODULE_API_1 MODULE_APIS = {
-        { MODULE_API_VERSION_1 },
-        (pfModule_ParseConfigurationFromJson)NULL,
-        mock_freeConfiguration,
-        mock_create,
-        mock_destroy,
-        mock_receive,
-        mock_start
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        MESSAGE_URI_TYPE_SHARED_MEMORY,
+        "shm://proxy_gateway_ut"
     };
 
-    int result;
-
-    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MODULE_APIS, "proxy_gateway_ut");
-    ASSERT_IS_NOT_NULL(remote_module);
+    publishing_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(publishing_module);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Open(MESSAGE.uri))
+        .SetReturn((SHARED_MEMORY_CHANNEL_HANDLE)0x5117);
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(publishing_module, &MESSAGE));
+    REGISTER_GLOBAL_MOCK_HOOK(SharedMemoryChannel_Destroy, publish_while_closing);
+    publish_result_while_closing = BROKER_OK;
 
     // Expected call listing
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mock_create((BROKER_HANDLE)remote_module, CREATE_MESSAGE.args))
-        .SetReturn(MOCK_MODULE);
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Close((SHARED_MEMORY_CHANNEL_HANDLE)0x5117));
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Destroy((SHARED_MEMORY_CHANNEL_HANDLE)0x5117));
+    expected_calls_disconnect_from_message_channel();
 
     // Act
-    result = invoke_add_module_procedure(remote_module, CREATE_MESSAGE.args);
+    disconnect_from_message_channel(publishing_module);
 
     // Assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, publish_result_while_closing);
 
     // Cleanup
-    ProxyGateway_Detach(remote_module);
+    REGISTER_GLOBAL_MOCK_HOOK(SharedMemoryChannel_Destroy, NULL);
+    ProxyGateway_Detach(publishing_module);
 }
 
-/* SRS_PROXY_GATEWAY_027_0xx: [If `Module_ParseConfigurationFromJson` was provided, `invoke_add_module_procedure` shall parse the configuration by calling `void * Module_ParseConfigurationFromJson(const char * configuration)` using the `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`invoke_add_module_procedure` shall create the remote module by calling `MODULE_HANDLE Module_Create(BROKER_HANDLE broker, const void * configuration)` using the `remote_module_handle` as `broker` and the parsed configuration value or `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [If both `Module_FreeConfiguration` and `Module_ParseConfigurationFromJson` were provided, `invoke_add_module_procedure` shall free the configuration by calling `void Module_FreeConfiguration(void * configuration)` using the value returned from `Module_ParseConfigurationFromJson` as `configuration`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [If no errors are encountered, `invoke_add_module_procedure` shall return zero] */
-TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_success)
+/* Tests_SRS_PROXY_GATEWAY_17_014: [If a call to `SharedMemoryChannel_Open` returns `NULL`, then `connect_to_message_channel` shall return a non-zero value] */
+TEST_FUNCTION(connect_to_message_channel_SCENARIO_shared_memory_open_fails)
 {
     // Arrange
-    static const CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
-        {
-            CONTROL_MESSAGE_VERSION_CURRENT,
-            CONTROL_MESSAGE_TYPE_MODULE_CREATE
-        },
-        GATEWAY_MESSAGE_VERSION_CURRENT,
-        {
-            sizeof("ipc://message_channel"),
-            NN_PAIR,
-            "ipc://message_channel"
-        },
-        sizeof("json_encoded_remote_module_parameters"),
-        "json_encoded_remote_module_parameters"
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        MESSAGE_URI_TYPE_SHARED_MEMORY,
+        "shm://proxy_gateway_ut"
     };
 
     int result;
@@ -2169,7 +2464,186 @@ TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_success)
 
     // Expected call listing
     umock_c_reset_all_calls();
-    expected_calls_invoke_add_module_procedure(remote_module, &CREATE_MESSAGE);
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Open(MESSAGE.uri))
+        .SetReturn(NULL);
+
+    // Act
+    result = connect_to_message_channel(remote_module, &MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall shutdown the Azure IoT Gateway message channel by calling `int nn_shutdown(int s, int how)`] */
+/* SRS_PROXY_GATEWAY_027_0xx: [`disconnect_from_message_channel` shall close the Azure IoT Gateway message socket by calling `int nn_close(int s)`] */
+TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_success)
+{
+    // Arrange
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_disconnect_from_message_channel();
+
+    // Act
+    disconnect_from_message_channel(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_006: [`close_message_batch` shall send the pending frame, if any, and free the batch, its mutex and its tick counter] */
+/* Tests_SRS_PROXY_GATEWAY_17_007: [`close_message_batch` shall stop accepting frames] */
+/* Tests_SRS_PROXY_GATEWAY_17_008: [`disconnect_from_message_channel` shall send any pending frame and stop accepting frames before closing the message channel] */
+TEST_FUNCTION(disconnect_from_message_channel_SCENARIO_sends_pending_frame)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+    static const void * NN_FRAME_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_FRAME_SIZE = 1979;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, NULL, 0))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_allocmsg(NN_FRAME_SIZE, 0))
+        .SetReturn((void *)NN_FRAME_BUFFER);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, (unsigned char *)NN_FRAME_BUFFER, NN_FRAME_SIZE))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_Clear(MOCK_BATCH));
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_Destroy(MOCK_BATCH));
+    STRICT_EXPECTED_CALL(Lock_Deinit(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(MOCK_TICK_COUNTER));
+    expected_calls_disconnect_from_message_channel();
+
+    // Act
+    disconnect_from_message_channel(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* SRS_PROXY_GATEWAY_027_0xx: [Special Handling - If `Module_ParseConfigurationFromJson` was provided, `invoke_add_module_procedure` shall parse the configuration by calling `void * Module_ParseConfigurationFromJson(const char * configuration)` using the `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
+TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_NULL_Module_ParseConfigurationFromJson)
+{
+    // Arrange
+    static const CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+    static const MODULE_API_1 MODULE_APIS = {
+        { MODULE_API_VERSION_1 },
+        (pfModule_ParseConfigurationFromJson)NULL,
+        mock_freeConfiguration,
+        mock_create,
+        mock_destroy,
+        mock_receive,
+        mock_start
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(mock_create((BROKER_HANDLE)remote_module, CREATE_MESSAGE.args))
+        .SetReturn(MOCK_MODULE);
+
+    // Act
+    result = invoke_add_module_procedure(remote_module, CREATE_MESSAGE.args);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* SRS_PROXY_GATEWAY_027_0xx: [If `Module_ParseConfigurationFromJson` was provided, `invoke_add_module_procedure` shall parse the configuration by calling `void * Module_ParseConfigurationFromJson(const char * configuration)` using the `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
+/* SRS_PROXY_GATEWAY_027_0xx: [`invoke_add_module_procedure` shall create the remote module by calling `MODULE_HANDLE Module_Create(BROKER_HANDLE broker, const void * configuration)` using the `remote_module_handle` as `broker` and the parsed configuration value or `CONTROL_MESSAGE_MODULE_CREATE::args` as `configuration`] */
+/* SRS_PROXY_GATEWAY_027_0xx: [If both `Module_FreeConfiguration` and `Module_ParseConfigurationFromJson` were provided, `invoke_add_module_procedure` shall free the configuration by calling `void Module_FreeConfiguration(void * configuration)` using the value returned from `Module_ParseConfigurationFromJson` as `configuration`] */
+/* SRS_PROXY_GATEWAY_027_0xx: [If no errors are encountered, `invoke_add_module_procedure` shall return zero] */
+TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_success)
+{
+    // Arrange
+    static const CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_invoke_add_module_procedure(remote_module, &CREATE_MESSAGE);
 
     // Act
     result = invoke_add_module_procedure(remote_module, CREATE_MESSAGE.args);
@@ -2236,7 +2710,7 @@ TEST_FUNCTION(invoke_add_module_procedure_SCENARIO_negative_tests)
     umock_c_negative_tests_deinit();
 }
 
-/* SRS_PROXY_GATEWAY_027_0xx: [Prerequisite Check - If the `gateway_message_version` is greater than 1, then `process_module_create_message` shall do nothing and return a non-zero value] */
+/* SRS_PROXY_GATEWAY_027_0xx: [Prerequisite Check - If the `gateway_message_version` is greater than `GATEWAY_MESSAGE_VERSION_CURRENT`, then `process_module_create_message` shall do nothing and return a non-zero value] */
 TEST_FUNCTION(process_module_create_message_SCENARIO_bad_version)
 {
     // Arrange
@@ -2445,6 +2919,107 @@ TEST_FUNCTION(process_module_create_message_SCENARIO_negative_tests)
     umock_c_negative_tests_deinit();
 }
 
+/* Tests_SRS_PROXY_GATEWAY_17_001: [`open_message_batch` shall accept the offered frame limits, so frames received on the message channel are unpacked] */
+/* Tests_SRS_PROXY_GATEWAY_17_002: [If the offered linger time is not zero, `open_message_batch` shall create a mutex by calling `LOCK_HANDLE Lock_Init(void)`, a batch by calling `MESSAGE_BATCH_HANDLE MessageBatch_Create(const MESSAGE_BATCH_LIMITS * limits)` and a tick counter by calling `TICK_COUNTER_HANDLE tickcounter_create(void)`; if any fails, it shall free the others and send messages one at a time] */
+/* Tests_SRS_PROXY_GATEWAY_17_011: [If the create message offers frame limits, `process_module_create_message` shall accept them before creating the module, and return them in its success reply] */
+/* Tests_SRS_PROXY_GATEWAY_17_012: [`send_control_reply` shall return the accepted frame limits in a success reply] */
+TEST_FUNCTION(process_module_create_message_SCENARIO_offered_frames_success)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_open_message_batch();
+    expected_calls_process_module_create_message(remote_module, &CREATE_MESSAGE, &REPLY);
+
+    // Act
+    result = process_module_create_message(remote_module, &CREATE_MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_001: [`open_message_batch` shall accept the offered frame limits, so frames received on the message channel are unpacked] */
+/* Tests_SRS_PROXY_GATEWAY_17_011: [If the create message offers frame limits, `process_module_create_message` shall accept them before creating the module, and return them in its success reply] */
+TEST_FUNCTION(process_module_create_message_SCENARIO_offered_frames_without_linger_only_receives_frames)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 0 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 0 }
+    };
+
+    int result;
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    expected_calls_process_module_create_message(remote_module, &CREATE_MESSAGE, &REPLY);
+
+    // Act
+    result = process_module_create_message(remote_module, &CREATE_MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`send_control_reply` shall calculate the serialized message size by calling `size_t ControlMessage_ToByteArray(CONTROL MESSAGE * message, unsigned char * buf, size_t size)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`send_control_reply` allocate the necessary space for the nano message, by calling `void * nn_allocmsg(size_t size, int type)` using the previously acquired message size for `size` and `0` for `type`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`send_control_reply` shall serialize a creation reply indicating the creation status by calling `size_t ControlMessage_ToByteArray(CONTROL MESSAGE * message, unsigned char * buf, size_t size)`] */
@@ -2591,12 +3166,12 @@ TEST_FUNCTION(publish_SCENARIO_create_message_success)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetReturn(NN_MESSAGE_SIZE);
-    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
         .IgnoreArgument(2)
+        .IgnoreArgument(3)
         .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
     STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, (MESSAGE_HANDLE)&CREATE_MESSAGE));
     STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&CREATE_MESSAGE));
-    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
 
     // Act
     ProxyGateway_DoWork(remote_module);
@@ -2612,7 +3187,8 @@ TEST_FUNCTION(Broker_Publish_retries_nn_send_when_it_is_interrupted)
 {
     // Arrange
     int data[100];
-    memset(&data, 1, 100);
+    // a remote module that does not send frames
+    memset(&data, 0, sizeof(data));
 
     static const int32_t msg_size = 100;
     static const void* allocated_memptr = (void*)0xEBADF00D;
@@ -2620,14 +3196,16 @@ TEST_FUNCTION(Broker_Publish_retries_nn_send_when_it_is_interrupted)
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(Message_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(IGNORED_PTR_ARG, NULL, 0))
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, NULL, 0))
         .IgnoreArgument(1)
+        .IgnoreArgument(2)
         .SetReturn(msg_size);
     STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
         .SetReturn((void*)allocated_memptr);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, msg_size))
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, msg_size))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -2651,12 +3229,881 @@ TEST_FUNCTION(Broker_Publish_retries_nn_send_when_it_is_interrupted)
 }
 
 
+/* Tests_SRS_PROXY_GATEWAY_17_034: [`process_module_create_message` shall send messages in the `gateway_message_version` of the create message, or, if the create message carries a `max_message_version`, in the lesser of it and `GATEWAY_MESSAGE_VERSION_CURRENT`] */
+/* Tests_SRS_PROXY_GATEWAY_17_035: [If the create message carried a `max_message_version`, `send_control_reply` shall return `GATEWAY_MESSAGE_VERSION_CURRENT` as the `max_message_version` of a success reply] */
+/* Tests_SRS_PROXY_GATEWAY_17_036: [`Broker_Publish` shall serialize the message in the message version agreed with the gateway] */
+TEST_FUNCTION(Broker_Publish_serializes_in_the_negotiated_message_version)
+{
+    // Arrange
+    static const int32_t msg_size = 100;
+    static const void* allocated_memptr = (void*)0xEBADF00D;
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_1,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 0, 0, 0 },
+        0,
+        GATEWAY_MESSAGE_VERSION_2
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 0, 0, 0 },
+        0,
+        GATEWAY_MESSAGE_VERSION_CURRENT
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    STRICT_EXPECTED_CALL(Message_Clone((MESSAGE_HANDLE)1));
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion((MESSAGE_HANDLE)1, GATEWAY_MESSAGE_VERSION_2, NULL, 0))
+        .SetReturn(msg_size);
+    STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
+        .SetReturn((void*)allocated_memptr);
+    STRICT_EXPECTED_CALL(Message_ToByteArrayVersion((MESSAGE_HANDLE)1, GATEWAY_MESSAGE_VERSION_2, IGNORED_PTR_ARG, msg_size))
+        .IgnoreArgument(3)
+        .SetReturn(msg_size);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(msg_size);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // Act
+    (void)Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_004: [If the remote module sends frames, `Broker_Publish` shall add the message to the pending frame, and send the frame once it is full or before a message that does not fit] */
+TEST_FUNCTION(Broker_Publish_adds_the_message_to_the_pending_frame)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+    BROKER_RESULT result;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(MOCK_TICK_COUNTER, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(MessageBatch_Add(MOCK_BATCH, (MESSAGE_HANDLE)1))
+        .SetReturn(MESSAGE_BATCH_OK);
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    result = Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_004: [If the remote module sends frames, `Broker_Publish` shall add the message to the pending frame, and send the frame once it is full or before a message that does not fit] */
+TEST_FUNCTION(Broker_Publish_sends_the_pending_frame_before_a_message_that_does_not_fit)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+    static const void * NN_FRAME_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_FRAME_SIZE = 1979;
+    BROKER_RESULT result;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(3);
+    STRICT_EXPECTED_CALL(MessageBatch_Add(MOCK_BATCH, (MESSAGE_HANDLE)1))
+        .SetReturn(MESSAGE_BATCH_NO_ROOM);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, NULL, 0))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_allocmsg(NN_FRAME_SIZE, 0))
+        .SetReturn((void *)NN_FRAME_BUFFER);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, (unsigned char *)NN_FRAME_BUFFER, NN_FRAME_SIZE))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_Clear(MOCK_BATCH));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(MOCK_TICK_COUNTER, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(MessageBatch_Add(MOCK_BATCH, (MESSAGE_HANDLE)1))
+        .SetReturn(MESSAGE_BATCH_OK);
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    result = Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_039: [`flush_message_batch` shall not block on a full message channel: it shall send with `NN_DONTWAIT`, or with a timeout on a shared memory channel, and try again while the channel is full, giving up once the channel has been closing for `FRAME_CLOSING_WAIT_MS`, so closing the channel never waits forever on a publisher sending a frame] */
+TEST_FUNCTION(Broker_Publish_sends_a_full_frame_again_while_the_gateway_is_not_keeping_up)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+    static const void * NN_FRAME_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_FRAME_SIZE = 1979;
+    BROKER_RESULT result;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(7);
+    STRICT_EXPECTED_CALL(MessageBatch_Add(MOCK_BATCH, (MESSAGE_HANDLE)1))
+        .SetReturn(MESSAGE_BATCH_FULL);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, NULL, 0))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_allocmsg(NN_FRAME_SIZE, 0))
+        .SetReturn((void *)NN_FRAME_BUFFER);
+    STRICT_EXPECTED_CALL(MessageBatch_ToByteArray(MOCK_BATCH, (unsigned char *)NN_FRAME_BUFFER, NN_FRAME_SIZE))
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_FRAME_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_Clear(MOCK_BATCH));
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    result = Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_019: [`process_module_create_message` shall accept the credit window of the create message, so the module may publish that many messages before the gateway grants more, and return it in its success reply; a window of zero turns flow control off] */
+/* Tests_SRS_PROXY_GATEWAY_17_020: [If the gateway accepted a credit window, `Broker_Publish` shall take one credit for the message, and if none is left it shall drop the message without waiting and return BROKER_ERROR, giving the credit back if the message cannot be sent] */
+TEST_FUNCTION(Broker_Publish_drops_the_message_without_credit)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 },
+        1
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 },
+        1
+    };
+    BROKER_RESULT result;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+    (void)Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+    umock_c_reset_all_calls();
+
+    // Act
+    result = Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_021: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_CREDIT, then `ProxyGateway_DoWork` shall add its credits to those the module may use to publish, up to the credit window] */
+TEST_FUNCTION(doWork_SCENARIO_credit_message_lets_the_module_publish_again)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 },
+        1
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 },
+        1
+    };
+    static const CONTROL_MESSAGE_MODULE_CREDIT CREDIT_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREDIT
+        },
+        1
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 10;
+    BROKER_RESULT result;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+    (void)Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+    umock_c_reset_all_calls();
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn((CONTROL_MESSAGE *)&CREDIT_MESSAGE);
+    STRICT_EXPECTED_CALL(ControlMessage_Destroy((CONTROL_MESSAGE *)&CREDIT_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(MOCK_TICK_COUNTER, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(MessageBatch_Add(MOCK_BATCH, (MESSAGE_HANDLE)1))
+        .SetReturn(MESSAGE_BATCH_OK);
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+    result = Broker_Publish((BROKER_HANDLE)remote_module, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_022: [Message Channel - Once the module has received at least half the credit window since the last grant, `ProxyGateway_DoWork` shall grant that many credits back to the gateway by calling `send_control_credit`, and try again on its next call if that fails] */
+/* Tests_SRS_PROXY_GATEWAY_17_023: [`send_control_credit` shall serialize and send a credit message granting `credits` to the gateway, the same way `send_control_reply` sends a reply] */
+TEST_FUNCTION(doWork_SCENARIO_grants_credits_for_received_messages)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 0 },
+        2
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 0 },
+        2
+    };
+    static const CONTROL_MESSAGE_MODULE_CREDIT CREDIT_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_CREDIT
+        },
+        1
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+    static void * NN_CREDIT_BUFFER = (void *)0xDEADBEEF;
+    static const int32_t NN_CREDIT_SIZE = 12;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(MessageBatch_IsFrame((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(MessageBatch_ForEachMessage((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE, IGNORED_PTR_ARG, remote_module))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(Message_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, NN_MESSAGE_SIZE))
+        .SetReturn((MESSAGE_HANDLE)&CREATE_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, (MESSAGE_HANDLE)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+    STRICT_EXPECTED_CALL(ControlMessage_ToByteArray((CONTROL_MESSAGE *)&CREDIT_MESSAGE, NULL, 0))
+        .SetReturn(NN_CREDIT_SIZE);
+    STRICT_EXPECTED_CALL(nn_allocmsg(NN_CREDIT_SIZE, 0))
+        .SetReturn(NN_CREDIT_BUFFER);
+    STRICT_EXPECTED_CALL(ControlMessage_ToByteArray((CONTROL_MESSAGE *)&CREDIT_MESSAGE, (unsigned char *)NN_CREDIT_BUFFER, NN_CREDIT_SIZE))
+        .SetReturn(NN_CREDIT_SIZE);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_CREDIT_SIZE);
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_025: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+TEST_FUNCTION(setWorkOptions_SCENARIO_NULL_handle)
+{
+    // Arrange
+    int result;
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+
+    // Act
+    result = ProxyGateway_SetWorkOptions(NULL, 250, 8);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // Cleanup
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_026: [Prerequisite Check - If `max_messages` is zero, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+/* Tests_SRS_PROXY_GATEWAY_17_027: [Prerequisite Check - If `wait_ms` is greater than `INT_MAX`, then `ProxyGateway_SetWorkOptions` shall do nothing and return a non-zero value] */
+TEST_FUNCTION(setWorkOptions_SCENARIO_invalid_options)
+{
+    // Arrange
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+
+    // Act
+    ASSERT_ARE_NOT_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, 250, 0));
+    ASSERT_ARE_NOT_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, (unsigned int)INT_MAX + 1, 8));
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_028: [`ProxyGateway_SetWorkOptions` shall keep `wait_ms` for the worker thread and `max_messages` for each call to `ProxyGateway_DoWork`, and return zero] */
+/* Tests_SRS_PROXY_GATEWAY_17_024: [Message Channel - `ProxyGateway_DoWork` shall pass up to the set number of messages or frames to the module, stopping early once none is left] */
+TEST_FUNCTION(doWork_SCENARIO_drains_up_to_max_messages)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+    ASSERT_ARE_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, 250, 2));
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(MOCK_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, MOCK_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy(MOCK_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(MOCK_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, MOCK_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy(MOCK_MESSAGE));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_024: [Message Channel - `ProxyGateway_DoWork` shall pass up to the set number of messages or frames to the module, stopping early once none is left] */
+TEST_FUNCTION(doWork_SCENARIO_stops_draining_once_no_message_is_left)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+    ASSERT_ARE_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, 250, 4));
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(Message_CreateFromOwnedByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG, IGNORED_PTR_ARG, (void *)NN_MESSAGE_BUFFER))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(MOCK_MESSAGE);
+    STRICT_EXPECTED_CALL(mock_receive(MOCK_MODULE, MOCK_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy(MOCK_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_029: [`wait_and_do_work` shall wait until the control socket or the message socket has a message to receive by calling `int nn_poll(struct nn_pollfd * fds, int nfds, int timeout)` with the timeout set by `ProxyGateway_SetWorkOptions`, then call `ProxyGateway_DoWork`] */
+TEST_FUNCTION(wait_and_do_work_SCENARIO_polls_the_control_socket_before_create)
+{
+    // Arrange
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, PROXY_GATEWAY_DEFAULT_WAIT_MS))
+        .IgnoreArgument(1)
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+
+    // Act
+    wait_and_do_work(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_029: [`wait_and_do_work` shall wait until the control socket or the message socket has a message to receive by calling `int nn_poll(struct nn_pollfd * fds, int nfds, int timeout)` with the timeout set by `ProxyGateway_SetWorkOptions`, then call `ProxyGateway_DoWork`] */
+TEST_FUNCTION(wait_and_do_work_SCENARIO_polls_both_sockets_for_the_set_wait)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters"
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+    ASSERT_ARE_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, 250, 1));
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 2, 250))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+
+    // Act
+    wait_and_do_work(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_030: [If the remote module sends frames, `wait_and_do_work` shall wait no longer than the accepted linger time] */
+TEST_FUNCTION(wait_and_do_work_SCENARIO_waits_no_longer_than_the_linger_time)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        { 8, 4096, 5 }
+    };
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        { 8, 4096, 5 }
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = attach_and_create_offering_frames(&CREATE_MESSAGE, &REPLY);
+
+    // Expected call listing
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 2, 5))
+        .IgnoreArgument(1)
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(Lock(MOCK_LOCK));
+    STRICT_EXPECTED_CALL(MessageBatch_GetCount(MOCK_BATCH))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(Unlock(MOCK_LOCK));
+
+    // Act
+    wait_and_do_work(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_032: [If `nn_poll` fails, `wait_and_do_work` shall sleep for the timeout by calling `void ThreadAPI_Sleep(unsigned int milliseconds)` instead, so the worker thread does not spin] */
+TEST_FUNCTION(wait_and_do_work_SCENARIO_sleeps_when_poll_fails)
+{
+    // Arrange
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 1, PROXY_GATEWAY_DEFAULT_WAIT_MS))
+        .IgnoreArgument(1)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EBADF);
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(PROXY_GATEWAY_DEFAULT_WAIT_MS));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+
+    // Act
+    wait_and_do_work(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_17_031: [If the message channel is shared memory, which cannot be polled with the sockets, `wait_and_do_work` shall do the work of `ProxyGateway_DoWork`, waiting up to the timeout for the first message of the channel] */
+TEST_FUNCTION(wait_and_do_work_SCENARIO_waits_on_the_shared_memory_channel)
+{
+    // Arrange
+    static const MESSAGE_URI MESSAGE = {
+        sizeof("shm://proxy_gateway_ut"),
+        MESSAGE_URI_TYPE_SHARED_MEMORY,
+        "shm://proxy_gateway_ut"
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Open(MESSAGE.uri))
+        .SetReturn((SHARED_MEMORY_CHANNEL_HANDLE)0x5117);
+    ASSERT_ARE_EQUAL(int, 0, connect_to_message_channel(remote_module, &MESSAGE));
+    ASSERT_ARE_EQUAL(int, 0, ProxyGateway_SetWorkOptions(remote_module, 250, 4));
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(SharedMemoryChannel_Receive((SHARED_MEMORY_CHANNEL_HANDLE)0x5117, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 250))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(SHARED_MEMORY_CHANNEL_TIMEOUT);
+
+    // Act
+    wait_and_do_work(remote_module);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to initialize the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall release the thread mutex upon entering the loop by calling `LOCK_RESULT Unlock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to release the mutex, then `worker_thread` shall exit the thread and return a non-zero value] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall invoke asynchronous processing by calling `void ProxyGateway_DoWork(REMOTE_MODULE_HANDLE remote_module)`] */
-/* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall yield its remaining quantum by calling `void THREADAPI_Sleep(unsigned int milliseconds)`] */
+/* SRS_PROXY_GATEWAY_17_033: [`worker_thread` shall wait for and process the messages of the gateway by calling `wait_and_do_work`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to check for a halt signal by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall exit the thread return a non-zero value] */
@@ -26,7 +26,7 @@ class ProxyGateway {
     this.module.receive(msg);
   }
 
-  onCreate(messageChannelId, args) {
+  onCreate(messageChannelId, args, frameLimits) {
     if (this.messageChannel) this.onDestroy();
     this.messageChannel = this.channelFactory.createMessageChannel();
     this.messageChannel.connect(messageChannelId);
@@ -35,7 +35,14 @@ class ProxyGateway {
       publish: (msg) => this.messageChannel.send(msg)
     };
     let result = this.module.create(broker, args);
-    this.controlChannel.send('create', result);
+    if (result && frameLimits) {
+      // frames only go out once the gateway has been told they are accepted
+      this.controlChannel.send('create', result, frameLimits);
+      this.messageChannel.acceptFrames(frameLimits);
+    }
+    else {
+      this.controlChannel.send('create', result);
+    }
   }
 
   onStart() {
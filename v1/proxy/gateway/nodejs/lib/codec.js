@@ -15,10 +15,54 @@ let headerBytes = {
   first: 0xA1,
   second: {
     message: 0x60,
-    control: 0x6C
+    control: 0x6C,
+    frame: 0x62
   }
 };
 
+// Byte 2 of a frame of several module messages, and the size of the frame
+// header that holds it, the frame size and the message count.
+const frameVersion = 1;
+const frameHeaderSize = 11;
+
+// Size of the most messages, most bytes and linger time that may follow the
+// args of a 'create' message and the result of a 'create' reply.
+const frameLimitsSize = 12;
+
+// Byte 2 of a version 2 module message; in version 1 it is the top byte of the
+// message size, which never has its high bit set.
+const moduleMessageVersion2 = 0x82;
+
+// Byte 2 of a version 3 module message, which is version 2 with a type at the
+// start of every value.
+const moduleMessageVersion3 = 0x83;
+
+// Types of version 3 values, in the order of MESSAGE_PROPERTY_TYPE in
+// core/inc/message.h.
+const propertyTypes = {
+  string: 0,
+  int64: 1,
+  double: 2,
+  bytes: 3,
+  timestamp: 4
+};
+
+const millisecondsPerDay = 86400000;
+
+// Property names a version 2 module message sends as ids, in the order of
+// MESSAGE_PROPERTY_ID in core/inc/message_properties.h.
+const internedPropertyNames = [
+  'source',
+  'macAddress',
+  'deviceName',
+  'deviceKey',
+  'iotHubMessageId',
+  'iotHubMessageDeliveryStatus',
+  'bleControllerIndex',
+  'timestamp',
+  'characteristicUUID'
+];
+
 let controlMessageTypes = {
     error: 0,
     create: 1,                 
@@ -75,6 +119,26 @@ function decodeMessageChannelUri(buf, offset = 0) {
   return result;
 }
 
+// Frame limits are optional; without them, or with no room for any message,
+// module messages are exchanged one at a time.
+function decodeFrameLimits(buf, offset) {
+  if (offset + frameLimitsSize > buf.length) return null;
+  let limits = {
+    maxMessages: buf.readUInt32BE(offset),
+    maxBytes: buf.readUInt32BE(offset + 4),
+    lingerMs: buf.readUInt32BE(offset + 8)
+  };
+  return (limits.maxMessages === 0 || limits.maxBytes === 0) ? null : limits;
+}
+
+function encodeFrameLimits(limits) {
+  let buffer = Buffer.alloc(frameLimitsSize);
+  buffer.writeUInt32BE(limits.maxMessages, 0);
+  buffer.writeUInt32BE(limits.maxBytes, 4);
+  buffer.writeUInt32BE(limits.lingerMs, 8);
+  return buffer;
+}
+
 function decodeCreateMessage(buf) {
   let uriResult = decodeMessageChannelUri(buf, 9);
   let startArgs = 9 + uriResult.length + 4;
@@ -84,11 +148,12 @@ function decodeCreateMessage(buf) {
     control: decodeControlMessage(buf),
     version: buf.readUInt8(8),
     messageChannelUri: uriResult.value,
-    args: buf.slice(startArgs, endArgs)
+    args: buf.slice(startArgs, endArgs),
+    frameLimits: decodeFrameLimits(buf, endArgs)
   };
 }
 
-function _encodeReplyMessage(type) {
+function _encodeReplyMessage(type, frameLimits) {
   let control = { version: 1, type: controlMessageTypes.reply };
 
   let buffers = [
@@ -96,6 +161,9 @@ function _encodeReplyMessage(type) {
     Buffer.alloc(4),  // total message size
     Buffer.from([type])
   ];
+  if (frameLimits) {
+    buffers.push(encodeFrameLimits(frameLimits));
+  }
 
   let buffer = Buffer.concat(buffers);
   buffer.writeUInt32BE(buffer.length, buffers[0].length);
@@ -103,11 +171,13 @@ function _encodeReplyMessage(type) {
   return buffer;
 }
 
-function encodeCreateReply(succeeded) {
+// A module accepts the frame limits of a 'create' message by sending them back
+// in a successful reply.
+function encodeCreateReply(succeeded, frameLimits) {
   let type = succeeded ?
     controlMessageReply.created :
     controlMessageReply.createError;
-  return _encodeReplyMessage(type);
+  return _encodeReplyMessage(type, succeeded ? frameLimits : null);
 }
 
 function encodeDetachMessage() {
@@ -176,12 +246,175 @@ function encodeModuleMessage(msg) {
   return buffer;
 }
 
+function decodeVarint(buf, offset) {
+  let value = 0;
+  for (let shift = 0; shift < 35; shift += 7) {
+    if (offset >= buf.length) {
+      break;
+    }
+    let byte = buf.readUInt8(offset++);
+    value += (byte & 0x7F) * Math.pow(2, shift);
+    if ((byte & 0x80) === 0) {
+      if (value > 0xFFFFFFFF) {
+        break;
+      }
+      return { value, offset };
+    }
+  }
+  throw new DecodeError('Length is truncated or does not fit 32 bits');
+}
+
+function decodeString(buf, offset, length) {
+  let term = offset + length;
+  if (term >= buf.length || buf.readUInt8(term) !== 0) {
+    throw new DecodeError('String is truncated or not null-terminated');
+  }
+  return { value: buf.toString('utf8', offset, term), offset: term + 1 };
+}
+
+// Writes the signed 64-bit integer at offset in decimal; Node 6 has no BigInt,
+// so the digits come from long division of its four 16-bit parts.
+function int64ToString(buf, offset) {
+  let hi = buf.readUInt32BE(offset);
+  let lo = buf.readUInt32BE(offset + 4);
+  let negative = hi >= 0x80000000;
+  if (negative) {
+    hi = ~hi >>> 0;
+    lo = (~lo >>> 0) + 1;
+    if (lo > 0xFFFFFFFF) {
+      lo = 0;
+      hi = (hi + 1) >>> 0;
+    }
+  }
+  let parts = [hi >>> 16, hi & 0xFFFF, lo >>> 16, lo & 0xFFFF];
+  let digits = '';
+  do {
+    let remainder = 0;
+    for (let i = 0; i < parts.length; i++) {
+      let current = remainder * 0x10000 + parts[i];
+      parts[i] = Math.floor(current / 10);
+      remainder = current % 10;
+    }
+    digits = remainder + digits;
+  } while (parts.some((part) => part !== 0));
+  return (negative ? '-' : '') + digits;
+}
+
+function pad(value, width) {
+  let result = String(value);
+  while (result.length < width) {
+    result = '0' + result;
+  }
+  return result;
+}
+
+// Writes milliseconds since 1970-01-01T00:00:00Z as YYYY-MM-DDTHH:MM:SS.mmmZ,
+// with H. Hinnant's civil_from_days as the gateway does, so that years before
+// 1970 or after 9999 come out the same in every language.
+function timestampToString(buf, offset) {
+  let milliseconds = buf.readInt32BE(offset) * 0x100000000 + buf.readUInt32BE(offset + 4);
+  let days = Math.floor(milliseconds / millisecondsPerDay);
+  milliseconds -= days * millisecondsPerDay;
+
+  let shifted = days + 719468;
+  let era = Math.floor(shifted / 146097);
+  let dayOfEra = shifted - era * 146097;
+  let yearOfEra = Math.floor((dayOfEra - Math.floor(dayOfEra / 1460) + Math.floor(dayOfEra / 36524) - Math.floor(dayOfEra / 146096)) / 365);
+  let dayOfYear = dayOfEra - (365 * yearOfEra + Math.floor(yearOfEra / 4) - Math.floor(yearOfEra / 100));
+  let marchMonth = Math.floor((5 * dayOfYear + 2) / 153);
+  let day = dayOfYear - Math.floor((153 * marchMonth + 2) / 5) + 1;
+  let month = marchMonth < 10 ? marchMonth + 3 : marchMonth - 9;
+  let year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+  return (year < 0 ? '-' + pad(-year, 4) : pad(year, 4)) + '-' + pad(month, 2) + '-' + pad(day, 2) +
+    'T' + pad(Math.floor(milliseconds / 3600000), 2) + ':' + pad(Math.floor(milliseconds / 60000) % 60, 2) +
+    ':' + pad(Math.floor(milliseconds / 1000) % 60, 2) + '.' + pad(milliseconds % 1000, 3) + 'Z';
+}
+
+// Decodes a version 3 value as the string the gateway would hand out for it.
+// Doubles use JavaScript's own formatting, which may pick other digits than
+// the gateway for the same double.
+function decodeTypedValue(buf, offset) {
+  if (offset >= buf.length) {
+    throw new DecodeError('Property type is missing');
+  }
+  let type = buf.readUInt8(offset++);
+  let field;
+  switch (type) {
+    case propertyTypes.string:
+      field = decodeVarint(buf, offset);
+      return decodeString(buf, field.offset, field.value);
+    case propertyTypes.bytes:
+      field = decodeVarint(buf, offset);
+      if (field.offset + field.value > buf.length) {
+        throw new DecodeError('Bytes are truncated');
+      }
+      return { value: buf.toString('hex', field.offset, field.offset + field.value), offset: field.offset + field.value };
+    case propertyTypes.int64:
+    case propertyTypes.double:
+    case propertyTypes.timestamp:
+      if (offset + 8 > buf.length) {
+        throw new DecodeError('Number is truncated');
+      }
+      return {
+        value: type === propertyTypes.int64 ? int64ToString(buf, offset) :
+          type === propertyTypes.double ? String(buf.readDoubleBE(offset)) :
+          timestampToString(buf, offset),
+        offset: offset + 8
+      };
+    default:
+      throw new DecodeError('Unknown property type');
+  }
+}
+
+function decodeModuleMessageV2(buf, typed) {
+  let field = decodeVarint(buf, 7);
+  let count = field.value;
+  let properties = {};
+
+  while (count-- > 0) {
+    field = decodeVarint(buf, field.offset);
+    let key;
+    if ((field.value & 1) !== 0) {
+      key = internedPropertyNames[Math.floor(field.value / 2)];
+      if (key === undefined) {
+        throw new DecodeError('Unknown interned property name');
+      }
+    } else {
+      field = decodeString(buf, field.offset, Math.floor(field.value / 2));
+      key = field.value;
+    }
+    if (typed) {
+      field = decodeTypedValue(buf, field.offset);
+    } else {
+      field = decodeVarint(buf, field.offset);
+      field = decodeString(buf, field.offset, field.value);
+    }
+    properties[key] = field.value;
+  }
+
+  field = decodeVarint(buf, field.offset);
+  if (field.offset + field.value !== buf.length) {
+    throw new DecodeError('Content size does not match the message size');
+  }
+
+  return {
+    properties,
+    content: buf.slice(field.offset)
+  };
+}
+
 function decodeModuleMessage(buf) {
   if (buf.readUInt8(0) !== headerBytes.first ||
     buf.readUInt8(1) !== headerBytes.second.message) {
     throw new DecodeError('Header bytes are missing or incorrect');
   }
 
+  let version = buf.readUInt8(2);
+  if (version === moduleMessageVersion2 || version === moduleMessageVersion3) {
+    return decodeModuleMessageV2(buf, version === moduleMessageVersion3);
+  }
+
   let count = buf.readUInt32BE(6);
   let obj = decodeModuleMessageProperties(buf.slice(10), count);
   let contentStart = 10 + obj.offset + 4;
@@ -193,18 +426,82 @@ function decodeModuleMessage(buf) {
   };
 }
 
+function isFrame(buf) {
+  return buf.length >= frameHeaderSize &&
+    buf.readUInt8(0) === headerBytes.first &&
+    buf.readUInt8(1) === headerBytes.second.frame &&
+    buf.readUInt8(2) === frameVersion;
+}
+
+// Packs encoded module messages, in order, into one frame.
+function encodeFrame(messages) {
+  let length = frameHeaderSize;
+  messages.forEach((msg) => {
+    length += 4 + msg.length;
+  });
+
+  let buffer = Buffer.alloc(length);
+  let offset = buffer.writeUInt8(headerBytes.first, 0);
+  offset = buffer.writeUInt8(headerBytes.second.frame, offset);
+  offset = buffer.writeUInt8(frameVersion, offset);
+  offset = buffer.writeUInt32BE(buffer.length, offset);
+  offset = buffer.writeUInt32BE(messages.length, offset);
+  messages.forEach((msg) => {
+    offset = buffer.writeUInt32BE(msg.length, offset);
+    offset += msg.copy(buffer, offset);
+  });
+
+  return buffer;
+}
+
+// Returns the encoded module messages of a frame, in order, without copying
+// them.
+function decodeFrame(buf) {
+  if (!isFrame(buf)) {
+    throw new DecodeError('Header bytes are missing or incorrect');
+  }
+  if (buf.readUInt32BE(3) !== buf.length) {
+    throw new DecodeError('Frame size does not match the size received');
+  }
+
+  let count = buf.readUInt32BE(7);
+  let offset = frameHeaderSize;
+  let messages = [];
+  while (count-- > 0) {
+    if (offset + 4 > buf.length) {
+      throw new DecodeError('Frame holds fewer messages than its count');
+    }
+    let end = offset + 4 + buf.readUInt32BE(offset);
+    if (end > buf.length) {
+      throw new DecodeError('Message goes past the end of the frame');
+    }
+    messages.push(buf.slice(offset + 4, end));
+    offset = end;
+  }
+  if (offset !== buf.length) {
+    throw new DecodeError('Bytes follow the last message of the frame');
+  }
+
+  return messages;
+}
+
 module.exports = {
   headerBytes,
+  frameHeaderSize,
   controlMessageTypes,
   controlMessageReply,
   encodeControlMessage,
   decodeControlMessage,
   decodeMessageChannelUri,
+  decodeFrameLimits,
   decodeCreateMessage,
   encodeCreateReply,
   encodeDetachMessage,
   encodeModuleMessageProperties,
   decodeModuleMessageProperties,
   encodeModuleMessage,
-  decodeModuleMessage
+  decodeModuleMessage,
+  isFrame,
+  encodeFrame,
+  decodeFrame
 };
\ No newline at end of file
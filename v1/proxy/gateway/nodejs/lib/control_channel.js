@@ -13,7 +13,7 @@ class ControlChannel extends Channel {
       let msg = codec.decodeControlMessage(data);
       if (msg.type === codec.controlMessageTypes.create) {
         msg = codec.decodeCreateMessage(data);
-        this.emit('create', msg.messageChannelUri, msg.args);
+        this.emit('create', msg.messageChannelUri, msg.args, msg.frameLimits);
       }
       else if (msg.type === codec.controlMessageTypes.start) {
         this.emit('start');
@@ -24,10 +24,10 @@ class ControlChannel extends Channel {
     });
   }
 
-  send(op, arg) {
+  send(op, arg, frameLimits) {
     let buf;
     if (op === 'create') {
-      buf = codec.encodeCreateReply(arg);
+      buf = codec.encodeCreateReply(arg, frameLimits);
     }
     else if (op === 'detach') {
       buf = codec.encodeDetachMessage();
@@ -9,15 +9,74 @@ let codec = require('./codec.js');
 class MessageChannel extends Channel {
   constructor() {
     super();
+    this.frameLimits = null;
+    this.pending = [];
+    this.pendingBytes = codec.frameHeaderSize;
+    this.lingerTimer = null;
     super.on('data', (data) => {
-      this.emit('message', codec.decodeModuleMessage(data));
+      if (this.frameLimits && codec.isFrame(data)) {
+        codec.decodeFrame(data).forEach((buf) => {
+          this.emit('message', codec.decodeModuleMessage(buf));
+        });
+      }
+      else {
+        this.emit('message', codec.decodeModuleMessage(data));
+      }
     });
   }
 
+  // Once the gateway has been sent back the frame limits it offered, messages
+  // go out in frames of at most limits.maxMessages messages and
+  // limits.maxBytes bytes, each sent when full or limits.lingerMs after its
+  // first message was queued. A message too large to share a frame goes out
+  // alone.
+  acceptFrames(limits) {
+    this.frameLimits = limits;
+  }
+
   send(msg) {
     let buf = codec.encodeModuleMessage(msg);
+    if (!this.frameLimits) {
+      super.send(buf);
+      return;
+    }
+
+    let size = 4 + buf.length;
+    if (this.pending.length > 0 && this.pendingBytes + size > this.frameLimits.maxBytes) {
+      this.flush();
+    }
+    this.pending.push(buf);
+    this.pendingBytes += size;
+
+    if (this.pending.length >= this.frameLimits.maxMessages ||
+      this.pendingBytes >= this.frameLimits.maxBytes) {
+      this.flush();
+    }
+    else if (this.lingerTimer === null) {
+      this.lingerTimer = setTimeout(() => this.flush(), this.frameLimits.lingerMs);
+    }
+  }
+
+  // Sends the queued messages now; a lone message is sent without a frame.
+  flush() {
+    if (this.lingerTimer !== null) {
+      clearTimeout(this.lingerTimer);
+      this.lingerTimer = null;
+    }
+    if (this.pending.length === 0) return;
+
+    let buf = (this.pending.length === 1) ?
+      this.pending[0] :
+      codec.encodeFrame(this.pending);
+    this.pending = [];
+    this.pendingBytes = codec.frameHeaderSize;
     super.send(buf);
   }
+
+  disconnect() {
+    this.flush();
+    super.disconnect();
+  }
 }
 
-module.exports = MessageChannel;
\ No newline at end of file
+module.exports = MessageChannel;
@@ -12,10 +12,12 @@ let DecodeError = require('../lib/exceptions.js').DecodeError;
 let EncodeError = require('../lib/exceptions.js').EncodeError;
 let makeControlMessage = require('./test_messages.js').makeControlMessage;
 let makeMessageChannelUri = require('./test_messages.js').makeMessageChannelUri;
+let makeFrameLimits = require('./test_messages.js').makeFrameLimits;
 let makeCreateMessage = require('./test_messages.js').makeCreateMessage;
 let makeCreateReply = require('./test_messages.js').makeCreateReply;
 let makeModuleMessageProperties = require('./test_messages.js').makeModuleMessageProperties;
 let makeModuleMessage = require('./test_messages.js').makeModuleMessage;
+let makeFrame = require('./test_messages.js').makeFrame;
 
 require('chai').should();
 
@@ -116,6 +118,29 @@ describe('Codec', () => {
       let msg = makeCreateMessage(128);
       codec.decodeCreateMessage(msg.buffer).should.eql(msg.object);
     });
+
+    it('decodes the frame limits that follow the module args', () => {
+      let msg = makeCreateMessage(undefined, makeFrameLimits());
+      codec.decodeCreateMessage(msg.buffer).should.eql(msg.object);
+    });
+
+    it('ignores the bytes that follow the frame limits', () => {
+      let msg = makeCreateMessage(128, makeFrameLimits());
+      codec.decodeCreateMessage(msg.buffer).should.eql(msg.object);
+    });
+  });
+
+  describe('#decodeFrameLimits', () => {
+    it('returns null if the limits do not fit the buffer', () => {
+      let limits = makeFrameLimits();
+      (codec.decodeFrameLimits(limits.buffer.slice(0, -1), 0) === null).should.be.true;
+    });
+
+    it('returns null if a frame cannot hold any message', () => {
+      let limits = makeFrameLimits();
+      limits.buffer.writeUInt32BE(0, 4);
+      (codec.decodeFrameLimits(limits.buffer, 0) === null).should.be.true;
+    });
   });
 
   describe('#encodeCreateReply', () => {
@@ -128,6 +153,17 @@ describe('Codec', () => {
       let msg = makeCreateReply(false);
       codec.encodeCreateReply(false).should.eql(msg.buffer);
     });
+
+    it("sends back the frame limits in a successful 'create' reply message", () => {
+      let limits = makeFrameLimits();
+      let msg = makeCreateReply(true, limits);
+      codec.encodeCreateReply(true, limits.object).should.eql(msg.buffer);
+    });
+
+    it("leaves the frame limits out of a failed 'create' reply message", () => {
+      let msg = makeCreateReply(false);
+      codec.encodeCreateReply(false, makeFrameLimits().object).should.eql(msg.buffer);
+    });
   });
 
   describe('#encodeModuleMessageProperties', () => {
@@ -267,5 +303,155 @@ describe('Codec', () => {
       codec.decodeModuleMessage(msg.buffer)
         .should.eql(msg.object);
     });
+
+    it('decodes a version 2 message', () => {
+      let buf = Buffer.from([
+        0xA1, 0x60, 0x82, 0x00, 0x00, 0x00, 0x18,
+        0x02,                         // two properties
+        0x01, 0x01, 0x78, 0x00,       // interned 'source' = 'x'
+        0x04, 0x61, 0x62, 0x00,       // 'ab'
+        0x02, 0x63, 0x64, 0x00,       // = 'cd'
+        0x03, 0x01, 0x02, 0x03        // content
+      ]);
+      codec.decodeModuleMessage(buf)
+        .should.eql({
+          properties: { source: 'x', ab: 'cd' },
+          content: Buffer.from([1, 2, 3])
+        });
+    });
+
+    it('throws when a version 2 length goes past the end of the message', () => {
+      let fn = () => {
+        let buf = Buffer.from([0xA1, 0x60, 0x82, 0x00, 0x00, 0x00, 0x0B, 0x01, 0x01, 0x09, 0x00]);
+        codec.decodeModuleMessage(buf);
+      };
+
+      fn.should.throw(DecodeError);
+    });
+
+    it('throws when a version 2 message uses an unknown interned name', () => {
+      let fn = () => {
+        let buf = Buffer.from([0xA1, 0x60, 0x82, 0x00, 0x00, 0x00, 0x0C, 0x01, 0x13, 0x00, 0x00, 0x00]);
+        codec.decodeModuleMessage(buf);
+      };
+
+      fn.should.throw(DecodeError, 'Unknown interned property name');
+    });
+
+    it('decodes a version 3 message as strings', () => {
+      let buf = Buffer.from([
+        0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 0x37,
+        0x05,                         // five properties
+        0x01, 0x00, 0x01, 0x78, 0x00, // interned 'source' = string 'x'
+        0x0D, 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF4, // interned 'bleControllerIndex' = int64 -12
+        0x0F, 0x04, 0x00, 0x00, 0x01, 0x58, 0x87, 0x14, 0x4F, 0xC3, // interned 'timestamp'
+        0x02, 0x74, 0x00, 0x02, 0x40, 0x35, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, // 't' = double 21.5
+        0x02, 0x62, 0x00, 0x03, 0x03, 0x00, 0xAB, 0x10, // 'b' = bytes
+        0x01, 0x07                    // content
+      ]);
+      codec.decodeModuleMessage(buf)
+        .should.eql({
+          properties: {
+            source: 'x',
+            bleControllerIndex: '-12',
+            timestamp: '2016-11-21T13:30:05.123Z',
+            t: '21.5',
+            b: '00ab10'
+          },
+          content: Buffer.from([7])
+        });
+    });
+
+    it('decodes version 3 integers and timestamps at their limits', () => {
+      let buf = Buffer.from([
+        0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 0x2D,
+        0x03,
+        0x02, 0x61, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 'a' = int64 minimum
+        0x02, 0x62, 0x00, 0x01, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 'b' = int64 maximum
+        0x02, 0x63, 0x00, 0x04, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 'c' = timestamp -1
+        0x00
+      ]);
+      codec.decodeModuleMessage(buf).properties
+        .should.eql({
+          a: '-9223372036854775808',
+          b: '9223372036854775807',
+          c: '1969-12-31T23:59:59.999Z'
+        });
+    });
+
+    it('throws when a version 3 message uses an unknown type', () => {
+      let fn = () => {
+        let buf = Buffer.from([0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 0x0C, 0x01, 0x01, 0x05, 0x00, 0x00]);
+        codec.decodeModuleMessage(buf);
+      };
+
+      fn.should.throw(DecodeError, 'Unknown property type');
+    });
+
+    it('throws when a version 3 number goes past the end of the message', () => {
+      let fn = () => {
+        let buf = Buffer.from([0xA1, 0x60, 0x83, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00]);
+        codec.decodeModuleMessage(buf);
+      };
+
+      fn.should.throw(DecodeError, 'Number is truncated');
+    });
+  });
+
+  describe('#isFrame', () => {
+    it('recognizes a frame', () => {
+      codec.isFrame(makeFrame([])).should.be.true;
+    });
+
+    it('does not mistake a module message for a frame', () => {
+      codec.isFrame(makeModuleMessage().buffer).should.be.false;
+    });
+
+    it('does not recognize a later frame version', () => {
+      codec.isFrame(fuzzMessage(makeFrame([]), 2, 2)).should.be.false;
+    });
+  });
+
+  describe('#encodeFrame', () => {
+    it('encodes an empty frame', () => {
+      codec.encodeFrame([]).should.eql(makeFrame([]));
+    });
+
+    it('encodes module messages in order', () => {
+      let messages = [makeModuleMessage().buffer, Buffer.from('abc')];
+      codec.encodeFrame(messages).should.eql(makeFrame(messages));
+    });
+  });
+
+  describe('#decodeFrame', () => {
+    it('decodes module messages in order', () => {
+      let messages = [makeModuleMessage().buffer, Buffer.alloc(0), Buffer.from('abc')];
+      codec.decodeFrame(makeFrame(messages)).should.eql(messages);
+    });
+
+    it('throws when the buffer is not a frame', () => {
+      let fn = () => codec.decodeFrame(makeModuleMessage().buffer);
+      fn.should.throw(DecodeError, 'Header bytes are missing or incorrect');
+    });
+
+    it('throws when the frame size does not match the buffer', () => {
+      let fn = () => codec.decodeFrame(makeFrame([Buffer.from('abc')]).slice(0, -1));
+      fn.should.throw(DecodeError, 'Frame size does not match the size received');
+    });
+
+    it('throws when a message goes past the end of the frame', () => {
+      let fn = () => codec.decodeFrame(fuzzMessage(makeFrame([Buffer.from('abc')]), 14, 4));
+      fn.should.throw(DecodeError, 'Message goes past the end of the frame');
+    });
+
+    it('throws when the frame holds fewer messages than its count', () => {
+      let fn = () => codec.decodeFrame(fuzzMessage(makeFrame([Buffer.from('abc')]), 10, 2));
+      fn.should.throw(DecodeError, 'Frame holds fewer messages than its count');
+    });
+
+    it('throws when bytes follow the last message', () => {
+      let fn = () => codec.decodeFrame(fuzzMessage(makeFrame([Buffer.from('abc')]), 10, 0));
+      fn.should.throw(DecodeError, 'Bytes follow the last message of the frame');
+    });
   });
 });
\ No newline at end of file
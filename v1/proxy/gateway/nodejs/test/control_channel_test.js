@@ -5,6 +5,7 @@
 
 let TestEndpoint = require('./test_endpoint.js');
 let ControlChannel = require('../lib/control_channel.js');
+let makeFrameLimits = require('./test_messages.js').makeFrameLimits;
 let makeCreateMessage = require('./test_messages.js').makeCreateMessage;
 let makeCreateReply = require('./test_messages.js').makeCreateReply;
 let makeStartMessage = require('./test_messages.js').makeStartMessage;
@@ -69,6 +70,48 @@ describe('ControlChannel', () => {
       .should.eventually.deep.equal(expected);
   });
 
+  it("can receive the frame limits of a 'create' message", () => {
+    let sender = new TestEndpoint(uri);
+
+    let ch = new ControlChannel();
+    ch.connect(uri);
+
+    return new Promise((resolve) => {
+      let createMessage = makeCreateMessage(undefined, makeFrameLimits());
+
+      ch.on('create', (uri, args, frameLimits) => {
+        ch.disconnect();
+        sender.close();
+
+        frameLimits.should.eql(createMessage.object.frameLimits);
+
+        resolve();
+      });
+
+      sender.send(createMessage.buffer);
+    });
+  });
+
+  it("can send a 'create' reply message that accepts frames", () => {
+    let ch = new ControlChannel();
+    let listener = new TestEndpoint(uri);
+
+    listener.receive().then(() => {
+      ch.disconnect();
+      listener.close();
+    });
+
+    let limits = makeFrameLimits();
+
+    ch.connect(uri);
+    ch.send('create', true, limits.object);
+
+    let expected = makeCreateReply(true, limits).buffer;
+
+    return listener.receive()
+      .should.eventually.deep.equal(expected);
+  });
+
   it("can receive a 'start' message", () => {
     let sender = new TestEndpoint(uri);
 
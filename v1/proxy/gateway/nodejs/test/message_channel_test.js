@@ -6,6 +6,7 @@
 let TestEndpoint = require('./test_endpoint.js');
 let MessageChannel = require('../lib/message_channel.js');
 let makeModuleMessage = require('./test_messages.js').makeModuleMessage;
+let makeFrame = require('./test_messages.js').makeFrame;
 let uuid = require('uuid');
 
 require('chai').should();
@@ -52,4 +53,90 @@ describe('MessageChannel', () => {
     return listener.receive()
       .should.eventually.deep.equal(message.buffer);
   });
+
+  it('can receive a frame of messages once frames are accepted', () => {
+    let sender = new TestEndpoint(uri);
+
+    let ch = new MessageChannel();
+    ch.acceptFrames({ maxMessages: 2, maxBytes: 4096, lingerMs: 0 });
+    ch.connect(uri);
+
+    return new Promise((resolve) => {
+      let moduleMessage = makeModuleMessage();
+      let received = [];
+
+      ch.on('message', (msg) => {
+        received.push(msg);
+        if (received.length === 2) {
+          ch.disconnect();
+          sender.close();
+
+          received.should.eql([moduleMessage.object, moduleMessage.object]);
+
+          resolve();
+        }
+      });
+
+      sender.send(makeFrame([moduleMessage.buffer, moduleMessage.buffer]));
+    });
+  });
+
+  it('sends a frame once it holds the most messages allowed', () => {
+    let ch = new MessageChannel();
+    let listener = new TestEndpoint(uri);
+
+    listener.receive().then(() => {
+      ch.disconnect();
+      listener.close();
+    });
+
+    let message = makeModuleMessage();
+
+    ch.acceptFrames({ maxMessages: 2, maxBytes: 4096, lingerMs: 60000 });
+    ch.connect(uri);
+    ch.send(message.object);
+    ch.send(message.object);
+
+    return listener.receive()
+      .should.eventually.deep.equal(makeFrame([message.buffer, message.buffer]));
+  });
+
+  it('sends the queued messages after the linger time', () => {
+    let ch = new MessageChannel();
+    let listener = new TestEndpoint(uri);
+
+    listener.receive().then(() => {
+      ch.disconnect();
+      listener.close();
+    });
+
+    let message = makeModuleMessage();
+
+    ch.acceptFrames({ maxMessages: 3, maxBytes: 4096, lingerMs: 10 });
+    ch.connect(uri);
+    ch.send(message.object);
+    ch.send(message.object);
+
+    return listener.receive()
+      .should.eventually.deep.equal(makeFrame([message.buffer, message.buffer]));
+  });
+
+  it('sends a message too large to share a frame on its own', () => {
+    let ch = new MessageChannel();
+    let listener = new TestEndpoint(uri);
+
+    listener.receive().then(() => {
+      ch.disconnect();
+      listener.close();
+    });
+
+    let message = makeModuleMessage();
+
+    ch.acceptFrames({ maxMessages: 3, maxBytes: 16, lingerMs: 60000 });
+    ch.connect(uri);
+    ch.send(message.object);
+
+    return listener.receive()
+      .should.eventually.deep.equal(message.buffer);
+  });
 });
\ No newline at end of file
@@ -19,6 +19,7 @@ class TestChannel extends EventEmitter {
     this.onConnect = onConnect;
     this.onDisconnect = onDisconnect;
     this.sendCalledWith = {};
+    this.frameLimits = null;
   }
 
   connect(id) {
@@ -30,10 +31,16 @@ class TestChannel extends EventEmitter {
     this.onDisconnect(this);
   }
 
-  send(arg1, arg2) {
+  send(arg1, arg2, arg3) {
     this.sendCalledWith = (arg2 === undefined) ?
       { arg1 } :
-      { arg1, arg2 };
+      (arg3 === undefined) ?
+        { arg1, arg2 } :
+        { arg1, arg2, arg3 };
+  }
+
+  acceptFrames(limits) {
+    this.frameLimits = limits;
   }
 }
 
@@ -238,6 +245,20 @@ describe('ProxyGateway', () => {
       proxy.onCreate("don't care");
       chfac.get('ctl').sendCalledWith.should.eql({ arg1: 'create', arg2: false });
     });
+
+    it('accepts the frame limits offered by the gateway', () => {
+      let limits = { maxMessages: 3, maxBytes: 4096, lingerMs: 5 };
+      proxy.onCreate("don't care", 'args', limits);
+      chfac.get('ctl').sendCalledWith.should.eql({ arg1: 'create', arg2: true, arg3: limits });
+      chfac.get("don't care").frameLimits.should.eql(limits);
+    });
+
+    it('does not accept frame limits when module creation fails', () => {
+      module.failCreate = true;
+      proxy.onCreate("don't care", 'args', { maxMessages: 3, maxBytes: 4096, lingerMs: 5 });
+      chfac.get('ctl').sendCalledWith.should.eql({ arg1: 'create', arg2: false });
+      (chfac.get("don't care").frameLimits === null).should.be.true;
+    });
   });
 
   describe('#onMessage', () => {
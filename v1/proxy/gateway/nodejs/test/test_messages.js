@@ -43,7 +43,18 @@ function makeMessageChannelUri(uri, buffer, offset = 0) {
   return { buffer, object };
 }
 
-function makeCreateMessage(bufferLength) {
+function makeFrameLimits() {
+  let object = { maxMessages: 3, maxBytes: 4096, lingerMs: 5 };
+
+  let buffer = Buffer.alloc(12);
+  buffer.writeUInt32BE(object.maxMessages, 0);
+  buffer.writeUInt32BE(object.maxBytes, 4);
+  buffer.writeUInt32BE(object.lingerMs, 8);
+
+  return { buffer, object };
+}
+
+function makeCreateMessage(bufferLength, frameLimits) {
   let uri = makeMessageChannelUri('abc');
 
   let buffers = [
@@ -54,6 +65,9 @@ function makeCreateMessage(bufferLength) {
     Buffer.alloc(4),  // args size
     Buffer.from('xyz')
   ];
+  if (frameLimits) {
+    buffers.push(frameLimits.buffer);
+  }
 
   let buffer = Buffer.concat(buffers, bufferLength);
 
@@ -64,13 +78,14 @@ function makeCreateMessage(bufferLength) {
     control: { version: 1, type: controlMessageTypes.create },
     version: 1,
     messageChannelUri: uri.object,
-    args: Buffer.from('xyz')
+    args: Buffer.from('xyz'),
+    frameLimits: frameLimits ? frameLimits.object : null
   };
 
   return { buffer, object };
 }
 
-function makeCreateReply(createSucceeded) {
+function makeCreateReply(createSucceeded, frameLimits) {
   let result = createSucceeded ?
     controlMessageReply.created :
     controlMessageReply.createError;
@@ -85,6 +100,9 @@ function makeCreateReply(createSucceeded) {
     Buffer.alloc(4),  // total message size
     Buffer.from([result])
   ];
+  if (frameLimits) {
+    buffers.push(frameLimits.buffer);
+  }
 
   let buffer = Buffer.concat(buffers);
 
@@ -154,14 +172,31 @@ function makeModuleMessage() {
   return { buffer, object };
 }
 
+function makeFrame(messages) {
+  let buffers = [Buffer.from([header.first, header.second.frame, 1]), Buffer.alloc(8)];
+  messages.forEach((msg) => {
+    let size = Buffer.alloc(4);
+    size.writeUInt32BE(msg.length, 0);
+    buffers.push(size, msg);
+  });
+
+  let buffer = Buffer.concat(buffers);
+  buffer.writeUInt32BE(buffer.length, 3);
+  buffer.writeUInt32BE(messages.length, 7);
+
+  return buffer;
+}
+
 module.exports = {
   makeControlMessage,
   makeMessageChannelUri,
+  makeFrameLimits,
   makeCreateMessage,
   makeCreateReply,
   makeStartMessage,
   makeDestroyMessage,
   makeDetachMessage,
   makeModuleMessageProperties,
-  makeModuleMessage
+  makeModuleMessage,
+  makeFrame
 };
\ No newline at end of file
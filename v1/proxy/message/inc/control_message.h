@@ -25,12 +25,19 @@ extern "C"
 #define CONTROL_MESSAGE_VERSION_1           0x01
 #define CONTROL_MESSAGE_VERSION_CURRENT     CONTROL_MESSAGE_VERSION_1
 
+/** @brief    The type of a message channel URI naming a shared memory channel
+ *            (see shared_memory_channel.h). Any other type is the nanomsg
+ *            protocol of a socket.
+ */
+#define MESSAGE_URI_TYPE_SHARED_MEMORY      0xF1
+
 #define CONTROL_MESSAGE_TYPE_VALUES      \
     CONTROL_MESSAGE_TYPE_ERROR,          \
     CONTROL_MESSAGE_TYPE_MODULE_CREATE,  \
     CONTROL_MESSAGE_TYPE_MODULE_REPLY, \
     CONTROL_MESSAGE_TYPE_MODULE_START,   \
-    CONTROL_MESSAGE_TYPE_MODULE_DESTROY
+    CONTROL_MESSAGE_TYPE_MODULE_DESTROY, \
+    CONTROL_MESSAGE_TYPE_MODULE_CREDIT
 
 /** @brief    Enumeration specifying the various types of control messages that
  *            can be sent from a gateway process to a module host process.
@@ -70,6 +77,31 @@ typedef struct MESSAGE_URI_TAG
     char*  uri;
 }MESSAGE_URI;
 
+/** @brief    Defines the limits of the multi-message frames sent on the
+ *            message channel.
+ *
+ *  @details  The gateway offers these limits in the "create" control message
+ *            and the module host process accepts them by returning them in
+ *            its reply. Frames are only sent once both sides have agreed.
+ */
+typedef struct MESSAGE_BATCH_LIMITS_TAG
+{
+    /** @brief  The most messages a frame may carry. Zero means frames are not
+     *          used, and the limits are not serialized.
+     */
+    uint32_t max_messages;
+
+    /** @brief  The most bytes a frame may take, including its header. A
+     *          message too large to share a frame is sent alone in one.
+     */
+    uint32_t max_bytes;
+
+    /** @brief  The longest time, in milliseconds, a message may wait for a
+     *          frame to fill before the frame is sent.
+     */
+    uint32_t linger_ms;
+}MESSAGE_BATCH_LIMITS;
+
 /** @brief    Defines the structure of the message that is sent for the
  *            "create" control message.
  */
@@ -96,6 +128,24 @@ typedef struct CONTROL_MESSAGE_MODULE_CREATE_TAG
      */
     char* args;
 
+    /** @brief  The multi-message frame limits the gateway offers. Optional;
+     *          all zero when the gateway does not offer frames.
+     */
+    MESSAGE_BATCH_LIMITS batch_limits;
+
+    /** @brief  The most messages either side may have in flight to the other
+     *          before it is granted credits. Optional; zero when the gateway
+     *          does not use flow control.
+     */
+    uint32_t credit_window;
+
+    /** @brief  The highest gateway message version the gateway reads, which
+     *          the module host process may send once it has replied with
+     *          its own. Optional; zero when the gateway does not say, and
+     *          then both sides keep to `gateway_message_version`.
+     */
+    uint8_t max_message_version;
+
 }CONTROL_MESSAGE_MODULE_CREATE;
 
 /** @brief    Defines the structure of the message that is sent in reply to the
@@ -112,8 +162,40 @@ typedef struct CONTROL_MESSAGE_MODULE_REPLY_TAG
      *          indicate success and the value 0 to indicate failure.
      */
     uint8_t status;
+
+    /** @brief  The multi-message frame limits the module host process
+     *          accepted. Optional; all zero when it declined them.
+     */
+    MESSAGE_BATCH_LIMITS batch_limits;
+
+    /** @brief  The credit window the module host process accepted. Optional;
+     *          zero when it does not use flow control.
+     */
+    uint32_t credit_window;
+
+    /** @brief  The highest gateway message version the module host process
+     *          reads. Optional; zero when it only reads version 1, and only
+     *          sent in reply to a create message that had one.
+     */
+    uint8_t max_message_version;
 }CONTROL_MESSAGE_MODULE_REPLY;
 
+/** @brief    Defines the structure of the "credit" control message, which
+ *            either side sends once it has consumed messages from the message
+ *            channel, so the other side may send that many more.
+ */
+typedef struct CONTROL_MESSAGE_MODULE_CREDIT_TAG
+{
+    /** @brief  The "base" message information.
+     */
+    CONTROL_MESSAGE base;
+
+    /** @brief  The number of messages the receiver of this control message
+     *          may send in addition to those it already may.
+     */
+    uint32_t credits;
+}CONTROL_MESSAGE_MODULE_CREDIT;
+
 
 /** @brief      Creates a new control message from a byte array
  *              containing the serialized form.
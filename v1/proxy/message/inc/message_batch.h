@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_batch.h
+ *  @brief      Packs several serialized gateway messages into one frame sent
+ *              on the out of process message channel, and unpacks them.
+ *
+ *  @details    A frame is only sent once both sides of the channel agreed on
+ *              the #MESSAGE_BATCH_LIMITS exchanged in the "create" control
+ *              message and its reply. The frame layout is described in
+ *              message_format.md.
+ */
+
+#ifndef MESSAGE_BATCH_H
+#define MESSAGE_BATCH_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+#include "gateway_export.h"
+#include "message.h"
+#include "control_message.h"
+
+#define MESSAGE_BATCH_FRAME_VERSION_1       0x01
+#define MESSAGE_BATCH_FRAME_VERSION_CURRENT MESSAGE_BATCH_FRAME_VERSION_1
+
+/** @brief  The size of the frame header: two marker bytes, the version, the
+ *          total size and the message count.
+ */
+#define MESSAGE_BATCH_FRAME_HEADER_SIZE     11
+
+#define MESSAGE_BATCH_RESULT_VALUES \
+    MESSAGE_BATCH_OK, \
+    MESSAGE_BATCH_FULL, \
+    MESSAGE_BATCH_NO_ROOM, \
+    MESSAGE_BATCH_ERROR
+
+/** @brief  Enumeration describing the result of #MessageBatch_Add.
+ *
+ *  @details    MESSAGE_BATCH_OK means the message was added and more may
+ *              follow. MESSAGE_BATCH_FULL means the message was added and the
+ *              batch reached one of its limits, so it should be sent.
+ *              MESSAGE_BATCH_NO_ROOM means the message was not added because
+ *              it does not fit; send the batch, clear it and add the message
+ *              again.
+ */
+DEFINE_ENUM(MESSAGE_BATCH_RESULT, MESSAGE_BATCH_RESULT_VALUES);
+
+typedef struct MESSAGE_BATCH_TAG* MESSAGE_BATCH_HANDLE;
+
+/** @brief  Function called by #MessageBatch_ForEachMessage for each
+ *          serialized message in a frame.
+ */
+typedef void(*MESSAGE_BATCH_ON_MESSAGE)(void* context, const unsigned char* source, int32_t size);
+
+/** @brief      Creates an empty batch.
+ *
+ *  @param      limits  The agreed limits. @c max_messages and @c max_bytes
+ *                      must not be zero.
+ *
+ *  @return     A non-NULL #MESSAGE_BATCH_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_BATCH_HANDLE, MessageBatch_Create, const MESSAGE_BATCH_LIMITS*, limits);
+
+/** @brief      Destroys a batch and the messages it holds.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageBatch_Destroy, MESSAGE_BATCH_HANDLE, batch);
+
+/** @brief      Adds a message to a batch.
+ *
+ *  @details    The batch keeps a clone of @c message and its serialized
+ *              form, so the caller still owns @c message. The first message
+ *              of a batch is always added, however large it is.
+ *
+ *  @return     A #MESSAGE_BATCH_RESULT value.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_BATCH_RESULT, MessageBatch_Add, MESSAGE_BATCH_HANDLE, batch, MESSAGE_HANDLE, message);
+
+/** @brief      Returns the number of messages in a batch.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch);
+
+/** @brief      Writes a batch as a frame.
+ *
+ *  @details    If @c buf is NULL and @c size is zero, returns the size of
+ *              the frame. The batch is left unchanged.
+ *
+ *  @return     The size of the frame, or a negative value upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, MessageBatch_ToByteArray, MESSAGE_BATCH_HANDLE, batch, unsigned char*, buf, int32_t, size);
+
+/** @brief      Destroys the messages held by a batch and makes it empty.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageBatch_Clear, MESSAGE_BATCH_HANDLE, batch);
+
+/** @brief      Returns true if @c source starts with a frame header rather
+ *              than a single serialized message.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT bool, MessageBatch_IsFrame, const unsigned char*, source, int32_t, size);
+
+/** @brief      Calls @c on_message for each serialized message in a frame,
+ *              in the order they were added.
+ *
+ *  @details    The whole frame is checked before the first call, so a
+ *              malformed frame delivers no messages. The bytes passed to
+ *              @c on_message point into @c source.
+ *
+ *  @return     Zero upon success, non-zero if the frame is malformed.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageBatch_ForEachMessage, const unsigned char*, source, int32_t, size, MESSAGE_BATCH_ON_MESSAGE, on_message, void*, context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_BATCH_H*/
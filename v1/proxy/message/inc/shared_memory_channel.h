@@ -0,0 +1,126 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       shared_memory_channel.h
+ *  @brief      A message channel between the gateway and a module host process
+ *              on the same machine, made of one ring of shared memory for each
+ *              direction.
+ *
+ *  @details    The gateway creates the channel and the module host process
+ *              opens it, once the "create" control message gives it the
+ *              channel's URI with #MESSAGE_URI_TYPE_SHARED_MEMORY as its type.
+ *              A buffer sent on the channel is copied into the ring once, and
+ *              received in place, without going through the kernel. A side
+ *              waiting for a buffer, or for room in a full ring, sleeps until
+ *              the other side wakes it.
+ */
+
+#ifndef SHARED_MEMORY_CHANNEL_H
+#define SHARED_MEMORY_CHANNEL_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+#include "gateway_export.h"
+
+/** @brief  The start of a shared memory channel URI; the rest names the
+ *          shared memory.
+ */
+#define SHARED_MEMORY_CHANNEL_URI_HEAD      "shm://"
+
+#define SHARED_MEMORY_CHANNEL_VERSION_1     0x01
+
+/** @brief  The smallest and largest size of each ring. Sizes in between are
+ *          rounded up to a power of two.
+ */
+#define SHARED_MEMORY_CHANNEL_RING_SIZE_MIN     4096
+#define SHARED_MEMORY_CHANNEL_RING_SIZE_MAX     (1U << 30)
+
+#define SHARED_MEMORY_CHANNEL_RESULT_VALUES \
+    SHARED_MEMORY_CHANNEL_OK, \
+    SHARED_MEMORY_CHANNEL_TIMEOUT, \
+    SHARED_MEMORY_CHANNEL_CLOSED, \
+    SHARED_MEMORY_CHANNEL_ERROR
+
+/** @brief  Enumeration describing the result of sending or receiving on a
+ *          shared memory channel.
+ */
+DEFINE_ENUM(SHARED_MEMORY_CHANNEL_RESULT, SHARED_MEMORY_CHANNEL_RESULT_VALUES);
+
+typedef struct SHARED_MEMORY_CHANNEL_TAG* SHARED_MEMORY_CHANNEL_HANDLE;
+
+/** @brief      Creates a channel; called by the gateway.
+ *
+ *  @param      uri         #SHARED_MEMORY_CHANNEL_URI_HEAD followed by a
+ *                          name without '/'.
+ *  @param      ring_size   The bytes in each ring. A buffer larger than
+ *                          about this size cannot be sent.
+ *
+ *  @return     A non-NULL #SHARED_MEMORY_CHANNEL_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_CHANNEL_HANDLE, SharedMemoryChannel_Create, const char*, uri, uint32_t, ring_size);
+
+/** @brief      Opens the channel the gateway created; called by the module
+ *              host process.
+ *
+ *  @return     A non-NULL #SHARED_MEMORY_CHANNEL_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_CHANNEL_HANDLE, SharedMemoryChannel_Open, const char*, uri);
+
+/** @brief      Wakes any thread of this process waiting on the channel, and
+ *              makes every later send or receive return
+ *              #SHARED_MEMORY_CHANNEL_CLOSED.
+ *
+ *  @details    The channel stays mapped until #SharedMemoryChannel_Destroy,
+ *              so threads still using it can finish.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SharedMemoryChannel_Close, SHARED_MEMORY_CHANNEL_HANDLE, channel);
+
+/** @brief      Closes and unmaps the channel. The gateway's call also removes
+ *              the shared memory.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SharedMemoryChannel_Destroy, SHARED_MEMORY_CHANNEL_HANDLE, channel);
+
+/** @brief      Copies a buffer into the outgoing ring.
+ *
+ *  @details    Several threads may send on the same channel. If the ring is
+ *              full, waits for room for up to @c timeout_ms milliseconds, or
+ *              forever if it is negative.
+ *
+ *  @return     A #SHARED_MEMORY_CHANNEL_RESULT value.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_CHANNEL_RESULT, SharedMemoryChannel_Send, SHARED_MEMORY_CHANNEL_HANDLE, channel, const unsigned char*, buf, int32_t, size, int, timeout_ms);
+
+/** @brief      Gets the oldest buffer of the incoming ring, in place.
+ *
+ *  @details    Only one thread may receive on a channel. If the ring is
+ *              empty, waits for up to @c timeout_ms milliseconds, or forever
+ *              if it is negative. Upon #SHARED_MEMORY_CHANNEL_OK, @c *buf
+ *              points into the ring and stays valid until
+ *              #SharedMemoryChannel_Release, which must be called before the
+ *              next receive.
+ *
+ *  @return     A #SHARED_MEMORY_CHANNEL_RESULT value.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SHARED_MEMORY_CHANNEL_RESULT, SharedMemoryChannel_Receive, SHARED_MEMORY_CHANNEL_HANDLE, channel, const unsigned char**, buf, int32_t*, size, int, timeout_ms);
+
+/** @brief      Gives the room of the buffer last received back to the
+ *              sender.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SharedMemoryChannel_Release, SHARED_MEMORY_CHANNEL_HANDLE, channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*SHARED_MEMORY_CHANNEL_H*/
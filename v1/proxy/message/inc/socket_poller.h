@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       socket_poller.h
+ *  @brief      One thread waiting on many nanomsg sockets.
+ *
+ *  @details    A socket added to the poller is polled along with every other
+ *              socket of the poller, and its callback is called on the
+ *              poller's thread each time the socket has a message to
+ *              receive. Proxy modules use it so that their control and
+ *              message channels do not need a thread each. A callback must
+ *              receive without waiting, and must not add or remove sockets.
+ */
+
+#ifndef SOCKET_POLLER_H
+#define SOCKET_POLLER_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct SOCKET_POLLER_TAG* SOCKET_POLLER_HANDLE;
+
+/** @brief      Called on the poller's thread when @c socket has a message to
+ *              receive.
+ */
+typedef void(*SOCKET_POLLER_ON_READABLE)(void* context, int socket);
+
+/** @brief      Creates a poller and starts its thread.
+ *
+ *  @return     A non-NULL #SOCKET_POLLER_HANDLE, or NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT SOCKET_POLLER_HANDLE, SocketPoller_Create);
+
+/** @brief      Stops and joins the poller's thread, and frees the poller.
+ *
+ *  @details    Every socket should have been removed first; none of them is
+ *              closed.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SocketPoller_Destroy, SOCKET_POLLER_HANDLE, poller);
+
+/** @brief      Adds a socket to those the poller waits on.
+ *
+ *  @return     Zero upon success, non-zero otherwise.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, SocketPoller_Add, SOCKET_POLLER_HANDLE, poller, int, socket, SOCKET_POLLER_ON_READABLE, on_readable, void*, context);
+
+/** @brief      Removes a socket from the poller.
+ *
+ *  @details    Returns once the poller's thread has stopped using the
+ *              socket, so that it may be closed, and its callback will not
+ *              be called again. Must not be called from a callback.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, SocketPoller_Remove, SOCKET_POLLER_HANDLE, poller, int, socket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*SOCKET_POLLER_H*/
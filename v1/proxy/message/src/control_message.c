@@ -18,6 +18,9 @@ DEFINE_ENUM_STRINGS(CONTROL_MESSAGE_TYPE, CONTROL_MESSAGE_TYPE_VALUES);
 #define BASE_MESSAGE_SIZE 8
 #define BASE_CREATE_SIZE (BASE_MESSAGE_SIZE+10)
 #define BASE_CREATE_REPLY_SIZE (BASE_MESSAGE_SIZE+1)
+#define BATCH_LIMITS_SIZE 12
+#define CREDIT_WINDOW_SIZE 4
+#define CREDIT_MESSAGE_SIZE (BASE_MESSAGE_SIZE+4)
 
 static int parse_uint32_t(const unsigned char* source, size_t sourceSize, size_t position, int32_t *parsed, uint32_t* value)
 {
@@ -87,6 +90,73 @@ static int parse_memory_chunk(const unsigned char* source, size_t sourceSize, si
     return result;
 }
 
+static int parse_batch_limits(const unsigned char* source, size_t sourceSize, size_t position, MESSAGE_BATCH_LIMITS * limits)
+{
+    int result;
+    int32_t current_parsed;
+    if (position == sourceSize)
+    {
+        /* the limits are optional; a message without them declines multi-message frames */
+        limits->max_messages = 0;
+        limits->max_bytes = 0;
+        limits->linger_ms = 0;
+        result = 0;
+    }
+    else if (parse_uint32_t(source, sourceSize, position, &current_parsed, &(limits->max_messages)) != 0)
+    {
+        LogError("unable to parse the most messages in a frame");
+        result = __LINE__;
+    }
+    else if (parse_uint32_t(source, sourceSize, position + current_parsed, &current_parsed, &(limits->max_bytes)) != 0)
+    {
+        LogError("unable to parse the most bytes in a frame");
+        result = __LINE__;
+    }
+    else if (parse_uint32_t(source, sourceSize, position + 2 * current_parsed, &current_parsed, &(limits->linger_ms)) != 0)
+    {
+        LogError("unable to parse the frame linger time");
+        result = __LINE__;
+    }
+    else
+    {
+        /* any bytes past the limits are left for later versions of the message */
+        result = 0;
+    }
+    return result;
+}
+
+/* reads the credit window that may follow the batch limits of a create or reply message */
+static int parse_credit_window(const unsigned char* source, size_t sourceSize, size_t position, uint32_t * credit_window)
+{
+    int result;
+    int32_t current_parsed;
+    if (position == sourceSize || position + BATCH_LIMITS_SIZE == sourceSize)
+    {
+        /* the window is optional; a message without it does not use flow control */
+        *credit_window = 0;
+        result = 0;
+    }
+    else if (parse_uint32_t(source, sourceSize, position + BATCH_LIMITS_SIZE, &current_parsed, credit_window) != 0)
+    {
+        LogError("unable to parse the credit window");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+/* reads the highest message version that may follow the credit window of a create or reply message */
+static void parse_max_message_version(const unsigned char* source, size_t sourceSize, size_t position, uint8_t * max_message_version)
+{
+    /* the version is optional; a message without it only reads its own version, and a later one may follow it */
+    *max_message_version = (position + BATCH_LIMITS_SIZE + CREDIT_WINDOW_SIZE < sourceSize) ?
+        source[position + BATCH_LIMITS_SIZE + CREDIT_WINDOW_SIZE] :
+        0;
+}
+
 static void init_create_message_contents(CONTROL_MESSAGE_MODULE_CREATE * create_msg)
 {
     create_msg->gateway_message_version = 0x00;
@@ -95,6 +165,11 @@ static void init_create_message_contents(CONTROL_MESSAGE_MODULE_CREATE * create_
     create_msg->uri.uri = NULL;
     create_msg->args_size = 0;
     create_msg->args = NULL;
+    create_msg->batch_limits.max_messages = 0;
+    create_msg->batch_limits.max_bytes = 0;
+    create_msg->batch_limits.linger_ms = 0;
+    create_msg->credit_window = 0;
+    create_msg->max_message_version = 0;
 }
 
 static void free_create_message_contents(CONTROL_MESSAGE_MODULE_CREATE * create_msg)
@@ -173,8 +248,24 @@ int parse_create_message(const unsigned char* source, size_t sourceSize, size_t
             /*Codes_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
             free_create_message_contents(create_msg);
         }
+        /*Codes_SRS_CONTROL_MESSAGE_17_038: [ If the byte array continues past the args, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+        else if (parse_batch_limits(source, sourceSize, position + current_parsed, &(create_msg->batch_limits)) != 0)
+        {
+            result = __LINE__;
+            /*Codes_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+            free_create_message_contents(create_msg);
+        }
+        /*Codes_SRS_CONTROL_MESSAGE_17_041: [ If the byte array continues past the batch_limits, this function shall read the credit_window from the byte stream, and otherwise set it to zero. ]*/
+        else if (parse_credit_window(source, sourceSize, position + current_parsed, &(create_msg->credit_window)) != 0)
+        {
+            result = __LINE__;
+            /*Codes_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+            free_create_message_contents(create_msg);
+        }
         else
         {
+            /*Codes_SRS_CONTROL_MESSAGE_17_046: [ If the byte array continues past the credit_window, this function shall read the max_message_version from the byte stream, and otherwise set it to zero. ]*/
+            parse_max_message_version(source, sourceSize, position + current_parsed, &(create_msg->max_message_version));
             result = 0;
         }
     }
@@ -254,6 +345,11 @@ CONTROL_MESSAGE * ControlMessage_CreateFromByteArray(const unsigned char* source
                                 free(result);
                                 result = NULL;
                             }
+                            else
+                            {
+                                /*Codes_SRS_CONTROL_MESSAGE_17_046: [ If the byte array continues past the credit_window, this function shall read the max_message_version from the byte stream, and otherwise set it to zero. ]*/
+                                parse_max_message_version(source, size, currentPosition, &(((CONTROL_MESSAGE_MODULE_REPLY*)result)->max_message_version));
+                            }
                         }
                     }
                 }
@@ -275,7 +371,37 @@ CONTROL_MESSAGE * ControlMessage_CreateFromByteArray(const unsigned char* source
                             result->type = messageType;
 							/*Codes_SRS_CONTROL_MESSAGE_17_021: [ This function shall read the status from the byte stream. ]*/
                             ((CONTROL_MESSAGE_MODULE_REPLY*)result)->status = 
-                                (uint8_t)source[currentPosition];
+                                (uint8_t)source[currentPosition++];
+                            /*Codes_SRS_CONTROL_MESSAGE_17_039: [ If the byte array continues past the status, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+                            /*Codes_SRS_CONTROL_MESSAGE_17_041: [ If the byte array continues past the batch_limits, this function shall read the credit_window from the byte stream, and otherwise set it to zero. ]*/
+                            if (parse_batch_limits(source, size, currentPosition, &(((CONTROL_MESSAGE_MODULE_REPLY*)result)->batch_limits)) != 0 ||
+                                parse_credit_window(source, size, currentPosition, &(((CONTROL_MESSAGE_MODULE_REPLY*)result)->credit_window)) != 0)
+                            {
+                                /*Codes_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+                                free(result);
+                                result = NULL;
+                            }
+                        }
+                    }
+                }
+                else if (messageType == CONTROL_MESSAGE_TYPE_MODULE_CREDIT)
+                {
+                    /*Codes_SRS_CONTROL_MESSAGE_17_042: [ If the total message size is not 12 bytes, then this function shall fail and return NULL. ]*/
+                    if (size != CREDIT_MESSAGE_SIZE)
+                    {
+                        result = NULL;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_CONTROL_MESSAGE_17_043: [ This function shall allocate a CONTROL_MESSAGE_MODULE_CREDIT structure. ]*/
+                        result = (CONTROL_MESSAGE *)malloc(sizeof(CONTROL_MESSAGE_MODULE_CREDIT));
+                        if (result != NULL)
+                        {
+                            /*Codes_SRS_CONTROL_MESSAGE_17_024: [ Upon valid reading of the byte stream, this function shall assign the message version and type into the CONTROL_MESSAGE base structure. ]*/
+                            result->version = messageVersion;
+                            result->type = messageType;
+                            /*Codes_SRS_CONTROL_MESSAGE_17_044: [ This function shall read the credits from the byte stream. ]*/
+                            (void)parse_uint32_t(source, size, currentPosition, &parsed, &(((CONTROL_MESSAGE_MODULE_CREDIT*)result)->credits));
                         }
                     }
                 }
@@ -323,6 +449,28 @@ void ControlMessage_Destroy(CONTROL_MESSAGE * message)
     }
 }
 
+/* the size of the optional fields that end a create or reply message */
+static size_t flow_fields_size(const MESSAGE_BATCH_LIMITS * limits, uint32_t credit_window, uint8_t max_message_version)
+{
+    size_t result = 0;
+    /*Codes_SRS_CONTROL_MESSAGE_17_040: [ This function shall write the batch_limits of a create or reply message after its other fields only when batch_limits.max_messages, the credit_window or the max_message_version is not zero. ]*/
+    if (limits->max_messages != 0 || credit_window != 0 || max_message_version != 0)
+    {
+        result += BATCH_LIMITS_SIZE;
+    }
+    /*Codes_SRS_CONTROL_MESSAGE_17_045: [ This function shall write the credit_window of a create or reply message after its batch_limits only when the credit_window or the max_message_version is not zero. ]*/
+    if (credit_window != 0 || max_message_version != 0)
+    {
+        result += CREDIT_WINDOW_SIZE;
+    }
+    /*Codes_SRS_CONTROL_MESSAGE_17_047: [ This function shall write the max_message_version of a create or reply message after its credit_window only when it is not zero. ]*/
+    if (max_message_version != 0)
+    {
+        result += 1;
+    }
+    return result;
+}
+
 static int32_t create_message_get_size(CONTROL_MESSAGE * message)
 {
     int32_t result;
@@ -345,10 +493,55 @@ static int32_t create_message_get_size(CONTROL_MESSAGE * message)
             (int32_t)strlen(create_msg->args)
             + 1; /* for null char */
     }
-        
+    result += (int32_t)flow_fields_size(&(create_msg->batch_limits), create_msg->credit_window, create_msg->max_message_version);
+
     return result;
 }
 
+static size_t batch_limits_serialize(const MESSAGE_BATCH_LIMITS * limits, unsigned char* buf, size_t currentPosition)
+{
+    buf[currentPosition++] = (limits->max_messages) >> 24;
+    buf[currentPosition++] = ((limits->max_messages) >> 16) & 0xFF;
+    buf[currentPosition++] = ((limits->max_messages) >> 8) & 0xFF;
+    buf[currentPosition++] = (limits->max_messages) & 0xFF;
+    buf[currentPosition++] = (limits->max_bytes) >> 24;
+    buf[currentPosition++] = ((limits->max_bytes) >> 16) & 0xFF;
+    buf[currentPosition++] = ((limits->max_bytes) >> 8) & 0xFF;
+    buf[currentPosition++] = (limits->max_bytes) & 0xFF;
+    buf[currentPosition++] = (limits->linger_ms) >> 24;
+    buf[currentPosition++] = ((limits->linger_ms) >> 16) & 0xFF;
+    buf[currentPosition++] = ((limits->linger_ms) >> 8) & 0xFF;
+    buf[currentPosition++] = (limits->linger_ms) & 0xFF;
+    return currentPosition;
+}
+
+static size_t uint32_serialize(uint32_t value, unsigned char* buf, size_t currentPosition)
+{
+    buf[currentPosition++] = value >> 24;
+    buf[currentPosition++] = (value >> 16) & 0xFF;
+    buf[currentPosition++] = (value >> 8) & 0xFF;
+    buf[currentPosition++] = value & 0xFF;
+    return currentPosition;
+}
+
+/* writes the optional fields that end a create or reply message; each one is written when it or a field after it is set */
+static size_t flow_fields_serialize(const MESSAGE_BATCH_LIMITS * limits, uint32_t credit_window, uint8_t max_message_version, unsigned char* buf, size_t currentPosition)
+{
+    if (limits->max_messages != 0 || credit_window != 0 || max_message_version != 0)
+    {
+        currentPosition = batch_limits_serialize(limits, buf, currentPosition);
+    }
+    if (credit_window != 0 || max_message_version != 0)
+    {
+        currentPosition = uint32_serialize(credit_window, buf, currentPosition);
+    }
+    if (max_message_version != 0)
+    {
+        buf[currentPosition++] = max_message_version;
+    }
+    return currentPosition;
+}
+
 static void create_message_serialize(CONTROL_MESSAGE_MODULE_CREATE * create_msg, unsigned char* buf, size_t currentPosition)
 {
 	buf[currentPosition++] = (create_msg->gateway_message_version);
@@ -371,6 +564,7 @@ static void create_message_serialize(CONTROL_MESSAGE_MODULE_CREATE * create_msg,
         memcpy(buf + currentPosition, create_msg->args, create_msg->args_size);
         currentPosition += create_msg->args_size;
     }
+    (void)flow_fields_serialize(&(create_msg->batch_limits), create_msg->credit_window, create_msg->max_message_version, buf, currentPosition);
 }
 
 
@@ -412,6 +606,15 @@ int32_t ControlMessage_ToByteArray(CONTROL_MESSAGE * message, unsigned char* buf
         {
             result = 0;
             byteArraySize += 1; /* status */
+            byteArraySize += flow_fields_size(
+                &(((CONTROL_MESSAGE_MODULE_REPLY*)message)->batch_limits),
+                ((CONTROL_MESSAGE_MODULE_REPLY*)message)->credit_window,
+                ((CONTROL_MESSAGE_MODULE_REPLY*)message)->max_message_version);
+        }
+        else if (message->type == CONTROL_MESSAGE_TYPE_MODULE_CREDIT)
+        {
+            result = 0;
+            byteArraySize += 4; /* credits */
         }
         else if (
                  (message->type == CONTROL_MESSAGE_TYPE_MODULE_START) || 
@@ -467,6 +670,11 @@ int32_t ControlMessage_ToByteArray(CONTROL_MESSAGE * message, unsigned char* buf
                     CONTROL_MESSAGE_MODULE_REPLY * reply_msg = 
                             (CONTROL_MESSAGE_MODULE_REPLY*)message;
                     buf[currentPosition++] = (reply_msg->status);
+                    currentPosition = flow_fields_serialize(&(reply_msg->batch_limits), reply_msg->credit_window, reply_msg->max_message_version, buf, currentPosition);
+                }
+                else if (message->type == CONTROL_MESSAGE_TYPE_MODULE_CREDIT)
+                {
+                    currentPosition = uint32_serialize(((CONTROL_MESSAGE_MODULE_CREDIT*)message)->credits, buf, currentPosition);
                 }
 				/*Codes_SRS_CONTROL_MESSAGE_17_035: [ Upon success this function shall return the byte array size.*/
                 result = byteArraySize;
@@ -0,0 +1,327 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#include "message_batch.h"
+
+DEFINE_ENUM_STRINGS(MESSAGE_BATCH_RESULT, MESSAGE_BATCH_RESULT_VALUES);
+
+#define FIRST_FRAME_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
+#define SECOND_FRAME_BYTE 0x62 /*0x62 comes from (B)atch */
+#define FRAME_ENTRY_HEADER_SIZE 4
+
+typedef struct MESSAGE_BATCH_ENTRY_TAG
+{
+    MESSAGE_HANDLE message;
+    const CONSTBUFFER* serialized;
+} MESSAGE_BATCH_ENTRY;
+
+typedef struct MESSAGE_BATCH_TAG
+{
+    MESSAGE_BATCH_ENTRY* entries;
+    uint32_t count;
+    uint32_t max_messages;
+    uint32_t max_bytes;
+    size_t frame_size;
+} MESSAGE_BATCH;
+
+static void write_uint32_t(unsigned char* buf, size_t position, uint32_t value)
+{
+    buf[position + 0] = (unsigned char)((value >> 24) & 0xFF);
+    buf[position + 1] = (unsigned char)((value >> 16) & 0xFF);
+    buf[position + 2] = (unsigned char)((value >> 8) & 0xFF);
+    buf[position + 3] = (unsigned char)(value & 0xFF);
+}
+
+static uint32_t read_uint32_t(const unsigned char* source, size_t position)
+{
+    return
+        ((uint32_t)source[position + 0] << 24) |
+        ((uint32_t)source[position + 1] << 16) |
+        ((uint32_t)source[position + 2] << 8) |
+        ((uint32_t)source[position + 3]);
+}
+
+MESSAGE_BATCH_HANDLE MessageBatch_Create(const MESSAGE_BATCH_LIMITS* limits)
+{
+    MESSAGE_BATCH* result;
+    if (limits == NULL || limits->max_messages == 0 || limits->max_bytes == 0)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_001: [ If limits is NULL, or either limits->max_messages or limits->max_bytes is zero, this function shall return NULL. ]*/
+        LogError("invalid arg limits=%p", limits);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_002: [ This function shall allocate a batch and room for limits->max_messages messages. ]*/
+        result = (MESSAGE_BATCH*)malloc(sizeof(MESSAGE_BATCH));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_003: [ If any allocation fails, this function shall free all it allocated and return NULL. ]*/
+            LogError("unable to allocate a message batch");
+        }
+        else
+        {
+            result->entries = (MESSAGE_BATCH_ENTRY*)calloc(limits->max_messages, sizeof(MESSAGE_BATCH_ENTRY));
+            if (result->entries == NULL)
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_003: [ If any allocation fails, this function shall free all it allocated and return NULL. ]*/
+                LogError("unable to allocate room for %" PRIu32 " messages", limits->max_messages);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_004: [ This function shall return a batch holding no messages. ]*/
+                result->count = 0;
+                result->max_messages = limits->max_messages;
+                result->max_bytes = limits->max_bytes;
+                result->frame_size = MESSAGE_BATCH_FRAME_HEADER_SIZE;
+            }
+        }
+    }
+    return result;
+}
+
+void MessageBatch_Clear(MESSAGE_BATCH_HANDLE batch)
+{
+    if (batch == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_005: [ If batch is NULL, this function shall do nothing. ]*/
+        LogError("invalid arg batch=NULL");
+    }
+    else
+    {
+        uint32_t index;
+        /*Codes_SRS_MESSAGE_BATCH_17_006: [ This function shall destroy every message held by the batch and leave it empty. ]*/
+        for (index = 0; index < batch->count; index++)
+        {
+            Message_Destroy(batch->entries[index].message);
+            batch->entries[index].message = NULL;
+            batch->entries[index].serialized = NULL;
+        }
+        batch->count = 0;
+        batch->frame_size = MESSAGE_BATCH_FRAME_HEADER_SIZE;
+    }
+}
+
+void MessageBatch_Destroy(MESSAGE_BATCH_HANDLE batch)
+{
+    if (batch == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_007: [ If batch is NULL, this function shall do nothing. ]*/
+        LogError("invalid arg batch=NULL");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_008: [ This function shall destroy every message held by the batch and free the batch. ]*/
+        MessageBatch_Clear(batch);
+        free(batch->entries);
+        free(batch);
+    }
+}
+
+MESSAGE_BATCH_RESULT MessageBatch_Add(MESSAGE_BATCH_HANDLE batch, MESSAGE_HANDLE message)
+{
+    MESSAGE_BATCH_RESULT result;
+    if (batch == NULL || message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_009: [ If batch or message is NULL, this function shall return MESSAGE_BATCH_ERROR. ]*/
+        LogError("invalid args batch=%p, message=%p", batch, message);
+        result = MESSAGE_BATCH_ERROR;
+    }
+    else if (batch->count == batch->max_messages)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_010: [ If the batch already holds max_messages messages, this function shall return MESSAGE_BATCH_NO_ROOM. ]*/
+        result = MESSAGE_BATCH_NO_ROOM;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_011: [ This function shall get the serialized form of message by calling Message_GetByteArray. ]*/
+        const CONSTBUFFER* serialized = Message_GetByteArray(message);
+        if (serialized == NULL)
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_012: [ If getting the serialized form or cloning the message fails, this function shall return MESSAGE_BATCH_ERROR and leave the batch unchanged. ]*/
+            LogError("unable to serialize message");
+            result = MESSAGE_BATCH_ERROR;
+        }
+        else
+        {
+            size_t needed = FRAME_ENTRY_HEADER_SIZE + serialized->size;
+            if (serialized->size > INT32_MAX || batch->frame_size + needed > INT32_MAX)
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_013: [ If adding the message would make the frame larger than max_bytes or than INT32_MAX bytes, and the batch is not empty, this function shall return MESSAGE_BATCH_NO_ROOM. ]*/
+                /*Codes_SRS_MESSAGE_BATCH_17_014: [ If the frame of an empty batch would be larger than INT32_MAX bytes, this function shall return MESSAGE_BATCH_ERROR. ]*/
+                result = (batch->count == 0) ? MESSAGE_BATCH_ERROR : MESSAGE_BATCH_NO_ROOM;
+            }
+            else if (batch->count != 0 && batch->frame_size + needed > batch->max_bytes)
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_013: [ If adding the message would make the frame larger than max_bytes or than INT32_MAX bytes, and the batch is not empty, this function shall return MESSAGE_BATCH_NO_ROOM. ]*/
+                result = MESSAGE_BATCH_NO_ROOM;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_BATCH_17_015: [ This function shall keep a clone of message, made by calling Message_Clone. ]*/
+                MESSAGE_HANDLE clone = Message_Clone(message);
+                if (clone == NULL)
+                {
+                    /*Codes_SRS_MESSAGE_BATCH_17_012: [ If getting the serialized form or cloning the message fails, this function shall return MESSAGE_BATCH_ERROR and leave the batch unchanged. ]*/
+                    LogError("unable to clone message");
+                    result = MESSAGE_BATCH_ERROR;
+                }
+                else
+                {
+                    batch->entries[batch->count].message = clone;
+                    batch->entries[batch->count].serialized = serialized;
+                    batch->count++;
+                    batch->frame_size += needed;
+                    /*Codes_SRS_MESSAGE_BATCH_17_016: [ Once the message is added, this function shall return MESSAGE_BATCH_FULL if the batch holds max_messages messages or its frame is at least max_bytes bytes, and MESSAGE_BATCH_OK otherwise. ]*/
+                    result = (batch->count == batch->max_messages || batch->frame_size >= batch->max_bytes) ?
+                        MESSAGE_BATCH_FULL :
+                        MESSAGE_BATCH_OK;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+size_t MessageBatch_GetCount(MESSAGE_BATCH_HANDLE batch)
+{
+    size_t result;
+    if (batch == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_017: [ If batch is NULL, this function shall return 0. ]*/
+        LogError("invalid arg batch=NULL");
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_018: [ This function shall return the number of messages in the batch. ]*/
+        result = batch->count;
+    }
+    return result;
+}
+
+int32_t MessageBatch_ToByteArray(MESSAGE_BATCH_HANDLE batch, unsigned char* buf, int32_t size)
+{
+    int32_t result;
+    if (batch == NULL || batch->count == 0 || (buf == NULL && size != 0))
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_019: [ If batch is NULL or empty, or buf is NULL and size is not zero, this function shall return -1. ]*/
+        LogError("invalid args batch=%p, buf=%p, size=%" PRId32, batch, buf, size);
+        result = -1;
+    }
+    else if (buf == NULL)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_020: [ If buf is NULL and size is zero, this function shall return the size of the frame. ]*/
+        result = (int32_t)batch->frame_size;
+    }
+    else if (size < 0 || (size_t)size < batch->frame_size)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_021: [ If size is smaller than the frame, this function shall return -1. ]*/
+        LogError("buffer of %" PRId32 " bytes is too small for a frame of %zu bytes", size, batch->frame_size);
+        result = -1;
+    }
+    else
+    {
+        uint32_t index;
+        size_t position = 0;
+        /*Codes_SRS_MESSAGE_BATCH_17_022: [ This function shall write the frame header: 0xA1 0x62, the frame version, the frame size and the message count. ]*/
+        buf[position++] = FIRST_FRAME_BYTE;
+        buf[position++] = SECOND_FRAME_BYTE;
+        buf[position++] = MESSAGE_BATCH_FRAME_VERSION_CURRENT;
+        write_uint32_t(buf, position, (uint32_t)batch->frame_size);
+        position += 4;
+        write_uint32_t(buf, position, batch->count);
+        position += 4;
+        /*Codes_SRS_MESSAGE_BATCH_17_023: [ This function shall write the size and the serialized bytes of each message, in the order they were added. ]*/
+        for (index = 0; index < batch->count; index++)
+        {
+            const CONSTBUFFER* serialized = batch->entries[index].serialized;
+            write_uint32_t(buf, position, (uint32_t)serialized->size);
+            position += FRAME_ENTRY_HEADER_SIZE;
+            (void)memcpy(buf + position, serialized->buffer, serialized->size);
+            position += serialized->size;
+        }
+        /*Codes_SRS_MESSAGE_BATCH_17_024: [ Upon success, this function shall return the size of the frame. ]*/
+        result = (int32_t)position;
+    }
+    return result;
+}
+
+bool MessageBatch_IsFrame(const unsigned char* source, int32_t size)
+{
+    /*Codes_SRS_MESSAGE_BATCH_17_025: [ This function shall return true if source is not NULL, size is at least the frame header size, and source starts with 0xA1 0x62 and the current frame version; and false otherwise. ]*/
+    return
+        source != NULL &&
+        size >= MESSAGE_BATCH_FRAME_HEADER_SIZE &&
+        source[0] == FIRST_FRAME_BYTE &&
+        source[1] == SECOND_FRAME_BYTE &&
+        source[2] == MESSAGE_BATCH_FRAME_VERSION_CURRENT;
+}
+
+int MessageBatch_ForEachMessage(const unsigned char* source, int32_t size, MESSAGE_BATCH_ON_MESSAGE on_message, void* context)
+{
+    int result;
+    if (on_message == NULL || !MessageBatch_IsFrame(source, size))
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_026: [ If on_message is NULL or source is not a frame, this function shall return a non-zero value. ]*/
+        LogError("invalid args source=%p, size=%" PRId32 ", on_message=%p", source, size, on_message);
+        result = __LINE__;
+    }
+    else if (read_uint32_t(source, 3) != (uint32_t)size)
+    {
+        /*Codes_SRS_MESSAGE_BATCH_17_027: [ If the frame size is not equal to size, this function shall return a non-zero value. ]*/
+        LogError("frame size does not match the size received");
+        result = __LINE__;
+    }
+    else
+    {
+        uint32_t count = read_uint32_t(source, 7);
+        uint32_t index;
+        size_t position = MESSAGE_BATCH_FRAME_HEADER_SIZE;
+        /*Codes_SRS_MESSAGE_BATCH_17_028: [ This function shall check every message entry fits in the frame and that no bytes follow the last entry before calling on_message, and return a non-zero value otherwise. ]*/
+        for (index = 0; index < count; index++)
+        {
+            uint32_t entry_size;
+            if (position + FRAME_ENTRY_HEADER_SIZE > (size_t)size)
+            {
+                break;
+            }
+            entry_size = read_uint32_t(source, position);
+            position += FRAME_ENTRY_HEADER_SIZE;
+            if (entry_size > (size_t)size - position)
+            {
+                break;
+            }
+            position += entry_size;
+        }
+        if (index != count || position != (size_t)size)
+        {
+            LogError("malformed frame of %" PRId32 " bytes holding %" PRIu32 " messages", size, count);
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_BATCH_17_029: [ This function shall call on_message with context and the bytes and size of each message, in frame order. ]*/
+            position = MESSAGE_BATCH_FRAME_HEADER_SIZE;
+            for (index = 0; index < count; index++)
+            {
+                uint32_t entry_size = read_uint32_t(source, position);
+                position += FRAME_ENTRY_HEADER_SIZE;
+                on_message(context, source + position, (int32_t)entry_size);
+                position += entry_size;
+            }
+            /*Codes_SRS_MESSAGE_BATCH_17_030: [ Upon success, this function shall return 0. ]*/
+            result = 0;
+        }
+    }
+    return result;
+}
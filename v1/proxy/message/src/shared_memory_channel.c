@@ -0,0 +1,491 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "shared_memory.h"
+#include "gateway_atomic.h"
+#include "shared_memory_channel.h"
+
+#define SHARED_MEMORY_CHANNEL_MAGIC     0x6D687341  /*"Ashm"*/
+#define CACHE_LINE_SIZE                 64
+#define RECORD_HEADER_SIZE              4
+#define RECORD_ALIGNMENT                8
+/*record header telling the receiver to go on at the start of the ring*/
+#define RECORD_WRAP                     0xFFFFFFFF
+/*times a side looks at the ring again before it goes to sleep*/
+#define SPIN_COUNT                      64
+
+/*the sender and the receiver each write their own cache line*/
+typedef struct RING_CONTROL_TAG
+{
+    /*written by the sender*/
+    GATEWAY_ATOMIC_U32 head;
+    GATEWAY_ATOMIC_U32 data_signal;
+    GATEWAY_ATOMIC_U32 sender_waiting;
+    unsigned char sender_pad[CACHE_LINE_SIZE - 3 * sizeof(GATEWAY_ATOMIC_U32)];
+    /*written by the receiver*/
+    GATEWAY_ATOMIC_U32 tail;
+    GATEWAY_ATOMIC_U32 room_signal;
+    GATEWAY_ATOMIC_U32 receiver_waiting;
+    unsigned char receiver_pad[CACHE_LINE_SIZE - 3 * sizeof(GATEWAY_ATOMIC_U32)];
+} RING_CONTROL;
+
+/*the start of the shared memory; the data of rings[0] then rings[1] follows it*/
+typedef struct CHANNEL_HEADER_TAG
+{
+    /*written last by the gateway, once the rest is set*/
+    GATEWAY_ATOMIC_U32 magic;
+    uint32_t version;
+    uint32_t ring_size;
+    unsigned char pad[CACHE_LINE_SIZE - 3 * sizeof(uint32_t)];
+    /*rings[0] carries buffers from the gateway, rings[1] buffers to it*/
+    RING_CONTROL rings[2];
+} CHANNEL_HEADER;
+
+typedef struct SHARED_MEMORY_CHANNEL_TAG
+{
+    SHARED_MEMORY_HANDLE memory;
+    RING_CONTROL* outgoing;
+    unsigned char* outgoing_data;
+    RING_CONTROL* incoming;
+    unsigned char* incoming_data;
+    uint32_t ring_size;
+    LOCK_HANDLE send_lock;
+    /*bytes of the record last received, 0 once released*/
+    uint32_t received_size;
+    GATEWAY_ATOMIC_U32 closed;
+} SHARED_MEMORY_CHANNEL;
+
+static const char* get_name(const char* uri)
+{
+    const char* result;
+    size_t head_size = sizeof(SHARED_MEMORY_CHANNEL_URI_HEAD) - 1;
+    if (uri == NULL || strncmp(uri, SHARED_MEMORY_CHANNEL_URI_HEAD, head_size) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = uri + head_size;
+    }
+    return result;
+}
+
+static uint32_t round_ring_size(uint32_t requested)
+{
+    uint32_t result = SHARED_MEMORY_CHANNEL_RING_SIZE_MIN;
+    while (result < requested && result < SHARED_MEMORY_CHANNEL_RING_SIZE_MAX)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+static int is_valid_ring_size(uint32_t ring_size)
+{
+    return (ring_size >= SHARED_MEMORY_CHANNEL_RING_SIZE_MIN &&
+        ring_size <= SHARED_MEMORY_CHANNEL_RING_SIZE_MAX &&
+        (ring_size & (ring_size - 1)) == 0);
+}
+
+static uint32_t record_size_of(uint32_t size)
+{
+    return (RECORD_HEADER_SIZE + size + (RECORD_ALIGNMENT - 1)) & ~(uint32_t)(RECORD_ALIGNMENT - 1);
+}
+
+static SHARED_MEMORY_CHANNEL* make_channel(SHARED_MEMORY_HANDLE memory, void* address, uint32_t ring_size, int is_gateway)
+{
+    SHARED_MEMORY_CHANNEL* result = (SHARED_MEMORY_CHANNEL*)malloc(sizeof(SHARED_MEMORY_CHANNEL));
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else if ((result->send_lock = Lock_Init()) == NULL)
+    {
+        LogError("unable to create the send lock");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        CHANNEL_HEADER* header = (CHANNEL_HEADER*)address;
+        unsigned char* data = (unsigned char*)address + sizeof(CHANNEL_HEADER);
+        result->memory = memory;
+        result->ring_size = ring_size;
+        result->outgoing = &header->rings[is_gateway ? 0 : 1];
+        result->outgoing_data = data + (is_gateway ? 0 : ring_size);
+        result->incoming = &header->rings[is_gateway ? 1 : 0];
+        result->incoming_data = data + (is_gateway ? ring_size : 0);
+        result->received_size = 0;
+        result->closed = 0;
+    }
+    return result;
+}
+
+/*tells the receiver a record was added*/
+static void signal_data(RING_CONTROL* ring)
+{
+    (void)gateway_atomic_increment(&ring->data_signal);
+    gateway_atomic_fence();
+    /*a receiver that is not asleep sees the new head without a system call*/
+    if (gateway_atomic_load(&ring->receiver_waiting) != 0)
+    {
+        SharedMemory_WakeAll((volatile uint32_t*)&ring->data_signal);
+    }
+}
+
+/*tells the sender a record was removed*/
+static void signal_room(RING_CONTROL* ring)
+{
+    (void)gateway_atomic_increment(&ring->room_signal);
+    gateway_atomic_fence();
+    if (gateway_atomic_load(&ring->sender_waiting) != 0)
+    {
+        SharedMemory_WakeAll((volatile uint32_t*)&ring->room_signal);
+    }
+}
+
+/*waits until the outgoing ring has needed bytes free after head; the caller holds the send lock*/
+static SHARED_MEMORY_CHANNEL_RESULT wait_for_room(SHARED_MEMORY_CHANNEL* channel, uint32_t head, uint32_t needed, int timeout_ms)
+{
+    SHARED_MEMORY_CHANNEL_RESULT result;
+    RING_CONTROL* ring = channel->outgoing;
+    int spins = 0;
+    for (;;)
+    {
+        uint32_t seen = gateway_atomic_load(&ring->room_signal);
+        if (gateway_atomic_load(&channel->closed) != 0)
+        {
+            result = SHARED_MEMORY_CHANNEL_CLOSED;
+            break;
+        }
+        if (channel->ring_size - (head - gateway_atomic_load(&ring->tail)) >= needed)
+        {
+            result = SHARED_MEMORY_CHANNEL_OK;
+            break;
+        }
+        if (timeout_ms == 0)
+        {
+            result = SHARED_MEMORY_CHANNEL_TIMEOUT;
+            break;
+        }
+        if (spins < SPIN_COUNT)
+        {
+            spins++;
+        }
+        else
+        {
+            /*the receiver wakes a sleeping sender when it frees room*/
+            gateway_atomic_store(&ring->sender_waiting, 1);
+            gateway_atomic_fence();
+            int timed_out = (channel->ring_size - (head - gateway_atomic_load(&ring->tail)) < needed &&
+                SharedMemory_Wait((volatile uint32_t*)&ring->room_signal, seen, timeout_ms) != 0);
+            gateway_atomic_store(&ring->sender_waiting, 0);
+            if (timed_out)
+            {
+                result = SHARED_MEMORY_CHANNEL_TIMEOUT;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+SHARED_MEMORY_CHANNEL_HANDLE SharedMemoryChannel_Create(const char* uri, uint32_t ring_size)
+{
+    SHARED_MEMORY_CHANNEL* result;
+    const char* name = get_name(uri);
+    if (name == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_001: [ SharedMemoryChannel_Create and SharedMemoryChannel_Open shall return NULL if uri is NULL or does not start with "shm://". ]*/
+        LogError("invalid shared memory channel uri %s", (uri == NULL) ? "NULL" : uri);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_002: [ SharedMemoryChannel_Create shall round ring_size up to a power of two between SHARED_MEMORY_CHANNEL_RING_SIZE_MIN and SHARED_MEMORY_CHANNEL_RING_SIZE_MAX. ]*/
+        uint32_t size = round_ring_size(ring_size);
+        void* address;
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_003: [ SharedMemoryChannel_Create shall create shared memory for the channel header and two rings by calling SharedMemory_Create with the rest of uri as the name. ]*/
+        SHARED_MEMORY_HANDLE memory = SharedMemory_Create(name, sizeof(CHANNEL_HEADER) + 2 * (size_t)size, &address);
+        if (memory == NULL)
+        {
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_005: [ If any step fails, SharedMemoryChannel_Create and SharedMemoryChannel_Open shall free all they allocated and return NULL. ]*/
+            LogError("unable to create the shared memory of channel %s", uri);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_004: [ SharedMemoryChannel_Create shall write the channel version and ring size, then the channel marker; the zero filled rings start out empty. ]*/
+            CHANNEL_HEADER* header = (CHANNEL_HEADER*)address;
+            header->version = SHARED_MEMORY_CHANNEL_VERSION_1;
+            header->ring_size = size;
+            gateway_atomic_store(&header->magic, SHARED_MEMORY_CHANNEL_MAGIC);
+
+            result = make_channel(memory, address, size, 1);
+            if (result == NULL)
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_005: [ If any step fails, SharedMemoryChannel_Create and SharedMemoryChannel_Open shall free all they allocated and return NULL. ]*/
+                SharedMemory_Close(memory);
+            }
+        }
+    }
+    return result;
+}
+
+SHARED_MEMORY_CHANNEL_HANDLE SharedMemoryChannel_Open(const char* uri)
+{
+    SHARED_MEMORY_CHANNEL* result;
+    const char* name = get_name(uri);
+    if (name == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_001: [ SharedMemoryChannel_Create and SharedMemoryChannel_Open shall return NULL if uri is NULL or does not start with "shm://". ]*/
+        LogError("invalid shared memory channel uri %s", (uri == NULL) ? "NULL" : uri);
+        result = NULL;
+    }
+    else
+    {
+        void* address;
+        size_t size;
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_006: [ SharedMemoryChannel_Open shall map the shared memory by calling SharedMemory_Open with the rest of uri as the name. ]*/
+        SHARED_MEMORY_HANDLE memory = SharedMemory_Open(name, &address, &size);
+        if (memory == NULL)
+        {
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_005: [ If any step fails, SharedMemoryChannel_Create and SharedMemoryChannel_Open shall free all they allocated and return NULL. ]*/
+            LogError("unable to open the shared memory of channel %s", uri);
+            result = NULL;
+        }
+        else
+        {
+            CHANNEL_HEADER* header = (CHANNEL_HEADER*)address;
+            if (size < sizeof(CHANNEL_HEADER) ||
+                gateway_atomic_load(&header->magic) != SHARED_MEMORY_CHANNEL_MAGIC ||
+                header->version != SHARED_MEMORY_CHANNEL_VERSION_1 ||
+                !is_valid_ring_size(header->ring_size) ||
+                size < sizeof(CHANNEL_HEADER) + 2 * (size_t)header->ring_size)
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_007: [ SharedMemoryChannel_Open shall fail if the shared memory does not hold a channel of the current version whose rings fit in it. ]*/
+                LogError("shared memory of %s is not a channel this module host can use", uri);
+                SharedMemory_Close(memory);
+                result = NULL;
+            }
+            else
+            {
+                result = make_channel(memory, address, header->ring_size, 0);
+                if (result == NULL)
+                {
+                    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_005: [ If any step fails, SharedMemoryChannel_Create and SharedMemoryChannel_Open shall free all they allocated and return NULL. ]*/
+                    SharedMemory_Close(memory);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void SharedMemoryChannel_Close(SHARED_MEMORY_CHANNEL_HANDLE channel)
+{
+    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_008: [ If channel is NULL, SharedMemoryChannel_Close and SharedMemoryChannel_Destroy shall do nothing. ]*/
+    if (channel != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_009: [ SharedMemoryChannel_Close shall mark the channel closed, then wake any thread waiting for a buffer or for room. ]*/
+        gateway_atomic_store(&channel->closed, 1);
+        (void)gateway_atomic_increment(&channel->incoming->data_signal);
+        (void)gateway_atomic_increment(&channel->outgoing->room_signal);
+        SharedMemory_WakeAll((volatile uint32_t*)&channel->incoming->data_signal);
+        SharedMemory_WakeAll((volatile uint32_t*)&channel->outgoing->room_signal);
+    }
+}
+
+void SharedMemoryChannel_Destroy(SHARED_MEMORY_CHANNEL_HANDLE channel)
+{
+    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_008: [ If channel is NULL, SharedMemoryChannel_Close and SharedMemoryChannel_Destroy shall do nothing. ]*/
+    if (channel != NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_010: [ SharedMemoryChannel_Destroy shall close the channel, unmap it by calling SharedMemory_Close and free it. ]*/
+        SharedMemoryChannel_Close(channel);
+        SharedMemory_Close(channel->memory);
+        (void)Lock_Deinit(channel->send_lock);
+        free(channel);
+    }
+}
+
+SHARED_MEMORY_CHANNEL_RESULT SharedMemoryChannel_Send(SHARED_MEMORY_CHANNEL_HANDLE channel, const unsigned char* buf, int32_t size, int timeout_ms)
+{
+    SHARED_MEMORY_CHANNEL_RESULT result;
+    if (channel == NULL || size < 0 || (buf == NULL && size != 0))
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_011: [ If channel is NULL, size is negative, or buf is NULL and size is not zero, SharedMemoryChannel_Send shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+        LogError("invalid arg channel=%p, buf=%p, size=%d", channel, buf, (int)size);
+        result = SHARED_MEMORY_CHANNEL_ERROR;
+    }
+    else if (record_size_of((uint32_t)size) > channel->ring_size)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_012: [ If the 4 byte size and the bytes of buf, rounded up to 8 bytes, do not fit in a ring, SharedMemoryChannel_Send shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+        LogError("a buffer of %d bytes does not fit a ring of %u bytes", (int)size, (unsigned int)channel->ring_size);
+        result = SHARED_MEMORY_CHANNEL_ERROR;
+    }
+    else if (Lock(channel->send_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_013: [ SharedMemoryChannel_Send shall hold a lock while it writes, so several threads can send on one channel. ]*/
+        LogError("unable to lock the channel");
+        result = SHARED_MEMORY_CHANNEL_ERROR;
+    }
+    else
+    {
+        RING_CONTROL* ring = channel->outgoing;
+        uint32_t record_size = record_size_of((uint32_t)size);
+        /*only this side moves head*/
+        uint32_t head = gateway_atomic_load(&ring->head);
+        uint32_t offset = head & (channel->ring_size - 1);
+        uint32_t to_end = channel->ring_size - offset;
+
+        result = SHARED_MEMORY_CHANNEL_OK;
+        if (record_size > to_end)
+        {
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_014: [ A record that would run past the end of the ring shall start at the beginning of the ring, after a marker telling the receiver to skip the rest. ]*/
+            result = wait_for_room(channel, head, to_end, timeout_ms);
+            if (result == SHARED_MEMORY_CHANNEL_OK)
+            {
+                *(uint32_t*)(channel->outgoing_data + offset) = RECORD_WRAP;
+                head += to_end;
+                offset = 0;
+                gateway_atomic_store(&ring->head, head);
+                signal_data(ring);
+            }
+        }
+
+        if (result == SHARED_MEMORY_CHANNEL_OK)
+        {
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_015: [ If the ring is full, SharedMemoryChannel_Send shall wait for room until timeout_ms elapses, or forever if it is negative, and return SHARED_MEMORY_CHANNEL_TIMEOUT if it does. ]*/
+            /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_016: [ SharedMemoryChannel_Send and SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_CLOSED once the channel is closed. ]*/
+            result = wait_for_room(channel, head, record_size, timeout_ms);
+            if (result == SHARED_MEMORY_CHANNEL_OK)
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_017: [ SharedMemoryChannel_Send shall write the size and the bytes of buf to the ring, then publish them and wake the receiver if it sleeps. ]*/
+                *(uint32_t*)(channel->outgoing_data + offset) = (uint32_t)size;
+                if (size > 0)
+                {
+                    (void)memcpy(channel->outgoing_data + offset + RECORD_HEADER_SIZE, buf, (size_t)size);
+                }
+                gateway_atomic_store(&ring->head, head + record_size);
+                signal_data(ring);
+            }
+        }
+        (void)Unlock(channel->send_lock);
+    }
+    return result;
+}
+
+SHARED_MEMORY_CHANNEL_RESULT SharedMemoryChannel_Receive(SHARED_MEMORY_CHANNEL_HANDLE channel, const unsigned char** buf, int32_t* size, int timeout_ms)
+{
+    SHARED_MEMORY_CHANNEL_RESULT result;
+    if (channel == NULL || buf == NULL || size == NULL)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_018: [ If channel, buf or size is NULL, or the buffer last received was not released, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+        LogError("invalid arg channel=%p, buf=%p, size=%p", channel, buf, size);
+        result = SHARED_MEMORY_CHANNEL_ERROR;
+    }
+    else if (channel->received_size != 0)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_018: [ If channel, buf or size is NULL, or the buffer last received was not released, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+        LogError("the buffer last received was not released");
+        result = SHARED_MEMORY_CHANNEL_ERROR;
+    }
+    else
+    {
+        RING_CONTROL* ring = channel->incoming;
+        /*only this side moves tail*/
+        uint32_t tail = gateway_atomic_load(&ring->tail);
+        int spins = 0;
+        for (;;)
+        {
+            uint32_t seen = gateway_atomic_load(&ring->data_signal);
+            uint32_t head;
+            if (gateway_atomic_load(&channel->closed) != 0)
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_016: [ SharedMemoryChannel_Send and SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_CLOSED once the channel is closed. ]*/
+                result = SHARED_MEMORY_CHANNEL_CLOSED;
+                break;
+            }
+
+            head = gateway_atomic_load(&ring->head);
+            if (head != tail)
+            {
+                /*the sender is another process: check everything it wrote*/
+                uint32_t offset = tail & (channel->ring_size - 1);
+                uint32_t available = head - tail;
+                uint32_t record = *(const uint32_t*)(channel->incoming_data + offset);
+                if (record == RECORD_WRAP && channel->ring_size - offset <= available)
+                {
+                    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_014: [ A record that would run past the end of the ring shall start at the beginning of the ring, after a marker telling the receiver to skip the rest. ]*/
+                    tail += channel->ring_size - offset;
+                    gateway_atomic_store(&ring->tail, tail);
+                    signal_room(ring);
+                }
+                else if (available > channel->ring_size ||
+                    record > channel->ring_size - offset - RECORD_HEADER_SIZE ||
+                    record_size_of(record) > available)
+                {
+                    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_019: [ If the oldest record does not fit within the ring and what the sender published, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+                    LogError("the incoming ring is corrupt");
+                    result = SHARED_MEMORY_CHANNEL_ERROR;
+                    break;
+                }
+                else
+                {
+                    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_020: [ SharedMemoryChannel_Receive shall set *buf and *size to the oldest buffer, in place in the ring, and return SHARED_MEMORY_CHANNEL_OK. ]*/
+                    *buf = channel->incoming_data + offset + RECORD_HEADER_SIZE;
+                    *size = (int32_t)record;
+                    channel->received_size = record_size_of(record);
+                    result = SHARED_MEMORY_CHANNEL_OK;
+                    break;
+                }
+            }
+            else if (timeout_ms == 0)
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_021: [ If the ring is empty, SharedMemoryChannel_Receive shall wait for a buffer until timeout_ms elapses, or forever if it is negative, and return SHARED_MEMORY_CHANNEL_TIMEOUT if it does. ]*/
+                result = SHARED_MEMORY_CHANNEL_TIMEOUT;
+                break;
+            }
+            else if (spins < SPIN_COUNT)
+            {
+                spins++;
+            }
+            else
+            {
+                /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_021: [ If the ring is empty, SharedMemoryChannel_Receive shall wait for a buffer until timeout_ms elapses, or forever if it is negative, and return SHARED_MEMORY_CHANNEL_TIMEOUT if it does. ]*/
+                /*the sender wakes a sleeping receiver when it publishes*/
+                gateway_atomic_store(&ring->receiver_waiting, 1);
+                gateway_atomic_fence();
+                int timed_out = (gateway_atomic_load(&ring->head) == tail &&
+                    SharedMemory_Wait((volatile uint32_t*)&ring->data_signal, seen, timeout_ms) != 0);
+                gateway_atomic_store(&ring->receiver_waiting, 0);
+                if (timed_out)
+                {
+                    result = SHARED_MEMORY_CHANNEL_TIMEOUT;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void SharedMemoryChannel_Release(SHARED_MEMORY_CHANNEL_HANDLE channel)
+{
+    /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_022: [ If channel is NULL or holds no received buffer, SharedMemoryChannel_Release shall do nothing. ]*/
+    if (channel != NULL && channel->received_size != 0)
+    {
+        /*Codes_SRS_SHARED_MEMORY_CHANNEL_17_023: [ SharedMemoryChannel_Release shall give the room of the buffer last received back to the sender and wake it if it sleeps. ]*/
+        RING_CONTROL* ring = channel->incoming;
+        gateway_atomic_store(&ring->tail, gateway_atomic_load(&ring->tail) + channel->received_size);
+        channel->received_size = 0;
+        signal_room(ring);
+    }
+}
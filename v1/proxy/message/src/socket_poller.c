@@ -0,0 +1,400 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <nanomsg/nn.h>
+#include <nanomsg/pair.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/vector.h"
+
+#include "socket_poller.h"
+
+#define WAKE_URI_FORMAT         "inproc://socket_poller/%p"
+#define WAKE_URI_SIZE           64
+/*how long the thread waits before it tries again to copy the sockets it polls*/
+#define RETRY_POLL_TIMEOUT_MS   1000
+
+typedef struct POLLED_SOCKET_TAG
+{
+    int socket;
+    SOCKET_POLLER_ON_READABLE on_readable;
+    void* context;
+} POLLED_SOCKET;
+
+typedef struct SOCKET_POLLER_TAG
+{
+    LOCK_HANDLE lock;
+    /*posted each time the thread starts a round, and when it ends*/
+    COND_HANDLE round_started;
+    /*of POLLED_SOCKET*/
+    VECTOR_HANDLE sockets;
+    /*rounds started by the thread; a round polls the sockets there were when it started*/
+    uint32_t round;
+    int stopping;
+    int running;
+    /*a message sent on wake_sender ends the poll of the current round*/
+    int wake_receiver;
+    int wake_sender;
+    THREAD_HANDLE thread;
+    /*the copy of the sockets polled by the current round, and their poll array; only used by the thread*/
+    POLLED_SOCKET* round_sockets;
+    struct nn_pollfd* round_fds;
+    size_t round_capacity;
+} SOCKET_POLLER;
+
+static int open_wake_sockets(SOCKET_POLLER* poller)
+{
+    int result;
+    char uri[WAKE_URI_SIZE];
+    (void)snprintf(uri, sizeof(uri), WAKE_URI_FORMAT, (void*)poller);
+    /*Codes_SRS_SOCKET_POLLER_17_003: [ SocketPoller_Create shall connect two pair sockets on an "inproc://" URI, so that a message on one ends the poll of the thread. ]*/
+    if ((poller->wake_receiver = nn_socket(AF_SP, NN_PAIR)) < 0)
+    {
+        LogError("unable to create the wake socket, errno = %d", nn_errno());
+        result = __LINE__;
+    }
+    else if (nn_bind(poller->wake_receiver, uri) < 0)
+    {
+        LogError("unable to bind the wake socket to %s, errno = %d", uri, nn_errno());
+        (void)nn_close(poller->wake_receiver);
+        result = __LINE__;
+    }
+    else if ((poller->wake_sender = nn_socket(AF_SP, NN_PAIR)) < 0)
+    {
+        LogError("unable to create the wake socket, errno = %d", nn_errno());
+        (void)nn_close(poller->wake_receiver);
+        result = __LINE__;
+    }
+    else if (nn_connect(poller->wake_sender, uri) < 0)
+    {
+        LogError("unable to connect the wake socket to %s, errno = %d", uri, nn_errno());
+        (void)nn_close(poller->wake_sender);
+        (void)nn_close(poller->wake_receiver);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void close_wake_sockets(SOCKET_POLLER* poller)
+{
+    (void)nn_close(poller->wake_sender);
+    (void)nn_close(poller->wake_receiver);
+}
+
+static bool is_socket(const void* element, const void* value)
+{
+    return ((const POLLED_SOCKET*)element)->socket == *(const int*)value;
+}
+
+static void wake_thread(SOCKET_POLLER* poller)
+{
+    static const unsigned char wake = 0;
+    /*a wake already pending is enough if this one does not fit*/
+    (void)nn_send(poller->wake_sender, &wake, sizeof(wake), NN_DONTWAIT);
+}
+
+/*copies the sockets to poll for this round, returns the number copied, or 0 with *copied set to 0 if they could not be*/
+static size_t copy_round_sockets(SOCKET_POLLER* poller, int* copied)
+{
+    size_t result;
+    size_t count = VECTOR_size(poller->sockets);
+    if (poller->round_capacity < count + 1)
+    {
+        /*the wake socket comes first in the poll array*/
+        size_t capacity = 2 * count + 1;
+        free(poller->round_sockets);
+        free(poller->round_fds);
+        poller->round_sockets = (POLLED_SOCKET*)malloc(capacity * sizeof(POLLED_SOCKET));
+        poller->round_fds = (struct nn_pollfd*)malloc(capacity * sizeof(struct nn_pollfd));
+        poller->round_capacity = (poller->round_sockets == NULL || poller->round_fds == NULL) ? 0 : capacity;
+    }
+
+    if (poller->round_capacity < count + 1)
+    {
+        LogError("unable to allocate the poll array for %zu sockets", count);
+        *copied = 0;
+        result = 0;
+    }
+    else
+    {
+        if (count != 0)
+        {
+            (void)memcpy(poller->round_sockets, VECTOR_front(poller->sockets), count * sizeof(POLLED_SOCKET));
+        }
+        *copied = 1;
+        result = count;
+    }
+    return result;
+}
+
+static int socket_poller_thread(void* param)
+{
+    SOCKET_POLLER* poller = (SOCKET_POLLER*)param;
+    int should_continue = 1;
+    while (should_continue)
+    {
+        size_t count = 0;
+        int copied = 1;
+        if (Lock(poller->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock, the socket poller stops");
+            should_continue = 0;
+            break;
+        }
+        /*Codes_SRS_SOCKET_POLLER_17_011: [ The thread shall end once SocketPoller_Destroy has been called. ]*/
+        if (poller->stopping)
+        {
+            should_continue = 0;
+        }
+        else
+        {
+            /*Codes_SRS_SOCKET_POLLER_17_008: [ Each round, the thread shall poll the wake socket and a copy of the sockets added, taken while it holds the lock, and signal SocketPoller_Remove that a round has started. ]*/
+            count = copy_round_sockets(poller, &copied);
+            poller->round++;
+            (void)Condition_Post(poller->round_started);
+        }
+        (void)Unlock(poller->lock);
+        if (!should_continue)
+        {
+            break;
+        }
+
+        struct nn_pollfd wake_only;
+        struct nn_pollfd* fds = copied ? poller->round_fds : &wake_only;
+        fds[0].fd = poller->wake_receiver;
+        fds[0].events = NN_POLLIN;
+        fds[0].revents = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            fds[i + 1].fd = poller->round_sockets[i].socket;
+            fds[i + 1].events = NN_POLLIN;
+            fds[i + 1].revents = 0;
+        }
+
+        /*Codes_SRS_SOCKET_POLLER_17_009: [ The thread shall wait in nn_poll until a socket has a message to receive, and wait no longer than 1000 ms if it could not copy the sockets. ]*/
+        int ready = nn_poll(fds, (int)(count + 1), copied ? -1 : RETRY_POLL_TIMEOUT_MS);
+        if (ready < 0)
+        {
+            int poll_error = nn_errno();
+            if (poll_error != EINTR)
+            {
+                /*Codes_SRS_SOCKET_POLLER_17_012: [ The thread shall end if nn_poll fails for any reason but being interrupted. ]*/
+                LogError("nn_poll failed, errno = %d, the socket poller stops", poll_error);
+                should_continue = 0;
+            }
+        }
+        else if (ready > 0)
+        {
+            if ((fds[0].revents & NN_POLLIN) != 0)
+            {
+                void* wake;
+                while (nn_recv(poller->wake_receiver, &wake, NN_MSG, NN_DONTWAIT) >= 0)
+                {
+                    (void)nn_freemsg(wake);
+                }
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if ((fds[i + 1].revents & NN_POLLIN) != 0)
+                {
+                    /*Codes_SRS_SOCKET_POLLER_17_010: [ The thread shall call the callback of each socket that has a message to receive, with its context and the socket. ]*/
+                    poller->round_sockets[i].on_readable(poller->round_sockets[i].context, poller->round_sockets[i].socket);
+                }
+            }
+        }
+    }
+
+    if (Lock(poller->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock, a caller of SocketPoller_Remove may wait");
+    }
+    else
+    {
+        poller->running = 0;
+        (void)Condition_Post(poller->round_started);
+        (void)Unlock(poller->lock);
+    }
+    return 0;
+}
+
+SOCKET_POLLER_HANDLE SocketPoller_Create(void)
+{
+    /*Codes_SRS_SOCKET_POLLER_17_001: [ SocketPoller_Create shall allocate the poller, a lock and a condition. ]*/
+    SOCKET_POLLER* result = (SOCKET_POLLER*)malloc(sizeof(SOCKET_POLLER));
+    if (result == NULL)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+        LogError("malloc failed");
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+        LogError("unable to create the lock");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->round_started = Condition_Init()) == NULL)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+        LogError("unable to create the condition");
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->sockets = VECTOR_create(sizeof(POLLED_SOCKET))) == NULL)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+        LogError("unable to create the socket vector");
+        Condition_Deinit(result->round_started);
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else if (open_wake_sockets(result) != 0)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+        VECTOR_destroy(result->sockets);
+        Condition_Deinit(result->round_started);
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->round = 0;
+        result->stopping = 0;
+        result->running = 1;
+        result->round_sockets = NULL;
+        result->round_fds = NULL;
+        result->round_capacity = 0;
+        /*Codes_SRS_SOCKET_POLLER_17_004: [ SocketPoller_Create shall start the thread of the poller. ]*/
+        if (ThreadAPI_Create(&result->thread, socket_poller_thread, result) != THREADAPI_OK)
+        {
+            /*Codes_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+            LogError("unable to start the socket poller thread");
+            close_wake_sockets(result);
+            VECTOR_destroy(result->sockets);
+            Condition_Deinit(result->round_started);
+            (void)Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void SocketPoller_Destroy(SOCKET_POLLER_HANDLE poller)
+{
+    /*Codes_SRS_SOCKET_POLLER_17_013: [ SocketPoller_Destroy shall do nothing if poller is NULL. ]*/
+    if (poller != NULL)
+    {
+        int notUsed;
+        /*Codes_SRS_SOCKET_POLLER_17_014: [ SocketPoller_Destroy shall tell the thread to end, wake it, and join it. ]*/
+        if (Lock(poller->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock, still telling the socket poller to stop");
+            poller->stopping = 1;
+        }
+        else
+        {
+            poller->stopping = 1;
+            (void)Unlock(poller->lock);
+        }
+        wake_thread(poller);
+        if (ThreadAPI_Join(poller->thread, &notUsed) != THREADAPI_OK)
+        {
+            LogError("unable to join the socket poller thread");
+        }
+
+        /*Codes_SRS_SOCKET_POLLER_17_015: [ SocketPoller_Destroy shall close the wake sockets and free the poller, but not the sockets added to it. ]*/
+        close_wake_sockets(poller);
+        VECTOR_destroy(poller->sockets);
+        free(poller->round_sockets);
+        free(poller->round_fds);
+        Condition_Deinit(poller->round_started);
+        (void)Lock_Deinit(poller->lock);
+        free(poller);
+    }
+}
+
+int SocketPoller_Add(SOCKET_POLLER_HANDLE poller, int socket, SOCKET_POLLER_ON_READABLE on_readable, void* context)
+{
+    int result;
+    if (poller == NULL || socket < 0 || on_readable == NULL)
+    {
+        /*Codes_SRS_SOCKET_POLLER_17_005: [ SocketPoller_Add shall return a non-zero value if poller or on_readable is NULL, or socket is negative. ]*/
+        LogError("invalid arg poller=%p, socket=%d, on_readable=%p", poller, socket, on_readable);
+        result = __LINE__;
+    }
+    else if (Lock(poller->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = __LINE__;
+    }
+    else
+    {
+        POLLED_SOCKET polled;
+        polled.socket = socket;
+        polled.on_readable = on_readable;
+        polled.context = context;
+        if (VECTOR_push_back(poller->sockets, &polled, 1) != 0)
+        {
+            /*Codes_SRS_SOCKET_POLLER_17_006: [ SocketPoller_Add shall return a non-zero value if it cannot make room for the socket. ]*/
+            LogError("unable to make room for socket %d", socket);
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_SOCKET_POLLER_17_007: [ SocketPoller_Add shall keep the socket, its callback and context, wake the thread so its next round polls the socket, and return zero. ]*/
+            result = 0;
+        }
+        (void)Unlock(poller->lock);
+        if (result == 0)
+        {
+            wake_thread(poller);
+        }
+    }
+    return result;
+}
+
+void SocketPoller_Remove(SOCKET_POLLER_HANDLE poller, int socket)
+{
+    /*Codes_SRS_SOCKET_POLLER_17_016: [ SocketPoller_Remove shall do nothing if poller is NULL. ]*/
+    if (poller != NULL)
+    {
+        if (Lock(poller->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock, socket %d is still polled", socket);
+        }
+        else
+        {
+            POLLED_SOCKET* polled = (POLLED_SOCKET*)VECTOR_find_if(poller->sockets, is_socket, &socket);
+            /*Codes_SRS_SOCKET_POLLER_17_017: [ SocketPoller_Remove shall do nothing more if socket was not added. ]*/
+            if (polled != NULL)
+            {
+                /*Codes_SRS_SOCKET_POLLER_17_018: [ SocketPoller_Remove shall forget the socket, wake the thread, and wait until the thread starts another round or has ended. ]*/
+                VECTOR_erase(poller->sockets, polled, 1);
+                uint32_t seen = poller->round;
+                wake_thread(poller);
+                while (poller->running && poller->round == seen)
+                {
+                    (void)Condition_Wait(poller->round_started, poller->lock, 0);
+                }
+            }
+            (void)Unlock(poller->lock);
+        }
+    }
+}
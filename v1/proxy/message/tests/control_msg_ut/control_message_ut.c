@@ -119,6 +119,60 @@ static const unsigned char notFail__1url_1args[] =
 	'T','h','i','s',' ','i','s',' ','m','o','d','u','l','e',' ','a','r','g','u','m','e','n','t','s','\0',
 };
 
+static const unsigned char notFail__1url_1args_batch[] =
+{
+	0xA1, 0x6C, 0x01, 1,    /*header, version, type */
+	0x00, 0x00, 0x00, 60,   /*size of this array*/
+	0x01,				    /*gateway message version*/
+	0x00, 0x00, 0x00, 0x00, 0x05, /* type, Size of uri*/
+	'm',  's',  'g',  '1', '\0', /*uri*/
+	0x00, 0x00, 0x00, 25,   /*module args size*/
+	'T','h','i','s',' ','i','s',' ','m','o','d','u','l','e',' ','a','r','g','u','m','e','n','t','s','\0',
+	0x00, 0x00, 0x00, 0x40, /*most messages in a frame*/
+	0x00, 0x01, 0x00, 0x00, /*most bytes in a frame*/
+	0x00, 0x00, 0x00, 0x05  /*frame linger time*/
+};
+
+static const unsigned char notFail____messageCreateReplyBatch[] =
+{
+	0xA1, 0x6C, 0x01, 2,    /*header, version, type */
+	0x00, 0x00, 0x00, 21,   /*size of this array*/
+	0x00,                   /*status*/
+	0x00, 0x00, 0x00, 0x40, /*most messages in a frame*/
+	0x00, 0x01, 0x00, 0x00, /*most bytes in a frame*/
+	0x00, 0x00, 0x00, 0x05  /*frame linger time*/
+};
+
+static const unsigned char notFail____messageCreateReplyCredit[] =
+{
+	0xA1, 0x6C, 0x01, 2,    /*header, version, type */
+	0x00, 0x00, 0x00, 25,   /*size of this array*/
+	0x00,                   /*status*/
+	0x00, 0x00, 0x00, 0x00, /*most messages in a frame, none*/
+	0x00, 0x00, 0x00, 0x00, /*most bytes in a frame*/
+	0x00, 0x00, 0x00, 0x00, /*frame linger time*/
+	0x00, 0x00, 0x01, 0x00  /*credit window*/
+};
+
+static const unsigned char notFail____messageCreateReplyVersion[] =
+{
+	0xA1, 0x6C, 0x01, 2,    /*header, version, type */
+	0x00, 0x00, 0x00, 26,   /*size of this array*/
+	0x00,                   /*status*/
+	0x00, 0x00, 0x00, 0x00, /*most messages in a frame, none*/
+	0x00, 0x00, 0x00, 0x00, /*most bytes in a frame*/
+	0x00, 0x00, 0x00, 0x00, /*frame linger time*/
+	0x00, 0x00, 0x00, 0x00, /*credit window, none*/
+	0x03                    /*highest message version*/
+};
+
+static const unsigned char notFail____messageCredit[] =
+{
+	0xA1, 0x6C, 0x01, 5,    /*header, version, type */
+	0x00, 0x00, 0x00, 12,   /*size of this array*/
+	0x00, 0x00, 0x00, 0x80  /*credits*/
+};
+
 static const unsigned char fail____headerFirstByteBad[] =
 {
 	0xA2, 0x6C, 0x01, 3,    /*header, version, type */
@@ -763,4 +817,337 @@ TEST_FUNCTION(ControlMessage_ToByteArray_create_reply_correct)
 	///cleanup
 }
 
+/*Tests_SRS_CONTROL_MESSAGE_17_038: [ If the byte array continues past the args, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_create_batch_limits)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREATE)));
+	STRICT_EXPECTED_CALL(gballoc_malloc(5));
+	STRICT_EXPECTED_CALL(gballoc_malloc(25));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_1args_batch, sizeof(notFail__1url_1args_batch));
+
+	CONTROL_MESSAGE_MODULE_CREATE* rc = (CONTROL_MESSAGE_MODULE_CREATE*)r1;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_ARE_EQUAL(int32_t, rc->args_size, 25);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.max_messages, 0x40);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.max_bytes, 0x10000);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.linger_ms, 5);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_038: [ If the byte array continues past the args, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_039: [ If the byte array continues past the status, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_without_batch_limits_sets_them_to_zero)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_1args, sizeof(notFail__1url_1args));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____minimalMessageCreateReply, sizeof(notFail____minimalMessageCreateReply));
+
+	CONTROL_MESSAGE_MODULE_CREATE* rc = (CONTROL_MESSAGE_MODULE_CREATE*)r1;
+	CONTROL_MESSAGE_MODULE_REPLY * rcr = (CONTROL_MESSAGE_MODULE_REPLY*)r2;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_IS_NOT_NULL(r2);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.max_messages, 0);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.max_bytes, 0);
+	ASSERT_ARE_EQUAL(int32_t, rc->batch_limits.linger_ms, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.max_messages, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.max_bytes, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.linger_ms, 0);
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_018: [ Reading past the end of the byte array shall cause this function to fail and return NULL. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_create_batch_limits_cut_short_fails)
+{
+	///arrange
+	unsigned char fail__1url_1args_batch[sizeof(notFail__1url_1args_batch) - 1];
+	memcpy(fail__1url_1args_batch, notFail__1url_1args_batch, sizeof(fail__1url_1args_batch));
+	fail__1url_1args_batch[7] = (unsigned char)sizeof(fail__1url_1args_batch);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREATE)));
+	STRICT_EXPECTED_CALL(gballoc_malloc(5));
+	STRICT_EXPECTED_CALL(gballoc_malloc(25));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(fail__1url_1args_batch, sizeof(fail__1url_1args_batch));
+
+	///assert
+	ASSERT_IS_NULL(r1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_039: [ If the byte array continues past the status, this function shall read the batch_limits from the byte stream, and otherwise set them to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_reply_batch_limits)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyBatch, sizeof(notFail____messageCreateReplyBatch));
+
+	CONTROL_MESSAGE_MODULE_REPLY * rcr = (CONTROL_MESSAGE_MODULE_REPLY*)r1;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_ARE_EQUAL(uint8_t, rcr->status, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.max_messages, 0x40);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.max_bytes, 0x10000);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.linger_ms, 5);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_018: [ Reading past the end of the byte array shall cause this function to fail and return NULL. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reply_batch_limits_cut_short_fails)
+{
+	///arrange
+	static const unsigned char fail____messageCreateReplyBatch[] =
+	{
+		0xA1, 0x6C, 0x01, 2,    /*header, version, type */
+		0x00, 0x00, 0x00, 13,   /*size of this array*/
+		0x00,                   /*status*/
+		0x00, 0x00, 0x00, 0x40  /*most messages in a frame, and nothing else*/
+	};
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(fail____messageCreateReplyBatch, sizeof(fail____messageCreateReplyBatch));
+
+	///assert
+	ASSERT_IS_NULL(r1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_040: [ This function shall write the batch_limits of a create or reply message after its other fields only when batch_limits.max_messages, the credit_window or the max_message_version is not zero. ]*/
+TEST_FUNCTION(ControlMessage_ToByteArray_writes_batch_limits_back)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_1args_batch, sizeof(notFail__1url_1args_batch));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyBatch, sizeof(notFail____messageCreateReplyBatch));
+	unsigned char create_buf[sizeof(notFail__1url_1args_batch)];
+	unsigned char reply_buf[sizeof(notFail____messageCreateReplyBatch)];
+	umock_c_reset_all_calls();
+
+	///act
+	int32_t c1 = ControlMessage_ToByteArray(r1, create_buf, sizeof(create_buf));
+	int32_t c2 = ControlMessage_ToByteArray(r2, reply_buf, sizeof(reply_buf));
+
+	///assert
+	ASSERT_ARE_EQUAL(int32_t, c1, sizeof(notFail__1url_1args_batch));
+	ASSERT_ARE_EQUAL(int32_t, c2, sizeof(notFail____messageCreateReplyBatch));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail__1url_1args_batch, create_buf, sizeof(create_buf)));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail____messageCreateReplyBatch, reply_buf, sizeof(reply_buf)));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_041: [ If the byte array continues past the batch_limits, this function shall read the credit_window from the byte stream, and otherwise set it to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_reply_credit_window)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyCredit, sizeof(notFail____messageCreateReplyCredit));
+
+	CONTROL_MESSAGE_MODULE_REPLY * rcr = (CONTROL_MESSAGE_MODULE_REPLY*)r1;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_ARE_EQUAL(int32_t, rcr->batch_limits.max_messages, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->credit_window, 0x100);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_041: [ If the byte array continues past the batch_limits, this function shall read the credit_window from the byte stream, and otherwise set it to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_without_credit_window_sets_it_to_zero)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_1args_batch, sizeof(notFail__1url_1args_batch));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____minimalMessageCreateReply, sizeof(notFail____minimalMessageCreateReply));
+
+	///act
+	CONTROL_MESSAGE_MODULE_CREATE * rc = (CONTROL_MESSAGE_MODULE_CREATE*)r1;
+	CONTROL_MESSAGE_MODULE_REPLY * rcr = (CONTROL_MESSAGE_MODULE_REPLY*)r2;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_IS_NOT_NULL(r2);
+	ASSERT_ARE_EQUAL(int32_t, rc->credit_window, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr->credit_window, 0);
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_018: [ Reading past the end of the byte array shall cause this function to fail and return NULL. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_022: [ This function shall release all allocated memory upon failure. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reply_credit_window_cut_short_fails)
+{
+	///arrange
+	unsigned char fail____messageCreateReplyCredit[sizeof(notFail____messageCreateReplyCredit) - 2];
+	memcpy(fail____messageCreateReplyCredit, notFail____messageCreateReplyCredit, sizeof(fail____messageCreateReplyCredit));
+	fail____messageCreateReplyCredit[7] = (unsigned char)sizeof(fail____messageCreateReplyCredit);
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(fail____messageCreateReplyCredit, sizeof(fail____messageCreateReplyCredit));
+
+	///assert
+	ASSERT_IS_NULL(r1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_043: [ This function shall allocate a CONTROL_MESSAGE_MODULE_CREDIT structure. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_044: [ This function shall read the credits from the byte stream. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_credit_message)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREDIT)));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCredit, sizeof(notFail____messageCredit));
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_ARE_EQUAL(CONTROL_MESSAGE_TYPE, r1->type, CONTROL_MESSAGE_TYPE_MODULE_CREDIT);
+	ASSERT_ARE_EQUAL(int32_t, ((CONTROL_MESSAGE_MODULE_CREDIT*)r1)->credits, 0x80);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_042: [ If the total message size is not 12 bytes, then this function shall fail and return NULL. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_credit_message_wrong_size_fails)
+{
+	///arrange
+	static const unsigned char fail____messageCredit[] =
+	{
+		0xA1, 0x6C, 0x01, 5,    /*header, version, type */
+		0x00, 0x00, 0x00, 10,   /*size of this array*/
+		0x00, 0x80              /*credits, cut short*/
+	};
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(fail____messageCredit, sizeof(fail____messageCredit));
+
+	///assert
+	ASSERT_IS_NULL(r1);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_040: [ This function shall write the batch_limits of a create or reply message after its other fields only when batch_limits.max_messages, the credit_window or the max_message_version is not zero. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_045: [ This function shall write the credit_window of a create or reply message after its batch_limits only when the credit_window or the max_message_version is not zero. ]*/
+TEST_FUNCTION(ControlMessage_ToByteArray_writes_credit_window_and_credits_back)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyCredit, sizeof(notFail____messageCreateReplyCredit));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____messageCredit, sizeof(notFail____messageCredit));
+	unsigned char reply_buf[sizeof(notFail____messageCreateReplyCredit)];
+	unsigned char credit_buf[sizeof(notFail____messageCredit)];
+	umock_c_reset_all_calls();
+
+	///act
+	int32_t c1 = ControlMessage_ToByteArray(r1, reply_buf, sizeof(reply_buf));
+	int32_t c2 = ControlMessage_ToByteArray(r2, credit_buf, sizeof(credit_buf));
+
+	///assert
+	ASSERT_ARE_EQUAL(int32_t, c1, sizeof(notFail____messageCreateReplyCredit));
+	ASSERT_ARE_EQUAL(int32_t, c2, sizeof(notFail____messageCredit));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail____messageCreateReplyCredit, reply_buf, sizeof(reply_buf)));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail____messageCredit, credit_buf, sizeof(credit_buf)));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_046: [ If the byte array continues past the credit_window, this function shall read the max_message_version from the byte stream, and otherwise set it to zero. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_reply_max_message_version)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyVersion, sizeof(notFail____messageCreateReplyVersion));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyCredit, sizeof(notFail____messageCreateReplyCredit));
+	CONTROL_MESSAGE * r3 = ControlMessage_CreateFromByteArray(notFail__1url_1args_batch, sizeof(notFail__1url_1args_batch));
+
+	///act
+	CONTROL_MESSAGE_MODULE_REPLY * rcr1 = (CONTROL_MESSAGE_MODULE_REPLY*)r1;
+	CONTROL_MESSAGE_MODULE_REPLY * rcr2 = (CONTROL_MESSAGE_MODULE_REPLY*)r2;
+	CONTROL_MESSAGE_MODULE_CREATE * rc3 = (CONTROL_MESSAGE_MODULE_CREATE*)r3;
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_IS_NOT_NULL(r2);
+	ASSERT_IS_NOT_NULL(r3);
+	ASSERT_ARE_EQUAL(int32_t, rcr1->credit_window, 0);
+	ASSERT_ARE_EQUAL(int32_t, rcr1->max_message_version, 3);
+	ASSERT_ARE_EQUAL(int32_t, rcr2->max_message_version, 0);
+	ASSERT_ARE_EQUAL(int32_t, rc3->max_message_version, 0);
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+	ControlMessage_Destroy(r3);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_040: [ This function shall write the batch_limits of a create or reply message after its other fields only when batch_limits.max_messages, the credit_window or the max_message_version is not zero. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_045: [ This function shall write the credit_window of a create or reply message after its batch_limits only when the credit_window or the max_message_version is not zero. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_047: [ This function shall write the max_message_version of a create or reply message after its credit_window only when it is not zero. ]*/
+TEST_FUNCTION(ControlMessage_ToByteArray_writes_max_message_version_back)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyVersion, sizeof(notFail____messageCreateReplyVersion));
+	unsigned char reply_buf[sizeof(notFail____messageCreateReplyVersion)];
+	umock_c_reset_all_calls();
+
+	///act
+	int32_t c1 = ControlMessage_ToByteArray(r1, reply_buf, sizeof(reply_buf));
+
+	///assert
+	ASSERT_ARE_EQUAL(int32_t, c1, sizeof(notFail____messageCreateReplyVersion));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail____messageCreateReplyVersion, reply_buf, sizeof(reply_buf)));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
 END_TEST_SUITE(control_message_ut)
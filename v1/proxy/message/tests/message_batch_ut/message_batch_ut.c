@@ -0,0 +1,631 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "message.h"
+#undef ENABLE_MOCKS
+
+#include "message_batch.h"
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*fake messages: the handle is a pointer to one of these*/
+typedef struct FAKE_MESSAGE_TAG
+{
+    CONSTBUFFER serialized;
+    int references;
+} FAKE_MESSAGE;
+
+static FAKE_MESSAGE message_a;
+static FAKE_MESSAGE message_b;
+static FAKE_MESSAGE message_c;
+
+static const unsigned char bytes_a[] = { 'h', 'e', 'l', 'l', 'o' };
+static const unsigned char bytes_b[] = { 'w', 'o', 'r', 'l', 'd', '!' };
+static const unsigned char bytes_c[] = { 'x' };
+
+static void init_fake_message(FAKE_MESSAGE* message, const unsigned char* bytes, size_t size)
+{
+    message->serialized.buffer = bytes;
+    message->serialized.size = size;
+    message->references = 1;
+}
+
+static const CONSTBUFFER* my_Message_GetByteArray(MESSAGE_HANDLE message)
+{
+    return &((FAKE_MESSAGE*)message)->serialized;
+}
+
+static MESSAGE_HANDLE my_Message_Clone(MESSAGE_HANDLE message)
+{
+    ((FAKE_MESSAGE*)message)->references++;
+    return message;
+}
+
+static void my_Message_Destroy(MESSAGE_HANDLE message)
+{
+    ((FAKE_MESSAGE*)message)->references--;
+}
+
+/*the frame made from message_a and message_b*/
+static const unsigned char frame_a_b[] =
+{
+    0xA1, 0x62, 0x01,           /*header, version*/
+    0x00, 0x00, 0x00, 30,       /*size of this array*/
+    0x00, 0x00, 0x00, 2,        /*message count*/
+    0x00, 0x00, 0x00, 5,        /*size of first message*/
+    'h', 'e', 'l', 'l', 'o',
+    0x00, 0x00, 0x00, 6,        /*size of second message*/
+    'w', 'o', 'r', 'l', 'd', '!'
+};
+
+#define MAX_DELIVERED 4
+static size_t delivered_count;
+static const unsigned char* delivered_source[MAX_DELIVERED];
+static int32_t delivered_size[MAX_DELIVERED];
+
+static void on_message(void* context, const unsigned char* source, int32_t size)
+{
+    (void)context;
+    if (delivered_count < MAX_DELIVERED)
+    {
+        delivered_source[delivered_count] = source;
+        delivered_size[delivered_count] = size;
+    }
+    delivered_count++;
+}
+
+BEGIN_TEST_SUITE(message_batch_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_calloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Message_GetByteArray, my_Message_GetByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Message_GetByteArray, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_Clone, my_Message_Clone);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Message_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_Destroy, my_Message_Destroy);
+
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const CONSTBUFFER*, void*);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    init_fake_message(&message_a, bytes_a, sizeof(bytes_a));
+    init_fake_message(&message_b, bytes_b, sizeof(bytes_b));
+    init_fake_message(&message_c, bytes_c, sizeof(bytes_c));
+    delivered_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+static MESSAGE_BATCH_HANDLE create_batch(uint32_t max_messages, uint32_t max_bytes)
+{
+    MESSAGE_BATCH_LIMITS limits = { max_messages, max_bytes, 0 };
+    MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(&limits);
+    ASSERT_IS_NOT_NULL(batch);
+    umock_c_reset_all_calls();
+    return batch;
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_001: [ If limits is NULL, or either limits->max_messages or limits->max_bytes is zero, this function shall return NULL. ]*/
+TEST_FUNCTION(MessageBatch_Create_with_invalid_limits_fails)
+{
+    ///arrange
+    MESSAGE_BATCH_LIMITS no_messages = { 0, 100, 0 };
+    MESSAGE_BATCH_LIMITS no_bytes = { 2, 0, 0 };
+
+    ///act
+    MESSAGE_BATCH_HANDLE r1 = MessageBatch_Create(NULL);
+    MESSAGE_BATCH_HANDLE r2 = MessageBatch_Create(&no_messages);
+    MESSAGE_BATCH_HANDLE r3 = MessageBatch_Create(&no_bytes);
+
+    ///assert
+    ASSERT_IS_NULL(r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_IS_NULL(r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_002: [ This function shall allocate a batch and room for limits->max_messages messages. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_004: [ This function shall return a batch holding no messages. ]*/
+TEST_FUNCTION(MessageBatch_Create_success)
+{
+    ///arrange
+    MESSAGE_BATCH_LIMITS limits = { 4, 100, 0 };
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(4, IGNORED_NUM_ARG));
+
+    ///act
+    MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(&limits);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(batch);
+    ASSERT_ARE_EQUAL(size_t, 0, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_003: [ If any allocation fails, this function shall free all it allocated and return NULL. ]*/
+TEST_FUNCTION(MessageBatch_Create_allocation_fails)
+{
+    ///arrange
+    MESSAGE_BATCH_LIMITS limits = { 4, 100, 0 };
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(4, IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(&limits);
+
+        ///assert
+        ASSERT_IS_NULL(batch);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_005: [ If batch is NULL, this function shall do nothing. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_007: [ If batch is NULL, this function shall do nothing. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_017: [ If batch is NULL, this function shall return 0. ]*/
+TEST_FUNCTION(MessageBatch_functions_with_NULL_batch_do_nothing)
+{
+    ///act
+    MessageBatch_Clear(NULL);
+    MessageBatch_Destroy(NULL);
+    size_t count = MessageBatch_GetCount(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_009: [ If batch or message is NULL, this function shall return MESSAGE_BATCH_ERROR. ]*/
+TEST_FUNCTION(MessageBatch_Add_with_NULL_args_fails)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+
+    ///act
+    MESSAGE_BATCH_RESULT r1 = MessageBatch_Add(NULL, (MESSAGE_HANDLE)&message_a);
+    MESSAGE_BATCH_RESULT r2 = MessageBatch_Add(batch, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_ERROR, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_ERROR, (int)r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_011: [ This function shall get the serialized form of message by calling Message_GetByteArray. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_015: [ This function shall keep a clone of message, made by calling Message_Clone. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_016: [ Once the message is added, this function shall return MESSAGE_BATCH_FULL if the batch holds max_messages messages or its frame is at least max_bytes bytes, and MESSAGE_BATCH_OK otherwise. ]*/
+TEST_FUNCTION(MessageBatch_Add_success)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    STRICT_EXPECTED_CALL(Message_GetByteArray((MESSAGE_HANDLE)&message_a));
+    STRICT_EXPECTED_CALL(Message_Clone((MESSAGE_HANDLE)&message_a));
+
+    ///act
+    MESSAGE_BATCH_RESULT result = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_OK, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(int, 2, message_a.references);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_016: [ Once the message is added, this function shall return MESSAGE_BATCH_FULL if the batch holds max_messages messages or its frame is at least max_bytes bytes, and MESSAGE_BATCH_OK otherwise. ]*/
+TEST_FUNCTION(MessageBatch_Add_returns_full_at_max_messages)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(2, 100);
+
+    ///act
+    MESSAGE_BATCH_RESULT r1 = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    MESSAGE_BATCH_RESULT r2 = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_OK, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_FULL, (int)r2);
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_016: [ Once the message is added, this function shall return MESSAGE_BATCH_FULL if the batch holds max_messages messages or its frame is at least max_bytes bytes, and MESSAGE_BATCH_OK otherwise. ]*/
+TEST_FUNCTION(MessageBatch_Add_returns_full_at_max_bytes)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, sizeof(frame_a_b));
+
+    ///act
+    MESSAGE_BATCH_RESULT r1 = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    MESSAGE_BATCH_RESULT r2 = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_OK, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_FULL, (int)r2);
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_010: [ If the batch already holds max_messages messages, this function shall return MESSAGE_BATCH_NO_ROOM. ]*/
+TEST_FUNCTION(MessageBatch_Add_past_max_messages_returns_no_room)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(1, 100);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    umock_c_reset_all_calls();
+
+    ///act
+    MESSAGE_BATCH_RESULT result = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_NO_ROOM, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(int, 1, message_b.references);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_013: [ If adding the message would make the frame larger than max_bytes or than INT32_MAX bytes, and the batch is not empty, this function shall return MESSAGE_BATCH_NO_ROOM. ]*/
+TEST_FUNCTION(MessageBatch_Add_past_max_bytes_returns_no_room)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, sizeof(frame_a_b) - 1);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_GetByteArray((MESSAGE_HANDLE)&message_b));
+
+    ///act
+    MESSAGE_BATCH_RESULT result = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_NO_ROOM, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(int, 1, message_b.references);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_016: [ Once the message is added, this function shall return MESSAGE_BATCH_FULL if the batch holds max_messages messages or its frame is at least max_bytes bytes, and MESSAGE_BATCH_OK otherwise. ]*/
+TEST_FUNCTION(MessageBatch_Add_first_message_larger_than_max_bytes_is_added)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 12);
+
+    ///act
+    MESSAGE_BATCH_RESULT result = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_FULL, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_012: [ If getting the serialized form or cloning the message fails, this function shall return MESSAGE_BATCH_ERROR and leave the batch unchanged. ]*/
+TEST_FUNCTION(MessageBatch_Add_fails_when_a_call_fails)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Message_GetByteArray((MESSAGE_HANDLE)&message_a));
+    STRICT_EXPECTED_CALL(Message_Clone((MESSAGE_HANDLE)&message_a));
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        MESSAGE_BATCH_RESULT result = MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, (int)MESSAGE_BATCH_ERROR, (int)result);
+        ASSERT_ARE_EQUAL(size_t, 0, MessageBatch_GetCount(batch));
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_006: [ This function shall destroy every message held by the batch and leave it empty. ]*/
+TEST_FUNCTION(MessageBatch_Clear_destroys_messages)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&message_a));
+    STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&message_b));
+
+    ///act
+    MessageBatch_Clear(batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(int, 1, message_a.references);
+    ASSERT_ARE_EQUAL(int, 1, message_b.references);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_008: [ This function shall destroy every message held by the batch and free the batch. ]*/
+TEST_FUNCTION(MessageBatch_Destroy_destroys_messages_and_frees)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)&message_a));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    MessageBatch_Destroy(batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 1, message_a.references);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_019: [ If batch is NULL or empty, or buf is NULL and size is not zero, this function shall return -1. ]*/
+TEST_FUNCTION(MessageBatch_ToByteArray_with_invalid_args_fails)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    unsigned char buf[64];
+
+    ///act
+    int32_t r1 = MessageBatch_ToByteArray(NULL, buf, sizeof(buf));
+    int32_t r2 = MessageBatch_ToByteArray(batch, buf, sizeof(buf));
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    int32_t r3 = MessageBatch_ToByteArray(batch, NULL, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, -1, r1);
+    ASSERT_ARE_EQUAL(int32_t, -1, r2);
+    ASSERT_ARE_EQUAL(int32_t, -1, r3);
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_020: [ If buf is NULL and size is zero, this function shall return the size of the frame. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_021: [ If size is smaller than the frame, this function shall return -1. ]*/
+TEST_FUNCTION(MessageBatch_ToByteArray_returns_size_and_checks_buffer)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    unsigned char buf[sizeof(frame_a_b)];
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+
+    ///act
+    int32_t needed = MessageBatch_ToByteArray(batch, NULL, 0);
+    int32_t too_small = MessageBatch_ToByteArray(batch, buf, sizeof(buf) - 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, (int32_t)sizeof(frame_a_b), needed);
+    ASSERT_ARE_EQUAL(int32_t, -1, too_small);
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_022: [ This function shall write the frame header: 0xA1 0x62, the frame version, the frame size and the message count. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_023: [ This function shall write the size and the serialized bytes of each message, in the order they were added. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_024: [ Upon success, this function shall return the size of the frame. ]*/
+TEST_FUNCTION(MessageBatch_ToByteArray_writes_frame)
+{
+    ///arrange
+    MESSAGE_BATCH_HANDLE batch = create_batch(4, 100);
+    unsigned char buf[sizeof(frame_a_b)];
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_a);
+    (void)MessageBatch_Add(batch, (MESSAGE_HANDLE)&message_b);
+    umock_c_reset_all_calls();
+
+    ///act
+    int32_t result = MessageBatch_ToByteArray(batch, buf, sizeof(buf));
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, (int32_t)sizeof(frame_a_b), result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(buf, frame_a_b, sizeof(frame_a_b)));
+    ASSERT_ARE_EQUAL(size_t, 2, MessageBatch_GetCount(batch));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    MessageBatch_Destroy(batch);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_025: [ This function shall return true if source is not NULL, size is at least the frame header size, and source starts with 0xA1 0x62 and the current frame version; and false otherwise. ]*/
+TEST_FUNCTION(MessageBatch_IsFrame_checks_header)
+{
+    ///arrange
+    unsigned char message_v1[sizeof(frame_a_b)];
+    memcpy(message_v1, frame_a_b, sizeof(frame_a_b));
+    message_v1[1] = 0x60;
+
+    ///act
+    bool r1 = MessageBatch_IsFrame(frame_a_b, sizeof(frame_a_b));
+    bool r2 = MessageBatch_IsFrame(NULL, sizeof(frame_a_b));
+    bool r3 = MessageBatch_IsFrame(frame_a_b, MESSAGE_BATCH_FRAME_HEADER_SIZE - 1);
+    bool r4 = MessageBatch_IsFrame(message_v1, sizeof(message_v1));
+
+    ///assert
+    ASSERT_IS_TRUE(r1);
+    ASSERT_IS_FALSE(r2);
+    ASSERT_IS_FALSE(r3);
+    ASSERT_IS_FALSE(r4);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_029: [ This function shall call on_message with context and the bytes and size of each message, in frame order. ]*/
+/*Tests_SRS_MESSAGE_BATCH_17_030: [ Upon success, this function shall return 0. ]*/
+TEST_FUNCTION(MessageBatch_ForEachMessage_delivers_each_message)
+{
+    ///act
+    int result = MessageBatch_ForEachMessage(frame_a_b, sizeof(frame_a_b), on_message, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, delivered_count);
+    ASSERT_ARE_EQUAL(int32_t, 5, delivered_size[0]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(delivered_source[0], bytes_a, sizeof(bytes_a)));
+    ASSERT_ARE_EQUAL(int32_t, 6, delivered_size[1]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(delivered_source[1], bytes_b, sizeof(bytes_b)));
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_026: [ If on_message is NULL or source is not a frame, this function shall return a non-zero value. ]*/
+TEST_FUNCTION(MessageBatch_ForEachMessage_with_invalid_args_fails)
+{
+    ///act
+    int r1 = MessageBatch_ForEachMessage(frame_a_b, sizeof(frame_a_b), NULL, NULL);
+    int r2 = MessageBatch_ForEachMessage(NULL, sizeof(frame_a_b), on_message, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, r1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r2);
+    ASSERT_ARE_EQUAL(size_t, 0, delivered_count);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_027: [ If the frame size is not equal to size, this function shall return a non-zero value. ]*/
+TEST_FUNCTION(MessageBatch_ForEachMessage_with_wrong_size_fails)
+{
+    ///act
+    int result = MessageBatch_ForEachMessage(frame_a_b, sizeof(frame_a_b) - 1, on_message, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, delivered_count);
+}
+
+/*Tests_SRS_MESSAGE_BATCH_17_028: [ This function shall check every message entry fits in the frame and that no bytes follow the last entry before calling on_message, and return a non-zero value otherwise. ]*/
+TEST_FUNCTION(MessageBatch_ForEachMessage_with_malformed_entries_delivers_nothing)
+{
+    ///arrange
+    unsigned char too_many[sizeof(frame_a_b)];
+    unsigned char too_few[sizeof(frame_a_b)];
+    unsigned char entry_too_long[sizeof(frame_a_b)];
+    memcpy(too_many, frame_a_b, sizeof(frame_a_b));
+    memcpy(too_few, frame_a_b, sizeof(frame_a_b));
+    memcpy(entry_too_long, frame_a_b, sizeof(frame_a_b));
+    too_many[10] = 3;
+    too_few[10] = 1;
+    entry_too_long[23] = 7;
+
+    ///act
+    int r1 = MessageBatch_ForEachMessage(too_many, sizeof(too_many), on_message, NULL);
+    int r2 = MessageBatch_ForEachMessage(too_few, sizeof(too_few), on_message, NULL);
+    int r3 = MessageBatch_ForEachMessage(entry_too_long, sizeof(entry_too_long), on_message, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, r1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r3);
+    ASSERT_ARE_EQUAL(size_t, 0, delivered_count);
+}
+
+END_TEST_SUITE(message_batch_ut)
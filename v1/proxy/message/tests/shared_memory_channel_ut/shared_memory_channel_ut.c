@@ -0,0 +1,628 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "shared_memory.h"
+#undef ENABLE_MOCKS
+
+#include "shared_memory_channel.h"
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*the channel header and the control of both rings, as laid out by the channel*/
+#define CHANNEL_HEADER_SIZE     (64 + 2 * 128)
+#define RING_SIZE               SHARED_MEMORY_CHANNEL_RING_SIZE_MIN
+
+#define TEST_MEMORY_CREATED     ((SHARED_MEMORY_HANDLE)0x5100)
+#define TEST_MEMORY_OPENED      ((SHARED_MEMORY_HANDLE)0x5101)
+#define TEST_LOCK               ((LOCK_HANDLE)0x10)
+
+/*both ends of a channel map this buffer*/
+static unsigned char* region;
+static size_t region_size;
+
+static SHARED_MEMORY_HANDLE my_SharedMemory_Create(const char* name, size_t size, void** address)
+{
+    (void)name;
+    free(region);
+    region = (unsigned char*)calloc(1, size);
+    region_size = size;
+    *address = region;
+    return TEST_MEMORY_CREATED;
+}
+
+static SHARED_MEMORY_HANDLE my_SharedMemory_Open(const char* name, void** address, size_t* size)
+{
+    (void)name;
+    *address = region;
+    *size = region_size;
+    return TEST_MEMORY_OPENED;
+}
+
+static unsigned char payload[RING_SIZE];
+
+BEGIN_TEST_SUITE(shared_memory_channel_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(SharedMemory_Create, my_SharedMemory_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SharedMemory_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(SharedMemory_Open, my_SharedMemory_Open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SharedMemory_Open, NULL);
+    /*nothing wakes a sleeper in these tests, so every wait times out*/
+    REGISTER_GLOBAL_MOCK_RETURN(SharedMemory_Wait, 1);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(SHARED_MEMORY_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(volatile uint32_t*, void*);
+
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (unsigned char)i;
+    }
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    free(region);
+    region = NULL;
+    region_size = 0;
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*the gateway end*/
+static SHARED_MEMORY_CHANNEL_HANDLE create_channel(void)
+{
+    SHARED_MEMORY_CHANNEL_HANDLE channel = SharedMemoryChannel_Create("shm://channel", RING_SIZE);
+    ASSERT_IS_NOT_NULL(channel);
+    umock_c_reset_all_calls();
+    return channel;
+}
+
+/*the module host end*/
+static SHARED_MEMORY_CHANNEL_HANDLE open_channel(void)
+{
+    SHARED_MEMORY_CHANNEL_HANDLE channel = SharedMemoryChannel_Open("shm://channel");
+    ASSERT_IS_NOT_NULL(channel);
+    umock_c_reset_all_calls();
+    return channel;
+}
+
+static void receive_and_check(SHARED_MEMORY_CHANNEL_HANDLE channel, int32_t expected_size)
+{
+    const unsigned char* buf;
+    int32_t size;
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Receive(channel, &buf, &size, 0);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)result);
+    ASSERT_ARE_EQUAL(int32_t, expected_size, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(buf, payload, (size_t)size));
+    SharedMemoryChannel_Release(channel);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_001: [ SharedMemoryChannel_Create and SharedMemoryChannel_Open shall return NULL if uri is NULL or does not start with "shm://". ]*/
+TEST_FUNCTION(SharedMemoryChannel_Create_and_Open_with_invalid_uri_fail)
+{
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE r1 = SharedMemoryChannel_Create(NULL, RING_SIZE);
+    SHARED_MEMORY_CHANNEL_HANDLE r2 = SharedMemoryChannel_Create("ipc://channel", RING_SIZE);
+    SHARED_MEMORY_CHANNEL_HANDLE r3 = SharedMemoryChannel_Open(NULL);
+    SHARED_MEMORY_CHANNEL_HANDLE r4 = SharedMemoryChannel_Open("shm:/channel");
+
+    ///assert
+    ASSERT_IS_NULL(r1);
+    ASSERT_IS_NULL(r2);
+    ASSERT_IS_NULL(r3);
+    ASSERT_IS_NULL(r4);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_002: [ SharedMemoryChannel_Create shall round ring_size up to a power of two between SHARED_MEMORY_CHANNEL_RING_SIZE_MIN and SHARED_MEMORY_CHANNEL_RING_SIZE_MAX. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_003: [ SharedMemoryChannel_Create shall create shared memory for the channel header and two rings by calling SharedMemory_Create with the rest of uri as the name. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(SharedMemory_Create("channel", CHANNEL_HEADER_SIZE + 2 * 8192, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE channel = SharedMemoryChannel_Create("shm://channel", 5000);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(channel);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(channel);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_002: [ SharedMemoryChannel_Create shall round ring_size up to a power of two between SHARED_MEMORY_CHANNEL_RING_SIZE_MIN and SHARED_MEMORY_CHANNEL_RING_SIZE_MAX. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Create_uses_the_smallest_ring_for_small_sizes)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(SharedMemory_Create("channel", CHANNEL_HEADER_SIZE + 2 * RING_SIZE, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE channel = SharedMemoryChannel_Create("shm://channel", 0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(channel);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(channel);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_005: [ If any step fails, SharedMemoryChannel_Create and SharedMemoryChannel_Open shall free all they allocated and return NULL. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Create_fails_when_a_step_fails)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(SharedMemory_Create("channel", IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2).IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        SHARED_MEMORY_CHANNEL_HANDLE channel = SharedMemoryChannel_Create("shm://channel", RING_SIZE);
+
+        ///assert
+        ASSERT_IS_NULL(channel);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_004: [ SharedMemoryChannel_Create shall write the channel version and ring size, then the channel marker; the zero filled rings start out empty. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_006: [ SharedMemoryChannel_Open shall map the shared memory by calling SharedMemory_Open with the rest of uri as the name. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Open_success)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    STRICT_EXPECTED_CALL(SharedMemory_Open("channel", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2).IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE host = SharedMemoryChannel_Open("shm://channel");
+
+    ///assert
+    ASSERT_IS_NOT_NULL(host);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_007: [ SharedMemoryChannel_Open shall fail if the shared memory does not hold a channel of the current version whose rings fit in it. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Open_fails_on_memory_that_is_not_a_channel)
+{
+    ///arrange
+    region_size = CHANNEL_HEADER_SIZE + 2 * RING_SIZE;
+    region = (unsigned char*)calloc(1, region_size);
+    ASSERT_IS_NOT_NULL(region);
+    STRICT_EXPECTED_CALL(SharedMemory_Open("channel", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2).IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(SharedMemory_Close(TEST_MEMORY_OPENED));
+
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE host = SharedMemoryChannel_Open("shm://channel");
+
+    ///assert
+    ASSERT_IS_NULL(host);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_007: [ SharedMemoryChannel_Open shall fail if the shared memory does not hold a channel of the current version whose rings fit in it. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Open_fails_when_the_rings_do_not_fit)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    region_size -= 1;
+    STRICT_EXPECTED_CALL(SharedMemory_Open("channel", IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2).IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(SharedMemory_Close(TEST_MEMORY_OPENED));
+
+    ///act
+    SHARED_MEMORY_CHANNEL_HANDLE host = SharedMemoryChannel_Open("shm://channel");
+
+    ///assert
+    ASSERT_IS_NULL(host);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_008: [ If channel is NULL, SharedMemoryChannel_Close and SharedMemoryChannel_Destroy shall do nothing. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_022: [ If channel is NULL or holds no received buffer, SharedMemoryChannel_Release shall do nothing. ]*/
+TEST_FUNCTION(SharedMemoryChannel_functions_with_NULL_channel_do_nothing)
+{
+    ///act
+    SharedMemoryChannel_Close(NULL);
+    SharedMemoryChannel_Destroy(NULL);
+    SharedMemoryChannel_Release(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_010: [ SharedMemoryChannel_Destroy shall close the channel, unmap it by calling SharedMemory_Close and free it. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Destroy_success)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    STRICT_EXPECTED_CALL(SharedMemory_WakeAll(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(SharedMemory_WakeAll(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(SharedMemory_Close(TEST_MEMORY_CREATED));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    SharedMemoryChannel_Destroy(gateway);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_011: [ If channel is NULL, size is negative, or buf is NULL and size is not zero, SharedMemoryChannel_Send shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_018: [ If channel, buf or size is NULL, or the buffer last received was not released, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Send_and_Receive_with_invalid_args_fail)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    const unsigned char* buf;
+    int32_t size;
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT r1 = SharedMemoryChannel_Send(NULL, payload, 1, 0);
+    SHARED_MEMORY_CHANNEL_RESULT r2 = SharedMemoryChannel_Send(gateway, payload, -1, 0);
+    SHARED_MEMORY_CHANNEL_RESULT r3 = SharedMemoryChannel_Send(gateway, NULL, 1, 0);
+    SHARED_MEMORY_CHANNEL_RESULT r4 = SharedMemoryChannel_Receive(NULL, &buf, &size, 0);
+    SHARED_MEMORY_CHANNEL_RESULT r5 = SharedMemoryChannel_Receive(gateway, NULL, &size, 0);
+    SHARED_MEMORY_CHANNEL_RESULT r6 = SharedMemoryChannel_Receive(gateway, &buf, NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r2);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r3);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r4);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r5);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)r6);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_012: [ If the 4 byte size and the bytes of buf, rounded up to 8 bytes, do not fit in a ring, SharedMemoryChannel_Send shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Send_larger_than_the_ring_fails)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Send(gateway, payload, RING_SIZE - 3, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_013: [ SharedMemoryChannel_Send shall hold a lock while it writes, so several threads can send on one channel. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_017: [ SharedMemoryChannel_Send shall write the size and the bytes of buf to the ring, then publish them and wake the receiver if it sleeps. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Send_success)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Send(gateway, payload, 10, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_013: [ SharedMemoryChannel_Send shall hold a lock while it writes, so several threads can send on one channel. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Send_fails_when_lock_fails)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK))
+        .SetReturn(LOCK_ERROR);
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Send(gateway, payload, 10, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_020: [ SharedMemoryChannel_Receive shall set *buf and *size to the oldest buffer, in place in the ring, and return SHARED_MEMORY_CHANNEL_OK. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_023: [ SharedMemoryChannel_Release shall give the room of the buffer last received back to the sender and wake it if it sleeps. ]*/
+TEST_FUNCTION(SharedMemoryChannel_buffers_go_both_ways_in_order)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+
+    ///act
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, 5, 0));
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, 0, 0));
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, 300, 0));
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(host, payload, 7, 0));
+
+    ///assert
+    receive_and_check(host, 5);
+    receive_and_check(host, 0);
+    receive_and_check(host, 300);
+    receive_and_check(gateway, 7);
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_018: [ If channel, buf or size is NULL, or the buffer last received was not released, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Receive_before_Release_fails)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+    const unsigned char* buf;
+    int32_t size;
+    (void)SharedMemoryChannel_Send(gateway, payload, 5, 0);
+    (void)SharedMemoryChannel_Send(gateway, payload, 6, 0);
+    (void)SharedMemoryChannel_Receive(host, &buf, &size, 0);
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Receive(host, &buf, &size, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)result);
+    SharedMemoryChannel_Release(host);
+    receive_and_check(host, 6);
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_014: [ A record that would run past the end of the ring shall start at the beginning of the ring, after a marker telling the receiver to skip the rest. ]*/
+TEST_FUNCTION(SharedMemoryChannel_buffers_wrap_around_the_ring)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, 3000, 0));
+    receive_and_check(host, 3000);
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Send(gateway, payload, 2000, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)result);
+    receive_and_check(host, 2000);
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_015: [ If the ring is full, SharedMemoryChannel_Send shall wait for room until timeout_ms elapses, or forever if it is negative, and return SHARED_MEMORY_CHANNEL_TIMEOUT if it does. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Send_on_a_full_ring_times_out)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, RING_SIZE - 4, 0));
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT r1 = SharedMemoryChannel_Send(gateway, payload, 0, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(SharedMemory_Wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG, 10))
+        .IgnoreArgument(1).IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    SHARED_MEMORY_CHANNEL_RESULT r2 = SharedMemoryChannel_Send(gateway, payload, 0, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_TIMEOUT, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_TIMEOUT, (int)r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    receive_and_check(host, RING_SIZE - 4);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_OK, (int)SharedMemoryChannel_Send(gateway, payload, 0, 0));
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_021: [ If the ring is empty, SharedMemoryChannel_Receive shall wait for a buffer until timeout_ms elapses, or forever if it is negative, and return SHARED_MEMORY_CHANNEL_TIMEOUT if it does. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Receive_on_an_empty_ring_times_out)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    const unsigned char* buf;
+    int32_t size;
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT r1 = SharedMemoryChannel_Receive(gateway, &buf, &size, 0);
+    STRICT_EXPECTED_CALL(SharedMemory_Wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG, 10))
+        .IgnoreArgument(1).IgnoreArgument(2);
+    SHARED_MEMORY_CHANNEL_RESULT r2 = SharedMemoryChannel_Receive(gateway, &buf, &size, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_TIMEOUT, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_TIMEOUT, (int)r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_019: [ If the oldest record does not fit within the ring and what the sender published, SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_ERROR. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Receive_of_a_corrupt_record_fails)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+    const unsigned char* buf;
+    int32_t size;
+    uint32_t bad_size = RING_SIZE;
+    (void)SharedMemoryChannel_Send(gateway, payload, 8, 0);
+    /*the first record of ring 0 starts right after the header*/
+    (void)memcpy(region + CHANNEL_HEADER_SIZE, &bad_size, sizeof(bad_size));
+
+    ///act
+    SHARED_MEMORY_CHANNEL_RESULT result = SharedMemoryChannel_Receive(host, &buf, &size, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_ERROR, (int)result);
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_009: [ SharedMemoryChannel_Close shall mark the channel closed, then wake any thread waiting for a buffer or for room. ]*/
+/*Tests_SRS_SHARED_MEMORY_CHANNEL_17_016: [ SharedMemoryChannel_Send and SharedMemoryChannel_Receive shall return SHARED_MEMORY_CHANNEL_CLOSED once the channel is closed. ]*/
+TEST_FUNCTION(SharedMemoryChannel_Close_ends_sends_and_receives)
+{
+    ///arrange
+    SHARED_MEMORY_CHANNEL_HANDLE gateway = create_channel();
+    SHARED_MEMORY_CHANNEL_HANDLE host = open_channel();
+    const unsigned char* buf;
+    int32_t size;
+    (void)SharedMemoryChannel_Send(host, payload, 8, 0);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(SharedMemory_WakeAll(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(SharedMemory_WakeAll(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    SharedMemoryChannel_Close(gateway);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    SHARED_MEMORY_CHANNEL_RESULT r1 = SharedMemoryChannel_Send(gateway, payload, 8, -1);
+    SHARED_MEMORY_CHANNEL_RESULT r2 = SharedMemoryChannel_Receive(gateway, &buf, &size, -1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_CLOSED, (int)r1);
+    ASSERT_ARE_EQUAL(int, (int)SHARED_MEMORY_CHANNEL_CLOSED, (int)r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SharedMemoryChannel_Destroy(host);
+    SharedMemoryChannel_Destroy(gateway);
+}
+
+END_TEST_SUITE(shared_memory_channel_ut)
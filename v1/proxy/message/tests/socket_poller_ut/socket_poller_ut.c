@@ -0,0 +1,640 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+
+#include <nanomsg/nn.h>
+#include <nanomsg/pair.h>
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/vector.h"
+#undef ENABLE_MOCKS
+
+#include "socket_poller.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+VECTOR_HANDLE real_VECTOR_create(size_t elementSize);
+VECTOR_HANDLE real_VECTOR_move(VECTOR_HANDLE handle);
+void real_VECTOR_destroy(VECTOR_HANDLE handle);
+int real_VECTOR_push_back(VECTOR_HANDLE handle, const void* elements, size_t numElements);
+void real_VECTOR_erase(VECTOR_HANDLE handle, void* elements, size_t numElements);
+void real_VECTOR_clear(VECTOR_HANDLE handle);
+void* real_VECTOR_element(const VECTOR_HANDLE handle, size_t index);
+void* real_VECTOR_front(const VECTOR_HANDLE handle);
+void* real_VECTOR_back(const VECTOR_HANDLE handle);
+void* real_VECTOR_find_if(const VECTOR_HANDLE handle, PREDICATE_FUNCTION pred, const void* value);
+size_t real_VECTOR_size(const VECTOR_HANDLE handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef _MSC_VER
+#pragma warning(disable:4505)
+#endif
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+#define TEST_LOCK               ((LOCK_HANDLE)0x10)
+#define TEST_CONDITION          ((COND_HANDLE)0x11)
+#define TEST_THREAD             ((THREAD_HANDLE)0x12)
+/*the sockets made by the poller, in the order nn_socket makes them*/
+#define WAKE_RECEIVER           1
+#define WAKE_SENDER             2
+#define SOCKET_A                7
+#define SOCKET_B                8
+#define CONTEXT_A               ((void*)0xA)
+#define CONTEXT_B               ((void*)0xB)
+
+/* nanomsg mocks
+ */
+
+static int next_nn_socket;
+static int nn_errno_value;
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_socket, int, domain, int, protocol)
+MOCK_FUNCTION_END(++next_nn_socket)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_bind, int, s, const char *, addr)
+MOCK_FUNCTION_END(1)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_connect, int, s, const char *, addr)
+MOCK_FUNCTION_END(1)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_close, int, s)
+MOCK_FUNCTION_END(0)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_errno)
+MOCK_FUNCTION_END(nn_errno_value)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_send, int, s, const void *, buf, size_t, len, int, flags)
+MOCK_FUNCTION_END((int)len)
+
+/*wake messages waiting on the wake socket*/
+static int pending_wakes;
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_recv, int, s, void *, buf, size_t, len, int, flags)
+    int rcv_length;
+    if (pending_wakes > 0)
+    {
+        pending_wakes--;
+        *(void**)buf = my_gballoc_malloc(1);
+        rcv_length = 1;
+    }
+    else
+    {
+        nn_errno_value = EAGAIN;
+        rcv_length = -1;
+    }
+MOCK_FUNCTION_END(rcv_length)
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_freemsg, void *, msg)
+    my_gballoc_free(msg);
+MOCK_FUNCTION_END(0)
+
+/*the first poll marks poll_readable_index readable, or fails with first_poll_errno if it is not 0; later polls fail with ETERM*/
+static int poll_count;
+static int poll_readable_index;
+static int first_poll_errno;
+static int last_poll_nfds;
+static int last_poll_timeout;
+static int last_poll_fds[4];
+
+MOCK_FUNCTION_WITH_CODE(, int, nn_poll, struct nn_pollfd *, fds, int, nfds, int, timeout)
+    int poll_result;
+    poll_count++;
+    last_poll_nfds = nfds;
+    last_poll_timeout = timeout;
+    for (int i = 0; i < nfds && i < 4; i++)
+    {
+        last_poll_fds[i] = fds[i].fd;
+    }
+    if (poll_count == 1 && first_poll_errno == 0 && poll_readable_index < nfds)
+    {
+        fds[poll_readable_index].revents = NN_POLLIN;
+        poll_result = 1;
+    }
+    else
+    {
+        nn_errno_value = (poll_count == 1 && first_poll_errno != 0) ? first_poll_errno : ETERM;
+        poll_result = -1;
+    }
+MOCK_FUNCTION_END(poll_result)
+
+/* Thread mocks
+ */
+
+static THREAD_START_FUNC poller_thread;
+static void* poller_thread_arg;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD;
+    poller_thread = func;
+    poller_thread_arg = arg;
+    return THREADAPI_OK;
+}
+
+static bool run_thread_on_join;
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    (void)threadHandle;
+    int thread_result = run_thread_on_join ? poller_thread(poller_thread_arg) : 0;
+    if (res != NULL)
+    {
+        *res = thread_result;
+    }
+    return THREADAPI_OK;
+}
+
+/*the poller's thread runs while SocketPoller_Remove waits for it*/
+static int wait_count;
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    wait_count++;
+    (void)poller_thread(poller_thread_arg);
+    return COND_OK;
+}
+
+/* Callback
+ */
+
+static int readable_count;
+static void* readable_context;
+static int readable_socket;
+
+static void on_readable(void* context, int socket)
+{
+    readable_count++;
+    readable_context = context;
+    readable_socket = socket;
+}
+
+BEGIN_TEST_SUITE(socket_poller_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_CONDITION);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_destroy, real_VECTOR_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_push_back, real_VECTOR_push_back);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_push_back, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_erase, real_VECTOR_erase);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_front, real_VECTOR_front);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_find_if, real_VECTOR_find_if);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_size, real_VECTOR_size);
+
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(nn_socket, -1);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(nn_bind, -1);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(nn_connect, -1);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(struct nn_pollfd *, void*);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+    umock_c_deinit();
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    next_nn_socket = 0;
+    nn_errno_value = 0;
+    pending_wakes = 0;
+    poll_count = 0;
+    poll_readable_index = 0;
+    first_poll_errno = 0;
+    last_poll_nfds = 0;
+    last_poll_timeout = 0;
+    poller_thread = NULL;
+    poller_thread_arg = NULL;
+    run_thread_on_join = false;
+    wait_count = 0;
+    readable_count = 0;
+    readable_context = NULL;
+    readable_socket = -1;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+static SOCKET_POLLER_HANDLE create_poller_with_sockets(void)
+{
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+    ASSERT_IS_NOT_NULL(poller);
+    ASSERT_ARE_EQUAL(int, 0, SocketPoller_Add(poller, SOCKET_A, on_readable, CONTEXT_A));
+    ASSERT_ARE_EQUAL(int, 0, SocketPoller_Add(poller, SOCKET_B, on_readable, CONTEXT_B));
+    umock_c_reset_all_calls();
+    return poller;
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_001: [ SocketPoller_Create shall allocate the poller, a lock and a condition. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_003: [ SocketPoller_Create shall connect two pair sockets on an "inproc://" URI, so that a message on one ends the poll of the thread. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_004: [ SocketPoller_Create shall start the thread of the poller. ]*/
+TEST_FUNCTION(SocketPoller_Create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(nn_bind(WAKE_RECEIVER, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(nn_connect(WAKE_SENDER, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    ///act
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(poller);
+    ASSERT_IS_NOT_NULL(poller_thread);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)poller, poller_thread_arg);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_002: [ SocketPoller_Create shall return NULL if any step fails, freeing what it made. ]*/
+TEST_FUNCTION(SocketPoller_Create_fails_when_a_step_fails)
+{
+    ///arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
+    STRICT_EXPECTED_CALL(nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        ///act
+        SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+
+        ///assert
+        ASSERT_IS_NULL(poller);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_005: [ SocketPoller_Add shall return a non-zero value if poller or on_readable is NULL, or socket is negative. ]*/
+TEST_FUNCTION(SocketPoller_Add_with_invalid_args_fails)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+    ASSERT_IS_NOT_NULL(poller);
+    umock_c_reset_all_calls();
+
+    ///act
+    int r1 = SocketPoller_Add(NULL, SOCKET_A, on_readable, CONTEXT_A);
+    int r2 = SocketPoller_Add(poller, -1, on_readable, CONTEXT_A);
+    int r3 = SocketPoller_Add(poller, SOCKET_A, NULL, CONTEXT_A);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, r1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_007: [ SocketPoller_Add shall keep the socket, its callback and context, wake the thread so its next round polls the socket, and return zero. ]*/
+TEST_FUNCTION(SocketPoller_Add_success)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+    ASSERT_IS_NOT_NULL(poller);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(nn_send(WAKE_SENDER, IGNORED_PTR_ARG, 1, NN_DONTWAIT));
+
+    ///act
+    int result = SocketPoller_Add(poller, SOCKET_A, on_readable, CONTEXT_A);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_A);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_006: [ SocketPoller_Add shall return a non-zero value if it cannot make room for the socket. ]*/
+TEST_FUNCTION(SocketPoller_Add_fails_when_it_cannot_make_room)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+    ASSERT_IS_NOT_NULL(poller);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    int result = SocketPoller_Add(poller, SOCKET_A, on_readable, CONTEXT_A);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_008: [ Each round, the thread shall poll the wake socket and a copy of the sockets added, taken while it holds the lock, and signal SocketPoller_Remove that a round has started. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_009: [ The thread shall wait in nn_poll until a socket has a message to receive, and wait no longer than 1000 ms if it could not copy the sockets. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_010: [ The thread shall call the callback of each socket that has a message to receive, with its context and the socket. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_012: [ The thread shall end if nn_poll fails for any reason but being interrupted. ]*/
+TEST_FUNCTION(socket_poller_thread_calls_the_callback_of_a_readable_socket)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = create_poller_with_sockets();
+    poll_readable_index = 2;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_front(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 3, -1));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_front(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(nn_poll(IGNORED_PTR_ARG, 3, -1));
+    STRICT_EXPECTED_CALL(nn_errno());
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    int result = poller_thread(poller_thread_arg);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, WAKE_RECEIVER, last_poll_fds[0]);
+    ASSERT_ARE_EQUAL(int, SOCKET_A, last_poll_fds[1]);
+    ASSERT_ARE_EQUAL(int, SOCKET_B, last_poll_fds[2]);
+    ASSERT_ARE_EQUAL(int, 1, readable_count);
+    ASSERT_ARE_EQUAL(void_ptr, CONTEXT_B, readable_context);
+    ASSERT_ARE_EQUAL(int, SOCKET_B, readable_socket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_A);
+    SocketPoller_Remove(poller, SOCKET_B);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_008: [ Each round, the thread shall poll the wake socket and a copy of the sockets added, taken while it holds the lock, and signal SocketPoller_Remove that a round has started. ]*/
+TEST_FUNCTION(socket_poller_thread_drains_the_wake_socket)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = create_poller_with_sockets();
+    poll_readable_index = 0;
+    pending_wakes = 2;
+
+    ///act
+    (void)poller_thread(poller_thread_arg);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, pending_wakes);
+    ASSERT_ARE_EQUAL(int, 0, readable_count);
+    ASSERT_ARE_EQUAL(int, 2, poll_count);
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_A);
+    SocketPoller_Remove(poller, SOCKET_B);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_012: [ The thread shall end if nn_poll fails for any reason but being interrupted. ]*/
+TEST_FUNCTION(socket_poller_thread_polls_again_when_interrupted)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = create_poller_with_sockets();
+    first_poll_errno = EINTR;
+
+    ///act
+    (void)poller_thread(poller_thread_arg);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 2, poll_count);
+    ASSERT_ARE_EQUAL(int, 0, readable_count);
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_A);
+    SocketPoller_Remove(poller, SOCKET_B);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_016: [ SocketPoller_Remove shall do nothing if poller is NULL. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_013: [ SocketPoller_Destroy shall do nothing if poller is NULL. ]*/
+TEST_FUNCTION(SocketPoller_Remove_and_Destroy_with_NULL_do_nothing)
+{
+    ///act
+    SocketPoller_Remove(NULL, SOCKET_A);
+    SocketPoller_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_017: [ SocketPoller_Remove shall do nothing more if socket was not added. ]*/
+TEST_FUNCTION(SocketPoller_Remove_of_a_socket_not_added_does_not_wait)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = create_poller_with_sockets();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    SocketPoller_Remove(poller, SOCKET_B + 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_A);
+    SocketPoller_Remove(poller, SOCKET_B);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_018: [ SocketPoller_Remove shall forget the socket, wake the thread, and wait until the thread starts another round or has ended. ]*/
+TEST_FUNCTION(SocketPoller_Remove_waits_for_a_round_without_the_socket)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = create_poller_with_sockets();
+
+    ///act
+    SocketPoller_Remove(poller, SOCKET_A);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 1, wait_count);
+    ASSERT_ARE_NOT_EQUAL(int, 0, poll_count);
+    ASSERT_ARE_EQUAL(int, 2, last_poll_nfds);
+    ASSERT_ARE_EQUAL(int, SOCKET_B, last_poll_fds[1]);
+
+    ///cleanup
+    SocketPoller_Remove(poller, SOCKET_B);
+    SocketPoller_Destroy(poller);
+}
+
+/*Tests_SRS_SOCKET_POLLER_17_011: [ The thread shall end once SocketPoller_Destroy has been called. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_014: [ SocketPoller_Destroy shall tell the thread to end, wake it, and join it. ]*/
+/*Tests_SRS_SOCKET_POLLER_17_015: [ SocketPoller_Destroy shall close the wake sockets and free the poller, but not the sockets added to it. ]*/
+TEST_FUNCTION(SocketPoller_Destroy_ends_the_thread_and_frees_the_poller)
+{
+    ///arrange
+    SOCKET_POLLER_HANDLE poller = SocketPoller_Create();
+    ASSERT_IS_NOT_NULL(poller);
+    umock_c_reset_all_calls();
+    run_thread_on_join = true;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(nn_send(WAKE_SENDER, IGNORED_PTR_ARG, 1, NN_DONTWAIT));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(nn_close(WAKE_SENDER));
+    STRICT_EXPECTED_CALL(nn_close(WAKE_RECEIVER));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_free(poller));
+
+    ///act
+    SocketPoller_Destroy(poller);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, poll_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(socket_poller_ut)
@@ -16,6 +16,7 @@
 
 #include "module.h"
 #include "module_loader.h"
+#include "module_loaders/outprocess_module.h"
 #include "gateway_export.h"
 
 #ifdef __cplusplus
@@ -53,6 +54,28 @@ typedef struct OUTPROCESS_LOADER_ENTRYPOINT_TAG
     char ** process_argv;
     /** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+    /** @brief The most messages in a frame on the message channel; 0 sends one message at a time. */
+    unsigned int batch_max_messages;
+    /** @brief The most bytes in a frame on the message channel. */
+    unsigned int batch_max_bytes;
+    /** @brief The longest time, in milliseconds, a message waits for a frame to fill. */
+    unsigned int batch_linger_ms;
+    /** @brief The transport of the message channel. */
+    OUTPROCESS_MESSAGE_CHANNEL message_channel;
+    /** @brief The bytes in each ring of a shared memory message channel. */
+    unsigned int message_channel_size;
+    /** @brief The most messages sent to the module host before it grants more credit; 0 sends without credit. */
+    unsigned int credit_window;
+    /** @brief What happens to a message received while credit_window messages wait for the module host. */
+    BROKER_OVERFLOW_POLICY credit_overflow;
+    /** @brief Where the module waits for messages from the module host. */
+    OUTPROCESS_IO_THREADS io_threads;
+    /** @brief The module host processes sharing the work of the module; 1 for a single one. */
+    unsigned int replicas;
+    /** @brief How messages are spread among the replicas. */
+    OUTPROCESS_BALANCE balance;
+    /** @brief The message property hashed to pick a replica; NULL unless balance is OUTPROCESS_BALANCE_HASH. */
+    STRING_HANDLE balance_property;
 } OUTPROCESS_LOADER_ENTRYPOINT;
 
 /** @brief      The API for the out of process proxy module loader. */
@@ -11,6 +11,7 @@
 
 #include "module.h"
 #include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -23,6 +24,28 @@ extern "C"
 
 DEFINE_ENUM(OUTPROCESS_MODULE_LIFECYCLE, OUTPROCESS_MODULE_LIFECYCLE_VALUES);
 
+#define OUTPROCESS_MESSAGE_CHANNEL_VALUES \
+	OUTPROCESS_MESSAGE_CHANNEL_NANOMSG, \
+	OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY
+
+/** @brief The transport carrying messages between the gateway and the module host process. */
+DEFINE_ENUM(OUTPROCESS_MESSAGE_CHANNEL, OUTPROCESS_MESSAGE_CHANNEL_VALUES);
+
+#define OUTPROCESS_IO_THREADS_VALUES \
+	OUTPROCESS_IO_THREADS_MODULE, \
+	OUTPROCESS_IO_THREADS_SHARED
+
+/** @brief Whether the module receives on threads of its own, or on a thread shared by the proxy modules. */
+DEFINE_ENUM(OUTPROCESS_IO_THREADS, OUTPROCESS_IO_THREADS_VALUES);
+
+#define OUTPROCESS_BALANCE_VALUES \
+	OUTPROCESS_BALANCE_ROUND_ROBIN, \
+	OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, \
+	OUTPROCESS_BALANCE_HASH
+
+/** @brief How a replica pool chooses the replica that receives a message. */
+DEFINE_ENUM(OUTPROCESS_BALANCE, OUTPROCESS_BALANCE_VALUES);
+
 /** @brief Structure to configure an out of process proxy module */
 typedef struct OUTPROCESS_MODULE_CONFIG_DATA
 {
@@ -35,11 +58,47 @@ typedef struct OUTPROCESS_MODULE_CONFIG_DATA
     STRING_HANDLE outprocess_module_args;
 	/** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+	/** @brief The most messages in a frame on the message channel; 0 sends one message at a time. */
+	unsigned int batch_max_messages;
+	/** @brief The most bytes in a frame on the message channel. */
+	unsigned int batch_max_bytes;
+	/** @brief The longest time, in milliseconds, a message waits for a frame to fill. */
+	unsigned int batch_linger_ms;
+	/** @brief The transport of the message channel. */
+	OUTPROCESS_MESSAGE_CHANNEL message_channel;
+	/** @brief The bytes in each ring of a shared memory message channel. */
+	unsigned int message_channel_size;
+	/** @brief The most messages sent to the module host before it grants more credit; 0 sends without credit. */
+	unsigned int credit_window;
+	/** @brief What happens to a message received while credit_window messages wait for the module host. */
+	BROKER_OVERFLOW_POLICY credit_overflow;
+	/** @brief Where the module waits for messages from the module host. */
+	OUTPROCESS_IO_THREADS io_threads;
+	/** @brief The module host processes sharing the work of the module; 1 or less for a single one. */
+	unsigned int replicas;
+	/** @brief How messages are spread among the replicas. */
+	OUTPROCESS_BALANCE balance;
+	/** @brief The message property hashed to pick a replica when balance is OUTPROCESS_BALANCE_HASH. */
+	STRING_HANDLE balance_property;
+	/** @brief The module that messages from the module host are published as; NULL publishes them as this module. */
+	MODULE_HANDLE publish_source;
 } OUTPROCESS_MODULE_CONFIG;
 
 /** @brief the API fr this module */
 extern const MODULE_API_1 Outprocess_Module_API_all;
 
+/** @brief  The messages a module created by #Outprocess_Module_API_all has
+ *          queued for its module host but not sent yet, or 0 if module is
+ *          NULL.
+ */
+MOCKABLE_FUNCTION(, size_t, Outprocess_GetQueueDepth, MODULE_HANDLE, module);
+
+/** @brief  The messages a module created by #Outprocess_Module_API_all has
+ *          discarded because they could not be queued for its module host,
+ *          or 0 if module is NULL.
+ */
+MOCKABLE_FUNCTION(, size_t, Outprocess_GetDropCount, MODULE_HANDLE, module);
+
 #ifdef __cplusplus
 }
 #endif
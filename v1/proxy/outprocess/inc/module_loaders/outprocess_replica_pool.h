@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       outprocess_replica_pool.h
+ *  @brief      The proxy module for an out of process module running in
+ *              several module host processes.
+ *
+ *  @details    The pool creates an out of process proxy module for each
+ *              replica and hands every message it receives to one of them.
+ *              Messages from the replicas are published as the pool, so the
+ *              rest of the gateway sees a single module.
+ */
+#ifndef OUTPROCESS_REPLICA_POOL_H
+#define OUTPROCESS_REPLICA_POOL_H
+
+#include "module.h"
+#include "module_loaders/outprocess_module.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief  Builds the control id or URI of a replica from the one of the
+ *          module and the index of the replica, counting from 0.
+ */
+#define OUTPROCESS_REPLICA_ID_FORMAT "%s.%u"
+
+/** @brief the API for this module */
+extern const MODULE_API_1 Outprocess_Replica_Pool_API_all;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*OUTPROCESS_REPLICA_POOL_H*/
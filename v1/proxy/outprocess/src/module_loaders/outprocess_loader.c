@@ -5,6 +5,7 @@
 
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <uv.h>
 
 #include "azure_c_shared_utility/gballoc.h"
@@ -19,16 +20,20 @@
 #include "module.h"
 #include "module_loader.h"
 #include "module_loaders/outprocess_module.h"
+#include "module_loaders/outprocess_replica_pool.h"
 
 DEFINE_ENUM_STRINGS(OUTPROCESS_LOADER_ACTIVATION_TYPE, OUTPROCESS_LOADER_ACTIVATION_TYPE_VALUES);
 
 #define LOADER_GUID_SIZE 37
 #define IPC_URI_HEAD "ipc://"
 #define IPC_URI_HEAD_SIZE 6
+#define SHM_URI_HEAD "shm://"
 #define MESSAGE_URI_SIZE (INPROC_URI_HEAD_SIZE + LOADER_GUID_SIZE +1)
 
 #define GRACE_PERIOD_MS_DEFAULT 3000
 #define REMOTE_MESSAGE_WAIT_DEFAULT 1000
+#define BATCH_MAX_BYTES_DEFAULT 65536
+#define MESSAGE_CHANNEL_SIZE_DEFAULT (1024 * 1024)
 #define GRACE_AWAIT_DELAY_MS 100
 
 typedef struct OUTPROCESS_MODULE_HANDLE_DATA_TAG
@@ -47,14 +52,14 @@ void exit_cb(uv_process_t* p, int64_t exit_status, int term_signal)
     uv_close((uv_handle_t *) p, NULL);
 }
 
-int launch_child_process_from_entrypoint (OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry)
+static int launch_child_process (char ** process_argv)
 {
     int result;
     uv_process_t * child = NULL;
     const uv_process_options_t options = {
         .exit_cb = exit_cb,
-        .file = outprocess_entry->process_argv[0],
-        .args = outprocess_entry->process_argv,
+        .file = process_argv[0],
+        .args = process_argv,
         .flags = UV_PROCESS_WINDOWS_VERBATIM_ARGUMENTS
     };
 
@@ -105,6 +110,76 @@ int launch_child_process_from_entrypoint (OUTPROCESS_LOADER_ENTRYPOINT * outproc
     return result;
 }
 
+int launch_child_process_from_entrypoint (OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry)
+{
+    return launch_child_process(outprocess_entry->process_argv);
+}
+
+int launch_replica_processes (OUTPROCESS_LOADER_ENTRYPOINT * outprocess_entry)
+{
+    int result;
+    const char * control_id = STRING_c_str(outprocess_entry->control_id);
+    bool control_id_found = false;
+    char ** replica_argv;
+
+    for (size_t i = 1; i < outprocess_entry->process_argc; ++i)
+    {
+        if (0 == strcmp(outprocess_entry->process_argv[i], control_id))
+        {
+            control_id_found = true;
+        }
+    }
+
+    if (!control_id_found)
+    {
+        /* Codes_SRS_OUTPROCESS_LOADER_17_062: [ If no launch argument is the control id, then `launch_replica_processes` shall return a non-zero value, since the replicas could not be told apart. ] */
+        LogError("Unable to launch replicas, no launch argument is the control id \"%s\"", control_id);
+        result = __LINE__;
+    }
+    /* Codes_SRS_OUTPROCESS_LOADER_17_063: [ `launch_replica_processes` shall allocate an argument array as long as the one of the entrypoint. ] */
+    else if (NULL == (replica_argv = (char **)malloc(sizeof(char *) * (outprocess_entry->process_argc + 1))))
+    {
+        /* Codes_SRS_OUTPROCESS_LOADER_17_066: [ If any call fails, then `launch_replica_processes` shall stop launching replicas and return a non-zero value. ] */
+        LogError("Unable to allocate replica argument array.");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+        for (unsigned int replica = 0; replica < outprocess_entry->replicas; ++replica)
+        {
+            STRING_HANDLE replica_control_id = STRING_construct_sprintf(OUTPROCESS_REPLICA_ID_FORMAT, control_id, replica);
+            if (NULL == replica_control_id)
+            {
+                /* Codes_SRS_OUTPROCESS_LOADER_17_066: [ If any call fails, then `launch_replica_processes` shall stop launching replicas and return a non-zero value. ] */
+                LogError("Unable to build the control id of replica %u.", replica);
+                result = __LINE__;
+                break;
+            }
+
+            /* Codes_SRS_OUTPROCESS_LOADER_17_064: [ For each replica, `launch_replica_processes` shall pass the launch arguments with each one equal to the control id replaced by the control id of the replica, "<control.id>.<index>". ] */
+            for (size_t i = 0; i <= outprocess_entry->process_argc; ++i)
+            {
+                char * arg = outprocess_entry->process_argv[i];
+                replica_argv[i] = (i != 0 && NULL != arg && 0 == strcmp(arg, control_id)) ? (char *)STRING_c_str(replica_control_id) : arg;
+            }
+
+            /* Codes_SRS_OUTPROCESS_LOADER_17_065: [ `launch_replica_processes` shall launch each replica like `launch_child_process_from_entrypoint`. ] */
+            result = launch_child_process(replica_argv);
+            STRING_delete(replica_control_id);
+            if (0 != result)
+            {
+                /* Codes_SRS_OUTPROCESS_LOADER_17_066: [ If any call fails, then `launch_replica_processes` shall stop launching replicas and return a non-zero value. ] */
+                LogError("Unable to launch replica %u.", replica);
+                break;
+            }
+        }
+        free(replica_argv);
+    }
+
+    return result;
+}
+
 int spawn_child_processes (void * context)
 {
     (void)context;
@@ -377,7 +452,9 @@ static MODULE_LIBRARY_HANDLE OutprocessModuleLoader_Load(const MODULE_LOADER* lo
         LogError("Invalid arguments activation type");
     }
     /*Codes_SRS_OUTPROCESS_LOADER_27_005: [ Launch - `OutprocessModuleLoader_Load` shall launch the child process identified by the entrypoint. ]*/
-    else if ((OUTPROCESS_LOADER_ACTIVATION_LAUNCH == outprocess_entry->activation_type) && launch_child_process_from_entrypoint(outprocess_entry))
+    /*Codes_SRS_OUTPROCESS_LOADER_17_060: [ Launch - If the entrypoint has more than one replica, `OutprocessModuleLoader_Load` shall launch a child process for each replica. ]*/
+    else if ((OUTPROCESS_LOADER_ACTIVATION_LAUNCH == outprocess_entry->activation_type) &&
+            ((outprocess_entry->replicas > 1) ? launch_replica_processes(outprocess_entry) : launch_child_process_from_entrypoint(outprocess_entry)))
     {
         /*Codes_SRS_OUTPROCESS_LOADER_17_008: [ If any call in this function fails, this function shall return NULL. ] */
         result = NULL;
@@ -411,8 +488,11 @@ static MODULE_LIBRARY_HANDLE OutprocessModuleLoader_Load(const MODULE_LOADER* lo
     else
     {
         /*Codes_SRS_OUTPROCESS_LOADER_17_006: [ The loader shall store the Outprocess_Module_API_all in the loader handle. ] */
+        /*Codes_SRS_OUTPROCESS_LOADER_17_061: [ If the entrypoint has more than one replica, the loader shall store the Outprocess_Replica_Pool_API_all in the loader handle instead. ] */
         /*Codes_SRS_OUTPROCESS_LOADER_17_007: [ Upon success, this function shall return a valid pointer to the loader handle. ] */
-        result->api = (const MODULE_API*)&Outprocess_Module_API_all;
+        result->api = (outprocess_entry->replicas > 1) ?
+            (const MODULE_API*)&Outprocess_Replica_Pool_API_all :
+            (const MODULE_API*)&Outprocess_Module_API_all;
     }
 
     return result;
@@ -567,6 +647,116 @@ static void* OutprocessModuleLoader_ParseEntrypointFromJson(const struct MODULE_
                     config->remote_message_wait = (unsigned int)timeout;
                 }
 
+                /*Codes_SRS_OUTPROCESS_LOADER_17_045: [ This function shall read the "batch.max.messages", "batch.max.bytes" and "batch.linger.ms" values. ]*/
+                /*Codes_SRS_OUTPROCESS_LOADER_17_046: [ If "batch.max.messages" is not set, batch_max_messages, batch_max_bytes and batch_linger_ms shall be 0, so messages are sent one at a time. ]*/
+                /*Codes_SRS_OUTPROCESS_LOADER_17_047: [ If "batch.max.messages" is set but "batch.max.bytes" is not, batch_max_bytes shall be set to a default of 65536. ]*/
+                double batch_max_messages = json_object_get_number(entrypoint, "batch.max.messages");
+                double batch_max_bytes = json_object_get_number(entrypoint, "batch.max.bytes");
+                double batch_linger_ms = json_object_get_number(entrypoint, "batch.linger.ms");
+                if (batch_max_messages < 1)
+                {
+                    config->batch_max_messages = 0;
+                    config->batch_max_bytes = 0;
+                    config->batch_linger_ms = 0;
+                }
+                else
+                {
+                    config->batch_max_messages = (unsigned int)batch_max_messages;
+                    config->batch_max_bytes = (batch_max_bytes < 1) ? BATCH_MAX_BYTES_DEFAULT : (unsigned int)batch_max_bytes;
+                    config->batch_linger_ms = (batch_linger_ms < 0) ? 0 : (unsigned int)batch_linger_ms;
+                }
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_048: [ This function shall read the "message.channel" and "message.channel.size" values. ]*/
+                /*Codes_SRS_OUTPROCESS_LOADER_17_049: [ If "message.channel" is "shared_memory", message_channel shall be OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, else OUTPROCESS_MESSAGE_CHANNEL_NANOMSG. ]*/
+                /*Codes_SRS_OUTPROCESS_LOADER_17_050: [ If "message.channel.size" is not set, message_channel_size shall be set to a default of 1048576. ]*/
+                const char* message_channel = json_object_get_string(entrypoint, "message.channel");
+                double message_channel_size = json_object_get_number(entrypoint, "message.channel.size");
+                if (message_channel != NULL && strcmp(message_channel, "shared_memory") == 0)
+                {
+                    config->message_channel = OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY;
+                }
+                else
+                {
+                    if (message_channel != NULL && strcmp(message_channel, "nanomsg") != 0)
+                    {
+                        LogInfo("unknown message.channel \"%s\", using nanomsg", message_channel);
+                    }
+                    config->message_channel = OUTPROCESS_MESSAGE_CHANNEL_NANOMSG;
+                }
+                config->message_channel_size = (message_channel_size < 1) ? MESSAGE_CHANNEL_SIZE_DEFAULT : (unsigned int)message_channel_size;
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_052: [ This function shall read the "credit.window" value, and set credit_window to 0 if it is not set, so messages are sent without credit. ]*/
+                double credit_window = json_object_get_number(entrypoint, "credit.window");
+                config->credit_window = (credit_window < 1) ? 0 : (unsigned int)credit_window;
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_067: [ This function shall read the "credit.overflow" value; if it is "drop_oldest", credit_overflow shall be BROKER_OVERFLOW_DROP_OLDEST, if it is "block", BROKER_OVERFLOW_BLOCK, else BROKER_OVERFLOW_DROP_NEWEST. ]*/
+                const char* credit_overflow = json_object_get_string(entrypoint, "credit.overflow");
+                if (credit_overflow != NULL && strcmp(credit_overflow, "drop_oldest") == 0)
+                {
+                    config->credit_overflow = BROKER_OVERFLOW_DROP_OLDEST;
+                }
+                else if (credit_overflow != NULL && strcmp(credit_overflow, "block") == 0)
+                {
+                    config->credit_overflow = BROKER_OVERFLOW_BLOCK;
+                }
+                else
+                {
+                    if (credit_overflow != NULL && strcmp(credit_overflow, "drop_newest") != 0)
+                    {
+                        LogInfo("unknown credit.overflow \"%s\", using drop_newest", credit_overflow);
+                    }
+                    config->credit_overflow = BROKER_OVERFLOW_DROP_NEWEST;
+                }
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_054: [ This function shall read the "io.threads" value; if it is "shared", io_threads shall be OUTPROCESS_IO_THREADS_SHARED, else OUTPROCESS_IO_THREADS_MODULE. ]*/
+                const char* io_threads = json_object_get_string(entrypoint, "io.threads");
+                if (io_threads != NULL && strcmp(io_threads, "shared") == 0)
+                {
+                    config->io_threads = OUTPROCESS_IO_THREADS_SHARED;
+                }
+                else
+                {
+                    if (io_threads != NULL && strcmp(io_threads, "module") != 0)
+                    {
+                        LogInfo("unknown io.threads \"%s\", using threads of the module", io_threads);
+                    }
+                    config->io_threads = OUTPROCESS_IO_THREADS_MODULE;
+                }
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_056: [ This function shall read the "replicas" value, and set replicas to 1 if it is not set. ]*/
+                double replicas = json_object_get_number(entrypoint, "replicas");
+                config->replicas = (replicas < 1) ? 1 : (unsigned int)replicas;
+
+                /*Codes_SRS_OUTPROCESS_LOADER_17_057: [ This function shall read the "balance" value; if it is "least_queue_depth", balance shall be OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, if it is "hash", OUTPROCESS_BALANCE_HASH, else OUTPROCESS_BALANCE_ROUND_ROBIN. ]*/
+                /*Codes_SRS_OUTPROCESS_LOADER_17_058: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall assign balance_property to the string value of "balance.property", and set balance to OUTPROCESS_BALANCE_ROUND_ROBIN if it is not present; balance_property shall be NULL otherwise. ]*/
+                const char* balance = json_object_get_string(entrypoint, "balance");
+                config->balance_property = NULL;
+                if (balance != NULL && strcmp(balance, "least_queue_depth") == 0)
+                {
+                    config->balance = OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH;
+                }
+                else if (balance != NULL && strcmp(balance, "hash") == 0)
+                {
+                    const char* balance_property = json_object_get_string(entrypoint, "balance.property");
+                    if (balance_property == NULL || (config->balance_property = STRING_construct(balance_property)) == NULL)
+                    {
+                        LogError("hash balancing without a \"balance.property\", using round_robin");
+                        config->balance = OUTPROCESS_BALANCE_ROUND_ROBIN;
+                    }
+                    else
+                    {
+                        config->balance = OUTPROCESS_BALANCE_HASH;
+                    }
+                }
+                else
+                {
+                    if (balance != NULL && strcmp(balance, "round_robin") != 0)
+                    {
+                        LogInfo("unknown balance \"%s\", using round_robin", balance);
+                    }
+                    config->balance = OUTPROCESS_BALANCE_ROUND_ROBIN;
+                }
+
                 /*Codes_SRS_OUTPROCESS_LOADER_17_017: [ This function shall assign the entrypoint activation_type to the decoded value. ] */
                 config->activation_type = activationType;
 
@@ -591,6 +781,8 @@ static void OutprocessModuleLoader_FreeEntrypoint(const struct MODULE_LOADER_TAG
         OUTPROCESS_LOADER_ENTRYPOINT* ep = (OUTPROCESS_LOADER_ENTRYPOINT*)entrypoint;
         if (ep->message_id != NULL)
             STRING_delete(ep->message_id); 
+        if (ep->balance_property != NULL)
+            STRING_delete(ep->balance_property);
         STRING_delete(ep->control_id);
         if (ep->process_argv) {
             for (size_t i = 0; i < ep->process_argc; ++i) {
@@ -648,6 +840,9 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
         OUTPROCESS_LOADER_ENTRYPOINT* ep = (OUTPROCESS_LOADER_ENTRYPOINT*)entrypoint;
         char uuid[LOADER_GUID_SIZE];
         UNIQUEID_RESULT uuid_result = UNIQUEID_OK;
+        /*Codes_SRS_OUTPROCESS_LOADER_17_051: [ If message_channel is OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY, the message uri shall start with "shm://" instead of "ipc://". ]*/
+        const char* message_uri_head = (ep->message_channel == OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY) ? SHM_URI_HEAD : IPC_URI_HEAD;
+        fullModuleConfiguration->balance_property = NULL;
 
         if (ep->message_id == NULL)
         {
@@ -663,13 +858,13 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
             else
             {
                 /*Codes_SRS_OUTPROCESS_LOADER_17_032: [ The message uri shall be composed of "ipc://" + unique id . ]*/
-                fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", IPC_URI_HEAD, uuid);
+                fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", message_uri_head, uuid);
             }
         }
         else
         {
             /*Codes_SRS_OUTPROCESS_LOADER_17_033: [ This function shall allocate and copy each string in OUTPROCESS_LOADER_ENTRYPOINT and assign them to the corresponding fields in OUTPROCESS_MODULE_CONFIG. ]*/
-            fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", IPC_URI_HEAD, STRING_c_str(ep->message_id));
+            fullModuleConfiguration->message_uri = STRING_construct_sprintf("%s%s", message_uri_head, STRING_c_str(ep->message_id));
         }
 
         if (fullModuleConfiguration->message_uri == NULL)
@@ -700,10 +895,36 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
             free(fullModuleConfiguration);
             fullModuleConfiguration = NULL;
         }
+        /*Codes_SRS_OUTPROCESS_LOADER_17_059: [ The module configuration shall take replicas and balance from the entrypoint, and a copy of its balance_property if there is one. ]*/
+        else if ((ep->balance_property != NULL) && (NULL == (fullModuleConfiguration->balance_property = STRING_clone(ep->balance_property))))
+        {
+            /*Codes_SRS_OUTPROCESS_LOADER_17_036: [ If any call fails, this function shall return NULL. ]*/
+            LogError("unable to allocate a balance property string");
+            STRING_delete(fullModuleConfiguration->message_uri);
+            STRING_delete(fullModuleConfiguration->control_uri);
+            STRING_delete(fullModuleConfiguration->outprocess_module_args);
+            free(fullModuleConfiguration);
+            fullModuleConfiguration = NULL;
+        }
         else
         {
             /*Codes_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
             fullModuleConfiguration->remote_message_wait = ep->remote_message_wait;
+            fullModuleConfiguration->batch_max_messages = ep->batch_max_messages;
+            fullModuleConfiguration->batch_max_bytes = ep->batch_max_bytes;
+            fullModuleConfiguration->batch_linger_ms = ep->batch_linger_ms;
+            fullModuleConfiguration->message_channel = ep->message_channel;
+            fullModuleConfiguration->message_channel_size = ep->message_channel_size;
+            /*Codes_SRS_OUTPROCESS_LOADER_17_053: [ The module configuration shall take credit_window from the entrypoint. ]*/
+            fullModuleConfiguration->credit_window = ep->credit_window;
+            /*Codes_SRS_OUTPROCESS_LOADER_17_068: [ The module configuration shall take credit_overflow from the entrypoint. ]*/
+            fullModuleConfiguration->credit_overflow = ep->credit_overflow;
+            /*Codes_SRS_OUTPROCESS_LOADER_17_055: [ The module configuration shall take io_threads from the entrypoint. ]*/
+            fullModuleConfiguration->io_threads = ep->io_threads;
+            /*Codes_SRS_OUTPROCESS_LOADER_17_059: [ The module configuration shall take replicas and balance from the entrypoint, and a copy of its balance_property if there is one. ]*/
+            fullModuleConfiguration->replicas = ep->replicas;
+            fullModuleConfiguration->balance = ep->balance;
+            fullModuleConfiguration->publish_source = NULL;
             fullModuleConfiguration->lifecycle_model = OUTPROCESS_LIFECYCLE_SYNC;
         }
     }
@@ -721,6 +942,10 @@ static void OutprocessModuleLoader_FreeModuleConfiguration(const struct MODULE_L
         STRING_delete(config->control_uri);
         STRING_delete(config->message_uri);
         STRING_delete(config->outprocess_module_args);
+        if (config->balance_property != NULL)
+        {
+            STRING_delete(config->balance_property);
+        }
         free(config);
     }
 }
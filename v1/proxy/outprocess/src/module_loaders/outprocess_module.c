@@ -11,12 +11,18 @@
 #include "message.h"
 #include "message_queue.h"
 #include "control_message.h"
+#include "message_batch.h"
+#include "shared_memory_channel.h"
+#include "socket_poller.h"
+#include "gateway_atomic.h"
 #include "module_loaders/outprocess_module.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 typedef struct THREAD_CONTROL_TAG
 {
@@ -27,10 +33,18 @@ typedef struct THREAD_CONTROL_TAG
 
 #define THREAD_FLAG_STOP 1
 
+/*longest time the control thread waits for a control message before it checks whether it should stop*/
+#define CONTROL_POLL_TIMEOUT_MS 1000
+
+/*longest time the incoming message thread waits on a shared memory channel before it checks whether it should stop*/
+#define MESSAGE_POLL_TIMEOUT_MS 1000
+
 typedef struct OUTPROCESS_HANDLE_DATA_TAG
 {
 	LOCK_HANDLE handle_lock;
 	int message_socket;
+	/*the message channel when it is shared memory rather than message_socket*/
+	SHARED_MEMORY_CHANNEL_HANDLE message_channel;
 	int control_socket;
 	MESSAGE_QUEUE_HANDLE outgoing_messages;
 	STRING_HANDLE control_uri;
@@ -38,7 +52,46 @@ typedef struct OUTPROCESS_HANDLE_DATA_TAG
 	STRING_HANDLE module_args;
 	OUTPROCESS_MODULE_LIFECYCLE lifecyle_model;
 	BROKER_HANDLE broker;
+	/*the module messages from the module host are published as; this module unless it is a replica in a pool*/
+	MODULE_HANDLE publish_source;
 	unsigned int remote_message_wait;
+	/*frame limits offered to the module host; they do not change once the module is created*/
+	MESSAGE_BATCH_LIMITS batch_offer;
+	/*frame limits the module host accepted; all zero while messages are sent one at a time*/
+	MESSAGE_BATCH_LIMITS batch_limits;
+	/*credit window offered to the module host; 0 when messages are sent without credit*/
+	uint32_t credit_offer;
+	/*credit window the module host accepted; 0 while messages are sent without credit*/
+	uint32_t credit_window;
+	/*messages that may be sent before the module host grants more credit*/
+	uint32_t send_credits;
+	/*the gateway message version messages are sent in; GATEWAY_MESSAGE_VERSION_1 until the module host replies with a higher one it reads*/
+	GATEWAY_ATOMIC_U32 message_version;
+	/*messages published since credit was last granted to the module host; only used by the incoming message thread*/
+	uint32_t received_since_grant;
+	/*posted when credit arrives or flow control ends; only created when a credit window is offered*/
+	COND_HANDLE credit_available;
+	/*what Outprocess_Receive does with a message when the queue holds the credit window*/
+	BROKER_OVERFLOW_POLICY overflow;
+	/*posted when a message leaves a full queue or the module is destroyed; only created for BROKER_OVERFLOW_BLOCK with a credit window*/
+	COND_HANDLE room_available;
+	/*threads waiting in Outprocess_Receive for room_available*/
+	size_t room_waiters;
+	/*set once Outprocess_Receive must not wait for room any more*/
+	int receive_closed;
+	/*messages Outprocess_Receive discarded*/
+	GATEWAY_ATOMIC_U32 dropped;
+	/*whether the module receives on threads of its own or on the shared socket poller*/
+	OUTPROCESS_IO_THREADS io_threads;
+	/*set once the sockets of the module have been added to the shared socket poller*/
+	int polled;
+	/*set while a thread reattaches the module host, which then takes the control messages the control channel callback receives; the control thread slot holds that thread*/
+	int attaching;
+	/*the control message handed to the thread reattaching the module host, and its size; NULL once taken*/
+	unsigned char* control_reply;
+	int control_reply_size;
+	/*posted when a control message is handed over; created when the module host is first reattached*/
+	COND_HANDLE control_reply_received;
 
 	THREAD_CONTROL message_receive_thread;
 	THREAD_CONTROL message_send_thread;
@@ -49,6 +102,15 @@ typedef struct OUTPROCESS_HANDLE_DATA_TAG
 // forward definitions
 static void* construct_create_message(OUTPROCESS_HANDLE_DATA* handleData, int32_t * creationMessageSize);
 static void send_start_message(OUTPROCESS_HANDLE_DATA* handleData);
+static void* serialize_control_message(CONTROL_MESSAGE * msg, int32_t * theMessageSize);
+static int outprocessCreate(void *param);
+static int wait_for_control_reply(OUTPROCESS_HANDLE_DATA * handleData, int timeout_ms, unsigned char ** buf);
+
+/*the socket poller shared by the proxy modules that share I/O threads, and how many of them use it;
+only used by Outprocess_Start and Outprocess_Destroy, which may run for several modules at once, while holding shared_poller_busy*/
+static SOCKET_POLLER_HANDLE shared_poller = NULL;
+static size_t shared_poller_users = 0;
+static GATEWAY_ATOMIC_U32 shared_poller_busy = 0;
 
 static int nn_really_close(int s)
 {
@@ -70,6 +132,235 @@ static int nn_really_send(int s, const void* buf, size_t len, int flags)
     return result;
 }
 
+/*releases a receive buffer handed over to a message*/
+static void nn_release_message_buffer(void* buf)
+{
+    (void)nn_freemsg(buf);
+}
+
+/*publishes one message unpacked from a frame received from the module host*/
+static void publish_framed_message(void* context, const unsigned char* source, int32_t size)
+{
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)context;
+	/*Codes_SRS_OUTPROCESS_MODULE_17_066: [ If frames were accepted and the received buffer is a frame, this function shall create each message of the frame with Message_CreateFromByteArray, publish it to the broker, and free the buffer. ]*/
+	MESSAGE_HANDLE msg = Message_CreateFromByteArray(source, size);
+	if (msg == NULL)
+	{
+		LogError("unable to create a message from a received frame");
+	}
+	else
+	{
+		Broker_Publish(handleData->broker, handleData->publish_source, msg);
+		Message_Destroy(msg);
+	}
+	handleData->received_since_grant++;
+}
+
+/*returns the frame limits the module host accepted, all zero if it did not*/
+static MESSAGE_BATCH_LIMITS get_batch_limits(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	MESSAGE_BATCH_LIMITS result = { 0, 0, 0 };
+	/*no lock is needed when frames were never offered, since then none are ever accepted*/
+	if (handleData->batch_offer.max_messages != 0)
+	{
+		if (Lock(handleData->handle_lock) != LOCK_OK)
+		{
+			LogError("unable to Lock handle data, sending messages one at a time");
+		}
+		else
+		{
+			result = handleData->batch_limits;
+			(void)Unlock(handleData->handle_lock);
+		}
+	}
+	return result;
+}
+
+/*takes the credit to send one message, waiting for the module host to grant more if wait is set; returns zero if the message may be sent*/
+static int take_send_credit(OUTPROCESS_HANDLE_DATA * handleData, int wait)
+{
+	int result;
+	/*no lock is needed when credit was never offered, since then no window is ever accepted*/
+	if (handleData->credit_offer == 0)
+	{
+		result = 0;
+	}
+	else if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data, sending without credit");
+		result = 0;
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_077: [ If the module host accepted a credit window, this function shall take a credit for each message it sends, waiting for the module host to grant more when none is left. ]*/
+		while (wait && handleData->credit_window != 0 && handleData->send_credits == 0)
+		{
+			(void)Condition_Wait(handleData->credit_available, handleData->handle_lock, 0);
+		}
+		if (handleData->credit_window == 0)
+		{
+			result = 0;
+		}
+		else if (handleData->send_credits != 0)
+		{
+			handleData->send_credits--;
+			result = 0;
+		}
+		else
+		{
+			result = __LINE__;
+		}
+		(void)Unlock(handleData->handle_lock);
+	}
+	return result;
+}
+
+/*returns credits granted by the module host, or taken for a message that was not sent, never holding more than the window*/
+static void add_send_credits(OUTPROCESS_HANDLE_DATA * handleData, uint32_t credits)
+{
+	if (handleData->credit_offer != 0)
+	{
+		if (Lock(handleData->handle_lock) != LOCK_OK)
+		{
+			LogError("unable to Lock handle data, dropping %u credits", (unsigned int)credits);
+		}
+		else
+		{
+			if (handleData->credit_window != 0)
+			{
+				uint32_t room = handleData->credit_window - handleData->send_credits;
+				handleData->send_credits += (credits < room) ? credits : room;
+			}
+			(void)Condition_Post(handleData->credit_available);
+			(void)Unlock(handleData->handle_lock);
+		}
+	}
+}
+
+/*wakes a thread waiting in Outprocess_Receive for room, after a message was removed from the queue*/
+static void post_queue_room(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	/*no lock is needed without the condition, since then nothing ever waits for room*/
+	if (handleData->room_available != NULL)
+	{
+		if (Lock(handleData->handle_lock) != LOCK_OK)
+		{
+			LogError("unable to Lock handle data, a receiving thread may wait for room");
+		}
+		else
+		{
+			if (handleData->room_waiters != 0)
+			{
+				(void)Condition_Post(handleData->room_available);
+			}
+			(void)Unlock(handleData->handle_lock);
+		}
+	}
+}
+
+/*grants the module host credit for the messages published since the last grant, once they fill half the window*/
+static void grant_received_credits(OUTPROCESS_HANDLE_DATA * handleData, int control_fd, uint32_t credit_window)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_079: [ If the module host accepted a credit window, this function shall send a Credit Message on the control channel for the messages it published, once they reach half the window. ]*/
+	if (credit_window != 0 && handleData->received_since_grant >= (credit_window + 1) / 2)
+	{
+		CONTROL_MESSAGE_MODULE_CREDIT credit_msg =
+		{
+			{
+				CONTROL_MESSAGE_VERSION_CURRENT,	/*version*/
+				CONTROL_MESSAGE_TYPE_MODULE_CREDIT	/*type*/
+			},
+			handleData->received_since_grant		/*credits*/
+		};
+		int32_t credit_size = 0;
+		void * credit_message = serialize_control_message((CONTROL_MESSAGE *)&credit_msg, &credit_size);
+		if (credit_message != NULL)
+		{
+			/*the credit is granted again with the next message if the control channel is busy*/
+			if (nn_really_send(control_fd, &credit_message, NN_MSG, NN_DONTWAIT) != credit_size)
+			{
+				nn_freemsg(credit_message);
+			}
+			else
+			{
+				handleData->received_since_grant = 0;
+			}
+		}
+	}
+}
+
+/*receives and publishes one buffer from a shared memory message channel*/
+static void receive_shared_memory_message(OUTPROCESS_HANDLE_DATA * handleData, SHARED_MEMORY_CHANNEL_HANDLE channel, int frames_accepted, int * should_continue)
+{
+	const unsigned char* buf;
+	int32_t nbytes;
+	/*Codes_SRS_OUTPROCESS_MODULE_17_072: [ With a shared memory message channel, this function shall receive from it with SharedMemoryChannel_Receive, waiting no longer than 1000 ms before it checks whether it should stop, and shall end once the channel is closed. ]*/
+	SHARED_MEMORY_CHANNEL_RESULT receive_result = SharedMemoryChannel_Receive(channel, &buf, &nbytes, MESSAGE_POLL_TIMEOUT_MS);
+	if (receive_result == SHARED_MEMORY_CHANNEL_OK)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_073: [ A buffer received on a shared memory message channel shall be copied into messages with Message_CreateFromByteArray, or unpacked if it is an accepted frame, then given back with SharedMemoryChannel_Release. ]*/
+		if (frames_accepted && MessageBatch_IsFrame(buf, nbytes))
+		{
+			if (MessageBatch_ForEachMessage(buf, nbytes, publish_framed_message, handleData) != 0)
+			{
+				LogError("received a malformed frame of %d bytes", (int)nbytes);
+			}
+		}
+		else
+		{
+			MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf, nbytes);
+			if (msg == NULL)
+			{
+				LogError("unable to create a message from a received buffer of %d bytes", (int)nbytes);
+			}
+			else
+			{
+				/*Codes_SRS_OUTPROCESS_MODULE_17_040: [ This function shall publish any successfully created gateway message to the broker. ]*/
+				Broker_Publish(handleData->broker, handleData->publish_source, msg);
+				Message_Destroy(msg);
+			}
+			handleData->received_since_grant++;
+		}
+		SharedMemoryChannel_Release(channel);
+	}
+	else if (receive_result != SHARED_MEMORY_CHANNEL_TIMEOUT)
+	{
+		*should_continue = 0;
+	}
+}
+
+/*publishes the message, or the messages of the frame, in a buffer received on the message socket, and frees the buffer*/
+static void publish_received_buffer(OUTPROCESS_HANDLE_DATA * handleData, unsigned char * buf, int nbytes, int frames_accepted)
+{
+	if (frames_accepted && MessageBatch_IsFrame((const unsigned char*)buf, nbytes))
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_066: [ If frames were accepted and the received buffer is a frame, this function shall create each message of the frame with Message_CreateFromByteArray, publish it to the broker, and free the buffer. ]*/
+		if (MessageBatch_ForEachMessage((const unsigned char*)buf, nbytes, publish_framed_message, handleData) != 0)
+		{
+			LogError("received a malformed frame of %d bytes", nbytes);
+		}
+		nn_freemsg(buf);
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_061: [ This function shall create the message on the received buffer with Message_CreateFromOwnedByteArray, handing the buffer over to the message, and shall free the buffer itself only if that fails. ]*/
+		const unsigned char*buf_bytes = (const unsigned char*)buf;
+		MESSAGE_HANDLE msg = Message_CreateFromOwnedByteArray(buf_bytes, nbytes, nn_release_message_buffer, buf);
+		if (msg == NULL)
+		{
+			nn_freemsg(buf);
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_040: [ This function shall publish any successfully created gateway message to the broker. ]*/
+			Broker_Publish(handleData->broker, handleData->publish_source, msg);
+			Message_Destroy(msg);
+		}
+		handleData->received_since_grant++;
+	}
+}
+
 int outprocessIncomingMessageThread(void *param)
 {
 	/*Codes_SRS_OUTPROCESS_MODULE_17_037: [ This function shall receive the module handle data as the thread parameter. ]*/
@@ -92,6 +383,10 @@ int outprocessIncomingMessageThread(void *param)
 				break;
 			}
 			int nn_fd = handleData->message_socket;
+			SHARED_MEMORY_CHANNEL_HANDLE channel = handleData->message_channel;
+			int frames_accepted = (handleData->batch_limits.max_messages != 0);
+			int control_fd = handleData->control_socket;
+			uint32_t credit_window = handleData->credit_window;
 			if (Unlock(handleData->handle_lock) != LOCK_OK)
 			{
 				should_continue = 0;
@@ -117,6 +412,13 @@ int outprocessIncomingMessageThread(void *param)
 				break;
 			}
 
+			if (channel != NULL)
+			{
+				receive_shared_memory_message(handleData, channel, frames_accepted, &should_continue);
+				grant_received_credits(handleData, control_fd, credit_window);
+				continue;
+			}
+
 			int nbytes;
 			unsigned char *buf = NULL;
 			errno = 0;
@@ -130,23 +432,213 @@ int outprocessIncomingMessageThread(void *param)
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
-				const unsigned char*buf_bytes = (const unsigned char*)buf;
-				MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes);
-				if (msg != NULL)
-				{
-					/*Codes_SRS_OUTPROCESS_MODULE_17_040: [ This function shall publish any successfully created gateway message to the broker. ]*/
-					Broker_Publish(handleData->broker, (MODULE_HANDLE)handleData, msg);
-					Message_Destroy(msg);
-				}
-				nn_freemsg(buf);
+				publish_received_buffer(handleData, buf, nbytes, frames_accepted);
 			}
-			ThreadAPI_Sleep(1);
+			grant_received_credits(handleData, control_fd, credit_window);
 		}
 	}
 	return 0;
 }
 
+/*sends a message in a version older than the current one, serialized straight into a nanomsg buffer*/
+static void send_versioned_message(OUTPROCESS_HANDLE_DATA * handleData, MESSAGE_HANDLE messageHandle, uint8_t message_version)
+{
+	int32_t msg_size = Message_ToByteArrayVersion(messageHandle, message_version, NULL, 0);
+	if (msg_size < 0)
+	{
+		LogError("unable to serialize outgoing message [%p] in version %u", messageHandle, (unsigned int)message_version);
+	}
+	else
+	{
+		void* result = nn_allocmsg(msg_size, 0);
+		if (result == NULL)
+		{
+			LogError("unable to allocate buffer for outgoing message [%p]", messageHandle);
+		}
+		else if (Message_ToByteArrayVersion(messageHandle, message_version, (unsigned char*)result, msg_size) != msg_size)
+		{
+			LogError("unable to serialize outgoing message [%p] in version %u", messageHandle, (unsigned int)message_version);
+			nn_freemsg(result);
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
+			int nbytes = nn_really_send(handleData->message_socket, &result, NN_MSG, 0);
+			if (nbytes != msg_size)
+			{
+				LogError("unable to send buffer to remote for message [%p]", messageHandle);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+				nn_freemsg(result);
+			}
+		}
+	}
+}
+
+static void send_single_message(OUTPROCESS_HANDLE_DATA * handleData, MESSAGE_HANDLE messageHandle)
+{
+	/* forward message to remote */
+	/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
+	/*the serialized form is kept with the message, so a message sent to several remote modules is encoded once*/
+	/*only module hosts that read the current version have a shared memory message channel*/
+	uint8_t message_version = (uint8_t)gateway_atomic_load(&handleData->message_version);
+	int older_version = (message_version != GATEWAY_MESSAGE_VERSION_CURRENT && handleData->message_channel == NULL);
+	const CONSTBUFFER* serialized = older_version ? NULL : Message_GetByteArray(messageHandle);
+	if (older_version)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_095: [ If the accepted message version is not GATEWAY_MESSAGE_VERSION_CURRENT, this function shall serialize the message in that version with Message_ToByteArrayVersion into a buffer from nn_allocmsg. ]*/
+		send_versioned_message(handleData, messageHandle, message_version);
+	}
+	else if (serialized == NULL)
+	{
+		LogError("unable to serialize outgoing message [%p]", messageHandle);
+	}
+	else if (handleData->message_channel != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_074: [ With a shared memory message channel, messages and frames shall be sent with SharedMemoryChannel_Send, waiting for room until the channel is closed. ]*/
+		if (SharedMemoryChannel_Send(handleData->message_channel, serialized->buffer, (int32_t)serialized->size, -1) != SHARED_MEMORY_CHANNEL_OK)
+		{
+			LogError("unable to send buffer to remote for message [%p]", messageHandle);
+		}
+	}
+	else
+	{
+		int32_t msg_size = (int32_t)serialized->size;
+		void* result = nn_allocmsg(msg_size, 0);
+		if (result == NULL)
+		{
+			LogError("unable to allocate buffer for outgoing message [%p]", messageHandle);
+		}
+		else
+		{
+			(void)memcpy(result, serialized->buffer, msg_size);
+			/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
+			int nbytes = nn_really_send(handleData->message_socket, &result, NN_MSG, 0);
+			if (nbytes != msg_size)
+			{
+				LogError("unable to send buffer to remote for message [%p]", messageHandle);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
+				nn_freemsg(result);
+			}
+		}
+	}
+	// We are finally finished with this message
+	/*Codes_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
+	Message_Destroy(messageHandle);
+}
+
+static void send_frame(OUTPROCESS_HANDLE_DATA * handleData, MESSAGE_BATCH_HANDLE batch)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_069: [ This function shall serialize the frame with MessageBatch_ToByteArray into a buffer from nn_allocmsg, send it on the message channel, and clear the batch. ]*/
+	int32_t frame_size = MessageBatch_ToByteArray(batch, NULL, 0);
+	if (frame_size < 0)
+	{
+		LogError("unable to size an outgoing frame");
+	}
+	else if (handleData->message_channel != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_074: [ With a shared memory message channel, messages and frames shall be sent with SharedMemoryChannel_Send, waiting for room until the channel is closed. ]*/
+		unsigned char* frame = (unsigned char*)malloc(frame_size);
+		if (frame == NULL)
+		{
+			LogError("unable to allocate buffer for an outgoing frame of %d bytes", (int)frame_size);
+		}
+		else
+		{
+			if (MessageBatch_ToByteArray(batch, frame, frame_size) != frame_size ||
+				SharedMemoryChannel_Send(handleData->message_channel, frame, frame_size, -1) != SHARED_MEMORY_CHANNEL_OK)
+			{
+				LogError("unable to send a frame of %d bytes to remote", (int)frame_size);
+			}
+			free(frame);
+		}
+	}
+	else
+	{
+		void* frame = nn_allocmsg(frame_size, 0);
+		if (frame == NULL)
+		{
+			LogError("unable to allocate buffer for an outgoing frame of %d bytes", (int)frame_size);
+		}
+		else if (MessageBatch_ToByteArray(batch, (unsigned char*)frame, frame_size) != frame_size)
+		{
+			LogError("unable to serialize an outgoing frame");
+			nn_freemsg(frame);
+		}
+		else
+		{
+			int nbytes = nn_really_send(handleData->message_socket, &frame, NN_MSG, 0);
+			if (nbytes != frame_size)
+			{
+				LogError("unable to send a frame of %d bytes to remote", (int)frame_size);
+				nn_freemsg(frame);
+			}
+		}
+	}
+	MessageBatch_Clear(batch);
+}
+
+/*sends messageHandle with whatever follows it in the queue within the linger time, and returns the message that did not fit, if any*/
+static MESSAGE_HANDLE send_message_frame(OUTPROCESS_HANDLE_DATA * handleData, MESSAGE_BATCH_HANDLE batch, uint32_t linger_ms, TICK_COUNTER_HANDLE tick_counter, MESSAGE_HANDLE messageHandle)
+{
+	MESSAGE_HANDLE carried = NULL;
+	tickcounter_ms_t started = 0;
+	if (linger_ms != 0 &&
+		(tick_counter == NULL || tickcounter_get_current_ms(tick_counter, &started) != 0))
+	{
+		LogError("unable to read the time, sending only queued messages in the frame");
+		linger_ms = 0;
+	}
+
+	while (messageHandle != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_067: [ If the module host accepted frames, this function shall add the message to a batch, then keep adding the messages it removes from the queue, waiting no longer than the accepted linger time since the first one, until the batch is full, a message does not fit, or no message arrives. ]*/
+		MESSAGE_BATCH_RESULT add_result = MessageBatch_Add(batch, messageHandle);
+		if (add_result == MESSAGE_BATCH_NO_ROOM)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_068: [ A message that does not fit in the batch shall start the next frame. ]*/
+			carried = messageHandle;
+			/*the next frame takes its credit again*/
+			add_send_credits(handleData, 1);
+			break;
+		}
+		if (add_result == MESSAGE_BATCH_ERROR)
+		{
+			LogError("unable to add outgoing message [%p] to a frame", messageHandle);
+		}
+		/*the batch holds its own clone*/
+		Message_Destroy(messageHandle);
+		messageHandle = NULL;
+		if (add_result == MESSAGE_BATCH_FULL)
+		{
+			break;
+		}
+
+		int wait_ms = 0;
+		tickcounter_ms_t now;
+		if (linger_ms != 0 && tickcounter_get_current_ms(tick_counter, &now) == 0 && (now - started) < linger_ms)
+		{
+			wait_ms = (int)(linger_ms - (now - started));
+		}
+		messageHandle = MESSAGE_QUEUE_pop_wait(handleData->outgoing_messages, wait_ms);
+		if (messageHandle != NULL)
+		{
+			post_queue_room(handleData);
+		}
+		if (messageHandle != NULL && take_send_credit(handleData, 0) != 0)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_078: [ A message that has no credit shall not wait in a frame already started, but start the next frame once credit arrives. ]*/
+			carried = messageHandle;
+			break;
+		}
+	}
+
+	if (MessageBatch_GetCount(batch) > 0)
+	{
+		send_frame(handleData, batch);
+	}
+	return carried;
+}
+
 static int outprocessOutgoingMessagesThread(void * param)
 {
 	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
@@ -157,6 +649,10 @@ static int outprocessOutgoingMessagesThread(void * param)
 	else
 	{
 		int should_continue = 1;
+		MESSAGE_HANDLE carried = NULL;
+		MESSAGE_BATCH_HANDLE batch = NULL;
+		MESSAGE_BATCH_LIMITS batch_limits = { 0, 0, 0 };
+		TICK_COUNTER_HANDLE tick_counter = NULL;
 
 		while (should_continue)
 		{
@@ -178,77 +674,123 @@ static int outprocessOutgoingMessagesThread(void * param)
 				should_continue = 0;
 				break;
 			}
-			MESSAGE_HANDLE messageHandle;
-			/*Codes_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-			if (Lock(handleData->handle_lock) != LOCK_OK)
+			/*Codes_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_062: [ This function shall wait on the outgoing gateway message queue until a message is queued or the queue is closed. ]*/
+			int popped = (carried == NULL);
+			MESSAGE_HANDLE messageHandle = popped ? MESSAGE_QUEUE_pop_wait(handleData->outgoing_messages, -1) : carried;
+			carried = NULL;
+			if (messageHandle == NULL)
 			{
-				LogError("unable to Lock");
+				/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ This function shall end once the outgoing gateway message queue is closed and empty. ]*/
 				should_continue = 0;
 				break;
 			}
-			
-			if (MESSAGE_QUEUE_is_empty(handleData->outgoing_messages))
+			if (popped)
 			{
-				messageHandle = NULL;
+				/*Codes_SRS_OUTPROCESS_MODULE_17_099: [ Once it removes a message from a queue with BROKER_OVERFLOW_BLOCK, this function shall wake a thread waiting in Outprocess_Receive for room. ]*/
+				post_queue_room(handleData);
 			}
-			else
+			/*Codes_SRS_OUTPROCESS_MODULE_17_077: [ If the module host accepted a credit window, this function shall take a credit for each message it sends, waiting for the module host to grant more when none is left. ]*/
+			(void)take_send_credit(handleData, 1);
+
+			MESSAGE_BATCH_LIMITS accepted = get_batch_limits(handleData);
+			if (accepted.max_messages != 0 &&
+				(batch == NULL || accepted.max_messages != batch_limits.max_messages || accepted.max_bytes != batch_limits.max_bytes))
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-				messageHandle = MESSAGE_QUEUE_pop(handleData->outgoing_messages);
-				if (messageHandle == NULL)
+				/*the module host may have been reattached with other limits*/
+				if (batch != NULL)
 				{
-					LogError("bad condition: message handle in queue is NULL");
-					(void)Unlock(handleData->handle_lock);
-					should_continue = 0;
-					break;
+					MessageBatch_Destroy(batch);
 				}
+				batch = MessageBatch_Create(&accepted);
+				if (batch == NULL)
+				{
+					LogError("unable to create a batch, sending messages one at a time");
+				}
+				batch_limits = accepted;
 			}
-			if (Unlock(handleData->handle_lock) != LOCK_OK)
+			if (accepted.linger_ms != 0 && tick_counter == NULL)
 			{
-				should_continue = 0;
-				break;
+				tick_counter = tickcounter_create();
 			}
 
-			/* forward message to remote */
-			if (messageHandle != NULL)
+			if (accepted.max_messages != 0 && batch != NULL)
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
-				int32_t msg_size = Message_ToByteArray(messageHandle, NULL, 0);
-				if (msg_size < 0)
-				{
-					LogError("unable to serialize outgoing message [%p]", messageHandle);
-				}
-				else
-				{
-					void* result = nn_allocmsg(msg_size, 0);
-					if (result == NULL)
-					{
-						LogError("unable to allocate buffer for outgoing message [%p]", messageHandle);
-					}
-					else
-					{
-						unsigned char *nn_msg_bytes = (unsigned char *)result;
-						Message_ToByteArray(messageHandle, nn_msg_bytes, msg_size);
-						/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
-						int nbytes = nn_really_send(handleData->message_socket, &result, NN_MSG, 0);
-						if (nbytes != msg_size)
-						{
-							LogError("unable to send buffer to remote for message [%p]", messageHandle);
-							/*Codes_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
-							nn_freemsg(result);
-						}
-					}
-				}
-				// We are finally finished with this message
-				/*Codes_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
-				Message_Destroy(messageHandle);
+				carried = send_message_frame(handleData, batch, accepted.linger_ms, tick_counter, messageHandle);
 			}
-			ThreadAPI_Sleep(1);
+			else
+			{
+				send_single_message(handleData, messageHandle);
+			}
+		}
+
+		if (carried != NULL)
+		{
+			Message_Destroy(carried);
+		}
+		if (batch != NULL)
+		{
+			MessageBatch_Destroy(batch);
+		}
+		if (tick_counter != NULL)
+		{
+			tickcounter_destroy(tick_counter);
 		}
 	}
 	return 0;
 }
 
+/*keeps the frame limits the module host returned in its reply, all zero if it declined them*/
+static void accept_batch_limits(OUTPROCESS_HANDLE_DATA * handleData, const MESSAGE_BATCH_LIMITS * reply_limits)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_065: [ If frames were offered, and the Create Response returns frame limits, this function shall send and receive frames within the smaller of the offered and returned limits; otherwise it shall send and receive messages one at a time. ]*/
+	MESSAGE_BATCH_LIMITS accepted = { 0, 0, 0 };
+	if (reply_limits->max_messages != 0 && reply_limits->max_bytes != 0)
+	{
+		accepted.max_messages = (reply_limits->max_messages < handleData->batch_offer.max_messages) ? reply_limits->max_messages : handleData->batch_offer.max_messages;
+		accepted.max_bytes = (reply_limits->max_bytes < handleData->batch_offer.max_bytes) ? reply_limits->max_bytes : handleData->batch_offer.max_bytes;
+		accepted.linger_ms = (reply_limits->linger_ms < handleData->batch_offer.linger_ms) ? reply_limits->linger_ms : handleData->batch_offer.linger_ms;
+	}
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data, sending messages one at a time");
+	}
+	else
+	{
+		handleData->batch_limits = accepted;
+		(void)Unlock(handleData->handle_lock);
+	}
+}
+
+/*keeps the credit window the module host returned in its reply, and starts over with a full window of credit*/
+static void accept_credit_window(OUTPROCESS_HANDLE_DATA * handleData, uint32_t reply_window)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_076: [ If a credit window was offered, and the Create Response returns a credit window, this function shall send messages within the smaller of the two windows and grant credit for the messages it receives; otherwise it shall send and receive messages without credit. ]*/
+	uint32_t accepted = (reply_window < handleData->credit_offer) ? reply_window : handleData->credit_offer;
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data, sending messages without credit");
+	}
+	else
+	{
+		handleData->credit_window = accepted;
+		handleData->send_credits = accepted;
+		(void)Condition_Post(handleData->credit_available);
+		(void)Unlock(handleData->handle_lock);
+	}
+}
+
+/*keeps the lower of the highest message version the module host reads and this gateway's, version 1 if its reply does not say*/
+static void accept_message_version(OUTPROCESS_HANDLE_DATA * handleData, uint8_t reply_version)
+{
+	/*Codes_SRS_OUTPROCESS_MODULE_17_096: [ If the Create Response returns a max_message_version, this function shall send messages in the lower of it and GATEWAY_MESSAGE_VERSION_CURRENT; otherwise it shall send them in GATEWAY_MESSAGE_VERSION_1. ]*/
+	uint8_t accepted =
+		(reply_version == 0) ? GATEWAY_MESSAGE_VERSION_1 :
+		(reply_version < GATEWAY_MESSAGE_VERSION_CURRENT) ? reply_version :
+		GATEWAY_MESSAGE_VERSION_CURRENT;
+	gateway_atomic_store(&handleData->message_version, accepted);
+}
+
 static int outprocessCreate(void *param)
 {
 	int thread_return;
@@ -270,6 +812,7 @@ static int outprocessCreate(void *param)
 		{
 			int control_fd = handleData->control_socket;
 			int remote_message_wait = (int)handleData->remote_message_wait;
+			int handed_over = handleData->attaching;
 			(void)Unlock(handleData->handle_lock);
 			int should_continue = 1;
 
@@ -317,11 +860,22 @@ static int outprocessCreate(void *param)
 						else
 						{
 							unsigned char *buf = NULL;
-							/* This receive should time out if no one sends a response. */
-							int recvBytes = nn_recv(control_fd, (void *)&buf, NN_MSG, 0);
+							int recvBytes;
+							int recv_error;
+							if (handed_over)
+							{
+								/*Codes_SRS_OUTPROCESS_MODULE_17_106: [ The thread reattaching the module host shall take the reply the control channel callback hands over, waiting no longer than remote_message_wait, instead of receiving on the control socket. ]*/
+								recvBytes = wait_for_control_reply(handleData, remote_message_wait, &buf);
+								recv_error = ETIMEDOUT;
+							}
+							else
+							{
+								/* This receive should time out if no one sends a response. */
+								recvBytes = nn_recv(control_fd, (void *)&buf, NN_MSG, 0);
+								recv_error = (recvBytes < 0) ? nn_errno() : 0;
+							}
 							if (recvBytes < 0)
 							{
-								int recv_error = nn_errno();
 								if (recv_error != EAGAIN && recv_error != ETIMEDOUT && recv_error != EINTR)
 								{
 									LogError("unexpected error on control channel receive: %d", recv_error);
@@ -356,6 +910,15 @@ static int outprocessCreate(void *param)
 											/*Codes_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
 											// complete success!
 											thread_return = 1;
+											accept_message_version(handleData, resp_msg->max_message_version);
+											if (handleData->batch_offer.max_messages != 0)
+											{
+												accept_batch_limits(handleData, &resp_msg->batch_limits);
+											}
+											if (handleData->credit_offer != 0)
+											{
+												accept_credit_window(handleData, resp_msg->credit_window);
+											}
 										}
 									}
 									ControlMessage_Destroy(msg);
@@ -367,161 +930,478 @@ static int outprocessCreate(void *param)
 			} while (should_continue == 1);
 		}
 	}
-	return thread_return;
+	return thread_return;
+}
+
+/*acts on a control message received from the module host and frees its buffer; returns non-zero if the module host should be reattached*/
+static int on_control_message(OUTPROCESS_HANDLE_DATA * handleData, unsigned char * buf, int nbytes)
+{
+	int needs_to_attach = 0;
+	CONTROL_MESSAGE * msg = ControlMessage_CreateFromByteArray((const unsigned char*)buf, nbytes);
+	nn_freemsg(buf);
+	if (msg != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_058: [ If a message has been received, it shall look for a Module Reply message. ]*/
+		if (msg->type == CONTROL_MESSAGE_TYPE_MODULE_REPLY)
+		{
+			CONTROL_MESSAGE_MODULE_REPLY * resp_msg = (CONTROL_MESSAGE_MODULE_REPLY*)msg;
+			if (resp_msg->status != 0)
+			{
+				/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
+				needs_to_attach = 1;
+			}
+		}
+		else if (msg->type == CONTROL_MESSAGE_TYPE_MODULE_CREDIT)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_080: [ If a Credit Message has been received, this thread shall add its credits, up to the accepted window, and wake the outgoing gateway message thread. ]*/
+			add_send_credits(handleData, ((CONTROL_MESSAGE_MODULE_CREDIT*)msg)->credits);
+		}
+		ControlMessage_Destroy(msg);
+	}
+	return needs_to_attach;
+}
+
+int outprocessControlThread(void *param)
+{
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
+	if (handleData == NULL)
+	{
+		LogError("outprocessControlThread: parameter is NULL");
+	}
+	else
+	{
+		int should_continue = 1;
+		int needs_to_attach = 0;
+
+		while (should_continue)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
+			if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
+			{
+				LogError("unable to Lock");
+				should_continue = 0;
+				break;
+			}
+			if (handleData->control_thread.thread_flag == THREAD_FLAG_STOP)
+			{
+				should_continue = 0;
+				(void)Unlock(handleData->control_thread.thread_lock);
+				break;
+			}
+			if (Unlock(handleData->control_thread.thread_lock) != LOCK_OK)
+			{
+				should_continue = 0;
+				break;
+			}
+
+			if (needs_to_attach)
+			{
+				// our remote has detached.  Attempt to reattach.
+				/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
+
+				/*Codes_SRS_OUTPROCESS_MODULE_17_060: [ Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host. ]*/
+				if (outprocessCreate(handleData) < 0)
+				{
+					LogError("attempting to reattach to remote failed");
+				}
+				else
+				{
+                    /*Codes_SRS_OUTPROCESS_MODULE_24_061: [ Once the control channel has been restarted and Create Message was sent, it shall send a Start Message to the module host. ]*/
+                    send_start_message(handleData);
+					needs_to_attach = 0;
+				}
+			}
+
+			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
+			if (Lock(handleData->handle_lock) != LOCK_OK)
+			{
+				LogError("unable to Lock handle data");
+				should_continue = 0;
+				break;
+			}
+			int nn_fd = handleData->control_socket;
+			if (Unlock(handleData->handle_lock) != LOCK_OK)
+			{
+				should_continue = 0;
+				break;
+			}
+
+			struct nn_pollfd control_poll;
+			control_poll.fd = nn_fd;
+			control_poll.events = NN_POLLIN;
+			control_poll.revents = 0;
+			/*Codes_SRS_OUTPROCESS_MODULE_17_057: [ This thread shall wait on the control channel, for up to 1 second at a time, for a message from the module host process. ]*/
+			int poll_result = nn_poll(&control_poll, 1, CONTROL_POLL_TIMEOUT_MS);
+			if (poll_result < 0)
+			{
+				if (nn_errno() != EINTR)
+					should_continue = 0;
+			}
+			else if (poll_result > 0 && (control_poll.revents & NN_POLLIN) != 0)
+			{
+				int nbytes;
+				unsigned char *buf = NULL;
+				errno = 0;
+				nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, NN_DONTWAIT);
+				if (nbytes < 0)
+				{
+					int receive_error = nn_errno();
+					if (receive_error != EAGAIN)
+						should_continue = 0;
+				}
+				else
+				{
+					if (on_control_message(handleData, buf, nbytes) != 0)
+					{
+						needs_to_attach = 1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/* Shared I/O thread functions
+*/
+
+/*frees a control message handed over but not taken; called with the handle lock held*/
+static void discard_control_reply(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	if (handleData->control_reply != NULL)
+	{
+		(void)nn_freemsg(handleData->control_reply);
+		handleData->control_reply = NULL;
+	}
+}
+
+/*waits for the control channel callback to hand over a control message; returns its size, or -1 if none came in time*/
+static int wait_for_control_reply(OUTPROCESS_HANDLE_DATA * handleData, int timeout_ms, unsigned char ** buf)
+{
+	int result = -1;
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data");
+	}
+	else
+	{
+		if (handleData->control_reply == NULL)
+		{
+			(void)Condition_Wait(handleData->control_reply_received, handleData->handle_lock, timeout_ms);
+		}
+		if (handleData->control_reply != NULL)
+		{
+			*buf = handleData->control_reply;
+			result = handleData->control_reply_size;
+			handleData->control_reply = NULL;
+		}
+		(void)Unlock(handleData->handle_lock);
+	}
+	return result;
+}
+
+static int outprocessReattachThread(void *param)
+{
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
+	int should_continue = 1;
+	while (should_continue)
+	{
+		if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
+		{
+			LogError("unable to Lock");
+			should_continue = 0;
+			break;
+		}
+		if (handleData->control_thread.thread_flag == THREAD_FLAG_STOP)
+		{
+			should_continue = 0;
+			(void)Unlock(handleData->control_thread.thread_lock);
+			break;
+		}
+		(void)Unlock(handleData->control_thread.thread_lock);
+
+		/*Codes_SRS_OUTPROCESS_MODULE_17_088: [ The thread reattaching the module host shall follow the same process in Outprocess_Create to send a Create Message, then send a Start Message, and end. ]*/
+		if (outprocessCreate(handleData) < 0)
+		{
+			LogError("attempting to reattach to remote failed");
+		}
+		else
+		{
+			send_start_message(handleData);
+			should_continue = 0;
+		}
+	}
+
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data, control messages are left unread");
+	}
+	else
+	{
+		handleData->attaching = 0;
+		discard_control_reply(handleData);
+		(void)Unlock(handleData->handle_lock);
+	}
+	return 0;
+}
+
+/*starts a thread to reattach the module host, as the socket poller's thread must not wait for its reply*/
+static void start_reattach_thread(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	if (handleData->control_thread.thread_handle != NULL)
+	{
+		/*the last reattach thread has ended, or is about to, since attaching is no longer set*/
+		int notUsed;
+		(void)ThreadAPI_Join(handleData->control_thread.thread_handle, &notUsed);
+		handleData->control_thread.thread_handle = NULL;
+	}
+
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data, not reattaching to remote");
+	}
+	else if (handleData->control_reply_received == NULL &&
+		(handleData->control_reply_received = Condition_Init()) == NULL)
+	{
+		LogError("unable to create the control reply condition, not reattaching to remote");
+		(void)Unlock(handleData->handle_lock);
+	}
+	else
+	{
+		handleData->attaching = 1;
+		discard_control_reply(handleData);
+		(void)Unlock(handleData->handle_lock);
+		/*Codes_SRS_OUTPROCESS_MODULE_17_087: [ If a Module Reply message indicates the module has failed or has been terminated, the control channel callback shall start a thread to reattach the module host, and leave the control messages to that thread until it ends. ]*/
+		if (ThreadAPI_Create(&(handleData->control_thread.thread_handle), outprocessReattachThread, handleData) != THREADAPI_OK)
+		{
+			LogError("failed to spawn a thread to reattach to remote");
+			handleData->control_thread.thread_handle = NULL;
+			if (Lock(handleData->handle_lock) == LOCK_OK)
+			{
+				handleData->attaching = 0;
+				(void)Unlock(handleData->handle_lock);
+			}
+		}
+	}
 }
 
-int outprocessControlThread(void *param)
+/*called on the socket poller's thread when the control socket has a message*/
+static void on_control_readable(void* context, int socket)
 {
-	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
-	if (handleData == NULL)
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)context;
+	unsigned char *buf = NULL;
+	/*Codes_SRS_OUTPROCESS_MODULE_17_086: [ The control channel callback shall receive a control message without waiting, and act on it like the control thread. ]*/
+	int nbytes = nn_recv(socket, (void *)&buf, NN_MSG, NN_DONTWAIT);
+	if (nbytes >= 0)
 	{
-		LogError("outprocessControlThread: parameter is NULL");
+		if (Lock(handleData->handle_lock) != LOCK_OK)
+		{
+			LogError("unable to Lock handle data, dropping a control message");
+			(void)nn_freemsg(buf);
+		}
+		else if (handleData->attaching)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_105: [ While a thread reattaches the module host, the control channel callback shall still receive each control message, and hand it to that thread in place of any it has not taken yet. ]*/
+			discard_control_reply(handleData);
+			handleData->control_reply = buf;
+			handleData->control_reply_size = nbytes;
+			(void)Condition_Post(handleData->control_reply_received);
+			(void)Unlock(handleData->handle_lock);
+		}
+		else
+		{
+			(void)Unlock(handleData->handle_lock);
+			if (on_control_message(handleData, buf, nbytes) != 0)
+			{
+				start_reattach_thread(handleData);
+			}
+		}
+	}
+}
+
+/*called on the socket poller's thread when the message socket has a message*/
+static void on_message_readable(void* context, int socket)
+{
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)context;
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data");
 	}
 	else
 	{
-		int should_continue = 1;
-		int needs_to_attach = 0;
+		int frames_accepted = (handleData->batch_limits.max_messages != 0);
+		int control_fd = handleData->control_socket;
+		uint32_t credit_window = handleData->credit_window;
+		(void)Unlock(handleData->handle_lock);
 
-		while (should_continue)
+		unsigned char *buf = NULL;
+		/*Codes_SRS_OUTPROCESS_MODULE_17_085: [ The message channel callback shall receive a message or frame without waiting, publish it like the incoming message thread, and grant credit like it. ]*/
+		int nbytes = nn_recv(socket, (void *)&buf, NN_MSG, NN_DONTWAIT);
+		if (nbytes >= 0)
 		{
-			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
-			if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
-			{
-				LogError("unable to Lock");
-				should_continue = 0;
-				break;
-			}
-			if (handleData->control_thread.thread_flag == THREAD_FLAG_STOP)
-			{
-				should_continue = 0;
-				(void)Unlock(handleData->control_thread.thread_lock);
-				break;
-			}
-			if (Unlock(handleData->control_thread.thread_lock) != LOCK_OK)
-			{
-				should_continue = 0;
-				break;
-			}
+			publish_received_buffer(handleData, buf, nbytes, frames_accepted);
+			grant_received_credits(handleData, control_fd, credit_window);
+		}
+	}
+}
 
-			if (needs_to_attach)
-			{
-				// our remote has detached.  Attempt to reattach.
-				/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
+static void lock_shared_poller(void)
+{
+	while (!gateway_atomic_compare_exchange(&shared_poller_busy, 0, 1))
+	{
+		/*the holder may be waiting for the poller's thread to start a round*/
+		ThreadAPI_Sleep(1);
+	}
+}
 
-				/*Codes_SRS_OUTPROCESS_MODULE_17_060: [ Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host. ]*/
-				if (outprocessCreate(handleData) < 0)
-				{
-					LogError("attempting to reattach to remote failed");
-				}
-				else
-				{
-                    /*Codes_SRS_OUTPROCESS_MODULE_24_061: [ Once the control channel has been restarted and Create Message was sent, it shall send a Start Message to the module host. ]*/
-                    send_start_message(handleData);
-					needs_to_attach = 0;
-				}
-			}
+static void unlock_shared_poller(void)
+{
+	gateway_atomic_store(&shared_poller_busy, 0);
+}
 
-			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
-			if (Lock(handleData->handle_lock) != LOCK_OK)
-			{
-				LogError("unable to Lock handle data");
-				should_continue = 0;
-				break;
-			}
-			int nn_fd = handleData->control_socket;
-			if (Unlock(handleData->handle_lock) != LOCK_OK)
-			{
-				should_continue = 0;
-				break;
-			}
+/*called with the shared poller locked*/
+static void release_shared_poller(void)
+{
+	shared_poller_users--;
+	if (shared_poller_users == 0)
+	{
+		SocketPoller_Destroy(shared_poller);
+		shared_poller = NULL;
+	}
+}
 
-			int nbytes;
-			unsigned char *buf = NULL;
-			errno = 0;
-			/*Codes_SRS_OUTPROCESS_MODULE_17_057: [ This thread shall periodically attempt to receive a meesage from the module host process. ]*/
-			nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, NN_DONTWAIT);
-			if (nbytes < 0)
+/*adds the control socket, and the message socket unless the channel is shared memory, to the shared socket poller*/
+static int add_to_shared_poller(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	int result;
+	lock_shared_poller();
+	if (shared_poller == NULL && (shared_poller = SocketPoller_Create()) == NULL)
+	{
+		LogError("unable to create the shared socket poller");
+		result = __LINE__;
+	}
+	else
+	{
+		shared_poller_users++;
+		if (SocketPoller_Add(shared_poller, handleData->control_socket, on_control_readable, handleData) != 0)
+		{
+			LogError("unable to add the control socket to the shared socket poller");
+			result = __LINE__;
+		}
+		else if (handleData->message_channel == NULL &&
+			SocketPoller_Add(shared_poller, handleData->message_socket, on_message_readable, handleData) != 0)
+		{
+			LogError("unable to add the message socket to the shared socket poller");
+			SocketPoller_Remove(shared_poller, handleData->control_socket);
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+
+		if (result != 0)
+		{
+			release_shared_poller();
+		}
+	}
+	unlock_shared_poller();
+	return result;
+}
+
+static void remove_from_shared_poller(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	lock_shared_poller();
+	SocketPoller_Remove(shared_poller, handleData->control_socket);
+	if (handleData->message_channel == NULL)
+	{
+		SocketPoller_Remove(shared_poller, handleData->message_socket);
+	}
+	release_shared_poller();
+	unlock_shared_poller();
+}
+
+/* Connection related functions
+*/
+
+static int message_connection_setup(OUTPROCESS_HANDLE_DATA* handleData, OUTPROCESS_MODULE_CONFIG * config)
+{
+	int result;
+	if (config->message_channel == OUTPROCESS_MESSAGE_CHANNEL_SHARED_MEMORY)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_071: [ If the configuration selects a shared memory message channel, this function shall create it on the message_uri with SharedMemoryChannel_Create instead of the pair socket. ]*/
+		handleData->message_channel = SharedMemoryChannel_Create(STRING_c_str(config->message_uri), config->message_channel_size);
+		if (handleData->message_channel == NULL)
+		{
+			result = -1;
+			LogError("unable to create the shared memory message channel");
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_008: [ This function shall create a pair socket for sending gateway messages to the module host. ]*/
+		handleData->message_socket = nn_socket(AF_SP, NN_PAIR);
+		if (handleData->message_socket < 0)
+		{
+			result = handleData->message_socket;
+			LogError("message socket failed to create, result = %d, errno = %d", result, nn_errno());
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_009: [ This function shall bind and connect the pair socket to the message_uri. ]*/
+			int message_bind_id = nn_connect(handleData->message_socket, STRING_c_str(config->message_uri));
+			if (message_bind_id < 0)
 			{
-				int receive_error = nn_errno();
-				if (receive_error != EAGAIN)
-					should_continue = 0;
+				result = message_bind_id;
+				LogError("remote socket failed to bind to message URL, result = %d, errno = %d", result, nn_errno());
 			}
 			else
 			{
-				CONTROL_MESSAGE * msg = ControlMessage_CreateFromByteArray((const unsigned char*)buf, nbytes);
-				nn_freemsg(buf);
-				if (msg != NULL)
-				{
-					/*Codes_SRS_OUTPROCESS_MODULE_17_058: [ If a message has been received, it shall look for a Module Reply message. ]*/
-					if (msg->type == CONTROL_MESSAGE_TYPE_MODULE_REPLY)
-					{
-						CONTROL_MESSAGE_MODULE_REPLY * resp_msg = (CONTROL_MESSAGE_MODULE_REPLY*)msg;
-						if (resp_msg->status != 0)
-						{
-							/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
-							needs_to_attach = 1;
-						}
-					}
-					ControlMessage_Destroy(msg);
-				}
+				result = 0;
 			}
-			ThreadAPI_Sleep(250);
 		}
 	}
-	return 0;
+	return result;
 }
 
-/* Connection related functions
-*/
-
 static int connection_setup(OUTPROCESS_HANDLE_DATA* handleData, OUTPROCESS_MODULE_CONFIG * config)
 {
 	int result;
 	handleData->control_socket = -1;
+	handleData->message_socket = -1;
+	handleData->message_channel = NULL;
 	/*
 	* Start with messaging socket.
 	*/
-	/*Codes_SRS_OUTPROCESS_MODULE_17_008: [ This function shall create a pair socket for sending gateway messages to the module host. ]*/
-	handleData->message_socket = nn_socket(AF_SP, NN_PAIR);
-	if (handleData->message_socket < 0)
-	{
-		result = handleData->message_socket;
-		LogError("message socket failed to create, result = %d, errno = %d", result, nn_errno());
-	}
-	else
+	result = message_connection_setup(handleData, config);
+	if (result == 0)
 	{
-		/*Codes_SRS_OUTPROCESS_MODULE_17_009: [ This function shall bind and connect the pair socket to the message_uri. ]*/
-		int message_bind_id = nn_connect(handleData->message_socket, STRING_c_str(config->message_uri));
-		if (message_bind_id < 0)
+		/*
+		* Now, the control socket.
+		*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_010: [ This function shall create a request/reply socket for sending control messages to the module host. ]*/
+		handleData->control_socket = nn_socket(AF_SP, NN_PAIR);
+		if (handleData->control_socket < 0)
 		{
-			result = message_bind_id;
-			LogError("remote socket failed to bind to message URL, result = %d, errno = %d", result, nn_errno());
+			result = handleData->control_socket;
+			LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
 		}
 		else
 		{
-			/*
-			* Now, the control socket.
-			*/
-			/*Codes_SRS_OUTPROCESS_MODULE_17_010: [ This function shall create a request/reply socket for sending control messages to the module host. ]*/
-			handleData->control_socket = nn_socket(AF_SP, NN_PAIR);
-			if (handleData->control_socket < 0)
+			/*Codes_SRS_OUTPROCESS_MODULE_17_011: [ This function shall connect the request/reply socket to the control_id. ]*/
+			int control_connect_id = nn_connect(handleData->control_socket, STRING_c_str(config->control_uri));
+			if (control_connect_id < 0)
 			{
-				result = handleData->control_socket;
+				result = control_connect_id;
 				LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_011: [ This function shall connect the request/reply socket to the control_id. ]*/
-				int control_connect_id = nn_connect(handleData->control_socket, STRING_c_str(config->control_uri));
-				if (control_connect_id < 0)
-				{
-					result = control_connect_id;
-					LogError("remote socket failed to connect to control URL, result = %d, errno = %d", result, nn_errno());
-				}
-				else
-				{
-					result = 0;
-				}
+				result = 0;
 			}
 		}
 	}
@@ -536,11 +1416,93 @@ static void connection_teardown(OUTPROCESS_HANDLE_DATA* handleData)
 	}
 	if (handleData->message_socket >= 0)
 		(void)nn_really_close(handleData->message_socket);
+	/*the channel stays mapped for the threads still using it until connection_release*/
+	if (handleData->message_channel != NULL)
+		SharedMemoryChannel_Close(handleData->message_channel);
 	if (handleData->control_socket >= 0)
 		(void)nn_really_close(handleData->control_socket);
 	(void)Unlock(handleData->handle_lock);
 }
 
+/*creates the outgoing gateway message queue, and what a credit window needs if one is offered*/
+static int outgoing_queue_setup(OUTPROCESS_HANDLE_DATA* handleData, OUTPROCESS_MODULE_CONFIG * config)
+{
+	int result;
+	handleData->credit_offer = config->credit_window;
+	handleData->credit_window = 0;
+	handleData->send_credits = 0;
+	gateway_atomic_store(&handleData->message_version, GATEWAY_MESSAGE_VERSION_1);
+	handleData->received_since_grant = 0;
+	handleData->credit_available = NULL;
+	handleData->overflow = config->credit_overflow;
+	handleData->room_available = NULL;
+	handleData->room_waiters = 0;
+	handleData->receive_closed = 0;
+	gateway_atomic_store(&handleData->dropped, 0);
+	if (config->credit_window == 0)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
+		handleData->outgoing_messages = MESSAGE_QUEUE_create();
+	}
+	else if ((handleData->credit_available = Condition_Init()) == NULL)
+	{
+		LogError("unable to create the credit condition");
+		handleData->outgoing_messages = NULL;
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_082: [ If a credit window is configured, the queue for outgoing gateway messages shall hold no more messages than the window. ]*/
+		handleData->outgoing_messages = MESSAGE_QUEUE_create_with_capacity(config->credit_window);
+		if (handleData->outgoing_messages == NULL)
+		{
+			Condition_Deinit(handleData->credit_available);
+		}
+		/*Codes_SRS_OUTPROCESS_MODULE_17_097: [ If a credit window is configured with BROKER_OVERFLOW_BLOCK, this function shall create a condition to wait on for room in the queue. ]*/
+		else if (config->credit_overflow == BROKER_OVERFLOW_BLOCK &&
+			(handleData->room_available = Condition_Init()) == NULL)
+		{
+			LogError("unable to create the queue room condition");
+			MESSAGE_QUEUE_destroy(handleData->outgoing_messages);
+			handleData->outgoing_messages = NULL;
+			Condition_Deinit(handleData->credit_available);
+		}
+	}
+
+	if (handleData->outgoing_messages == NULL)
+	{
+		LogError("unable to create outgoing message queue");
+		result = -1;
+	}
+	else
+	{
+		result = 0;
+	}
+	return result;
+}
+
+static void outgoing_queue_release(OUTPROCESS_HANDLE_DATA* handleData)
+{
+	MESSAGE_QUEUE_destroy(handleData->outgoing_messages);
+	if (handleData->credit_available != NULL)
+	{
+		Condition_Deinit(handleData->credit_available);
+	}
+	if (handleData->room_available != NULL)
+	{
+		Condition_Deinit(handleData->room_available);
+	}
+}
+
+/*frees what connection_teardown leaves for the module threads; only called once they have ended*/
+static void connection_release(OUTPROCESS_HANDLE_DATA* handleData)
+{
+	if (handleData->message_channel != NULL)
+	{
+		SharedMemoryChannel_Destroy(handleData->message_channel);
+		handleData->message_channel = NULL;
+	}
+}
+
 
 
 /**/
@@ -596,14 +1558,21 @@ static void* construct_create_message(OUTPROCESS_HANDLE_DATA* handleData, int32_
 				CONTROL_MESSAGE_VERSION_CURRENT,	/*version*/
 				CONTROL_MESSAGE_TYPE_MODULE_CREATE	/*type*/
 			},
-			GATEWAY_MESSAGE_VERSION_CURRENT,		/*gateway_message_version*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_094: [ The Create Message shall give GATEWAY_MESSAGE_VERSION_1 as the gateway_message_version, which every module host accepts, and GATEWAY_MESSAGE_VERSION_CURRENT as the max_message_version. ]*/
+			GATEWAY_MESSAGE_VERSION_1,				/*gateway_message_version*/
 			{
 				uri_length + 1,						/*uri_size (+1 for null)*/
-				(uint8_t)NN_PAIR,					/*uri_type*/
+				/*Codes_SRS_OUTPROCESS_MODULE_17_075: [ The Create Message shall give MESSAGE_URI_TYPE_SHARED_MEMORY as the uri type of a shared memory message channel, and NN_PAIR otherwise. ]*/
+				(handleData->message_channel != NULL) ? (uint8_t)MESSAGE_URI_TYPE_SHARED_MEMORY : (uint8_t)NN_PAIR,	/*uri_type*/
 				uri_string							/*uri*/
 			},
 			args_length + 1,	/*args_size;(+1 for null)*/
-			args_string			/*args;*/
+			args_string,		/*args;*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_070: [ The Create Message shall offer the frame limits from the configuration. ]*/
+			handleData->batch_offer,	/*batch_limits*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_081: [ The Create Message shall offer the credit window from the configuration. ]*/
+			handleData->credit_offer,	/*credit_window*/
+			GATEWAY_MESSAGE_VERSION_CURRENT	/*max_message_version*/
 		};
 		result = serialize_control_message((CONTROL_MESSAGE *)&create_msg, creationMessageSize);
 	}
@@ -749,11 +1718,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
-				module->outgoing_messages = MESSAGE_QUEUE_create();
-				if (module->outgoing_messages == NULL)
+				if (outgoing_queue_setup(module, config) != 0)
 				{
-					LogError("unable to create outgoing message queue");
 					Lock_Deinit(module->handle_lock);
 					free(module);
 					module = NULL;
@@ -765,7 +1731,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						/*Codes_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
 						LogError("unable to set up connections");
 						connection_teardown(module);
-						MESSAGE_QUEUE_destroy(module->outgoing_messages);
+						connection_release(module);
+						outgoing_queue_release(module);
 						Lock_Deinit(module->handle_lock);
 						free(module);
 						module = NULL;
@@ -779,18 +1746,33 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 							0
 						};
 						module->broker = broker;
+						/*Codes_SRS_OUTPROCESS_MODULE_17_091: [ This function shall publish the messages from the module host as the configuration's publish_source, or as the module itself if publish_source is NULL. ]*/
+						module->publish_source = (config->publish_source != NULL) ? config->publish_source : (MODULE_HANDLE)module;
 						module->remote_message_wait = config->remote_message_wait;
+						module->batch_offer.max_messages = config->batch_max_messages;
+						module->batch_offer.max_bytes = (config->batch_max_messages != 0) ? config->batch_max_bytes : 0;
+						module->batch_offer.linger_ms = (config->batch_max_messages != 0) ? config->batch_linger_ms : 0;
+						module->batch_limits.max_messages = 0;
+						module->batch_limits.max_bytes = 0;
+						module->batch_limits.linger_ms = 0;
 						module->message_receive_thread = default_thread;
 						module->message_send_thread = default_thread;
 						module->control_thread = default_thread;
 						module->async_create_thread = default_thread;
 						module->lifecyle_model = config->lifecycle_model;
+						module->io_threads = config->io_threads;
+						module->polled = 0;
+						module->attaching = 0;
+						module->control_reply = NULL;
+						module->control_reply_size = 0;
+						module->control_reply_received = NULL;
 
 						/*Codes_SRS_OUTPROCESS_MODULE_17_041: [ This function shall intitialize a lock for each thread for thread management. ]*/
 						if ((module->message_receive_thread.thread_lock = Lock_Init()) == NULL)
 						{
 							connection_teardown(module);
-							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							connection_release(module);
+							outgoing_queue_release(module);
 							Lock_Deinit(module->handle_lock);
 							free(module);
 							module = NULL;
@@ -798,7 +1780,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						else if ((module->control_thread.thread_lock = Lock_Init()) == NULL)
 						{
 							connection_teardown(module);
-							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							connection_release(module);
+							outgoing_queue_release(module);
 							Lock_Deinit(module->message_receive_thread.thread_lock);
 							Lock_Deinit(module->handle_lock);
 							free(module);
@@ -807,7 +1790,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						else if ((module->async_create_thread.thread_lock = Lock_Init()) == NULL)
 						{
 							connection_teardown(module);
-							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							connection_release(module);
+							outgoing_queue_release(module);
 							Lock_Deinit(module->control_thread.thread_lock);
 							Lock_Deinit(module->message_receive_thread.thread_lock);
 							Lock_Deinit(module->handle_lock);
@@ -817,7 +1801,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						else if ((module->message_send_thread.thread_lock = Lock_Init()) == NULL)
 						{
 							connection_teardown(module);
-							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							connection_release(module);
+							outgoing_queue_release(module);
 							Lock_Deinit(module->async_create_thread.thread_lock);
 							Lock_Deinit(module->control_thread.thread_lock);
 							Lock_Deinit(module->message_receive_thread.thread_lock);
@@ -828,7 +1813,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						else if (save_strings(module, config) != 0)
 						{
 							connection_teardown(module);
-							MESSAGE_QUEUE_destroy(module->outgoing_messages);
+							connection_release(module);
+							outgoing_queue_release(module);
 							Lock_Deinit(module->async_create_thread.thread_lock);
 							Lock_Deinit(module->control_thread.thread_lock);
 							Lock_Deinit(module->message_receive_thread.thread_lock);
@@ -847,8 +1833,9 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 								LogError("failed to spawn a thread");
 								module->async_create_thread.thread_handle = NULL;
 								connection_teardown(module);
+								connection_release(module);
 								delete_strings(module);
-								MESSAGE_QUEUE_destroy(module->outgoing_messages);
+								outgoing_queue_release(module);
 								Lock_Deinit(module->async_create_thread.thread_lock);
 								Lock_Deinit(module->control_thread.thread_lock);
 								Lock_Deinit(module->message_receive_thread.thread_lock);
@@ -883,8 +1870,9 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 								{
 									/*Codes_SRS_OUTPROCESS_MODULE_17_016: [ If any step in the creation fails, this function shall deallocate all resources and return NULL. ]*/
 									connection_teardown(module);
+									connection_release(module);
 									delete_strings(module);
-									MESSAGE_QUEUE_destroy(module->outgoing_messages);
+									outgoing_queue_release(module);
 									Lock_Deinit(module->async_create_thread.thread_lock);
 									Lock_Deinit(module->control_thread.thread_lock);
 									Lock_Deinit(module->message_receive_thread.thread_lock);
@@ -980,6 +1968,13 @@ static void Outprocess_Destroy(MODULE_HANDLE moduleHandle)
 			LogError("unable to create destroy control message, continuing with module destroy");
 		}
 
+		if (handleData->polled)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_089: [ If the module shares I/O threads, this function shall remove its sockets from the shared socket poller before it closes them, and destroy the poller once no module uses it. ]*/
+			remove_from_shared_poller(handleData);
+			handleData->polled = 0;
+		}
+
 		/*Codes_SRS_OUTPROCESS_MODULE_17_030: [ This function shall close the message channel socket. ]*/
 		/*Codes_SRS_OUTPROCESS_MODULE_17_031: [ This function shall close the control channel socket. ]*/
 		connection_teardown(handleData);
@@ -988,13 +1983,42 @@ static void Outprocess_Destroy(MODULE_HANDLE moduleHandle)
 		/*Codes_SRS_OUTPROCESS_MODULE_17_032: [ This function shall signal the messaging thread to close. ]*/
 		shutdown_a_thread(&(handleData->message_receive_thread));
 		/*Codes_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
+		/*Codes_SRS_OUTPROCESS_MODULE_17_064: [ This function shall close the outgoing gateway message queue to wake the outgoing gateway message thread. ]*/
+		MESSAGE_QUEUE_close(handleData->outgoing_messages);
+		if (handleData->credit_offer != 0)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_083: [ This function shall end flow control to wake an outgoing gateway message thread waiting for credit. ]*/
+			if (Lock(handleData->handle_lock) != LOCK_OK)
+			{
+				LogError("unable to Lock handle data - the outgoing message thread may wait for credit");
+			}
+			else
+			{
+				handleData->credit_window = 0;
+				(void)Condition_Post(handleData->credit_available);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_100: [ This function shall wake every thread waiting in Outprocess_Receive for room in the queue, which then drops its message. ]*/
+				handleData->receive_closed = 1;
+				if (handleData->room_available != NULL)
+				{
+					(void)Condition_Post(handleData->room_available);
+				}
+				(void)Unlock(handleData->handle_lock);
+			}
+		}
 		shutdown_a_thread(&(handleData->message_send_thread));
 		/*Codes_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
 		shutdown_a_thread(&(handleData->control_thread));
 		shutdown_a_thread(&(handleData->async_create_thread));
+		if (handleData->control_reply_received != NULL)
+		{
+			discard_control_reply(handleData);
+			Condition_Deinit(handleData->control_reply_received);
+		}
 
 		/* Free remaining resources */
 		/*Codes_SRS_OUTPROCESS_MODULE_17_034: [ This function shall release all resources created by this module. ]*/
+		connection_release(handleData);
+		outgoing_queue_release(handleData);
 		delete_strings(handleData);
 		(void)Lock_Deinit(handleData->handle_lock);
 		free(handleData);
@@ -1024,10 +2048,41 @@ static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
 			else
 			{
 				/*Codes_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-				if (MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message) != 0)
+				int queued = MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message);
+				if (queued != 0 && handleData->room_available != NULL)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_098: [ If the queue holds the credit window and the overflow policy is BROKER_OVERFLOW_BLOCK, this function shall wait until the outgoing gateway message thread removes a message, then push the message. ]*/
+					while (queued != 0 && !handleData->receive_closed)
+					{
+						handleData->room_waiters++;
+						(void)Condition_Wait(handleData->room_available, handleData->handle_lock, 0);
+						handleData->room_waiters--;
+						queued = MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message);
+					}
+					if (handleData->room_waiters != 0)
+					{
+						/*pass a wake up from Outprocess_Destroy on to the next waiter*/
+						(void)Condition_Post(handleData->room_available);
+					}
+				}
+				else if (queued != 0 && handleData->overflow == BROKER_OVERFLOW_DROP_OLDEST)
+				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_101: [ If the message cannot be queued and the overflow policy is BROKER_OVERFLOW_DROP_OLDEST, this function shall discard the oldest queued message, count it as dropped, and push the message again. ]*/
+					MESSAGE_HANDLE oldest = MESSAGE_QUEUE_pop(handleData->outgoing_messages);
+					if (oldest != NULL)
+					{
+						Message_Destroy(oldest);
+						(void)gateway_atomic_increment(&handleData->dropped);
+						queued = MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message);
+					}
+				}
+
+				if (queued != 0)
 				{
+					/*Codes_SRS_OUTPROCESS_MODULE_17_102: [ If the message still cannot be queued, this function shall discard it and count it as dropped. ]*/
 					LogError("unable to queue the message");
 					Message_Destroy(queued_message);
+					(void)gateway_atomic_increment(&handleData->dropped);
 				}
 				(void)Unlock(handleData->handle_lock);
 			}
@@ -1035,15 +2090,67 @@ static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
 	}
 }
 
+size_t Outprocess_GetQueueDepth(MODULE_HANDLE moduleHandle)
+{
+	size_t result;
+	OUTPROCESS_HANDLE_DATA* handleData = moduleHandle;
+	if (handleData == NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_092: [ If module is NULL, Outprocess_GetQueueDepth shall return 0. ]*/
+		LogError("module is NULL");
+		result = 0;
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_093: [ Outprocess_GetQueueDepth shall return the size of the outgoing gateway message queue. ]*/
+		result = MESSAGE_QUEUE_size(handleData->outgoing_messages);
+	}
+	return result;
+}
+
+size_t Outprocess_GetDropCount(MODULE_HANDLE moduleHandle)
+{
+	size_t result;
+	OUTPROCESS_HANDLE_DATA* handleData = moduleHandle;
+	if (handleData == NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_103: [ If module is NULL, Outprocess_GetDropCount shall return 0. ]*/
+		LogError("module is NULL");
+		result = 0;
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_104: [ Outprocess_GetDropCount shall return the number of messages Outprocess_Receive has discarded. ]*/
+		result = gateway_atomic_load(&handleData->dropped);
+	}
+	return result;
+}
+
 static void Outprocess_Start(MODULE_HANDLE moduleHandle)
 {
 	OUTPROCESS_HANDLE_DATA* handleData = moduleHandle;
 	/*Codes_SRS_OUTPROCESS_MODULE_17_020: [ This function shall do nothing if module is NULL. ]*/
 	if (handleData != NULL)
 	{
+		if (handleData->io_threads == OUTPROCESS_IO_THREADS_SHARED)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_084: [ If the configuration shares I/O threads, this function shall add the control socket, and the message socket unless the message channel is shared memory, to the socket poller shared by the proxy modules, instead of creating the threads that would receive on them. ]*/
+			if (add_to_shared_poller(handleData) != 0)
+			{
+				/*Codes_SRS_OUTPROCESS_MODULE_17_090: [ If the sockets cannot be added to the shared socket poller, this function shall create the threads of the module instead. ]*/
+				LogError("unable to share I/O threads, the module receives on threads of its own");
+			}
+			else
+			{
+				handleData->polled = 1;
+			}
+		}
+		int message_socket_polled = (handleData->polled && handleData->message_channel == NULL);
+
 		/*Codes_SRS_OUTPROCESS_MODULE_17_017: [ This function shall ensure thread safety on execution. ]*/
 		/*Codes_SRS_OUTPROCESS_MODULE_17_018: [ This function shall create a thread to handle receiving messages from module host. ]*/
-		if (ThreadAPI_Create(&(handleData->message_receive_thread.thread_handle), outprocessIncomingMessageThread, handleData) != THREADAPI_OK)
+		if (!message_socket_polled &&
+			ThreadAPI_Create(&(handleData->message_receive_thread.thread_handle), outprocessIncomingMessageThread, handleData) != THREADAPI_OK)
 		{
 			LogError("failed to spawn message handling thread");
 			handleData->message_receive_thread.thread_handle = NULL;
@@ -1055,7 +2162,8 @@ static void Outprocess_Start(MODULE_HANDLE moduleHandle)
 			handleData->control_thread.thread_handle = NULL;
 		}
 		/*Codes_SRS_OUTPROCESS_MODULE_17_044: [ This function shall create a thread to handle receiving messages from module host. ]*/
-		else if (ThreadAPI_Create(&(handleData->control_thread.thread_handle), outprocessControlThread, handleData) != THREADAPI_OK)
+		else if (!handleData->polled &&
+			ThreadAPI_Create(&(handleData->control_thread.thread_handle), outprocessControlThread, handleData) != THREADAPI_OK)
 		{
 			LogError("failed to spawn control handling thread");
 			handleData->control_thread.thread_handle = NULL;
@@ -0,0 +1,270 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "module.h"
+#include "message.h"
+#include "module_loaders/outprocess_module.h"
+#include "module_loaders/outprocess_replica_pool.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "gateway_atomic.h"
+
+typedef struct OUTPROCESS_REPLICA_POOL_DATA_TAG
+{
+	MODULE_HANDLE * replicas;
+	unsigned int replica_count;
+	OUTPROCESS_BALANCE balance;
+	/*the message property hashed to choose a replica; NULL unless balance is OUTPROCESS_BALANCE_HASH*/
+	STRING_HANDLE balance_property;
+	/*counts the turns taken, modulo replica_count it is the replica after the one chosen last*/
+	GATEWAY_ATOMIC_U32 next_replica;
+} OUTPROCESS_REPLICA_POOL_DATA;
+
+/*FNV-1a, so that the same key always goes to the same replica*/
+static uint32_t hash_key(const char * key)
+{
+	uint32_t hash = 2166136261u;
+	while (*key != '\0')
+	{
+		hash ^= (unsigned char)*key++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*Receive does not assume a single caller thread: the pool engine's workers may steal the module's task*/
+static unsigned int take_next_replica(OUTPROCESS_REPLICA_POOL_DATA * pool)
+{
+	return (unsigned int)((gateway_atomic_increment(&pool->next_replica) - 1) % pool->replica_count);
+}
+
+static unsigned int choose_replica(OUTPROCESS_REPLICA_POOL_DATA * pool, MESSAGE_HANDLE messageHandle)
+{
+	unsigned int result;
+	const char * key;
+	if (pool->balance == OUTPROCESS_BALANCE_HASH &&
+		(key = Message_GetProperty(messageHandle, STRING_c_str(pool->balance_property))) != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_014: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall choose the replica from a hash of the message's balance_property, so that messages with the same value go to the same replica in order. ]*/
+		result = hash_key(key) % pool->replica_count;
+	}
+	else if (pool->balance == OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_013: [ If balance is OUTPROCESS_BALANCE_LEAST_QUEUE_DEPTH, this function shall choose the replica with the fewest messages queued for its module host, looking from the replica after the one chosen last and stopping at an empty queue. ]*/
+		size_t least_depth = SIZE_MAX;
+		unsigned int candidate = (unsigned int)(gateway_atomic_load(&pool->next_replica) % pool->replica_count);
+		unsigned int i;
+		result = candidate;
+		for (i = 0; i < pool->replica_count; i++)
+		{
+			size_t depth = Outprocess_GetQueueDepth(pool->replicas[candidate]);
+			if (depth < least_depth)
+			{
+				least_depth = depth;
+				result = candidate;
+				if (depth == 0)
+				{
+					break;
+				}
+			}
+			candidate = (candidate + 1 == pool->replica_count) ? 0 : candidate + 1;
+		}
+		gateway_atomic_store(&pool->next_replica, result + 1);
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_012: [ If balance is OUTPROCESS_BALANCE_ROUND_ROBIN, this function shall choose the replicas in turn. ]*/
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_015: [ If balance is OUTPROCESS_BALANCE_HASH and the message does not have the balance_property, this function shall choose the replicas in turn. ]*/
+		result = take_next_replica(pool);
+	}
+	return result;
+}
+
+/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_001: [ This function shall parse the configuration like Outprocess_Module_API_all. ]*/
+static void* ReplicaPool_ParseConfigurationFromJson(const char* configuration)
+{
+	return Outprocess_Module_API_all.Module_ParseConfigurationFromJson(configuration);
+}
+
+/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_001: [ This function shall parse the configuration like Outprocess_Module_API_all. ]*/
+static void ReplicaPool_FreeConfiguration(void* configuration)
+{
+	Outprocess_Module_API_all.Module_FreeConfiguration(configuration);
+}
+
+static MODULE_HANDLE create_replica(OUTPROCESS_REPLICA_POOL_DATA * pool, BROKER_HANDLE broker, const OUTPROCESS_MODULE_CONFIG * config, unsigned int index)
+{
+	MODULE_HANDLE result;
+	OUTPROCESS_MODULE_CONFIG replica_config = *config;
+	/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_006: [ Each replica shall be configured like the pool, with a single replica, the pool as its publish_source, and the control and message URIs of the pool followed by "." and the index of the replica. ]*/
+	replica_config.replicas = 1;
+	replica_config.publish_source = (MODULE_HANDLE)pool;
+	replica_config.control_uri = STRING_construct_sprintf(OUTPROCESS_REPLICA_ID_FORMAT, STRING_c_str(config->control_uri), index);
+	if (replica_config.control_uri == NULL)
+	{
+		LogError("unable to build the control URI of replica %u", index);
+		result = NULL;
+	}
+	else
+	{
+		replica_config.message_uri = STRING_construct_sprintf(OUTPROCESS_REPLICA_ID_FORMAT, STRING_c_str(config->message_uri), index);
+		if (replica_config.message_uri == NULL)
+		{
+			LogError("unable to build the message URI of replica %u", index);
+			result = NULL;
+		}
+		else
+		{
+			/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_007: [ This function shall create each replica with Outprocess_Module_API_all. ]*/
+			result = Outprocess_Module_API_all.Module_Create(broker, &replica_config);
+			if (result == NULL)
+			{
+				LogError("unable to create replica %u", index);
+			}
+			STRING_delete(replica_config.message_uri);
+		}
+		STRING_delete(replica_config.control_uri);
+	}
+	return result;
+}
+
+static void destroy_replicas(OUTPROCESS_REPLICA_POOL_DATA * pool, unsigned int count)
+{
+	unsigned int i;
+	for (i = 0; i < count; i++)
+	{
+		Outprocess_Module_API_all.Module_Destroy(pool->replicas[i]);
+	}
+}
+
+static void free_pool(OUTPROCESS_REPLICA_POOL_DATA * pool)
+{
+	if (pool->balance_property != NULL)
+	{
+		STRING_delete(pool->balance_property);
+	}
+	free(pool->replicas);
+	free(pool);
+}
+
+static MODULE_HANDLE ReplicaPool_Create(BROKER_HANDLE broker, const void* configuration)
+{
+	OUTPROCESS_REPLICA_POOL_DATA * pool;
+	const OUTPROCESS_MODULE_CONFIG * config = (const OUTPROCESS_MODULE_CONFIG*)configuration;
+	if (broker == NULL || config == NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_002: [ If broker or configuration are NULL, this function shall return NULL. ]*/
+		LogError("invalid arguments for replica pool. broker=[%p], configuration = [%p]", broker, configuration);
+		pool = NULL;
+	}
+	else if (config->balance == OUTPROCESS_BALANCE_HASH && config->balance_property == NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_003: [ If balance is OUTPROCESS_BALANCE_HASH and balance_property is NULL, this function shall return NULL. ]*/
+		LogError("hash balancing needs a property to hash");
+		pool = NULL;
+	}
+	/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_004: [ This function shall allocate memory for the pool and for a replica handle per replica, counting one replica if replicas is 0. ]*/
+	else if ((pool = (OUTPROCESS_REPLICA_POOL_DATA*)malloc(sizeof(OUTPROCESS_REPLICA_POOL_DATA))) == NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+		LogError("allocation for replica pool failed.");
+	}
+	else
+	{
+		pool->replica_count = (config->replicas < 1) ? 1 : config->replicas;
+		pool->balance = config->balance;
+		pool->balance_property = NULL;
+		pool->next_replica = 0;
+		if ((pool->replicas = (MODULE_HANDLE*)malloc(pool->replica_count * sizeof(MODULE_HANDLE))) == NULL)
+		{
+			/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+			LogError("allocation for %u replicas failed.", pool->replica_count);
+			free(pool);
+			pool = NULL;
+		}
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_005: [ If balance is OUTPROCESS_BALANCE_HASH, this function shall keep a copy of balance_property. ]*/
+		else if (pool->balance == OUTPROCESS_BALANCE_HASH &&
+			(pool->balance_property = STRING_clone(config->balance_property)) == NULL)
+		{
+			/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+			LogError("unable to copy the balance property");
+			free_pool(pool);
+			pool = NULL;
+		}
+		else
+		{
+			unsigned int created;
+			for (created = 0; created < pool->replica_count; created++)
+			{
+				if ((pool->replicas[created] = create_replica(pool, broker, config, created)) == NULL)
+				{
+					break;
+				}
+			}
+
+			if (created < pool->replica_count)
+			{
+				/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_008: [ If any step fails, this function shall destroy the replicas created so far, deallocate all resources and return NULL. ]*/
+				destroy_replicas(pool, created);
+				free_pool(pool);
+				pool = NULL;
+			}
+			/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_009: [ Upon success, this function shall return the pool as the module handle. ]*/
+		}
+	}
+	return (MODULE_HANDLE)pool;
+}
+
+static void ReplicaPool_Destroy(MODULE_HANDLE moduleHandle)
+{
+	OUTPROCESS_REPLICA_POOL_DATA * pool = (OUTPROCESS_REPLICA_POOL_DATA*)moduleHandle;
+	/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_018: [ If module is NULL, this function shall do nothing. ]*/
+	if (pool != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_019: [ This function shall destroy every replica and release all resources created by this module. ]*/
+		destroy_replicas(pool, pool->replica_count);
+		free_pool(pool);
+	}
+}
+
+static void ReplicaPool_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+	OUTPROCESS_REPLICA_POOL_DATA * pool = (OUTPROCESS_REPLICA_POOL_DATA*)moduleHandle;
+	/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_010: [ If module or message_handle is NULL, this function shall do nothing. ]*/
+	if (pool != NULL && messageHandle != NULL)
+	{
+		/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_011: [ This function shall hand the message to the Module_Receive of one replica. ]*/
+		unsigned int replica = choose_replica(pool, messageHandle);
+		Outprocess_Module_API_all.Module_Receive(pool->replicas[replica], messageHandle);
+	}
+}
+
+static void ReplicaPool_Start(MODULE_HANDLE moduleHandle)
+{
+	OUTPROCESS_REPLICA_POOL_DATA * pool = (OUTPROCESS_REPLICA_POOL_DATA*)moduleHandle;
+	/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_016: [ If module is NULL, this function shall do nothing. ]*/
+	if (pool != NULL)
+	{
+		unsigned int i;
+		for (i = 0; i < pool->replica_count; i++)
+		{
+			/*Codes_SRS_OUTPROCESS_REPLICA_POOL_17_017: [ This function shall start every replica. ]*/
+			Outprocess_Module_API_all.Module_Start(pool->replicas[i]);
+		}
+	}
+}
+
+const MODULE_API_1 Outprocess_Replica_Pool_API_all =
+{
+	{MODULE_API_VERSION_1},
+	ReplicaPool_ParseConfigurationFromJson,
+	ReplicaPool_FreeConfiguration,
+	ReplicaPool_Create,
+	ReplicaPool_Destroy,
+	ReplicaPool_Receive,
+	ReplicaPool_Start
+};
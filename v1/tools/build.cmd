@@ -25,6 +25,7 @@ set build-platform=Win32
 set rebuild_deps=OFF
 set CMAKE_run_unittests=OFF
 set CMAKE_run_e2e_tests=OFF
+set CMAKE_build_benchmarks=OFF
 set CMAKE_enable_dotnet_binding=OFF
 set CMAKE_enable_dotnet_core_binding=OFF
 set enable-java-binding=OFF
@@ -43,6 +44,7 @@ if "%1" equ "--rebuild-deps" goto arg-rebuild-deps
 if "%1" equ "--platform" goto arg-build-platform
 if "%1" equ "--run-unittests" goto arg-run-unittests
 if "%1" equ "--run-e2e-tests" goto arg-run-e2e-tests
+if "%1" equ "--build-benchmarks" goto arg-build-benchmarks
 if "%1" equ "--enable-dotnet-binding" goto arg-enable-dotnet-binding
 if "%1" equ "--enable-dotnet-core-binding" goto arg-enable-dotnet-core-binding
 if "%1" equ "--enable-java-binding" goto arg-enable-java-binding
@@ -80,6 +82,10 @@ goto args-continue
 set CMAKE_run_e2e_tests=ON
 goto args-continue
 
+:arg-build-benchmarks
+set CMAKE_build_benchmarks=ON
+goto args-continue
+
 :arg-enable-dotnet-binding
 set CMAKE_enable_dotnet_binding=ON
 if not !ERRORLEVEL!==0 exit /b !ERRORLEVEL!
@@ -211,7 +217,7 @@ mkdir %cmake-root%
 if not !ERRORLEVEL!==0 exit /b !ERRORLEVEL!
 
 pushd %cmake-root%
-cmake %dependency_install_prefix% -DCMAKE_BUILD_TYPE="%build-config%" -Drun_unittests:BOOL=%CMAKE_run_unittests% -Drun_e2e_tests:BOOL=%CMAKE_run_e2e_tests% -Denable_dotnet_binding:BOOL=%CMAKE_enable_dotnet_binding% -Denable_dotnet_core_binding:BOOL=%CMAKE_enable_dotnet_core_binding% -Denable_java_binding:BOOL=%enable-java-binding% -Denable_nodejs_binding:BOOL=%enable_nodejs_binding% -Denable_native_remote_modules:BOOL=%enable_native_remote_modules% -Denable_java_remote_modules:BOOL=%enable_java_remote_modules% -Denable_nodejs_remote_modules:BOOL=%enable_nodejs_remote_modules% -Denable_ble_module:BOOL=%CMAKE_enable_ble_module% -Drebuild_deps:BOOL=%rebuild_deps% -Duse_xplat_uuid:BOOL=%use_xplat_uuid% -G "%cmake-generator%" "%build-root%"
+cmake %dependency_install_prefix% -DCMAKE_BUILD_TYPE="%build-config%" -Drun_unittests:BOOL=%CMAKE_run_unittests% -Drun_e2e_tests:BOOL=%CMAKE_run_e2e_tests% -Dbuild_benchmarks:BOOL=%CMAKE_build_benchmarks% -Denable_dotnet_binding:BOOL=%CMAKE_enable_dotnet_binding% -Denable_dotnet_core_binding:BOOL=%CMAKE_enable_dotnet_core_binding% -Denable_java_binding:BOOL=%enable-java-binding% -Denable_nodejs_binding:BOOL=%enable_nodejs_binding% -Denable_native_remote_modules:BOOL=%enable_native_remote_modules% -Denable_java_remote_modules:BOOL=%enable_java_remote_modules% -Denable_nodejs_remote_modules:BOOL=%enable_nodejs_remote_modules% -Denable_ble_module:BOOL=%CMAKE_enable_ble_module% -Drebuild_deps:BOOL=%rebuild_deps% -Duse_xplat_uuid:BOOL=%use_xplat_uuid% -G "%cmake-generator%" "%build-root%"
 if not !ERRORLEVEL!==0 exit /b !ERRORLEVEL!
 
 msbuild /m /p:Configuration="%build-config%" /p:Platform="%build-platform%" azure_iot_gateway_sdk.sln
@@ -233,6 +239,7 @@ rem ----------------------------------------------------------------------------
 :usage
 echo build.cmd [options]
 echo options:
+echo  --build-benchmarks              Build the message_bench microbenchmarks
 echo  --config value                  Build configuration (e.g. [Debug], Release)
 echo  --disable-ble-module            Do not build the BLE module
 echo  --enable-dotnet-binding         Build .NET binding
@@ -11,6 +11,7 @@ CORES=0
 rebuild_deps=OFF
 run_unittests=OFF
 run_e2e_tests=OFF
+build_benchmarks=OFF
 run_valgrind=0
 enable_java_binding=OFF
 enable_dotnet_core_binding=OFF
@@ -36,6 +37,7 @@ usage ()
     echo "options"
     echo " -cl, --compileoption <val>      Specify a gcc compile option"
     echo "   Example: -cl -O1 -cl ..."
+    echo " --build-benchmarks              Build the message_bench microbenchmarks"
     echo " -f,  --config <value>           Build configuration (e.g. [Debug], Release)"
     echo " --disable-ble-module            Do not build the BLE module"
     echo " --enable-dotnet-core-binding    Build the .NET Core binding"
@@ -89,6 +91,7 @@ process_args ()
               "-x" | "--xtrace" ) set -x;;
               "--run-unittests" ) run_unittests=ON;;
               "--run-e2e-tests" ) run_e2e_tests=ON;;
+              "--build-benchmarks" ) build_benchmarks=ON;;
               "--rebuild-deps" ) rebuild_deps=ON;;
               "-cl" | "--compileoption" ) save_next_arg=1;;
               "-rv" | "--run-valgrind" ) run_valgrind=1;;
@@ -209,6 +212,7 @@ cmake $toolchainfile \
       -DCMAKE_BUILD_TYPE="$build_config" \
       -Drun_unittests:BOOL=$run_unittests \
       -Drun_e2e_tests:BOOL=$run_e2e_tests \
+      -Dbuild_benchmarks:BOOL=$build_benchmarks \
       -Denable_java_binding:BOOL=$enable_java_binding \
       -Denable_dotnet_core_binding:BOOL=$enable_dotnet_core_binding \
       -Denable_nodejs_binding:BOOL=$enable_nodejs_binding \